@@ -119,6 +119,19 @@ extract_pipe_data (void)
     return (*data->str) ? g_strdup (data->str) : NULL;
 }
 
+/* The whole value of a listed item: a listing only carries the start of a long
+ * one, and what a script reads out of this is the item's contents. */
+static gchar *
+listed_item_value (Context          *ctx,
+                   GPasteClientItem *item,
+                   GError          **error)
+{
+    if (!g_paste_client_item_is_truncated (item))
+        return g_strdup (g_paste_client_item_get_value (item));
+
+    return g_paste_client_get_value_sync (ctx->client, g_paste_client_item_get_uuid (item), error);
+}
+
 static void
 print_history_line (gchar       *line,
                     guint        index,
@@ -224,7 +237,11 @@ g_paste_history (Context *ctx,
         if (ctx->favourites && !g_paste_client_item_is_favourite (item))
             continue;
 
-        g_autofree gchar *line = g_strdup (g_paste_client_item_get_value (item));
+        g_autofree gchar *line = listed_item_value (ctx, item, error);
+
+        if (*error)
+            return EXIT_FAILURE;
+
         print_history_line (line, position, g_paste_client_item_get_uuid (item), ctx);
     }
 
@@ -551,12 +568,12 @@ static gint
 g_paste_get (Context *ctx,
              GError **error)
 {
-    g_autoptr (GPasteClientItem) item = g_paste_client_get_item_sync (ctx->client, ctx->uuid, error);
+    g_autofree gchar *value = g_paste_client_get_value_sync (ctx->client, ctx->uuid, error);
 
     if (*error)
         return EXIT_FAILURE;
 
-    printf ("%s", g_paste_client_item_get_value (item));
+    printf ("%s", value);
 
     return EXIT_SUCCESS;
 }
@@ -598,7 +615,11 @@ g_paste_search (Context *ctx,
         if (ctx->favourites && !g_paste_client_item_is_favourite (item))
             continue;
 
-        g_autofree gchar *line = g_strdup (g_paste_client_item_get_value (item));
+        g_autofree gchar *line = listed_item_value (ctx, item, error);
+
+        if (*error)
+            return EXIT_FAILURE;
+
         print_history_line (line, index++, g_paste_client_item_get_uuid (item), ctx);
     }
 
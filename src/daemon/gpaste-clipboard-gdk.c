@@ -11,6 +11,7 @@
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-special-atom.h>
 #include <gpaste-daemon/gpaste-text-item.h>
+#include <gpaste-daemon/gpaste-text-sink.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
 
 enum
@@ -29,6 +30,12 @@ struct _GPasteClipboardGdk
     GPasteSettings        *settings;
 
     GPasteClipboardContent content;
+    /* Bumped by every update and every selection we make ourselves. An image
+     * capture finishes on a worker thread, well after its read started: one
+     * that comes back to a different serial was overtaken (a newer owner, or
+     * the user picking something from the history) and must neither claim the
+     * clipboard back nor land in the history behind what replaced it. */
+    guint64                serial;
 
     gulong                 c_signals[C_LAST_SIGNAL];
 };
@@ -43,7 +50,7 @@ typedef void (*GPasteClipboardGdkTextCallback)    (GPasteClipboardGdk *self,
                                                    gpointer            user_data);
 
 typedef void (*GPasteClipboardGdkTextureCallback) (GPasteClipboardGdk *self,
-                                                   GdkTexture         *texture,
+                                                   GPasteItem         *image,
                                                    gpointer            user_data);
 
 static gboolean
@@ -80,27 +87,34 @@ g_paste_clipboard_gdk_private_set_text_take (GPasteClipboardGdk *self,
 static void g_paste_clipboard_gdk_select_text (GPasteClipboardGdk *self,
                                                const gchar        *text);
 
+/* The mimetype we stream text from. GDK maps the X11 targets carrying UTF-8
+ * onto it too, so a failed read only means an owner offering nothing but
+ * legacy encodings, which gdk_clipboard_read_text_async() still converts. */
+#define GDK_MIME_TEXT "text/plain;charset=utf-8"
+
 typedef struct
 {
     GPasteClipboardGdk            *self; /* ref'd for the duration of the read */
+    GOutputStream                 *sink; /* the #GPasteTextSink, while splicing */
+    GCancellable                  *cancellable; /* the update's, if any */
     GPasteClipboardGdkTextCallback callback;
     gpointer                       user_data;
 } GPasteClipboardGdkTextCallbackData;
 
+/* The end of every text read, whichever way the text came in: %NULL when there
+ * was none to be had. Frees @user_data. */
 static void
-g_paste_clipboard_gdk_on_text_ready (GObject      *source_object,
-                                     GAsyncResult *res,
-                                     gpointer      user_data)
+g_paste_clipboard_gdk_on_text (gpointer     user_data,
+                               const gchar *text)
 {
     g_autofree GPasteClipboardGdkTextCallbackData *data = user_data;
     g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in set_text */
-    g_autoptr (GError) error = NULL;
-    g_autofree gchar *text = gdk_clipboard_read_text_finish (GDK_CLIPBOARD (source_object), res, &error);
+    g_autoptr (GCancellable) cancellable = data->cancellable;
 
-    if (!text)
+    /* A text that made it in just as its update was superseded must not move
+     * the cache: the next update would then find it unchanged and drop it. */
+    if (!text || g_cancellable_is_cancelled (cancellable))
     {
-        if (error)
-            g_debug ("Failed to read text from clipboard: %s", error->message);
         if (data->callback)
             data->callback (self, NULL, data->user_data);
         return;
@@ -127,23 +141,112 @@ g_paste_clipboard_gdk_on_text_ready (GObject      *source_object,
         data->callback (self, self->content.str, data->user_data);
 }
 
+static void
+g_paste_clipboard_gdk_on_text_ready (GObject      *source_object,
+                                     GAsyncResult *res,
+                                     gpointer      user_data)
+{
+    g_autoptr (GError) error = NULL;
+    g_autofree gchar *text = gdk_clipboard_read_text_finish (GDK_CLIPBOARD (source_object), res, &error);
+
+    /* Legacy encodings are read in one go: the size policy applied to the
+     * result is all the capping they get. */
+    if (error)
+        g_debug ("Failed to read text from clipboard: %s", error->message);
+
+    g_paste_clipboard_gdk_on_text (user_data, text);
+}
+
+static void
+g_paste_clipboard_gdk_on_text_spliced (GObject      *source_object,
+                                       GAsyncResult *res,
+                                       gpointer      user_data)
+{
+    GPasteClipboardGdkTextCallbackData *data = user_data;
+    g_autoptr (GOutputStream) sink = g_steal_pointer (&data->sink);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GBytes) bytes = NULL;
+    g_autofree gchar *text = NULL;
+
+    /* The sink failing a write (too big, not UTF-8) fails the splice, which
+     * closes the source there and then: the rest of the text is never read. */
+    if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source_object), res, &error) >= 0)
+        bytes = g_paste_text_sink_finish (G_PASTE_TEXT_SINK (sink), &error);
+
+    if (bytes)
+    {
+        gsize size;
+        const gchar *raw = g_bytes_get_data (bytes, &size);
+
+        text = g_strndup ((raw) ? raw : "", size);
+    }
+    else
+        g_debug ("Failed to read text from clipboard: %s", error->message);
+
+    g_paste_clipboard_gdk_on_text (data, text);
+}
+
+static void
+g_paste_clipboard_gdk_on_text_stream_ready (GObject      *source_object,
+                                            GAsyncResult *res,
+                                            gpointer      user_data)
+{
+    GPasteClipboardGdkTextCallbackData *data = user_data;
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GInputStream) stream = gdk_clipboard_read_finish (GDK_CLIPBOARD (source_object), res, NULL, &error);
+
+    if (!stream)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+            gdk_clipboard_read_text_async (GDK_CLIPBOARD (source_object),
+                                           data->cancellable,
+                                           g_paste_clipboard_gdk_on_text_ready,
+                                           data);
+            return;
+        }
+
+        if (error)
+            g_debug ("Failed to read text from clipboard: %s", error->message);
+        g_paste_clipboard_gdk_on_text (data, NULL);
+        return;
+    }
+
+    /* Chunk by chunk into a sink capped at what the history would accept, so
+     * an oversized text is dropped as soon as it shows it is one, rather than
+     * once it has all been allocated (see GPasteTextSink). */
+    data->sink = g_paste_text_sink_new (g_paste_settings_get_max_text_item_size (data->self->settings));
+    g_output_stream_splice_async (data->sink,
+                                  stream,
+                                  G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                  G_PRIORITY_DEFAULT,
+                                  data->cancellable,
+                                  g_paste_clipboard_gdk_on_text_spliced,
+                                  data);
+}
+
 static void
 g_paste_clipboard_gdk_set_text (GPasteClipboardGdk            *self,
+                                GCancellable                  *cancellable,
                                 GPasteClipboardGdkTextCallback callback,
                                 gpointer                       user_data)
 {
-    GPasteClipboardGdkTextCallbackData *data = g_new (GPasteClipboardGdkTextCallbackData, 1);
+    GPasteClipboardGdkTextCallbackData *data = g_new0 (GPasteClipboardGdkTextCallbackData, 1);
+    const gchar *mime_types[] = { GDK_MIME_TEXT, NULL };
 
     /* Hold a ref for the whole read, as the meta backend does: nothing else
      * keeps us alive between the request and its callback. */
     data->self = g_object_ref (self);
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
 
-    gdk_clipboard_read_text_async (self->real,
-                                   NULL, /* cancellable */
-                                   g_paste_clipboard_gdk_on_text_ready,
-                                   data);
+    gdk_clipboard_read_async (self->real,
+                              mime_types,
+                              G_PRIORITY_DEFAULT,
+                              cancellable,
+                              g_paste_clipboard_gdk_on_text_stream_ready,
+                              data);
 }
 
 static void
@@ -152,6 +255,8 @@ g_paste_clipboard_gdk_select_text (GPasteClipboardGdk *self,
 {
     g_debug ("%s: select text", g_paste_clipboard_provider_target_name (self->is_clipboard));
 
+    ++self->serial;
+
     /* Avoid cycling twice as setting the content will make the clipboards manager react */
     g_paste_clipboard_gdk_private_set_text (self, text);
 
@@ -254,61 +359,101 @@ g_paste_clipboard_gdk_private_select_texture (GPasteClipboardGdk *self,
 typedef struct
 {
     GPasteClipboardGdk               *self; /* ref'd for the duration of the read */
+    GCancellable                     *cancellable; /* the update's, if any */
     GPasteClipboardGdkTextureCallback callback;
     gpointer                          user_data;
+    guint64                           serial;
 } GPasteClipboardGdkTextureCallbackData;
 
+static void
+g_paste_clipboard_gdk_on_image_ready (GObject      *source_object G_GNUC_UNUSED,
+                                      GAsyncResult *res,
+                                      gpointer      user_data)
+{
+    g_autofree GPasteClipboardGdkTextureCallbackData *data = user_data;
+    g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in set_texture */
+    g_autoptr (GCancellable) cancellable = data->cancellable;
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GPasteItem) image = g_paste_image_item_new_finish (res, &error);
+
+    if (!image)
+    {
+        g_debug ("Failed to process image from clipboard: %s", error->message);
+    }
+    else if (data->serial != self->serial || g_cancellable_is_cancelled (cancellable))
+    {
+        /* See the comment on @serial: whatever replaced it is what the
+         * clipboard holds now, so this one is no longer anybody's. A
+         * cancelled update is the same story, told before the next one
+         * got the chance to start. */
+        g_debug ("%s: dropping superseded image", g_paste_clipboard_provider_target_name (self->is_clipboard));
+        g_clear_object (&image);
+    }
+    else
+    {
+        GPasteImageItem *image_item = G_PASTE_IMAGE_ITEM (image);
+        const gchar *checksum = g_paste_image_item_get_checksum (image_item);
+
+        if (self->content.kind == CLIPBOARD_CONTENT_IMAGE && g_paste_str_equal (checksum, self->content.str))
+            g_clear_object (&image); /* Same image, nothing to do */
+        else
+            g_paste_clipboard_gdk_private_select_texture (self, g_paste_image_item_get_image (image_item), checksum);
+    }
+
+    if (data->callback)
+        data->callback (self, g_steal_pointer (&image), data->user_data);
+}
+
 static void
 g_paste_clipboard_gdk_on_texture_ready (GObject      *source_object,
                                         GAsyncResult *res,
                                         gpointer      user_data)
 {
-    g_autofree GPasteClipboardGdkTextureCallbackData *data = user_data;
-    g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in set_texture */
+    GPasteClipboardGdkTextureCallbackData *data = user_data;
     g_autoptr (GError) error = NULL;
     /* Transfer full — we own this ref */
     g_autoptr (GdkTexture) texture = gdk_clipboard_read_texture_finish (GDK_CLIPBOARD (source_object), res, &error);
 
     if (!texture)
     {
+        g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in set_texture */
+        g_autoptr (GCancellable) cancellable = data->cancellable;
+
         if (error)
             g_debug ("Failed to read texture from clipboard: %s", error->message);
         if (data->callback)
             data->callback (self, NULL, data->user_data);
+        g_free (data);
         return;
     }
 
-    g_autofree gchar *checksum = g_paste_image_item_compute_checksum (texture);
-    GdkTexture *result = NULL;
-
-    if (self->content.kind == CLIPBOARD_CONTENT_IMAGE && g_paste_str_equal (checksum, self->content.str))
-    {
-        /* Same image, nothing to do */
-    }
-    else
-    {
-        g_paste_clipboard_gdk_private_select_texture (self, texture, checksum);
-        result = texture;  /* borrowed from the g_autoptr above */
-    }
-
-    if (data->callback)
-        data->callback (self, result, data->user_data);
+    /* Checksumming and encoding a full-size image is the slow part of a
+     * capture: hand both to a worker, @data riding along with its ref. */
+    g_paste_image_item_new_async (texture,
+                                  g_paste_settings_get_images_encoder (data->self->settings),
+                                  data->cancellable,
+                                  g_paste_clipboard_gdk_on_image_ready,
+                                  data);
 }
 
 static void
 g_paste_clipboard_gdk_set_texture (GPasteClipboardGdk               *self,
+                                   GCancellable                     *cancellable,
                                    GPasteClipboardGdkTextureCallback callback,
                                    gpointer                          user_data)
 {
     GPasteClipboardGdkTextureCallbackData *data = g_new (GPasteClipboardGdkTextureCallbackData, 1);
 
-    /* Ref for the whole read (see set_text). */
+    /* Ref for the whole read (see set_text), which lasts until the worker
+     * building the item is done with it too. */
     data->self = g_object_ref (self);
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
+    data->serial = self->serial;
 
     gdk_clipboard_read_texture_async (self->real,
-                                      NULL, /* cancellable */
+                                      cancellable,
                                       g_paste_clipboard_gdk_on_texture_ready,
                                       data);
 }
@@ -320,6 +465,7 @@ typedef void (*GPasteClipboardGdkRGBACallback) (GPasteClipboardGdk *self,
 typedef struct
 {
     GPasteClipboardGdk            *self; /* ref'd for the duration of the read */
+    GCancellable                  *cancellable; /* the update's, if any */
     GPasteClipboardGdkRGBACallback callback;
     gpointer                       user_data;
 } GPasteClipboardGdkRGBACallbackData;
@@ -331,6 +477,7 @@ g_paste_clipboard_gdk_on_rgba_ready (GObject      *source_object,
 {
     g_autofree GPasteClipboardGdkRGBACallbackData *data = user_data;
     g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in set_color */
+    g_autoptr (GCancellable) cancellable = data->cancellable;
     g_autoptr (GError) error = NULL;
     const GValue *value = gdk_clipboard_read_value_finish (GDK_CLIPBOARD (source_object), res, &error);
 
@@ -345,7 +492,8 @@ g_paste_clipboard_gdk_on_rgba_ready (GObject      *source_object,
 
     const GdkRGBA *rgba = g_value_get_boxed (value);
 
-    if (!rgba)
+    /* Superseded: leave the cache alone (see on_text). */
+    if (!rgba || g_cancellable_is_cancelled (cancellable))
     {
         if (data->callback)
             data->callback (self, NULL, data->user_data);
@@ -367,6 +515,7 @@ g_paste_clipboard_gdk_on_rgba_ready (GObject      *source_object,
 
 static void
 g_paste_clipboard_gdk_set_color (GPasteClipboardGdk            *self,
+                                 GCancellable                  *cancellable,
                                  GPasteClipboardGdkRGBACallback callback,
                                  gpointer                       user_data)
 {
@@ -374,13 +523,14 @@ g_paste_clipboard_gdk_set_color (GPasteClipboardGdk            *self,
 
     /* Ref for the whole read (see set_text). */
     data->self = g_object_ref (self);
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
 
     gdk_clipboard_read_value_async (self->real,
                                     GDK_TYPE_RGBA,
                                     G_PRIORITY_DEFAULT,
-                                    NULL, /* cancellable */
+                                    cancellable,
                                     g_paste_clipboard_gdk_on_rgba_ready,
                                     data);
 }
@@ -394,6 +544,7 @@ typedef struct
 {
     GPasteClipboardGdk                   *self; /* ref'd for the duration of the read */
     GPasteSpecialAtom                     atom;
+    GCancellable                         *cancellable; /* the update's, if any */
     GPasteClipboardGdkSpecialAtomCallback callback;
     gpointer                              user_data;
 } GPasteClipboardGdkSpecialAtomData;
@@ -405,6 +556,7 @@ g_paste_clipboard_gdk_on_special_atom_bytes_ready (GObject      *source_object,
 {
     g_autofree GPasteClipboardGdkSpecialAtomData *data = user_data;
     g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in fetch_special_atom */
+    g_autoptr (GCancellable) cancellable = data->cancellable;
     g_autoptr (GError) error = NULL;
     g_autoptr (GBytes) bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source_object), res, &error);
 
@@ -429,6 +581,7 @@ g_paste_clipboard_gdk_on_special_atom_stream_ready (GObject      *source_object,
     g_autofree GPasteClipboardGdkSpecialAtomData *data = user_data;
     /* Released here unless the read below takes both it and @data over. */
     g_autoptr (GPasteClipboardGdk) self = data->self; /* ref taken in fetch_special_atom */
+    g_autoptr (GCancellable) cancellable = data->cancellable;
     g_autoptr (GError) error = NULL;
     const gchar *actual_mime = NULL;
     g_autoptr (GInputStream) stream = gdk_clipboard_read_finish (GDK_CLIPBOARD (source_object), res, &actual_mime, &error);
@@ -442,13 +595,14 @@ g_paste_clipboard_gdk_on_special_atom_stream_ready (GObject      *source_object,
         return;
     }
 
-    /* data->self keeps the ref for the second half of the read. */
+    /* data keeps its refs for the second half of the read. */
     g_steal_pointer (&self);
+    g_steal_pointer (&cancellable);
 
     g_input_stream_read_bytes_async (stream,
                                      G_MAXUINT,
                                      G_PRIORITY_DEFAULT,
-                                     NULL, /* cancellable */
+                                     data->cancellable,
                                      g_paste_clipboard_gdk_on_special_atom_bytes_ready,
                                      g_steal_pointer (&data));
 }
@@ -456,6 +610,7 @@ g_paste_clipboard_gdk_on_special_atom_stream_ready (GObject      *source_object,
 static void
 g_paste_clipboard_gdk_fetch_special_atom (GPasteClipboardGdk                   *self,
                                           GPasteSpecialAtom                     atom,
+                                          GCancellable                         *cancellable,
                                           GPasteClipboardGdkSpecialAtomCallback callback,
                                           gpointer                              user_data)
 {
@@ -464,6 +619,7 @@ g_paste_clipboard_gdk_fetch_special_atom (GPasteClipboardGdk                   *
     /* Ref for the whole read (see set_text), across both of its halves. */
     data->self = g_object_ref (self);
     data->atom = atom;
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
 
@@ -475,7 +631,7 @@ g_paste_clipboard_gdk_fetch_special_atom (GPasteClipboardGdk                   *
     gdk_clipboard_read_async (self->real,
                               mime_types,
                               G_PRIORITY_DEFAULT,
-                              NULL, /* cancellable */
+                              cancellable,
                               g_paste_clipboard_gdk_on_special_atom_stream_ready,
                               data);
 }
@@ -483,13 +639,14 @@ g_paste_clipboard_gdk_fetch_special_atom (GPasteClipboardGdk                   *
 typedef struct
 {
     GPasteClipboardGdk                   *self; /* ref'd for the whole update */
+    GCancellable                         *cancellable; /* ref'd, if any */
     GPasteClipboardProviderUpdateCallback callback;
     gpointer                              user_data;
     gint                                  pending;
     GPasteClipboardContentKind            content_kind;
     union {
         const gchar   *text;
-        GdkTexture    *texture;
+        GPasteItem    *image; /* owned */
         GdkFileList   *file_list;
         const GdkRGBA *rgba;
     };
@@ -506,7 +663,7 @@ g_paste_clipboard_gdk_update_maybe_done (GPasteClipboardGdkUpdateData *data)
      * builder looks at exactly that one. */
     GPasteItem *item = g_paste_clipboard_content_to_item (data->content_kind,
                                                           (data->content_kind == CLIPBOARD_CONTENT_TEXT) ? data->text : NULL,
-                                                          (data->content_kind == CLIPBOARD_CONTENT_IMAGE) ? data->texture : NULL,
+                                                          (data->content_kind == CLIPBOARD_CONTENT_IMAGE) ? data->image : NULL,
                                                           (data->content_kind == CLIPBOARD_CONTENT_FILE_LIST) ? data->file_list : NULL,
                                                           (data->content_kind == CLIPBOARD_CONTENT_COLOR) ? data->rgba : NULL,
                                                           data->special_atom);
@@ -516,6 +673,9 @@ g_paste_clipboard_gdk_update_maybe_done (GPasteClipboardGdkUpdateData *data)
 
     for (GPasteSpecialAtom atom = G_PASTE_SPECIAL_ATOM_FIRST; atom < G_PASTE_SPECIAL_ATOM_LAST; ++atom)
         g_clear_object (&data->special_atom[atom]);
+    if (data->content_kind == CLIPBOARD_CONTENT_IMAGE)
+        g_clear_object (&data->image);
+    g_clear_object (&data->cancellable);
     g_object_unref (data->self); /* ref taken in update */
     g_free (data);
 }
@@ -548,7 +708,9 @@ g_paste_clipboard_gdk_update_on_file_list_ready (GObject      *source_object,
         return;
     }
 
-    if (g_paste_clipboard_file_list_equal (g_paste_clipboard_content_get_file_list (&self->content), file_list))
+    /* Superseded: leave the cache alone (see on_text). */
+    if (g_cancellable_is_cancelled (data->cancellable) ||
+        g_paste_clipboard_file_list_equal (g_paste_clipboard_content_get_file_list (&self->content), file_list))
     {
         g_paste_clipboard_gdk_update_maybe_done (data);
         return;
@@ -567,7 +729,7 @@ g_paste_clipboard_gdk_fetch_file_list (GPasteClipboardGdk           *self,
     gdk_clipboard_read_value_async (self->real,
                                     GDK_TYPE_FILE_LIST,
                                     G_PRIORITY_DEFAULT,
-                                    NULL, /* cancellable */
+                                    data->cancellable,
                                     g_paste_clipboard_gdk_update_on_file_list_ready,
                                     data);
 }
@@ -584,11 +746,11 @@ g_paste_clipboard_gdk_update_on_text_ready (GPasteClipboardGdk *self G_GNUC_UNUS
 
 static void
 g_paste_clipboard_gdk_update_on_texture_ready (GPasteClipboardGdk *self G_GNUC_UNUSED,
-                                               GdkTexture         *texture,
+                                               GPasteItem         *image,
                                                gpointer            user_data)
 {
     GPasteClipboardGdkUpdateData *data = user_data;
-    data->texture = texture;
+    data->image = image; /* transfer full */
     g_paste_clipboard_gdk_update_maybe_done (data);
 }
 
@@ -618,11 +780,15 @@ g_paste_clipboard_gdk_update_on_special_atom_ready (GPasteClipboardGdk *self G_G
 
 static void
 g_paste_clipboard_gdk_update (GPasteClipboardGdk                   *self,
+                              GCancellable                         *cancellable,
                               GPasteClipboardProviderUpdateCallback callback,
                               gpointer                              user_data)
 {
     GdkContentFormats *formats = gdk_clipboard_get_formats (self->real);
     GPasteClipboardContentKind content_kind = CLIPBOARD_CONTENT_NONE;
+
+    ++self->serial;
+
     if (gdk_content_formats_contain_gtype (formats, GDK_TYPE_FILE_LIST))
         content_kind = CLIPBOARD_CONTENT_FILE_LIST;
     else if (gdk_content_formats_contain_gtype (formats, GDK_TYPE_RGBA))
@@ -658,6 +824,7 @@ g_paste_clipboard_gdk_update (GPasteClipboardGdk                   *self,
     /* Hold a ref for the whole update (the content read plus every special-value
      * read), released when data is freed in update_maybe_done. */
     data->self = g_object_ref (self);
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
     data->pending = 1;
@@ -682,13 +849,13 @@ g_paste_clipboard_gdk_update (GPasteClipboardGdk                   *self,
         g_paste_clipboard_gdk_fetch_file_list (self, data);
         break;
     case CLIPBOARD_CONTENT_COLOR:
-        g_paste_clipboard_gdk_set_color (self, g_paste_clipboard_gdk_update_on_color_ready, data);
+        g_paste_clipboard_gdk_set_color (self, cancellable, g_paste_clipboard_gdk_update_on_color_ready, data);
         break;
     case CLIPBOARD_CONTENT_TEXT:
-        g_paste_clipboard_gdk_set_text (self, g_paste_clipboard_gdk_update_on_text_ready, data);
+        g_paste_clipboard_gdk_set_text (self, cancellable, g_paste_clipboard_gdk_update_on_text_ready, data);
         break;
     case CLIPBOARD_CONTENT_IMAGE:
-        g_paste_clipboard_gdk_set_texture (self, g_paste_clipboard_gdk_update_on_texture_ready, data);
+        g_paste_clipboard_gdk_set_texture (self, cancellable, g_paste_clipboard_gdk_update_on_texture_ready, data);
         break;
     case CLIPBOARD_CONTENT_IGNORED:
     case CLIPBOARD_CONTENT_NONE:
@@ -700,7 +867,7 @@ g_paste_clipboard_gdk_update (GPasteClipboardGdk                   *self,
         if (atom_available[atom])
         {
             ++data->pending;
-            g_paste_clipboard_gdk_fetch_special_atom (self, atom, g_paste_clipboard_gdk_update_on_special_atom_ready, data);
+            g_paste_clipboard_gdk_fetch_special_atom (self, atom, cancellable, g_paste_clipboard_gdk_update_on_special_atom_ready, data);
         }
     }
 
@@ -713,6 +880,8 @@ g_paste_clipboard_gdk_select_item (GPasteClipboardGdk *self,
 {
     g_debug ("%s: select item", g_paste_clipboard_provider_target_name (self->is_clipboard));
 
+    ++self->serial;
+
     if (G_PASTE_IS_IMAGE_ITEM (item))
     {
         GdkTexture *texture = g_paste_image_item_get_image (G_PASTE_IMAGE_ITEM (item));
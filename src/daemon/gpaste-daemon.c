@@ -9,10 +9,15 @@
 
 #include <gpaste-daemon/gpaste-bus.h>
 #include <gpaste-daemon/gpaste-daemon.h>
+#include <gpaste-daemon/gpaste-handover.h>
 #include <gpaste-daemon/gpaste-search-provider.h>
 #include <gpaste-daemon/gpaste-storage-backend.h>
 #include <gpaste-daemon/gpaste-storage-migration.h>
 
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+#include <gpaste-daemon/gpaste-secret-stream-converter.h>
+#endif
+
 #include <errno.h>
 #include <unistd.h>
 
@@ -57,6 +62,19 @@ typedef struct
      * the first is rewriting, then build a second daemon over the first. The
      * gnome-shell host gates the same window with _settleStorage(). */
     gboolean         settling;
+
+    /* What the daemon we were re-executed from handed over (see hand_over),
+     * until the name is ours and take_over() makes sense of it, and then the
+     * history it held, for the daemon we build to start from. */
+    GVariant        *handover;
+    GVariant        *history_state;
+
+    /* When main() was entered, and when the name was acquired and the storage
+     * settled: the phases of startup that run before there is a daemon to
+     * record them in (see on_storage_ready). */
+    gint64           started;
+    gint64           name_acquired;
+    gint64           storage_ready;
 } DaemonContext;
 
 /* Persist the history synchronously and release the storage lock so a successor
@@ -70,10 +88,101 @@ flush_and_unlock (DaemonContext *ctx)
     g_paste_storage_backend_unlock ();
 }
 
+/* Hand what we hold in memory over to the process we are about to exec: the
+ * history, so it does not read it all back, and for an encrypted store the
+ * passphrase and the keys derived from it, so it neither prompts for it nor
+ * runs Argon2id again. Returns the descriptor to cancel the handover with, or
+ * -1 when there is none. */
+static gint
+hand_over (DaemonContext *ctx,
+           GPasteDaemon  *g_paste_daemon)
+{
+    g_auto (GVariantDict) state = G_VARIANT_DICT_INIT (NULL);
+    g_autoptr (GVariant) history = (g_paste_daemon) ? g_paste_daemon_export_state (g_paste_daemon) : NULL;
+
+    g_variant_dict_insert (&state, "version", "u", G_PASTE_HANDOVER_VERSION);
+    g_variant_dict_insert (&state, "storage", "s", g_paste_storage_get_extension (g_paste_settings_get_storage_backend (ctx->settings)));
+
+    if (history)
+        g_variant_dict_insert_value (&state, "history", history);
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    const gchar *passphrase = g_paste_storage_backend_get_passphrase ();
+
+    if (passphrase)
+    {
+        g_autoptr (GVariant) keys = g_paste_secret_stream_converter_export_keys (passphrase);
+
+        g_variant_dict_insert (&state, "passphrase", "s", passphrase);
+        if (keys)
+            g_variant_dict_insert_value (&state, "keys", keys);
+    }
+#endif
+
+    g_autoptr (GVariant) packed = g_variant_ref_sink (g_variant_dict_end (&state));
+    g_autoptr (GError) error = NULL;
+    gint fd = g_paste_handover_send (packed, &error);
+
+    /* The successor simply loads everything itself. */
+    if (fd < 0)
+        g_warning ("Could not hand the daemon state over: %s", error->message);
+
+    return fd;
+}
+
+/* Make sense of what the daemon we were re-executed from handed over, now that
+ * the store is ours: take its passphrase when the store still takes it, and
+ * keep its history for on_storage_ready(). A state from another version or for
+ * another store is dropped whole, and we load as if there had been none. */
+static void
+take_over (DaemonContext *ctx)
+{
+    g_autoptr (GVariant) state = g_steal_pointer (&ctx->handover);
+    GPasteStorage storage = g_paste_settings_get_storage_backend (ctx->settings);
+    const gchar *extension;
+    guint32 version;
+
+    if (!state)
+        return;
+
+    if (!g_variant_lookup (state, "version", "u", &version) || version != G_PASTE_HANDOVER_VERSION ||
+        !g_variant_lookup (state, "storage", "&s", &extension) || !g_paste_str_equal (extension, g_paste_storage_get_extension (storage)))
+    {
+        g_debug ("Ignoring a handover from another version or for another store");
+        return;
+    }
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    const gchar *passphrase;
+
+    if (g_variant_lookup (state, "passphrase", "&s", &passphrase))
+    {
+        g_autoptr (GVariant) keys = g_variant_lookup_value (state, "keys", G_VARIANT_TYPE ("a(ayttay)"));
+
+        if (keys)
+            g_paste_secret_stream_converter_import_keys (passphrase, keys);
+
+        /* Checked against the store all the same, as an unlock would: with the
+         * keys already in, that costs no derivation. */
+        if (!g_paste_storage_passphrase_can_decrypt (storage, ctx->settings, passphrase))
+        {
+            g_paste_secret_stream_converter_forget_keys ();
+            return;
+        }
+
+        g_paste_storage_backend_set_passphrase (passphrase);
+    }
+#endif
+
+    ctx->history_state = g_variant_lookup_value (state, "history", G_VARIANT_TYPE (G_PASTE_HANDOVER_HISTORY_TYPE));
+}
+
 static void
 reexec (GPasteDaemon *g_paste_daemon,
-        gpointer      user_data G_GNUC_UNUSED)
+        gpointer      user_data)
 {
+    DaemonContext *ctx = user_data;
+
     /* The clipboards manager was already stored by g_paste_daemon_reexecute();
      * make sure the history hits the disk too before we hand over to the new
      * process, which blocks on the storage lock until we release it. The lock is
@@ -82,6 +191,8 @@ reexec (GPasteDaemon *g_paste_daemon,
     if (g_paste_daemon)
         g_paste_daemon_flush (g_paste_daemon);
 
+    gint handover = hand_over (ctx, g_paste_daemon);
+
     /* execl replaces this process on success and only returns on failure, so do
      * NOT quit the application first: a failed exec (e.g. the binary is missing)
      * must leave the current daemon running rather than exit into no daemon.
@@ -97,6 +208,8 @@ reexec (GPasteDaemon *g_paste_daemon,
      * recording (g_paste_daemon_flush() stopped it above). */
     g_warning ("%s: %s", _("Failed to reexecute the daemon"), g_strerror (errno));
 
+    g_paste_handover_cancel (handover);
+
     if (g_paste_daemon)
         g_paste_daemon_resume (g_paste_daemon);
 }
@@ -120,8 +233,8 @@ usr1_handler (gpointer user_data)
 {
     DaemonContext *ctx = user_data;
 
-    /* reexec() takes the daemon to flush (NULL before it is built, which simply
-     * skips the flush) and ignores its second, signal-closure argument. */
+    /* reexec() takes the daemon to flush and hand over (NULL before it is
+     * built, which simply skips both) and the context, as the signal does. */
     reexec (ctx->daemon, ctx);
 
     /* Only reached when the exec failed and the daemon resumed: keep the
@@ -187,12 +300,28 @@ change_passphrase (GPasteDaemon *g_paste_daemon G_GNUC_UNUSED,
     g_source_set_name_by_id (g_idle_add (do_change_passphrase, ctx), "[GPaste] passphrase change");
 }
 
+/* Search results are the one thing we serve that nobody waits for at login, so
+ * the provider is exported once everything a copy needs had its turn. */
+static gboolean
+export_search_provider (gpointer user_data)
+{
+    DaemonContext *ctx = user_data;
+
+    ctx->search_provider = g_paste_search_provider_new ();
+    g_paste_bus_add_object (ctx->bus, ctx->search_provider);
+
+    g_paste_daemon_startup_phase (ctx->daemon, "search-provider", g_get_monotonic_time ());
+
+    return G_SOURCE_REMOVE;
+}
+
 /* Final step, once the name is owned, the backend choice is settled and any
  * encrypted history is unlocked: build the daemon and expose it on the bus. */
 static void
 on_storage_ready (DaemonContext *ctx)
 {
     ctx->settling = FALSE;
+    ctx->storage_ready = g_get_monotonic_time ();
 
     /* The GDK backend is ours alone — the gnome-shell-hosted daemon drives the
      * mutter one instead — so the providers are built right here rather than
@@ -200,17 +329,25 @@ on_storage_ready (DaemonContext *ctx)
     g_autoptr (GPasteClipboardProvider) clipboard = g_paste_clipboard_gdk_new_clipboard (ctx->settings);
     g_autoptr (GPasteClipboardProvider) primary = g_paste_clipboard_gdk_new_primary (ctx->settings);
 
-    ctx->daemon = g_paste_daemon_new (ctx->settings, clipboard, primary);
-    ctx->search_provider = g_paste_search_provider_new ();
+    ctx->daemon = g_paste_daemon_new_with_state (ctx->settings, clipboard, primary, ctx->history_state);
+    g_clear_pointer (&ctx->history_state, g_variant_unref);
+
+    g_paste_daemon_set_startup_origin (ctx->daemon, ctx->started);
+    g_paste_daemon_startup_phase (ctx->daemon, "name", ctx->name_acquired);
+    g_paste_daemon_startup_phase (ctx->daemon, "storage", ctx->storage_ready);
+    g_paste_daemon_startup_phase (ctx->daemon, "daemon", g_get_monotonic_time ());
 
     ctx->c_signals[C_REEXECUTE_SELF] = g_signal_connect (ctx->daemon, "reexecute-self",
                                                          G_CALLBACK (reexec), ctx);
     ctx->c_signals[C_CHANGE_PASSPHRASE] = g_signal_connect (ctx->daemon, "change-passphrase",
                                                             G_CALLBACK (change_passphrase), ctx);
 
-    /* The name is already owned, so the bus registers these immediately. */
+    /* The name is already owned, so the bus registers this immediately: from
+     * here on clients are served, while the history loads. */
     g_paste_bus_add_object (ctx->bus, G_PASTE_BUS_OBJECT (ctx->daemon));
-    g_paste_bus_add_object (ctx->bus, ctx->search_provider);
+    g_paste_daemon_startup_phase (ctx->daemon, "exported", g_get_monotonic_time ());
+
+    g_source_set_name_by_id (g_idle_add_full (G_PRIORITY_LOW, export_search_provider, ctx, NULL), "[GPaste] search provider export");
 
     g_paste_util_write_pid_file ("Daemon");
 }
@@ -272,15 +409,23 @@ on_name_acquired (GPasteBus *bus G_GNUC_UNUSED,
         return;
 
     ctx->settling = TRUE;
+    ctx->name_acquired = g_get_monotonic_time ();
 
     /* Get the history store ready (backend choice + encrypted-history unlock)
      * before the daemon starts persisting anything. libadwaita was initialised by
      * the application registration, so any dialog shows right away and is
-     * processed by the running main loop — no nested loop of our own. */
+     * processed by the running main loop — no nested loop of our own. A store
+     * about to be migrated is not the one a handover was made for. */
     if (g_paste_storage_migration_needed (ctx->settings))
+    {
+        g_clear_pointer (&ctx->handover, g_variant_unref);
         g_paste_storage_migration_async (ctx->prompt, ctx->settings, on_migration_done, ctx);
+    }
     else
+    {
+        take_over (ctx);
         start_decryption (ctx);
+    }
 }
 
 /* We may well own the name, but an object we cannot export is a daemon no client
@@ -349,10 +494,14 @@ extract_replace_arg (gint  *argc,
 gint
 main (gint argc, gchar *argv[])
 {
+    gint64 started = g_get_monotonic_time ();
+
     /* GTK doesn't support global clipboard events on wayland */
     gdk_set_allowed_backends ("x11");
 
     gboolean replace = extract_replace_arg (&argc, argv);
+    /* Taken first thing, so no child of ours inherits it. */
+    g_autoptr (GVariant) handover = g_paste_handover_receive ();
 
     G_PASTE_GTK_INIT_APPLICATION ("Daemon");
 
@@ -363,7 +512,7 @@ main (gint argc, gchar *argv[])
     /* The libadwaita prompt backend: how the storage layer reaches the user from
      * here. The gnome-shell-hosted daemon supplies its own instead. */
     g_autoptr (GPastePrompt) prompt = g_paste_prompt_adw_new (app);
-    DaemonContext ctx = { .gapp = gapp, .app = app, .prompt = prompt, .settings = settings };
+    DaemonContext ctx = { .gapp = gapp, .app = app, .prompt = prompt, .settings = settings, .handover = g_steal_pointer (&handover), .started = started };
 
 #ifdef G_OS_UNIX
     g_source_set_name_by_id (g_unix_signal_add (SIGTERM, signal_handler, &ctx), "[GPaste] SIGTERM listener");
@@ -407,6 +556,8 @@ main (gint argc, gchar *argv[])
     g_paste_storage_backend_set_passphrase (NULL);
 #endif
 
+    g_clear_pointer (&ctx.handover, g_variant_unref);
+    g_clear_pointer (&ctx.history_state, g_variant_unref);
     g_clear_object (&ctx.search_provider);
     g_clear_object (&ctx.daemon);
     g_clear_object (&ctx.bus);
@@ -16,6 +16,13 @@ struct _GPastePromptAdw
 
     /* Anchors the dialogs. Owned by main(), which outlives us. */
     GtkApplication *application;
+
+    /* The progress window while one is up: every update lands in the same
+     * one. Cleared when it goes, whether we took it down or the user did. */
+    GtkWidget      *progress_window;
+    GtkWidget      *progress_bar;
+    /* The user closed it: leave them be until the work is over. */
+    gboolean        progress_dismissed;
 };
 
 static void g_paste_prompt_adw_prompt_iface_init (GPastePromptInterface *iface);
@@ -690,12 +697,95 @@ g_paste_prompt_adw_report (GPastePrompt *prompt,
     gtk_window_present (GTK_WINDOW (window));
 }
 
+/*
+ * The progress
+ */
+
+static gboolean
+on_progress_close_request (GtkWindow *window G_GNUC_UNUSED,
+                           gpointer   user_data)
+{
+    GPastePromptAdw *self = user_data;
+
+    self->progress_dismissed = TRUE;
+
+    return GDK_EVENT_PROPAGATE;
+}
+
+static void
+on_progress_window_destroy (GtkWidget *window G_GNUC_UNUSED,
+                            gpointer   user_data)
+{
+    GPastePromptAdw *self = user_data;
+
+    self->progress_window = NULL;
+    self->progress_bar = NULL;
+}
+
+/* Not modal, and closing it stops nothing: it only says how the work goes,
+ * which carries on whether anyone watches. Once closed it stays closed until
+ * the next piece of work, rather than popping back up at the next update. */
+static void
+g_paste_prompt_adw_progress (GPastePrompt *prompt,
+                             const gchar  *title,
+                             gdouble       fraction,
+                             const gchar  *status)
+{
+    GPastePromptAdw *self = G_PASTE_PROMPT_ADW (prompt);
+
+    if (fraction >= 1)
+    {
+        if (self->progress_window)
+            gtk_window_destroy (GTK_WINDOW (self->progress_window));
+        self->progress_dismissed = FALSE;
+        return;
+    }
+
+    if (!self->progress_window)
+    {
+        if (self->progress_dismissed)
+            return;
+
+        GtkWidget *window = adw_application_window_new (self->application);
+
+        gtk_window_set_title (GTK_WINDOW (window), title);
+        gtk_window_set_icon_name (GTK_WINDOW (window), G_PASTE_ICON_NAME);
+        gtk_window_set_default_size (GTK_WINDOW (window), 420, -1);
+
+        GtkWidget *bar = gtk_progress_bar_new ();
+
+        gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (bar), TRUE);
+        gtk_widget_set_margin_top (bar, 24);
+        gtk_widget_set_margin_bottom (bar, 24);
+        gtk_widget_set_margin_start (bar, 24);
+        gtk_widget_set_margin_end (bar, 24);
+
+        GtkWidget *toolbar = adw_toolbar_view_new ();
+
+        adw_toolbar_view_add_top_bar (ADW_TOOLBAR_VIEW (toolbar), adw_header_bar_new ());
+        adw_toolbar_view_set_content (ADW_TOOLBAR_VIEW (toolbar), bar);
+        adw_application_window_set_content (ADW_APPLICATION_WINDOW (window), toolbar);
+
+        g_signal_connect (window, "close-request", G_CALLBACK (on_progress_close_request), self);
+        g_signal_connect (window, "destroy", G_CALLBACK (on_progress_window_destroy), self);
+
+        self->progress_window = window;
+        self->progress_bar = bar;
+
+        gtk_window_present (GTK_WINDOW (window));
+    }
+
+    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (self->progress_bar), fraction);
+    gtk_progress_bar_set_text (GTK_PROGRESS_BAR (self->progress_bar), status);
+}
+
 static void
 g_paste_prompt_adw_prompt_iface_init (GPastePromptInterface *iface)
 {
     iface->passphrase = g_paste_prompt_adw_passphrase;
     iface->migration = g_paste_prompt_adw_migration;
     iface->report = g_paste_prompt_adw_report;
+    iface->progress = g_paste_prompt_adw_progress;
 }
 
 static void
@@ -398,6 +398,33 @@ class GPasteReportDialog extends ModalDialog.ModalDialog {
     }
 });
 
+// Closing it stops nothing: it only says how the work goes, which carries on
+// whether anyone watches.
+const ProgressDialog = GObject.registerClass(
+class GPasteProgressDialog extends ModalDialog.ModalDialog {
+    constructor(title) {
+        super({styleClass: 'prompt-dialog'});
+
+        this._content = new Dialog.MessageDialogContent({title});
+        this._level = new BarLevel.BarLevel({x_expand: true});
+
+        this.contentLayout.add_child(this._content);
+        this.contentLayout.add_child(this._level);
+
+        this.addButton({
+            label: GPasteDaemon.prompt_text(GPasteDaemon.PromptText.CLOSE),
+            action: () => this.close(),
+            key: Clutter.KEY_Escape,
+            default: true,
+        });
+    }
+
+    update(fraction, status) {
+        this._level.value = fraction;
+        this._content.description = status ?? '';
+    }
+});
+
 // ModalDialog.open() fails when it cannot take the modal grab (another system
 // modal already holds one). A dialog that never opened also never closes, so
 // nothing would ever answer the request — and the storage never settles, which
@@ -422,6 +449,11 @@ export const GPasteShellPrompt = GObject.registerClass({
 
         this._open = new Set();
         this._shutDown = false;
+        // The progress dialog while one is up, and whether the user closed it:
+        // every update lands in the same one, and a closed one stays closed
+        // until the work is over rather than popping back up.
+        this._progress = null;
+        this._progressDismissed = false;
     }
 
     _show(dialog, request) {
@@ -485,4 +517,47 @@ export const GPasteShellPrompt = GObject.registerClass({
         console.error(`GPaste: ${title}: ${message}`);
         dialog.destroy();
     }
+
+    // Only ever informative, so a dialog that cannot be shown leaves nothing
+    // behind but a debug line.
+    vfunc_progress(title, fraction, status) {
+        if (fraction >= 1) {
+            // Detached first, so its 'closed' does not read as the user's.
+            const dialog = this._progress;
+
+            this._progress = null;
+            this._progressDismissed = false;
+            dialog?.close();
+            return;
+        }
+
+        if (this._shutDown || this._progressDismissed)
+            return;
+
+        if (!this._progress) {
+            const dialog = new ProgressDialog(title);
+
+            this._open.add(dialog);
+            dialog.connect('closed', () => {
+                if (this._progress === dialog)
+                    this._progressDismissed = true;
+            });
+            dialog.connect('destroy', () => {
+                this._open.delete(dialog);
+                if (this._progress === dialog)
+                    this._progress = null;
+            });
+
+            if (!dialog.open()) {
+                console.debug(`GPaste: ${title}: ${status}`);
+                dialog.destroy();
+                this._progressDismissed = true;
+                return;
+            }
+
+            this._progress = dialog;
+        }
+
+        this._progress.update(fraction, status);
+    }
 });
@@ -4,6 +4,8 @@
 #include <gpaste-3/gpaste-client-item.h>
 #include <gpaste-3/gpaste-util.h>
 
+#include <string.h>
+
 struct _GPasteClientItem
 {
     GObject parent_instance;
@@ -12,6 +14,7 @@ struct _GPasteClientItem
     gchar         *value;
     GPasteItemKind kind;
     gboolean       favourite;
+    guint64        length;
 
     /* Composed on demand from @kind and @value, then kept: a row is redrawn far
      * more often than an item is built. */
@@ -38,7 +41,9 @@ g_paste_client_item_get_uuid (GPasteClientItem *self)
  * g_paste_client_item_get_value:
  * @self: a #GPasteClientItem instance
  *
- * Returns the value of the item
+ * Returns the value of the item: as much of it as the daemon lists items
+ * with, which is the whole of it unless g_paste_client_item_is_truncated()
+ * says otherwise. g_paste_client_get_value() is where the rest is.
  */
 G_PASTE_VISIBLE const gchar *
 g_paste_client_item_get_value (GPasteClientItem *self)
@@ -54,7 +59,8 @@ g_paste_client_item_get_value (GPasteClientItem *self)
  *
  * Get the string to draw for this item: its value, with the decoration its kind
  * calls for around it, as g_paste_util_display_string () composes it. Kept once
- * composed, since a row is redrawn far more often than an item is built.
+ * composed, since a row is redrawn far more often than an item is built. Ends
+ * with an ellipsis when the item holds only the start of its value.
  *
  * Returns: read-only display string, owned by the item
  */
@@ -64,7 +70,13 @@ g_paste_client_item_get_display_string (GPasteClientItem *self)
     g_return_val_if_fail (G_PASTE_IS_CLIENT_ITEM (self), NULL);
 
     if (!self->display_string)
-        self->display_string = g_paste_util_display_string (self->value, self->kind);
+    {
+        g_autofree gchar *display_string = g_paste_util_display_string (self->value, self->kind);
+
+        /* Where the daemon cut the value, so that a client showing rows in
+         * full still shows there is more. */
+        self->display_string = (g_paste_client_item_is_truncated (self)) ? g_strconcat (display_string, "…", NULL) : g_steal_pointer (&display_string);
+    }
 
     return self->display_string;
 }
@@ -98,6 +110,36 @@ g_paste_client_item_is_favourite (GPasteClientItem *self)
     return self->favourite;
 }
 
+/**
+ * g_paste_client_item_get_length:
+ * @self: a #GPasteClientItem instance
+ *
+ * Returns the length of the whole value of the item, in bytes, however much
+ * of it the item holds
+ */
+G_PASTE_VISIBLE guint64
+g_paste_client_item_get_length (GPasteClientItem *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIENT_ITEM (self), 0);
+
+    return self->length;
+}
+
+/**
+ * g_paste_client_item_is_truncated:
+ * @self: a #GPasteClientItem instance
+ *
+ * Returns whether the item only holds the start of its value, the daemon
+ * listing long items with no more than a row can show
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_client_item_is_truncated (GPasteClientItem *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIENT_ITEM (self), FALSE);
+
+    return self->length > strlen (self->value);
+}
+
 static void
 g_paste_client_item_finalize (GObject *object)
 {
@@ -127,6 +169,7 @@ g_paste_client_item_init (GPasteClientItem *self G_GNUC_UNUSED)
  * @value: the value of the item
  * @kind: the kind of the item
  * @favourite: whether the item is pinned
+ * @length: the length of the whole value, @value being possibly only its start
  *
  * Create a new instance of #GPasteClientItem
  *
@@ -137,7 +180,8 @@ G_PASTE_VISIBLE GPasteClientItem *
 g_paste_client_item_new (const gchar   *uuid,
                          const gchar   *value,
                          GPasteItemKind kind,
-                         gboolean       favourite)
+                         gboolean       favourite,
+                         guint64        length)
 {
     g_return_val_if_fail (g_uuid_string_is_valid (uuid), NULL);
     g_return_val_if_fail (g_utf8_validate (value, -1, NULL), NULL);
@@ -148,6 +192,7 @@ g_paste_client_item_new (const gchar   *uuid,
     self->value = g_strdup (value);
     self->kind = kind;
     self->favourite = favourite;
+    self->length = length;
 
     return self;
 }
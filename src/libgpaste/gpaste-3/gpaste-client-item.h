@@ -12,16 +12,20 @@
 
 G_BEGIN_DECLS
 
-/* How an item travels: uuid, value, kind, favourite. Declared in
+/* How an item travels: uuid, value, kind, favourite, length. Declared in
  * data/dbus/org.gnome.GPaste3.xml, which is the contract; these are the same
  * thing spelled for the C that builds and reads it, so that the daemon's
  * builder and the client's parser cannot come to disagree. */
-#define G_PASTE_ITEM_VARIANT_STRING  "(ssub)"
+#define G_PASTE_ITEM_VARIANT_STRING  "(ssubt)"
 #define G_PASTE_ITEMS_VARIANT_STRING "a" G_PASTE_ITEM_VARIANT_STRING
 
 #define G_PASTE_ITEM_VARIANT_TYPE  G_VARIANT_TYPE (G_PASTE_ITEM_VARIANT_STRING)
 #define G_PASTE_ITEMS_VARIANT_TYPE G_VARIANT_TYPE (G_PASTE_ITEMS_VARIANT_STRING)
 
+/* A match across every history: the history it is in, the item, its score. */
+#define G_PASTE_SEARCH_HITS_VARIANT_STRING "a(s" G_PASTE_ITEM_VARIANT_STRING "d)"
+#define G_PASTE_SEARCH_HITS_VARIANT_TYPE   G_VARIANT_TYPE (G_PASTE_SEARCH_HITS_VARIANT_STRING)
+
 #define G_PASTE_TYPE_CLIENT_ITEM (g_paste_client_item_get_type ())
 
 G_PASTE_FINAL_TYPE (ClientItem, client_item, CLIENT_ITEM, GObject)
@@ -31,10 +35,13 @@ const gchar   *g_paste_client_item_get_value          (GPasteClientItem *self);
 const gchar   *g_paste_client_item_get_display_string (GPasteClientItem *self);
 GPasteItemKind g_paste_client_item_get_kind           (GPasteClientItem *self);
 gboolean       g_paste_client_item_is_favourite       (GPasteClientItem *self);
+guint64        g_paste_client_item_get_length         (GPasteClientItem *self);
+gboolean       g_paste_client_item_is_truncated       (GPasteClientItem *self);
 
 GPasteClientItem *g_paste_client_item_new (const gchar   *uuid,
                                            const gchar   *value,
                                            GPasteItemKind kind,
-                                           gboolean       favourite);
+                                           gboolean       favourite,
+                                           guint64        length);
 
 G_END_DECLS
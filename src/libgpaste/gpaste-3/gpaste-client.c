@@ -42,6 +42,9 @@ enum
 {
     PROP_ACTIVE = 1,
     PROP_HISTORY,
+    PROP_MAINTENANCE,
+    PROP_STARTUP_TIMINGS,
+    PROP_SWITCH_STATS,
     PROP_VERSION,
 };
 
@@ -870,6 +873,42 @@ G_PASTE_CLIENT_METHOD_RET (get_uris,
                            g_auto (GStrv) uris = NULL, &uris, g_steal_pointer (&uris),
                            (const gchar *uuid), (uuid))
 
+/**
+ * g_paste_client_get_value_sync:
+ * @self: a #GPasteClient instance
+ * @uuid: the uuid of the item we want the value of
+ * @error: return location for a #GError, or %NULL
+ *
+ * Get the whole value of an item from the #GPasteDaemon, which items are only
+ * listed with the start of when it is long
+ *
+ * Returns: (transfer full): a newly allocated string
+ */
+/**
+ * g_paste_client_get_value:
+ * @self: a #GPasteClient instance
+ * @uuid: the uuid of the item we want the value of
+ * @callback: (nullable): A #GAsyncReadyCallback to call when the request is satisfied or %NULL if you don't
+ * care about the result of the method invocation.
+ * @user_data: (nullable): The data to pass to @callback.
+ *
+ * Get the whole value of an item from the #GPasteDaemon
+ */
+/**
+ * g_paste_client_get_value_finish:
+ * @self: a #GPasteClient instance
+ * @result: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to the async call.
+ * @error: return location for a #GError, or %NULL
+ *
+ * Get the whole value of an item from the #GPasteDaemon
+ *
+ * Returns: (transfer full): a newly allocated string
+ */
+G_PASTE_CLIENT_METHOD_RET (get_value,
+                           gchar *, NULL,
+                           g_autofree gchar *value = NULL, &value, g_steal_pointer (&value),
+                           (const gchar *uuid), (uuid))
+
 /**
  * g_paste_client_list_histories_sync:
  * @self: a #GPasteClient instance
@@ -1397,6 +1436,67 @@ g_paste_client_get_history_name (GPasteClient *self)
     return (history) ? g_variant_dup_string (history, NULL) : NULL;
 }
 
+/**
+ * g_paste_client_get_maintenance:
+ * @self: a #GPasteClient instance
+ *
+ * Get what the last idle-time maintenance of the daemon's storage did: an
+ * "a{st}" holding when it finished, how long it took, how many histories it
+ * went through, how many bytes it reclaimed, how many leftover files it removed
+ * and whether it got through everything; empty until the first run.
+ *
+ * Returns: (transfer full) (nullable): the report, or %NULL when the daemon
+ *          does not report it
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_client_get_maintenance (GPasteClient *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIENT (self), NULL);
+
+    return g_dbus_proxy_get_cached_property (G_DBUS_PROXY (self), G_PASTE_DAEMON_PROP_MAINTENANCE);
+}
+
+/**
+ * g_paste_client_get_startup_timings:
+ * @self: a #GPasteClient instance
+ *
+ * Get how long each phase of the daemon startup took to be reached: an
+ * "a{st}" mapping the name of each phase reached so far to the microseconds
+ * since the daemon started.
+ *
+ * Returns: (transfer full) (nullable): the timings, or %NULL when the daemon
+ *          does not report them
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_client_get_startup_timings (GPasteClient *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIENT (self), NULL);
+
+    /* Same as g_paste_client_is_active(): the cached property, not the
+     * interface's own getter. */
+    return g_dbus_proxy_get_cached_property (G_DBUS_PROXY (self), G_PASTE_DAEMON_PROP_STARTUP_TIMINGS);
+}
+
+/**
+ * g_paste_client_get_switch_stats:
+ * @self: a #GPasteClient instance
+ *
+ * Get how the daemon's switches between histories went since it started: an
+ * "a{st}" holding how many switches there were, how many needed no read, how
+ * many histories were read ahead of a switch and how many switches one of
+ * those served.
+ *
+ * Returns: (transfer full) (nullable): the counters, or %NULL when the daemon
+ *          does not report them
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_client_get_switch_stats (GPasteClient *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIENT (self), NULL);
+
+    return g_dbus_proxy_get_cached_property (G_DBUS_PROXY (self), G_PASTE_DAEMON_PROP_SWITCH_STATS);
+}
+
 /**
  * g_paste_client_get_version:
  * @self: a #GPasteClient instance
@@ -1442,6 +1542,15 @@ g_paste_client_get_property (GObject    *object,
     case PROP_HISTORY:
         g_value_take_string (value, g_paste_client_get_history_name (self));
         break;
+    case PROP_MAINTENANCE:
+        g_value_take_variant (value, g_paste_client_get_maintenance (self));
+        break;
+    case PROP_STARTUP_TIMINGS:
+        g_value_take_variant (value, g_paste_client_get_startup_timings (self));
+        break;
+    case PROP_SWITCH_STATS:
+        g_value_take_variant (value, g_paste_client_get_switch_stats (self));
+        break;
     case PROP_VERSION:
         g_value_take_string (value, g_paste_client_get_version (self));
         break;
@@ -1464,6 +1573,9 @@ g_paste_client_set_property (GObject      *object,
     {
     case PROP_ACTIVE:
     case PROP_HISTORY:
+    case PROP_MAINTENANCE:
+    case PROP_STARTUP_TIMINGS:
+    case PROP_SWITCH_STATS:
     case PROP_VERSION:
         g_warning ("GPasteClient:%s is owned by the daemon and cannot be set", pspec->name);
         break;
@@ -1552,6 +1664,15 @@ g_paste_client_g_properties_changed (GDBusProxy          *proxy,
     if (g_paste_client_property_moved (&dict, invalidated_properties, G_PASTE_DAEMON_PROP_HISTORY))
         g_object_notify (G_OBJECT (self), "history");
 
+    if (g_paste_client_property_moved (&dict, invalidated_properties, G_PASTE_DAEMON_PROP_MAINTENANCE))
+        g_object_notify (G_OBJECT (self), "maintenance");
+
+    if (g_paste_client_property_moved (&dict, invalidated_properties, G_PASTE_DAEMON_PROP_STARTUP_TIMINGS))
+        g_object_notify (G_OBJECT (self), "startup-timings");
+
+    if (g_paste_client_property_moved (&dict, invalidated_properties, G_PASTE_DAEMON_PROP_SWITCH_STATS))
+        g_object_notify (G_OBJECT (self), "switch-stats");
+
     if (g_paste_client_property_moved (&dict, invalidated_properties, G_PASTE_DAEMON_PROP_VERSION))
         g_object_notify (G_OBJECT (self), "version");
 
@@ -1582,6 +1703,9 @@ g_paste_client_notify (GObject    *object,
             g_object_notify (object, "active");
             g_signal_emit (self, signals[TRACKING], 0 /* detail */, g_paste_client_is_active (self));
             g_object_notify (object, "history");
+            g_object_notify (object, "maintenance");
+            g_object_notify (object, "startup-timings");
+            g_object_notify (object, "switch-stats");
             g_object_notify (object, "version");
         }
     }
@@ -1611,8 +1735,9 @@ g_paste_client_class_init (GPasteClientClass *klass)
     proxy_class->g_signal = g_paste_client_g_signal;
     proxy_class->g_properties_changed = g_paste_client_g_properties_changed;
 
-    /* Installs the interface's "Active", "History" and "Version" on us, in the
-     * PROP_* order declared above. */
+    /* Installs the interface's "Active", "History", "Maintenance",
+     * "StartupTimings", "SwitchStats" and "Version" on us, in the PROP_* order
+     * declared above. */
     g_paste_daemon3_override_properties (object_class, PROP_ACTIVE);
 
     /**
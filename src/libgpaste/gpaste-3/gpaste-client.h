@@ -69,6 +69,9 @@ GBytes  *g_paste_client_get_image_sync                  (GPasteClient  *self,
 GStrv    g_paste_client_get_uris_sync                   (GPasteClient  *self,
                                                          const gchar   *uuid,
                                                          GError       **error);
+gchar   *g_paste_client_get_value_sync                  (GPasteClient  *self,
+                                                         const gchar   *uuid,
+                                                         GError       **error);
 GStrv    g_paste_client_list_histories_sync             (GPasteClient  *self,
                                                          GError       **error);
 void     g_paste_client_merge_sync                      (GPasteClient  *self,
@@ -192,6 +195,10 @@ void g_paste_client_get_uris                   (GPasteClient       *self,
                                                 const gchar        *uuid,
                                                 GAsyncReadyCallback callback,
                                                 gpointer            user_data);
+void g_paste_client_get_value                  (GPasteClient       *self,
+                                                const gchar        *uuid,
+                                                GAsyncReadyCallback callback,
+                                                gpointer            user_data);
 void g_paste_client_list_histories             (GPasteClient       *self,
                                                 GAsyncReadyCallback callback,
                                                 gpointer            user_data);
@@ -307,6 +314,9 @@ GBytes  *g_paste_client_get_image_finish                  (GPasteClient *self,
 GStrv    g_paste_client_get_uris_finish                   (GPasteClient *self,
                                                            GAsyncResult *result,
                                                            GError      **error);
+gchar   *g_paste_client_get_value_finish                  (GPasteClient *self,
+                                                           GAsyncResult *result,
+                                                           GError      **error);
 GStrv    g_paste_client_list_histories_finish             (GPasteClient *self,
                                                            GAsyncResult *result,
                                                            GError      **error);
@@ -358,9 +368,12 @@ GPasteClientItem *g_paste_client_get_item_at_index_finish (GPasteClient *self,
 /* Properties */
 /**************/
 
-gboolean g_paste_client_is_active        (GPasteClient *self);
-gchar   *g_paste_client_get_history_name (GPasteClient *self);
-gchar   *g_paste_client_get_version      (GPasteClient *self);
+gboolean  g_paste_client_is_active            (GPasteClient *self);
+gchar    *g_paste_client_get_history_name     (GPasteClient *self);
+GVariant *g_paste_client_get_maintenance      (GPasteClient *self);
+GVariant *g_paste_client_get_startup_timings  (GPasteClient *self);
+GVariant *g_paste_client_get_switch_stats      (GPasteClient *self);
+gchar    *g_paste_client_get_version          (GPasteClient *self);
 
 /****************/
 /* Constructors */
@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <gpaste-3/gpaste-compression.h>
+
+G_PASTE_VISIBLE GType
+g_paste_compression_get_type (void)
+{
+    static GType etype = 0;
+    if (!etype)
+    {
+        static const GEnumValue values[] = {
+            { G_PASTE_COMPRESSION_NONE, "G_PASTE_COMPRESSION_NONE", "None" },
+            { G_PASTE_COMPRESSION_ZSTD, "G_PASTE_COMPRESSION_ZSTD", "Zstd" },
+            { 0,                         NULL,                       NULL  }
+        };
+        etype = g_enum_register_static (g_intern_static_string ("GPasteCompression"), values);
+        g_type_class_ref (etype);
+    }
+    return etype;
+}
@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#if !defined (__G_PASTE_H_INSIDE__) && !defined (G_PASTE_COMPILATION)
+#error "Only <gpaste.h> can be included directly."
+#endif
+
+#pragma once
+
+#include <gpaste-3/gpaste-macros.h>
+
+G_BEGIN_DECLS
+
+/* How the storage backends compress what they store of an item: the values of
+ * the "storage-compression" setting (g_paste_settings_get_storage_compression()).
+ * The same values tag every stored payload with what it was compressed with, so
+ * a history written under one setting reads back under any other. */
+typedef enum {
+    G_PASTE_COMPRESSION_NONE,
+    G_PASTE_COMPRESSION_ZSTD,
+    G_PASTE_N_COMPRESSION /* must stay last */
+} GPasteCompression;
+
+#define G_PASTE_TYPE_COMPRESSION (g_paste_compression_get_type ())
+GType g_paste_compression_get_type (void);
+
+G_END_DECLS
@@ -35,9 +35,12 @@ G_BEGIN_DECLS
 #define G_PASTE_DAEMON_SIG_UPDATE            "Update"
 
 /* Read from the proxy's property cache, which is keyed by the wire name. */
-#define G_PASTE_DAEMON_PROP_ACTIVE  "Active"
-#define G_PASTE_DAEMON_PROP_HISTORY "History"
-#define G_PASTE_DAEMON_PROP_VERSION "Version"
+#define G_PASTE_DAEMON_PROP_ACTIVE          "Active"
+#define G_PASTE_DAEMON_PROP_HISTORY         "History"
+#define G_PASTE_DAEMON_PROP_MAINTENANCE     "Maintenance"
+#define G_PASTE_DAEMON_PROP_STARTUP_TIMINGS "StartupTimings"
+#define G_PASTE_DAEMON_PROP_SWITCH_STATS    "SwitchStats"
+#define G_PASTE_DAEMON_PROP_VERSION         "Version"
 
 #define G_PASTE_SEARCH_PROVIDER_OBJECT_PATH "/org/gnome/GPaste/SearchProvider"
 
@@ -16,11 +16,13 @@ G_BEGIN_DECLS
 #define G_PASTE_SHELL_SETTINGS_NAME "org.gnome.shell"
 
 #define G_PASTE_CLOSE_ON_SELECT_SETTING            "close-on-select"
+#define G_PASTE_COMPRESS_IDLE_ITEMS_SETTING        "compress-idle-items"
 #define G_PASTE_ELEMENT_SIZE_SETTING               "element-size"
 #define G_PASTE_EMPTY_HISTORY_CONFIRMATION_SETTING "empty-history-confirmation"
 #define G_PASTE_EXPERIMENTAL_META_DAEMON_SETTING   "experimental-meta-daemon"
 #define G_PASTE_GROWING_LINES_SETTING              "growing-lines"
 #define G_PASTE_HISTORY_NAME_SETTING               "history-name"
+#define G_PASTE_IMAGES_ENCODER_SETTING             "images-encoder"
 #define G_PASTE_IMAGES_PREVIEW_SETTING             "images-preview"
 #define G_PASTE_IMAGES_PREVIEW_SIZE_SETTING        "images-preview-size"
 #define G_PASTE_IMAGES_SUPPORT_SETTING             "images-support"
@@ -33,14 +35,19 @@ G_BEGIN_DECLS
 #define G_PASTE_OPEN_CENTERED_SETTING              "open-centered"
 #define G_PASTE_POP_SETTING                        "pop"
 #define G_PASTE_PRIMARY_TO_HISTORY_SETTING         "primary-to-history"
+#define G_PASTE_RECENT_HISTORIES_SETTING           "recent-histories"
+#define G_PASTE_RESIDENT_HISTORY_SIZE_SETTING      "resident-history-size"
 #define G_PASTE_RICH_TEXT_SUPPORT_SETTING          "rich-text-support"
 #define G_PASTE_SHOW_HISTORY_SETTING               "show-history"
+#define G_PASTE_SQLITE_SINGLE_DATABASE_SETTING     "sqlite-single-database"
 #define G_PASTE_STORAGE_BACKEND_SETTING            "storage-backend"
 #define G_PASTE_STORAGE_BACKEND_REVISION_SETTING   "storage-backend-revision"
+#define G_PASTE_STORAGE_COMPRESSION_SETTING        "storage-compression"
 #define G_PASTE_SYNC_CLIPBOARD_TO_PRIMARY_SETTING  "sync-clipboard-to-primary"
 #define G_PASTE_SYNC_PRIMARY_TO_CLIPBOARD_SETTING  "sync-primary-to-clipboard"
 #define G_PASTE_SYNCHRONIZE_CLIPBOARDS_SETTING     "synchronize-clipboards"
 #define G_PASTE_TRACK_CHANGES_SETTING              "track-changes"
+#define G_PASTE_TRACK_CHANGES_DELAY_SETTING        "track-changes-delay"
 #define G_PASTE_TRACK_EXTENSION_STATE_SETTING      "track-extension-state"
 #define G_PASTE_TRIM_ITEMS_SETTING                 "trim-items"
 #define G_PASTE_UPLOAD_SETTING                     "upload"
@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <gpaste-3/gpaste-image-encoder.h>
+
+G_PASTE_VISIBLE GType
+g_paste_image_encoder_get_type (void)
+{
+    static GType etype = 0;
+    if (!etype)
+    {
+        static const GEnumValue values[] = {
+            { G_PASTE_IMAGE_ENCODER_DEFAULT, "G_PASTE_IMAGE_ENCODER_DEFAULT", "Default" },
+            { G_PASTE_IMAGE_ENCODER_FAST,    "G_PASTE_IMAGE_ENCODER_FAST",    "Fast"    },
+            { G_PASTE_IMAGE_ENCODER_SMALL,   "G_PASTE_IMAGE_ENCODER_SMALL",   "Small"   },
+            { 0,                              NULL,                            NULL     }
+        };
+        etype = g_enum_register_static (g_intern_static_string ("GPasteImageEncoder"), values);
+        g_type_class_ref (etype);
+    }
+    return etype;
+}
@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#if !defined (__G_PASTE_H_INSIDE__) && !defined (G_PASTE_COMPILATION)
+#error "Only <gpaste.h> can be included directly."
+#endif
+
+#pragma once
+
+#include <gpaste-3/gpaste-macros.h>
+
+G_BEGIN_DECLS
+
+/* How a captured image is encoded before it is stored: the values of the
+ * "images-encoder" setting (g_paste_settings_get_images_encoder()). Every one of
+ * them produces a PNG -- what GetImage hands to D-Bus clients and what the file
+ * backend's cache files are named after -- they only trade encoding time for
+ * size on disk, so whatever an item was stored with, any GPaste reads it back. */
+typedef enum {
+    G_PASTE_IMAGE_ENCODER_DEFAULT, /* GDK's own PNG encoder */
+    G_PASTE_IMAGE_ENCODER_FAST,    /* light filtering, fastest deflate */
+    G_PASTE_IMAGE_ENCODER_SMALL,   /* adaptive filtering, strongest deflate */
+    G_PASTE_N_IMAGE_ENCODER        /* must stay last */
+} GPasteImageEncoder;
+
+#define G_PASTE_TYPE_IMAGE_ENCODER (g_paste_image_encoder_get_type ())
+GType g_paste_image_encoder_get_type (void);
+
+G_END_DECLS
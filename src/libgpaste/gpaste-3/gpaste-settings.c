@@ -18,12 +18,14 @@ struct _GPasteSettings
 
     gboolean      close_on_select;
     gboolean      open_centered;
+    gboolean      compress_idle_items;
     guint64       element_size;
     gboolean      empty_history_confirmation;
     gboolean      experimental_meta_daemon;
     gboolean      growing_lines;
     gchar        *history_name;
     gboolean      images_support;
+    GPasteImageEncoder images_encoder;
     gboolean      images_preview;
     guint64       images_preview_size;
     gchar        *launch_ui;
@@ -34,14 +36,19 @@ struct _GPasteSettings
     guint64       min_text_item_size;
     gchar        *pop;
     gboolean      primary_to_history;
+    guint64       recent_histories;
+    guint64       resident_history_size;
     gboolean      rich_text_support;
     gchar        *show_history;
+    gboolean      sqlite_single_database;
     GPasteStorage storage_backend;
     guint64       storage_backend_revision;
+    GPasteCompression storage_compression;
     gchar        *sync_clipboard_to_primary;
     gchar        *sync_primary_to_clipboard;
     gboolean      synchronize_clipboards;
     gboolean      track_changes;
+    guint64       track_changes_delay;
     gboolean      track_extension_state;
     gboolean      trim_items;
     gchar        *upload;
@@ -201,6 +208,23 @@ BOOLEAN_SETTING (empty_history_confirmation, EMPTY_HISTORY_CONFIRMATION)
  */
 BOOLEAN_SETTING (experimental_meta_daemon, EXPERIMENTAL_META_DAEMON)
 
+/**
+ * g_paste_settings_get_compress_idle_items:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "compress-idle-items" setting
+ *
+ * Returns: the value of the "compress-idle-items" setting
+ */
+/**
+ * g_paste_settings_set_compress_idle_items:
+ * @self: a #GPasteSettings instance
+ * @value: whether to hold the value of idle text items compressed in memory
+ *
+ * Change the "compress-idle-items" setting
+ */
+BOOLEAN_SETTING (compress_idle_items, COMPRESS_IDLE_ITEMS)
+
 /**
  * g_paste_settings_get_growing_lines:
  * @self: a #GPasteSettings instance
@@ -252,6 +276,23 @@ STRING_SETTING (history_name, HISTORY_NAME)
  */
 BOOLEAN_SETTING (images_support, IMAGES_SUPPORT)
 
+/**
+ * g_paste_settings_get_images_encoder:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "images-encoder" setting
+ *
+ * Returns: the value of the "images-encoder" setting
+ */
+/**
+ * g_paste_settings_set_images_encoder:
+ * @self: a #GPasteSettings instance
+ * @value: how to encode the images we store
+ *
+ * Change the "images-encoder" setting
+ */
+ENUM_SETTING (images_encoder, IMAGES_ENCODER, GPasteImageEncoder)
+
 /**
  * g_paste_settings_get_images_preview:
  * @self: a #GPasteSettings instance
@@ -422,6 +463,40 @@ STRING_SETTING (pop, POP)
  */
 BOOLEAN_SETTING (primary_to_history, PRIMARY_TO_HISTORY)
 
+/**
+ * g_paste_settings_get_recent_histories:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "recent-histories" setting
+ *
+ * Returns: the value of the "recent-histories" setting
+ */
+/**
+ * g_paste_settings_set_recent_histories:
+ * @self: a #GPasteSettings instance
+ * @value: how many histories switched away from to keep in memory
+ *
+ * Change the "recent-histories" setting
+ */
+UNSIGNED_SETTING (recent_histories, RECENT_HISTORIES)
+
+/**
+ * g_paste_settings_get_resident_history_size:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "resident-history-size" setting
+ *
+ * Returns: the value of the "resident-history-size" setting
+ */
+/**
+ * g_paste_settings_set_resident_history_size:
+ * @self: a #GPasteSettings instance
+ * @value: how many items the history keeps in memory, 0 for all of them
+ *
+ * Change the "resident-history-size" setting
+ */
+UNSIGNED_SETTING (resident_history_size, RESIDENT_HISTORY_SIZE)
+
 /**
  * g_paste_settings_get_rich_text_support:
  * @self: a #GPasteSettings instance
@@ -456,6 +531,23 @@ BOOLEAN_SETTING (rich_text_support, RICH_TEXT_SUPPORT)
  */
 STRING_SETTING (show_history, SHOW_HISTORY)
 
+/**
+ * g_paste_settings_get_sqlite_single_database:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "sqlite-single-database" setting
+ *
+ * Returns: the value of the "sqlite-single-database" setting
+ */
+/**
+ * g_paste_settings_set_sqlite_single_database:
+ * @self: a #GPasteSettings instance
+ * @value: whether every SQLite history lives in one database
+ *
+ * Change the "sqlite-single-database" setting
+ */
+BOOLEAN_SETTING (sqlite_single_database, SQLITE_SINGLE_DATABASE)
+
 /**
  * g_paste_settings_get_storage_backend:
  * @self: a #GPasteSettings instance
@@ -490,6 +582,23 @@ ENUM_SETTING (storage_backend, STORAGE_BACKEND, GPasteStorage)
  */
 UNSIGNED_SETTING (storage_backend_revision, STORAGE_BACKEND_REVISION)
 
+/**
+ * g_paste_settings_get_storage_compression:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "storage-compression" setting
+ *
+ * Returns: the value of the "storage-compression" setting
+ */
+/**
+ * g_paste_settings_set_storage_compression:
+ * @self: a #GPasteSettings instance
+ * @value: how to compress the items we store (a #GPasteCompression)
+ *
+ * Change the "storage-compression" setting
+ */
+ENUM_SETTING (storage_compression, STORAGE_COMPRESSION, GPasteCompression)
+
 /**
  * g_paste_settings_get_sync_clipboard_to_primary:
  * @self: a #GPasteSettings instance
@@ -558,6 +667,23 @@ BOOLEAN_SETTING (synchronize_clipboards, SYNCHRONIZE_CLIPBOARDS)
  */
 BOOLEAN_SETTING (track_changes, TRACK_CHANGES)
 
+/**
+ * g_paste_settings_get_track_changes_delay:
+ * @self: a #GPasteSettings instance
+ *
+ * Get the "track-changes-delay" setting
+ *
+ * Returns: the value of the "track-changes-delay" setting
+ */
+/**
+ * g_paste_settings_set_track_changes_delay:
+ * @self: a #GPasteSettings instance
+ * @value: how long to wait for a burst of clipboard changes to settle, in milliseconds
+ *
+ * Change the "track-changes-delay" setting
+ */
+UNSIGNED_SETTING (track_changes_delay, TRACK_CHANGES_DELAY)
+
 /**
  * g_paste_settings_get_track_extension_state:
  * @self: a #GPasteSettings instance
@@ -729,12 +855,14 @@ typedef struct
 static const GPasteSettingEntry setting_entries[] = {
     SETTING_ENTRY (CLOSE_ON_SELECT, close_on_select),
     SETTING_ENTRY (OPEN_CENTERED, open_centered),
+    SETTING_ENTRY (COMPRESS_IDLE_ITEMS, compress_idle_items),
     SETTING_ENTRY (ELEMENT_SIZE, element_size),
     SETTING_ENTRY (EMPTY_HISTORY_CONFIRMATION, empty_history_confirmation),
     SETTING_ENTRY (EXPERIMENTAL_META_DAEMON, experimental_meta_daemon),
     SETTING_ENTRY (GROWING_LINES, growing_lines),
     SETTING_ENTRY (HISTORY_NAME, history_name),
     SETTING_ENTRY (IMAGES_SUPPORT, images_support),
+    SETTING_ENTRY (IMAGES_ENCODER, images_encoder),
     SETTING_ENTRY (IMAGES_PREVIEW, images_preview),
     SETTING_ENTRY (IMAGES_PREVIEW_SIZE, images_preview_size),
     KEYBINDING_ENTRY (LAUNCH_UI, launch_ui),
@@ -745,14 +873,19 @@ static const GPasteSettingEntry setting_entries[] = {
     SETTING_ENTRY (MIN_TEXT_ITEM_SIZE, min_text_item_size),
     KEYBINDING_ENTRY (POP, pop),
     SETTING_ENTRY (PRIMARY_TO_HISTORY, primary_to_history),
+    SETTING_ENTRY (RECENT_HISTORIES, recent_histories),
+    SETTING_ENTRY (RESIDENT_HISTORY_SIZE, resident_history_size),
     SETTING_ENTRY (RICH_TEXT_SUPPORT, rich_text_support),
     KEYBINDING_ENTRY (SHOW_HISTORY, show_history),
+    SETTING_ENTRY (SQLITE_SINGLE_DATABASE, sqlite_single_database),
     SETTING_ENTRY (STORAGE_BACKEND, storage_backend),
     SETTING_ENTRY (STORAGE_BACKEND_REVISION, storage_backend_revision),
+    SETTING_ENTRY (STORAGE_COMPRESSION, storage_compression),
     KEYBINDING_ENTRY (SYNC_CLIPBOARD_TO_PRIMARY, sync_clipboard_to_primary),
     KEYBINDING_ENTRY (SYNC_PRIMARY_TO_CLIPBOARD, sync_primary_to_clipboard),
     SETTING_ENTRY (SYNCHRONIZE_CLIPBOARDS, synchronize_clipboards),
     SETTING_ENTRY (TRACK_CHANGES, track_changes),
+    SETTING_ENTRY (TRACK_CHANGES_DELAY, track_changes_delay),
     SETTING_ENTRY (TRACK_EXTENSION_STATE, track_extension_state),
     SETTING_ENTRY (TRIM_ITEMS, trim_items),
     KEYBINDING_ENTRY (UPLOAD, upload),
@@ -796,12 +929,14 @@ g_paste_settings_settings_changed (GSettings   *settings G_GNUC_UNUSED,
 #define G_PASTE_SETTINGS_FOR_EACH_PROP(BOOL, UINT, STR, ENUM)                             \
     BOOL (close_on_select,            CLOSE_ON_SELECT)                                    \
     BOOL (open_centered,              OPEN_CENTERED)                                      \
+    BOOL (compress_idle_items,        COMPRESS_IDLE_ITEMS)                                \
     UINT (element_size,               ELEMENT_SIZE)                                       \
     BOOL (empty_history_confirmation, EMPTY_HISTORY_CONFIRMATION)                         \
     BOOL (experimental_meta_daemon,   EXPERIMENTAL_META_DAEMON)                           \
     BOOL (growing_lines,              GROWING_LINES)                                      \
     STR  (history_name,               HISTORY_NAME)                                       \
     BOOL (images_support,             IMAGES_SUPPORT)                                     \
+    ENUM (images_encoder,             IMAGES_ENCODER,         G_PASTE_TYPE_IMAGE_ENCODER) \
     BOOL (images_preview,             IMAGES_PREVIEW)                                     \
     UINT (images_preview_size,        IMAGES_PREVIEW_SIZE)                                \
     STR  (launch_ui,                  LAUNCH_UI)                                          \
@@ -812,14 +947,19 @@ g_paste_settings_settings_changed (GSettings   *settings G_GNUC_UNUSED,
     UINT (min_text_item_size,         MIN_TEXT_ITEM_SIZE)                                 \
     STR  (pop,                        POP)                                                \
     BOOL (primary_to_history,         PRIMARY_TO_HISTORY)                                 \
+    UINT (recent_histories,           RECENT_HISTORIES)                                   \
+    UINT (resident_history_size,      RESIDENT_HISTORY_SIZE)                              \
     BOOL (rich_text_support,          RICH_TEXT_SUPPORT)                                  \
     STR  (show_history,               SHOW_HISTORY)                                       \
+    BOOL (sqlite_single_database,     SQLITE_SINGLE_DATABASE)                             \
     ENUM (storage_backend,            STORAGE_BACKEND,              G_PASTE_TYPE_STORAGE) \
     UINT (storage_backend_revision,   STORAGE_BACKEND_REVISION)                           \
+    ENUM (storage_compression,        STORAGE_COMPRESSION,      G_PASTE_TYPE_COMPRESSION) \
     STR  (sync_clipboard_to_primary,  SYNC_CLIPBOARD_TO_PRIMARY)                          \
     STR  (sync_primary_to_clipboard,  SYNC_PRIMARY_TO_CLIPBOARD)                          \
     BOOL (synchronize_clipboards,     SYNCHRONIZE_CLIPBOARDS)                             \
     BOOL (track_changes,              TRACK_CHANGES)                                      \
+    UINT (track_changes_delay,        TRACK_CHANGES_DELAY)                                \
     BOOL (track_extension_state,      TRACK_EXTENSION_STATE)                              \
     BOOL (trim_items,                 TRIM_ITEMS)                                         \
     STR  (upload,                     UPLOAD)
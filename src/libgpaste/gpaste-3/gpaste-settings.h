@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <gpaste-3/gpaste-compression.h>
+#include <gpaste-3/gpaste-image-encoder.h>
 #include <gpaste-3/gpaste-macros.h>
 #include <gpaste-3/gpaste-storage.h>
 
@@ -18,11 +20,13 @@ G_PASTE_FINAL_TYPE (Settings, settings, SETTINGS, GObject)
 
 gboolean     g_paste_settings_get_close_on_select            (GPasteSettings *self);
 gboolean     g_paste_settings_get_open_centered              (GPasteSettings *self);
+gboolean     g_paste_settings_get_compress_idle_items        (GPasteSettings *self);
 guint64      g_paste_settings_get_element_size               (GPasteSettings *self);
 gboolean     g_paste_settings_get_empty_history_confirmation (GPasteSettings *self);
 gboolean     g_paste_settings_get_experimental_meta_daemon   (GPasteSettings *self);
 gboolean     g_paste_settings_get_growing_lines              (GPasteSettings *self);
 const gchar *g_paste_settings_get_history_name               (GPasteSettings *self);
+GPasteImageEncoder g_paste_settings_get_images_encoder       (GPasteSettings *self);
 gboolean     g_paste_settings_get_images_preview             (GPasteSettings *self);
 guint64      g_paste_settings_get_images_preview_size        (GPasteSettings *self);
 gboolean     g_paste_settings_get_images_support             (GPasteSettings *self);
@@ -34,14 +38,19 @@ guint64      g_paste_settings_get_max_text_item_size         (GPasteSettings *se
 guint64      g_paste_settings_get_min_text_item_size         (GPasteSettings *self);
 const gchar *g_paste_settings_get_pop                        (GPasteSettings *self);
 gboolean     g_paste_settings_get_primary_to_history         (GPasteSettings *self);
+guint64      g_paste_settings_get_recent_histories           (GPasteSettings *self);
+guint64      g_paste_settings_get_resident_history_size      (GPasteSettings *self);
 gboolean     g_paste_settings_get_rich_text_support          (GPasteSettings *self);
 const gchar *g_paste_settings_get_show_history               (GPasteSettings *self);
+gboolean     g_paste_settings_get_sqlite_single_database     (GPasteSettings *self);
 GPasteStorage g_paste_settings_get_storage_backend           (GPasteSettings *self);
 guint64      g_paste_settings_get_storage_backend_revision   (GPasteSettings *self);
+GPasteCompression g_paste_settings_get_storage_compression   (GPasteSettings *self);
 const gchar *g_paste_settings_get_sync_clipboard_to_primary  (GPasteSettings *self);
 const gchar *g_paste_settings_get_sync_primary_to_clipboard  (GPasteSettings *self);
 gboolean     g_paste_settings_get_synchronize_clipboards     (GPasteSettings *self);
 gboolean     g_paste_settings_get_track_changes              (GPasteSettings *self);
+guint64      g_paste_settings_get_track_changes_delay        (GPasteSettings *self);
 gboolean     g_paste_settings_get_track_extension_state      (GPasteSettings *self);
 gboolean     g_paste_settings_get_trim_items                 (GPasteSettings *self);
 const gchar *g_paste_settings_get_upload                     (GPasteSettings *self);
@@ -50,6 +59,8 @@ void g_paste_settings_set_close_on_select            (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_open_centered              (GPasteSettings *self,
                                                       gboolean        value);
+void g_paste_settings_set_compress_idle_items        (GPasteSettings *self,
+                                                      gboolean        value);
 void g_paste_settings_set_element_size               (GPasteSettings *self,
                                                       guint64         value);
 void g_paste_settings_set_empty_history_confirmation (GPasteSettings *self,
@@ -60,6 +71,8 @@ void g_paste_settings_set_growing_lines              (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_history_name               (GPasteSettings *self,
                                                       const gchar    *value);
+void g_paste_settings_set_images_encoder             (GPasteSettings    *self,
+                                                      GPasteImageEncoder value);
 void g_paste_settings_set_images_preview             (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_images_preview_size        (GPasteSettings *self,
@@ -82,14 +95,22 @@ void g_paste_settings_set_pop                        (GPasteSettings *self,
                                                       const gchar    *value);
 void g_paste_settings_set_primary_to_history         (GPasteSettings *self,
                                                       gboolean        value);
+void g_paste_settings_set_recent_histories           (GPasteSettings *self,
+                                                      guint64         value);
+void g_paste_settings_set_resident_history_size      (GPasteSettings *self,
+                                                      guint64         value);
 void g_paste_settings_set_rich_text_support          (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_show_history               (GPasteSettings *self,
                                                       const gchar    *value);
+void g_paste_settings_set_sqlite_single_database     (GPasteSettings *self,
+                                                      gboolean        value);
 void g_paste_settings_set_storage_backend            (GPasteSettings *self,
                                                       GPasteStorage   value);
 void g_paste_settings_set_storage_backend_revision   (GPasteSettings *self,
                                                       guint64         value);
+void g_paste_settings_set_storage_compression        (GPasteSettings   *self,
+                                                      GPasteCompression value);
 void g_paste_settings_set_sync_clipboard_to_primary  (GPasteSettings *self,
                                                       const gchar    *value);
 void g_paste_settings_set_sync_primary_to_clipboard  (GPasteSettings *self,
@@ -98,6 +119,8 @@ void g_paste_settings_set_synchronize_clipboards     (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_track_changes              (GPasteSettings *self,
                                                       gboolean        value);
+void g_paste_settings_set_track_changes_delay        (GPasteSettings *self,
+                                                      guint64         value);
 void g_paste_settings_set_track_extension_state      (GPasteSettings *self,
                                                       gboolean        value);
 void g_paste_settings_set_trim_items                 (GPasteSettings *self,
@@ -380,10 +380,11 @@ g_paste_util_get_dbus_item_result (GVariant *variant)
     g_autofree gchar *value = NULL;
     guint32 kind;
     gboolean favourite;
+    guint64 length;
 
-    g_variant_get (variant, G_PASTE_ITEM_VARIANT_STRING, &uuid, &value, &kind, &favourite);
+    g_variant_get (variant, G_PASTE_ITEM_VARIANT_STRING, &uuid, &value, &kind, &favourite, &length);
 
-    return g_paste_client_item_new (uuid, value, kind, favourite);
+    return g_paste_client_item_new (uuid, value, kind, favourite, length);
 }
 
 /**
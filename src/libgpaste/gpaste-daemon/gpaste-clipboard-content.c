@@ -272,7 +272,7 @@ g_paste_clipboard_file_list_equal (GdkFileList *a,
  * g_paste_clipboard_content_to_item:
  * @kind: what the read produced
  * @text: (nullable): the text, for %CLIPBOARD_CONTENT_TEXT
- * @texture: (nullable): the image, for %CLIPBOARD_CONTENT_IMAGE
+ * @image: (nullable) (transfer none): the already built #GPasteImageItem, for %CLIPBOARD_CONTENT_IMAGE
  * @file_list: (nullable): the files, for %CLIPBOARD_CONTENT_FILE_LIST
  * @rgba: (nullable): the colour, for %CLIPBOARD_CONTENT_COLOR
  * @special_atoms: (array fixed-size=4): the alternative representations
@@ -286,7 +286,7 @@ g_paste_clipboard_file_list_equal (GdkFileList *a,
 G_PASTE_VISIBLE GPasteItem *
 g_paste_clipboard_content_to_item (GPasteClipboardContentKind kind,
                                    const gchar               *text,
-                                   GdkTexture                *texture,
+                                   GPasteItem                *image,
                                    GdkFileList               *file_list,
                                    const GdkRGBA             *rgba,
                                    GPasteBinaryData         **special_atoms)
@@ -308,8 +308,8 @@ g_paste_clipboard_content_to_item (GPasteClipboardContentKind kind,
             item = G_PASTE_ITEM (g_paste_text_item_new (text));
         break;
     case CLIPBOARD_CONTENT_IMAGE:
-        if (texture)
-            item = G_PASTE_ITEM (g_paste_image_item_new (texture));
+        if (image)
+            item = g_object_ref (image);
         break;
     case CLIPBOARD_CONTENT_IGNORED:
     case CLIPBOARD_CONTENT_NONE:
@@ -83,12 +83,16 @@ gboolean     g_paste_clipboard_file_list_equal (GdkFileList *a,
  * nothing -- including NONE and IGNORED, so a backend that decided not to
  * produce anything just passes those.
  *
+ * An image comes in already built: checksumming and encoding it is the
+ * expensive part of a capture, which the backends run off the main thread
+ * through g_paste_image_item_new_async() before getting here.
+ *
  * @special_atoms is the G_PASTE_SPECIAL_ATOM_LAST-long array of alternative
  * representations gathered alongside; the ones that end up on the item are
  * stolen from it, and the rest are left for the caller to release. */
 GPasteItem *g_paste_clipboard_content_to_item (GPasteClipboardContentKind kind,
                                                const gchar               *text,
-                                               GdkTexture                *texture,
+                                               GPasteItem                *image,
                                                GdkFileList               *file_list,
                                                const GdkRGBA             *rgba,
                                                GPasteBinaryData         **special_atoms);
@@ -13,6 +13,7 @@
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-special-atom.h>
 #include <gpaste-daemon/gpaste-text-item.h>
+#include <gpaste-daemon/gpaste-text-sink.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
 
 /*
@@ -25,7 +26,8 @@
  * than opening a display connection of its own, and it sees *every* selection
  * ownership change globally — no keyboard-focus gating, unlike GdkClipboard.
  *
- * Reads go through meta_selection_transfer_async() into an in-memory stream;
+ * Reads go through meta_selection_transfer_async() into an in-memory stream
+ * (a #GPasteTextSink for text, which cuts an oversized one short);
  * writes publish a #GPasteClipboardMetaSource we own (and recognise on the
  * resulting owner-change to avoid reprocessing our own writes). Unlike mutter's
  * #MetaSelectionSourceMemory, which only ever advertises a single mimetype, our
@@ -54,6 +56,16 @@ struct _GPasteClipboardMeta
     gulong                 owner_changed_id;
 
     GPasteClipboardContent content;
+    /* Bumped by every update and every selection we publish ourselves, so an
+     * image capture finishing on a worker thread can tell it was overtaken
+     * (see the GDK backend, which does the same). */
+    guint64                serial;
+    /* The image/png bytes the current image was built from, and its checksum
+     * (the offer only describes what we hold while the content still carries
+     * that checksum): an owner offering the very same bytes again is the same
+     * image, which then costs a comparison instead of a decode. */
+    GBytes                *offered_png;
+    gchar                 *offered_png_checksum;
 };
 
 static void g_paste_clipboard_meta_provider_iface_init (GPasteClipboardProviderInterface *iface);
@@ -127,28 +139,44 @@ g_paste_clipboard_meta_on_transfer_done (GObject      *source_object,
         return;
     }
 
-    /* steal_as_bytes requires a closed stream and the transfer leaves it open.
-     * Closing a #GMemoryOutputStream cannot fail, hence the unchecked error. */
-    g_output_stream_close (ostream, NULL, NULL);
+    g_autoptr (GBytes) bytes = NULL;
 
-    g_autoptr (GBytes) bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (ostream));
+    if (G_PASTE_IS_TEXT_SINK (ostream))
+    {
+        /* The sink validated the text as it came in; all that is left to
+         * check is that it did not stop in the middle of a character. */
+        if (!(bytes = g_paste_text_sink_finish (G_PASTE_TEXT_SINK (ostream), &error)))
+            g_debug ("Failed to read selection text: %s", error->message);
+    }
+    else
+    {
+        /* steal_as_bytes requires a closed stream and the transfer leaves it open.
+         * Closing a #GMemoryOutputStream cannot fail, hence the unchecked error. */
+        g_output_stream_close (ostream, NULL, NULL);
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (ostream));
+    }
 
     if (data->callback)
         data->callback (self, bytes, data->user_data);
 }
 
+/* Read @mimetype into @ostream (transfer full), an in-memory stream: a failed
+ * write aborts the transfer, which is how a #GPasteTextSink stops reading an
+ * oversized text without waiting for the rest of it. */
 static void
-g_paste_clipboard_meta_read_mime (GPasteClipboardMeta             *self,
-                                  const gchar                     *mimetype,
-                                  GPasteClipboardMetaBytesCallback callback,
-                                  gpointer                         user_data)
+g_paste_clipboard_meta_read_mime_into (GPasteClipboardMeta             *self,
+                                       const gchar                     *mimetype,
+                                       GOutputStream                   *ostream,
+                                       GCancellable                    *cancellable,
+                                       GPasteClipboardMetaBytesCallback callback,
+                                       gpointer                         user_data)
 {
     GPasteClipboardMetaReadData *data = g_new0 (GPasteClipboardMetaReadData, 1);
 
     /* Hold a ref for the duration of the async transfer so the provider cannot be
      * finalized out from under the callback (released in on_transfer_done). */
     data->self = g_object_ref (self);
-    data->ostream = g_memory_output_stream_new_resizable ();
+    data->ostream = ostream;
     data->callback = callback;
     data->user_data = user_data;
 
@@ -157,11 +185,37 @@ g_paste_clipboard_meta_read_mime (GPasteClipboardMeta             *self,
                                    mimetype,
                                    -1, /* size unknown */
                                    data->ostream,
-                                   NULL, /* cancellable */
+                                   cancellable,
                                    g_paste_clipboard_meta_on_transfer_done,
                                    data);
 }
 
+static void
+g_paste_clipboard_meta_read_mime (GPasteClipboardMeta             *self,
+                                  const gchar                     *mimetype,
+                                  GCancellable                    *cancellable,
+                                  GPasteClipboardMetaBytesCallback callback,
+                                  gpointer                         user_data)
+{
+    g_paste_clipboard_meta_read_mime_into (self, mimetype, g_memory_output_stream_new_resizable (), cancellable, callback, user_data);
+}
+
+/* Read the text @mimetype, giving up as soon as it grows past what the history
+ * would accept anyway (max-text-item-size, which is checked before trimming
+ * here: trimming only ever shrinks a text, and what it would shave off a
+ * 500 MB one is not worth reading it all for). */
+static void
+g_paste_clipboard_meta_read_text (GPasteClipboardMeta             *self,
+                                  const gchar                     *mimetype,
+                                  GCancellable                    *cancellable,
+                                  GPasteClipboardMetaBytesCallback callback,
+                                  gpointer                         user_data)
+{
+    gsize max_size = g_paste_settings_get_max_text_item_size (self->settings);
+
+    g_paste_clipboard_meta_read_mime_into (self, mimetype, g_paste_text_sink_new (max_size), cancellable, callback, user_data);
+}
+
 /* --- GDK-backed format negotiation --- */
 
 /*
@@ -433,6 +487,9 @@ static void
 g_paste_clipboard_meta_publish_source (GPasteClipboardMeta       *self,
                                        GPasteClipboardMetaSource *source)
 {
+    /* Whatever capture is still in flight was taken before this. */
+    ++self->serial;
+
     /* Keep our own ref so we can recognise the resulting owner-change as ours. */
     g_set_object (&self->owned_source, META_SELECTION_SOURCE (source));
     meta_selection_set_owner (self->selection, self->type, META_SELECTION_SOURCE (source));
@@ -510,7 +567,7 @@ g_paste_clipboard_meta_sync_text (GPasteClipboardMeta *self,
                       : NULL;
 
     if (mime)
-        g_paste_clipboard_meta_read_mime ((GPasteClipboardMeta *) self, mime,
+        g_paste_clipboard_meta_read_mime ((GPasteClipboardMeta *) self, mime, NULL, /* cancellable */
                                           g_paste_clipboard_meta_sync_ready, g_object_ref (other));
 
     g_list_free_full (mimetypes, g_free);
@@ -621,14 +678,17 @@ g_paste_clipboard_meta_is_empty (GPasteClipboardMeta *self)
 typedef struct
 {
     GPasteClipboardMeta                  *self;
+    GCancellable                         *cancellable; /* ref'd, if any */
     GPasteClipboardProviderUpdateCallback callback;
     gpointer                              user_data;
     gint                                  pending;
     GPasteClipboardContentKind            content_kind;
     gboolean                              produced;
+    guint64                               serial;
     gchar                                *text;
-    GdkTexture                           *texture;
+    GPasteItem                           *image;
     gchar                                *mime;
+    GBytes                               *offered_png;
     GdkFileList                          *file_list;
     GdkRGBA                               rgba;
     GPasteBinaryData                     *special_atom[G_PASTE_SPECIAL_ATOM_LAST];
@@ -643,7 +703,7 @@ g_paste_clipboard_meta_update_maybe_done (GPasteClipboardMetaUpdateData *data)
     /* Nothing produced means nothing to build, whatever the kind said. */
     GPasteItem *item = g_paste_clipboard_content_to_item (data->produced ? data->content_kind : CLIPBOARD_CONTENT_NONE,
                                                           data->text,
-                                                          data->texture,
+                                                          data->image,
                                                           data->file_list,
                                                           &data->rgba,
                                                           data->special_atom);
@@ -653,11 +713,13 @@ g_paste_clipboard_meta_update_maybe_done (GPasteClipboardMetaUpdateData *data)
 
     for (GPasteSpecialAtom atom = G_PASTE_SPECIAL_ATOM_FIRST; atom < G_PASTE_SPECIAL_ATOM_LAST; ++atom)
         g_clear_object (&data->special_atom[atom]);
-    g_clear_object (&data->texture);
+    g_clear_object (&data->image);
     if (data->file_list)
         g_boxed_free (GDK_TYPE_FILE_LIST, g_steal_pointer (&data->file_list));
     g_free (data->text);
     g_free (data->mime);
+    g_clear_pointer (&data->offered_png, g_bytes_unref);
+    g_clear_object (&data->cancellable);
     g_object_unref (data->self);
     g_free (data);
 }
@@ -669,16 +731,19 @@ g_paste_clipboard_meta_update_on_text (GPasteClipboardMeta *self,
 {
     GPasteClipboardMetaUpdateData *data = user_data;
 
-    if (!bytes)
+    /* A text that made it in just as its update was superseded must not move
+     * the cache: the next update would then find it unchanged and drop it. */
+    if (!bytes || g_cancellable_is_cancelled (data->cancellable))
     {
         g_paste_clipboard_meta_update_maybe_done (data);
         return;
     }
 
+    /* Already size-capped and validated by the sink it was read into. */
     gsize size;
     const gchar *raw = g_bytes_get_data (bytes, &size);
 
-    if (!raw || !g_utf8_validate (raw, size, NULL))
+    if (!raw)
     {
         g_paste_clipboard_meta_update_maybe_done (data);
         return;
@@ -723,6 +788,55 @@ g_paste_clipboard_meta_content_gtype (GPasteClipboardContentKind content_kind)
     }
 }
 
+static void
+g_paste_clipboard_meta_update_on_image_ready (GObject      *source_object G_GNUC_UNUSED,
+                                              GAsyncResult *res,
+                                              gpointer      user_data)
+{
+    GPasteClipboardMetaUpdateData *data = user_data;
+    GPasteClipboardMeta *self = data->self;
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GPasteItem) image = g_paste_image_item_new_finish (res, &error);
+
+    if (!image)
+    {
+        g_debug ("Failed to process selection image: %s", error->message);
+        g_paste_clipboard_meta_update_maybe_done (data);
+        return;
+    }
+
+    /* Overtaken by a newer owner, or by a selection of our own, while the
+     * worker was busy: that is what the selection holds now, not this. A
+     * cancelled update was overtaken too, just before the next one started. */
+    if (data->serial != self->serial || g_cancellable_is_cancelled (data->cancellable))
+    {
+        g_debug ("%s: dropping superseded image", g_paste_clipboard_provider_target_name (self->is_clipboard));
+        g_paste_clipboard_meta_update_maybe_done (data);
+        return;
+    }
+
+    const gchar *checksum = g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (image));
+
+    if (self->content.kind == CLIPBOARD_CONTENT_IMAGE && g_paste_str_equal (checksum, self->content.str))
+    {
+        g_paste_clipboard_meta_update_maybe_done (data);
+        return;
+    }
+
+    g_paste_clipboard_content_set_image_checksum (&self->content, checksum);
+
+    if (data->offered_png)
+    {
+        g_clear_pointer (&self->offered_png, g_bytes_unref);
+        self->offered_png = g_bytes_ref (data->offered_png);
+        g_set_str (&self->offered_png_checksum, checksum);
+    }
+
+    data->produced = TRUE;
+    data->image = g_steal_pointer (&image);
+    g_paste_clipboard_meta_update_maybe_done (data);
+}
+
 static void
 g_paste_clipboard_meta_update_on_value_deserialized (GObject      *source_object G_GNUC_UNUSED,
                                                      GAsyncResult *res,
@@ -743,25 +857,30 @@ g_paste_clipboard_meta_update_on_value_deserialized (GObject      *source_object
         return;
     }
 
+    /* Superseded: leave the cache alone (see update_on_text). */
+    if (g_cancellable_is_cancelled (data->cancellable))
+    {
+        g_paste_clipboard_meta_update_maybe_done (data);
+        return;
+    }
+
     switch (data->content_kind)
     {
     case CLIPBOARD_CONTENT_IMAGE:
     {
-        g_autoptr (GdkTexture) texture = g_value_dup_object (&value);
+        GdkTexture *texture = g_value_get_object (&value);
 
         if (!texture)
             break;
 
-        g_autofree gchar *checksum = g_paste_image_item_compute_checksum (texture);
-
-        if (self->content.kind == CLIPBOARD_CONTENT_IMAGE && g_paste_str_equal (checksum, self->content.str))
-            break;
-
-        g_paste_clipboard_content_set_image_checksum_take (&self->content, g_steal_pointer (&checksum));
-
-        data->produced = TRUE;
-        data->texture = g_steal_pointer (&texture);
-        break;
+        /* Checksumming and encoding run on a worker, in the compositor's
+         * process of all places; @data stays pending until they are done. */
+        g_paste_image_item_new_async (texture,
+                                      g_paste_settings_get_images_encoder (self->settings),
+                                      data->cancellable,
+                                      g_paste_clipboard_meta_update_on_image_ready,
+                                      data);
+        return;
     }
     case CLIPBOARD_CONTENT_COLOR:
     {
@@ -807,7 +926,7 @@ g_paste_clipboard_meta_update_on_value_deserialized (GObject      *source_object
  * the GDK backend's reads take, so every representation GDK accepts (and the
  * exact byte formats it expects) is handled identically here. */
 static void
-g_paste_clipboard_meta_update_on_value (GPasteClipboardMeta *self G_GNUC_UNUSED,
+g_paste_clipboard_meta_update_on_value (GPasteClipboardMeta *self,
                                         GBytes              *bytes,
                                         gpointer             user_data)
 {
@@ -819,13 +938,35 @@ g_paste_clipboard_meta_update_on_value (GPasteClipboardMeta *self G_GNUC_UNUSED,
         return;
     }
 
+    /* An image offered as PNG skips GDK's deserialiser: the worker building
+     * the item decodes it itself, off the compositor's main loop, and keeps
+     * the offered bytes as the item's PNG rather than encoding its own. */
+    if (data->content_kind == CLIPBOARD_CONTENT_IMAGE && g_paste_str_equal (data->mime, META_MIME_IMAGE))
+    {
+        if (self->offered_png &&
+            g_paste_str_equal (g_paste_clipboard_content_get_image_checksum (&self->content), self->offered_png_checksum) &&
+            g_bytes_equal (bytes, self->offered_png))
+        {
+            g_paste_clipboard_meta_update_maybe_done (data);
+            return;
+        }
+
+        data->offered_png = g_bytes_ref (bytes);
+        g_paste_image_item_new_from_png_async (bytes,
+                                               g_paste_settings_get_images_encoder (self->settings),
+                                               data->cancellable,
+                                               g_paste_clipboard_meta_update_on_image_ready,
+                                               data);
+        return;
+    }
+
     g_autoptr (GInputStream) stream = g_memory_input_stream_new_from_bytes (bytes);
 
     gdk_content_deserialize_async (stream,
                                    data->mime,
                                    g_paste_clipboard_meta_content_gtype (data->content_kind),
                                    G_PRIORITY_DEFAULT,
-                                   NULL, /* cancellable */
+                                   data->cancellable,
                                    g_paste_clipboard_meta_update_on_value_deserialized,
                                    data);
 }
@@ -878,6 +1019,7 @@ g_paste_clipboard_meta_pick_mime (GList       *mimetypes,
 
 static void
 g_paste_clipboard_meta_update (GPasteClipboardMeta                  *self,
+                               GCancellable                         *cancellable,
                                GPasteClipboardProviderUpdateCallback callback,
                                gpointer                              user_data)
 {
@@ -885,6 +1027,8 @@ g_paste_clipboard_meta_update (GPasteClipboardMeta                  *self,
     GPasteClipboardContentKind content_kind = CLIPBOARD_CONTENT_NONE;
     const gchar *content_mime = NULL;
 
+    ++self->serial;
+
     if ((content_mime = g_paste_clipboard_meta_pick_mime (mimetypes, GDK_TYPE_FILE_LIST, META_MIME_URIS)))
     {
         content_kind = CLIPBOARD_CONTENT_FILE_LIST;
@@ -931,10 +1075,12 @@ g_paste_clipboard_meta_update (GPasteClipboardMeta                  *self,
     /* Hold a ref for the whole update (transfer + deserialize + special-value
      * reads), released when data is freed in update_maybe_done. */
     data->self = g_object_ref (self);
+    data->cancellable = (cancellable) ? g_object_ref (cancellable) : NULL;
     data->callback = callback;
     data->user_data = user_data;
     data->pending = 1;
     data->content_kind = content_kind;
+    data->serial = self->serial;
 
     ++data->pending;
     switch (content_kind)
@@ -946,10 +1092,10 @@ g_paste_clipboard_meta_update (GPasteClipboardMeta                  *self,
          * this owned copy (not content_mime, which aliases the mimetypes list freed
          * below) to the async transfer, since it reads the string after we return. */
         data->mime = g_strdup (content_mime);
-        g_paste_clipboard_meta_read_mime (self, data->mime, g_paste_clipboard_meta_update_on_value, data);
+        g_paste_clipboard_meta_read_mime (self, data->mime, cancellable, g_paste_clipboard_meta_update_on_value, data);
         break;
     case CLIPBOARD_CONTENT_TEXT:
-        g_paste_clipboard_meta_read_mime (self, content_mime, g_paste_clipboard_meta_update_on_text, data);
+        g_paste_clipboard_meta_read_text (self, content_mime, cancellable, g_paste_clipboard_meta_update_on_text, data);
         break;
     case CLIPBOARD_CONTENT_IGNORED:
     case CLIPBOARD_CONTENT_NONE:
@@ -969,7 +1115,7 @@ g_paste_clipboard_meta_update (GPasteClipboardMeta                  *self,
             ctx->atom = atom;
 
             ++data->pending;
-            g_paste_clipboard_meta_read_mime (self, g_paste_special_atom_get (atom), g_paste_clipboard_meta_on_atom_bytes, ctx);
+            g_paste_clipboard_meta_read_mime (self, g_paste_special_atom_get (atom), cancellable, g_paste_clipboard_meta_on_atom_bytes, ctx);
         }
     }
 
@@ -1023,6 +1169,8 @@ g_paste_clipboard_meta_finalize (GObject *object)
     GPasteClipboardMeta *self = G_PASTE_CLIPBOARD_META (object);
 
     g_paste_clipboard_content_clear (&self->content);
+    g_clear_pointer (&self->offered_png, g_bytes_unref);
+    g_free (self->offered_png_checksum);
 
     G_OBJECT_CLASS (g_paste_clipboard_meta_parent_class)->finalize (object);
 }
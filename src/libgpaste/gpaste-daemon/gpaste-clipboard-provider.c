@@ -103,21 +103,28 @@ g_paste_clipboard_provider_is_empty (GPasteClipboardProvider *self)
 /**
  * g_paste_clipboard_provider_update:
  * @self: a #GPasteClipboardProvider instance
+ * @cancellable: (nullable): a #GCancellable to abandon the reads with
  * @callback: (scope async): the callback to be called when the content is ready
  * @user_data: user data to pass to @callback
  *
  * Read the current selection content and update the internal cache. The
  * callback receives a newly created #GPasteItem or %NULL if the content is
  * unchanged, unrecognised, or the selection has no owner.
+ *
+ * Cancelling @cancellable stops the reads still in flight; the callback is
+ * still called, with %NULL unless the cache had already moved on to the new
+ * content, in which case the item for it is delivered all the same.
  */
 G_PASTE_VISIBLE void
 g_paste_clipboard_provider_update (GPasteClipboardProvider              *self,
+                                   GCancellable                         *cancellable,
                                    GPasteClipboardProviderUpdateCallback callback,
                                    gpointer                              user_data)
 {
     g_return_if_fail (G_PASTE_IS_CLIPBOARD_PROVIDER (self));
+    g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-    G_PASTE_CLIPBOARD_PROVIDER_GET_IFACE (self)->update (self, callback, user_data);
+    G_PASTE_CLIPBOARD_PROVIDER_GET_IFACE (self)->update (self, cancellable, callback, user_data);
 }
 
 /**
@@ -50,6 +50,7 @@ struct _GPasteClipboardProviderInterface
     const gchar *(*get_image_checksum) (GPasteClipboardProvider *self);
     gboolean     (*is_empty)           (GPasteClipboardProvider *self);
     void         (*update)             (GPasteClipboardProvider              *self,
+                                        GCancellable                         *cancellable,
                                         GPasteClipboardProviderUpdateCallback callback,
                                         gpointer                              user_data);
     void         (*select_text)        (GPasteClipboardProvider *self,
@@ -91,10 +92,12 @@ struct _GPasteClipboardProviderInterface
     }                                                                                                      \
     static void                                                                                            \
     provider_update (GPasteClipboardProvider              *self,                                           \
+                     GCancellable                         *cancellable,                                    \
                      GPasteClipboardProviderUpdateCallback callback,                                       \
                      gpointer                              user_data)                                      \
     {                                                                                                      \
-        g_paste_clipboard_##lc##_update (G_PASTE_CLIPBOARD_##UC ((gpointer) self), callback, user_data);   \
+        g_paste_clipboard_##lc##_update (G_PASTE_CLIPBOARD_##UC ((gpointer) self),                         \
+                                         cancellable, callback, user_data);                                \
     }                                                                                                      \
     static void                                                                                            \
     provider_select_text (GPasteClipboardProvider *self,                                                   \
@@ -139,6 +142,7 @@ const gchar  *g_paste_clipboard_provider_get_text           (GPasteClipboardProv
 const gchar  *g_paste_clipboard_provider_get_image_checksum (GPasteClipboardProvider *self);
 gboolean      g_paste_clipboard_provider_is_empty           (GPasteClipboardProvider *self);
 void          g_paste_clipboard_provider_update             (GPasteClipboardProvider              *self,
+                                                             GCancellable                         *cancellable,
                                                              GPasteClipboardProviderUpdateCallback callback,
                                                              gpointer                              user_data);
 void          g_paste_clipboard_provider_select_text        (GPasteClipboardProvider *self,
@@ -3,10 +3,19 @@
 
 #include <gpaste-daemon/gpaste-clipboards-manager.h>
 
+/* Each clipboard gets its own update scheduler. A change arms a window of
+ * track-changes-delay ms; the changes landing inside it are folded into the
+ * single update the window ends with, and a change landing while that update
+ * is still reading cancels it, since only the newest owner's content matters
+ * (think of a terminal selection being dragged with primary-to-history on). */
 typedef struct
 {
+    GPasteClipboardsManager *manager;
     GPasteClipboardProvider *clipboard;
     GSignalGroup            *signal_group;
+    GCancellable            *cancellable; /* the latest update's */
+    guint                    window_id;
+    guint64                  coalesced; /* changes folded into the pending window */
 } _Clipboard;
 
 struct _GPasteClipboardsManager
@@ -17,23 +26,52 @@ struct _GPasteClipboardsManager
     GPasteHistory  *history;
     GSignalGroup   *history_signals;
     GPasteSettings *settings;
+
+    guint64         coalesced_updates;
 };
 
 G_PASTE_DEFINE_TYPE (ClipboardsManager, clipboards_manager, G_TYPE_OBJECT)
 
 static void g_paste_clipboards_manager_notify (GPasteClipboardProvider *clipboard, gpointer user_data);
 
+/* Cancel whatever @clip is still reading, and hand out the cancellable for the
+ * update about to replace it. */
+static GCancellable *
+_clipboard_supersede (_Clipboard *clip)
+{
+    if (clip->cancellable)
+    {
+        g_cancellable_cancel (clip->cancellable);
+        g_object_unref (clip->cancellable);
+    }
+
+    return clip->cancellable = g_cancellable_new ();
+}
+
+typedef struct
+{
+    GPasteClipboardsManager *self; /* ref'd for the whole update */
+    GCancellable            *cancellable;
+    gboolean                 track;
+} GPasteClipboardsManagerUpdateData;
+
 static void
 g_paste_clipboards_manager_bootstrap_ready (GPasteClipboardProvider *clipboard,
                                             GPasteItem              *item,
                                             gpointer                 user_data)
 {
-    GPasteClipboardsManager *self = user_data;
+    g_autofree GPasteClipboardsManagerUpdateData *data = user_data;
+    g_autoptr (GPasteClipboardsManager) self = data->self;
+    g_autoptr (GCancellable) cancellable = data->cancellable;
     /* The update callback owns the item it is handed (transfer full); at
      * bootstrap we only care about the selection not being empty, so whatever
      * was already in it is read and dropped rather than pushed to the history. */
     g_autoptr (GPasteItem) bootstrapped = item;
 
+    /* A change overtook the bootstrap: its own update takes it from here. */
+    if (g_cancellable_is_cancelled (cancellable))
+        return;
+
     g_paste_clipboard_provider_ensure_not_empty (clipboard, self->history);
 }
 
@@ -52,13 +90,18 @@ g_paste_clipboards_manager_add_clipboard (GPasteClipboardsManager *self,
     g_return_if_fail (G_PASTE_IS_CLIPBOARD_PROVIDER (clipboard));
 
     _Clipboard *clip = g_new0 (_Clipboard, 1);
+    GPasteClipboardsManagerUpdateData *data = g_new0 (GPasteClipboardsManagerUpdateData, 1);
 
+    clip->manager = self;
     clip->clipboard = g_object_ref (clipboard);
     clip->signal_group = g_signal_group_new (G_PASTE_TYPE_CLIPBOARD_PROVIDER);
-    g_signal_group_connect (clip->signal_group, "changed", G_CALLBACK (g_paste_clipboards_manager_notify), self);
+    g_signal_group_connect (clip->signal_group, "changed", G_CALLBACK (g_paste_clipboards_manager_notify), clip);
+
+    data->self = g_object_ref (self);
+    data->cancellable = g_object_ref (_clipboard_supersede (clip));
 
     self->clipboards = g_slist_prepend (self->clipboards, clip);
-    g_paste_clipboard_provider_update (clipboard, g_paste_clipboards_manager_bootstrap_ready, self);
+    g_paste_clipboard_provider_update (clipboard, data->cancellable, g_paste_clipboards_manager_bootstrap_ready, data);
 }
 
 /**
@@ -131,22 +174,31 @@ g_paste_clipboards_manager_notify_finish (GPasteClipboardsManager *self,
     }
 }
 
-typedef struct
-{
-    GPasteClipboardsManager *self;
-    gboolean                 track;
-} GPasteClipboardsManagerUpdateData;
-
 static void
 g_paste_clipboards_manager_update_ready (GPasteClipboardProvider *clipboard,
                                          GPasteItem              *item,
                                          gpointer                 user_data)
 {
     g_autofree GPasteClipboardsManagerUpdateData *data = user_data;
-    GPasteClipboardsManager *self = data->self;
+    g_autoptr (GPasteClipboardsManager) self = data->self;
+    g_autoptr (GCancellable) cancellable = data->cancellable;
 
     g_debug ("clipboards-manager: update ready");
 
+    if (g_cancellable_is_cancelled (cancellable))
+    {
+        /* Superseded, or the manager was disposed. The providers only hand
+         * an item out of a cancelled update if their cache already moved on to
+         * it, and then the history must have it too or the next update, seeing
+         * nothing new, would never add it; the rest (syncing, refilling an
+         * empty selection) is for the update that replaced this one to do. */
+        if (item && data->track && self->history)
+            g_paste_history_add (self->history, item);
+        else
+            g_clear_object (&item);
+        return;
+    }
+
     const gchar *synchronized_text = NULL;
 
     if (item && g_paste_clipboard_provider_get_text (clipboard) &&
@@ -163,12 +215,19 @@ g_paste_clipboards_manager_update_ready (GPasteClipboardProvider *clipboard,
 }
 
 static void
-g_paste_clipboards_manager_notify (GPasteClipboardProvider *clipboard,
-                                   gpointer                 user_data)
+g_paste_clipboards_manager_start_update (_Clipboard *clip)
 {
-    GPasteClipboardsManager *self = user_data;
+    GPasteClipboardsManager *self = clip->manager;
+    GPasteClipboardProvider *clipboard = clip->clipboard;
 
-    g_debug ("clipboards-manager: notify");
+    if (clip->coalesced)
+    {
+        g_debug ("%s: coalesced %" G_GUINT64_FORMAT " updates",
+                 g_paste_clipboard_provider_target_name (g_paste_clipboard_provider_is_clipboard (clipboard)),
+                 clip->coalesced);
+        self->coalesced_updates += clip->coalesced;
+        clip->coalesced = 0;
+    }
 
     GPasteSettings *settings = self->settings;
     gboolean track = (g_paste_settings_get_track_changes (settings) &&
@@ -177,12 +236,53 @@ g_paste_clipboards_manager_notify (GPasteClipboardProvider *clipboard,
                            g_paste_settings_get_synchronize_clipboards (settings))); // Or primary and clipboards are synchronized hence primary will affect history through clipboard
     GPasteClipboardsManagerUpdateData *data = g_new0 (GPasteClipboardsManagerUpdateData, 1);
 
-    data->self = self;
+    data->self = g_object_ref (self);
+    data->cancellable = g_object_ref (_clipboard_supersede (clip));
     data->track = track;
 
     g_paste_clipboard_provider_update (clipboard,
-                              g_paste_clipboards_manager_update_ready,
-                              data);
+                                       data->cancellable,
+                                       g_paste_clipboards_manager_update_ready,
+                                       data);
+}
+
+static gboolean
+g_paste_clipboards_manager_window_elapsed (gpointer user_data)
+{
+    _Clipboard *clip = user_data;
+
+    clip->window_id = 0;
+    g_paste_clipboards_manager_start_update (clip);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+g_paste_clipboards_manager_notify (GPasteClipboardProvider *clipboard G_GNUC_UNUSED,
+                                   gpointer                 user_data)
+{
+    _Clipboard *clip = user_data;
+    guint64 delay = g_paste_settings_get_track_changes_delay (clip->manager->settings);
+
+    g_debug ("clipboards-manager: notify");
+
+    /* Whatever the previous update is still reading belongs to an owner that
+     * is gone already. */
+    if (clip->cancellable)
+        g_cancellable_cancel (clip->cancellable);
+
+    if (!delay)
+    {
+        g_paste_clipboards_manager_start_update (clip);
+        return;
+    }
+
+    /* The window is not pushed back by the changes landing in it, so a burst
+     * that never settles is still read every @delay ms rather than never. */
+    if (clip->window_id)
+        ++clip->coalesced;
+    else
+        clip->window_id = g_timeout_add (delay, g_paste_clipboards_manager_window_elapsed, clip);
 }
 
 /**
@@ -257,6 +357,23 @@ g_paste_clipboards_manager_store (GPasteClipboardsManager *self)
     }
 }
 
+/**
+ * g_paste_clipboards_manager_get_coalesced_updates:
+ * @self: a #GPasteClipboardsManager instance
+ *
+ * Get how many clipboard changes were folded into another one's update rather
+ * than read on their own (see the "track-changes-delay" setting)
+ *
+ * Returns: the number of coalesced updates since @self was created
+ */
+G_PASTE_VISIBLE guint64
+g_paste_clipboards_manager_get_coalesced_updates (GPasteClipboardsManager *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_CLIPBOARDS_MANAGER (self), 0);
+
+    return self->coalesced_updates;
+}
+
 static void
 on_item_selected (GPasteClipboardsManager *self,
                   GPasteItem              *item,
@@ -271,6 +388,11 @@ _clipboard_free (gpointer data)
 {
     _Clipboard *clip = data;
 
+    /* Stop the reads still in flight: nobody is left to act on them. */
+    g_clear_handle_id (&clip->window_id, g_source_remove);
+    if (clip->cancellable)
+        g_cancellable_cancel (clip->cancellable);
+    g_clear_object (&clip->cancellable);
     g_clear_object (&clip->signal_group);
     g_object_unref (clip->clipboard);
     g_free (clip);
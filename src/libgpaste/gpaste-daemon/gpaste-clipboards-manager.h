@@ -20,6 +20,8 @@ gboolean g_paste_clipboards_manager_select        (GPasteClipboardsManager *self
                                                    GPasteItem              *item);
 void g_paste_clipboards_manager_store             (GPasteClipboardsManager *self);
 
+guint64  g_paste_clipboards_manager_get_coalesced_updates (GPasteClipboardsManager *self);
+
 GPasteClipboardsManager *g_paste_clipboards_manager_new (GPasteHistory  *history,
                                                          GPasteSettings *settings);
 
@@ -4,21 +4,24 @@
 #include <gpaste-daemon/gpaste-daemon-methods.h>
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-password-item.h>
+#include <gpaste-daemon/gpaste-storage-backend.h>
 #include <gpaste-daemon/gpaste-text-item.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
 
 #include <string.h>
 
 /* The one shape an item takes on the wire, and the one value it carries: the
- * string a user is shown. */
+ * string a user is shown, or as much of it as a row can show, with the length
+ * of the whole of it. GetValue is where the rest is. */
 static GVariant *
 g_paste_daemon_methods_item_variant (GPasteItem *item)
 {
     return g_variant_new (G_PASTE_ITEM_VARIANT_STRING,
                           g_paste_item_get_uuid (item),
-                          g_paste_item_get_display_string (item),
+                          g_paste_item_get_preview (item),
                           (guint32) g_paste_item_get_kind (item),
-                          g_paste_item_is_favourite (item));
+                          g_paste_item_is_favourite (item),
+                          g_paste_item_get_display_length (item));
 }
 
 /* The same for a whole array of them, which is every listing the daemon
@@ -112,7 +115,7 @@ g_paste_daemon_methods_add_file (const GPasteDaemonMethods *self,
                 G_PASTE_DBUS_ASSERT (FALSE, G_PASTE_ERROR_WRONG_ITEM_KIND, "the file is neither text nor an image");
             }
 
-            g_paste_daemon_methods_do_add_item (self, g_paste_image_item_new (img));
+            g_paste_daemon_methods_do_add_item (self, g_paste_image_item_new (img, g_paste_settings_get_images_encoder (self->settings)));
         }
     }
 }
@@ -129,26 +132,60 @@ g_paste_daemon_methods_add_password (const GPasteDaemonMethods *self,
     g_paste_daemon_methods_do_add_item (self, g_paste_password_item_new (name, password));
 }
 
+/* What a backup in flight needs to answer its caller: the skeleton to complete
+ * on (and announce the new history through), and the invocation it owes a
+ * reply. */
+typedef struct
+{
+    GPasteDaemon3         *skeleton;
+    GDBusMethodInvocation *invocation;
+} GPasteDaemonMethodsBackup;
+
+static void
+g_paste_daemon_methods_on_history_backed_up (GObject      *source_object,
+                                             GAsyncResult *result,
+                                             gpointer      user_data)
+{
+    g_autofree GPasteDaemonMethodsBackup *backup = user_data;
+    g_autoptr (GError) error = NULL;
+
+    if (!g_paste_history_backup_finish (G_PASTE_HISTORY (source_object), result, &error))
+    {
+        g_dbus_method_invocation_take_error (backup->invocation, g_steal_pointer (&error));
+    }
+    else
+    {
+        /* The current history is not switched away from, and no UI has to be
+         * told it was. What did change is the set of histories, which has a
+         * signal of its own precisely because a new one appearing is not a
+         * switch. */
+        g_paste_daemon3_emit_raw_histories_changed (backup->skeleton);
+        g_paste_daemon3_complete_backup_history (backup->skeleton, backup->invocation);
+    }
+
+    g_object_unref (backup->skeleton);
+}
+
 G_PASTE_VISIBLE void
 g_paste_daemon_methods_backup_history (const GPasteDaemonMethods *self,
                                        const gchar               *history,
                                        const gchar               *backup,
-                                       GError                   **error)
+                                       GDBusMethodInvocation     *invocation)
 {
-    G_PASTE_DBUS_ASSERT (history && backup, G_PASTE_ERROR_INVALID_ARGUMENT, "no history to backup");
-
-    GPasteSettings *settings = self->settings;
+    if (!history || !backup)
+    {
+        g_dbus_method_invocation_return_error_literal (invocation, G_PASTE_ERROR, G_PASTE_ERROR_INVALID_ARGUMENT, "no history to backup");
+        return;
+    }
 
-    /* A history of its own, so the backup never disturbs the current one: the
-     * current history is not switched away from, and no UI has to be told it
-     * was. What did change is the set of histories, which has a signal of its
-     * own precisely because a new one appearing is not a switch. */
-    g_autoptr (GPasteHistory) _history = g_paste_history_new (settings);
+    GPasteDaemonMethodsBackup *data = g_new (GPasteDaemonMethodsBackup, 1);
 
-    g_paste_history_load (_history, history);
-    g_paste_history_save (_history, backup);
+    data->skeleton = g_object_ref (self->skeleton);
+    data->invocation = invocation;
 
-    g_paste_daemon3_emit_raw_histories_changed (self->skeleton);
+    /* A copy of the store, made in the background: a large history backs up at
+     * the cost of the I/O, without the bus waiting on it. */
+    g_paste_history_backup (self->history, history, backup, g_paste_daemon_methods_on_history_backed_up, data);
 }
 
 G_PASTE_VISIBLE void
@@ -200,6 +237,8 @@ g_paste_daemon_methods_empty_history (const GPasteDaemonMethods *self,
     {
         g_autoptr (GPasteHistory) history = g_paste_history_new (self->settings);
 
+        /* Emptied behind the back of the one that may be keeping it. */
+        g_paste_history_forget_recent (self->history, name);
         g_paste_history_save (history, name);
     }
 
@@ -287,6 +326,12 @@ g_paste_daemon_methods_get_history_size (const GPasteDaemonMethods *self,
     if (g_paste_str_equal (name, g_paste_history_get_current (self->history)))
         return g_paste_history_get_length (self->history);
 
+    guint64 length;
+
+    /* A store that can count a history spares reading it in just for that. */
+    if (g_paste_history_count (self->history, name, &length))
+        return length;
+
     g_autoptr (GPasteHistory) history = g_paste_history_new (self->settings);
 
     g_paste_history_load (history, name);
@@ -344,6 +389,18 @@ g_paste_daemon_methods_get_uris (const GPasteDaemonMethods *self,
     return g_paste_uris_item_get_uris (G_PASTE_URIS_ITEM (item));
 }
 
+G_PASTE_VISIBLE const gchar *
+g_paste_daemon_methods_get_value (const GPasteDaemonMethods *self,
+                                  const gchar               *uuid,
+                                  GError                   **error)
+{
+    GPasteItem *item = g_paste_history_get_by_uuid (self->history, uuid);
+
+    G_PASTE_DBUS_ASSERT_FULL (item, G_PASTE_ERROR_NOT_FOUND, "Provided uuid doesn't match any item.", NULL);
+
+    return g_paste_item_get_display_string (item);
+}
+
 G_PASTE_VISIBLE GStrv
 g_paste_daemon_methods_list_histories (const GPasteDaemonMethods *self,
                                        GError                   **error)
@@ -459,6 +516,96 @@ g_paste_daemon_methods_search (const GPasteDaemonMethods *self,
     return g_variant_builder_end (&builder);
 }
 
+static void
+g_paste_daemon_methods_add_hit (GVariantBuilder *builder,
+                                const gchar     *history,
+                                GPasteItem      *item,
+                                gdouble          score)
+{
+    g_variant_builder_add_value (builder, g_variant_new ("(s@" G_PASTE_ITEM_VARIANT_STRING "d)",
+                                                         history,
+                                                         g_paste_daemon_methods_item_variant (item),
+                                                         score));
+}
+
+/* Ranked by the store when it indexes its items; otherwise every history is
+ * searched the way Search does it, reading in the ones not current, and the
+ * matches come in history order, unscored. */
+G_PASTE_VISIBLE GVariant *
+g_paste_daemon_methods_search_all (const GPasteDaemonMethods *self,
+                                   const gchar               *query,
+                                   guint64                    offset,
+                                   guint64                    limit,
+                                   GError                   **error)
+{
+    g_auto (GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_PASTE_SEARCH_HITS_VARIANT_TYPE);
+    g_autoptr (GPtrArray) hits = g_paste_history_search_all (self->history, query, offset, limit);
+
+    if (hits)
+    {
+        for (guint i = 0; i < hits->len; ++i)
+        {
+            GPasteStorageHit *hit = g_ptr_array_index (hits, i);
+
+            g_paste_daemon_methods_add_hit (&builder, hit->history, hit->item, hit->score);
+        }
+
+        return g_variant_builder_end (&builder);
+    }
+
+    g_auto (GStrv) names = g_paste_history_list (self->history, error);
+
+    if (!names)
+        return NULL;
+
+    const gchar *current = g_paste_history_get_current (self->history);
+    guint64 seen = 0;
+    guint64 taken = 0;
+
+    /* The current history first, as it is the one the caller is looking at. */
+    g_autoptr (GStrvBuilder) order = g_strv_builder_new ();
+
+    if (current)
+        g_strv_builder_add (order, current);
+    for (GStrv name = names; *name; ++name)
+    {
+        if (!g_paste_str_equal (*name, current))
+            g_strv_builder_add (order, *name);
+    }
+
+    g_auto (GStrv) ordered = g_strv_builder_end (order);
+
+    for (GStrv name = ordered; *name && (!limit || taken < limit); ++name)
+    {
+        g_autoptr (GPasteHistory) loaded = NULL;
+        GPasteHistory *history = self->history;
+
+        if (!g_paste_str_equal (*name, current))
+        {
+            history = loaded = g_paste_history_new (self->settings);
+            g_paste_history_load (history, *name);
+        }
+
+        g_auto (GStrv) results = g_paste_history_search (history, query);
+
+        if (!results)
+            continue;
+
+        for (GStrv uuid = results; *uuid && (!limit || taken < limit); ++uuid)
+        {
+            GPasteItem *item = g_paste_history_get_by_uuid (history, *uuid);
+
+            if (!item || seen++ < offset)
+                continue;
+
+            g_paste_daemon_methods_add_hit (&builder, *name, item, 0);
+            ++taken;
+        }
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
 G_PASTE_VISIBLE void
 g_paste_daemon_methods_set_favourite (const GPasteDaemonMethods *self,
                                       const gchar               *uuid,
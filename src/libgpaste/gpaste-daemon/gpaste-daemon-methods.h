@@ -44,7 +44,10 @@ typedef struct
 /* The handlers below take the method's arguments as the generated skeleton
  * hands them over, and return what its matching g_paste_daemon3_complete_*()
  * wants. A borrowed const gchar * is one the reply copies before the call
- * returns; a GVariant * is floating and consumed by the completion. */
+ * returns; a GVariant * is floating and consumed by the completion.
+ *
+ * The one exception is g_paste_daemon_methods_backup_history(), which runs in
+ * the background: it takes over @invocation and answers it itself once done. */
 
 void      g_paste_daemon_methods_do_add                     (const GPasteDaemonMethods *self,
                                                              const gchar               *text,
@@ -63,7 +66,7 @@ void      g_paste_daemon_methods_add_password               (const GPasteDaemonM
 void      g_paste_daemon_methods_backup_history             (const GPasteDaemonMethods *self,
                                                              const gchar               *history,
                                                              const gchar               *backup,
-                                                             GError                   **error);
+                                                             GDBusMethodInvocation     *invocation);
 void      g_paste_daemon_methods_delete_item                (const GPasteDaemonMethods *self,
                                                              const gchar               *uuid,
                                                              GError                   **error);
@@ -94,6 +97,9 @@ GVariant *g_paste_daemon_methods_get_items                  (const GPasteDaemonM
 GStrv     g_paste_daemon_methods_get_uris                   (const GPasteDaemonMethods *self,
                                                              const gchar               *uuid,
                                                              GError                   **error);
+const gchar *g_paste_daemon_methods_get_value               (const GPasteDaemonMethods *self,
+                                                             const gchar               *uuid,
+                                                             GError                   **error);
 GStrv     g_paste_daemon_methods_list_histories             (const GPasteDaemonMethods *self,
                                                              GError                   **error);
 void      g_paste_daemon_methods_merge                      (const GPasteDaemonMethods *self,
@@ -108,6 +114,11 @@ void      g_paste_daemon_methods_rename_password            (const GPasteDaemonM
 GVariant *g_paste_daemon_methods_search                     (const GPasteDaemonMethods *self,
                                                              const gchar               *query,
                                                              GError                   **error);
+GVariant *g_paste_daemon_methods_search_all                 (const GPasteDaemonMethods *self,
+                                                             const gchar               *query,
+                                                             guint64                    offset,
+                                                             guint64                    limit,
+                                                             GError                   **error);
 void      g_paste_daemon_methods_select                     (const GPasteDaemonMethods *self,
                                                              const gchar               *uuid,
                                                              GError                   **error);
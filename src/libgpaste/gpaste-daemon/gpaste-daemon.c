@@ -28,12 +28,33 @@ struct _GPasteDaemon
     GPasteClipboardsManager *clipboards_manager;
     GPasteKeybinder         *keybinder;
     GPasteScreensaverClient *screensaver;
+    GMemoryMonitor          *memory_monitor;
 
     GSignalGroup            *history_signals;
     GSignalGroup            *settings_signals;
     GSignalGroup            *screensaver_signals;
+
+    /* When startup began (see g_paste_daemon_set_startup_origin()), and the idle
+     * the clients nothing needs to capture a copy are deferred to. */
+    gint64                   startup_origin;
+    guint                    start_clients_id;
+
+    /* Idle-time maintenance of the storage (see g_paste_daemon_maintain()):
+     * the timer every change rearms, when the run in flight started, and when
+     * the last one to get through everything finished. */
+    guint                    maintenance_id;
+    gint64                   maintenance_started;
+    gint64                   maintained;
 };
 
+/* The clipboard staying untouched that long, in seconds, is the session being
+ * idle enough to tidy the storage up in. */
+#define G_PASTE_DAEMON_MAINTENANCE_QUIET (15 * 60)
+/* How long a run may keep the saver to itself. */
+#define G_PASTE_DAEMON_MAINTENANCE_BUDGET (2 * G_TIME_SPAN_SECOND)
+/* How long a run that got through everything holds until the next one. */
+#define G_PASTE_DAEMON_MAINTENANCE_INTERVAL G_TIME_SPAN_DAY
+
 G_PASTE_DEFINE_TYPE (Daemon, daemon, G_PASTE_TYPE_BUS_OBJECT)
 
 enum
@@ -145,6 +166,76 @@ g_paste_daemon_reload_storage (GPasteDaemon *self)
     g_paste_history_reload_backend (self->history);
 }
 
+/**
+ * g_paste_daemon_export_state:
+ * @self: (transfer none): the #GPasteDaemon
+ *
+ * The history as it stands in memory, for a re-executed daemon to start from
+ * (see g_paste_daemon_new_with_state()) rather than reading it back. Only
+ * meaningful after g_paste_daemon_flush().
+ *
+ * Returns: (transfer full) (nullable): the state of the history, or %NULL
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_daemon_export_state (GPasteDaemon *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_DAEMON (self), NULL);
+
+    return g_paste_history_export_state (self->history);
+}
+
+/**
+ * g_paste_daemon_set_startup_origin:
+ * @self: (transfer none): the #GPasteDaemon
+ * @origin: when startup began, in g_get_monotonic_time() microseconds
+ *
+ * Date the StartupTimings phases from @origin rather than from the creation of
+ * the daemon, for a host that did work of its own before it could build one
+ * (owning the name, settling the storage). Meant to be called right after
+ * creation, before any phase is recorded.
+ */
+G_PASTE_VISIBLE void
+g_paste_daemon_set_startup_origin (GPasteDaemon *self,
+                                   gint64        origin)
+{
+    g_return_if_fail (G_PASTE_IS_DAEMON (self));
+
+    self->startup_origin = origin;
+}
+
+/**
+ * g_paste_daemon_startup_phase:
+ * @self: (transfer none): the #GPasteDaemon
+ * @phase: the name of the phase
+ * @when: when it was reached, in g_get_monotonic_time() microseconds
+ *
+ * Record that startup reached @phase at @when: logged as a debug message, and
+ * added to the StartupTimings property, which maps each phase to the
+ * microseconds it took since the origin. A phase is only reached once: a later
+ * record of the same one (a reload, a re-registration) is not startup and is
+ * ignored.
+ */
+G_PASTE_VISIBLE void
+g_paste_daemon_startup_phase (GPasteDaemon *self,
+                              const gchar  *phase,
+                              gint64        when)
+{
+    g_return_if_fail (G_PASTE_IS_DAEMON (self));
+    g_return_if_fail (phase);
+
+    g_auto (GVariantDict) timings = G_VARIANT_DICT_INIT (g_paste_daemon3_get_startup_timings (self->skeleton));
+
+    if (g_variant_dict_contains (&timings, phase))
+        return;
+
+    guint64 elapsed = MAX (when - self->startup_origin, 0);
+
+    g_debug ("Startup: %s after %.1f ms", phase, elapsed / 1000.);
+
+    g_variant_dict_insert (&timings, phase, "t", elapsed);
+    g_paste_daemon3_set_startup_timings (self->skeleton, g_variant_dict_end (&timings));
+}
+
 /**
  * g_paste_daemon_extension_state_changed:
  * @self: (transfer none): the #GPasteDaemon
@@ -487,7 +578,19 @@ G_PASTE_DAEMON_HANDLER_ERR (add_text, (const gchar *text), (text))
 
 G_PASTE_DAEMON_HANDLER_ERR (add_password, (const gchar *name, const gchar *password), (name, password))
 
-G_PASTE_DAEMON_HANDLER_ERR (backup_history, (const gchar *history, const gchar *backup), (history, backup))
+/* Answered later, by the method itself, once the copy is on disk. */
+static gboolean
+g_paste_daemon_handle_backup_history (GPasteDaemon          *self,
+                                      GDBusMethodInvocation *invocation,
+                                      const gchar           *history,
+                                      const gchar           *backup)
+{
+    const GPasteDaemonMethods methods = G_PASTE_DAEMON_METHODS (self);
+
+    g_paste_daemon_methods_backup_history (&methods, history, backup, invocation);
+
+    return TRUE;
+}
 
 static gboolean
 g_paste_daemon_handle_change_passphrase (GPasteDaemon          *self,
@@ -534,6 +637,10 @@ G_PASTE_DAEMON_HANDLER_RET_ERR (get_uris,
                                 g_auto (GStrv) uris, (const gchar * const *) uris,
                                 (const gchar *uuid), (uuid))
 
+G_PASTE_DAEMON_HANDLER_RET_ERR (get_value,
+                                const gchar *value, value,
+                                (const gchar *uuid), (uuid))
+
 G_PASTE_DAEMON_HANDLER_RET_ERR (list_histories,
                                 g_auto (GStrv) histories, (const gchar * const *) histories,
                                 (), ())
@@ -571,6 +678,10 @@ G_PASTE_DAEMON_HANDLER_RET_ERR (search,
                                 GVariant *results, results,
                                 (const gchar *query), (query))
 
+G_PASTE_DAEMON_HANDLER_RET_ERR (search_all,
+                                GVariant *results, results,
+                                (const gchar *query, guint64 offset, guint64 limit), (query, offset, limit))
+
 G_PASTE_DAEMON_HANDLER_ERR (select, (const gchar *uuid), (uuid))
 
 G_PASTE_DAEMON_HANDLER (set_active, (gboolean active), (active))
@@ -650,6 +761,7 @@ g_paste_daemon_connect_handlers (GPasteDaemon *self)
         { "handle-get-item-at-index",           G_CALLBACK (g_paste_daemon_handle_get_item_at_index)           },
         { "handle-get-items",                   G_CALLBACK (g_paste_daemon_handle_get_items)                   },
         { "handle-get-uris",                    G_CALLBACK (g_paste_daemon_handle_get_uris)                    },
+        { "handle-get-value",                   G_CALLBACK (g_paste_daemon_handle_get_value)                   },
         { "handle-list-histories",              G_CALLBACK (g_paste_daemon_handle_list_histories)              },
         { "handle-merge",                       G_CALLBACK (g_paste_daemon_handle_merge)                       },
         { "handle-reexecute",                   G_CALLBACK (g_paste_daemon_handle_reexecute)                   },
@@ -657,6 +769,7 @@ g_paste_daemon_connect_handlers (GPasteDaemon *self)
         { "handle-replace",                     G_CALLBACK (g_paste_daemon_handle_replace)                     },
         { "handle-report-extension-state",      G_CALLBACK (g_paste_daemon_handle_report_extension_state)      },
         { "handle-search",                      G_CALLBACK (g_paste_daemon_handle_search)                      },
+        { "handle-search-all",                  G_CALLBACK (g_paste_daemon_handle_search_all)                  },
         { "handle-select",                      G_CALLBACK (g_paste_daemon_handle_select)                      },
         { "handle-set-active",                  G_CALLBACK (g_paste_daemon_handle_set_active)                  },
         { "handle-set-favourite",               G_CALLBACK (g_paste_daemon_handle_set_favourite)               },
@@ -691,6 +804,90 @@ g_paste_daemon_unregister_on_connection (GPasteBusObject *self)
     daemon->registered = FALSE;
 }
 
+/*****************/
+/* Maintenance   */
+/*****************/
+
+static void g_paste_daemon_maintain (GPasteDaemon *self);
+
+static void
+g_paste_daemon_on_quiet (gpointer user_data)
+{
+    GPasteDaemon *self = user_data;
+
+    self->maintenance_id = 0;
+    g_paste_daemon_maintain (self);
+}
+
+/* No ref is held: disposing the daemon removes the timeout. */
+static void
+g_paste_daemon_rearm_maintenance (GPasteDaemon *self)
+{
+    g_clear_handle_id (&self->maintenance_id, g_source_remove);
+    self->maintenance_id = g_timeout_add_seconds_once (G_PASTE_DAEMON_MAINTENANCE_QUIET, g_paste_daemon_on_quiet, self);
+    g_source_set_name_by_id (self->maintenance_id, "[GPaste] Maintenance - quiet");
+}
+
+/* What the run did goes in the Maintenance property; one the budget cut short
+ * is picked up after the next quiet spell rather than a day later. */
+static void
+g_paste_daemon_on_maintained (GObject      *source_object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+    g_autoptr (GPasteDaemon) self = user_data; /* ref taken in g_paste_daemon_maintain() */
+    g_autoptr (GError) error = NULL;
+    GPasteStorageMaintenance report;
+    gint64 now = g_get_monotonic_time ();
+    gint64 duration = now - self->maintenance_started;
+
+    self->maintenance_started = 0;
+
+    if (!g_paste_history_maintain_finish (G_PASTE_HISTORY (source_object), result, &report, &error))
+    {
+        g_debug ("Maintenance: skipped: %s", error->message);
+        return;
+    }
+
+    /* Disposed meanwhile: nobody left to tell. */
+    if (!self->skeleton)
+        return;
+
+    if (report.complete)
+        self->maintained = now;
+    else
+        g_paste_daemon_rearm_maintenance (self);
+
+    g_autofree gchar *reclaimed = g_format_size (report.reclaimed);
+    g_auto (GVariantDict) dict = G_VARIANT_DICT_INIT (NULL);
+
+    g_debug ("Maintenance: %" G_GUINT64_FORMAT " histories in %.1f ms, %s reclaimed, %" G_GUINT64_FORMAT " leftovers removed%s",
+             report.histories, duration / 1000., reclaimed, report.orphans, (report.complete) ? "" : ", out of time");
+
+    g_variant_dict_insert (&dict, "finished", "t", (guint64) g_get_real_time ());
+    g_variant_dict_insert (&dict, "duration", "t", (guint64) duration);
+    g_variant_dict_insert (&dict, "histories", "t", report.histories);
+    g_variant_dict_insert (&dict, "reclaimed", "t", report.reclaimed);
+    g_variant_dict_insert (&dict, "orphans", "t", report.orphans);
+    g_variant_dict_insert (&dict, "complete", "t", (guint64) report.complete);
+    g_paste_daemon3_set_maintenance (self->skeleton, g_variant_dict_end (&dict));
+}
+
+/* Tidy the storage up while the session is idle -- the screen locked, or the
+ * clipboard quiet for a while -- unless a run is in flight already, or the
+ * last one got through everything not long ago. */
+static void
+g_paste_daemon_maintain (GPasteDaemon *self)
+{
+    gint64 now = g_get_monotonic_time ();
+
+    if (self->maintenance_started || (self->maintained && now - self->maintained < G_PASTE_DAEMON_MAINTENANCE_INTERVAL))
+        return;
+
+    self->maintenance_started = now;
+    g_paste_history_maintain (self->history, G_PASTE_DAEMON_MAINTENANCE_BUDGET, g_paste_daemon_on_maintained, g_object_ref (self));
+}
+
 static void
 g_paste_daemon_on_history_update (GPasteDaemon      *self,
                                   GPasteUpdateAction action,
@@ -699,17 +896,34 @@ g_paste_daemon_on_history_update (GPasteDaemon      *self,
                                   guint64            position,
                                   gpointer           user_data G_GNUC_UNUSED)
 {
+    /* The first whole-history update is the startup load landing (or, had a
+     * copy beaten it, that copy): the history is usable from there on. */
+    if (action == G_PASTE_UPDATE_ACTION_REPLACE && target == G_PASTE_UPDATE_TARGET_ALL)
+        g_paste_daemon_startup_phase (self, "history", g_get_monotonic_time ());
+
+    g_paste_daemon_rearm_maintenance (self);
     g_paste_daemon_update (self, action, target, uuid, position);
 }
 
 /* Which history is in use is state, so it is a property: the skeleton turns the
- * assignment into the PropertiesChanged a client listens for. */
+ * assignment into the PropertiesChanged a client listens for. So is how the
+ * switches went, counted by the history by the time it announces one. */
 static void
-g_paste_daemon_on_history_switch (GPasteDaemon *self,
-                                  const gchar  *name,
-                                  gpointer      user_data G_GNUC_UNUSED)
+g_paste_daemon_on_history_switch (GPasteDaemon  *self,
+                                  const gchar   *name,
+                                  GPasteHistory *history)
 {
+    guint64 switches, hits, prefetches, prefetch_hits;
+    g_auto (GVariantDict) dict = G_VARIANT_DICT_INIT (NULL);
+
     g_paste_daemon3_set_history (self->skeleton, name);
+
+    g_paste_history_get_switch_stats (history, &switches, &hits, &prefetches, &prefetch_hits);
+    g_variant_dict_insert (&dict, "switches", "t", switches);
+    g_variant_dict_insert (&dict, "hits", "t", hits);
+    g_variant_dict_insert (&dict, "prefetches", "t", prefetches);
+    g_variant_dict_insert (&dict, "prefetch_hits", "t", prefetch_hits);
+    g_paste_daemon3_set_switch_stats (self->skeleton, g_variant_dict_end (&dict));
 }
 
 static void
@@ -742,6 +956,24 @@ g_paste_daemon_on_screensaver_active_changed (GPasteDaemon            *self,
                 g_paste_history_remove (self->history, 0);
         }
     }
+    else
+    {
+        /* Nobody is copying anything while the screen is locked. */
+        g_paste_daemon_maintain (self);
+    }
+}
+
+/* The system runs short of memory: the history lets go of its caches rather
+ * than have the clipboard history push a laptop into swap. */
+static void
+g_paste_daemon_on_low_memory_warning (GPasteDaemon              *self,
+                                      GMemoryMonitorWarningLevel level,
+                                      GMemoryMonitor            *monitor G_GNUC_UNUSED)
+{
+    guint64 freed = g_paste_history_shed_caches (self->history, level);
+    g_autofree gchar *size = g_format_size (freed);
+
+    g_message ("Low memory warning (level %d): freed %s of caches", level, size);
 }
 
 static void
@@ -767,6 +999,13 @@ g_paste_daemon_dispose (GObject *object)
 {
     GPasteDaemon *self = G_PASTE_DAEMON (object);
 
+    g_clear_handle_id (&self->start_clients_id, g_source_remove);
+    g_clear_handle_id (&self->maintenance_id, g_source_remove);
+
+    if (self->memory_monitor)
+        g_signal_handlers_disconnect_by_data (self->memory_monitor, self);
+    g_clear_object (&self->memory_monitor);
+
     if (self->registered)
         g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->skeleton));
 
@@ -881,7 +1120,10 @@ on_screensaver_client_ready (GObject      *source_object G_GNUC_UNUSED,
         g_clear_object (&self->screensaver);
     }
     else if (screensaver)
+    {
         g_signal_group_set_target (self->screensaver_signals, screensaver);
+        g_paste_daemon_startup_phase (self, "screensaver", g_get_monotonic_time ());
+    }
 }
 
 static void
@@ -901,6 +1143,27 @@ on_portal_client_ready (GObject      *source_object G_GNUC_UNUSED,
 
     self->keybinder = g_paste_keybinder_new (self->settings, portal_client);
     g_paste_daemon_activate_default_keybindings (self);
+    g_paste_daemon_startup_phase (self, "shortcuts", g_get_monotonic_time ());
+}
+
+/* Neither the screensaver nor the shortcuts are needed to capture the first
+ * copy, and both are a round trip to another service at the busiest moment of
+ * a login: they wait until the main loop has nothing more urgent to do, which
+ * is after the history load, the clipboards and the bus exports had their turn.
+ * No ref is held: disposing the daemon removes the idle. */
+static gboolean
+g_paste_daemon_start_clients (gpointer user_data)
+{
+    GPasteDaemon *self = user_data;
+
+    self->start_clients_id = 0;
+
+    /* Hold a ref across each async call: the callback owns it (g_autoptr), so the
+     * daemon cannot be finalized out from under the in-flight client creation. */
+    g_paste_screensaver_client_new (on_screensaver_client_ready, g_object_ref (self));
+    g_paste_global_shortcut_client_new (on_portal_client_ready, g_object_ref (self));
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -909,9 +1172,17 @@ g_paste_daemon_init (GPasteDaemon *self)
     /* The skeleton owns the marshalling and the property store; the daemon owns
      * the skeleton. "Version" never changes, so it is set once here; "Active"
      * follows the track-changes setting, and is seeded from it when the
-     * interface is exported (see g_paste_daemon_tracking()). */
+     * interface is exported (see g_paste_daemon_tracking()); "StartupTimings"
+     * starts empty and fills in as startup goes (see
+     * g_paste_daemon_startup_phase()), "Maintenance" stays empty until the
+     * first idle-time maintenance run (see g_paste_daemon_maintain()), and
+     * "SwitchStats" until the history first announces which one is in use. */
     self->skeleton = G_PASTE_DAEMON3 (g_paste_daemon3_skeleton_new ());
     g_paste_daemon3_set_version (self->skeleton, VERSION);
+    g_paste_daemon3_set_startup_timings (self->skeleton, g_variant_new_array (G_VARIANT_TYPE ("{st}"), NULL, 0));
+    g_paste_daemon3_set_maintenance (self->skeleton, g_variant_new_array (G_VARIANT_TYPE ("{st}"), NULL, 0));
+    g_paste_daemon3_set_switch_stats (self->skeleton, g_variant_new_array (G_VARIANT_TYPE ("{st}"), NULL, 0));
+    self->startup_origin = g_get_monotonic_time ();
 
     g_paste_daemon_connect_handlers (self);
 
@@ -940,10 +1211,8 @@ g_paste_daemon_init (GPasteDaemon *self)
                                     G_CALLBACK (g_paste_daemon_on_screensaver_active_changed),
                                     self);
 
-    /* Hold a ref across each async call: the callback owns it (g_autoptr), so the
-     * daemon cannot be finalized out from under the in-flight client creation. */
-    g_paste_screensaver_client_new (on_screensaver_client_ready, g_object_ref (self));
-    g_paste_global_shortcut_client_new (on_portal_client_ready, g_object_ref (self));
+    self->start_clients_id = g_idle_add_full (G_PRIORITY_LOW, g_paste_daemon_start_clients, self, NULL);
+    g_source_set_name_by_id (self->start_clients_id, "[GPaste] Startup - clients");
 }
 
 /**
@@ -965,6 +1234,29 @@ G_PASTE_VISIBLE GPasteDaemon *
 g_paste_daemon_new (GPasteSettings          *settings,
                     GPasteClipboardProvider *clipboard,
                     GPasteClipboardProvider *primary)
+{
+    return g_paste_daemon_new_with_state (settings, clipboard, primary, NULL);
+}
+
+/**
+ * g_paste_daemon_new_with_state:
+ * @settings: (transfer none): the #GPasteSettings shared by the whole daemon
+ * @clipboard: (transfer none): the clipboard selection provider
+ * @primary: (transfer none): the primary selection provider
+ * @state: (nullable): what g_paste_daemon_export_state() returned in the daemon
+ *         this one re-executed
+ *
+ * Like g_paste_daemon_new(), but starting from the history @state holds when
+ * it is still what the store holds (see g_paste_history_load_state_async()).
+ *
+ * Returns: a newly allocated #GPasteDaemon
+ *          free it with g_object_unref
+ */
+G_PASTE_VISIBLE GPasteDaemon *
+g_paste_daemon_new_with_state (GPasteSettings          *settings,
+                               GPasteClipboardProvider *clipboard,
+                               GPasteClipboardProvider *primary,
+                               GVariant                *state)
 {
     g_return_val_if_fail (G_PASTE_IS_SETTINGS (settings), NULL);
     g_return_val_if_fail (G_PASTE_IS_CLIPBOARD_PROVIDER (clipboard), NULL);
@@ -980,7 +1272,16 @@ g_paste_daemon_new (GPasteSettings          *settings,
     g_paste_clipboards_manager_add_clipboard (clipboards_manager, primary);
     g_paste_clipboards_manager_activate (clipboards_manager);
 
-    g_paste_history_load_async (history, NULL);
+    self->memory_monitor = g_memory_monitor_dup_default ();
+    g_signal_connect_swapped (self->memory_monitor,
+                              "low-memory-warning",
+                              G_CALLBACK (g_paste_daemon_on_low_memory_warning),
+                              self);
+
+    if (state)
+        g_paste_history_load_state_async (history, state);
+    else
+        g_paste_history_load_async (history, NULL);
 
     return self;
 }
@@ -17,6 +17,12 @@ void g_paste_daemon_show_history (GPasteDaemon *self,
 void g_paste_daemon_flush        (GPasteDaemon *self);
 void g_paste_daemon_resume       (GPasteDaemon *self);
 void g_paste_daemon_reload_storage (GPasteDaemon *self);
+GVariant *g_paste_daemon_export_state (GPasteDaemon *self);
+void g_paste_daemon_set_startup_origin (GPasteDaemon *self,
+                                        gint64        origin);
+void g_paste_daemon_startup_phase (GPasteDaemon *self,
+                                   const gchar  *phase,
+                                   gint64        when);
 void g_paste_daemon_extension_state_changed (GPasteDaemon *self,
                                              gboolean      state);
 gboolean g_paste_daemon_upload   (GPasteDaemon *self,
@@ -25,6 +31,10 @@ gboolean g_paste_daemon_upload   (GPasteDaemon *self,
 GPasteDaemon *g_paste_daemon_new (GPasteSettings          *settings,
                                   GPasteClipboardProvider *clipboard,
                                   GPasteClipboardProvider *primary);
+GPasteDaemon *g_paste_daemon_new_with_state (GPasteSettings          *settings,
+                                             GPasteClipboardProvider *clipboard,
+                                             GPasteClipboardProvider *primary,
+                                             GVariant                *state);
 
 #ifdef G_PASTE_ENABLE_GNOME_SHELL
 /* @selection is the mutter MetaSelection (global.display.get_selection ()),
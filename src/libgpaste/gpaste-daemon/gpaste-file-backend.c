@@ -9,9 +9,15 @@
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-item.h>
 #include <gpaste-daemon/gpaste-password-item.h>
+#include <gpaste-daemon/gpaste-storage-compression.h>
 #include <gpaste-daemon/gpaste-text-item.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
 
+#ifdef G_OS_UNIX
+#include <errno.h>
+#include <unistd.h>
+#endif
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 #define GCR_API_SUBJECT_TO_CHANGE
 #include <gcr/gcr.h>
@@ -26,6 +32,9 @@ typedef struct
      * extension is used, and password entries are persisted (encrypted) rather
      * than skipped. NULL means a plain ".xml" history. */
     gchar *passphrase;
+    /* Whether the store's key check was already made to agree with the
+     * passphrase, which never changes: see get_output_stream(). */
+    gboolean key_check_settled;
 } GPasteFileBackendPrivate;
 
 G_PASTE_DEFINE_TYPE_WITH_PRIVATE (FileBackend, file_backend, G_PASTE_TYPE_STORAGE_BACKEND)
@@ -82,7 +91,7 @@ g_paste_file_backend_images_dir (const gchar *history_name)
 /**
  * g_paste_file_backend_image_path:
  * @history_name: the name of a history
- * @checksum: the image's SHA256 checksum, which is the image item's value
+ * @checksum: the image's checksum, which is the image item's value
  *
  * Get the file this backend materializes an image in for @history_name:
  * <history-dir>/images/<history_name>/<checksum>.png. Derived rather than
@@ -267,7 +276,7 @@ _g_paste_file_backend_write_image_metadata (GOutputStream   *stream,
         !g_output_stream_write_all (stream, date_str, strlen (date_str), NULL, NULL /* cancellable */, error))
         return FALSE;
 
-    /* The checksum (hex SHA256) needs no XML escaping */
+    /* The checksum (hex digits, and a dash) needs no XML escaping */
     if (checksum &&
         (!g_output_stream_write_all (stream, "\" checksum=\"", 12, NULL, NULL /* cancellable */, error) ||
          !g_output_stream_write_all (stream, checksum, strlen (checksum), NULL, NULL /* cancellable */, error)))
@@ -276,10 +285,57 @@ _g_paste_file_backend_write_image_metadata (GOutputStream   *stream,
     return TRUE;
 }
 
+/* Write one <value> element: @mime names the atom of a special value, NULL
+ * for the item's own value. A payload worth compressing is stored as the
+ * base64 of its compressed bytes, tagged with how they were compressed; one
+ * that is not stays as it always was: readable text for the item's value,
+ * base64 for a special value. */
 static gboolean
-_g_paste_file_backend_write_special_values (GOutputStream *stream,
-                                            const GSList  *special_values,
-                                            GError       **error)
+_g_paste_file_backend_write_value (GOutputStream    *stream,
+                                   const gchar      *mime,
+                                   GPasteCompression compression,
+                                   gconstpointer     data,
+                                   gsize             length,
+                                   GError          **error)
+{
+    gsize compressed_length = 0;
+    g_autofree guchar *compressed = g_paste_storage_compress (compression, data, length, &compressed_length);
+    g_autofree gchar *text = NULL;
+
+    if (compressed)
+        text = g_base64_encode (compressed, compressed_length);
+    else if (mime)
+        text = g_base64_encode (data, length);
+    else
+        text = g_paste_util_xml_encode (data);
+
+    if (!g_output_stream_write_all (stream, "    <value", 10, NULL, NULL /* cancellable */, error) ||
+        (mime &&
+         (!g_output_stream_write_all (stream, " mime=\"", 7, NULL, NULL /* cancellable */, error) ||
+          !g_output_stream_write_all (stream, mime, strlen (mime), NULL, NULL /* cancellable */, error) ||
+          !g_output_stream_write_all (stream, "\"", 1, NULL, NULL /* cancellable */, error))))
+        return FALSE;
+
+    if (compressed)
+    {
+        const gchar *nick = g_enum_get_value (g_type_class_peek (G_PASTE_TYPE_COMPRESSION), compression)->value_nick;
+
+        if (!g_output_stream_write_all (stream, " compression=\"", 14, NULL, NULL /* cancellable */, error) ||
+            !g_output_stream_write_all (stream, nick, strlen (nick), NULL, NULL /* cancellable */, error) ||
+            !g_output_stream_write_all (stream, "\"", 1, NULL, NULL /* cancellable */, error))
+            return FALSE;
+    }
+
+    return g_output_stream_write_all (stream, "><![CDATA[", 10, NULL, NULL /* cancellable */, error) &&
+           g_output_stream_write_all (stream, text, strlen (text), NULL, NULL /* cancellable */, error) &&
+           g_output_stream_write_all (stream, "]]></value>\n", 12, NULL, NULL /* cancellable */, error);
+}
+
+static gboolean
+_g_paste_file_backend_write_special_values (GOutputStream    *stream,
+                                            const GSList     *special_values,
+                                            GPasteCompression compression,
+                                            GError          **error)
 {
     for (const GSList *val = special_values; val; val = val->next)
     {
@@ -295,23 +351,39 @@ _g_paste_file_backend_write_special_values (GOutputStream *stream,
             continue;
         }
 
-        const gchar *mime = gev->value_nick;
-        g_autofree gchar *b64 = g_paste_binary_data_to_base64 (value);
-        g_autofree gchar *text = g_paste_util_xml_encode (b64);
+        gsize length;
+        gconstpointer data = g_bytes_get_data (g_paste_binary_data_get_bytes (value), &length);
 
-        if (!g_output_stream_write_all (stream, "    <value mime=\"", 17, NULL, NULL /* cancellable */, error) ||
-            !g_output_stream_write_all (stream, mime, strlen (mime), NULL, NULL /* cancellable */, error) ||
-            !g_output_stream_write_all (stream, "\"><![CDATA[", 11, NULL, NULL /* cancellable */, error) ||
-            !g_output_stream_write_all (stream, text, strlen (text), NULL, NULL /* cancellable */, error) ||
-            !g_output_stream_write_all (stream, "]]></value>\n", 12, NULL, NULL /* cancellable */, error))
-        {
+        if (!_g_paste_file_backend_write_value (stream, gev->value_nick, compression, data, length, error))
             return FALSE;
-        }
     }
 
     return TRUE;
 }
 
+/* Whether @path is the file an image of @history_name was read from under a
+ * checksum from an older GPaste, which the item has since traded for a
+ * fingerprint (see g_paste_image_item_checksum_is_current()): once the history
+ * is written under the new name, nothing references it any more. A path into
+ * another history's directory is that history's (this is a backup being
+ * written), and stays. */
+static gboolean
+_g_paste_file_backend_image_is_superseded (const gchar *history_name,
+                                           const gchar *path,
+                                           const gchar *reference)
+{
+    if (g_paste_str_equal (path, reference) || !g_str_has_suffix (path, ".png"))
+        return FALSE;
+
+    g_autofree gchar *images_dir = g_paste_file_backend_images_dir (history_name);
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autofree gchar *basename = g_path_get_basename (path);
+
+    basename[strlen (basename) - 4] = '\0';
+
+    return g_paste_str_equal (dir, images_dir) && !g_paste_image_item_checksum_is_current (basename);
+}
+
 static void
 g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
                                          const gchar          *history_name,
@@ -329,10 +401,18 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
     /* An encrypted history keeps password entries (the file is unreadable
      * without the passphrase) and persists their real value, not the mask. */
     gboolean encrypted = g_paste_storage_backend_is_encrypted (self);
+    /* Applied per value, inside the stream the encrypted flavor encrypts. */
+    GPasteCompression compression = g_paste_settings_get_storage_compression (g_paste_storage_backend_get_settings (self));
+
+    if (!g_paste_storage_compression_is_available (compression))
+        compression = G_PASTE_COMPRESSION_NONE;
 
     g_autofree gchar *tmp_path = g_strconcat (history_file_path, ".tmp", NULL);
     g_autoptr (GFile) tmp_file = g_file_new_for_path (tmp_path);
     g_autoptr (GOutputStream) stream = G_PASTE_FILE_BACKEND_GET_CLASS (real_self)->get_output_stream (real_self, tmp_file);
+    /* Files left behind by images whose checksum was upgraded, deleted once
+     * the history no longer naming them is in place. */
+    g_autoptr (GPtrArray) superseded = g_ptr_array_new_with_free_func (g_free);
 
     if (!stream)
         return;
@@ -340,8 +420,13 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
     gboolean success = TRUE;
     g_autoptr (GError) error = NULL;
 
+    /* 2.1 is 2.0 with compressed values: written only when there may be some,
+     * so that a GPaste unable to read them refuses the file rather than taking
+     * their base64 for text. */
     if (!g_output_stream_write_all (stream, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n", 39, NULL, NULL /* cancellable */, &error) ||
-        !g_output_stream_write_all (stream, "<history version=\"2.0\">\n", 24, NULL, NULL /* cancellable */, &error))
+        !g_output_stream_write_all (stream,
+                                    (compression == G_PASTE_COMPRESSION_NONE) ? "<history version=\"2.0\">\n" : "<history version=\"2.1\">\n",
+                                    24, NULL, NULL /* cancellable */, &error))
     {
         g_warning ("Failed to write history header: %s", error->message);
         g_clear_error (&error);
@@ -373,6 +458,14 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
              * image item has -- building one is what computes it. */
             image_reference = g_paste_file_backend_image_path (history_name, g_paste_image_item_get_checksum (image));
             _g_paste_file_backend_ensure_image_file (real_self, image, image_reference);
+
+            /* Only this flavour's own file: the other's belongs to a history
+             * of that flavour (the source of a storage migration in progress)
+             * which may still be reading it. */
+            const gchar *cache_path = g_paste_image_item_get_cache_path (image);
+
+            if (cache_path && _g_paste_file_backend_image_is_superseded (history_name, cache_path, image_reference))
+                g_ptr_array_add (superseded, (encrypted) ? g_paste_file_backend_encrypted_path (cache_path) : g_strdup (cache_path));
         }
 
         const GSList *special_values = g_paste_item_get_special_values (item);
@@ -382,7 +475,7 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
          * own content is the text: get_value only differs from get_real_value
          * for passwords (it masks them), and those are skipped above unless
          * encrypted, so the real value is always what we want to persist. */
-        g_autofree gchar *text = g_paste_util_xml_encode ((image_reference) ? image_reference : g_paste_item_get_real_value (item));
+        const gchar *text = (image_reference) ? image_reference : g_paste_item_get_real_value (item);
 
         if (!g_output_stream_write_all (stream, "  <item kind=\"", 14, NULL, NULL /* cancellable */, &error) ||
             !g_output_stream_write_all (stream, kind_str, strlen (kind_str), NULL, NULL /* cancellable */, &error) ||
@@ -393,10 +486,11 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
             /* Written only when set, so an ordinary history's file is unchanged
              * by the attribute's existence. */
             (g_paste_item_is_favourite (item) && !g_output_stream_write_all (stream, "\" favourite=\"true", 17, NULL, NULL /* cancellable */, &error)) ||
-            !g_output_stream_write_all (stream, "\">\n    <value><![CDATA[", 23, NULL, NULL /* cancellable */, &error) ||
-            !g_output_stream_write_all (stream, text, strlen (text), NULL, NULL /* cancellable */, &error) ||
-            !g_output_stream_write_all (stream, "]]></value>\n", 12, NULL, NULL /* cancellable */, &error) ||
-            (special_values && !_g_paste_file_backend_write_special_values (stream, special_values, &error)) ||
+            !g_output_stream_write_all (stream, "\">\n", 3, NULL, NULL /* cancellable */, &error) ||
+            /* An image's value is a path, which is nothing to compress. */
+            !_g_paste_file_backend_write_value (stream, NULL, (image_reference) ? G_PASTE_COMPRESSION_NONE : compression,
+                                                text, strlen (text), &error) ||
+            (special_values && !_g_paste_file_backend_write_special_values (stream, special_values, compression, &error)) ||
             !g_output_stream_write_all (stream, "  </item>\n", 10, NULL, NULL /* cancellable */, &error))
         {
             g_warning ("Failed to write an item to history: %s", error->message);
@@ -434,6 +528,20 @@ g_paste_file_backend_write_history_file (GPasteStorageBackend *self,
         {
             g_warning ("Failed to delete history temp file: %s", error->message);
         }
+
+        return;
+    }
+
+    /* The items read from these carry their bytes (see add_item), so nothing
+     * in memory needs the files either. */
+    for (guint i = 0; i < superseded->len; ++i)
+    {
+        g_autoptr (GFile) image = g_file_new_for_path (g_ptr_array_index (superseded, i));
+        g_autoptr (GError) delete_error = NULL;
+
+        if (!g_file_delete (image, NULL, &delete_error) &&
+            !g_error_matches (delete_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            g_warning ("Failed to delete superseded image file: %s", delete_error->message);
     }
 }
 
@@ -457,14 +565,15 @@ typedef enum
  * is reset per item, so such an item never makes the next one, which may have
  * no kind of its own, inherit its type. */
 
-/* 2.0 is the only format read. 1.0 -- which held an item's value as text
- * directly inside <item> rather than in a <value> child -- was dropped: it is
- * refused like any other unreadable history, which leaves the file untouched
- * rather than overwriting it, so an ancient history can still be recovered with
- * an older GPaste. */
+/* 2.0 and 2.1, which only adds compressed values, are the formats read. 1.0 --
+ * which held an item's value as text directly inside <item> rather than in a
+ * <value> child -- was dropped: it is refused like any other unreadable
+ * history, which leaves the file untouched rather than overwriting it, so an
+ * ancient history can still be recovered with an older GPaste. */
 typedef enum
 {
     HISTORY_2_0,
+    HISTORY_2_1,
     HISTORY_INVALID = -1
 } HistoryVersion;
 
@@ -488,6 +597,12 @@ typedef struct
     GSList               *special_values;
     HistoryVersion        version;
     GPasteSpecialAtom     mime;
+    GPasteCompression     compression;
+    /* Set when going through the history rather than reading it back: each
+     * item goes to @each instead of @history, and @seen holds the uuids so far. */
+    GFunc                 each;
+    gpointer              each_data;
+    GHashTable           *seen;
 } Data;
 
 /* Where the parser currently is, for a diagnostic. An encrypted history is
@@ -552,10 +667,13 @@ parse_location (GMarkupParseContext *context,
     } while (0)
 
 static gboolean
-history_contains_uuid (const GList *history,
+history_contains_uuid (const Data  *data,
                        const gchar *uuid)
 {
-    for (; history; history = g_list_next (history))
+    if (data->seen)
+        return g_hash_table_contains (data->seen, uuid);
+
+    for (const GList *history = data->history; history; history = g_list_next (history))
     {
         GPasteItem *item = history->data;
 
@@ -585,6 +703,8 @@ start_tag (GMarkupParseContext *context,
             {
                 if (g_paste_str_equal (*v, "2.0"))
                     data->version = HISTORY_2_0;
+                else if (g_paste_str_equal (*v, "2.1"))
+                    data->version = HISTORY_2_1;
                 else
                 {
                     /* Name 1.0 rather than calling it unknown: it is a history
@@ -620,7 +740,7 @@ start_tag (GMarkupParseContext *context,
             }
             else if (g_paste_str_equal (*a, "uuid"))
             {
-                if (g_uuid_string_is_valid (*v) && !history_contains_uuid (data->history, *v))
+                if (g_uuid_string_is_valid (*v) && !history_contains_uuid (data, *v))
                     data->uuid = g_strdup (*v);
             }
             /* An attribute that does not belong to this kind is skipped, not a
@@ -663,6 +783,7 @@ start_tag (GMarkupParseContext *context,
     {
         SWITCH_STATE (IN_ITEM, IN_VALUE);
         data->mime = G_PASTE_SPECIAL_ATOM_INVALID;
+        data->compression = G_PASTE_COMPRESSION_NONE;
         for (const gchar **a = attribute_names, **v = attribute_values; *a && *v; ++a, ++v)
         {
             if (g_paste_str_equal (*a, "mime"))
@@ -673,6 +794,20 @@ start_tag (GMarkupParseContext *context,
                 else
                     WARN_AT ("Unknown mime: %s", *v);
             }
+            else if (g_paste_str_equal (*a, "compression"))
+            {
+                GEnumValue *gev = g_enum_get_value_by_nick (g_type_class_peek (G_PASTE_TYPE_COMPRESSION), *v);
+
+                /* Which makes the value undecodable, and dropped: its text is
+                 * not the value, whatever it turned out to be. */
+                if (gev)
+                    data->compression = gev->value;
+                else
+                {
+                    WARN_AT ("Unknown compression: %s", *v);
+                    data->compression = G_PASTE_N_COMPRESSION;
+                }
+            }
         }
     }
     else
@@ -719,6 +854,19 @@ add_item (Data *data)
              * materialized data actually lives. */
             g_autoptr (GBytes) png = _g_paste_file_backend_load_image_bytes (data->backend, data->text);
 
+            /* A checksum from an older GPaste is traded for a fingerprint, and
+             * with it the file the image is materialized in, the old one being
+             * deleted on the next write: carry the bytes, so the item never
+             * depends on it again. */
+            if (!png && !g_paste_image_item_checksum_is_current (data->checksum))
+            {
+                gchar *contents = NULL;
+                gsize length = 0;
+
+                if (g_file_get_contents (data->text, &contents, &length, NULL))
+                    png = g_bytes_new_take (contents, length);
+            }
+
             item = (png) ? g_paste_image_item_new_from_bytes_at_path (data->text, png, date_time, data->checksum)
                          : g_paste_image_item_new_from_file (data->text, date_time, data->checksum);
         }
@@ -736,7 +884,10 @@ add_item (Data *data)
 
         g_paste_item_set_uuid (item, data->uuid);
         g_paste_item_set_favourite (item, data->favourite);
-        data->history = g_list_append (data->history, item);
+        if (data->seen)
+            g_hash_table_add (data->seen, g_strdup (data->uuid));
+        else
+            data->history = g_list_append (data->history, item);
 
         /* Only the items the cap can actually evict are counted against it: a
          * favourite is read back whatever it costs, or one that had sunk past
@@ -759,6 +910,12 @@ add_item (Data *data)
         data->mem_size += g_paste_item_get_size (item);
 
     g_clear_pointer (&data->special_values, g_slist_free);
+
+    if (item && data->each)
+    {
+        data->each (item, data->each_data);
+        g_object_unref (item);
+    }
 }
 
 static void
@@ -819,13 +976,32 @@ on_text (GMarkupParseContext *context,
             WARN_AT ("Unexpected text in item: %s", txt);
         break;
     case IN_VALUE:
-        if (data->version == HISTORY_2_0)
+        if (data->version != HISTORY_INVALID)
         {
             g_autofree gchar *value = g_paste_util_xml_decode (txt);
             if (*g_strstrip (txt))
             {
                 SWITCH_STATE (IN_VALUE, IN_VALUE_WITH_TEXT);
-                if (data->mime == G_PASTE_SPECIAL_ATOM_INVALID)
+                if (data->compression != G_PASTE_COMPRESSION_NONE)
+                {
+                    gsize packed_length, raw_length;
+                    g_autofree guchar *packed = g_base64_decode (value, &packed_length);
+                    g_autofree guchar *raw = g_paste_storage_decompress (data->compression, packed, packed_length, &raw_length);
+
+                    if (!raw)
+                        WARN_AT ("Could not decompress a value, dropping it");
+                    else if (data->mime != G_PASTE_SPECIAL_ATOM_INVALID)
+                    {
+                        GBytes *bytes = g_bytes_new_take (g_steal_pointer (&raw), raw_length);
+
+                        data->special_values = g_slist_prepend (data->special_values, g_paste_binary_data_new (data->mime, bytes));
+                    }
+                    else if (g_utf8_validate ((const gchar *) raw, raw_length, NULL))
+                        g_set_str_take (&data->text, (gchar *) g_steal_pointer (&raw));
+                    else
+                        WARN_AT ("A decompressed value is not text, dropping it");
+                }
+                else if (data->mime == G_PASTE_SPECIAL_ATOM_INVALID)
                     g_set_str_take (&data->text, g_steal_pointer (&value));
                 else
                 {
@@ -837,7 +1013,7 @@ on_text (GMarkupParseContext *context,
             }
         }
         else
-            WARN_AT ("Unexpected value for history version != 2.0");
+            WARN_AT ("Unexpected value for an unknown history version");
         break;
     default:
         WARN_AT ("Unexpected state: %" G_GINT32_FORMAT, data->state);
@@ -859,6 +1035,37 @@ on_error (GMarkupParseContext *context,
 /* End XML Parser */
 /******************/
 
+/* How much of a history file going through it reads at once. */
+#define G_PASTE_FILE_BACKEND_READ_CHUNK (64 << 10)
+
+/* Open @file for reading, through the decrypting converter for an encrypted
+ * backend: the read-side counterpart of get_output_stream(). */
+static GInputStream *
+g_paste_file_backend_get_input_stream (GPasteStorageBackend *self,
+                                       GFile                *file,
+                                       GError              **error)
+{
+    g_autoptr (GFileInputStream) file_in = g_file_read (file, NULL, error);
+
+    if (!file_in)
+        return NULL;
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    const gchar *passphrase = g_paste_file_backend_get_passphrase (self);
+
+    if (passphrase)
+    {
+        g_autoptr (GConverter) converter = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+
+        return g_converter_input_stream_new (G_INPUT_STREAM (file_in), converter);
+    }
+#else
+    (void) self;
+#endif
+
+    return G_INPUT_STREAM (g_steal_pointer (&file_in));
+}
+
 /* Load the raw history document, transparently decrypting it for an encrypted
  * backend. Returns the (caller-owned) bytes through @text / @text_length. */
 static gboolean
@@ -870,17 +1077,13 @@ g_paste_file_backend_load_contents (GPasteStorageBackend *self,
                                     GError              **error)
 {
 #ifdef G_PASTE_ENABLE_ENCRYPTION
-    const gchar *passphrase = g_paste_file_backend_get_passphrase (self);
-
-    if (passphrase)
+    if (g_paste_file_backend_get_passphrase (self))
     {
-        g_autoptr (GFileInputStream) file_in = g_file_read (history_file, NULL, error);
+        g_autoptr (GInputStream) decrypted = g_paste_file_backend_get_input_stream (self, history_file, error);
 
-        if (!file_in)
+        if (!decrypted)
             return FALSE;
 
-        g_autoptr (GConverter) converter = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
-        g_autoptr (GInputStream) decrypted = g_converter_input_stream_new (G_INPUT_STREAM (file_in), converter);
         g_autoptr (GOutputStream) buffer = g_memory_output_stream_new_resizable ();
 
         if (g_output_stream_splice (buffer, decrypted,
@@ -940,7 +1143,11 @@ g_paste_file_backend_read_history_file (GPasteStorageBackend *self,
             NULL, /* text */
             NULL, /* special_values */
             HISTORY_INVALID,
-            G_PASTE_SPECIAL_ATOM_INVALID
+            G_PASTE_SPECIAL_ATOM_INVALID,
+            G_PASTE_COMPRESSION_NONE,
+            NULL, /* each */
+            NULL, /* each_data */
+            NULL  /* seen */
         };
         g_autoptr (GMarkupParseContext) ctx = g_markup_parse_context_new (&parser,
                                                                           G_MARKUP_TREAT_CDATA_AS_TEXT,
@@ -1017,6 +1224,116 @@ g_paste_file_backend_read_history_file (GPasteStorageBackend *self,
     return TRUE;
 }
 
+/* read_history_file(), parsed as it is read (and decrypted) a chunk at a time,
+ * each item handed over as soon as its </item> is: neither the document nor
+ * the items are ever all in memory. Unlike a read, going through a history
+ * that is not there does not create it. */
+static gboolean
+g_paste_file_backend_foreach_item (GPasteStorageBackend *self,
+                                   const gchar          *name,
+                                   GFunc                 func,
+                                   gpointer              user_data)
+{
+    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
+    g_autofree gchar *history_file_path = g_paste_storage_backend_get_history_file_path (self, name);
+    g_autoptr (GFile) history_file = g_file_new_for_path (history_file_path);
+
+    if (!g_file_query_exists (history_file, NULL /* cancellable */))
+        return TRUE;
+
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GInputStream) stream = g_paste_file_backend_get_input_stream (self, history_file, &error);
+
+    if (!stream)
+    {
+        g_warning ("Failed to read history file: %s", error->message);
+        return FALSE;
+    }
+
+    GMarkupParser parser = {
+        start_tag,
+        end_tag,
+        on_text,
+        NULL,
+        on_error
+    };
+    Data data = {
+        self,
+        history_file_path,
+        NULL,
+        0,
+        BEGIN,
+        G_PASTE_ITEM_KIND_INVALID,
+        0,
+        g_paste_settings_get_max_history_size (settings),
+        g_paste_settings_get_images_support (settings),
+        FALSE,
+        NULL, /* uuid */
+        NULL, /* date */
+        NULL, /* checksum */
+        NULL, /* name */
+        NULL, /* text */
+        NULL, /* special_values */
+        HISTORY_INVALID,
+        G_PASTE_SPECIAL_ATOM_INVALID,
+        G_PASTE_COMPRESSION_NONE,
+        func,
+        user_data,
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL)
+    };
+    g_autoptr (GMarkupParseContext) ctx = g_markup_parse_context_new (&parser,
+                                                                      G_MARKUP_TREAT_CDATA_AS_TEXT,
+                                                                      &data,
+                                                                      NULL);
+    g_autofree gchar *chunk = g_malloc (G_PASTE_FILE_BACKEND_READ_CHUNK);
+    gsize total = 0;
+    gboolean parsed = TRUE;
+
+    for (;;)
+    {
+        gssize len = g_input_stream_read (stream, chunk, G_PASTE_FILE_BACKEND_READ_CHUNK, NULL, &error);
+
+        if (len < 0)
+        {
+            g_warning ("Failed to read history file: %s", error->message);
+            parsed = FALSE;
+            break;
+        }
+
+        if (!len)
+            break;
+
+        total += len;
+
+        if (!g_markup_parse_context_parse (ctx, chunk, len, &error))
+        {
+            g_warning ("Failed to parse history file %s: %s", history_file_path, error->message);
+            parsed = FALSE;
+            break;
+        }
+    }
+
+    /* The empty placeholder is an empty history (see read_history_file()). */
+    if (parsed && total && !g_markup_parse_context_end_parse (ctx, &error))
+    {
+        g_warning ("Failed to parse history file %s: %s", history_file_path, error->message);
+        parsed = FALSE;
+    }
+
+    if (parsed && total && data.state != END)
+        g_warning ("Unexpected state after parsing history %s: %" G_GINT32_FORMAT, history_file_path, data.state);
+
+    g_clear_pointer (&data.uuid, g_free);
+    g_clear_pointer (&data.date, g_free);
+    g_clear_pointer (&data.checksum, g_free);
+    g_clear_pointer (&data.name, g_free);
+    g_clear_pointer (&data.text, g_free);
+    g_clear_slist (&data.special_values, g_object_unref);
+    g_hash_table_unref (data.seen);
+
+    return parsed && (!total || data.version != HISTORY_INVALID);
+}
+
 static void
 g_paste_file_backend_delete_history (GPasteStorageBackend *self,
                                      const gchar          *name,
@@ -1027,6 +1344,184 @@ g_paste_file_backend_delete_history (GPasteStorageBackend *self,
     g_file_delete (history_file, NULL, error);
 }
 
+/* Give @target the image file at @source: a hard link where the filesystem
+ * allows one, a copy otherwise. Sharing the inode is safe because an image file
+ * never changes in place -- it is written once under its checksum and replaced
+ * (a re-key) by renaming a new file over the name. Best effort about a missing
+ * @source, like materialization: a history naming an image whose file is gone
+ * reads back without it either way. */
+static gboolean
+_g_paste_file_backend_share_image (const gchar *source,
+                                   const gchar *target,
+                                   GError     **error)
+{
+    if (g_file_test (target, G_FILE_TEST_EXISTS))
+        return TRUE;
+
+#ifdef G_OS_UNIX
+    if (!link (source, target) || errno == ENOENT)
+        return TRUE;
+#endif
+
+    g_autoptr (GFile) source_file = g_file_new_for_path (source);
+    g_autoptr (GFile) target_file = g_file_new_for_path (target);
+    g_autoptr (GError) copy_error = NULL;
+
+    if (g_file_copy (source_file, target_file, G_FILE_COPY_NONE, NULL, NULL, NULL, &copy_error) ||
+        g_error_matches (copy_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        return TRUE;
+
+    g_propagate_error (error, g_steal_pointer (&copy_error));
+
+    return FALSE;
+}
+
+/* The document is copied line by line, as written by write_history_file(): an
+ * image's <value> is the only line naming a file, the one right after its
+ * <item> line, and it is rewritten from the source's images directory to the
+ * copy's while the file itself is shared there. Nothing is parsed or decoded --
+ * the encrypted flavour only runs the bytes back through its converters -- so
+ * the copy costs the I/O and no more.
+ *
+ * A text value can span lines but never closes its CDATA early (the encoding
+ * escapes '>'), which is what keeps a line inside one from being mistaken for
+ * markup. An image naming a file anywhere else (a legacy shared directory) is
+ * left to the item-by-item copy, which knows how to move it. */
+static gboolean
+g_paste_file_backend_copy_history (GPasteStorageBackend *self,
+                                   const gchar          *name,
+                                   const gchar          *copy,
+                                   GError              **error)
+{
+    GPasteFileBackend *real_self = G_PASTE_FILE_BACKEND (self);
+    gboolean encrypted = g_paste_storage_backend_is_encrypted (self);
+    g_autofree gchar *source_path = g_paste_storage_backend_get_history_file_path (self, name);
+    g_autofree gchar *copy_path = g_paste_storage_backend_get_history_file_path (self, copy);
+    g_autofree gchar *tmp_path = g_strconcat (copy_path, ".tmp", NULL);
+    g_autoptr (GFile) source_file = g_file_new_for_path (source_path);
+    g_autoptr (GFile) copy_file = g_file_new_for_path (copy_path);
+    g_autoptr (GFile) tmp_file = g_file_new_for_path (tmp_path);
+    g_autoptr (GInputStream) in = g_paste_file_backend_get_input_stream (self, source_file, error);
+
+    if (!in)
+        return FALSE;
+
+    g_autoptr (GOutputStream) out = G_PASTE_FILE_BACKEND_GET_CLASS (real_self)->get_output_stream (real_self, tmp_file);
+
+    if (!out)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not open “%s” for writing", tmp_path);
+        return FALSE;
+    }
+
+    g_autoptr (GDataInputStream) lines = g_data_input_stream_new (in);
+    g_autofree gchar *source_images = g_paste_file_backend_images_dir (name);
+    g_autofree gchar *copy_images = g_paste_file_backend_images_dir (copy);
+    g_autofree gchar *source_dir = g_paste_util_xml_encode (source_images);
+    g_autofree gchar *copy_dir = g_paste_util_xml_encode (copy_images);
+    g_autofree gchar *image_tag = g_strconcat ("  <item kind=\"", g_paste_item_kind_to_string (G_PASTE_ITEM_KIND_IMAGE), "\"", NULL);
+    g_autofree gchar *image_value = g_strconcat ("    <value><![CDATA[", source_dir, G_DIR_SEPARATOR_S, NULL);
+    gsize image_value_length = strlen (image_value);
+    gboolean made_images_dir = FALSE;
+    gboolean in_value = FALSE;
+    gboolean image_next = FALSE;
+    gboolean ok = TRUE;
+    g_autoptr (GError) local_error = NULL;
+
+    /* LF only: a text item may hold a lone CR, which must come out as it went in. */
+    g_data_input_stream_set_newline_type (lines, G_DATA_STREAM_NEWLINE_TYPE_LF);
+
+    while (ok)
+    {
+        gsize length = 0;
+        g_autofree gchar *line = g_data_input_stream_read_line (lines, &length, NULL, &local_error);
+        g_autofree gchar *rewritten = NULL;
+
+        if (!line)
+        {
+            ok = !local_error;
+            break;
+        }
+
+        if (in_value)
+        {
+            in_value = !strstr (line, "]]>");
+        }
+        else if (g_str_has_prefix (line, "  <item "))
+        {
+            image_next = g_str_has_prefix (line, image_tag);
+        }
+        else if (g_str_has_prefix (line, "    <value"))
+        {
+            in_value = !strstr (line, "]]>");
+
+            if (image_next)
+            {
+                const gchar *end = strstr (line, "]]>");
+
+                if (!g_str_has_prefix (line, image_value) || !end)
+                {
+                    g_set_error (&local_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                 "An image of “%s” lives outside its images directory", name);
+                    ok = FALSE;
+                    break;
+                }
+
+                g_autofree gchar *file = g_strndup (line + image_value_length, end - (line + image_value_length));
+                g_autofree gchar *suffix = (encrypted) ? g_strconcat (file, "s", NULL) : g_strdup (file);
+                g_autofree gchar *source = g_build_filename (source_images, suffix, NULL);
+                g_autofree gchar *target = g_build_filename (copy_images, suffix, NULL);
+
+                if (!made_images_dir)
+                {
+                    g_autoptr (GFile) dir = g_file_new_for_path (copy_images);
+
+                    made_images_dir = g_file_make_directory_with_parents (dir, NULL, &local_error) ||
+                                      g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS);
+
+                    if (!made_images_dir)
+                    {
+                        ok = FALSE;
+                        break;
+                    }
+
+                    g_clear_error (&local_error);
+                }
+
+                if (!_g_paste_file_backend_share_image (source, target, &local_error))
+                {
+                    ok = FALSE;
+                    break;
+                }
+
+                rewritten = g_strconcat ("    <value><![CDATA[", copy_dir, G_DIR_SEPARATOR_S, file, end, NULL);
+                length = strlen (rewritten);
+            }
+
+            image_next = FALSE;
+        }
+
+        ok = g_output_stream_write_all (out, (rewritten) ? rewritten : line, length, NULL, NULL /* cancellable */, &local_error) &&
+             g_output_stream_write_all (out, "\n", 1, NULL, NULL /* cancellable */, &local_error);
+    }
+
+    ok = ok &&
+         g_output_stream_close (out, NULL /* cancellable */, &local_error) &&
+         g_file_move (tmp_file, copy_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &local_error);
+
+    if (!ok)
+    {
+        /* Best effort: whatever went wrong is what gets reported. The images
+         * already shared stay, referenced or not, like any the copy's next
+         * save would have materialized. */
+        g_output_stream_close (out, NULL, NULL);
+        g_file_delete (tmp_file, NULL, NULL);
+        g_propagate_error (error, g_steal_pointer (&local_error));
+    }
+
+    return ok;
+}
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 /* Re-encrypt one file's bytes from the key @self holds to the one @rekeyed does,
  * into a sibling temporary file whose path is returned through @tmp_path. The
@@ -1085,6 +1580,55 @@ _g_paste_file_backend_reencrypt_file (GPasteStorageBackend *self,
     return TRUE;
 }
 
+/* At most this many files of a history are re-encrypted at once: each holds
+ * its whole plaintext while it is rewritten. */
+#define G_PASTE_FILE_BACKEND_MAX_REKEY_JOBS 4
+
+/* One history's re-key, shared by the jobs running it: @tmps[i] is where the
+ * re-encryption of @paths[i] went, %NULL until it is written and verified. */
+typedef struct
+{
+    GPasteStorageBackend     *self;
+    GPasteStorageBackend     *rekeyed;
+    GStrv                     paths;
+    GStrv                     tmps;
+    GPasteStorageProgressFunc progress;
+    gpointer                  progress_data;
+
+    GMutex                    lock;
+    gboolean                  ok;
+    guint64                   done; /* files re-encrypted so far */
+} GPasteFileBackendRekey;
+
+static void
+_g_paste_file_backend_rekey_job (gpointer data,
+                                 gpointer user_data)
+{
+    guint i = GPOINTER_TO_UINT (data) - 1;
+    GPasteFileBackendRekey *rekey = user_data;
+
+    /* One file failing fails the history: the rest is not worth rewriting. */
+    g_mutex_lock (&rekey->lock);
+    gboolean go = rekey->ok;
+    g_mutex_unlock (&rekey->lock);
+
+    if (!go)
+        return;
+
+    gchar *tmp = NULL;
+    gboolean ok = _g_paste_file_backend_reencrypt_file (rekey->self, rekey->rekeyed, rekey->paths[i], &tmp);
+
+    g_mutex_lock (&rekey->lock);
+    rekey->tmps[i] = tmp;
+    rekey->ok &= ok;
+
+    /* Under the lock, so the counts only ever go up. */
+    if (ok && rekey->progress)
+        rekey->progress (++rekey->done, g_strv_length (rekey->paths), rekey->progress_data);
+
+    g_mutex_unlock (&rekey->lock);
+}
+
 /* Every file of @name that is encrypted: the history itself and the image side
  * files it references, which live in the history's own images directory.
  *
@@ -1135,9 +1679,11 @@ _g_paste_file_backend_encrypted_files (GPasteStorageBackend *self,
  * filter, so changing a passphrase would quietly drop items the user still has.
  * A key change must change nothing but the key. */
 static gboolean
-g_paste_file_backend_rekey (GPasteStorageBackend *self,
-                            const gchar          *name,
-                            const gchar          *new_passphrase)
+g_paste_file_backend_rekey (GPasteStorageBackend     *self,
+                            const gchar              *name,
+                            const gchar              *new_passphrase,
+                            GPasteStorageProgressFunc progress,
+                            gpointer                  user_data)
 {
     if (!g_paste_file_backend_get_passphrase (self))
     {
@@ -1157,27 +1703,47 @@ g_paste_file_backend_rekey (GPasteStorageBackend *self,
     if (!paths || !*paths)
         return FALSE;
 
-    g_autoptr (GStrvBuilder) written = g_strv_builder_new ();
-    gboolean ok = TRUE;
+    /* The files are independent until they are moved into place, so they are
+     * re-encrypted side by side; an image-heavy history is mostly side files. */
+    guint n_paths = g_strv_length (paths);
+    g_auto (GStrv) tmps = g_new0 (gchar *, n_paths + 1);
+    GPasteFileBackendRekey rekey = {
+        .self = self,
+        .rekeyed = rekeyed,
+        .paths = paths,
+        .tmps = tmps,
+        .progress = progress,
+        .progress_data = user_data,
+        .ok = TRUE,
+    };
 
-    for (GStrv path = paths; ok && *path; ++path)
-    {
-        gchar *tmp = NULL;
+    g_mutex_init (&rekey.lock);
 
-        if ((ok = _g_paste_file_backend_reencrypt_file (self, rekeyed, *path, &tmp)))
-            g_strv_builder_take (written, tmp);
-    }
+    /* Not exclusive, so this cannot fail. */
+    GThreadPool *pool = g_thread_pool_new (_g_paste_file_backend_rekey_job, &rekey,
+                                           MIN ((gint) g_get_num_processors (), G_PASTE_FILE_BACKEND_MAX_REKEY_JOBS),
+                                           FALSE, NULL);
+
+    for (guint i = 0; i < n_paths; ++i)
+        g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
 
-    g_auto (GStrv) tmps = g_strv_builder_end (written);
+    /* Waits for every queued file, which is what lets @rekey live here. */
+    g_thread_pool_free (pool, FALSE, TRUE);
+    g_mutex_clear (&rekey.lock);
+
+    gboolean ok = rekey.ok;
 
     if (!ok)
     {
         /* Nothing has moved yet, so dropping the copies puts us back exactly
          * where we started. Best effort: a temporary we fail to remove is
          * clutter, and the originals are intact either way. */
-        for (GStrv tmp = tmps; *tmp; ++tmp)
+        for (guint i = 0; i < n_paths; ++i)
         {
-            g_autoptr (GFile) file = g_file_new_for_path (*tmp);
+            if (!tmps[i])
+                continue;
+
+            g_autoptr (GFile) file = g_file_new_for_path (tmps[i]);
 
             g_file_delete (file, NULL, NULL);
         }
@@ -1205,6 +1771,115 @@ g_paste_file_backend_rekey (GPasteStorageBackend *self,
 }
 #endif
 
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+/* The store's key check: what every encrypted history was last found to be
+ * keyed with (see store_confirms_passphrase), beside them under a name that
+ * no history can have. */
+static gchar *
+_g_paste_file_backend_key_check_path (void)
+{
+    g_autofree gchar *dir = g_paste_util_get_history_dir_path ();
+
+    return g_build_filename (dir, "xmls.key-check", NULL);
+}
+
+/* Whether the store's key check was made for the passphrase of @self. @present
+ * says whether there is one at all: one that cannot be read back or trusted is
+ * there, and vouches for nothing. */
+static gboolean
+_g_paste_file_backend_key_check_matches (GPasteStorageBackend *self,
+                                         gboolean             *present)
+{
+    g_autofree gchar *path = _g_paste_file_backend_key_check_path ();
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+    g_autoptr (GError) error = NULL;
+
+    *present = g_file_test (path, G_FILE_TEST_EXISTS);
+
+    if (!*present)
+        return FALSE;
+
+    if (!g_file_get_contents (path, &contents, &length, &error))
+    {
+        g_warning ("Could not read the key check of the encrypted histories: %s", error->message);
+        return FALSE;
+    }
+
+    g_autoptr (GBytes) check = g_bytes_new_take (g_steal_pointer (&contents), length);
+    gboolean matches = FALSE;
+
+    if (!g_paste_secret_stream_key_check_match (g_paste_file_backend_get_passphrase (self), check, &matches, &error))
+    {
+        g_warning ("Ignoring the key check of the encrypted histories: %s", error->message);
+        return FALSE;
+    }
+
+    return matches;
+}
+
+/* Anything written under a passphrase the key check was not made for turns it
+ * into a lie, which would then vouch for a passphrase a history no longer
+ * takes: drop it before writing, and let the next verification go through the
+ * histories again. Once per backend, its passphrase being fixed; a re-key
+ * writes from several threads at once, which may all get here first, and
+ * settling is idempotent, so only the flag needs to be atomic. */
+static gboolean
+_g_paste_file_backend_settle_key_check (GPasteFileBackend *self)
+{
+    GPasteFileBackendPrivate *priv = g_paste_file_backend_get_instance_private (self);
+    gboolean present;
+
+    if (g_atomic_int_get (&priv->key_check_settled))
+        return TRUE;
+
+    if (!_g_paste_file_backend_key_check_matches (G_PASTE_STORAGE_BACKEND (self), &present) && present)
+    {
+        g_autofree gchar *path = _g_paste_file_backend_key_check_path ();
+        g_autoptr (GFile) file = g_file_new_for_path (path);
+        g_autoptr (GError) error = NULL;
+
+        if (!g_file_delete (file, NULL, &error) && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+            g_warning ("Could not drop the key check of the encrypted histories: %s", error->message);
+            return FALSE;
+        }
+    }
+
+    g_atomic_int_set (&priv->key_check_settled, TRUE);
+
+    return TRUE;
+}
+
+/* See the vfunc: one derivation, whatever the number of histories. */
+static gboolean
+g_paste_file_backend_store_confirms_passphrase (GPasteStorageBackend *self)
+{
+    gboolean present;
+
+    return _g_paste_file_backend_key_check_matches (self, &present);
+}
+
+static void
+g_paste_file_backend_store_passphrase_confirmed (GPasteStorageBackend *self)
+{
+    g_autoptr (GError) error = NULL;
+
+    if (!g_paste_util_ensure_history_dir_exists ())
+        return;
+
+    g_autoptr (GBytes) check = g_paste_secret_stream_key_check_new (g_paste_file_backend_get_passphrase (self), &error);
+    g_autofree gchar *path = _g_paste_file_backend_key_check_path ();
+    gsize length = 0;
+    const gchar *data = (check) ? g_bytes_get_data (check, &length) : NULL;
+
+    /* Best effort: without it, the next verification asks every history again. */
+    if (!check || !g_file_set_contents_full (path, data, (gssize) length,
+                                             G_FILE_SET_CONTENTS_CONSISTENT, 0600, &error))
+        g_warning ("Could not write the key check of the encrypted histories: %s", error->message);
+}
+#endif
+
 static GPasteStorage
 g_paste_file_backend_get_kind (GPasteStorageBackend *self)
 {
@@ -1216,6 +1891,14 @@ g_paste_file_backend_get_output_stream (GPasteFileBackend *self G_GNUC_UNUSED,
                                         GFile             *output_file)
 {
     g_autoptr (GError) error = NULL;
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    /* A write that would leave a stale key check behind is no write at all. */
+    if (g_paste_file_backend_get_passphrase (G_PASTE_STORAGE_BACKEND (self)) &&
+        !_g_paste_file_backend_settle_key_check (self))
+        return NULL;
+#endif
+
     GOutputStream *stream = G_OUTPUT_STREAM (g_file_replace (output_file,
                                                               NULL,
                                                               FALSE,
@@ -1305,22 +1988,128 @@ g_paste_file_backend_drop_item_data (GPasteStorageBackend *self G_GNUC_UNUSED,
         g_paste_file_backend_delete_image (cache_path);
 }
 
+/* How long, in seconds, a file nothing references has to have been left alone
+ * before it is taken for a leftover: a write in flight (from a saver being
+ * replaced, say) materializes its images before the history naming them. */
+#define G_PASTE_FILE_BACKEND_LEFTOVER_AGE (60 * 60)
+
+/* Remove @path if it has been left alone long enough, counting it in @report. */
+static void
+_g_paste_file_backend_remove_leftover (const gchar              *path,
+                                       GPasteStorageMaintenance *report)
+{
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    g_autoptr (GFileInfo) info = g_file_query_info (file,
+                                                    G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                    NULL, NULL);
+
+    if (!info)
+        return;
+
+    gint64 modified = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+    if (g_get_real_time () / G_USEC_PER_SEC - modified < G_PASTE_FILE_BACKEND_LEFTOVER_AGE)
+        return;
+
+    g_autoptr (GError) error = NULL;
+
+    if (!g_file_delete (file, NULL, &error))
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            g_warning ("Failed to delete leftover %s: %s", path, error->message);
+        return;
+    }
+
+    ++report->orphans;
+    report->reclaimed += g_file_info_get_size (info);
+}
+
+/* The history file is rewritten whole on every write, so there is no journal
+ * to fold back into it: what is left to tidy is what a write that died half
+ * way left behind -- its temporary file, and the images it materialized for a
+ * history that never got to name them. An image of this flavour is a leftover
+ * when the history file does not name it; the other flavour's files are its
+ * own history's business. A history file that cannot be read says nothing
+ * about which images it names, so nothing is removed then. */
+static gboolean
+g_paste_file_backend_maintain (GPasteStorageBackend     *self,
+                               const gchar              *name,
+                               gint64                    deadline,
+                               GPasteStorageMaintenance *report)
+{
+    g_autofree gchar *history_file_path = g_paste_storage_backend_get_history_file_path (self, name);
+    g_autofree gchar *tmp_path = g_strconcat (history_file_path, ".tmp", NULL);
+
+    _g_paste_file_backend_remove_leftover (tmp_path, report);
+
+    g_autofree gchar *images_dir = g_paste_file_backend_images_dir (name);
+    g_autoptr (GFile) dir = g_file_new_for_path (images_dir);
+    g_autoptr (GError) error = NULL;
+    g_auto (GStrv) images = g_paste_util_list_directory (dir, G_FILE_ATTRIBUTE_STANDARD_NAME, &error);
+
+    if (!images || !*images || !g_file_test (history_file_path, G_FILE_TEST_EXISTS))
+        return TRUE;
+
+    g_autoptr (GFile) history_file = g_file_new_for_path (history_file_path);
+    g_autofree gchar *text = NULL;
+    gsize text_length;
+
+    if (!g_paste_file_backend_load_contents (self, history_file_path, history_file, &text, &text_length, &error))
+    {
+        g_debug ("Not looking for leftover images of “%s”: %s", name, error->message);
+        return TRUE;
+    }
+
+    gboolean encrypted = g_paste_storage_backend_is_encrypted (self);
+
+    for (GStrv image = images; *image; ++image)
+    {
+        if (g_get_monotonic_time () >= deadline)
+            return FALSE;
+
+        if (!g_str_has_suffix (*image, (encrypted) ? ".pngs" : ".png"))
+            continue;
+
+        /* The history names the canonical path, which the encrypted side
+         * file is named after. */
+        g_autofree gchar *reference = g_strconcat (G_DIR_SEPARATOR_S, *image, NULL);
+
+        if (encrypted)
+            reference[strlen (reference) - 1] = '\0';
+
+        if (!g_strstr_len (text, text_length, reference))
+        {
+            g_autofree gchar *path = g_build_filename (images_dir, *image, NULL);
+
+            _g_paste_file_backend_remove_leftover (path, report);
+        }
+    }
+
+    return TRUE;
+}
+
 static void
 g_paste_file_backend_class_init (GPasteFileBackendClass *klass)
 {
     GPasteStorageBackendClass *storage_class = G_PASTE_STORAGE_BACKEND_CLASS (klass);
 
     storage_class->read_history_file = g_paste_file_backend_read_history_file;
+    storage_class->foreach_item = g_paste_file_backend_foreach_item;
     storage_class->write_history_file = g_paste_file_backend_write_history_file;
     storage_class->get_kind = g_paste_file_backend_get_kind;
     storage_class->delete_history = g_paste_file_backend_delete_history;
     storage_class->drop_item_data = g_paste_file_backend_drop_item_data;
+    storage_class->copy_history = g_paste_file_backend_copy_history;
+    storage_class->maintain = g_paste_file_backend_maintain;
 
     klass->get_output_stream = g_paste_file_backend_get_output_stream;
 
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     storage_class->rekey = g_paste_file_backend_rekey;
     storage_class->history_refutes_passphrase = g_paste_file_backend_history_refutes_passphrase;
+    storage_class->store_confirms_passphrase = g_paste_file_backend_store_confirms_passphrase;
+    storage_class->store_passphrase_confirmed = g_paste_file_backend_store_passphrase_confirmed;
 
     G_OBJECT_CLASS (klass)->finalize = g_paste_file_backend_finalize;
 #endif
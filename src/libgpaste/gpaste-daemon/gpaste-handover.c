@@ -0,0 +1,445 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+/* memfd_create, the file seals and explicit_bzero */
+#define _GNU_SOURCE
+
+#include <gpaste-daemon/gpaste-binary-data.h>
+#include <gpaste-daemon/gpaste-color-item.h>
+#include <gpaste-daemon/gpaste-handover.h>
+#include <gpaste-daemon/gpaste-image-item.h>
+#include <gpaste-daemon/gpaste-password-item.h>
+#include <gpaste-daemon/gpaste-special-atom.h>
+#include <gpaste-daemon/gpaste-text-item.h>
+#include <gpaste-daemon/gpaste-uris-item.h>
+
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/* Where the successor finds the descriptor of the state. */
+#define G_PASTE_HANDOVER_ENV "GPASTE_HANDOVER_FD"
+
+/* What a state may weigh: the memory cap of a history is far below it, so a
+ * bigger one is not ours. */
+#define G_PASTE_HANDOVER_MAX_SIZE (G_GSIZE_CONSTANT (1) << 31)
+
+/****************/
+/* Items        */
+/****************/
+
+static GVariant *
+g_paste_handover_pack_item (GPasteItem *item,
+                            GEnumClass *atoms)
+{
+    g_auto (GVariantDict) extras = G_VARIANT_DICT_INIT (NULL);
+
+    if (G_PASTE_IS_PASSWORD_ITEM (item))
+        g_variant_dict_insert (&extras, "name", "s", g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM (item)));
+
+    if (G_PASTE_IS_IMAGE_ITEM (item))
+    {
+        GPasteImageItem *image = G_PASTE_IMAGE_ITEM (item);
+        const gchar *path = g_paste_image_item_get_cache_path (image);
+        GBytes *png = g_paste_image_item_get_png_bytes (image);
+
+        g_variant_dict_insert (&extras, "date", "x", g_date_time_to_unix ((GDateTime *) g_paste_image_item_get_date (image)));
+        g_variant_dict_insert (&extras, "checksum", "s", g_paste_image_item_get_checksum (image));
+        if (path)
+            g_variant_dict_insert (&extras, "path", "s", path);
+        if (png)
+            g_variant_dict_insert_value (&extras, "png", g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, png, TRUE));
+    }
+
+    const GSList *special_values = g_paste_item_get_special_values (item);
+
+    if (special_values)
+    {
+        g_auto (GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(say)"));
+
+        for (const GSList *v = special_values; v; v = v->next)
+        {
+            GPasteBinaryData *value = v->data;
+            GEnumValue *gev = g_enum_get_value (atoms, g_paste_binary_data_get_mime (value));
+
+            if (gev)
+                g_variant_builder_add (&builder, "(s@ay)", gev->value_nick,
+                                       g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, g_paste_binary_data_get_bytes (value), TRUE));
+        }
+
+        g_variant_dict_insert_value (&extras, "special", g_variant_builder_end (&builder));
+    }
+
+    return g_variant_new ("(sssb@a{sv})",
+                          g_paste_item_kind_to_string (g_paste_item_get_kind (item)),
+                          g_paste_item_get_uuid (item),
+                          g_paste_item_get_real_value (item),
+                          g_paste_item_is_favourite (item),
+                          g_variant_dict_end (&extras));
+}
+
+/**
+ * g_paste_handover_pack_items:
+ * @items: (element-type GPasteItem): the items of a history, newest first
+ *
+ * Pack @items for g_paste_handover_unpack_items() to rebuild in the successor.
+ *
+ * Returns: (transfer full): the items, as a %G_PASTE_HANDOVER_ITEMS_TYPE #GVariant
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_handover_pack_items (const GList *items)
+{
+    GEnumClass *atoms = g_type_class_ref (G_PASTE_TYPE_SPECIAL_ATOM);
+    g_auto (GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE (G_PASTE_HANDOVER_ITEMS_TYPE));
+
+    for (const GList *i = items; i; i = i->next)
+        g_variant_builder_add_value (&builder, g_paste_handover_pack_item (i->data, atoms));
+
+    g_type_class_unref (atoms);
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static GPasteItem *
+g_paste_handover_unpack_image (const gchar  *value,
+                               GVariantDict *extras)
+{
+    gint64 date;
+    const gchar *checksum;
+
+    if (!g_variant_dict_lookup (extras, "date", "x", &date) ||
+        !g_variant_dict_lookup (extras, "checksum", "&s", &checksum))
+        return NULL;
+
+    g_autoptr (GDateTime) date_time = g_date_time_new_from_unix_local (date);
+    g_autoptr (GVariant) png = g_variant_dict_lookup_value (extras, "png", G_VARIANT_TYPE_BYTESTRING);
+    const gchar *path = NULL;
+
+    g_variant_dict_lookup (extras, "path", "&s", &path);
+
+    if (!png)
+        return g_paste_image_item_new_from_file ((path) ? path : value, date_time, checksum);
+
+    g_autoptr (GBytes) bytes = g_variant_get_data_as_bytes (png);
+
+    return (path) ? g_paste_image_item_new_from_bytes_at_path (path, bytes, date_time, checksum)
+                  : g_paste_image_item_new_from_bytes (bytes, date_time, checksum);
+}
+
+static GPasteItem *
+g_paste_handover_unpack_item (GVariant   *packed,
+                              GEnumClass *atoms)
+{
+    const gchar *kind, *uuid, *value;
+    gboolean favourite;
+    g_autoptr (GVariant) extras_value = NULL;
+
+    g_variant_get (packed, "(&s&s&sb@a{sv})", &kind, &uuid, &value, &favourite, &extras_value);
+
+    g_auto (GVariantDict) extras;
+    g_variant_dict_init (&extras, extras_value);
+
+    GPasteItem *item = NULL;
+
+    switch (g_paste_item_kind_from_string (kind))
+    {
+    case G_PASTE_ITEM_KIND_TEXT:
+        item = g_paste_text_item_new (value);
+        break;
+    case G_PASTE_ITEM_KIND_URIS:
+        item = g_paste_uris_item_new_from_str (value);
+        break;
+    case G_PASTE_ITEM_KIND_PASSWORD:
+    {
+        const gchar *name = NULL;
+
+        g_variant_dict_lookup (&extras, "name", "&s", &name);
+        item = g_paste_password_item_new (name, value);
+        break;
+    }
+    case G_PASTE_ITEM_KIND_COLOR:
+        item = g_paste_color_item_new_from_str (value);
+        break;
+    case G_PASTE_ITEM_KIND_IMAGE:
+        item = g_paste_handover_unpack_image (value, &extras);
+        break;
+    case G_PASTE_ITEM_KIND_INVALID:
+        break;
+    }
+
+    if (!item)
+        return NULL;
+
+    g_paste_item_set_uuid (item, uuid);
+    g_paste_item_set_favourite (item, favourite);
+
+    g_autoptr (GVariant) special = g_variant_dict_lookup_value (&extras, "special", G_VARIANT_TYPE ("a(say)"));
+
+    /* add_special_value prepends, so going through them backwards keeps their
+     * order. */
+    for (gsize i = (special) ? g_variant_n_children (special) : 0; i; --i)
+    {
+        const gchar *mime;
+        g_autoptr (GVariant) data = NULL;
+
+        g_variant_get_child (special, i - 1, "(&s@ay)", &mime, &data);
+
+        GEnumValue *gev = g_enum_get_value_by_nick (atoms, mime);
+
+        if (gev && g_variant_get_size (data))
+            g_paste_item_add_special_value (item, g_paste_binary_data_new (gev->value, g_variant_get_data_as_bytes (data)));
+    }
+
+    return item;
+}
+
+/**
+ * g_paste_handover_unpack_items:
+ * @items: what g_paste_handover_pack_items() packed
+ * @size: (out): the size the items take
+ *
+ * Rebuild the items packed by a predecessor. One that cannot be rebuilt is
+ * left out, the way a storage backend skips an item it cannot read back.
+ *
+ * Returns: (transfer full) (element-type GPasteItem): the items, newest first
+ */
+G_PASTE_VISIBLE GList *
+g_paste_handover_unpack_items (GVariant *items,
+                               gsize    *size)
+{
+    g_return_val_if_fail (g_variant_is_of_type (items, G_VARIANT_TYPE (G_PASTE_HANDOVER_ITEMS_TYPE)), NULL);
+    g_return_val_if_fail (size, NULL);
+
+    GEnumClass *atoms = g_type_class_ref (G_PASTE_TYPE_SPECIAL_ATOM);
+    GList *history = NULL;
+    GVariantIter iter;
+    GVariant *packed;
+
+    *size = 0;
+    g_variant_iter_init (&iter, items);
+
+    while ((packed = g_variant_iter_next_value (&iter)))
+    {
+        GPasteItem *item = g_paste_handover_unpack_item (packed, atoms);
+
+        if (item)
+        {
+            *size += g_paste_item_get_size (item);
+            history = g_list_prepend (history, item);
+        }
+
+        g_variant_unref (packed);
+    }
+
+    g_type_class_unref (atoms);
+
+    return g_list_reverse (history);
+}
+
+/****************/
+/* Transport    */
+/****************/
+
+#ifdef __linux__
+#define G_PASTE_HANDOVER_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+/* The state can hold a passphrase and passwords: leave nothing of it behind. */
+static void
+g_paste_handover_wipe (gpointer data,
+                       gsize    length)
+{
+    explicit_bzero (data, length);
+    g_free (data);
+}
+
+static gboolean
+g_paste_handover_write (gint          fd,
+                        gconstpointer data,
+                        gsize         length)
+{
+    gsize written = 0;
+
+    while (written < length)
+    {
+        gssize ret = write (fd, (const guchar *) data + written, length - written);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return FALSE;
+
+        written += ret;
+    }
+
+    return TRUE;
+}
+
+typedef struct
+{
+    gpointer data;
+    gsize    length;
+} GPasteHandoverBuffer;
+
+static void
+g_paste_handover_buffer_free (gpointer data)
+{
+    g_autofree GPasteHandoverBuffer *buffer = data;
+
+    g_paste_handover_wipe (buffer->data, buffer->length);
+}
+#endif
+
+/**
+ * g_paste_handover_send:
+ * @state: the state to hand over, an "a{sv}" #GVariant
+ * @error: return location for a #GError, or %NULL
+ *
+ * Write @state to a sealed memfd that the next exec inherits, and tell the
+ * successor where to find it. Call g_paste_handover_cancel() with what this
+ * returns if the exec does not happen after all.
+ *
+ * Returns: the descriptor of the state, or -1 on error
+ */
+G_PASTE_VISIBLE gint
+g_paste_handover_send (GVariant *state,
+                       GError  **error)
+{
+    g_return_val_if_fail (g_variant_is_of_type (state, G_VARIANT_TYPE_VARDICT), -1);
+
+#ifdef __linux__
+    gsize length = g_variant_get_size (state);
+    gpointer data = g_malloc (length);
+
+    g_variant_store (state, data);
+
+    /* No MFD_CLOEXEC: the exec is the whole point. */
+    gint fd = memfd_create ("gpaste-handover", MFD_ALLOW_SEALING);
+    /* Sealed, whatever happens to us now the successor reads what we wrote. */
+    gboolean ok = (fd >= 0 &&
+                   g_paste_handover_write (fd, data, length) &&
+                   fcntl (fd, F_ADD_SEALS, G_PASTE_HANDOVER_SEALS | F_SEAL_SEAL) == 0);
+    gint saved_errno = errno;
+
+    g_paste_handover_wipe (data, length);
+
+    if (!ok)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     "Could not prepare the handover: %s", g_strerror (saved_errno));
+        if (fd >= 0)
+            close (fd);
+        return -1;
+    }
+
+    g_autofree gchar *fd_str = g_strdup_printf ("%d", fd);
+
+    g_setenv (G_PASTE_HANDOVER_ENV, fd_str, TRUE);
+
+    return fd;
+#else
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "No handover on this platform");
+
+    return -1;
+#endif
+}
+
+/**
+ * g_paste_handover_cancel:
+ * @fd: what g_paste_handover_send() returned
+ *
+ * Drop a handover whose exec failed, so that a later one does not hand over
+ * this stale state.
+ */
+G_PASTE_VISIBLE void
+g_paste_handover_cancel (gint fd)
+{
+    g_unsetenv (G_PASTE_HANDOVER_ENV);
+
+#ifdef __linux__
+    if (fd >= 0)
+        close (fd);
+#endif
+}
+
+/**
+ * g_paste_handover_receive:
+ *
+ * Take the state a predecessor handed over with g_paste_handover_send(), if
+ * any. Called once, early: the descriptor is closed and forgotten whatever
+ * becomes of the state, so no child of ours inherits it.
+ *
+ * Returns: (transfer full) (nullable): the state, an "a{sv}" #GVariant, or
+ *          %NULL when there is none or it cannot be trusted
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_handover_receive (void)
+{
+    const gchar *fd_str = g_getenv (G_PASTE_HANDOVER_ENV);
+
+    if (!fd_str)
+        return NULL;
+
+    guint64 fd_value = 0;
+    gboolean valid = g_ascii_string_to_unsigned (fd_str, 10, 3, G_MAXINT, &fd_value, NULL);
+
+    g_unsetenv (G_PASTE_HANDOVER_ENV);
+
+    if (!valid)
+        return NULL;
+
+#ifdef __linux__
+    gint fd = (gint) fd_value;
+    struct stat st;
+
+    /* Only a fully sealed state is one nobody could have changed under us. */
+    if ((fcntl (fd, F_GET_SEALS) & G_PASTE_HANDOVER_SEALS) != G_PASTE_HANDOVER_SEALS ||
+        fstat (fd, &st) < 0 || st.st_size <= 0 || (gsize) st.st_size > G_PASTE_HANDOVER_MAX_SIZE)
+    {
+        g_warning ("Ignoring an invalid handover");
+        close (fd);
+        return NULL;
+    }
+
+    GPasteHandoverBuffer *buffer = g_new (GPasteHandoverBuffer, 1);
+    gsize got = 0;
+
+    buffer->length = st.st_size;
+    buffer->data = g_malloc (buffer->length);
+
+    while (got < buffer->length)
+    {
+        gssize ret = pread (fd, (guchar *) buffer->data + got, buffer->length - got, got);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+
+        got += ret;
+    }
+
+    close (fd);
+
+    if (got < buffer->length)
+    {
+        g_warning ("Could not read the handover back");
+        g_paste_handover_buffer_free (buffer);
+        return NULL;
+    }
+
+    g_autoptr (GBytes) bytes = g_bytes_new_with_free_func (buffer->data, buffer->length, g_paste_handover_buffer_free, buffer);
+
+    /* Not trusted: each access checks what it reads. */
+    return g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+#else
+    return NULL;
+#endif
+}
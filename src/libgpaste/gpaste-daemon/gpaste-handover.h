@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+#include <gpaste-daemon/gpaste-item.h>
+
+G_BEGIN_DECLS
+
+/* Handing a re-executed daemon what its predecessor held in memory, so it does
+ * not have to read (and decrypt) it all back. The state is a #GVariant written
+ * to a sealed memfd the exec inherits, its descriptor passed along in the
+ * environment: nothing touches the disk, and nothing but the successor can see
+ * it. It is only ever a shortcut: a successor that finds no state, or one it
+ * cannot trust, loads the history as it would have anyway. */
+
+/* Bumped whenever the layout of the state changes: a successor only takes the
+ * state of a predecessor that speaks its own version. */
+#define G_PASTE_HANDOVER_VERSION 1
+
+/* The items of a history, newest first: kind, uuid, value, favourite, and
+ * whatever else rebuilding that kind of item takes. */
+#define G_PASTE_HANDOVER_ITEMS_TYPE "a(sssba{sv})"
+
+/* The state of a history (see g_paste_history_export_state()): its name, the
+ * stamp of its store (see g_paste_storage_backend_dup_stamp()), its resident
+ * limit and cold length, and its items. */
+#define G_PASTE_HANDOVER_HISTORY_TYPE "(sstt" G_PASTE_HANDOVER_ITEMS_TYPE ")"
+
+GVariant *g_paste_handover_pack_items   (const GList *items);
+GList    *g_paste_handover_unpack_items (GVariant    *items,
+                                         gsize       *size);
+
+gint      g_paste_handover_send    (GVariant *state,
+                                    GError  **error);
+void      g_paste_handover_cancel  (gint      fd);
+GVariant *g_paste_handover_receive (void);
+
+G_END_DECLS
@@ -1,7 +1,9 @@
 // SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
 // SPDX-License-Identifier: BSD-2-Clause
 
+#include <gpaste-daemon/gpaste-handover.h>
 #include <gpaste-daemon/gpaste-history-saver.h>
+#include <gpaste-daemon/gpaste-item.h>
 
 #include <gio/gio.h>
 
@@ -24,11 +26,14 @@ struct _GPasteHistorySaver
     GPasteStorageBackend        *backend;
     gpointer                     owner; /* not ref'd: owns us, outlives us */
     GPasteHistorySaverLoadedFunc loaded;
+    GPasteHistorySaverPageFunc   paged;
 
     gboolean                     write_in_progress;
     /* Pending writes (GPasteHistorySaverWrite*), applied in order. With a
      * non-incremental backend each entry is a full rewrite, so the queue is
-     * coalesced down to the latest snapshot and never holds more than one. */
+     * coalesced down to the latest snapshot: it never holds more than one
+     * after the last copy queued (g_paste_history_saver_copy), which must
+     * still see the writes queued before it, and only those. */
     GQueue                       pending;
 
     /* Handshake for g_paste_history_saver_drain(): the worker thread clears
@@ -54,6 +59,27 @@ G_PASTE_DEFINE_TYPE (HistorySaver, history_saver, G_TYPE_OBJECT)
 /* Write path   */
 /****************/
 
+/* What reading a history hands back, for a load or a prefetch alike. */
+typedef struct
+{
+    GList   *history;
+    gsize    size;
+    guint64  cold_length;
+    /* %FALSE when the history is on disk but could not be read back (a failed
+     * decryption, parse or I/O error), so the owner can refuse to persist over
+     * data it never managed to load. */
+    gboolean readable;
+} GPasteHistorySaverLoadResult;
+
+static void
+g_paste_history_saver_load_result_free (GPasteHistorySaverLoadResult *result)
+{
+    g_autofree GPasteHistorySaverLoadResult *r = result;
+    g_clear_list (&r->history, g_object_unref);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GPasteHistorySaverLoadResult, g_paste_history_saver_load_result_free)
+
 typedef struct
 {
     GPasteHistorySaver   *saver; /* not ref'd: the task's own ref keeps it alive */
@@ -63,6 +89,25 @@ typedef struct
     GPasteItem           *item; /* ref'd, or NULL */
     gchar                *uuid; /* or NULL */
     GList                *history;
+    guint64               length; /* for a truncation, or the items a page or a prefetch reads */
+    /* Set for a copy of @name to @copy rather than a write, along with the
+     * task it answers once done. */
+    gchar                *copy;
+    GTask                *copy_task;
+    /* Set for a read of @length items past the @offset newest of the cold
+     * tier rather than a write, @read being what came back. */
+    gboolean              page;
+    guint64               offset;
+    guint64               serial;
+    GList                *read;
+    /* Set for a prefetch of the @length newest items of @name rather than a
+     * write, along with the task it answers once done. */
+    GTask                *prefetch_task;
+    /* Set for a maintenance run of the stores rather than a write, starting
+     * @offset histories into them and stopping after @budget, along with the
+     * task it answers once done. */
+    GTask                *maintain_task;
+    GTimeSpan             budget;
 } GPasteHistorySaverWrite;
 
 static void
@@ -70,15 +115,166 @@ g_paste_history_saver_write_free (gpointer data)
 {
     g_autofree GPasteHistorySaverWrite *d = data;
     g_clear_object (&d->backend);
-    g_clear_pointer (&d->name, g_free);
     g_clear_object (&d->item);
     g_clear_pointer (&d->uuid, g_free);
     g_clear_list (&d->history, g_object_unref);
+    g_clear_pointer (&d->copy, g_free);
+    g_clear_list (&d->read, g_object_unref);
+
+    /* A copy dropped before it ran (the saver went away with it queued) is
+     * still owed an answer. */
+    if (d->copy_task)
+    {
+        g_task_return_new_error (d->copy_task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                 "The history storage went away before “%s” could be copied", d->name);
+        g_clear_object (&d->copy_task);
+    }
+
+    if (d->prefetch_task)
+    {
+        g_task_return_new_error (d->prefetch_task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                 "The history storage went away before “%s” could be read", d->name);
+        g_clear_object (&d->prefetch_task);
+    }
+
+    if (d->maintain_task)
+    {
+        g_task_return_new_error (d->maintain_task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                 "The history storage went away before it could be maintained");
+        g_clear_object (&d->maintain_task);
+    }
+
+    g_clear_pointer (&d->name, g_free);
 }
 
+/* Whether @data is a change to the store, rather than a copy, a read or a
+ * maintenance run queued alongside the changes: only a change may be folded
+ * into a later one or applied by a drain. */
+static gboolean
+g_paste_history_saver_write_is_change (const GPasteHistorySaverWrite *data)
+{
+    return !(data->copy || data->page || data->prefetch_task || data->maintain_task);
+}
+
+/* Runs in the same queue as the writes, so the copy sees every change recorded
+ * before it was asked for and, unless a drain applied them past it, none
+ * recorded after. */
 static void
-g_paste_history_saver_do_write (const GPasteHistorySaverWrite *data)
+g_paste_history_saver_do_copy (GPasteHistorySaverWrite *data)
 {
+    g_autoptr (GTask) task = g_steal_pointer (&data->copy_task);
+    GError *error = NULL;
+
+    if (g_paste_storage_backend_copy_history (data->backend, data->name, data->copy, &error))
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+}
+
+/* Read the way a load does, but for the owner to keep aside rather than
+ * install: an unreadable history is an error here, not an empty one. */
+static void
+g_paste_history_saver_do_prefetch (GPasteHistorySaverWrite *data)
+{
+    g_autoptr (GTask) task = g_steal_pointer (&data->prefetch_task);
+    g_autoptr (GPasteHistorySaverLoadResult) result = g_new0 (GPasteHistorySaverLoadResult, 1);
+
+    if (data->length)
+        result->readable = g_paste_storage_backend_read_history_head (data->backend, data->name, data->length,
+                                                                      &result->history, &result->size, &result->cold_length);
+    else
+        result->readable = g_paste_storage_backend_read_history (data->backend, data->name, &result->history, &result->size);
+
+    if (result->readable)
+        g_task_return_pointer (task, g_steal_pointer (&result), (GDestroyNotify) g_paste_history_saver_load_result_free);
+    else
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Could not read “%s” back", data->name);
+}
+
+static gint
+g_paste_history_saver_compare_names (gconstpointer a,
+                                     gconstpointer b,
+                                     gpointer      user_data G_GNUC_UNUSED)
+{
+    return g_strcmp0 (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* Go through the store of every history until the budget runs out, each store
+ * once however many histories it holds. The histories are taken in order of
+ * name, @offset of them in, so a run cut short is picked up by the next one
+ * where it stopped rather than going through the same ones again. The one the
+ * budget ran out in counts as gone through: a store too big to finish in one
+ * run would otherwise be all every later run gets to. */
+static void
+g_paste_history_saver_do_maintain (GPasteHistorySaverWrite *data)
+{
+    g_autoptr (GTask) task = g_steal_pointer (&data->maintain_task);
+    g_autoptr (GError) error = NULL;
+    g_auto (GStrv) names = g_paste_storage_backend_list_histories (data->backend, &error);
+
+    if (!names)
+    {
+        g_task_return_error (task, g_steal_pointer (&error));
+        return;
+    }
+
+    gint64 deadline = g_get_monotonic_time () + data->budget;
+    guint64 n_names = g_strv_length (names);
+    g_autoptr (GHashTable) stores = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    GPasteStorageMaintenance *report = g_new0 (GPasteStorageMaintenance, 1);
+
+    g_sort_array (names, n_names, sizeof (gchar *), g_paste_history_saver_compare_names, NULL);
+
+    report->complete = TRUE;
+
+    for (guint64 i = 0; report->complete && i < n_names; ++i)
+    {
+        const gchar *name = names[(data->offset + i) % n_names];
+        g_autofree gchar *store = g_paste_storage_backend_get_store_path (data->backend, name);
+
+        if (g_get_monotonic_time () >= deadline)
+        {
+            report->complete = FALSE;
+            break;
+        }
+
+        if (g_hash_table_add (stores, g_steal_pointer (&store)) &&
+            !g_paste_storage_backend_maintain (data->backend, name, deadline, report))
+            report->complete = FALSE;
+
+        ++report->histories;
+    }
+
+    g_task_return_pointer (task, report, g_free);
+}
+
+static void
+g_paste_history_saver_do_write (GPasteHistorySaverWrite *data)
+{
+    if (data->copy)
+    {
+        g_paste_history_saver_do_copy (data);
+        return;
+    }
+
+    if (data->prefetch_task)
+    {
+        g_paste_history_saver_do_prefetch (data);
+        return;
+    }
+
+    if (data->maintain_task)
+    {
+        g_paste_history_saver_do_maintain (data);
+        return;
+    }
+
+    if (data->page)
+    {
+        data->read = g_paste_storage_backend_read_history_tail (data->backend, data->name, data->offset, data->length);
+        return;
+    }
+
     switch (data->op)
     {
     case G_PASTE_HISTORY_SAVE_ADD:
@@ -93,6 +289,9 @@ g_paste_history_saver_do_write (const GPasteHistorySaverWrite *data)
     case G_PASTE_HISTORY_SAVE_CLEAR:
         g_paste_storage_backend_clear_history (data->backend, data->name, data->history);
         break;
+    case G_PASTE_HISTORY_SAVE_TRUNCATE:
+        g_paste_storage_backend_truncate_history (data->backend, data->name, data->length);
+        break;
     case G_PASTE_HISTORY_SAVE_FULL:
     default:
         g_paste_storage_backend_write_history (data->backend, data->name, data->history);
@@ -106,10 +305,14 @@ g_paste_history_saver_write_task (GTask        *task,
                                   gpointer      task_data,
                                   GCancellable *cancellable G_GNUC_UNUSED)
 {
-    const GPasteHistorySaverWrite *data = task_data;
+    GPasteHistorySaverWrite *data = task_data;
     GPasteHistorySaver *self = data->saver;
 
+    /* The backend reads the values of items the history keeps working on
+     * meanwhile: the copies of the compressed ones must stay until it is done. */
+    g_paste_item_hold_values ();
     g_paste_history_saver_do_write (data);
+    g_paste_item_release_values ();
 
     /* Let a concurrent g_paste_history_saver_drain() know this write is done. */
     g_mutex_lock (&self->drain_mutex);
@@ -150,13 +353,18 @@ g_paste_history_saver_start_write (GPasteHistorySaver *self)
 
 static void
 g_paste_history_saver_write_done (GObject      *source_object G_GNUC_UNUSED,
-                                  GAsyncResult *result        G_GNUC_UNUSED,
+                                  GAsyncResult *result,
                                   gpointer      user_data)
 {
     g_autoptr (GPasteHistorySaver) self = user_data; /* the ref taken in start_write */
+    GPasteHistorySaverWrite *data = g_task_get_task_data (G_TASK (result));
 
     self->write_in_progress = FALSE;
 
+    /* Like a load, a page is only handed to an owner that still owns us. */
+    if (data->page && !self->detached)
+        self->paged (self->owner, g_steal_pointer (&data->read), data->serial);
+
     /* More changes may have queued up while we were writing: drain the next. */
     g_paste_history_saver_start_write (self);
 }
@@ -188,10 +396,16 @@ g_paste_history_saver_record (GPasteHistorySaver *self,
     g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
 
     /* A non-incremental backend ignores the granular hint and rewrites the whole
-     * snapshot, so collapse any pending writes into a single full one. */
+     * snapshot, so collapse the pending writes into a single full one -- those
+     * queued since the last copy, read or maintenance run: the copy is owed the
+     * state it was asked in, a read is owed its answer, and the run goes over
+     * what the writes before it left. */
     if (!g_paste_storage_backend_is_incremental (self->backend))
     {
-        g_queue_clear_full (&self->pending, g_paste_history_saver_write_free);
+        while (!g_queue_is_empty (&self->pending) &&
+               g_paste_history_saver_write_is_change (g_queue_peek_tail (&self->pending)))
+            g_paste_history_saver_write_free (g_queue_pop_tail (&self->pending));
+
         op = G_PASTE_HISTORY_SAVE_FULL;
         item = NULL;
         uuid = NULL;
@@ -211,6 +425,276 @@ g_paste_history_saver_record (GPasteHistorySaver *self,
     g_paste_history_saver_start_write (self);
 }
 
+/**
+ * g_paste_history_saver_truncate:
+ * @self: a #GPasteHistorySaver
+ * @name: the history to truncate
+ * @length: how many of the items that may stay in the store to keep
+ *
+ * Drop the oldest items of @name that only its store holds, in the background
+ * and in order with the other changes (see g_paste_storage_backend_truncate_history()).
+ * Only ever recorded for a history loaded with a resident bound, so only ever
+ * met by a backend with a cold tier, which never needs the writes coalesced.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_truncate (GPasteHistorySaver *self,
+                                const gchar        *name,
+                                guint64             length)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+    g_return_if_fail (name);
+
+    GPasteHistorySaverWrite *data = g_new0 (GPasteHistorySaverWrite, 1);
+    data->saver = self;
+    data->backend = g_object_ref (self->backend);
+    data->op = G_PASTE_HISTORY_SAVE_TRUNCATE;
+    data->name = g_strdup (name);
+    data->length = length;
+
+    g_queue_push_tail (&self->pending, data);
+
+    g_paste_history_saver_start_write (self);
+}
+
+/**
+ * g_paste_history_saver_copy:
+ * @self: a #GPasteHistorySaver
+ * @name: the history to copy
+ * @copy: the name to copy it to
+ * @callback: called on the current thread-default main context once done
+ * @user_data: data for @callback
+ *
+ * Copy @name to @copy in the background, through the backend's own copy where
+ * it has one (see g_paste_storage_backend_copy_history()). Queued behind the
+ * pending writes, so the copy holds every change recorded before this call.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_copy (GPasteHistorySaver *self,
+                            const gchar        *name,
+                            const gchar        *copy,
+                            GAsyncReadyCallback callback,
+                            gpointer            user_data)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+    g_return_if_fail (name);
+    g_return_if_fail (copy);
+
+    GPasteHistorySaverWrite *data = g_new0 (GPasteHistorySaverWrite, 1);
+    data->saver = self;
+    data->backend = g_object_ref (self->backend);
+    data->name = g_strdup (name);
+    data->copy = g_strdup (copy);
+    data->copy_task = g_task_new (self->owner, NULL, callback, user_data);
+    g_task_set_static_name (data->copy_task, "gpaste-history-copy");
+    g_task_set_source_tag (data->copy_task, g_paste_history_saver_copy);
+
+    g_queue_push_tail (&self->pending, data);
+
+    g_paste_history_saver_start_write (self);
+}
+
+/**
+ * g_paste_history_saver_copy_finish:
+ * @self: a #GPasteHistorySaver
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: whether the copy was made
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_history_saver_copy_finish (GPasteHistorySaver *self,
+                                   GAsyncResult       *result,
+                                   GError            **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY_SAVER (self), FALSE);
+    g_return_val_if_fail (g_task_is_valid (result, self->owner), FALSE);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == g_paste_history_saver_copy, FALSE);
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * g_paste_history_saver_read_page:
+ * @self: a #GPasteHistorySaver
+ * @name: the history to read from
+ * @offset: how many of the newest items that may stay in the store to skip
+ * @limit: how many of them to read at most
+ * @serial: handed back to the #GPasteHistorySaverPageFunc along with the page
+ *
+ * Read a page of the items of @name that may stay in the store (see
+ * g_paste_storage_backend_read_history_tail()) in the background. Queued behind
+ * the pending writes like a copy, so the page sees every change recorded before
+ * this call; the owner tells the ones recorded after it through @serial. Only
+ * for a backend with a cold tier.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_read_page (GPasteHistorySaver *self,
+                                 const gchar        *name,
+                                 guint64             offset,
+                                 guint64             limit,
+                                 guint64             serial)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+    g_return_if_fail (name);
+    g_return_if_fail (g_paste_storage_backend_has_cold_tier (self->backend));
+
+    GPasteHistorySaverWrite *data = g_new0 (GPasteHistorySaverWrite, 1);
+    data->saver = self;
+    data->backend = g_object_ref (self->backend);
+    data->name = g_strdup (name);
+    data->page = TRUE;
+    data->offset = offset;
+    data->length = limit;
+    data->serial = serial;
+
+    g_queue_push_tail (&self->pending, data);
+
+    g_paste_history_saver_start_write (self);
+}
+
+/**
+ * g_paste_history_saver_prefetch:
+ * @self: a #GPasteHistorySaver
+ * @name: the history to read
+ * @resident: how many of the items that may stay in the store to read, the
+ *            others staying there; 0 to read them all
+ * @callback: called on the current thread-default main context once done
+ * @user_data: data for @callback
+ *
+ * Read @name in the background for the owner to keep at hand, without it
+ * becoming the one loaded: unlike g_paste_history_saver_load(), nothing is
+ * installed and no load is reported in progress. Queued behind the pending
+ * writes like a copy, so what is read holds every change recorded before this
+ * call. @resident is honoured as by g_paste_history_saver_load().
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_prefetch (GPasteHistorySaver *self,
+                                const gchar        *name,
+                                guint64             resident,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+    g_return_if_fail (name);
+
+    GPasteHistorySaverWrite *data = g_new0 (GPasteHistorySaverWrite, 1);
+    data->saver = self;
+    data->backend = g_object_ref (self->backend);
+    data->name = g_strdup (name);
+    data->length = g_paste_storage_backend_has_cold_tier (self->backend) ? resident : 0;
+    data->prefetch_task = g_task_new (self->owner, NULL, callback, user_data);
+    g_task_set_static_name (data->prefetch_task, "gpaste-history-prefetch");
+    g_task_set_source_tag (data->prefetch_task, g_paste_history_saver_prefetch);
+
+    g_queue_push_tail (&self->pending, data);
+
+    g_paste_history_saver_start_write (self);
+}
+
+/**
+ * g_paste_history_saver_prefetch_finish:
+ * @self: a #GPasteHistorySaver
+ * @result: the #GAsyncResult passed to the callback
+ * @size: (out): where to store the total size of the items read
+ * @cold_length: (out): where to store how many more items only the store holds
+ * @error: return location for a #GError, or %NULL
+ *
+ * Fails with %G_IO_ERROR_INVALID_DATA when the history is on disk but could not
+ * be read back, and with %G_IO_ERROR_CANCELLED when the saver went away first.
+ *
+ * Returns: (transfer full) (element-type GPasteItem): the items read, newest
+ *          first; %NULL on error, or for an empty history
+ */
+G_PASTE_VISIBLE GList *
+g_paste_history_saver_prefetch_finish (GPasteHistorySaver *self,
+                                       GAsyncResult       *result,
+                                       gsize              *size,
+                                       guint64            *cold_length,
+                                       GError            **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY_SAVER (self), NULL);
+    g_return_val_if_fail (g_task_is_valid (result, self->owner), NULL);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == g_paste_history_saver_prefetch, NULL);
+
+    g_autoptr (GPasteHistorySaverLoadResult) read = g_task_propagate_pointer (G_TASK (result), error);
+
+    if (!read)
+        return NULL;
+
+    *size = read->size;
+    *cold_length = read->cold_length;
+
+    return g_steal_pointer (&read->history);
+}
+
+/**
+ * g_paste_history_saver_maintain:
+ * @self: a #GPasteHistorySaver
+ * @offset: how many histories into the list to start at
+ * @budget: how long the run may take, in microseconds
+ * @callback: called on the current thread-default main context once done
+ * @user_data: data for @callback
+ *
+ * Tidy the stores of the histories up in the background (see
+ * g_paste_storage_backend_maintain()), for at most @budget. Queued behind the
+ * pending writes like a copy, so it never runs alongside one. Histories are
+ * gone through in order of name, starting @offset of them in: how many a run
+ * cut short went through is where the next one should start.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_maintain (GPasteHistorySaver *self,
+                                guint64             offset,
+                                GTimeSpan           budget,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+
+    GPasteHistorySaverWrite *data = g_new0 (GPasteHistorySaverWrite, 1);
+    data->saver = self;
+    data->backend = g_object_ref (self->backend);
+    data->offset = offset;
+    data->budget = budget;
+    data->maintain_task = g_task_new (self->owner, NULL, callback, user_data);
+    g_task_set_static_name (data->maintain_task, "gpaste-history-maintain");
+    g_task_set_source_tag (data->maintain_task, g_paste_history_saver_maintain);
+
+    g_queue_push_tail (&self->pending, data);
+
+    g_paste_history_saver_start_write (self);
+}
+
+/**
+ * g_paste_history_saver_maintain_finish:
+ * @self: a #GPasteHistorySaver
+ * @result: the #GAsyncResult passed to the callback
+ * @report: (out caller-allocates): where to store what the run did
+ * @error: return location for a #GError, or %NULL
+ *
+ * Fails with %G_IO_ERROR_CANCELLED when the saver went away first.
+ *
+ * Returns: whether the run took place
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_history_saver_maintain_finish (GPasteHistorySaver       *self,
+                                       GAsyncResult             *result,
+                                       GPasteStorageMaintenance *report,
+                                       GError                  **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY_SAVER (self), FALSE);
+    g_return_val_if_fail (g_task_is_valid (result, self->owner), FALSE);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == g_paste_history_saver_maintain, FALSE);
+
+    g_autofree GPasteStorageMaintenance *done = g_task_propagate_pointer (G_TASK (result), error);
+
+    if (!done)
+        return FALSE;
+
+    *report = *done;
+
+    return TRUE;
+}
+
 /**
  * g_paste_history_saver_drain:
  * @self: a #GPasteHistorySaver
@@ -234,20 +718,39 @@ g_paste_history_saver_drain (GPasteHistorySaver *self)
         g_cond_wait (&self->drain_cond, &self->drain_mutex);
     g_mutex_unlock (&self->drain_mutex);
 
-    /* Apply whatever is still queued synchronously, in order. */
+    /* Apply whatever is still queued synchronously, in order. A copy, a page, a
+     * prefetch or a maintenance run is no write: it is left for the worker,
+     * whose completion hands it back from the main loop rather than from inside
+     * whatever is draining us -- and neither a backup nor a run is worth
+     * stalling the main thread for. A copy left behind this way holds the
+     * writes drained past it too: a few changes newer than asked for, never
+     * fewer. */
+    GQueue left = G_QUEUE_INIT;
+
     while (!g_queue_is_empty (&self->pending))
     {
         GPasteHistorySaverWrite *data = g_queue_pop_head (&self->pending);
 
+        if (!g_paste_history_saver_write_is_change (data))
+        {
+            g_queue_push_tail (&left, data);
+            continue;
+        }
+
         g_paste_history_saver_do_write (data);
         g_paste_history_saver_write_free (data);
     }
 
+    while (!g_queue_is_empty (&left))
+        g_queue_push_tail (&self->pending, g_queue_pop_head (&left));
+
     /* Deliberately *not* clearing write_in_progress: the drained task's completion
      * callback is still queued on the main context and will clear it (and pick up
      * anything recorded meanwhile). Clearing it here would let a record() made
      * after a resumed handover start a second worker while that callback then
-     * starts a third — two threads rewriting the same history at once. */
+     * starts a third — two threads rewriting the same history at once. When
+     * no write is in flight, nothing else picks up what was left behind. */
+    g_paste_history_saver_start_write (self);
 }
 
 /**
@@ -276,7 +779,9 @@ typedef struct
     GPasteStorageBackend *backend;
     gchar                *name;
     guint64               generation;
+    guint64               resident;
     gboolean              save_after;
+    GVariant             *state;
 } GPasteHistorySaverLoadData;
 
 static void
@@ -285,26 +790,35 @@ g_paste_history_saver_load_data_free (gpointer data)
     g_autofree GPasteHistorySaverLoadData *d = data;
     g_clear_object (&d->backend);
     g_clear_pointer (&d->name, g_free);
+    g_clear_pointer (&d->state, g_variant_unref);
 }
 
-typedef struct
+/* Take the items of a handed over state, if the store still is what it was when
+ * they were handed over. */
+static gboolean
+g_paste_history_saver_take_state (const GPasteHistorySaverLoadData *data,
+                                  GPasteHistorySaverLoadResult     *result)
 {
-    GList   *history;
-    gsize    size;
-    /* %FALSE when the history is on disk but could not be read back (a failed
-     * decryption, parse or I/O error), so the owner can refuse to persist over
-     * data it never managed to load. */
-    gboolean readable;
-} GPasteHistorySaverLoadResult;
+    const gchar *stamp;
+    guint64 cold_length;
+    g_autoptr (GVariant) items = NULL;
 
-static void
-g_paste_history_saver_load_result_free (GPasteHistorySaverLoadResult *result)
-{
-    g_autofree GPasteHistorySaverLoadResult *r = result;
-    g_clear_list (&r->history, g_object_unref);
-}
+    g_variant_get (data->state, "(&s&stt@" G_PASTE_HANDOVER_ITEMS_TYPE ")", NULL, &stamp, NULL, &cold_length, &items);
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (GPasteHistorySaverLoadResult, g_paste_history_saver_load_result_free)
+    g_autofree gchar *current = g_paste_storage_backend_dup_stamp (data->backend, data->name);
+
+    if (!g_paste_str_equal (stamp, current))
+    {
+        g_debug ("The history was written since it was handed over, reading it back");
+        return FALSE;
+    }
+
+    result->history = g_paste_handover_unpack_items (items, &result->size);
+    result->cold_length = cold_length;
+    result->readable = TRUE;
+
+    return TRUE;
+}
 
 static void
 g_paste_history_saver_load_task (GTask        *task,
@@ -319,7 +833,16 @@ g_paste_history_saver_load_task (GTask        *task,
      * finished flushing and released the lock, so we never load a stale history. */
     g_paste_storage_backend_lock ();
 
-    result->readable = g_paste_storage_backend_read_history (data->backend, data->name, &result->history, &result->size);
+    /* Only now can the store be compared with the state: the previous daemon
+     * is gone, and nothing else writes to it without the lock. */
+    if (!data->state || !g_paste_history_saver_take_state (data, result))
+    {
+        if (data->resident)
+            result->readable = g_paste_storage_backend_read_history_head (data->backend, data->name, data->resident,
+                                                                          &result->history, &result->size, &result->cold_length);
+        else
+            result->readable = g_paste_storage_backend_read_history (data->backend, data->name, &result->history, &result->size);
+    }
     g_task_return_pointer (task, result, (GDestroyNotify) g_paste_history_saver_load_result_free);
 }
 
@@ -356,25 +879,16 @@ g_paste_history_saver_load_done (GObject      *source_object G_GNUC_UNUSED,
     }
 
     self->loaded (self->owner, g_steal_pointer (&load_result->history), load_result->size,
-                  data->save_after, load_result->readable);
+                  load_result->cold_length, data->save_after, load_result->readable);
 }
 
-/**
- * g_paste_history_saver_load:
- * @self: a #GPasteHistorySaver
- * @name: the history name to read
- * @save_after: whether the loaded history should be persisted back once installed
- *
- * Read @name in the background. When it completes (and has not been superseded
- * by a later load) the result is handed to the #GPasteHistorySaverLoadedFunc.
- */
-G_PASTE_VISIBLE void
-g_paste_history_saver_load (GPasteHistorySaver *self,
-                            const gchar        *name,
-                            gboolean            save_after)
+static void
+g_paste_history_saver_start_load (GPasteHistorySaver *self,
+                                  const gchar        *name,
+                                  guint64             resident,
+                                  gboolean            save_after,
+                                  GVariant           *state)
 {
-    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
-
     self->load_in_progress = TRUE;
     self->load_generation++;
 
@@ -382,11 +896,13 @@ g_paste_history_saver_load (GPasteHistorySaver *self,
     data->backend = g_object_ref (self->backend);
     data->name = g_strdup (name);
     data->generation = self->load_generation;
+    data->resident = g_paste_storage_backend_has_cold_tier (self->backend) ? resident : 0;
     /* save_after exists so a snapshot-rewriting backend persists its read-time
      * normalization (format upgrade, uuid dedup, truncation). An incremental
      * backend normalizes its storage on open instead, so writing the whole
      * history back after a load would be pure churn: drop the request. */
     data->save_after = save_after && !g_paste_storage_backend_is_incremental (self->backend);
+    data->state = (state) ? g_variant_ref (state) : NULL;
 
     /* Hold our own ref for the task (see start_write): reload_backend may drop
      * the owner's ref to us while this load is still in flight. */
@@ -396,6 +912,53 @@ g_paste_history_saver_load (GPasteHistorySaver *self,
     g_task_run_in_thread (task, g_paste_history_saver_load_task);
 }
 
+/**
+ * g_paste_history_saver_load:
+ * @self: a #GPasteHistorySaver
+ * @name: the history name to read
+ * @resident: how many of the items that may stay in the store to read, the
+ *            others staying there; 0 to read them all
+ * @save_after: whether the loaded history should be persisted back once installed
+ *
+ * Read @name in the background. When it completes (and has not been superseded
+ * by a later load) the result is handed to the #GPasteHistorySaverLoadedFunc.
+ * @resident is only honoured by a backend with a cold tier (see
+ * g_paste_storage_backend_has_cold_tier()): any other reads everything.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_load (GPasteHistorySaver *self,
+                            const gchar        *name,
+                            guint64             resident,
+                            gboolean            save_after)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+
+    g_paste_history_saver_start_load (self, name, resident, save_after, NULL);
+}
+
+/**
+ * g_paste_history_saver_load_state:
+ * @self: a #GPasteHistorySaver
+ * @name: the history name to read
+ * @resident: as for g_paste_history_saver_load()
+ * @state: a %G_PASTE_HANDOVER_HISTORY_TYPE state a previous daemon handed over
+ *
+ * Like g_paste_history_saver_load(), but take the items of @state rather than
+ * reading them back, provided the store is still as @state found it. It is
+ * only read back when it is not.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_saver_load_state (GPasteHistorySaver *self,
+                                  const gchar        *name,
+                                  guint64             resident,
+                                  GVariant           *state)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY_SAVER (self));
+    g_return_if_fail (g_variant_is_of_type (state, G_VARIANT_TYPE (G_PASTE_HANDOVER_HISTORY_TYPE)));
+
+    g_paste_history_saver_start_load (self, name, resident, FALSE, state);
+}
+
 /**
  * g_paste_history_saver_abandon_load:
  * @self: a #GPasteHistorySaver
@@ -480,6 +1043,7 @@ g_paste_history_saver_init (GPasteHistorySaver *self)
  *         therefore this saver, which it owns) stays alive during operations,
  *         and passed back to @loaded
  * @loaded: (scope notified): invoked when an async load completes
+ * @paged: (scope notified): invoked when a page read completes
  *
  * Create a new instance of #GPasteHistorySaver
  *
@@ -489,17 +1053,20 @@ g_paste_history_saver_init (GPasteHistorySaver *self)
 G_PASTE_VISIBLE GPasteHistorySaver *
 g_paste_history_saver_new (GPasteStorageBackend        *backend,
                            gpointer                     owner,
-                           GPasteHistorySaverLoadedFunc loaded)
+                           GPasteHistorySaverLoadedFunc loaded,
+                           GPasteHistorySaverPageFunc   paged)
 {
     g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (backend), NULL);
     g_return_val_if_fail (G_IS_OBJECT (owner), NULL);
     g_return_val_if_fail (loaded, NULL);
+    g_return_val_if_fail (paged, NULL);
 
     GPasteHistorySaver *self = g_object_new (G_PASTE_TYPE_HISTORY_SAVER, NULL);
 
     self->backend = g_object_ref (backend);
     self->owner = owner;
     self->loaded = loaded;
+    self->paged = paged;
 
     return self;
 }
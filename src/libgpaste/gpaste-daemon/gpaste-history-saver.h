@@ -16,6 +16,8 @@ G_PASTE_FINAL_TYPE (HistorySaver, history_saver, HISTORY_SAVER, GObject)
  * @user_data: the @owner passed to g_paste_history_saver_new()
  * @history: (transfer full) (element-type GPasteItem): the loaded items
  * @size: the total size of the loaded items
+ * @cold_length: how many more items the history holds in its store only (see
+ *               g_paste_history_saver_load())
  * @save_after: whether the load was triggered by a switch and should be persisted back
  * @readable: %FALSE when the history exists on disk but could not be read back,
  *            so @history is empty only because the read failed and must never be
@@ -27,9 +29,22 @@ G_PASTE_FINAL_TYPE (HistorySaver, history_saver, HISTORY_SAVER, GObject)
 typedef void (*GPasteHistorySaverLoadedFunc) (gpointer  user_data,
                                               GList    *history,
                                               gsize     size,
+                                              guint64   cold_length,
                                               gboolean  save_after,
                                               gboolean  readable);
 
+/**
+ * GPasteHistorySaverPageFunc:
+ * @user_data: the @owner passed to g_paste_history_saver_new()
+ * @page: (transfer full) (element-type GPasteItem): the items read, newest first
+ * @serial: the one passed to g_paste_history_saver_read_page()
+ *
+ * Called on the main thread when a page read finishes.
+ */
+typedef void (*GPasteHistorySaverPageFunc) (gpointer user_data,
+                                            GList   *page,
+                                            guint64  serial);
+
 /* The kind of change being persisted. Incremental backends (e.g. SQLite) act on
  * the supplied item/uuid; the file backend ignores them and rewrites the whole
  * snapshot, so for it every kind behaves like %G_PASTE_HISTORY_SAVE_FULL. */
@@ -40,6 +55,7 @@ typedef enum
     G_PASTE_HISTORY_SAVE_REMOVE,  /* @uuid was removed */
     G_PASTE_HISTORY_SAVE_REPLACE, /* @uuid was replaced by @item */
     G_PASTE_HISTORY_SAVE_CLEAR,   /* the history was emptied */
+    G_PASTE_HISTORY_SAVE_TRUNCATE, /* the oldest items left in the store were dropped */
 } GPasteHistorySaveOp;
 
 /********************/
@@ -52,9 +68,49 @@ void     g_paste_history_saver_record       (GPasteHistorySaver  *self,
                                              GPasteItem    *item,
                                              const gchar         *uuid,
                                              GList               *history);
+void     g_paste_history_saver_truncate     (GPasteHistorySaver *self,
+                                             const gchar        *name,
+                                             guint64             length);
 void     g_paste_history_saver_load         (GPasteHistorySaver *self,
                                              const gchar        *name,
+                                             guint64             resident,
                                              gboolean            save_after);
+void     g_paste_history_saver_load_state   (GPasteHistorySaver *self,
+                                             const gchar        *name,
+                                             guint64             resident,
+                                             GVariant           *state);
+void     g_paste_history_saver_copy         (GPasteHistorySaver *self,
+                                             const gchar        *name,
+                                             const gchar        *copy,
+                                             GAsyncReadyCallback callback,
+                                             gpointer            user_data);
+gboolean g_paste_history_saver_copy_finish  (GPasteHistorySaver *self,
+                                             GAsyncResult       *result,
+                                             GError            **error);
+void     g_paste_history_saver_read_page    (GPasteHistorySaver *self,
+                                             const gchar        *name,
+                                             guint64             offset,
+                                             guint64             limit,
+                                             guint64             serial);
+void     g_paste_history_saver_prefetch     (GPasteHistorySaver *self,
+                                             const gchar        *name,
+                                             guint64             resident,
+                                             GAsyncReadyCallback callback,
+                                             gpointer            user_data);
+GList   *g_paste_history_saver_prefetch_finish (GPasteHistorySaver *self,
+                                                GAsyncResult       *result,
+                                                gsize              *size,
+                                                guint64            *cold_length,
+                                                GError            **error);
+void     g_paste_history_saver_maintain     (GPasteHistorySaver *self,
+                                             guint64             offset,
+                                             GTimeSpan           budget,
+                                             GAsyncReadyCallback callback,
+                                             gpointer            user_data);
+gboolean g_paste_history_saver_maintain_finish (GPasteHistorySaver       *self,
+                                                GAsyncResult             *result,
+                                                GPasteStorageMaintenance *report,
+                                                GError                  **error);
 void     g_paste_history_saver_drain        (GPasteHistorySaver *self);
 void     g_paste_history_saver_detach       (GPasteHistorySaver *self);
 void     g_paste_history_saver_abandon_load (GPasteHistorySaver *self);
@@ -66,6 +122,7 @@ gboolean g_paste_history_saver_is_loading   (GPasteHistorySaver *self);
 
 GPasteHistorySaver *g_paste_history_saver_new (GPasteStorageBackend        *backend,
                                                gpointer                     owner,
-                                               GPasteHistorySaverLoadedFunc loaded);
+                                               GPasteHistorySaverLoadedFunc loaded,
+                                               GPasteHistorySaverPageFunc   paged);
 
 G_END_DECLS
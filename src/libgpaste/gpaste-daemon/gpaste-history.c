@@ -5,11 +5,13 @@
 #include <gpaste-3/gpaste-update-enums.h>
 #include <gpaste-3/gpaste-util.h>
 
+#include <gpaste-daemon/gpaste-handover.h>
 #include <gpaste-daemon/gpaste-history.h>
 #include <gpaste-daemon/gpaste-history-saver.h>
 #include <gpaste-daemon/gpaste-storage-backend.h>
 #include <gpaste-daemon/gpaste-text-item.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
+#include <gpaste-daemon/gpaste-uuid.h>
 
 #include <gio/gio.h>
 
@@ -39,7 +41,7 @@ struct _GPasteHistory
 
     /* The model: newest first, holding a ref on each item, plus an index from
      * uuid to the very same items. The hash borrows both — the key is the
-     * item's own uuid string and the value is the item the array owns — so an
+     * item's own binary uuid and the value is the item the array owns — so an
      * entry is only ever valid while the item is in the array, and the two are
      * updated together. That is safe because a uuid never changes once its item
      * is in the history: only the storage backends call
@@ -48,6 +50,73 @@ struct _GPasteHistory
     GHashTable           *by_uuid;
     gsize                 size;
 
+    /* The tiered mode, for a backend with a cold tier and a non-zero
+     * "resident-history-size": of the items that could just as well stay in
+     * the store -- neither a favourite nor a password -- the array only keeps
+     * the @resident_limit newest, and the @cold_length others come after the
+     * whole of it. Those resident ones are always the newest the store holds,
+     * so how many there are is where the cold ones start in it. @faulted keeps
+     * the last few cold items read back, so the pointer get() hands out stays
+     * good for a while, @faulted_order being the order they go in.
+     *
+     * Nothing is ever written back as a whole in that mode, since the history
+     * does not have the whole of itself at hand: what leaves it along the way
+     * is named to the store one item at a time. @dropped queues the uuids of
+     * those, and @truncated a cut of the cold tier, for g_paste_history_update
+     * to record along with the change they rode along with. */
+    guint64               resident_limit;
+    guint64               cold_length;
+    GHashTable           *faulted;
+    GQueue                faulted_order;
+    GPtrArray            *dropped;
+    gboolean              truncated;
+
+    /* A history loaded in the background arrives a page at a time: the first
+     * one at once, then the rest of it streamed in behind (see
+     * g_paste_history_on_page). @serial counts the changes to the model, and a
+     * page asked for at another one than @stream_serial belongs to a history
+     * since swapped out. @streaming says a page is on its way.
+     *
+     * Each page is the head of the cold tier when it is asked for, read past
+     * however many items the array holds that may go cold. A copy, a removal or
+     * a selection in the array only moves that offset, not what sits past it,
+     * so the page is still the head of the cold tier when it comes; whatever
+     * takes from or adds to that head bumps @cold_serial instead, and a page
+     * asked for at another one than @stream_cold_serial is read again. */
+    guint64               serial;
+    guint64               stream_serial;
+    gboolean              streaming;
+    guint64               cold_serial;
+    guint64               stream_cold_serial;
+
+    /* The histories most recently switched away from, the latest first, each
+     * kept whole (a GPasteHistoryParked) for a switch back to it to need no
+     * reading at all. "recent-histories" bounds how many, and their items count
+     * against the memory cap along with those of the current one: @parked_size
+     * is what they hold. */
+    GQueue                parked;
+    gsize                 parked_size;
+
+    /* Which history tends to follow which, and the prefetch it drives (see
+     * "Switch prediction"). @transitions is read in from disk the first time it
+     * is needed, and is NULL until then; @pending_switches are the switches made
+     * since it was last brought up to date. The prefetch of @prefetching in
+     * flight is answered at @prefetch_serial, bumped by whatever makes it moot. */
+    GPtrArray            *transitions;
+    GPtrArray            *pending_switches;
+    guint                 prefetch_source;
+    gchar                *prefetching;
+    guint                 prefetch_serial;
+
+    /* How the switches went (see g_paste_history_get_switch_stats) */
+    guint64               switches;
+    guint64               switch_hits;
+    guint64               prefetches;
+    guint64               prefetch_hits;
+
+    /* Where the next maintenance run starts (see g_paste_history_maintain) */
+    guint64               maintenance_offset;
+
     gchar                *name;
 
     /* Set once the history has been flushed for shutdown/handover: no further
@@ -98,6 +167,10 @@ g_paste_history_emit_pending_selection (GPasteHistorySelectionScope *scope)
     GPasteHistory *self = scope->self;
     g_autoptr (GPasteItem) item = NULL;
 
+    /* The operation is over, and with it the use of whatever values it read:
+     * the decompressed copies of idle items can go. */
+    g_paste_item_trim_values ();
+
     {
         G_PASTE_DO_LOCK_HISTORY;
 
@@ -180,7 +253,7 @@ g_paste_history_private_remove (GPasteHistory *self,
     self->size -= g_paste_item_get_size (item);
 
     /* Before the steal: the key belongs to the item. */
-    g_hash_table_remove (self->by_uuid, g_paste_item_get_uuid (item));
+    g_hash_table_remove (self->by_uuid, g_paste_item_get_binary_uuid (item));
     g_ptr_array_steal_index (self->history, index);
 
     if (remove_leftovers)
@@ -225,157 +298,1141 @@ g_paste_history_snapshot (GPasteHistory *self)
 {
     GList *snapshot = NULL;
 
-    for (guint i = self->history->len; i > 0; --i)
-        snapshot = g_list_prepend (snapshot, g_object_ref (g_ptr_array_index (self->history, i - 1)));
+    for (guint i = self->history->len; i > 0; --i)
+        snapshot = g_list_prepend (snapshot, g_object_ref (g_ptr_array_index (self->history, i - 1)));
+
+    return snapshot;
+}
+
+static void
+g_paste_history_private_forget_faulted (GPasteHistory *self)
+{
+    g_queue_clear (&self->faulted_order);
+    g_hash_table_remove_all (self->faulted);
+}
+
+/* Drop every item, keeping the containers. Releases the array's refs through
+ * its free func (a plain unref: unlike g_paste_history_empty this is a history
+ * being swapped out, not thrown away, so backing files are left alone). The
+ * cold tier goes with it: it belongs to the history the array held. */
+static void
+g_paste_history_private_clear (GPasteHistory *self)
+{
+    g_ptr_array_set_size (self->history, 0);
+    g_hash_table_remove_all (self->by_uuid);
+
+    self->cold_length = 0;
+    g_paste_history_private_forget_faulted (self);
+    g_ptr_array_set_size (self->dropped, 0);
+    self->truncated = FALSE;
+
+    /* Whatever page is still on its way belongs to the history swapped out. */
+    ++self->serial;
+    ++self->cold_serial;
+    self->streaming = FALSE;
+}
+
+/* Take over an item list from the storage layer (transfer full) and install it
+ * as the model, rebuilding the uuid index with it. */
+static void
+g_paste_history_private_set_from_list (GPasteHistory *self,
+                                       GList         *history)
+{
+    g_paste_history_private_clear (self);
+
+    for (GList *h = history; h; h = g_list_next (h))
+    {
+        GPasteItem *item = h->data;
+
+        g_ptr_array_add (self->history, item);
+        g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_binary_uuid (item), item);
+    }
+
+    /* The refs moved into the array; only the links are ours to free. */
+    g_list_free (history);
+}
+
+/* Whether @item may be left to the store in the tiered mode. A favourite or a
+ * password never is: the store reads both back with the head, and a password
+ * is not even kept by the plain stores. */
+static gboolean
+g_paste_history_private_may_go_cold (GPasteItem *item)
+{
+    return !g_paste_item_is_favourite (item) && !G_PASTE_IS_PASSWORD_ITEM (item);
+}
+
+/* How many of the items in memory may go cold, which is also how many of the
+ * store's newest such items the array holds: where the cold tier starts. */
+static guint64
+g_paste_history_private_count_warm (GPasteHistory *self)
+{
+    guint64 warm = 0;
+
+    for (guint i = 0; i < self->history->len; ++i)
+    {
+        if (g_paste_history_private_may_go_cold (g_ptr_array_index (self->history, i)))
+            ++warm;
+    }
+
+    return warm;
+}
+
+/* Whether anything that may go cold sits past @index in the array. */
+static gboolean
+g_paste_history_private_has_warm_after (GPasteHistory *self,
+                                        guint          index)
+{
+    for (guint i = index + 1; i < self->history->len; ++i)
+    {
+        if (g_paste_history_private_may_go_cold (g_ptr_array_index (self->history, i)))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* The whole length of the history, cold tier included. */
+static guint64
+g_paste_history_private_get_length (GPasteHistory *self)
+{
+    return self->history->len + self->cold_length;
+}
+
+/* Whether the history does not hold the whole of itself: in the tiered mode,
+ * or while the rest of a background load is still streaming in. */
+static gboolean
+g_paste_history_private_is_partial (GPasteHistory *self)
+{
+    return self->resident_limit || self->cold_length;
+}
+
+/* Don't persist intermediate states while an async load is replacing the
+ * history (the load result triggers its own save when appropriate), nor once
+ * we have been flushed for handover (a successor daemon owns the file now). */
+static gboolean
+g_paste_history_private_can_record (GPasteHistory *self)
+{
+    return !self->stopped && !self->unreadable && !g_paste_history_saver_is_loading (self->saver);
+}
+
+/* In the tiered mode, queue @item's removal from the store, to be recorded
+ * along with the change that dropped it (see @dropped). */
+static void
+g_paste_history_private_drop_stored (GPasteHistory *self,
+                                     GPasteItem    *item)
+{
+    if (g_paste_history_private_is_partial (self))
+        g_ptr_array_add (self->dropped, g_strdup (g_paste_item_get_uuid (item)));
+}
+
+static void
+g_paste_history_emit_update (GPasteHistory     *self,
+                             GPasteUpdateAction action,
+                             GPasteUpdateTarget target,
+                             const gchar       *uuid,
+                             guint64            position)
+{
+    g_debug ("history: update");
+
+    /* Every change to the model is announced: this is where it is counted. */
+    ++self->serial;
+
+    g_signal_emit (self,
+                   signals[UPDATE],
+                   0, /* detail */
+                   action,
+                   target,
+                   (uuid) ?: "",
+                   position,
+                   NULL);
+}
+
+/* No snapshot ever in the tiered mode, nor while a load streams in: the
+ * history does not hold the whole of itself, and the store reconciling against
+ * what it does hold would delete every cold row. A FULL is then only what rode
+ * along with it. */
+static void
+g_paste_history_record_tiered (GPasteHistory      *self,
+                               GPasteHistorySaveOp op,
+                               GPasteItem         *item,
+                               const gchar        *uuid)
+{
+    if (op != G_PASTE_HISTORY_SAVE_FULL)
+        g_paste_history_saver_record (self->saver, op, self->name, item, uuid, NULL);
+
+    for (guint i = 0; i < self->dropped->len; ++i)
+        g_paste_history_saver_record (self->saver, G_PASTE_HISTORY_SAVE_REMOVE, self->name, NULL, g_ptr_array_index (self->dropped, i), NULL);
+
+    /* Last, so the store holds what the history counts by then. */
+    if (self->truncated)
+        g_paste_history_saver_truncate (self->saver, self->name, g_paste_history_private_count_warm (self) + self->cold_length);
+}
+
+/* @displaced says whether anything left the history alongside the change: a
+ * dedup, a grown line replacing its shorter self, or an eviction. It only means
+ * anything for an add on an incremental backend -- see below. */
+static void
+g_paste_history_update (GPasteHistory      *self,
+                        GPasteUpdateAction  action,
+                        GPasteUpdateTarget  target,
+                        guint64             position,
+                        GPasteHistorySaveOp op,
+                        GPasteItem         *item,
+                        const gchar        *uuid,
+                        gboolean            displaced)
+{
+    gboolean record = g_paste_history_private_can_record (self);
+
+    if (record && g_paste_history_private_is_partial (self))
+        g_paste_history_record_tiered (self, op, item, uuid);
+    else if (record)
+    {
+        /* A non-incremental backend rewrites everything and always needs the
+         * snapshot. An incremental one only reconciles what rode along with an
+         * add -- and reconciliation only ever deletes rows the history no longer
+         * has, so with nothing displaced there is provably nothing to delete.
+         * That is the common case, and it is what spares a per-item ref-copy of
+         * the whole history on every single clipboard change. */
+        gboolean full = !g_paste_storage_backend_is_incremental (self->backend);
+        GList *snapshot = (full || op == G_PASTE_HISTORY_SAVE_FULL || (op == G_PASTE_HISTORY_SAVE_ADD && displaced))
+            ? g_paste_history_snapshot (self)
+            : NULL;
+
+        g_paste_history_saver_record (self->saver, op, self->name, item, uuid, snapshot);
+    }
+
+    g_ptr_array_set_size (self->dropped, 0);
+    self->truncated = FALSE;
+
+    /* The item the change is about: whichever one it left behind, or the uuid
+     * alone when it left none (a removal). Neither rides along with an ALL,
+     * which is about the history and not about any one item of it: the
+     * interface says both are empty there, and a client that reads the uuid
+     * whenever it is non-empty would otherwise act on an item the update was
+     * never about. The saver still gets @item -- what it persists and what the
+     * signal is about are two different questions. */
+    if (target == G_PASTE_UPDATE_TARGET_ALL)
+        g_paste_history_emit_update (self, action, target, NULL, 0);
+    else
+        g_paste_history_emit_update (self, action, target, (item) ? g_paste_item_get_uuid (item) : uuid, position);
+}
+
+static void
+g_paste_history_activate_first (GPasteHistory *self,
+                                gboolean       select)
+{
+    if (!self->history->len)
+        return;
+
+    GPasteItem *first = g_ptr_array_index (self->history, 0);
+
+    self->size -= g_paste_item_get_size (first);
+    g_paste_item_set_state (first, G_PASTE_ITEM_STATE_ACTIVE);
+    self->size += g_paste_item_get_size (first);
+
+    if (select)
+        g_paste_history_selected (self, first);
+}
+
+/* A history comes back from storage with every value expanded: hold the idle
+ * ones compressed right away, not only once each has been active and let go. */
+static void
+g_paste_history_private_compress_idle (GPasteHistory *self)
+{
+    if (!g_paste_settings_get_compress_idle_items (self->settings))
+        return;
+
+    /* From 1: the first item is the active one. */
+    for (guint i = 1; i < self->history->len; ++i)
+    {
+        GPasteItem *item = g_ptr_array_index (self->history, i);
+
+        self->size -= g_paste_item_get_size (item);
+        g_paste_item_compress (item);
+        self->size += g_paste_item_get_size (item);
+    }
+}
+
+static GPasteItem *
+g_paste_history_private_get_by_uuid (GPasteHistory *self,
+                                     const gchar   *uuid)
+{
+    GPasteUuid binary_uuid;
+
+    /* Not a uuid at all is no item's. */
+    return (g_paste_uuid_parse (uuid, &binary_uuid)) ? g_hash_table_lookup (self->by_uuid, &binary_uuid) : NULL;
+}
+
+/* The item plus where it currently sits.
+ *
+ * The position is looked up rather than indexed, because indexing it would cost
+ * more than it saves: adding prepends, which shifts every position, so a
+ * uuid->position map would have to be rewritten on every single add. The scan
+ * compares pointers, the item having already been found by uuid. */
+static GPasteItem *
+g_paste_history_private_get_indexed_by_uuid (GPasteHistory *self,
+                                             const gchar   *uuid,
+                                             guint         *index)
+{
+    GPasteItem *item = g_paste_history_private_get_by_uuid (self, uuid);
+
+    if (!item)
+        return NULL;
+
+    /* In the index but not in the array would mean the two had drifted apart.
+     * Checked with a real branch rather than g_return_val_if_fail(): that one
+     * compiles away entirely under G_DISABLE_CHECKS, taking the lookup with it
+     * and handing the caller an @index its stack happened to hold. */
+    if (!g_ptr_array_find (self->history, item, index))
+    {
+        g_critical ("The item with uuid \"%s\" is indexed but not in the history", uuid);
+        return NULL;
+    }
+
+    return item;
+}
+
+/*****************/
+/* The cold tier */
+/*****************/
+
+/* How many cold items stay at hand once read back (see @faulted). */
+#define G_PASTE_HISTORY_FAULTED_MAX 64
+
+/* How many cold items a scan of the cold tier reads back at once, which is
+ * also what each page of a streamed load holds. */
+#define G_PASTE_HISTORY_COLD_PAGE 256
+
+/* How many of the items that may go cold the first page of a background load
+ * holds: what clients have to show before the rest streams in, and a read that
+ * costs the same whatever the size of the history. */
+#define G_PASTE_HISTORY_FIRST_PAGE 64
+
+/* The resident bound a load honours: none for a backend that cannot serve a
+ * history a part at a time. */
+static guint64
+g_paste_history_private_resident_limit (GPasteHistory *self)
+{
+    return (g_paste_storage_backend_has_cold_tier (self->backend)) ? g_paste_settings_get_resident_history_size (self->settings) : 0;
+}
+
+/* Keep @item (transfer full), just read back from the cold tier, among the
+ * faulted ones, the oldest of which makes room for it. Hands back the copy
+ * already there instead, when it was read before. */
+static GPasteItem *
+g_paste_history_private_fault_in (GPasteHistory *self,
+                                  GPasteItem    *item)
+{
+    const GPasteUuid *uuid = g_paste_item_get_binary_uuid (item);
+    GPasteItem *known = g_hash_table_lookup (self->faulted, uuid);
+
+    if (known)
+    {
+        g_object_unref (item);
+        return known;
+    }
+
+    if (self->faulted_order.length >= G_PASTE_HISTORY_FAULTED_MAX)
+    {
+        GPasteItem *oldest = g_queue_pop_head (&self->faulted_order);
+
+        g_hash_table_remove (self->faulted, g_paste_item_get_binary_uuid (oldest));
+    }
+
+    g_queue_push_tail (&self->faulted_order, item);
+    g_hash_table_insert (self->faulted, (gpointer) uuid, item);
+
+    return item;
+}
+
+/* Take @item out of the faulted ones, handing their ref over to the caller. */
+static GPasteItem *
+g_paste_history_private_steal_faulted (GPasteHistory *self,
+                                       GPasteItem    *item)
+{
+    g_queue_remove (&self->faulted_order, item);
+    g_hash_table_steal (self->faulted, g_paste_item_get_binary_uuid (item));
+
+    return item;
+}
+
+/* Read back @limit cold items (every one, if 0) past the @offset newest. The
+ * store only holds what the history does once the pending writes are in. */
+static GList *
+g_paste_history_private_read_cold (GPasteHistory *self,
+                                   guint64        offset,
+                                   guint64        limit)
+{
+    if (!self->name || offset >= self->cold_length)
+        return NULL;
+
+    g_paste_history_saver_drain (self->saver);
+
+    return g_paste_storage_backend_read_history_tail (self->backend, self->name, g_paste_history_private_count_warm (self) + offset, limit);
+}
+
+static GPasteItem *
+g_paste_history_private_get_cold (GPasteHistory *self,
+                                  guint64        offset)
+{
+    GList *cold = g_paste_history_private_read_cold (self, offset, 1);
+    GPasteItem *item = (cold) ? g_paste_history_private_fault_in (self, cold->data) : NULL;
+
+    g_list_free (cold);
+
+    return item;
+}
+
+static GPasteItem *
+g_paste_history_private_get_cold_by_uuid (GPasteHistory *self,
+                                          const gchar   *uuid)
+{
+    GPasteUuid binary_uuid;
+
+    if (!self->cold_length || !self->name || !g_paste_uuid_parse (uuid, &binary_uuid))
+        return NULL;
+
+    GPasteItem *item = g_hash_table_lookup (self->faulted, &binary_uuid);
+
+    if (item)
+        return item;
+
+    g_paste_history_saver_drain (self->saver);
+
+    /* Whatever the store holds and the array does not is cold: a favourite or
+     * a password is always read with the head. Checked all the same, as
+     * faulting in an item the array should have had would only hide that. */
+    item = g_paste_storage_backend_read_stored_item (self->backend, self->name, uuid);
+
+    if (item && !g_paste_history_private_may_go_cold (item))
+        g_clear_object (&item);
+
+    return (item) ? g_paste_history_private_fault_in (self, item) : NULL;
+}
+
+/* Bring the cold @item back in memory at the end of the array, for it to stop
+ * being one: to become a favourite or a password, which the array always
+ * holds, or to be edited. Returns where it now sits. */
+static guint
+g_paste_history_private_promote (GPasteHistory *self,
+                                 GPasteItem    *item)
+{
+    g_paste_history_private_steal_faulted (self, item);
+
+    if (g_paste_settings_get_compress_idle_items (self->settings))
+        g_paste_item_compress (item);
+
+    g_ptr_array_add (self->history, item);
+    g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_binary_uuid (item), item);
+    self->size += g_paste_item_get_size (item);
+    --self->cold_length;
+    ++self->cold_serial;
+
+    return self->history->len - 1;
+}
+
+/* Leave the item at @index to the store, which already has it: only memory is
+ * freed. Says whether it was the elected biggest item, which the caller then
+ * re-elects once done. */
+static gboolean
+g_paste_history_private_demote (GPasteHistory *self,
+                                guint          index)
+{
+    GPasteItem *item = g_ptr_array_index (self->history, index);
+    gboolean was_biggest = g_paste_str_equal (self->biggest_uuid, g_paste_item_get_uuid (item));
+
+    /* Before the unref below: biggest_uuid borrows the item's own string. */
+    if (was_biggest)
+    {
+        self->biggest_uuid = NULL;
+        self->biggest_size = 0;
+    }
+
+    g_paste_history_private_remove (self, index, FALSE);
+    g_object_unref (item);
+    ++self->cold_length;
+    ++self->cold_serial;
+
+    return was_biggest;
+}
+
+/* Let the oldest items that may go cold do so, for as long as the array holds
+ * more of them than the resident bound allows or the memory cap has room for.
+ * From the tail, so what the array keeps is still the newest; and down to 1,
+ * never 0, the active item staying in memory whatever it is. */
+static void
+g_paste_history_private_spill (GPasteHistory *self)
+{
+    if (!self->resident_limit || !self->history->len)
+        return;
+
+    guint64 max_memory = g_paste_settings_get_max_memory_usage (self->settings) * 1024 * 1024;
+    guint64 warm = g_paste_history_private_count_warm (self);
+    gboolean dropped_biggest = FALSE;
+
+    for (guint i = self->history->len; --i > 0 && (warm > self->resident_limit || self->size > max_memory); )
+    {
+        if (!g_paste_history_private_may_go_cold (g_ptr_array_index (self->history, i)))
+            continue;
+
+        dropped_biggest |= g_paste_history_private_demote (self, i);
+        --warm;
+    }
+
+    if (dropped_biggest)
+        g_paste_history_private_elect_new_biggest (self);
+}
+
+/* Move @cold (transfer full), the newest cold items in order, to the end of
+ * the array. With @capped, what the memory cap has no room for stays cold, and
+ * so does everything older: says whether that happened. */
+static gboolean
+g_paste_history_private_append_cold (GPasteHistory *self,
+                                     GList         *cold,
+                                     gboolean       capped)
+{
+    guint64 max_memory = g_paste_settings_get_max_memory_usage (self->settings) * 1024 * 1024;
+    gboolean compress = g_paste_settings_get_compress_idle_items (self->settings);
+    gboolean full = FALSE;
+
+    for (GList *c = cold; c; c = g_list_next (c))
+    {
+        GPasteItem *item = c->data;
+
+        if (compress)
+            g_paste_item_compress (item);
+
+        guint64 size = g_paste_item_get_size (item);
+
+        /* What does not fit stays cold, and so does everything older. */
+        if (full || (capped && self->size + size > max_memory))
+        {
+            full = TRUE;
+            g_object_unref (item);
+            continue;
+        }
+
+        /* One item, one object: a faulted copy of it goes. */
+        GPasteItem *faulted = g_hash_table_lookup (self->faulted, g_paste_item_get_binary_uuid (item));
+
+        if (faulted)
+            g_object_unref (g_paste_history_private_steal_faulted (self, faulted));
+
+        g_ptr_array_add (self->history, item);
+        g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_binary_uuid (item), item);
+        self->size += size;
+        --self->cold_length;
+        ++self->cold_serial;
+
+        if (self->history->len > 1 && size >= self->biggest_size)
+        {
+            self->biggest_uuid = g_paste_item_get_uuid (item);
+            self->biggest_size = size;
+        }
+    }
+
+    g_list_free (cold);
+
+    return full;
+}
+
+/* The way back from a spill: bring cold items back while the array holds fewer of
+ * those that may go cold than the resident bound allows, and the memory cap
+ * has room for them. For after one left the array, or stopped being one. */
+static void
+g_paste_history_private_refill (GPasteHistory *self)
+{
+    if (!self->resident_limit || !self->cold_length)
+        return;
+
+    guint64 warm = g_paste_history_private_count_warm (self);
+
+    if (warm >= self->resident_limit)
+        return;
+
+    g_paste_history_private_append_cold (self, g_paste_history_private_read_cold (self, 0, MIN (self->resident_limit - warm, self->cold_length)), TRUE);
+}
+
+/* What a background load reads first: the first page, or less when the
+ * resident bound is lower still. The saver reads everything from a backend
+ * without a cold tier, which cannot serve a history a part at a time. */
+static guint64
+g_paste_history_private_first_page (GPasteHistory *self)
+{
+    return (self->resident_limit) ? MIN (self->resident_limit, G_PASTE_HISTORY_FIRST_PAGE) : G_PASTE_HISTORY_FIRST_PAGE;
+}
+
+/* Ask for the next page of a background load, for as long as the array holds
+ * less than it would have read at once: all of the history, or as much of it
+ * as the resident bound allows. Read in the background and behind the pending
+ * writes, so the store has everything recorded by then. */
+static void
+g_paste_history_private_stream (GPasteHistory *self)
+{
+    guint64 warm = g_paste_history_private_count_warm (self);
+    guint64 wanted = (self->resident_limit) ? self->resident_limit : G_MAXUINT64;
+
+    if (self->streaming || !self->name || !self->cold_length || warm >= wanted || self->stopped || self->unreadable)
+        return;
+
+    self->streaming = TRUE;
+    self->stream_serial = self->serial;
+    self->stream_cold_serial = self->cold_serial;
+
+    g_paste_history_saver_read_page (self->saver, self->name, warm, MIN (MIN (wanted - warm, self->cold_length), G_PASTE_HISTORY_COLD_PAGE), self->serial);
+}
+
+/* Every cold item that @pattern matches, a page at a time rather than the
+ * whole tier at once. */
+static void
+g_paste_history_private_search_cold (GPasteHistory *self,
+                                     GRegex        *regex,
+                                     const gchar   *pattern,
+                                     GStrvBuilder  *results)
+{
+    for (guint64 offset = 0; offset < self->cold_length; offset += G_PASTE_HISTORY_COLD_PAGE)
+    {
+        g_autolist (GPasteItem) page = g_paste_history_private_read_cold (self, offset, G_PASTE_HISTORY_COLD_PAGE);
+
+        if (!page)
+            break;
+
+        for (GList *p = page; p; p = g_list_next (p))
+        {
+            GPasteItem *item = p->data;
+            const gchar *uuid = g_paste_item_get_uuid (item);
+
+            if (g_paste_str_equal (pattern, uuid) ||
+                g_regex_match (regex, g_paste_item_get_value (item), G_REGEX_MATCH_NOTEMPTY|G_REGEX_MATCH_NEWLINE_ANY, NULL))
+                g_strv_builder_add (results, uuid);
+        }
+    }
+}
+
+/********************/
+/* Recent histories */
+/********************/
+
+/* A history switched away from, as it was left: its model and the tiered state
+ * that goes with it. Whatever it had not yet recorded is in the saver's queue,
+ * which writes to every history alike. */
+typedef struct
+{
+    gchar      *name;
+    GPtrArray  *history;
+    GHashTable *by_uuid;
+    gsize       size;
+    guint64     resident_limit;
+    guint64     cold_length;
+    /* Read ahead of a switch to it rather than switched away from */
+    gboolean    prefetched;
+} GPasteHistoryParked;
+
+/* Its items go the way g_paste_history_private_clear lets them: the history is
+ * only being let go of, so backing files are left alone. */
+static void
+g_paste_history_parked_free (gpointer data)
+{
+    g_autofree GPasteHistoryParked *parked = data;
+
+    g_free (parked->name);
+    g_clear_pointer (&parked->by_uuid, g_hash_table_unref);
+    g_clear_pointer (&parked->history, g_ptr_array_unref);
+}
+
+/* Let go of the oldest parked histories for as long as there are more of them
+ * than "recent-histories" allows, or than the memory cap has room for along with
+ * the @size bytes of the current one. They go before any item of the current
+ * one does: reading one back on the next switch to it is all it costs. */
+static void
+g_paste_history_private_shed_parked (GPasteHistory *self,
+                                     gsize          size)
+{
+    guint64 max_parked = g_paste_settings_get_recent_histories (self->settings);
+    guint64 max_memory = g_paste_settings_get_max_memory_usage (self->settings) * 1024 * 1024;
+
+    while (!g_queue_is_empty (&self->parked) && (self->parked.length > max_parked || size + self->parked_size > max_memory))
+    {
+        GPasteHistoryParked *oldest = g_queue_pop_tail (&self->parked);
+
+        self->parked_size -= oldest->size;
+        g_paste_history_parked_free (oldest);
+    }
+}
+
+static GPasteHistoryParked *
+g_paste_history_private_take_parked (GPasteHistory *self,
+                                     const gchar   *name)
+{
+    for (GList *p = self->parked.head; p; p = g_list_next (p))
+    {
+        GPasteHistoryParked *parked = p->data;
+
+        if (g_paste_str_equal (parked->name, name))
+        {
+            g_queue_delete_link (&self->parked, p);
+            self->parked_size -= parked->size;
+
+            return parked;
+        }
+    }
+
+    return NULL;
+}
+
+static gboolean
+g_paste_history_private_is_parked (GPasteHistory *self,
+                                   const gchar   *name)
+{
+    for (GList *p = self->parked.head; p; p = g_list_next (p))
+    {
+        if (g_paste_str_equal (((GPasteHistoryParked *) p->data)->name, name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Drop whatever the prefetch in flight brings back, if any. */
+static void
+g_paste_history_private_cancel_prefetch (GPasteHistory *self)
+{
+    ++self->prefetch_serial;
+    g_clear_pointer (&self->prefetching, g_free);
+}
+
+/* Let go of the parked copy of @name, if any: its store is about to change
+ * behind it, or to be read back anyway. The same goes for a copy of it still
+ * on its way. */
+static void
+g_paste_history_private_forget_parked (GPasteHistory *self,
+                                       const gchar   *name)
+{
+    GPasteHistoryParked *parked = g_paste_history_private_take_parked (self, name);
+
+    if (parked)
+        g_paste_history_parked_free (parked);
+    if (g_paste_str_equal (self->prefetching, name))
+        g_paste_history_private_cancel_prefetch (self);
+}
+
+static void
+g_paste_history_private_forget_all_parked (GPasteHistory *self)
+{
+    g_queue_clear_full (&self->parked, g_paste_history_parked_free);
+    self->parked_size = 0;
+    g_paste_history_private_cancel_prefetch (self);
+}
+
+/* Switching away: put the current history aside rather than drop it, when it
+ * is whole and sound -- neither still loading, nor unreadable, nor handed over.
+ * Leaves the model empty either way, as g_paste_history_private_clear does.
+ * Nothing is shed yet: the history switched to may well be among the parked
+ * ones, and is not to make room for itself. */
+static void
+g_paste_history_private_park (GPasteHistory *self)
+{
+    if (self->name && !self->stopped && !self->unreadable &&
+        !g_paste_history_saver_is_loading (self->saver) &&
+        g_paste_settings_get_recent_histories (self->settings))
+    {
+        GPasteHistoryParked *parked = g_new (GPasteHistoryParked, 1);
+
+        parked->name = g_strdup (self->name);
+        parked->history = g_steal_pointer (&self->history);
+        parked->by_uuid = g_steal_pointer (&self->by_uuid);
+        parked->size = self->size;
+        parked->resident_limit = self->resident_limit;
+        parked->cold_length = self->cold_length;
+        parked->prefetched = FALSE;
+
+        self->history = g_ptr_array_new_with_free_func (g_object_unref);
+        self->by_uuid = g_hash_table_new (g_paste_uuid_hash, g_paste_uuid_equal);
+
+        g_queue_push_head (&self->parked, parked);
+        self->parked_size += parked->size;
+    }
+
+    g_paste_history_private_clear (self);
+    self->size = 0;
+    /* biggest_uuid borrows from an item that is now parked, or gone. */
+    g_paste_history_private_elect_new_biggest (self);
+}
+
+/* Switching back: install the parked copy of @name as the model, if there is
+ * one, and count the hit. Says whether there was. */
+static gboolean
+g_paste_history_private_unpark (GPasteHistory *self,
+                                const gchar   *name)
+{
+    GPasteHistoryParked *parked = g_paste_history_private_take_parked (self, name);
+
+    if (!parked)
+        return FALSE;
+
+    g_paste_history_private_clear (self);
+    g_ptr_array_unref (self->history);
+    g_hash_table_unref (self->by_uuid);
+
+    self->history = g_steal_pointer (&parked->history);
+    self->by_uuid = g_steal_pointer (&parked->by_uuid);
+    self->size = parked->size;
+    self->resident_limit = parked->resident_limit;
+    self->cold_length = parked->cold_length;
+
+    ++self->switch_hits;
+    if (parked->prefetched)
+        ++self->prefetch_hits;
+
+    g_paste_history_parked_free (parked);
+    g_paste_history_private_elect_new_biggest (self);
+
+    return TRUE;
+}
+
+/*********************/
+/* Switch prediction */
+/*********************/
+
+/* How many pairs of histories are remembered at most, and how high a count goes
+ * before those of its history are halved. */
+#define G_PASTE_HISTORY_TRANSITIONS_MAX 64
+#define G_PASTE_HISTORY_TRANSITION_CAP 1024
+
+/* How many times @to was switched to right from @from */
+typedef struct
+{
+    gchar  *from;
+    gchar  *to;
+    guint64 count;
+} GPasteHistoryTransition;
+
+static GPasteHistoryTransition *
+g_paste_history_transition_new (const gchar *from,
+                                const gchar *to,
+                                guint64      count)
+{
+    GPasteHistoryTransition *transition = g_new (GPasteHistoryTransition, 1);
+
+    transition->from = g_strdup (from);
+    transition->to = g_strdup (to);
+    transition->count = count;
+
+    return transition;
+}
+
+static void
+g_paste_history_transition_free (gpointer data)
+{
+    g_autofree GPasteHistoryTransition *transition = data;
+
+    g_free (transition->from);
+    g_free (transition->to);
+}
+
+/* Next to the settings: it is about how the histories are used, not about any
+ * one of them, so it stays out of the stores. */
+static gchar *
+g_paste_history_transitions_path (void)
+{
+    return g_build_filename (g_get_user_config_dir (), PACKAGE, "history-transitions", NULL);
+}
+
+/* One group per pair, with the names as values: a history name is whatever the
+ * user typed, which a key could not always hold. */
+static void
+g_paste_history_private_ensure_transitions (GPasteHistory *self)
+{
+    if (self->transitions)
+        return;
+
+    self->transitions = g_ptr_array_new_with_free_func (g_paste_history_transition_free);
+
+    g_autofree gchar *path = g_paste_history_transitions_path ();
+    g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+
+    if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+        return;
+
+    g_auto (GStrv) groups = g_key_file_get_groups (keyfile, NULL);
+
+    for (GStrv group = groups; *group && self->transitions->len < G_PASTE_HISTORY_TRANSITIONS_MAX; ++group)
+    {
+        g_autofree gchar *from = g_key_file_get_string (keyfile, *group, "From", NULL);
+        g_autofree gchar *to = g_key_file_get_string (keyfile, *group, "To", NULL);
+        guint64 count = g_key_file_get_uint64 (keyfile, *group, "Count", NULL);
+
+        if (from && to && count)
+            g_ptr_array_add (self->transitions, g_paste_history_transition_new (from, to, MIN (count, G_PASTE_HISTORY_TRANSITION_CAP)));
+    }
+}
+
+static void
+g_paste_history_on_transitions_saved (GObject      *source_object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data G_GNUC_UNUSED)
+{
+    g_autoptr (GError) error = NULL;
+
+    if (!g_file_replace_contents_finish (G_FILE (source_object), result, NULL /* new etag */, &error))
+        g_warning ("Could not save which histories follow which: %s", error->message);
+}
+
+/* Written in the background: it is only ever a hint, and the last one written
+ * wins. */
+static void
+g_paste_history_private_save_transitions (GPasteHistory *self)
+{
+    g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+
+    for (guint i = 0; i < self->transitions->len; ++i)
+    {
+        const GPasteHistoryTransition *transition = g_ptr_array_index (self->transitions, i);
+        g_autofree gchar *group = g_strdup_printf ("Switch %u", i);
+
+        g_key_file_set_string (keyfile, group, "From", transition->from);
+        g_key_file_set_string (keyfile, group, "To", transition->to);
+        g_key_file_set_uint64 (keyfile, group, "Count", transition->count);
+    }
+
+    g_autofree gchar *path = g_paste_history_transitions_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    gsize length;
+    gchar *data = g_key_file_to_data (keyfile, &length, NULL);
+    g_autoptr (GBytes) bytes = g_bytes_new_take (data, length);
+
+    g_mkdir_with_parents (dir, 0700);
+    g_file_replace_contents_bytes_async (file, bytes, NULL /* etag */, FALSE /* backup */, G_FILE_CREATE_PRIVATE,
+                                         NULL /* cancellable */, g_paste_history_on_transitions_saved, NULL);
+}
+
+/* Halve the counts of the switches away from @from, forgetting those that fall
+ * to nothing, so what the user did long ago weighs less than what they do now. */
+static void
+g_paste_history_private_age_transitions (GPasteHistory *self,
+                                         const gchar   *from)
+{
+    for (guint i = self->transitions->len; i > 0; --i)
+    {
+        GPasteHistoryTransition *transition = g_ptr_array_index (self->transitions, i - 1);
+
+        if (g_paste_str_equal (transition->from, from) && !(transition->count /= 2))
+            g_ptr_array_remove_index_fast (self->transitions, i - 1);
+    }
+}
+
+/* Count a switch from @from to @to, making room for a pair not seen yet by
+ * forgetting the least seen one. */
+static void
+g_paste_history_private_count_switch (GPasteHistory *self,
+                                      const gchar   *from,
+                                      const gchar   *to)
+{
+    GPasteHistoryTransition *least = NULL;
+
+    for (guint i = 0; i < self->transitions->len; ++i)
+    {
+        GPasteHistoryTransition *transition = g_ptr_array_index (self->transitions, i);
+
+        if (g_paste_str_equal (transition->from, from) && g_paste_str_equal (transition->to, to))
+        {
+            if (++transition->count >= G_PASTE_HISTORY_TRANSITION_CAP)
+                g_paste_history_private_age_transitions (self, from);
+            return;
+        }
+
+        if (!least || transition->count < least->count)
+            least = transition;
+    }
 
-    return snapshot;
+    if (self->transitions->len >= G_PASTE_HISTORY_TRANSITIONS_MAX)
+        g_ptr_array_remove_fast (self->transitions, least);
+
+    g_ptr_array_add (self->transitions, g_paste_history_transition_new (from, to, 1));
 }
 
-/* Drop every item, keeping the containers. Releases the array's refs through
- * its free func (a plain unref: unlike g_paste_history_empty this is a history
- * being swapped out, not thrown away, so backing files are left alone). */
+/* A switch is only noted down here, to be counted once the main loop is idle:
+ * counting it means reading the transitions in the first time, which the
+ * switch itself has no reason to wait for. */
 static void
-g_paste_history_private_clear (GPasteHistory *self)
+g_paste_history_private_note_switch (GPasteHistory *self,
+                                     const gchar   *from)
 {
-    g_ptr_array_set_size (self->history, 0);
-    g_hash_table_remove_all (self->by_uuid);
+    if (!from || g_paste_str_equal (from, self->name))
+        return;
+
+    ++self->switches;
+    g_ptr_array_add (self->pending_switches, g_paste_history_transition_new (from, self->name, 1));
 }
 
-/* Take over an item list from the storage layer (transfer full) and install it
- * as the model, rebuilding the uuid index with it. */
+/* Stop predicting switches to or from a history that is no more. */
 static void
-g_paste_history_private_set_from_list (GPasteHistory *self,
-                                       GList         *history)
+g_paste_history_private_forget_transitions (GPasteHistory *self,
+                                            const gchar   *name)
 {
-    g_paste_history_private_clear (self);
+    g_paste_history_private_ensure_transitions (self);
 
-    for (GList *h = history; h; h = g_list_next (h))
+    guint length_before = self->transitions->len;
+
+    for (guint i = self->transitions->len; i > 0; --i)
     {
-        GPasteItem *item = h->data;
+        const GPasteHistoryTransition *transition = g_ptr_array_index (self->transitions, i - 1);
 
-        g_ptr_array_add (self->history, item);
-        g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_uuid (item), item);
+        if (g_paste_str_equal (transition->from, name) || g_paste_str_equal (transition->to, name))
+            g_ptr_array_remove_index_fast (self->transitions, i - 1);
     }
 
-    /* The refs moved into the array; only the links are ours to free. */
-    g_list_free (history);
+    if (self->transitions->len != length_before)
+        g_paste_history_private_save_transitions (self);
 }
 
-static void
-g_paste_history_emit_update (GPasteHistory     *self,
-                             GPasteUpdateAction action,
-                             GPasteUpdateTarget target,
-                             const gchar       *uuid,
-                             guint64            position)
+/* The history most often switched to from the current one, unless it is at
+ * hand already. */
+static const gchar *
+g_paste_history_private_predict (GPasteHistory *self)
 {
-    g_debug ("history: update");
+    const GPasteHistoryTransition *best = NULL;
 
-    g_signal_emit (self,
-                   signals[UPDATE],
-                   0, /* detail */
-                   action,
-                   target,
-                   (uuid) ?: "",
-                   position,
-                   NULL);
+    for (guint i = 0; i < self->transitions->len; ++i)
+    {
+        const GPasteHistoryTransition *transition = g_ptr_array_index (self->transitions, i);
+
+        if (g_paste_str_equal (transition->from, self->name) && !g_paste_str_equal (transition->to, self->name) &&
+            (!best || transition->count > best->count))
+            best = transition;
+    }
+
+    if (!best || g_paste_history_private_is_parked (self, best->to))
+        return NULL;
+
+    return best->to;
 }
 
-/* @displaced says whether anything left the history alongside the change: a
- * dedup, a grown line replacing its shorter self, or an eviction. It only means
- * anything for an add on an incremental backend -- see below. */
+/* Keep what a prefetch read aside like a history switched away from, as the
+ * latest one: it is the likeliest to be switched to next. */
 static void
-g_paste_history_update (GPasteHistory      *self,
-                        GPasteUpdateAction  action,
-                        GPasteUpdateTarget  target,
-                        guint64             position,
-                        GPasteHistorySaveOp op,
-                        GPasteItem         *item,
-                        const gchar        *uuid,
-                        gboolean            displaced)
+g_paste_history_on_prefetched (GObject      *source_object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
 {
-    /* Don't persist intermediate states while an async load is replacing the
-     * history (the load result triggers its own save when appropriate), nor once
-     * we have been flushed for handover (a successor daemon owns the file now). */
-    if (!self->stopped && !self->unreadable && !g_paste_history_saver_is_loading (self->saver))
+    GPasteHistory *self = G_PASTE_HISTORY (source_object);
+    G_PASTE_LOCK_HISTORY;
+
+    /* Made moot meanwhile (see g_paste_history_private_cancel_prefetch), maybe
+     * by the very saver it was asked of going away: the task frees whatever it
+     * read. */
+    if (GPOINTER_TO_UINT (user_data) != self->prefetch_serial)
+        return;
+
+    g_autoptr (GError) error = NULL;
+    gsize size = 0;
+    guint64 cold_length = 0;
+    g_autolist (GPasteItem) history = g_paste_history_saver_prefetch_finish (self->saver, result, &size, &cold_length, &error);
+
+    g_autofree gchar *name = g_steal_pointer (&self->prefetching);
+
+    if (error)
     {
-        /* A non-incremental backend rewrites everything and always needs the
-         * snapshot. An incremental one only reconciles what rode along with an
-         * add -- and reconciliation only ever deletes rows the history no longer
-         * has, so with nothing displaced there is provably nothing to delete.
-         * That is the common case, and it is what spares a per-item ref-copy of
-         * the whole history on every single clipboard change. */
-        gboolean full = !g_paste_storage_backend_is_incremental (self->backend);
-        GList *snapshot = (full || op == G_PASTE_HISTORY_SAVE_FULL || (op == G_PASTE_HISTORY_SAVE_ADD && displaced))
-            ? g_paste_history_snapshot (self)
-            : NULL;
+        /* A switch to it will tell, and say why. */
+        g_debug ("history: could not prefetch '%s': %s", name, error->message);
+        return;
+    }
 
-        g_paste_history_saver_record (self->saver, op, self->name, item, uuid, snapshot);
+    if (self->stopped || g_paste_str_equal (name, self->name) || g_paste_history_private_is_parked (self, name))
+        return;
+
+    GPasteHistoryParked *parked = g_new (GPasteHistoryParked, 1);
+    gboolean compress = g_paste_settings_get_compress_idle_items (self->settings);
+
+    parked->name = g_steal_pointer (&name);
+    parked->history = g_ptr_array_new_with_free_func (g_object_unref);
+    parked->by_uuid = g_hash_table_new (g_paste_uuid_hash, g_paste_uuid_equal);
+    parked->size = size;
+    parked->resident_limit = g_paste_history_private_resident_limit (self);
+    parked->cold_length = cold_length;
+    parked->prefetched = TRUE;
+
+    for (GList *h = history; h; h = g_list_next (h))
+    {
+        GPasteItem *item = h->data;
+
+        /* As g_paste_history_private_compress_idle would, on the way in */
+        if (compress && parked->history->len)
+        {
+            parked->size -= g_paste_item_get_size (item);
+            g_paste_item_compress (item);
+            parked->size += g_paste_item_get_size (item);
+        }
+
+        g_ptr_array_add (parked->history, g_object_ref (item));
+        g_hash_table_insert (parked->by_uuid, (gpointer) g_paste_item_get_binary_uuid (item), item);
     }
 
-    /* The item the change is about: whichever one it left behind, or the uuid
-     * alone when it left none (a removal). Neither rides along with an ALL,
-     * which is about the history and not about any one item of it: the
-     * interface says both are empty there, and a client that reads the uuid
-     * whenever it is non-empty would otherwise act on an item the update was
-     * never about. The saver still gets @item -- what it persists and what the
-     * signal is about are two different questions. */
-    if (target == G_PASTE_UPDATE_TARGET_ALL)
-        g_paste_history_emit_update (self, action, target, NULL, 0);
-    else
-        g_paste_history_emit_update (self, action, target, (item) ? g_paste_item_get_uuid (item) : uuid, position);
+    g_queue_push_head (&self->parked, parked);
+    self->parked_size += parked->size;
+    g_paste_history_private_shed_parked (self, self->size);
 }
 
+/* Read the likeliest next history ahead of the switch to it, when there is
+ * room to keep it and nothing else is being read: it goes the way of the
+ * writes, on the saver's thread and behind them. */
 static void
-g_paste_history_activate_first (GPasteHistory *self,
-                                gboolean       select)
+g_paste_history_private_prefetch (GPasteHistory *self)
 {
-    if (!self->history->len)
+    if (!self->name || self->prefetching || self->stopped || self->unreadable ||
+        g_paste_history_saver_is_loading (self->saver) ||
+        !g_paste_settings_get_recent_histories (self->settings))
         return;
 
-    GPasteItem *first = g_ptr_array_index (self->history, 0);
+    const gchar *next = g_paste_history_private_predict (self);
 
-    self->size -= g_paste_item_get_size (first);
-    g_paste_item_set_state (first, G_PASTE_ITEM_STATE_ACTIVE);
-    self->size += g_paste_item_get_size (first);
+    if (!next)
+        return;
 
-    if (select)
-        g_paste_history_selected (self, first);
-}
+    g_debug ("history: prefetching '%s'", next);
 
-static GPasteItem *
-g_paste_history_private_get_by_uuid (GPasteHistory *self,
-                                     const gchar   *uuid)
-{
-    return (uuid) ? g_hash_table_lookup (self->by_uuid, uuid) : NULL;
+    self->prefetching = g_strdup (next);
+    ++self->prefetches;
+    g_paste_history_saver_prefetch (self->saver, next, g_paste_history_private_first_page (self),
+                                    g_paste_history_on_prefetched, GUINT_TO_POINTER (self->prefetch_serial));
 }
 
-/* The item plus where it currently sits.
- *
- * The position is looked up rather than indexed, because indexing it would cost
- * more than it saves: adding prepends, which shifts every position, so a
- * uuid->position map would have to be rewritten on every single add. The scan
- * compares pointers, the item having already been found by uuid. */
-static GPasteItem *
-g_paste_history_private_get_indexed_by_uuid (GPasteHistory *self,
-                                             const gchar   *uuid,
-                                             guint         *index)
+static gboolean
+g_paste_history_on_idle (gpointer user_data)
 {
-    GPasteItem *item = g_paste_history_private_get_by_uuid (self, uuid);
+    GPasteHistory *self = user_data;
+    G_PASTE_LOCK_HISTORY;
 
-    if (!item)
-        return NULL;
+    self->prefetch_source = 0;
 
-    /* In the index but not in the array would mean the two had drifted apart.
-     * Checked with a real branch rather than g_return_val_if_fail(): that one
-     * compiles away entirely under G_DISABLE_CHECKS, taking the lookup with it
-     * and handing the caller an @index its stack happened to hold. */
-    if (!g_ptr_array_find (self->history, item, index))
+    g_paste_history_private_ensure_transitions (self);
+
+    if (self->pending_switches->len)
     {
-        g_critical ("The item with uuid \"%s\" is indexed but not in the history", uuid);
-        return NULL;
+        for (guint i = 0; i < self->pending_switches->len; ++i)
+        {
+            const GPasteHistoryTransition *transition = g_ptr_array_index (self->pending_switches, i);
+
+            g_paste_history_private_count_switch (self, transition->from, transition->to);
+        }
+
+        g_ptr_array_set_size (self->pending_switches, 0);
+        g_paste_history_private_save_transitions (self);
     }
 
-    return item;
+    g_paste_history_private_prefetch (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Once a history is in, and the main loop has nothing better to do: count the
+ * switches made, then read ahead the history likely to come next. */
+static void
+g_paste_history_private_schedule_prefetch (GPasteHistory *self)
+{
+    if (!self->prefetch_source)
+        self->prefetch_source = g_idle_add_full (G_PRIORITY_LOW, g_paste_history_on_idle, self, NULL);
 }
 
 static void
@@ -383,12 +1440,22 @@ g_paste_history_private_check_memory_usage (GPasteHistory *self)
 {
     guint64 max_memory = g_paste_settings_get_max_memory_usage (self->settings) * 1024 * 1024;
 
+    /* The parked histories make room first. */
+    g_paste_history_private_shed_parked (self, self->size);
+
+    /* In the tiered mode, whatever may go cold does so first: the store keeps
+     * it, where an eviction would not. */
+    g_paste_history_private_spill (self);
+
     while (self->size > max_memory && self->biggest_uuid)
     {
         guint index;
 
         if (g_paste_history_private_get_indexed_by_uuid (self, self->biggest_uuid, &index))
+        {
+            g_paste_history_private_drop_stored (self, g_ptr_array_index (self->history, index));
             g_paste_history_private_remove (self, index, TRUE);
+        }
 
         /* Also re-points biggest_uuid, which borrowed its string from the item
          * just freed. */
@@ -412,10 +1479,22 @@ g_paste_history_private_check_size (GPasteHistory *self)
      * Down to 1, never 0: the first item is the one just added or selected, and
      * a history whose every other entry is pinned would otherwise evict it on
      * the spot -- the clipboard would stop keeping anything at all. The memory
-     * cap leaves that slot alone for the same reason. */
+     * cap leaves that slot alone for the same reason.
+     *
+     * The cold tier is the oldest part of the history, so it goes first, cut
+     * straight from the store: nothing of it is in memory to walk through. */
+    guint64 length = g_paste_history_private_get_length (self);
+
+    if (length > max_history_size && self->cold_length)
+    {
+        self->cold_length -= MIN (length - max_history_size, self->cold_length);
+        self->truncated = TRUE;
+        g_paste_history_private_forget_faulted (self);
+    }
+
     gboolean dropped_biggest = FALSE;
 
-    for (guint i = self->history->len; --i > 0 && self->history->len > max_history_size; )
+    for (guint i = self->history->len; --i > 0 && g_paste_history_private_get_length (self) > max_history_size; )
     {
         GPasteItem *item = g_ptr_array_index (self->history, i);
 
@@ -433,6 +1512,7 @@ g_paste_history_private_check_size (GPasteHistory *self)
             dropped_biggest = TRUE;
         }
 
+        g_paste_history_private_drop_stored (self, item);
         g_paste_history_private_remove (self, i, TRUE);
     }
 
@@ -458,13 +1538,17 @@ g_paste_history_private_trim (GPasteHistory *self)
     if (self->stopped || self->unreadable)
         return;
 
-    guint length_before = self->history->len;
+    guint64 length_before = g_paste_history_private_get_length (self);
+    guint resident_before = self->history->len;
 
     g_paste_history_private_check_size (self);
     g_paste_history_private_check_memory_usage (self);
 
-    if (self->history->len != length_before)
+    /* Items going cold changes what the array lists, not what the store has. */
+    if (g_paste_history_private_get_length (self) != length_before)
         g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_FULL, NULL, NULL, FALSE);
+    else if (self->history->len != resident_before)
+        g_paste_history_emit_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, NULL, 0);
 }
 
 /* A line grows as it is typed or selected, which only plain text and uri lists
@@ -511,8 +1595,8 @@ _g_paste_history_add (GPasteHistory *self,
     if (g_paste_item_get_size (item) > max_memory)
         return;
 
-    guint length_before = self->history->len;
-    gboolean election_needed = !length_before; // If we don't have an history we want to initalize the biggest
+    guint64 length_before = g_paste_history_private_get_length (self);
+    gboolean election_needed = !self->history->len; // If we don't have an history we want to initalize the biggest
 
     g_debug ("history: add");
 
@@ -535,6 +1619,7 @@ _g_paste_history_add (GPasteHistory *self,
             /* old_first is a distinct object replaced by the grown item; free it
              * (its shared backing file, if any, is kept). */
             g_autoptr (GPasteItem) dropped = old_first;
+            g_paste_history_private_drop_stored (self, old_first);
             g_paste_history_private_remove (self, 0, FALSE);
         }
         else
@@ -542,6 +1627,8 @@ _g_paste_history_add (GPasteHistory *self,
             /* size may change when state is idle */
             self->size -= g_paste_item_get_size (old_first);
             g_paste_item_set_state (old_first, G_PASTE_ITEM_STATE_IDLE);
+            if (g_paste_settings_get_compress_idle_items (self->settings))
+                g_paste_item_compress (old_first);
 
             guint64 size = g_paste_item_get_size (old_first);
 
@@ -573,6 +1660,8 @@ _g_paste_history_add (GPasteHistory *self,
                      * backing file is kept). On select, @entry IS @item being moved
                      * to the front, so its ref must be left alone. */
                     g_autoptr (GPasteItem) dropped = new_selection ? entry : NULL;
+                    if (dropped)
+                        g_paste_history_private_drop_stored (self, dropped);
                     g_paste_history_private_remove (self, i, FALSE);
                     break;
                 }
@@ -581,7 +1670,7 @@ _g_paste_history_add (GPasteHistory *self,
     }
 
     g_ptr_array_insert (self->history, 0, item);
-    g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_uuid (item), item);
+    g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_binary_uuid (item), item);
     g_steal_pointer (&owned); /* ownership transferred to the history */
 
     g_paste_history_activate_first (self, FALSE);
@@ -598,8 +1687,9 @@ _g_paste_history_add (GPasteHistory *self,
     g_paste_history_private_check_memory_usage (self);
 
     /* One in and nothing out means nothing was deduped, grown over or evicted;
-     * anything else and the store has rows the history no longer has. */
-    gboolean displaced = self->history->len != length_before + 1;
+     * anything else and the store has rows the history no longer has. Items
+     * going cold do not count: the store keeps those. */
+    gboolean displaced = g_paste_history_private_get_length (self) != length_before + 1;
 
     /* TARGET_ALL whichever path got here. An ordinary add shifts every position
      * along; a grown line is a new item, with a uuid of its own, standing where
@@ -648,6 +1738,22 @@ g_paste_history_remove_common (GPasteHistory *self,
         g_paste_history_private_elect_new_biggest (self);
 
     g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REMOVE, G_PASTE_UPDATE_TARGET_ITEM, index, G_PASTE_HISTORY_SAVE_REMOVE, NULL, uuid, FALSE);
+    g_paste_history_private_refill (self);
+}
+
+/* An item only the store holds has no place in the array to report, so the
+ * update is about the whole history. */
+static void
+g_paste_history_remove_cold (GPasteHistory *self,
+                             GPasteItem    *item)
+{
+    GPasteItem *removed = g_paste_history_private_steal_faulted (self, item);
+
+    --self->cold_length;
+    ++self->cold_serial;
+
+    g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REMOVE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_REMOVE, NULL, g_paste_item_get_uuid (removed), FALSE);
+    g_paste_history_item_free (self, removed);
 }
 
 static void
@@ -657,7 +1763,13 @@ g_paste_history_remove_locked (GPasteHistory *self,
     g_debug ("history: remove '%" G_GUINT64_FORMAT "'", index);
 
     if (index >= self->history->len)
+    {
+        GPasteItem *cold = g_paste_history_private_get_cold (self, index - self->history->len);
+
+        if (cold)
+            g_paste_history_remove_cold (self, cold);
         return;
+    }
 
     g_paste_history_remove_common (self, g_ptr_array_index (self->history, index), (guint) index);
 }
@@ -703,17 +1815,26 @@ g_paste_history_remove_by_uuid (GPasteHistory *self,
     GPasteItem *item = g_paste_history_private_get_indexed_by_uuid (self, uuid, &index);
 
     if (!item)
-        return FALSE;
+    {
+        GPasteItem *cold = g_paste_history_private_get_cold_by_uuid (self, uuid);
+
+        if (!cold)
+            return FALSE;
+
+        g_paste_history_remove_cold (self, cold);
+        return TRUE;
+    }
 
     g_paste_history_remove_common (self, item, index);
     return TRUE;
 }
 
+/* Past the array is the cold tier, read back on demand. */
 static GPasteItem *
 g_paste_history_private_get (GPasteHistory *self,
                              guint64        index)
 {
-    return (index < self->history->len) ? g_ptr_array_index (self->history, index) : NULL;
+    return (index < self->history->len) ? g_ptr_array_index (self->history, index) : g_paste_history_private_get_cold (self, index - self->history->len);
 }
 
 /**
@@ -755,7 +1876,7 @@ g_paste_history_get_by_uuid (GPasteHistory *self,
 
     G_PASTE_LOCK_HISTORY;
 
-    return g_paste_history_private_get_by_uuid (self, uuid);
+    return g_paste_history_private_get_by_uuid (self, uuid) ?: g_paste_history_private_get_cold_by_uuid (self, uuid);
 }
 
 /**
@@ -783,6 +1904,36 @@ g_paste_history_dup (GPasteHistory *self,
     return (item) ? g_object_ref (item) : NULL;
 }
 
+/* Selecting a cold item brings it back at the front the way a copy of it would
+ * arrive, only keeping the uuid and the row it already has. */
+static gboolean
+g_paste_history_select_cold (GPasteHistory *self,
+                             const gchar   *uuid)
+{
+    GPasteItem *item = g_paste_history_private_get_cold_by_uuid (self, uuid);
+
+    if (!item)
+        return FALSE;
+
+    /* The add takes the cache's ref over; this one tells whether it kept it. */
+    g_autoptr (GPasteItem) selected = g_object_ref (item);
+
+    /* Out of the cold tier before the add, which counts the history's length
+     * against its cap: the item must not be there twice meanwhile. */
+    --self->cold_length;
+    ++self->cold_serial;
+    _g_paste_history_add (self, g_paste_history_private_steal_faulted (self, item), TRUE);
+
+    if (!self->history->len || g_ptr_array_index (self->history, 0) != selected)
+    {
+        ++self->cold_length;
+        return FALSE;
+    }
+
+    g_paste_history_selected (self, selected);
+    return TRUE;
+}
+
 /**
  * g_paste_history_select:
  * @self: a #GPasteHistory instance
@@ -803,7 +1954,7 @@ g_paste_history_select (GPasteHistory *self,
     GPasteItem *item = g_paste_history_private_get_by_uuid (self, uuid);
 
     if (!item)
-        return FALSE;
+        return g_paste_history_select_cold (self, uuid);
 
     _g_paste_history_add (self, item, FALSE);
     g_paste_history_selected (self, item);
@@ -832,11 +1983,11 @@ _g_paste_history_replace (GPasteHistory *self,
      * not run) so we drop it ourselves, and @new takes the same slot. Unlike a
      * removal this keeps any backing file, since only the item wrapping it is
      * being replaced. */
-    g_hash_table_remove (self->by_uuid, old_uuid);
+    g_hash_table_remove (self->by_uuid, g_paste_item_get_binary_uuid (old));
     g_ptr_array_steal_index (self->history, index);
     g_object_unref (old);
     g_ptr_array_insert (self->history, index, new);
-    g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_uuid (new), new);
+    g_hash_table_insert (self->by_uuid, (gpointer) g_paste_item_get_binary_uuid (new), new);
 
     if (was_biggest)
         g_paste_history_private_elect_new_biggest (self);
@@ -866,17 +2017,27 @@ g_paste_history_replace (GPasteHistory *self,
     G_PASTE_LOCK_HISTORY;
     guint index;
     GPasteItem *item = g_paste_history_private_get_indexed_by_uuid (self, uuid, &index);
+    gboolean cold = FALSE;
+
+    if (!item && (item = g_paste_history_private_get_cold_by_uuid (self, uuid)))
+        cold = TRUE;
 
     if (!item)
         return;
 
     g_return_if_fail (G_PASTE_IS_TEXT_ITEM (item));
 
+    /* A cold item is edited in memory, and goes back once done. */
+    if (cold)
+        index = g_paste_history_private_promote (self, item);
+
     GPasteItem *new = g_paste_text_item_new (contents);
 
     _g_paste_history_replace (self, index, new);
 
-    if (!index)
+    if (cold)
+        g_paste_history_private_spill (self);
+    else if (!index)
         g_paste_history_selected (self, new);
 }
 
@@ -904,9 +2065,20 @@ g_paste_history_set_favourite (GPasteHistory *self,
     G_PASTE_LOCK_HISTORY;
     guint index;
     GPasteItem *item = g_paste_history_private_get_indexed_by_uuid (self, uuid, &index);
+    gboolean promoted = FALSE;
 
     if (!item)
-        return FALSE;
+    {
+        item = g_paste_history_private_get_cold_by_uuid (self, uuid);
+
+        /* A cold item is never a favourite, and pinning one brings it back in
+         * memory, where every favourite is. */
+        if (!item || !favourite)
+            return !!item;
+
+        index = g_paste_history_private_promote (self, item);
+        promoted = TRUE;
+    }
 
     if (g_paste_item_is_favourite (item) == favourite)
         return TRUE;
@@ -915,7 +2087,10 @@ g_paste_history_set_favourite (GPasteHistory *self,
 
     /* Our own copy: un-pinning can evict the very item we are holding. */
     g_autofree gchar *item_uuid = g_strdup (uuid);
-    guint length_before = self->history->len;
+    /* And our own ref, for the tiered mode to still name it to the store. */
+    g_autoptr (GPasteItem) held = g_object_ref (item);
+    guint64 length_before = g_paste_history_private_get_length (self);
+    guint resident_before = self->history->len;
 
     g_paste_item_set_favourite (item, favourite);
 
@@ -926,6 +2101,13 @@ g_paste_history_set_favourite (GPasteHistory *self,
         if (g_paste_str_equal (self->biggest_uuid, item_uuid))
             g_paste_history_private_elect_new_biggest (self);
     }
+    else if (self->resident_limit && index && self->cold_length && !g_paste_history_private_has_warm_after (self, index))
+    {
+        /* Nothing in memory that may go cold is older than it, so the cold
+         * tier may well hold newer items than this one: it joins them rather
+         * than jump the queue. A favourite is never the elected one. */
+        g_paste_history_private_demote (self, index);
+    }
     else
     {
         /* The pool gained it, so nothing has to be re-elected: one comparison
@@ -944,7 +2126,9 @@ g_paste_history_set_favourite (GPasteHistory *self,
         g_paste_history_private_check_memory_usage (self);
     }
 
-    if (self->history->len != length_before)
+    gboolean evicted = g_paste_history_private_get_length (self) != length_before;
+
+    if (evicted && !g_paste_history_private_is_partial (self))
     {
         /* Evictions rode along. A replace carries no snapshot for an incremental
          * backend to reconcile against — unlike an add, which is the one
@@ -955,7 +2139,16 @@ g_paste_history_set_favourite (GPasteHistory *self,
         g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_FULL, NULL, NULL, FALSE);
     }
     else
-        g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ITEM, index, G_PASTE_HISTORY_SAVE_REPLACE, item, item_uuid, FALSE);
+    {
+        /* The tiered mode names the evicted to the store itself, after this.
+         * The array moving around is about more than this one item, though. */
+        GPasteUpdateTarget target = (promoted || self->history->len != resident_before) ? G_PASTE_UPDATE_TARGET_ALL : G_PASTE_UPDATE_TARGET_ITEM;
+
+        g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, target, index, G_PASTE_HISTORY_SAVE_REPLACE, held, item_uuid, FALSE);
+    }
+
+    /* Pinning may have left the array short of items that may go cold. */
+    g_paste_history_private_refill (self);
 
     return TRUE;
 }
@@ -1002,14 +2195,23 @@ g_paste_history_set_password (GPasteHistory *self,
     G_PASTE_LOCK_HISTORY;
     guint index;
     GPasteItem *item = g_paste_history_private_get_indexed_by_uuid (self, uuid, &index);
+    gboolean cold = FALSE;
+
+    if (!item && (item = g_paste_history_private_get_cold_by_uuid (self, uuid)))
+        cold = TRUE;
 
     g_return_if_fail (item);
     g_return_if_fail (G_PASTE_IS_TEXT_ITEM (item));
     g_return_if_fail (!_g_paste_history_private_get_password (self, name, NULL));
 
+    /* A password is always in memory: a cold item turning into one comes back. */
+    if (cold)
+        index = g_paste_history_private_promote (self, item);
+
     GPasteItem *password = g_paste_password_item_new (name, g_paste_item_get_real_value (item));
 
     _g_paste_history_replace (self, index, password);
+    g_paste_history_private_refill (self);
 }
 
 /**
@@ -1102,6 +2304,9 @@ g_paste_history_empty (GPasteHistory *self)
         g_paste_history_private_remove (self, self->history->len - 1, TRUE);
 
     self->size = 0;
+    self->cold_length = 0;
+    ++self->cold_serial;
+    g_paste_history_private_forget_faulted (self);
 
     g_paste_history_private_elect_new_biggest (self);
     g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REMOVE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_CLEAR, NULL, NULL, FALSE);
@@ -1124,6 +2329,11 @@ g_paste_history_save (GPasteHistory *self,
 
     g_autolist (GPasteItem) snapshot = g_paste_history_snapshot (self);
 
+    /* The cold tier is part of the history all the same: read back for the
+     * occasion, after everything the array holds. */
+    if (self->cold_length)
+        snapshot = g_list_concat (snapshot, g_paste_history_private_read_cold (self, 0, 0));
+
     g_paste_storage_backend_write_history (self->backend, (name) ? name : self->name, snapshot);
 }
 
@@ -1164,6 +2374,39 @@ g_paste_history_resume (GPasteHistory *self)
     self->stopped = FALSE;
 }
 
+/**
+ * g_paste_history_export_state:
+ * @self: a #GPasteHistory instance
+ *
+ * The history as it stands in memory, along with the stamp of its store, for
+ * a re-executed daemon to pick up with g_paste_history_load_state_async()
+ * instead of reading it all back. Only meaningful once g_paste_history_flush()
+ * has put every change on disk and stopped recording: the stamp is what
+ * proves the successor the store did not change after that.
+ *
+ * Returns: (transfer full) (nullable): the %G_PASTE_HANDOVER_HISTORY_TYPE state,
+ *          or %NULL when there is nothing trustworthy to hand over
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_history_export_state (GPasteHistory *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), NULL);
+
+    G_PASTE_LOCK_HISTORY;
+
+    /* Still recording, still loading or never read back: what we hold is not
+     * what the store holds. */
+    if (!self->stopped || !self->name || self->unreadable || g_paste_history_saver_is_loading (self->saver))
+        return NULL;
+
+    g_autolist (GPasteItem) snapshot = g_paste_history_snapshot (self);
+    g_autoptr (GVariant) items = g_paste_handover_pack_items (snapshot);
+    g_autofree gchar *stamp = g_paste_storage_backend_dup_stamp (self->backend, self->name);
+
+    return g_variant_ref_sink (g_variant_new ("(sstt@" G_PASTE_HANDOVER_ITEMS_TYPE ")",
+                                              self->name, stamp, self->resident_limit, self->cold_length, items));
+}
+
 /* Read a history in, synchronously, and install it as the model.
  *
  * No cap is applied to what comes back, unlike the load g_paste_history_on_loaded ()
@@ -1179,6 +2422,8 @@ g_paste_history_load_locked (GPasteHistory *self,
     self->size = 0;
 
     g_set_str (&self->name, (name) ? name : g_paste_settings_get_history_name (self->settings));
+    /* Read back all the same: a parked copy of it would only go stale. */
+    g_paste_history_private_forget_parked (self, self->name);
 
     /* A history that is on disk but unreadable (wrong passphrase, corrupt or
      * truncated file, I/O error) must not be persisted over: stop recording so
@@ -1188,9 +2433,18 @@ g_paste_history_load_locked (GPasteHistory *self,
      * otherwise one unreadable history would silently stop persisting every
      * other one loaded afterwards. */
     GList *history = NULL;
+    guint64 cold_length = 0;
+
+    self->resident_limit = g_paste_history_private_resident_limit (self);
+
+    if (self->resident_limit)
+        self->unreadable = !g_paste_storage_backend_read_history_head (self->backend, self->name, self->resident_limit, &history, &self->size, &cold_length);
+    else
+        self->unreadable = !g_paste_storage_backend_read_history (self->backend, self->name, &history, &self->size);
 
-    self->unreadable = !g_paste_storage_backend_read_history (self->backend, self->name, &history, &self->size);
     g_paste_history_private_set_from_list (self, history);
+    self->cold_length = cold_length;
+    g_paste_history_private_compress_idle (self);
 
     if (self->unreadable)
         g_warning ("Could not read the history back; it will not be overwritten");
@@ -1230,6 +2484,7 @@ static void
 g_paste_history_on_loaded (gpointer user_data,
                            GList   *history,
                            gsize    size,
+                           guint64  cold_length,
                            gboolean save_after,
                            gboolean readable)
 {
@@ -1238,6 +2493,8 @@ g_paste_history_on_loaded (gpointer user_data,
 
     g_paste_history_private_set_from_list (self, history);
     self->size = size;
+    self->cold_length = cold_length;
+    g_paste_history_private_compress_idle (self);
 
     if (self->history->len)
         g_paste_history_activate_first (self, TRUE);
@@ -1272,19 +2529,83 @@ g_paste_history_on_loaded (gpointer user_data,
      * flushed window -- see g_paste_history_history_name_changed (). */
     else if (!self->stopped)
     {
-        guint length_before = self->history->len;
+        guint64 length_before = g_paste_history_private_get_length (self);
+
+        g_paste_history_private_check_size (self);
+        g_paste_history_private_check_memory_usage (self);
+
+        if (g_paste_history_private_get_length (self) != length_before)
+            save_after = TRUE;
+    }
+
+    if (save_after)
+        g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_FULL, NULL, NULL, FALSE);
+    else
+        g_paste_history_emit_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, NULL, 0);
+
+    /* That was the first page: the rest follows. */
+    g_paste_history_private_stream (self);
+
+    g_paste_history_private_schedule_prefetch (self);
+}
+
+/* Install the next page of a background load (see g_paste_history_private_stream)
+ * behind what the array already holds. Until the last one is in, whatever has
+ * not come yet is the cold tier, read back on demand like in the tiered mode. */
+static void
+g_paste_history_on_page (gpointer user_data,
+                         GList   *page,
+                         guint64  serial)
+{
+    GPasteHistory *self = user_data;
+    G_PASTE_LOCK_HISTORY;
+
+    g_autolist (GPasteItem) items = page;
+
+    /* Not the page asked for last: one for a history since swapped out. */
+    if (!self->streaming || serial != self->stream_serial)
+        return;
+
+    self->streaming = FALSE;
+
+    /* The head of the cold tier moved meanwhile, so the page is no longer what
+     * comes next: read it again from where the array is now. What only moved
+     * in the array, however many copies were made, leaves the page as it is. */
+    if (self->stream_cold_serial != self->cold_serial)
+    {
+        g_paste_history_private_stream (self);
+        return;
+    }
+
+    /* Nothing where the cold tier should be means the store was changed
+     * behind our back: what did come stays on demand rather than streamed. */
+    if (!items || !self->cold_length || self->stopped)
+        return;
 
-        g_paste_history_private_check_size (self);
-        g_paste_history_private_check_memory_usage (self);
+    /* The caps cut the cold tier from its end, which the page may reach. */
+    GList *cut = g_list_nth (items, MIN (self->cold_length, G_MAXUINT));
 
-        if (self->history->len != length_before)
-            save_after = TRUE;
+    if (cut)
+    {
+        cut->prev->next = NULL;
+        cut->prev = NULL;
+        g_list_free_full (cut, g_object_unref);
     }
 
-    if (save_after)
+    guint64 length_before = g_paste_history_private_get_length (self);
+    gboolean full = g_paste_history_private_append_cold (self, g_steal_pointer (&items), self->resident_limit != 0);
+
+    /* The memory cap applies to each page as it does to a whole load, and its
+     * evictions are saved for the same reason (see g_paste_history_on_loaded). */
+    g_paste_history_private_check_memory_usage (self);
+
+    if (g_paste_history_private_get_length (self) != length_before)
         g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_FULL, NULL, NULL, FALSE);
     else
         g_paste_history_emit_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, NULL, 0);
+
+    if (!full)
+        g_paste_history_private_stream (self);
 }
 
 /**
@@ -1318,8 +2639,10 @@ g_paste_history_reload_backend (GPasteHistory *self)
     g_clear_object (&self->saver);
     g_clear_object (&self->backend);
     self->backend = g_paste_storage_backend_new (g_paste_settings_get_storage_backend (self->settings), self->settings);
-    self->saver = g_paste_history_saver_new (self->backend, self, g_paste_history_on_loaded);
+    self->saver = g_paste_history_saver_new (self->backend, self, g_paste_history_on_loaded, g_paste_history_on_page);
 
+    /* The stores were rewritten: nothing kept from before is to be trusted. */
+    g_paste_history_private_forget_all_parked (self);
     g_paste_history_private_clear (self);
     self->size = 0;
     g_paste_history_private_elect_new_biggest (self);
@@ -1336,7 +2659,32 @@ g_paste_history_reload_backend (GPasteHistory *self)
      * host, where reading (and, for an encrypted flavour, deriving the key with
      * Argon2id) inline would freeze the whole compositor. The store was just
      * written by the migration, so there is nothing to normalize back. */
-    g_paste_history_saver_load (self->saver, self->name, FALSE);
+    self->resident_limit = g_paste_history_private_resident_limit (self);
+    g_paste_history_saver_load (self->saver, self->name, g_paste_history_private_first_page (self), FALSE);
+}
+
+/* Start loading @name in the background, from @state when there is one (see
+ * g_paste_history_saver_load_state). */
+static void
+g_paste_history_load_async_locked (GPasteHistory *self,
+                                   const gchar   *name,
+                                   GVariant      *state)
+{
+    g_set_str (&self->name, name);
+    g_paste_history_private_forget_parked (self, self->name);
+    g_paste_history_private_clear (self);
+    self->size = 0;
+    /* A previously unreadable history must not keep the *next* one from being
+     * persisted: the load's own result decides (see g_paste_history_on_loaded).
+     * Nothing is recorded in the meantime, since a load is now in progress.
+     * @stopped is deliberately left alone — a handover is not ours to undo. */
+    self->unreadable = FALSE;
+    self->resident_limit = g_paste_history_private_resident_limit (self);
+
+    if (state)
+        g_paste_history_saver_load_state (self->saver, self->name, g_paste_history_private_first_page (self), state);
+    else
+        g_paste_history_saver_load (self->saver, self->name, g_paste_history_private_first_page (self), FALSE);
 }
 
 /**
@@ -1345,7 +2693,9 @@ g_paste_history_reload_backend (GPasteHistory *self)
  * @name: (nullable): the name of the history to load, defaults to the configured one
  *
  * Load the #GPasteHistory from the history file asynchronously.
- * The UPDATE signal is emitted on the main thread when loading is complete.
+ * The UPDATE signal is emitted on the main thread once the first items are in,
+ * and again as the rest streams in behind them when the storage backend can
+ * serve a history a part at a time.
  */
 G_PASTE_VISIBLE void
 g_paste_history_load_async (GPasteHistory *self,
@@ -1361,16 +2711,38 @@ g_paste_history_load_async (GPasteHistory *self,
     if (self->name && g_paste_str_equal (resolved, self->name) && !g_paste_history_saver_is_loading (self->saver))
         return;
 
-    g_set_str (&self->name, resolved);
-    g_paste_history_private_clear (self);
-    self->size = 0;
-    /* A previously unreadable history must not keep the *next* one from being
-     * persisted: the load's own result decides (see g_paste_history_on_loaded).
-     * Nothing is recorded in the meantime, since a load is now in progress.
-     * @stopped is deliberately left alone — a handover is not ours to undo. */
-    self->unreadable = FALSE;
+    g_paste_history_load_async_locked (self, resolved, NULL);
+}
+
+/**
+ * g_paste_history_load_state_async:
+ * @self: a #GPasteHistory instance
+ * @state: what g_paste_history_export_state() returned in a previous daemon
+ *
+ * Load the configured history as g_paste_history_load_async() does, but from
+ * @state rather than from the store: it is only read back when @state is not
+ * the configured history as its store still holds it.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_load_state_async (GPasteHistory *self,
+                                  GVariant      *state)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY (self));
+    g_return_if_fail (g_variant_is_of_type (state, G_VARIANT_TYPE (G_PASTE_HANDOVER_HISTORY_TYPE)));
+
+    G_PASTE_LOCK_HISTORY;
 
-    g_paste_history_saver_load (self->saver, self->name, FALSE);
+    const gchar *name = g_paste_settings_get_history_name (self->settings);
+    const gchar *state_name;
+    guint64 resident_limit;
+
+    g_variant_get (state, "(&s&stt@" G_PASTE_HANDOVER_ITEMS_TYPE ")", &state_name, NULL, &resident_limit, NULL, NULL);
+
+    /* Switched away, or split the other way, since: of no use. */
+    if (!g_paste_str_equal (state_name, name) || resident_limit != g_paste_history_private_resident_limit (self))
+        state = NULL;
+
+    g_paste_history_load_async_locked (self, name, state);
 }
 
 /**
@@ -1449,6 +2821,13 @@ g_paste_history_delete (GPasteHistory *self,
          * again. */
         self->unreadable = FALSE;
     }
+    else
+    {
+        G_PASTE_LOCK_HISTORY;
+
+        g_paste_history_private_forget_parked (self, history_name);
+        g_paste_history_private_forget_transitions (self, history_name);
+    }
 
     g_autoptr (GError) local_error = NULL;
 
@@ -1463,15 +2842,106 @@ g_paste_history_delete (GPasteHistory *self,
     return TRUE;
 }
 
+/**
+ * g_paste_history_forget_recent:
+ * @self: a #GPasteHistory instance
+ * @name: the history to forget
+ *
+ * Stop keeping @name in memory, if it is among the histories recently switched
+ * away from (see the "recent-histories" setting), so the next switch to it
+ * reads it back. For a caller about to change its store through something else
+ * than @self.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_forget_recent (GPasteHistory *self,
+                               const gchar   *name)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY (self));
+    g_return_if_fail (name);
+
+    G_PASTE_LOCK_HISTORY;
+
+    g_paste_history_private_forget_parked (self, name);
+}
+
+/**
+ * g_paste_history_backup:
+ * @self: a #GPasteHistory instance
+ * @name: (nullable): the history to back up (defaults to the current one)
+ * @backup: the name to back it up as
+ * @callback: called once the backup is on disk
+ * @user_data: data for @callback
+ *
+ * Copy a stored history under another name, in the background and without
+ * loading it: the storage backend duplicates its store where it can. Queued
+ * behind the pending writes, so backing up the current history captures every
+ * change made before the call. Fails with %G_IO_ERROR_BUSY, having written
+ * nothing, when the store has been handed over (see g_paste_history_flush()).
+ */
+G_PASTE_VISIBLE void
+g_paste_history_backup (GPasteHistory      *self,
+                        const gchar        *name,
+                        const gchar        *backup,
+                        GAsyncReadyCallback callback,
+                        gpointer            user_data)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY (self));
+    g_return_if_fail (backup);
+
+    const gchar *history_name = (name) ? name : self->name;
+
+    /* Same reasoning as g_paste_history_delete(): the store belongs to someone
+     * else right now, and writing a new history into it would race them. */
+    if (self->stopped)
+    {
+        g_task_report_new_error (self, callback, user_data, g_paste_history_backup,
+                                 G_IO_ERROR, G_IO_ERROR_BUSY,
+                                 "The history storage is being handed over, cannot back “%s” up right now",
+                                 history_name);
+        return;
+    }
+
+    g_paste_history_saver_copy (self->saver, history_name, backup, callback, user_data);
+}
+
+/**
+ * g_paste_history_backup_finish:
+ * @self: a #GPasteHistory instance
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: whether the backup was written
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_history_backup_finish (GPasteHistory *self,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), FALSE);
+    g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+    if (g_async_result_is_tagged (result, g_paste_history_backup))
+        return g_task_propagate_boolean (G_TASK (result), error);
+
+    return g_paste_history_saver_copy_finish (self->saver, result, error);
+}
+
 static void
 g_paste_history_history_name_changed (GPasteHistory *self)
 {
+    g_autofree gchar *from = g_strdup (self->name);
+
+    g_paste_history_private_park (self);
+
     g_set_str (&self->name, g_paste_settings_get_history_name (self->settings));
 
     g_debug ("history: name changed to '%s'", self->name);
 
-    g_paste_history_private_clear (self);
-    self->size = 0;
+    g_paste_history_private_note_switch (self, from);
+    /* Read anyway now, the way a switch reads it */
+    if (g_paste_str_equal (self->prefetching, self->name))
+        g_paste_history_private_cancel_prefetch (self);
+
     /* Switching away from an unreadable history resumes recording: the new one
      * stands on its own (see g_paste_history_load_async). A flushed history
      * stays flushed, though — the in-shell daemon keeps answering the bus right
@@ -1479,8 +2949,52 @@ g_paste_history_history_name_changed (GPasteHistory *self)
      * not put the pre-migration backend back to work. */
     self->unreadable = FALSE;
 
+    gboolean unparked = g_paste_history_private_unpark (self, self->name);
+
+    /* Now that the one switched to is out of them, if it was there */
+    g_paste_history_private_shed_parked (self, self->size);
+
+    if (unparked)
+    {
+        /* Back to a history we kept: no reading, and nothing for a load still
+         * in flight (for another one) to install over it. Only the caps may
+         * have moved in the meantime, which a load would have applied too. */
+        g_paste_history_saver_abandon_load (self->saver);
+
+        if (self->history->len)
+            g_paste_history_activate_first (self, TRUE);
+
+        guint64 length_before = g_paste_history_private_get_length (self);
+
+        if (!self->stopped)
+        {
+            g_paste_history_private_check_size (self);
+            g_paste_history_private_check_memory_usage (self);
+        }
+
+        g_paste_history_emit_switch (self, self->name);
+
+        if (g_paste_history_private_get_length (self) != length_before)
+            g_paste_history_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, 0, G_PASTE_HISTORY_SAVE_FULL, NULL, NULL, FALSE);
+        else
+            g_paste_history_emit_update (self, G_PASTE_UPDATE_ACTION_REPLACE, G_PASTE_UPDATE_TARGET_ALL, NULL, 0);
+
+        /* It may have been left in the middle of streaming in. */
+        g_paste_history_private_stream (self);
+
+        g_debug ("history: switch served from memory (%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT " prefetched)",
+                 self->switch_hits, self->switches, self->prefetch_hits);
+        g_paste_history_private_schedule_prefetch (self);
+        return;
+    }
+
+    g_debug ("history: switch read from the store (%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " served from memory)",
+             self->switch_hits, self->switches);
+
+    self->resident_limit = g_paste_history_private_resident_limit (self);
+
     g_paste_history_emit_switch (self, self->name);
-    g_paste_history_saver_load (self->saver, self->name, TRUE);
+    g_paste_history_saver_load (self->saver, self->name, g_paste_history_private_first_page (self), TRUE);
 }
 
 /* One detailed "notify::<key>" handler per setting the history reacts to, rather
@@ -1500,6 +3014,47 @@ g_paste_history_on_cap_changed (GPasteSettings *settings G_GNUC_UNUSED,
     g_paste_history_private_trim (self);
 }
 
+/* The history in memory was split by the previous bound, so a new one takes a
+ * fresh read. Not a switch: it is the same history, and the load's own update
+ * is all a client needs to redraw it. */
+static void
+g_paste_history_on_resident_size_changed (GPasteSettings *settings G_GNUC_UNUSED,
+                                          GParamSpec     *pspec G_GNUC_UNUSED,
+                                          gpointer        user_data)
+{
+    GPasteHistory *self = user_data;
+    G_PASTE_LOCK_HISTORY;
+
+    guint64 resident_limit = g_paste_history_private_resident_limit (self);
+
+    if (!self->name || resident_limit == self->resident_limit)
+        return;
+
+    /* The read must see every change made under the previous bound, under
+     * which the parked histories were split too. */
+    g_paste_history_saver_drain (self->saver);
+    g_paste_history_private_forget_all_parked (self);
+
+    g_paste_history_private_clear (self);
+    self->size = 0;
+    g_paste_history_private_elect_new_biggest (self);
+    self->unreadable = FALSE;
+    self->resident_limit = resident_limit;
+
+    g_paste_history_saver_load (self->saver, self->name, g_paste_history_private_first_page (self), FALSE);
+}
+
+static void
+g_paste_history_on_recent_histories_changed (GPasteSettings *settings G_GNUC_UNUSED,
+                                             GParamSpec     *pspec G_GNUC_UNUSED,
+                                             gpointer        user_data)
+{
+    GPasteHistory *self = user_data;
+    G_PASTE_LOCK_HISTORY;
+
+    g_paste_history_private_shed_parked (self, self->size);
+}
+
 static void
 g_paste_history_on_history_name_changed (GPasteSettings *settings G_GNUC_UNUSED,
                                          GParamSpec     *pspec G_GNUC_UNUSED,
@@ -1521,6 +3076,13 @@ g_paste_history_dispose (GObject *object)
     g_clear_object (&self->pending_selection);
     g_clear_pointer (&self->history, g_ptr_array_unref);
     g_clear_pointer (&self->by_uuid, g_hash_table_unref);
+    g_queue_clear (&self->faulted_order);
+    g_clear_pointer (&self->faulted, g_hash_table_unref);
+    g_clear_pointer (&self->dropped, g_ptr_array_unref);
+    g_paste_history_private_forget_all_parked (self);
+    g_clear_handle_id (&self->prefetch_source, g_source_remove);
+    g_clear_pointer (&self->transitions, g_ptr_array_unref);
+    g_clear_pointer (&self->pending_switches, g_ptr_array_unref);
     g_clear_object (&self->settings_signals);
     g_clear_object (&self->settings);
 
@@ -1618,7 +3180,13 @@ g_paste_history_init (GPasteHistory *self)
     /* The array owns a ref per item; the index borrows both its keys and its
      * values from it, so it gets no free funcs of its own. */
     self->history = g_ptr_array_new_with_free_func (g_object_unref);
-    self->by_uuid = g_hash_table_new (g_str_hash, g_str_equal);
+    self->by_uuid = g_hash_table_new (g_paste_uuid_hash, g_paste_uuid_equal);
+    /* The faulted items are the table's own, keyed by their binary uuid. */
+    self->faulted = g_hash_table_new_full (g_paste_uuid_hash, g_paste_uuid_equal, NULL, g_object_unref);
+    g_queue_init (&self->faulted_order);
+    self->dropped = g_ptr_array_new_with_free_func (g_free);
+    g_queue_init (&self->parked);
+    self->pending_switches = g_ptr_array_new_with_free_func (g_paste_history_transition_free);
 
     G_PASTE_LOCK_HISTORY;
 
@@ -1632,7 +3200,9 @@ g_paste_history_init (GPasteHistory *self)
  * Get the inner history of a #GPasteHistory
  *
  * Returns: (element-type GPasteItem) (transfer none): The inner history,
- *          newest first
+ *          newest first: only the part kept in memory when the
+ *          "resident-history-size" setting leaves the rest to the store, or
+ *          while the rest of a load is still streaming in
  */
 G_PASTE_VISIBLE const GPtrArray *
 g_paste_history_get_history (GPasteHistory *self)
@@ -1648,7 +3218,7 @@ g_paste_history_get_history (GPasteHistory *self)
  *
  * Get the length of a #GPasteHistory
  *
- * Returns: The length of the inner history
+ * Returns: The length of the history, items left to the store included
  */
 G_PASTE_VISIBLE guint64
 g_paste_history_get_length (GPasteHistory *self)
@@ -1657,7 +3227,7 @@ g_paste_history_get_length (GPasteHistory *self)
 
     G_PASTE_LOCK_HISTORY;
 
-    return self->history->len;
+    return g_paste_history_private_get_length (self);
 }
 
 /**
@@ -1676,6 +3246,171 @@ g_paste_history_get_current (GPasteHistory *self)
     return self->name;
 }
 
+/**
+ * g_paste_history_get_switch_stats:
+ * @self: a #GPasteHistory instance
+ * @switches: (out) (optional): where to store how many switches there were
+ * @hits: (out) (optional): where to store how many of them needed no read
+ * @prefetches: (out) (optional): where to store how many histories were read
+ *              ahead of a switch to them
+ * @prefetch_hits: (out) (optional): where to store how many switches one of
+ *                 those served
+ *
+ * Get how the switches between histories went since @self was created: the
+ * hit rate is @hits out of @switches, the part prefetching has in it
+ * @prefetch_hits out of @switches, and what it read for nothing @prefetches
+ * less @prefetch_hits.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_get_switch_stats (GPasteHistory *self,
+                                  guint64       *switches,
+                                  guint64       *hits,
+                                  guint64       *prefetches,
+                                  guint64       *prefetch_hits)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY (self));
+
+    G_PASTE_LOCK_HISTORY;
+
+    if (switches)
+        *switches = self->switches;
+    if (hits)
+        *hits = self->switch_hits;
+    if (prefetches)
+        *prefetches = self->prefetches;
+    if (prefetch_hits)
+        *prefetch_hits = self->prefetch_hits;
+}
+
+/**
+ * g_paste_history_shed_caches:
+ * @self: a #GPasteHistory instance
+ * @level: how short memory is
+ *
+ * Let go of what the history only keeps in memory to answer faster, for when
+ * the system runs short of it: the decompressed copies of compressed values,
+ * the cold items read back lately and the page cache of the store first; from
+ * %G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM on, the histories kept from earlier
+ * switches and read ahead of the next one too, which cost a read each to get
+ * back. Nothing the history holds is lost.
+ *
+ * Returns: how many bytes that freed
+ */
+G_PASTE_VISIBLE guint64
+g_paste_history_shed_caches (GPasteHistory             *self,
+                             GMemoryMonitorWarningLevel level)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), 0);
+
+    G_PASTE_LOCK_HISTORY;
+
+    guint64 freed = g_paste_item_shed_values ();
+
+    for (GList *f = self->faulted_order.head; f; f = g_list_next (f))
+        freed += g_paste_item_get_size (f->data);
+    g_paste_history_private_forget_faulted (self);
+
+    freed += g_paste_storage_backend_release_memory (self->backend);
+
+    if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+    {
+        freed += self->parked_size;
+        g_paste_history_private_forget_all_parked (self);
+    }
+
+    return freed;
+}
+
+static void
+g_paste_history_on_maintained (GObject      *source_object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+    GPasteHistory *self = G_PASTE_HISTORY (source_object);
+    g_autoptr (GTask) task = user_data;
+    g_autofree GPasteStorageMaintenance *report = g_new0 (GPasteStorageMaintenance, 1);
+    GError *error = NULL;
+
+    /* Any saver of ours can finish the run: the saver may have been swapped out
+     * since, but the task is ours either way. */
+    if (!g_paste_history_saver_maintain_finish (self->saver, result, report, &error))
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    self->maintenance_offset = (report->complete) ? 0 : self->maintenance_offset + report->histories;
+
+    g_task_return_pointer (task, g_steal_pointer (&report), g_free);
+}
+
+/**
+ * g_paste_history_maintain:
+ * @self: a #GPasteHistory instance
+ * @budget: how long the run may take, in microseconds
+ * @callback: called once done
+ * @user_data: data for @callback
+ *
+ * Tidy the stores of every history up in the background, for when nothing
+ * else needs them: give back the space they no longer use, refresh their query
+ * statistics and remove what failed writes left behind (see
+ * g_paste_storage_backend_maintain()). A run @budget cuts short is picked up
+ * where it stopped by the next one.
+ */
+G_PASTE_VISIBLE void
+g_paste_history_maintain (GPasteHistory      *self,
+                          GTimeSpan           budget,
+                          GAsyncReadyCallback callback,
+                          gpointer            user_data)
+{
+    g_return_if_fail (G_PASTE_IS_HISTORY (self));
+
+    g_autoptr (GTask) task = g_task_new (self, NULL, callback, user_data);
+
+    g_task_set_static_name (task, "gpaste-history-maintain");
+    g_task_set_source_tag (task, g_paste_history_maintain);
+
+    /* Same as g_paste_history_backup(): the store belongs to someone else
+     * right now. */
+    if (self->stopped)
+    {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_BUSY,
+                                 "The history storage is being handed over, cannot maintain it right now");
+        return;
+    }
+
+    g_paste_history_saver_maintain (self->saver, self->maintenance_offset, budget, g_paste_history_on_maintained, g_steal_pointer (&task));
+}
+
+/**
+ * g_paste_history_maintain_finish:
+ * @self: a #GPasteHistory instance
+ * @result: the #GAsyncResult passed to the callback
+ * @report: (out caller-allocates): where to store what the run did
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: whether the run took place
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_history_maintain_finish (GPasteHistory            *self,
+                                 GAsyncResult             *result,
+                                 GPasteStorageMaintenance *report,
+                                 GError                  **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), FALSE);
+    g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+    g_return_val_if_fail (report, FALSE);
+
+    g_autofree GPasteStorageMaintenance *done = g_task_propagate_pointer (G_TASK (result), error);
+
+    if (!done)
+        return FALSE;
+
+    *report = *done;
+
+    return TRUE;
+}
+
 /**
  * g_paste_history_search:
  * @self: a #GPasteHistory instance
@@ -1710,6 +3445,31 @@ g_paste_history_search (GPasteHistory *self,
     if (!regex)
         return NULL;
 
+    /* A literal pattern is a caseless substring match, which a store indexing
+     * its items answers without going through them -- once the pending writes
+     * are in, it holds what this does. Only password items, which the plain
+     * stores do not keep, are still matched here. */
+    g_auto (GStrv) stored_uuids = NULL;
+    g_autoptr (GHashTable) stored = NULL;
+
+    if (self->name && !self->stopped && !self->unreadable && !g_paste_history_saver_is_loading (self->saver))
+    {
+        g_autofree gchar *escaped = g_regex_escape_string (pattern, -1);
+
+        if (g_paste_str_equal (escaped, pattern))
+        {
+            g_paste_history_saver_drain (self->saver);
+            stored_uuids = g_paste_storage_backend_search (self->backend, self->name, pattern);
+        }
+    }
+
+    if (stored_uuids)
+    {
+        stored = g_hash_table_new (g_str_hash, g_str_equal);
+        for (GStrv uuid = stored_uuids; *uuid; ++uuid)
+            g_hash_table_add (stored, *uuid);
+    }
+
     g_autoptr (GStrvBuilder) results = g_strv_builder_new ();
     for (guint i = 0; i < self->history->len; ++i)
     {
@@ -1721,6 +3481,8 @@ g_paste_history_search (GPasteHistory *self,
             match = TRUE;
         else if (G_PASTE_IS_PASSWORD_ITEM (item) && g_paste_str_equal (pattern, g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM (item))))
             match = TRUE;
+        else if (stored && !G_PASTE_IS_PASSWORD_ITEM (item))
+            match = g_hash_table_contains (stored, uuid);
         else if (g_regex_match (regex, g_paste_item_get_value (item), G_REGEX_MATCH_NOTEMPTY|G_REGEX_MATCH_NEWLINE_ANY, NULL))
             match = TRUE;
 
@@ -1728,6 +3490,19 @@ g_paste_history_search (GPasteHistory *self,
             g_strv_builder_add (results, uuid);
     }
 
+    /* Then the cold tier: whatever the store found that the array does not
+     * hold, or else a scan of it. */
+    if (self->cold_length && stored_uuids)
+    {
+        for (GStrv uuid = stored_uuids; *uuid; ++uuid)
+        {
+            if (!g_paste_history_private_get_by_uuid (self, *uuid))
+                g_strv_builder_add (results, *uuid);
+        }
+    }
+    else if (self->cold_length)
+        g_paste_history_private_search_cold (self, regex, pattern, results);
+
     return g_strv_builder_end (results);
 }
 
@@ -1748,7 +3523,7 @@ g_paste_history_new (GPasteSettings *settings)
     GPasteHistory *self = g_object_new (G_PASTE_TYPE_HISTORY, NULL);
 
     self->backend = g_paste_storage_backend_new (g_paste_settings_get_storage_backend (settings), settings);
-    self->saver = g_paste_history_saver_new (self->backend, self, g_paste_history_on_loaded);
+    self->saver = g_paste_history_saver_new (self->backend, self, g_paste_history_on_loaded, g_paste_history_on_page);
     self->settings = g_object_ref (settings);
 
     /* The text item size settings are deliberately absent: they filter what
@@ -1762,6 +3537,10 @@ g_paste_history_new (GPasteSettings *settings)
                             G_CALLBACK (g_paste_history_on_cap_changed), self);
     g_signal_group_connect (settings_signals, "notify::" G_PASTE_HISTORY_NAME_SETTING,
                             G_CALLBACK (g_paste_history_on_history_name_changed), self);
+    g_signal_group_connect (settings_signals, "notify::" G_PASTE_RESIDENT_HISTORY_SIZE_SETTING,
+                            G_CALLBACK (g_paste_history_on_resident_size_changed), self);
+    g_signal_group_connect (settings_signals, "notify::" G_PASTE_RECENT_HISTORIES_SETTING,
+                            G_CALLBACK (g_paste_history_on_recent_histories_changed), self);
     g_signal_group_set_target (settings_signals, settings);
 
     return self;
@@ -1788,3 +3567,66 @@ g_paste_history_list (GPasteHistory *self,
 
     return g_paste_storage_backend_list_histories (self->backend, error);
 }
+
+/**
+ * g_paste_history_count:
+ * @self: a #GPasteHistory instance
+ * @name: the name of the history to count
+ * @length: (out): where to store its length
+ *
+ * Get the length the history called @name would have once loaded, without
+ * loading it, when the storage backend can tell.
+ *
+ * Returns: whether @length could be told that way
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_history_count (GPasteHistory *self,
+                       const gchar   *name,
+                       guint64       *length)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (length, FALSE);
+
+    return g_paste_storage_backend_count_history (self->backend, name, length);
+}
+
+/**
+ * g_paste_history_search_all:
+ * @self: a #GPasteHistory instance
+ * @pattern: the pattern to match
+ * @offset: how many of the best matches to skip
+ * @limit: how many matches to return at most, 0 for all of them
+ *
+ * Get the elements matching @pattern in every history, ranked, when the
+ * storage backend can search them itself: only for a literal @pattern, found
+ * anywhere in an item's value, caselessly.
+ *
+ * Returns: (transfer full) (nullable) (element-type GPasteStorageHit): the
+ *          matches, best first, or %NULL when they have to be looked for
+ *          history by history
+ */
+G_PASTE_VISIBLE GPtrArray *
+g_paste_history_search_all (GPasteHistory *self,
+                            const gchar   *pattern,
+                            guint64        offset,
+                            guint64        limit)
+{
+    g_return_val_if_fail (G_PASTE_IS_HISTORY (self), NULL);
+    g_return_val_if_fail (pattern && g_utf8_validate (pattern, -1, NULL), NULL);
+
+    g_autofree gchar *escaped = g_regex_escape_string (pattern, -1);
+
+    if (!g_paste_str_equal (escaped, pattern))
+        return NULL;
+
+    G_PASTE_LOCK_HISTORY;
+
+    /* The current history is only what the store holds once it is written. */
+    if (self->stopped || self->unreadable || g_paste_history_saver_is_loading (self->saver))
+        return NULL;
+
+    g_paste_history_saver_drain (self->saver);
+
+    return g_paste_storage_backend_search_all (self->backend, pattern, offset, limit);
+}
@@ -6,6 +6,7 @@
 #include <gpaste-3/gpaste-settings.h>
 
 #include <gpaste-daemon/gpaste-password-item.h>
+#include <gpaste-daemon/gpaste-storage-backend.h>
 
 G_BEGIN_DECLS
 
@@ -47,27 +48,62 @@ void         g_paste_history_empty       (GPasteHistory *self);
 void         g_paste_history_flush       (GPasteHistory *self);
 void         g_paste_history_resume      (GPasteHistory *self);
 void         g_paste_history_reload_backend (GPasteHistory *self);
+GVariant    *g_paste_history_export_state (GPasteHistory *self);
 void     g_paste_history_save       (GPasteHistory *self,
                                      const gchar   *name);
 void     g_paste_history_load       (GPasteHistory *self,
                                      const gchar   *name);
 void     g_paste_history_load_async (GPasteHistory *self,
                                      const gchar   *name);
+void     g_paste_history_load_state_async (GPasteHistory *self,
+                                           GVariant      *state);
 void     g_paste_history_switch     (GPasteHistory *self,
                                      const gchar   *name);
 gboolean g_paste_history_delete     (GPasteHistory *self,
                                      const gchar   *name,
                                      GError       **error);
+void     g_paste_history_forget_recent (GPasteHistory *self,
+                                        const gchar   *name);
+void     g_paste_history_backup     (GPasteHistory      *self,
+                                     const gchar        *name,
+                                     const gchar        *backup,
+                                     GAsyncReadyCallback callback,
+                                     gpointer            user_data);
+gboolean g_paste_history_backup_finish (GPasteHistory *self,
+                                        GAsyncResult  *result,
+                                        GError       **error);
 const GPtrArray *g_paste_history_get_history (GPasteHistory *self);
 guint64      g_paste_history_get_length  (GPasteHistory *self);
 const gchar *g_paste_history_get_current (GPasteHistory *self);
+void         g_paste_history_get_switch_stats (GPasteHistory *self,
+                                               guint64       *switches,
+                                               guint64       *hits,
+                                               guint64       *prefetches,
+                                               guint64       *prefetch_hits);
+guint64      g_paste_history_shed_caches (GPasteHistory             *self,
+                                          GMemoryMonitorWarningLevel level);
+void         g_paste_history_maintain    (GPasteHistory      *self,
+                                          GTimeSpan           budget,
+                                          GAsyncReadyCallback callback,
+                                          gpointer            user_data);
+gboolean     g_paste_history_maintain_finish (GPasteHistory            *self,
+                                              GAsyncResult             *result,
+                                              GPasteStorageMaintenance *report,
+                                              GError                  **error);
 
 GStrv g_paste_history_search (GPasteHistory *self,
                               const gchar   *pattern);
+GPtrArray *g_paste_history_search_all (GPasteHistory *self,
+                                       const gchar   *pattern,
+                                       guint64        offset,
+                                       guint64        limit);
 
 GPasteHistory *g_paste_history_new (GPasteSettings *settings);
 
 GStrv g_paste_history_list (GPasteHistory *self,
                              GError       **error);
+gboolean g_paste_history_count (GPasteHistory *self,
+                                const gchar   *name,
+                                guint64       *length);
 
 G_END_DECLS
@@ -29,13 +29,185 @@ struct _GPasteImageItem
 
 G_PASTE_DEFINE_TYPE (ImageItem, image_item, G_PASTE_TYPE_ITEM)
 
+/* An image's checksum is a fingerprint: "<content>-<perceptual>", 32 hex
+ * digits of a 128-bit SipHash-2-4 over its pixels then 16 of a difference hash
+ * (dHash) of its 9×8 luminance thumbnail. The first half is what tells two
+ * images apart; the second survives re-encoding, rescaling and small edits,
+ * and is what g_paste_image_item_is_near_duplicate() compares. Both come out
+ * of one pass over the rows of the buffer GDK hands out, which is the texture's
+ * own when it already is in the format we hash (a decoded PNG is), so no
+ * image-sized copy is made just to checksum it.
+ *
+ * Older GPaste used the hex SHA256 of the whole downloaded buffer. Such a
+ * checksum is recognised by its shape and replaced by a fingerprint when the
+ * item is built (see _g_paste_image_item_new()), which the storage backends
+ * then persist in its place. */
+#define FINGERPRINT_CONTENT_LENGTH    32
+#define FINGERPRINT_PERCEPTUAL_LENGTH 16
+#define FINGERPRINT_LENGTH            (FINGERPRINT_CONTENT_LENGTH + 1 + FINGERPRINT_PERCEPTUAL_LENGTH)
+
+/* The dHash thumbnail: one more column than bits per row, each bit comparing
+ * two neighbours. */
+#define DHASH_COLUMNS 9
+#define DHASH_ROWS    8
+/* The thumbnail only needs that many samples per cell along each axis; a
+ * bigger image is sampled rather than averaged in full. */
+#define DHASH_SAMPLES 32
+
+/* How many of the 64 dHash bits two images may differ by and still be the
+ * same picture, give or take a re-encode or a resize. */
+#define NEAR_DUPLICATE_DISTANCE 8
+
+/* Not a secret -- SipHash is keyed, and this only sets the fingerprint apart
+ * from any other use of it. Changing it changes every fingerprint. */
+static const guint64 fingerprint_key[2] = {
+    G_GUINT64_CONSTANT (0x6d49657473615047), /* "GPasteIm" */
+    G_GUINT64_CONSTANT (0x3168736148656761)  /* "ageHash1" */
+};
+
+typedef struct
+{
+    guint64 v[4];
+    guint64 tail;     /* the bytes of a word not complete yet, little-endian */
+    guint   tail_length;
+    guint64 length;
+} SipHash;
+
+#define SIP_ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static inline void
+sip_round (guint64 *v)
+{
+    v[0] += v[1];
+    v[1] = SIP_ROTL (v[1], 13);
+    v[1] ^= v[0];
+    v[0] = SIP_ROTL (v[0], 32);
+    v[2] += v[3];
+    v[3] = SIP_ROTL (v[3], 16);
+    v[3] ^= v[2];
+    v[0] += v[3];
+    v[3] = SIP_ROTL (v[3], 21);
+    v[3] ^= v[0];
+    v[2] += v[1];
+    v[1] = SIP_ROTL (v[1], 17);
+    v[1] ^= v[2];
+    v[2] = SIP_ROTL (v[2], 32);
+}
+
+static inline void
+sip_compress (SipHash *self,
+              guint64  m)
+{
+    self->v[3] ^= m;
+    sip_round (self->v);
+    sip_round (self->v);
+    self->v[0] ^= m;
+}
+
+static void
+sip_init (SipHash *self)
+{
+    self->v[0] = G_GUINT64_CONSTANT (0x736f6d6570736575) ^ fingerprint_key[0];
+    /* 0xee: the 128-bit output variant */
+    self->v[1] = G_GUINT64_CONSTANT (0x646f72616e646f6d) ^ fingerprint_key[1] ^ 0xee;
+    self->v[2] = G_GUINT64_CONSTANT (0x6c7967656e657261) ^ fingerprint_key[0];
+    self->v[3] = G_GUINT64_CONSTANT (0x7465646279746573) ^ fingerprint_key[1];
+    self->tail = 0;
+    self->tail_length = 0;
+    self->length = 0;
+}
+
+/* Feed @length bytes, in as many calls as it takes: a row whose length is not
+ * a multiple of 8 leaves the rest of its last word for the next one. */
+static void
+sip_update (SipHash      *self,
+            const guchar *data,
+            gsize         length)
+{
+    self->length += length;
+
+    for (; self->tail_length && length; --length)
+    {
+        self->tail |= (guint64) *data++ << (8 * self->tail_length);
+        if (++self->tail_length == 8)
+        {
+            sip_compress (self, self->tail);
+            self->tail = 0;
+            self->tail_length = 0;
+        }
+    }
+
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        guint64 m;
+
+        memcpy (&m, data, 8);
+        sip_compress (self, GUINT64_FROM_LE (m));
+    }
+
+    for (; length; --length)
+        self->tail |= (guint64) *data++ << (8 * self->tail_length++);
+}
+
+static void
+sip_finish (SipHash *self,
+            guint64  out[2])
+{
+    sip_compress (self, (self->length << 56) | self->tail);
+
+    self->v[2] ^= 0xee;
+    for (guint i = 0; i < 4; ++i)
+        sip_round (self->v);
+    out[0] = self->v[0] ^ self->v[1] ^ self->v[2] ^ self->v[3];
+
+    self->v[1] ^= 0xdd;
+    for (guint i = 0; i < 4; ++i)
+        sip_round (self->v);
+    out[1] = self->v[0] ^ self->v[1] ^ self->v[2] ^ self->v[3];
+}
+
+static gboolean
+g_paste_image_item_is_hex (const gchar *str,
+                           gsize        length)
+{
+    for (gsize i = 0; i < length; ++i)
+    {
+        if (!g_ascii_isxdigit (str[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * g_paste_image_item_checksum_is_current:
+ * @checksum: (nullable): an image checksum, as stored by any version of GPaste
+ *
+ * Whether @checksum is a fingerprint of the kind g_paste_image_item_compute_checksum()
+ * produces today, rather than one an older GPaste stored (a plain SHA256). An
+ * item built with an outdated one recomputes it, so a storage backend reading
+ * one back knows it has something to write.
+ *
+ * Returns: whether @checksum is in the current format
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_image_item_checksum_is_current (const gchar *checksum)
+{
+    return checksum &&
+           strlen (checksum) == FINGERPRINT_LENGTH &&
+           checksum[FINGERPRINT_CONTENT_LENGTH] == '-' &&
+           g_paste_image_item_is_hex (checksum, FINGERPRINT_CONTENT_LENGTH) &&
+           g_paste_image_item_is_hex (checksum + FINGERPRINT_CONTENT_LENGTH + 1, FINGERPRINT_PERCEPTUAL_LENGTH);
+}
+
 /**
  * g_paste_image_item_get_checksum:
  * @self: a #GPasteImageItem instance
  *
  * Get the checksum of the GdkTexture contained in the #GPasteImageItem
  *
- * Returns: read-only string representatig the SHA256 checksum of the image
+ * Returns: read-only string representing the fingerprint of the image (see
+ *          g_paste_image_item_compute_checksum())
  */
 G_PASTE_VISIBLE const gchar *
 g_paste_image_item_get_checksum (GPasteImageItem *self)
@@ -138,6 +310,39 @@ g_paste_image_item_equals (GPasteItem *item,
     return g_paste_str_equal (self->checksum, _other->checksum);
 }
 
+/**
+ * g_paste_image_item_is_near_duplicate:
+ * @self: a #GPasteImageItem instance
+ * @other: another #GPasteImageItem instance
+ *
+ * Whether @self and @other show the same picture, if not byte for byte: the
+ * same screenshot re-encoded by another application, scaled, or touched up.
+ * Compares the perceptual half of their fingerprints, so an item whose
+ * checksum could not be upgraded from an older GPaste's only ever matches an
+ * identical one.
+ *
+ * Returns: whether the two images are (nearly) the same
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_image_item_is_near_duplicate (GPasteImageItem *self,
+                                      GPasteImageItem *other)
+{
+    g_return_val_if_fail (G_PASTE_IS_IMAGE_ITEM (self), FALSE);
+    g_return_val_if_fail (G_PASTE_IS_IMAGE_ITEM (other), FALSE);
+
+    if (g_paste_str_equal (self->checksum, other->checksum))
+        return TRUE;
+
+    if (!g_paste_image_item_checksum_is_current (self->checksum) ||
+        !g_paste_image_item_checksum_is_current (other->checksum))
+        return FALSE;
+
+    guint64 a = g_ascii_strtoull (self->checksum + FINGERPRINT_CONTENT_LENGTH + 1, NULL, 16);
+    guint64 b = g_ascii_strtoull (other->checksum + FINGERPRINT_CONTENT_LENGTH + 1, NULL, 16);
+
+    return __builtin_popcountll (a ^ b) <= NEAR_DUPLICATE_DISTANCE;
+}
+
 static void
 g_paste_image_item_set_size (GPasteItem *item)
 {
@@ -253,7 +458,17 @@ _g_paste_image_item_new (const gchar *cache_path,
      * wherever its bytes happen to live. An item being loaded off a file has
      * none yet -- activating it below is what computes one -- so the value
      * starts empty and is set as soon as there is one. */
-    GPasteItem *item = g_paste_item_new (G_PASTE_TYPE_IMAGE_ITEM, (checksum) ? checksum : "");
+    GPasteItem *item;
+
+    /* One stored by an older GPaste identifies the image as well as ever, but
+     * no longer matches what a fresh capture of it computes: recompute it from
+     * the pixels we are about to load anyway, and the backend that read it
+     * persists the new one. */
+    if (checksum && !g_paste_image_item_checksum_is_current (checksum))
+        g_clear_pointer (&checksum, g_free);
+
+    item = g_paste_item_new (G_PASTE_TYPE_IMAGE_ITEM, (checksum) ? checksum : "");
+
     GPasteImageItem *self = G_PASTE_IMAGE_ITEM (item);
 
     self->cache_path = g_strdup (cache_path);
@@ -300,7 +515,9 @@ _g_paste_image_item_new (const gchar *cache_path,
  * g_paste_image_item_compute_checksum:
  * @image: the #GdkTexture to checksum
  *
- * Compute the checksum of an image
+ * Compute the fingerprint of an image: a hash of its pixels and dimensions,
+ * followed by a perceptual hash of what it looks like (see
+ * g_paste_image_item_is_near_duplicate()).
  *
  * Returns: the newly allocated checksum
  */
@@ -310,18 +527,387 @@ g_paste_image_item_compute_checksum (GdkTexture *image)
     if (!image || !GDK_IS_TEXTURE (image))
         return NULL;
 
-    gsize stride = (gsize) gdk_texture_get_width (image) * 4;
-    gsize length = stride * gdk_texture_get_height (image);
-    g_autofree guchar *data = g_malloc (length);
+    gint width = gdk_texture_get_width (image);
+    gint height = gdk_texture_get_height (image);
+    g_autoptr (GdkTextureDownloader) downloader = gdk_texture_downloader_new (image);
+    gsize stride;
+
+    /* Straight RGBA is what the PNG loader produces, so for a decoded image
+     * this hands out the texture's own buffer rather than a converted copy. */
+    gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8);
+
+    g_autoptr (GBytes) pixels = gdk_texture_downloader_download_bytes (downloader, &stride);
+    const guchar *data = g_bytes_get_data (pixels, NULL);
+    gsize row_length = (gsize) width * 4;
+    /* The dimensions go in first: the same bytes laid out as 2×1 or 1×2 are
+     * not the same image. */
+    guint32 dimensions[2] = { GUINT32_TO_LE ((guint32) width), GUINT32_TO_LE ((guint32) height) };
+    gint step_x = MAX (1, width / (DHASH_COLUMNS * DHASH_SAMPLES));
+    gint step_y = MAX (1, height / (DHASH_ROWS * DHASH_SAMPLES));
+    guint64 luma[DHASH_ROWS][DHASH_COLUMNS] = { { 0 } };
+    guint64 samples[DHASH_ROWS][DHASH_COLUMNS] = { { 0 } };
+    SipHash hash;
+
+    sip_init (&hash);
+    sip_update (&hash, (const guchar *) dimensions, sizeof (dimensions));
+
+    for (gint y = 0; y < height; ++y)
+    {
+        const guchar *row = data + (gsize) y * stride;
+
+        /* Row by row: the stride may pad each one, and the padding is not
+         * part of the image. */
+        sip_update (&hash, row, row_length);
+
+        if (y % step_y)
+            continue;
+
+        guint cell_y = (guint) ((gint64) y * DHASH_ROWS / height);
+
+        for (gint x = 0; x < width; x += step_x)
+        {
+            const guchar *pixel = row + (gsize) x * 4;
+            guint cell_x = (guint) ((gint64) x * DHASH_COLUMNS / width);
+
+            /* BT.601 luma, weighted by alpha: what the pixel looks like over
+             * black, so fully transparent ones all look the same. */
+            luma[cell_y][cell_x] += (77u * pixel[0] + 150u * pixel[1] + 29u * pixel[2]) * pixel[3];
+            ++samples[cell_y][cell_x];
+        }
+    }
+
+    guint64 content[2];
+    guint64 perceptual = 0;
+
+    sip_finish (&hash, content);
+
+    for (guint y = 0; y < DHASH_ROWS; ++y)
+    {
+        for (guint x = 0; x + 1 < DHASH_COLUMNS; ++x)
+        {
+            guint64 left = (samples[y][x]) ? luma[y][x] / samples[y][x] : 0;
+            guint64 right = (samples[y][x + 1]) ? luma[y][x + 1] / samples[y][x + 1] : 0;
+
+            perceptual = (perceptual << 1) | (left > right);
+        }
+    }
+
+    return g_strdup_printf ("%016" G_GINT64_MODIFIER "x%016" G_GINT64_MODIFIER "x-%016" G_GINT64_MODIFIER "x",
+                            content[0], content[1], perceptual);
+}
+
+/* Our own PNG writer, for the encoders that are not GDK's: GDK encodes at a
+ * fixed compression, and a full-screen screenshot spends most of its capture
+ * time there. Every scanline is filtered then deflated as it is read, straight
+ * into the one IDAT chunk, so no filtered copy of the image is ever made. What
+ * comes out is a plain 8-bit RGBA PNG, the same kind GDK writes. */
+#define PNG_FILTER_NONE    0
+#define PNG_FILTER_SUB     1
+#define PNG_FILTER_UP      2
+#define PNG_FILTER_AVERAGE 3
+#define PNG_FILTER_PAETH   4
+#define PNG_N_FILTERS      5
+/* Not a PNG filter type: try them all on each row and keep the one most likely
+ * to deflate best. */
+#define PNG_FILTER_ADAPTIVE PNG_N_FILTERS
+
+#define PNG_BYTES_PER_PIXEL 4
+
+typedef struct
+{
+    gint   level;  /* zlib's, 1 (fastest) to 9 (smallest) */
+    guint8 filter; /* applied to every row */
+} PngEncoder;
+
+/* Indexed by GPasteImageEncoder; G_PASTE_IMAGE_ENCODER_DEFAULT is GDK's. */
+static const PngEncoder png_encoders[G_PASTE_N_IMAGE_ENCODER] = {
+    /* Up is the cheapest filter that still pays off on both what screenshots
+     * are made of (rows repeating the one above) and gradients. */
+    [G_PASTE_IMAGE_ENCODER_FAST]  = { 1, PNG_FILTER_UP       },
+    [G_PASTE_IMAGE_ENCODER_SMALL] = { 9, PNG_FILTER_ADAPTIVE },
+};
+
+static const guint32 *
+png_crc_table (void)
+{
+    static guint32 table[256];
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized))
+    {
+        for (guint32 n = 0; n < 256; ++n)
+        {
+            guint32 c = n;
+
+            for (guint k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return table;
+}
+
+static guint32
+png_crc (const guchar *data,
+         gsize         length)
+{
+    const guint32 *table = png_crc_table ();
+    guint32 c = 0xffffffffu;
+
+    for (gsize i = 0; i < length; ++i)
+        c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+
+    return c ^ 0xffffffffu;
+}
+
+static void
+png_append_be32 (GByteArray *png,
+                 guint32     value)
+{
+    guint32 be = GUINT32_TO_BE (value);
+
+    g_byte_array_append (png, (const guint8 *) &be, sizeof (be));
+}
+
+/* Start a chunk: its length is filled in by png_end_chunk(), once its data has
+ * been appended. Returns where the chunk starts. */
+static gsize
+png_begin_chunk (GByteArray  *png,
+                 const gchar *type)
+{
+    gsize start = png->len;
+
+    png_append_be32 (png, 0);
+    g_byte_array_append (png, (const guint8 *) type, 4);
+
+    return start;
+}
+
+static void
+png_end_chunk (GByteArray *png,
+               gsize       start)
+{
+    gsize type_start = start + 4;
+    guint32 length = GUINT32_TO_BE ((guint32) (png->len - type_start - 4));
+
+    memcpy (png->data + start, &length, sizeof (length));
+    png_append_be32 (png, png_crc (png->data + type_start, png->len - type_start));
+}
+
+static inline guint8
+png_paeth (guint8 a,
+           guint8 b,
+           guint8 c)
+{
+    gint p = (gint) a + b - c;
+    gint pa = ABS (p - a);
+    gint pb = ABS (p - b);
+    gint pc = ABS (p - c);
+
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+/* Filter @row (whose predecessor is @prior, all zeroes for the first one) into
+ * @out, which gets the filter type byte first. The first pixel has no left
+ * neighbour, so it is filtered as if it were zero. */
+static void
+png_filter_row (guint8        filter,
+                const guchar *row,
+                const guchar *prior,
+                gsize         length,
+                guchar       *out)
+{
+    const gsize bpp = PNG_BYTES_PER_PIXEL;
+
+    *out++ = filter;
+
+    switch (filter)
+    {
+    case PNG_FILTER_SUB:
+        memcpy (out, row, bpp);
+        for (gsize i = bpp; i < length; ++i)
+            out[i] = row[i] - row[i - bpp];
+        break;
+    case PNG_FILTER_UP:
+        for (gsize i = 0; i < length; ++i)
+            out[i] = row[i] - prior[i];
+        break;
+    case PNG_FILTER_AVERAGE:
+        for (gsize i = 0; i < bpp; ++i)
+            out[i] = row[i] - prior[i] / 2;
+        for (gsize i = bpp; i < length; ++i)
+            out[i] = row[i] - (guint8) (((guint) row[i - bpp] + prior[i]) / 2);
+        break;
+    case PNG_FILTER_PAETH:
+        for (gsize i = 0; i < bpp; ++i)
+            out[i] = row[i] - prior[i];
+        for (gsize i = bpp; i < length; ++i)
+            out[i] = row[i] - png_paeth (row[i - bpp], prior[i], prior[i - bpp]);
+        break;
+    default:
+        memcpy (out, row, length);
+        break;
+    }
+}
+
+/* The usual heuristic: the row whose bytes, read as signed, stay closest to
+ * zero is the one deflate finds the most repetition in. */
+static guint64
+png_filtered_row_cost (const guchar *filtered,
+                       gsize         length)
+{
+    guint64 cost = 0;
+
+    for (gsize i = 1; i <= length; ++i)
+        cost += ABS ((gint8) filtered[i]);
+
+    return cost;
+}
+
+/* Feed @length bytes to @compressor, appending whatever it hands back to @png.
+ * With @last, also flush it to the end of the zlib stream. */
+static gboolean
+png_deflate (GConverter   *compressor,
+             const guchar *data,
+             gsize         length,
+             gboolean      last,
+             GByteArray   *png)
+{
+    GConverterFlags flags = (last) ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS;
+    guchar buffer[16384];
+
+    while (length || last)
+    {
+        g_autoptr (GError) error = NULL;
+        gsize read, written;
+        GConverterResult result = g_converter_convert (compressor,
+                                                       data, length,
+                                                       buffer, sizeof (buffer),
+                                                       flags,
+                                                       &read, &written,
+                                                       &error);
+
+        if (result == G_CONVERTER_ERROR)
+        {
+            g_warning ("Failed to compress image: %s", error->message);
+            return FALSE;
+        }
+
+        g_byte_array_append (png, buffer, written);
+        data += read;
+        length -= read;
+
+        if (result == G_CONVERTER_FINISHED)
+            break;
+    }
+
+    return TRUE;
+}
+
+static GBytes *
+png_encode (GdkTexture       *texture,
+            const PngEncoder *encoder)
+{
+    static const guchar signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    gint width = gdk_texture_get_width (texture);
+    gint height = gdk_texture_get_height (texture);
+    g_autoptr (GdkTextureDownloader) downloader = gdk_texture_downloader_new (texture);
+    gsize stride;
+
+    /* Straight 8-bit RGBA is PNG colour type 6 as is. */
+    gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8);
+
+    g_autoptr (GBytes) pixels = gdk_texture_downloader_download_bytes (downloader, &stride);
+    const guchar *data = g_bytes_get_data (pixels, NULL);
+    gsize row_length = (gsize) width * PNG_BYTES_PER_PIXEL;
+    guint n_candidates = (encoder->filter == PNG_FILTER_ADAPTIVE) ? PNG_N_FILTERS : 1;
+    g_autofree guchar *zero_row = g_malloc0 (row_length);
+    g_autofree guchar *filtered = g_malloc (n_candidates * (row_length + 1));
+    g_autoptr (GZlibCompressor) compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB, encoder->level);
+    /* A guess at a compressed screenshot's size, to spare most reallocations. */
+    g_autoptr (GByteArray) png = g_byte_array_sized_new ((guint) MIN (row_length * (gsize) height / 4, 64 << 20) + 1024);
+
+    g_byte_array_append (png, signature, sizeof (signature));
+
+    gsize chunk = png_begin_chunk (png, "IHDR");
+    png_append_be32 (png, (guint32) width);
+    png_append_be32 (png, (guint32) height);
+    /* 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing */
+    g_byte_array_append (png, (const guint8 *) "\x08\x06\x00\x00\x00", 5);
+    png_end_chunk (png, chunk);
+
+    chunk = png_begin_chunk (png, "IDAT");
+    for (gint y = 0; y < height; ++y)
+    {
+        const guchar *row = data + (gsize) y * stride;
+        const guchar *prior = (y) ? row - stride : zero_row;
+        const guchar *best = filtered;
+
+        if (encoder->filter == PNG_FILTER_ADAPTIVE)
+        {
+            guint64 best_cost = G_MAXUINT64;
+
+            for (guint8 filter = 0; filter < PNG_N_FILTERS; ++filter)
+            {
+                guchar *candidate = filtered + filter * (row_length + 1);
+                guint64 cost;
+
+                png_filter_row (filter, row, prior, row_length, candidate);
+                cost = png_filtered_row_cost (candidate, row_length);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best = candidate;
+                }
+            }
+        }
+        else
+            png_filter_row (encoder->filter, row, prior, row_length, filtered);
+
+        if (!png_deflate (G_CONVERTER (compressor), best, row_length + 1, FALSE, png))
+            return NULL;
+    }
+    if (!png_deflate (G_CONVERTER (compressor), NULL, 0, TRUE, png))
+        return NULL;
+    png_end_chunk (png, chunk);
+
+    png_end_chunk (png, png_begin_chunk (png, "IEND"));
+
+    return g_byte_array_free_to_bytes (g_steal_pointer (&png));
+}
+
+/**
+ * g_paste_image_item_encode:
+ * @texture: (transfer none): the #GdkTexture to encode
+ * @encoder: the #GPasteImageEncoder to encode it with
+ *
+ * Encode an image the way it is stored: as a PNG, which is what any GPaste
+ * reads back and what GetImage hands out, whichever @encoder wrote it. They
+ * only trade encoding time for size.
+ *
+ * Returns: (transfer full): the encoded PNG
+ */
+G_PASTE_VISIBLE GBytes *
+g_paste_image_item_encode (GdkTexture        *texture,
+                           GPasteImageEncoder encoder)
+{
+    g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
+
+    GBytes *png = NULL;
 
-    gdk_texture_download (image, data, stride);
+    if (encoder != G_PASTE_IMAGE_ENCODER_DEFAULT && (guint) encoder < G_PASTE_N_IMAGE_ENCODER)
+        png = png_encode (texture, &png_encoders[encoder]);
 
-    return g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, length);
+    /* GDK's encoder is the one that cannot fail on us halfway through. */
+    return (png) ? png : gdk_texture_save_to_png_bytes (texture);
 }
 
 /**
  * g_paste_image_item_new:
  * @texture: (transfer none): the GdkTexture we want to be contained in the #GPasteImageItem
+ * @encoder: how to encode it for storage
  *
  * Create a new instance of #GPasteImageItem
  *
@@ -329,7 +915,8 @@ g_paste_image_item_compute_checksum (GdkTexture *image)
  *          free it with g_object_unref
  */
 G_PASTE_VISIBLE GPasteItem *
-g_paste_image_item_new (GdkTexture *texture)
+g_paste_image_item_new (GdkTexture        *texture,
+                        GPasteImageEncoder encoder)
 {
     g_return_val_if_fail (GDK_IS_TEXTURE (texture), NULL);
 
@@ -346,11 +933,198 @@ g_paste_image_item_new (GdkTexture *texture)
     /* Encode once and carry the PNG: persisting the image (as a database blob,
      * a plain cache file, an encrypted side file...) is the storage backend's
      * business, and D-Bus clients get the bytes without touching the disk. */
-    g_paste_image_item_take_png (self, gdk_texture_save_to_png_bytes (texture));
+    g_paste_image_item_take_png (self, g_paste_image_item_encode (texture, encoder));
 
     return self;
 }
 
+/* Build a capture from the PNG a clipboard owner offered: decoding it is what
+ * gets us the pixels to fingerprint, and the bytes themselves are what a fresh
+ * capture would encode anyway, so they are kept as they are. Anything else GDK
+ * can decode is re-encoded, as the item carries a PNG whatever it came from. */
+static GPasteItem *
+g_paste_image_item_new_from_offered_png (GBytes            *png,
+                                         GPasteImageEncoder encoder)
+{
+    static const guchar signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GdkTexture) texture = gdk_texture_new_from_bytes (png, &error);
+
+    if (!texture)
+    {
+        g_debug ("Failed to decode offered image: %s", error->message);
+        return NULL;
+    }
+
+    GPasteItem *self = _g_paste_image_item_new (NULL,
+                                                g_date_time_new_now_local (),
+                                                g_object_ref (texture),
+                                                g_paste_image_item_compute_checksum (texture));
+    if (!self)
+        return NULL;
+
+    gsize length;
+    const guchar *data = g_bytes_get_data (png, &length);
+    gboolean is_png = (length > sizeof (signature) && !memcmp (data, signature, sizeof (signature)));
+
+    g_paste_image_item_take_png (self, (is_png) ? g_bytes_ref (png) : g_paste_image_item_encode (texture, encoder));
+
+    return self;
+}
+
+/* What a worker builds an item out of: one of @texture or @png. */
+typedef struct
+{
+    GdkTexture        *texture;
+    GBytes            *png;
+    GPasteImageEncoder encoder;
+} GPasteImageItemNewData;
+
+static void
+g_paste_image_item_new_data_free (gpointer user_data)
+{
+    GPasteImageItemNewData *data = user_data;
+
+    g_clear_object (&data->texture);
+    g_clear_pointer (&data->png, g_bytes_unref);
+    g_free (data);
+}
+
+static void
+g_paste_image_item_new_task (GTask        *task,
+                             gpointer      source_object G_GNUC_UNUSED,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+    /* Superseded before a worker got to it: skip the whole download + encode. */
+    if (g_task_return_error_if_cancelled (task))
+        return;
+
+    GPasteImageItemNewData *data = task_data;
+    GPasteItem *item = (data->texture)
+        ? g_paste_image_item_new (data->texture, data->encoder)
+        : g_paste_image_item_new_from_offered_png (data->png, data->encoder);
+
+    /* Superseded while we were at it: the result is dropped either way, but
+     * say so rather than hand back an item nobody is waiting for. */
+    if (g_cancellable_is_cancelled (cancellable))
+    {
+        g_clear_object (&item);
+        g_task_return_error_if_cancelled (task);
+        return;
+    }
+
+    if (!item)
+    {
+        g_task_return_new_error_literal (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid image");
+        return;
+    }
+
+    g_task_return_pointer (task, item, g_object_unref);
+}
+
+/**
+ * g_paste_image_item_new_async:
+ * @texture: (transfer none): the GdkTexture we want to be contained in the #GPasteImageItem
+ * @encoder: how to encode it for storage
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: called on the thread-default main context once the item is built
+ * @user_data: data for @callback
+ *
+ * Like g_paste_image_item_new(), on a worker thread. Building an image item
+ * means downloading every pixel to checksum it and encoding the whole thing to
+ * PNG, which for a screenshot takes long enough to stall the main loop -- and
+ * in gnome-shell, the compositor with it. A #GdkTexture is immutable, so
+ * reading it from another thread is safe; the item only reaches the caller
+ * once it is complete, through @callback on the context this was called from.
+ *
+ * The shared GTask pool bounds how many of these run at once, and each capture
+ * is independent, so nothing here decides what order results come back in:
+ * a caller that cares (a clipboard provider whose owner changed again in the
+ * meantime) has to check that itself when @callback fires.
+ */
+G_PASTE_VISIBLE void
+g_paste_image_item_new_async (GdkTexture         *texture,
+                              GPasteImageEncoder  encoder,
+                              GCancellable       *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer            user_data)
+{
+    g_return_if_fail (GDK_IS_TEXTURE (texture));
+    g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+    g_autoptr (GTask) task = g_task_new (NULL, cancellable, callback, user_data);
+
+    g_task_set_source_tag (task, g_paste_image_item_new_async);
+    GPasteImageItemNewData *data = g_new0 (GPasteImageItemNewData, 1);
+
+    data->texture = g_object_ref (texture);
+    data->encoder = encoder;
+
+    g_task_set_static_name (task, "gpaste-image-item-new");
+    g_task_set_task_data (task, data, g_paste_image_item_new_data_free);
+    g_task_run_in_thread (task, g_paste_image_item_new_task);
+}
+
+/**
+ * g_paste_image_item_new_from_png_async:
+ * @png: (transfer none): the encoded image a clipboard owner offered as image/png
+ * @encoder: how to encode it for storage, should it not be a PNG after all
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: called on the thread-default main context once the item is built
+ * @user_data: data for @callback
+ *
+ * Like g_paste_image_item_new_async(), from the bytes the clipboard offered
+ * rather than a texture decoded from them: the decode moves to the worker too,
+ * and the offered PNG becomes the item's own instead of being encoded again.
+ * Complete with g_paste_image_item_new_finish().
+ */
+G_PASTE_VISIBLE void
+g_paste_image_item_new_from_png_async (GBytes             *png,
+                                       GPasteImageEncoder  encoder,
+                                       GCancellable       *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer            user_data)
+{
+    g_return_if_fail (png);
+    g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+    g_autoptr (GTask) task = g_task_new (NULL, cancellable, callback, user_data);
+
+    /* Same tag as the texture flavour: one finish for both. */
+    g_task_set_source_tag (task, g_paste_image_item_new_async);
+    GPasteImageItemNewData *data = g_new0 (GPasteImageItemNewData, 1);
+
+    data->png = g_bytes_ref (png);
+    data->encoder = encoder;
+
+    g_task_set_static_name (task, "gpaste-image-item-new-from-png");
+    g_task_set_task_data (task, data, g_paste_image_item_new_data_free);
+    g_task_run_in_thread (task, g_paste_image_item_new_task);
+}
+
+/**
+ * g_paste_image_item_new_finish:
+ * @result: the #GAsyncResult handed to the g_paste_image_item_new_async() or
+ *          g_paste_image_item_new_from_png_async() callback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Complete g_paste_image_item_new_async() or g_paste_image_item_new_from_png_async().
+ *
+ * Returns: (transfer full) (nullable): the newly allocated #GPasteImageItem,
+ *          or %NULL with @error set when the texture held no usable image or
+ *          the build was cancelled
+ */
+G_PASTE_VISIBLE GPasteItem *
+g_paste_image_item_new_finish (GAsyncResult *result,
+                               GError      **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+    g_return_val_if_fail (g_async_result_is_tagged (result, g_paste_image_item_new_async), NULL);
+
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 static GPasteItem *
 _g_paste_image_item_new_from_bytes (const gchar *cache_path,
                                     GBytes      *png,
@@ -386,7 +1160,7 @@ _g_paste_image_item_new_from_bytes (const gchar *cache_path,
  * g_paste_image_item_new_from_bytes:
  * @png: the encoded PNG we want to be contained in the #GPasteImageItem
  * @date: (transfer none): the date at which the image was created
- * @checksum: (nullable): the image's known SHA256 checksum, or %NULL to compute it
+ * @checksum: (nullable): the image's known checksum, or %NULL to compute it
  *
  * Create a new instance of #GPasteImageItem from its encoded bytes (e.g. a
  * storage backend's blob), touching no file at all: the item carries the image
@@ -411,7 +1185,7 @@ g_paste_image_item_new_from_bytes (GBytes      *png,
  * @path: the on-disk location the image was stored with
  * @png: the encoded PNG we want to be contained in the #GPasteImageItem
  * @date: (transfer none): the date at which the image was created
- * @checksum: (nullable): the image's known SHA256 checksum, or %NULL to compute it
+ * @checksum: (nullable): the image's known checksum, or %NULL to compute it
  *
  * Like g_paste_image_item_new_from_bytes() but for bytes that came out of a
  * file (e.g. the encrypted file backend reading an image side file): the item
@@ -438,7 +1212,7 @@ g_paste_image_item_new_from_bytes_at_path (const gchar *path,
  * g_paste_image_item_new_from_file:
  * @path: the file holding the image we want to be contained in the #GPasteImageItem
  * @date: (transfer none): the date at which the image was created
- * @checksum: (nullable): the image's known SHA256 checksum, or %NULL to compute it
+ * @checksum: (nullable): the image's known checksum, or %NULL to compute it
  *
  * Create a new instance of #GPasteImageItem from a file, which becomes the
  * item's cache path: the image is read from it now (that is what computes the
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <gpaste-3/gpaste-image-encoder.h>
 #include <gpaste-daemon/gpaste-item.h>
 
 #include <gtk/gtk.h>
@@ -19,7 +20,23 @@ const GDateTime *g_paste_image_item_get_date       (GPasteImageItem *self);
 GdkTexture      *g_paste_image_item_get_image      (GPasteImageItem *self);
 GBytes          *g_paste_image_item_get_png_bytes  (GPasteImageItem *self);
 
-GPasteItem      *g_paste_image_item_new                    (GdkTexture  *texture);
+gboolean         g_paste_image_item_is_near_duplicate (GPasteImageItem *self,
+                                                       GPasteImageItem *other);
+
+GPasteItem      *g_paste_image_item_new                    (GdkTexture        *texture,
+                                                            GPasteImageEncoder encoder);
+void             g_paste_image_item_new_async              (GdkTexture         *texture,
+                                                            GPasteImageEncoder  encoder,
+                                                            GCancellable       *cancellable,
+                                                            GAsyncReadyCallback callback,
+                                                            gpointer            user_data);
+void             g_paste_image_item_new_from_png_async     (GBytes             *png,
+                                                            GPasteImageEncoder  encoder,
+                                                            GCancellable       *cancellable,
+                                                            GAsyncReadyCallback callback,
+                                                            gpointer            user_data);
+GPasteItem      *g_paste_image_item_new_finish             (GAsyncResult       *result,
+                                                            GError            **error);
 GPasteItem      *g_paste_image_item_new_from_file          (const gchar *path,
                                                             GDateTime   *date,
                                                             const gchar *checksum);
@@ -38,5 +55,11 @@ GPasteItem      *g_paste_image_item_new_from_bytes_at_path (const gchar *path,
  * libgpaste-gtk4: this library must not pull the widget stack into
  * gnome-shell, which cannot initialise it. */
 gchar           *g_paste_image_item_compute_checksum       (GdkTexture  *image);
+gboolean         g_paste_image_item_checksum_is_current    (const gchar *checksum);
+
+/* The PNG an image is stored as, out of whichever encoder the user picked
+ * (see the "images-encoder" setting). */
+GBytes          *g_paste_image_item_encode                 (GdkTexture        *texture,
+                                                            GPasteImageEncoder encoder);
 
 G_END_DECLS
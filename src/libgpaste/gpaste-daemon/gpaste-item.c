@@ -2,24 +2,206 @@
 // SPDX-License-Identifier: BSD-2-Clause
 
 #include <gpaste-daemon/gpaste-item.h>
+#include <gpaste-daemon/gpaste-storage-compression.h>
+#include <gpaste-daemon/gpaste-uuid.h>
 
 #include <string.h>
 
 #define GCR_API_SUBJECT_TO_CHANGE
 #include <gcr/gcr.h>
 
+/* Below this, an idle value is not worth holding compressed. */
+#define G_PASTE_ITEM_COMPRESSION_MIN_SIZE 1024
+
+/* How many compressed items a trim leaves their decompressed copy to. */
+#define G_PASTE_ITEM_VALUE_CACHE_SIZE 8
+
+/* How many characters of its display string an item is listed with: past the
+ * largest element-size a client can be set to, so that no client draws the
+ * cut rather than its own ellipsis. */
+#define G_PASTE_ITEM_PREVIEW_LENGTH 512
+
+/* Values shorter than this live in the item itself rather than in an
+ * allocation of their own: in a history of many short snippets, the allocation
+ * is most of what an item costs. */
+#define G_PASTE_ITEM_INLINE_VALUE_SIZE 24
+
+/* The value, while the item idles compressed (g_paste_item_compress()). Apart
+ * from the item, as only the few large ones ever have it. */
 typedef struct
 {
-    gchar   *uuid;
-    gchar   *value;
-    GSList  *special_values;
-    gchar   *display_string;
-    guint64  size;
-    gboolean favourite;
+    guchar *data;
+    gsize   length;
+    GList   cache_link;
+} GPasteItemCompressed;
+
+typedef struct
+{
+    GPasteUuid binary_uuid;
+    gchar     *value;
+    GSList    *special_values;
+    gchar     *display_string;
+    guint64    size;
+
+    /* What listings carry instead of the display string, when that is too
+     * long to list (NULL otherwise), and the length of the full one. Kept up
+     * to date with the value and the display string, so listing an idle
+     * compressed item never decompresses it. */
+    gchar     *preview;
+    guint64    display_length;
+
+    /* When set, @value is either NULL or a decompressed copy, in which case
+     * the compressed state's cache link is in value_cache. */
+    GPasteItemCompressed *compressed;
+
+    gboolean   favourite;
+    gchar      uuid[G_PASTE_UUID_STRING_LENGTH + 1];
+
+    /* Where @value points when it is short enough, and never for a secure
+     * item: that one belongs in secure memory. */
+    gchar      inline_value[G_PASTE_ITEM_INLINE_VALUE_SIZE];
 } GPasteItemPrivate;
 
 G_PASTE_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (Item, item, G_TYPE_OBJECT)
 
+/* The items whose value is a decompressed copy, most recently read first.
+ * Reading a compressed value decompresses it in place, and the copy has to
+ * outlive the read: callers get a borrowed string. So copies are only ever
+ * dropped by g_paste_item_trim_values(), which the history calls once it is
+ * done with an operation, and never while a background writer holds the
+ * values (g_paste_item_hold_values()). The lock covers the compressed state
+ * of every item, as the storage backends read values from the saver's thread. */
+static GMutex value_cache_lock;
+static GQueue value_cache = G_QUEUE_INIT;
+static guint  value_cache_holds = 0;
+
+/* With value_cache_lock held, or before anybody else can see the item. */
+static void
+g_paste_item_private_set_value (GPasteItemPrivate *priv,
+                                const gchar       *value,
+                                gboolean           secure)
+{
+    gsize length = strlen (value);
+
+    if (!secure && length < G_PASTE_ITEM_INLINE_VALUE_SIZE)
+    {
+        /* A move: @value may be a piece of what the buffer held. */
+        memmove (priv->inline_value, value, length + 1);
+        priv->value = priv->inline_value;
+    }
+    else
+    {
+        priv->value = (secure) ? gcr_secure_memory_strdup (value) : g_strdup (value);
+    }
+}
+
+/* Same locking as above. */
+static void
+g_paste_item_private_free_value (GPasteItemPrivate *priv,
+                                 gboolean           secure)
+{
+    if (priv->value != priv->inline_value)
+    {
+        if (secure)
+            gcr_secure_memory_strfree (priv->value);
+        else
+            g_free (priv->value);
+    }
+
+    priv->value = NULL;
+}
+
+/* With value_cache_lock held. */
+static const gchar *
+g_paste_item_private_get_value (GPasteItemPrivate *priv)
+{
+    GPasteItemCompressed *compressed = priv->compressed;
+
+    if (compressed)
+    {
+        if (priv->value)
+            g_queue_unlink (&value_cache, &compressed->cache_link);
+        else
+            priv->value = (gchar *) g_paste_storage_decompress (G_PASTE_COMPRESSION_ZSTD, compressed->data, compressed->length, NULL);
+
+        /* The link is in the cache exactly when there is a copy: one that failed
+         * to decompress leaves it out, or the next read would link it twice. */
+        if (priv->value)
+            g_queue_push_head_link (&value_cache, &compressed->cache_link);
+    }
+
+    return priv->value;
+}
+
+/* With value_cache_lock held, the value being a decompressed copy or NULL. */
+static void
+g_paste_item_private_free_compressed (GPasteItemPrivate *priv)
+{
+    GPasteItemCompressed *compressed = g_steal_pointer (&priv->compressed);
+
+    if (priv->value)
+        g_queue_unlink (&value_cache, &compressed->cache_link);
+    g_free (compressed->data);
+    g_free (compressed);
+}
+
+/* With value_cache_lock held: hold the value expanded again, for good. */
+static void
+g_paste_item_private_expand (GPasteItemPrivate *priv)
+{
+    /* Left compressed when it does not decompress: there is no value to hold. */
+    if (!priv->compressed || !g_paste_item_private_get_value (priv))
+        return;
+
+    priv->size -= priv->compressed->length;
+    priv->size += strlen (priv->value) + 1;
+    g_paste_item_private_free_compressed (priv);
+}
+
+/* With value_cache_lock held, or before anybody else can see the item. The
+ * value of a secure item is never shown, so it never makes a preview either:
+ * such an item is listed by the display string it is given. */
+static void
+g_paste_item_private_update_preview (GPasteItemPrivate *priv,
+                                     GPasteItemKind     kind,
+                                     gboolean           secure)
+{
+    if (priv->preview)
+    {
+        priv->size -= strlen (priv->preview) + 1;
+        g_clear_pointer (&priv->preview, g_free);
+    }
+
+    const gchar *shown = (priv->display_string || secure) ? priv->display_string : g_paste_item_private_get_value (priv);
+
+    priv->display_length = (shown) ? strlen (shown) : 0;
+    if (!shown)
+        return;
+
+    const gchar *end = shown;
+
+    for (guint i = 0; *end && i < G_PASTE_ITEM_PREVIEW_LENGTH; ++i)
+        end = g_utf8_next_char (end);
+
+    if (!*end)
+        return;
+
+    /* Cut between graphemes rather than characters, as far as glib can tell
+     * them apart: a combining mark stays with its base, and a joined sequence
+     * is not left hanging on its joiner. */
+    while (end > shown &&
+           (g_unichar_ismark (g_utf8_get_char (end)) || g_utf8_get_char (g_utf8_prev_char (end)) == 0x200D))
+        end = g_utf8_prev_char (end);
+
+    priv->preview = g_strndup (shown, end - shown);
+    priv->size += strlen (priv->preview) + 1;
+
+    /* One line, like every client draws it. Only for text: the newlines of a
+     * uris item are what its value splits on. */
+    if (kind == G_PASTE_ITEM_KIND_TEXT)
+        g_strdelimit (priv->preview, "\n\r\t", ' ');
+}
+
 /**
  * g_paste_item_get_uuid:
  * @self: a #GPasteItem instance
@@ -68,9 +250,10 @@ g_paste_item_get_real_value (GPasteItem *self)
 {
     g_return_val_if_fail (G_PASTE_IS_ITEM (self), NULL);
 
-    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
 
-    return priv->value;
+    return g_paste_item_private_get_value (priv);
 }
 
 /**
@@ -107,7 +290,47 @@ g_paste_item_get_display_string (GPasteItem *self)
     const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
     const gchar *display_string = priv->display_string;
 
-    return (display_string) ? display_string : priv->value;
+    return (display_string) ? display_string : g_paste_item_get_real_value (self);
+}
+
+/**
+ * g_paste_item_get_preview:
+ * @self: a #GPasteItem instance
+ *
+ * Get the string to list the #GPasteItem with: its display string, cut to
+ * its first few hundred characters and held on one line when it is longer
+ * than that. A listing costs as much as its rows then, however large the
+ * items: g_paste_item_get_display_string() remains the whole string.
+ *
+ * Returns: read-only preview string
+ */
+G_PASTE_VISIBLE const gchar *
+g_paste_item_get_preview (GPasteItem *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_ITEM (self), NULL);
+
+    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+
+    return (priv->preview) ? priv->preview : g_paste_item_get_display_string (self);
+}
+
+/**
+ * g_paste_item_get_display_length:
+ * @self: a #GPasteItem instance
+ *
+ * Get the length of the display string, in bytes, for whoever was handed the
+ * preview alone to tell whether it has it all.
+ *
+ * Returns: the length of the display string
+ */
+G_PASTE_VISIBLE guint64
+g_paste_item_get_display_length (GPasteItem *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_ITEM (self), 0);
+
+    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+
+    return priv->display_length;
 }
 
 /**
@@ -201,7 +424,8 @@ g_paste_item_set_favourite (GPasteItem *self,
  * g_paste_item_get_size:
  * @self: a #GPasteItem instance
  *
- * Get the size of the #GPasteItem
+ * Get the size of the #GPasteItem. For an item held compressed, that is
+ * the compressed size of its value.
  *
  * Returns: The size of its contents
  */
@@ -298,6 +522,10 @@ g_paste_item_set_display_string (GPasteItem *self,
      * permanently over max-memory-usage and starts evicting the history. */
     if (priv->display_string)
         priv->size += strlen (priv->display_string) + 1;
+
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    g_paste_item_private_update_preview (priv, g_paste_item_get_kind (self), G_PASTE_ITEM_GET_CLASS (self)->secure (self));
 }
 
 /**
@@ -350,11 +578,35 @@ g_paste_item_set_uuid (GPasteItem  *self,
                        const gchar *uuid)
 {
     g_return_if_fail (G_PASTE_IS_ITEM (self));
-    g_return_if_fail (g_uuid_string_is_valid (uuid));
 
     GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    GPasteUuid binary_uuid;
 
-    g_set_str (&priv->uuid, uuid);
+    g_return_if_fail (g_paste_uuid_parse (uuid, &binary_uuid));
+
+    /* Written back out rather than copied, so that the string always reads
+     * the way the bytes it is looked up by do. */
+    priv->binary_uuid = binary_uuid;
+    g_paste_uuid_format (&binary_uuid, priv->uuid);
+}
+
+/**
+ * g_paste_item_get_binary_uuid: (skip)
+ * @self: a #GPasteItem instance
+ *
+ * Get the uuid of the given item as the bytes it spells, which is what the
+ * history indexes it by
+ *
+ * Returns: the uuid, owned by the item
+ */
+G_PASTE_VISIBLE const GPasteUuid *
+g_paste_item_get_binary_uuid (GPasteItem *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_ITEM (self), NULL);
+
+    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+
+    return &priv->binary_uuid;
 }
 
 /**
@@ -376,6 +628,9 @@ g_paste_item_set_value (GPasteItem  *self,
 
     GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
     gboolean secure = G_PASTE_ITEM_GET_CLASS (self)->secure (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    g_paste_item_private_expand (priv);
 
     /* Also guards against @value aliasing our current value, which would be
      * read after free below. */
@@ -384,13 +639,150 @@ g_paste_item_set_value (GPasteItem  *self,
 
     priv->size -= strlen (priv->value) + 1;
 
-    if (secure)
-        gcr_secure_memory_strfree (priv->value);
-    else
-        g_free (priv->value);
-
-    priv->value = (secure) ? gcr_secure_memory_strdup (value) : g_strdup (value);
+    g_paste_item_private_free_value (priv, secure);
+    g_paste_item_private_set_value (priv, value, secure);
     priv->size += strlen (priv->value) + 1;
+
+    g_paste_item_private_update_preview (priv, g_paste_item_get_kind (self), secure);
+}
+
+/**
+ * g_paste_item_compress:
+ * @self: a #GPasteItem instance
+ *
+ * Hold the value of an idle text or uris item compressed, when it is large
+ * enough for that to pay off: it is decompressed on demand, and expanded for
+ * good once the item is active again. The size of the item changes with it,
+ * which is for the caller to account for, like with g_paste_item_set_state().
+ *
+ * Does nothing in a build without zstd.
+ */
+G_PASTE_VISIBLE void
+g_paste_item_compress (GPasteItem *self)
+{
+    g_return_if_fail (G_PASTE_IS_ITEM (self));
+
+    GPasteItemKind kind = g_paste_item_get_kind (self);
+
+    /* Secure memory is for values that must never reach the regular heap. */
+    if ((kind != G_PASTE_ITEM_KIND_TEXT && kind != G_PASTE_ITEM_KIND_URIS) ||
+        G_PASTE_ITEM_GET_CLASS (self)->secure (self) ||
+        !g_paste_storage_compression_is_available (G_PASTE_COMPRESSION_ZSTD))
+        return;
+
+    GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    if (priv->compressed)
+        return;
+
+    gsize length = strlen (priv->value);
+
+    if (length < G_PASTE_ITEM_COMPRESSION_MIN_SIZE)
+        return;
+
+    gsize compressed_length;
+    guchar *data = g_paste_storage_compress (G_PASTE_COMPRESSION_ZSTD, priv->value, length, &compressed_length);
+
+    if (!data)
+        return;
+
+    priv->compressed = g_new0 (GPasteItemCompressed, 1);
+    priv->compressed->data = data;
+    priv->compressed->length = compressed_length;
+    priv->compressed->cache_link.data = self;
+
+    priv->size -= length + 1;
+    priv->size += compressed_length;
+
+    /* Not freed here: whoever read the value may still be using it. It is
+     * the cache's least recently read copy, first to go on the next trim.
+     * Large enough to be compressed, it was never inline to begin with. */
+    g_queue_push_tail_link (&value_cache, &priv->compressed->cache_link);
+}
+
+/* Drop the decompressed copies of compressed values past the @keep most
+ * recently read, unless a background writer holds them. Returns how many bytes
+ * that freed. */
+static gsize
+g_paste_item_private_trim_values (guint keep)
+{
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+    gsize freed = 0;
+
+    if (value_cache_holds)
+        return 0;
+
+    while (value_cache.length > keep)
+    {
+        GList *link = g_queue_pop_tail_link (&value_cache);
+        GPasteItemPrivate *priv = g_paste_item_get_instance_private (link->data);
+
+        if (priv->value)
+            freed += strlen (priv->value) + 1;
+        g_clear_pointer (&priv->value, g_free);
+    }
+
+    return freed;
+}
+
+/**
+ * g_paste_item_trim_values:
+ *
+ * Drop the decompressed copies of compressed values, all but the few most
+ * recently read, unless a background writer holds them. Only call this where
+ * nobody can still be using a value read before: #GPasteHistory does once it
+ * is done with an operation.
+ */
+G_PASTE_VISIBLE void
+g_paste_item_trim_values (void)
+{
+    g_paste_item_private_trim_values (G_PASTE_ITEM_VALUE_CACHE_SIZE);
+}
+
+/**
+ * g_paste_item_shed_values:
+ *
+ * Like g_paste_item_trim_values(), but dropping every decompressed copy, the
+ * most recently read ones too: for when memory is short, at the cost of
+ * decompressing them again on the next read.
+ *
+ * Returns: how many bytes that freed
+ */
+G_PASTE_VISIBLE gsize
+g_paste_item_shed_values (void)
+{
+    return g_paste_item_private_trim_values (0);
+}
+
+/**
+ * g_paste_item_hold_values:
+ *
+ * Keep g_paste_item_trim_values() from dropping any value until the matching
+ * g_paste_item_release_values(): for a thread reading the values of items the
+ * history may be working on meanwhile.
+ */
+G_PASTE_VISIBLE void
+g_paste_item_hold_values (void)
+{
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    ++value_cache_holds;
+}
+
+/**
+ * g_paste_item_release_values:
+ *
+ * Release the hold g_paste_item_hold_values() took.
+ */
+G_PASTE_VISIBLE void
+g_paste_item_release_values (void)
+{
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    g_return_if_fail (value_cache_holds);
+
+    --value_cache_holds;
 }
 
 static void
@@ -407,14 +799,18 @@ static void
 g_paste_item_finalize (GObject *object)
 {
     GPasteItem *self = G_PASTE_ITEM (object);
-    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
 
-    g_free (priv->uuid);
-    if (G_PASTE_ITEM_GET_CLASS (self)->secure (self))
-        gcr_secure_memory_strfree (priv->value);
-    else
-        g_free (priv->value);
+    if (priv->compressed)
+    {
+        g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+        g_paste_item_private_free_compressed (priv);
+    }
+
+    g_paste_item_private_free_value (priv, G_PASTE_ITEM_GET_CLASS (self)->secure (self));
     g_free (priv->display_string);
+    g_free (priv->preview);
 
     G_OBJECT_CLASS (g_paste_item_parent_class)->finalize (object);
 }
@@ -432,16 +828,21 @@ g_paste_item_default_equals (GPasteItem *self,
     if (g_paste_item_get_kind (self) != g_paste_item_get_kind (other))
         return FALSE;
 
-    const GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
-    const GPasteItemPrivate *_priv = g_paste_item_get_instance_private (other);
-
-    return g_paste_str_equal (priv->value, _priv->value);
+    return g_paste_str_equal (g_paste_item_get_real_value (self), g_paste_item_get_real_value (other));
 }
 
+/* An item that gets active again is going to be read: expand it for good. */
 static void
-g_paste_item_default_set_state (GPasteItem     *self  G_GNUC_UNUSED,
-                                GPasteItemState state G_GNUC_UNUSED)
+g_paste_item_default_set_state (GPasteItem     *self,
+                                GPasteItemState state)
 {
+    if (state != G_PASTE_ITEM_STATE_ACTIVE)
+        return;
+
+    GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&value_cache_lock);
+
+    g_paste_item_private_expand (priv);
 }
 
 static gboolean
@@ -488,12 +889,17 @@ g_paste_item_new (GType        type,
 
     GPasteItem *self = g_object_new (type, NULL);
     GPasteItemPrivate *priv = g_paste_item_get_instance_private (self);
+    gboolean secure = G_PASTE_ITEM_GET_CLASS (self)->secure (self);
 
-    priv->uuid = g_uuid_string_random ();
-    priv->value = (G_PASTE_ITEM_GET_CLASS (self)->secure (self)) ? gcr_secure_memory_strdup (value) : g_strdup (value);
+    g_autofree gchar *uuid = g_uuid_string_random ();
+
+    g_paste_item_set_uuid (self, uuid);
+    g_paste_item_private_set_value (priv, value, secure);
     priv->display_string = NULL;
 
     priv->size = strlen (priv->value) + 1;
 
+    g_paste_item_private_update_preview (priv, g_paste_item_get_kind (self), secure);
+
     return self;
 }
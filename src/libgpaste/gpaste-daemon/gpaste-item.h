@@ -38,6 +38,8 @@ const gchar  *g_paste_item_get_value          (GPasteItem *self);
 const gchar  *g_paste_item_get_real_value     (GPasteItem *self);
 const GSList *g_paste_item_get_special_values (GPasteItem *self);
 const gchar  *g_paste_item_get_display_string (GPasteItem *self);
+const gchar  *g_paste_item_get_preview        (GPasteItem *self);
+guint64       g_paste_item_get_display_length (GPasteItem *self);
 gboolean      g_paste_item_equals             (GPasteItem *self,
                                                GPasteItem *other);
 GPasteItemKind g_paste_item_get_kind          (GPasteItem *self);
@@ -59,6 +61,13 @@ void g_paste_item_set_display_string (GPasteItem       *self,
 void g_paste_item_add_special_value  (GPasteItem       *self,
                                       GPasteBinaryData *binary_data);
 
+void g_paste_item_compress (GPasteItem *self);
+
+void  g_paste_item_trim_values    (void);
+gsize g_paste_item_shed_values    (void);
+void  g_paste_item_hold_values    (void);
+void  g_paste_item_release_values (void);
+
 void g_paste_item_set_size    (GPasteItem *self,
                                guint64     size);
 void g_paste_item_add_size    (GPasteItem *self,
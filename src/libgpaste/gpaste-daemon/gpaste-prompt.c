@@ -383,12 +383,23 @@ g_paste_prompt_default_report (GPastePrompt *self G_GNUC_UNUSED,
     g_warning ("%s: %s", title, message);
 }
 
+/* Progress is no failure: only whoever asked for debug output hears it. */
+static void
+g_paste_prompt_default_progress (GPastePrompt *self     G_GNUC_UNUSED,
+                                 const gchar  *title,
+                                 gdouble       fraction,
+                                 const gchar  *status)
+{
+    g_debug ("%s: %.0f%% %s", title, fraction * 100, (status) ? status : "");
+}
+
 static void
 g_paste_prompt_default_init (GPastePromptInterface *iface)
 {
     iface->passphrase = g_paste_prompt_default_prompt;
     iface->migration = g_paste_prompt_default_prompt;
     iface->report = g_paste_prompt_default_report;
+    iface->progress = g_paste_prompt_default_progress;
 }
 
 /**
@@ -412,6 +423,29 @@ g_paste_prompt_report (GPastePrompt *self,
     G_PASTE_PROMPT_GET_IFACE (self)->report (self, title, message);
 }
 
+/**
+ * g_paste_prompt_progress:
+ * @self: a #GPastePrompt instance
+ * @title: what is under way, in the user's words
+ * @fraction: how much of it is done, from 0 to 1
+ * @status: (nullable): a line on how it is going, e.g. its pace and what is left
+ *
+ * Tell the user how far along something long-running is. Called as often as
+ * there is news, and a last time with a @fraction of 1 once it is over, whether
+ * it worked or not: what went wrong, if anything, is reported separately.
+ */
+G_PASTE_VISIBLE void
+g_paste_prompt_progress (GPastePrompt *self,
+                         const gchar  *title,
+                         gdouble       fraction,
+                         const gchar  *status)
+{
+    g_return_if_fail (G_PASTE_IS_PROMPT (self));
+    g_return_if_fail (title);
+
+    G_PASTE_PROMPT_GET_IFACE (self)->progress (self, title, CLAMP (fraction, 0, 1), status);
+}
+
 /**
  * g_paste_prompt_passphrase_async:
  * @self: a #GPastePrompt instance
@@ -936,6 +970,10 @@ g_paste_prompt_text_get_type (void)
             { G_PASTE_PROMPT_TEXT_REKEY_SPLIT_DESCRIPTION,           "G_PASTE_PROMPT_TEXT_REKEY_SPLIT_DESCRIPTION",           "rekey-split-description" },
             { G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_TITLE,              "G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_TITLE",              "cleanup-failed-title" },
             { G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_DESCRIPTION,        "G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_DESCRIPTION",        "cleanup-failed-description" },
+            { G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE,          "G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE",          "migration-progress-title" },
+            { G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS,                "G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS",                "migration-progress" },
+            { G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE,              "G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE",              "rekey-progress-title" },
+            { G_PASTE_PROMPT_TEXT_REKEY_PROGRESS,                    "G_PASTE_PROMPT_TEXT_REKEY_PROGRESS",                    "rekey-progress" },
             { G_PASTE_PROMPT_TEXT_CLOSE,                             "G_PASTE_PROMPT_TEXT_CLOSE",                             "close" },
             { G_PASTE_PROMPT_TEXT_CANCEL,                            "G_PASTE_PROMPT_TEXT_CANCEL",                            "cancel" },
             { 0, NULL, NULL }
@@ -1016,6 +1054,20 @@ g_paste_prompt_text (GPastePromptText text)
         return _("The old data was not deleted");
     case G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_DESCRIPTION:
         return _("The clipboard history GPaste was told to delete after the migration is still on disk.");
+    case G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE:
+        return _("Migrating your clipboard history");
+    case G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS:
+        /* Translators: a printf format. In order: the histories copied so far,
+         * how many there are, the amount copied per second ("4.2 MB"), and the
+         * time left ("1:05"). Keep the four, in that order. */
+        return _("%u of %u histories copied, %s per second, %s left");
+    case G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE:
+        return _("Changing your passphrase");
+    case G_PASTE_PROMPT_TEXT_REKEY_PROGRESS:
+        /* Translators: a printf format. In order: the histories re-encrypted so
+         * far, how many there are, and the time left ("1:05"). Keep the three,
+         * in that order. */
+        return _("%u of %u histories re-encrypted, %s left");
     case G_PASTE_PROMPT_TEXT_CLOSE:
         return _("Close");
     case G_PASTE_PROMPT_TEXT_CANCEL:
@@ -74,6 +74,13 @@ G_DECLARE_INTERFACE (GPastePrompt, g_paste_prompt, G_PASTE, PROMPT, GObject)
  * happen — a passphrase that did not change, old data that was not deleted —
  * where a log line would leave them believing it did. Its default implementation
  * is that log line, so a backend that skips it loses the dialog, not the report.
+ *
+ * @progress asks nothing either: it says how far along something long-running
+ * the user set in motion is -- a migration copying histories -- so they are not
+ * left looking at a daemon that seems to do nothing for minutes. It is called
+ * again and again as the work advances, and once more with a @fraction of 1
+ * when it is over, which is the backend's cue to take down whatever it showed.
+ * Its default implementation logs at debug level.
  */
 struct _GPastePromptInterface
 {
@@ -86,6 +93,10 @@ struct _GPastePromptInterface
     void (*report)     (GPastePrompt        *self,
                         const gchar         *title,
                         const gchar         *message);
+    void (*progress)   (GPastePrompt        *self,
+                        const gchar         *title,
+                        gdouble              fraction,
+                        const gchar         *status);
 };
 
 /* What the prompt was asked. Only the getters matching the vfunc that received
@@ -149,6 +160,13 @@ void g_paste_prompt_report (GPastePrompt *self,
                             const gchar  *title,
                             const gchar  *message);
 
+/* Tell the user how far along something long is. Nothing comes back either, and
+ * a @fraction of 1 says it is over. */
+void g_paste_prompt_progress (GPastePrompt *self,
+                              const gchar  *title,
+                              gdouble       fraction,
+                              const gchar  *status);
+
 /* The backends the migration prompt should offer, in display order: whichever
  * flavors this build can actually construct. Shared so the feature gating and
  * the labels live here rather than in each prompt backend. */
@@ -199,6 +217,14 @@ typedef enum
     G_PASTE_PROMPT_TEXT_REKEY_SPLIT_DESCRIPTION,
     G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_TITLE,
     G_PASTE_PROMPT_TEXT_CLEANUP_FAILED_DESCRIPTION,
+    /* What g_paste_prompt_progress() is called with while a migration copies
+     * the histories over. The second one is a format: see its translator
+     * comment. */
+    G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE,
+    G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS,
+    /* The same, for a passphrase change re-encrypting them. */
+    G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE,
+    G_PASTE_PROMPT_TEXT_REKEY_PROGRESS,
     G_PASTE_PROMPT_TEXT_CLOSE,
     G_PASTE_PROMPT_TEXT_CANCEL,
 } GPastePromptText;
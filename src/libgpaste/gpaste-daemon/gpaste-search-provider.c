@@ -161,7 +161,9 @@ typedef struct
 /* What the shell shows of a result, and what it puts on the clipboard if the
  * user copies one: the first is the decorated string every client draws, so a
  * search result names its kind the way the menu's row does; the second is the
- * item's own value, which is what pasting it has to give. */
+ * item's own value, which is what pasting it has to give. So that one is left
+ * out when the search only answered the start of the value: activating the
+ * result still selects the whole of it. */
 static void
 append_meta (GVariantBuilder  *builder,
              GPasteClientItem *item)
@@ -173,7 +175,8 @@ append_meta (GVariantBuilder  *builder,
     append_dict_entry (&dict, "id", g_paste_client_item_get_uuid (item));
     append_dict_entry (&dict, "name", result);
     append_dict_entry (&dict, "gicon", G_PASTE_ICON_NAME);
-    append_dict_entry (&dict, "clipboardText", value);
+    if (!g_paste_client_item_is_truncated (item))
+        append_dict_entry (&dict, "clipboardText", value);
 
     g_variant_builder_add_value (builder, g_variant_builder_end (&dict));
 }
@@ -9,21 +9,58 @@
 #include <sodium.h>
 
 /* A bidirectional GConverter built on libsodium's secretstream (XChaCha20-
- * Poly1305). The symmetric key is derived from a user passphrase with
- * crypto_pwhash (Argon2id); the random salt and the Argon2 parameters are
- * stored in the stream header so decryption can reproduce the key.
+ * Poly1305). The key comes from a user passphrase through crypto_pwhash
+ * (Argon2id); the salt and the Argon2 parameters are stored in the stream
+ * header so decryption can reproduce it.
  *
- * Stream layout:
+ * Segmented layout, version 3 (what we write by default):
  *
- *   MAGIC (8)  salt (16)  opslimit (u64 LE)  memlimit (u64 LE)  ss_header (24)
- *   then, repeated until the FINAL chunk:  clen (u32 LE)  ciphertext (clen)
+ *   "GPSTENC3" (8)  salt (16)  opslimit (u64 LE)  memlimit (u64 LE)  nonce (32)  segment_size (u32 LE)
+ *
+ * followed by segments, then the manifest:
+ *
+ *   clen (u32 LE)  XChaCha20-Poly1305 ciphertext (clen)      repeated
+ *   0xFFFFFFFF (u32)  sealed { segment count (u64 LE)  plaintext length (u64 LE) }
+ *
+ * A segment holds up to segment_size bytes of plaintext and is sealed on its
+ * own, with its index as nonce and associated data, so segments cannot be
+ * reordered and any number of them can be sealed or opened at once: a batch
+ * is spread over a thread pool, which is what makes a large history or image
+ * cost wall-clock time divided by the number of cores. The manifest is sealed
+ * like one more segment; a stream that ends without it, or whose manifest does
+ * not match what was read, was truncated.
+ *
+ * Sequential layout, version 2 (still written on demand, and read):
+ *
+ *   "GPSTENC2" (8)  salt (16)  opslimit (u64 LE)  memlimit (u64 LE)  nonce (32)  ss_header (24)
+ *
+ * In both, Argon2id turns the passphrase and salt into a master key, and the stream key
+ * is a keyed BLAKE2b of the random per-stream nonce under that master key. The
+ * salt is the session's, not the stream's: the master key for a passphrase is
+ * derived once and kept (see the master key cache below), so a history and
+ * the dozens of ".pngs" images saved or loaded along with it cost one Argon2id
+ * run between them instead of one each. Every stream still gets a key of its
+ * own, which is what the nonce is for.
+ *
+ * Version 1, still read:
+ *
+ *   "GPSTENC1" (8)  salt (16)  opslimit (u64 LE)  memlimit (u64 LE)  ss_header (24)
+ *
+ * where the stream key is the Argon2id output itself, under a salt drawn for
+ * that stream alone.
+ *
+ * Versions 1 and 2 are followed by frames repeated until the FINAL chunk:
+ *
+ *   clen (u32 LE)  ciphertext (clen)
  *
  * Each plaintext chunk is at most CHUNK_SIZE bytes; the last one carries the
  * secretstream FINAL tag so truncation is detected. Both directions buffer
  * internally (a chunk worth of input, the produced output) so the converter
  * copes with the arbitrary split of buffers GConverter hands it. */
 
-#define G_PASTE_SECRET_STREAM_MAGIC     "GPSTENC1"
+#define G_PASTE_SECRET_STREAM_MAGIC_V1  "GPSTENC1"
+#define G_PASTE_SECRET_STREAM_MAGIC_V2  "GPSTENC2"
+#define G_PASTE_SECRET_STREAM_MAGIC_V3  "GPSTENC3"
 #define G_PASTE_SECRET_STREAM_MAGIC_LEN 8
 
 #define CHUNK_SIZE      4096
@@ -33,6 +70,7 @@
 #define TAG_MESSAGE     crypto_secretstream_xchacha20poly1305_TAG_MESSAGE
 #define TAG_FINAL       crypto_secretstream_xchacha20poly1305_TAG_FINAL
 #define SALTBYTES       crypto_pwhash_SALTBYTES
+#define NONCEBYTES      32
 
 /* Argon2 cost parameters used when deriving the key for a *new* stream; the
  * actual values are stored in each stream's header, so decryption always reads
@@ -40,13 +78,41 @@
 #define OPSLIMIT        crypto_pwhash_OPSLIMIT_MODERATE
 #define MEMLIMIT        crypto_pwhash_MEMLIMIT_MODERATE
 
-#define STREAM_HEADER_LEN (G_PASTE_SECRET_STREAM_MAGIC_LEN + SALTBYTES + 8 + 8 + HEADERBYTES)
+#define STREAM_HEADER_V1_LEN (G_PASTE_SECRET_STREAM_MAGIC_LEN + SALTBYTES + 8 + 8 + HEADERBYTES)
+#define STREAM_HEADER_V2_LEN (STREAM_HEADER_V1_LEN + NONCEBYTES)
+#define STREAM_HEADER_V3_LEN (G_PASTE_SECRET_STREAM_MAGIC_LEN + SALTBYTES + 8 + 8 + NONCEBYTES + 4)
+
+/* Large enough that sealing one is worth handing to another thread, small
+ * enough that a batch of them stays a modest amount of memory. Readers take
+ * the size from the header, up to MAX_SEGMENT_SIZE. */
+#define SEGMENT_SIZE      (1 << 20)
+#define MAX_SEGMENT_SIZE  (16 << 20)
+#define MAX_SEGMENT_BATCH 8
+#define SEGMENT_ABYTES    crypto_aead_xchacha20poly1305_ietf_ABYTES
+#define SEGMENT_NPUBBYTES crypto_aead_xchacha20poly1305_ietf_NPUBBYTES
+#define MANIFEST_MARKER   G_MAXUINT32
+#define MANIFEST_LEN      (8 + 8 + SEGMENT_ABYTES)
+
+/* What the associated data says a sealed block is, so the manifest can never
+ * pass for a segment or the other way round. */
+#define SEGMENT_KIND_DATA     0
+#define SEGMENT_KIND_MANIFEST 1
+
+/* Tell the stream keys apart from anything else ever keyed by a master key,
+ * and the keys of the two formats apart from one another. */
+#define SUBKEY_CONTEXT           "GPaste secretstream subkey"
+#define SEGMENTED_SUBKEY_CONTEXT "GPaste segmented subkey"
+
+/* How many master keys the session keeps: one per passphrase in use, plus the
+ * odd salt read back from a store written in another session. */
+#define MAX_MASTER_KEYS 8
 
 struct _GPasteSecretStreamConverter
 {
     GObject parent_instance;
 
     GPasteSecretStreamDirection direction;
+    GPasteSecretStreamFormat    format; /* what we write; what we read is up to the header */
     /* Kept (in gcr secure memory) for the converter's lifetime: the key is
      * derived lazily and salt-dependent, so reset() must be able to re-derive
      * it for a fresh stream (whose salt may differ). */
@@ -54,13 +120,19 @@ struct _GPasteSecretStreamConverter
     gsize                       passphrase_len;
 
     gboolean                    header_done; /* header emitted (encrypt) or parsed (decrypt) */
-    gboolean                    finished;    /* FINAL chunk produced/consumed */
+    gboolean                    finished;    /* FINAL chunk or manifest produced/consumed */
+
+    gboolean                    segmented;     /* the stream at hand is version 3 */
+    guint32                     segment_size;
+    guint64                     segment_index; /* segments produced/consumed so far */
+    guint64                     plain_len;     /* plaintext produced/consumed so far */
 
     crypto_secretstream_xchacha20poly1305_state state;
     guchar                     *key; /* KEYBYTES, in gcr secure (non-swappable) memory */
 
     GByteArray                 *in;  /* input not processed yet */
-    GByteArray                 *out; /* output not handed back yet */
+    GByteArray                 *out;     /* output not handed back yet, from out_pos */
+    gsize                       out_pos; /* how much of out was handed back already */
 };
 
 static void g_paste_secret_stream_converter_iface_init (GConverterIface *iface);
@@ -106,9 +178,12 @@ read_u64_le (const guint8 *data)
     return GUINT64_FROM_LE (le);
 }
 
-/* Encrypt the first @len buffered bytes into a length-prefixed frame. */
-static void
+/* Encrypt @len buffered bytes, from @offset on, into a length-prefixed frame.
+ * The caller drops the input once it is done with all of it: dropping each
+ * chunk as it goes would move the whole buffer for every 4 KiB. */
+static gsize
 push_chunk (GPasteSecretStreamConverter *self,
+            gsize                        offset,
             gsize                        len,
             unsigned char                tag)
 {
@@ -116,13 +191,12 @@ push_chunk (GPasteSecretStreamConverter *self,
     unsigned long long clen = 0;
 
     crypto_secretstream_xchacha20poly1305_push (&self->state, cipher, &clen,
-                                                self->in->data, len, NULL, 0, tag);
+                                                self->in->data + offset, len, NULL, 0, tag);
 
     append_u32_le (self->out, (guint32) clen);
     g_byte_array_append (self->out, cipher, clen);
 
-    if (len)
-        g_byte_array_remove_range (self->in, 0, len);
+    return offset + len;
 }
 
 /**
@@ -197,6 +271,740 @@ derive_key (GPasteSecretStreamConverter *self,
                                       self->key, KEYBYTES, error);
 }
 
+/* --- master key cache --- */
+
+/* A master key, with what it was derived from. The passphrase is only known by
+ * a keyed hash under a key drawn for this process, so the cache holds nothing
+ * that would let anyone check a guess against it once the process is gone. */
+typedef struct
+{
+    guchar  passphrase_id[crypto_generichash_BYTES];
+    guchar  salt[SALTBYTES];
+    guint64 opslimit;
+    guint64 memlimit;
+    guchar  key[KEYBYTES];
+} GPasteMasterKey;
+
+static GMutex  master_keys_lock;
+static GQueue  master_keys = G_QUEUE_INIT; /* GPasteMasterKey*, most recently used first, in gcr secure memory */
+static guchar *master_keys_id_key = NULL;  /* crypto_generichash_KEYBYTES, in gcr secure memory */
+
+static void
+master_key_free (gpointer data)
+{
+    gcr_secure_memory_free (data);
+}
+
+/* With master_keys_lock held. */
+static void
+master_key_id (const gchar *passphrase,
+               gsize        passphrase_len,
+               guchar      *passphrase_id)
+{
+    if (!master_keys_id_key)
+    {
+        master_keys_id_key = gcr_secure_memory_alloc (crypto_generichash_KEYBYTES);
+        crypto_generichash_keygen (master_keys_id_key);
+    }
+
+    crypto_generichash (passphrase_id, crypto_generichash_BYTES,
+                        (const guchar *) passphrase, passphrase_len,
+                        master_keys_id_key, crypto_generichash_KEYBYTES);
+}
+
+/* Fill @key and @salt_out with the master key for @passphrase under @salt, or
+ * under whichever salt the session already uses with these parameters when
+ * @salt is %NULL (a new salt is drawn if there is none yet). Only a miss runs
+ * Argon2id, and it runs under the lock: the streams of a history load all
+ * want the same key at once, and the first one deriving it is cheaper to
+ * wait for than to race. */
+static gboolean
+master_key_get (const gchar         *passphrase,
+                gsize                passphrase_len,
+                const unsigned char *salt,
+                guint64              opslimit,
+                guint64              memlimit,
+                unsigned char       *salt_out,
+                unsigned char       *key,
+                GError             **error)
+{
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&master_keys_lock);
+    guchar passphrase_id[crypto_generichash_BYTES];
+
+    master_key_id (passphrase, passphrase_len, passphrase_id);
+
+    for (GList *l = master_keys.head; l; l = l->next)
+    {
+        GPasteMasterKey *master = l->data;
+
+        if (sodium_memcmp (master->passphrase_id, passphrase_id, sizeof (passphrase_id)) != 0 ||
+            master->opslimit != opslimit || master->memlimit != memlimit ||
+            (salt && memcmp (master->salt, salt, SALTBYTES) != 0))
+            continue;
+
+        g_queue_unlink (&master_keys, l);
+        g_queue_push_head_link (&master_keys, l);
+
+        memcpy (salt_out, master->salt, SALTBYTES);
+        memcpy (key, master->key, KEYBYTES);
+
+        return TRUE;
+    }
+
+    GPasteMasterKey *master = gcr_secure_memory_alloc (sizeof (GPasteMasterKey));
+
+    memcpy (master->passphrase_id, passphrase_id, sizeof (passphrase_id));
+    if (salt)
+        memcpy (master->salt, salt, SALTBYTES);
+    else
+        randombytes_buf (master->salt, SALTBYTES);
+    master->opslimit = opslimit;
+    master->memlimit = memlimit;
+
+    if (!g_paste_crypto_derive_key (passphrase, passphrase_len,
+                                    master->salt, opslimit, memlimit,
+                                    master->key, KEYBYTES, error))
+    {
+        master_key_free (master);
+        return FALSE;
+    }
+
+    g_queue_push_head (&master_keys, master);
+    while (master_keys.length > MAX_MASTER_KEYS)
+        master_key_free (g_queue_pop_tail (&master_keys));
+
+    memcpy (salt_out, master->salt, SALTBYTES);
+    memcpy (key, master->key, KEYBYTES);
+
+    return TRUE;
+}
+
+/**
+ * g_paste_secret_stream_converter_forget_keys:
+ *
+ * Wipe the master keys the converters derived this session, so the next
+ * stream runs Argon2id again. For when a passphrase stops being in use, e.g.
+ * once a history was re-encrypted under another one.
+ */
+G_PASTE_VISIBLE void
+g_paste_secret_stream_converter_forget_keys (void)
+{
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&master_keys_lock);
+
+    /* gcr secure memory is wiped on free. */
+    g_queue_clear_full (&master_keys, master_key_free);
+}
+
+/**
+ * g_paste_secret_stream_converter_export_keys:
+ * @passphrase: the passphrase whose master keys to export
+ *
+ * The master keys derived from @passphrase this session, with the salt and
+ * Argon2 parameters of each, as an "a(ayttay)" #GVariant. Meant for a re-exec
+ * handing its state over to its successor, which would otherwise run Argon2id
+ * again for keys the predecessor already had: the variant lives in ordinary
+ * memory, so it must go straight to where it is handed over and nowhere else.
+ *
+ * Returns: (transfer full) (nullable): the keys, or %NULL when there are none
+ */
+G_PASTE_VISIBLE GVariant *
+g_paste_secret_stream_converter_export_keys (const gchar *passphrase)
+{
+    g_return_val_if_fail (passphrase, NULL);
+
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&master_keys_lock);
+    guchar passphrase_id[crypto_generichash_BYTES];
+
+    if (!master_keys.length)
+        return NULL;
+
+    master_key_id (passphrase, strlen (passphrase), passphrase_id);
+
+    g_auto (GVariantBuilder) builder = G_VARIANT_BUILDER_INIT (G_VARIANT_TYPE ("a(ayttay)"));
+    gboolean any = FALSE;
+
+    for (GList *l = master_keys.head; l; l = l->next)
+    {
+        GPasteMasterKey *master = l->data;
+
+        if (sodium_memcmp (master->passphrase_id, passphrase_id, sizeof (passphrase_id)) != 0)
+            continue;
+
+        g_variant_builder_add (&builder, "(@aytt@ay)",
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, master->salt, SALTBYTES, 1),
+                               master->opslimit,
+                               master->memlimit,
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, master->key, KEYBYTES, 1));
+        any = TRUE;
+    }
+
+    return (any) ? g_variant_ref_sink (g_variant_builder_end (&builder)) : NULL;
+}
+
+/**
+ * g_paste_secret_stream_converter_import_keys:
+ * @passphrase: the passphrase @keys were derived from
+ * @keys: what g_paste_secret_stream_converter_export_keys() returned
+ *
+ * Seed the master key cache with @keys, so the streams of @passphrase open
+ * without running Argon2id. Nothing here checks the keys against @passphrase:
+ * only hand in what a predecessor that did derive them exported, and verify
+ * the passphrase against the store before trusting it (that check is what the
+ * imported keys then make cheap).
+ */
+G_PASTE_VISIBLE void
+g_paste_secret_stream_converter_import_keys (const gchar *passphrase,
+                                             GVariant    *keys)
+{
+    g_return_if_fail (passphrase);
+    g_return_if_fail (g_variant_is_of_type (keys, G_VARIANT_TYPE ("a(ayttay)")));
+
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&master_keys_lock);
+    guchar passphrase_id[crypto_generichash_BYTES];
+    GVariantIter iter;
+    GVariant *salt, *key;
+    guint64 opslimit, memlimit;
+
+    master_key_id (passphrase, strlen (passphrase), passphrase_id);
+    g_variant_iter_init (&iter, keys);
+
+    while (g_variant_iter_next (&iter, "(@aytt@ay)", &salt, &opslimit, &memlimit, &key))
+    {
+        gsize salt_len, key_len;
+        const guchar *salt_data = g_variant_get_fixed_array (salt, &salt_len, 1);
+        const guchar *key_data = g_variant_get_fixed_array (key, &key_len, 1);
+
+        if (salt_len == SALTBYTES && key_len == KEYBYTES && master_keys.length < MAX_MASTER_KEYS)
+        {
+            GPasteMasterKey *master = gcr_secure_memory_alloc (sizeof (GPasteMasterKey));
+
+            memcpy (master->passphrase_id, passphrase_id, sizeof (passphrase_id));
+            memcpy (master->salt, salt_data, SALTBYTES);
+            master->opslimit = opslimit;
+            master->memlimit = memlimit;
+            memcpy (master->key, key_data, KEYBYTES);
+
+            /* The exported order is the most recently used first. */
+            g_queue_push_tail (&master_keys, master);
+        }
+
+        g_variant_unref (salt);
+        g_variant_unref (key);
+    }
+}
+
+/* --- key checks --- */
+
+/* A key check: the salt and Argon2 parameters of a master key, and a keyed
+ * hash of a fixed string under it. It tells whether a passphrase is the one a
+ * store was written with for the price of one derivation, whatever the number
+ * of streams, and reveals no more than any of those streams' headers would:
+ * checking a guess against it costs the same Argon2id run.
+ *
+ *   "GPSTKEY1" (8)  salt (16)  opslimit (u64 LE)  memlimit (u64 LE)  verifier (32) */
+
+#define KEY_CHECK_MAGIC   "GPSTKEY1"
+#define KEY_CHECK_CONTEXT "GPaste key check"
+#define KEY_CHECK_LEN     (G_PASTE_SECRET_STREAM_MAGIC_LEN + SALTBYTES + 8 + 8 + crypto_generichash_BYTES)
+
+static void
+key_check_verifier (const guchar *master,
+                    guchar       *verifier)
+{
+    crypto_generichash (verifier, crypto_generichash_BYTES,
+                        (const guchar *) KEY_CHECK_CONTEXT, strlen (KEY_CHECK_CONTEXT),
+                        master, KEYBYTES);
+}
+
+static gboolean
+key_check_init (GError **error)
+{
+    if (sodium_init () < 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Could not initialise libsodium");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * g_paste_secret_stream_key_check_new:
+ * @passphrase: the passphrase to make a key check for
+ * @error: return location for a #GError, or %NULL
+ *
+ * Make a key check for @passphrase, under the master key the streams encrypted
+ * from now on in this session will use, so that verifying it later primes the
+ * key for reading them back too.
+ *
+ * Returns: (transfer full) (nullable): the key check, or %NULL if the key
+ *          could not be derived
+ */
+G_PASTE_VISIBLE GBytes *
+g_paste_secret_stream_key_check_new (const gchar *passphrase,
+                                     GError     **error)
+{
+    g_return_val_if_fail (passphrase && *passphrase, NULL);
+
+    if (!key_check_init (error))
+        return NULL;
+
+    guchar *master = gcr_secure_memory_alloc (KEYBYTES);
+    guchar salt[SALTBYTES];
+    guchar verifier[crypto_generichash_BYTES];
+
+    if (!master_key_get (passphrase, strlen (passphrase), NULL, OPSLIMIT, MEMLIMIT, salt, master, error))
+    {
+        gcr_secure_memory_free (master);
+        return NULL;
+    }
+
+    key_check_verifier (master, verifier);
+    gcr_secure_memory_free (master);
+
+    GByteArray *check = g_byte_array_sized_new (KEY_CHECK_LEN);
+
+    g_byte_array_append (check, (const guint8 *) KEY_CHECK_MAGIC, G_PASTE_SECRET_STREAM_MAGIC_LEN);
+    g_byte_array_append (check, salt, sizeof (salt));
+    append_u64_le (check, OPSLIMIT);
+    append_u64_le (check, MEMLIMIT);
+    g_byte_array_append (check, verifier, sizeof (verifier));
+
+    return g_byte_array_free_to_bytes (check);
+}
+
+/**
+ * g_paste_secret_stream_key_check_match:
+ * @passphrase: the passphrase to check
+ * @check: a key check made by g_paste_secret_stream_key_check_new()
+ * @matches: (out): whether @check was made for @passphrase
+ * @error: return location for a #GError, or %NULL
+ *
+ * Check @passphrase against @check. The master key it derives stays in the
+ * session's cache, so the streams written along with @check open without
+ * another derivation.
+ *
+ * Fails with %G_IO_ERROR_INVALID_DATA when @check is not a key check, or asks
+ * for unreasonable parameters (see g_paste_crypto_derive_key()): a check that
+ * cannot be trusted says nothing either way.
+ *
+ * Returns: whether @matches was set
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_secret_stream_key_check_match (const gchar *passphrase,
+                                       GBytes      *check,
+                                       gboolean    *matches,
+                                       GError     **error)
+{
+    g_return_val_if_fail (passphrase && *passphrase, FALSE);
+    g_return_val_if_fail (check, FALSE);
+    g_return_val_if_fail (matches, FALSE);
+
+    *matches = FALSE;
+
+    if (!key_check_init (error))
+        return FALSE;
+
+    gsize length = 0;
+    const guint8 *data = g_bytes_get_data (check, &length);
+
+    if (length != KEY_CHECK_LEN || memcmp (data, KEY_CHECK_MAGIC, G_PASTE_SECRET_STREAM_MAGIC_LEN) != 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "Not a GPaste key check");
+        return FALSE;
+    }
+
+    const guchar *salt = data + G_PASTE_SECRET_STREAM_MAGIC_LEN;
+    guint64 opslimit = read_u64_le (salt + SALTBYTES);
+    guint64 memlimit = read_u64_le (salt + SALTBYTES + 8);
+    const guchar *verifier = salt + SALTBYTES + 16;
+    guchar *master = gcr_secure_memory_alloc (KEYBYTES);
+    guchar salt_out[SALTBYTES];
+    guchar expected[crypto_generichash_BYTES];
+
+    if (!master_key_get (passphrase, strlen (passphrase), salt, opslimit, memlimit, salt_out, master, error))
+    {
+        gcr_secure_memory_free (master);
+        return FALSE;
+    }
+
+    key_check_verifier (master, expected);
+    gcr_secure_memory_free (master);
+
+    *matches = (sodium_memcmp (expected, verifier, sizeof (expected)) == 0);
+
+    return TRUE;
+}
+
+/* Turn the master key in self->key into the key of the stream @nonce belongs
+ * to, in place. */
+static void
+derive_subkey (GPasteSecretStreamConverter *self,
+               const gchar                 *context,
+               const unsigned char         *nonce)
+{
+    crypto_generichash_state state;
+
+    crypto_generichash_init (&state, self->key, KEYBYTES, KEYBYTES);
+    crypto_generichash_update (&state, (const guchar *) context, strlen (context));
+    crypto_generichash_update (&state, nonce, NONCEBYTES);
+    crypto_generichash_final (&state, self->key, KEYBYTES);
+    sodium_memzero (&state, sizeof (state));
+}
+
+static gboolean
+derive_stream_key (GPasteSecretStreamConverter *self,
+                   const gchar                 *context,
+                   const unsigned char         *salt,
+                   guint64                      opslimit,
+                   guint64                      memlimit,
+                   const unsigned char         *nonce,
+                   unsigned char               *salt_out,
+                   GError                     **error)
+{
+    if (!master_key_get ((const gchar *) self->passphrase, self->passphrase_len,
+                         salt, opslimit, memlimit,
+                         salt_out, self->key, error))
+        return FALSE;
+
+    derive_subkey (self, context, nonce);
+
+    return TRUE;
+}
+
+/* --- segments --- */
+
+typedef struct _GPasteSecretSegmentBatch GPasteSecretSegmentBatch;
+
+/* One segment to seal or open: @src is @src_len bytes of input, @dst has room
+ * for what it becomes. */
+typedef struct
+{
+    GPasteSecretSegmentBatch *batch;
+    const guint8             *src;
+    gsize                     src_len;
+    guint8                   *dst;
+    guint64                   index;
+    gboolean                  ok;
+} GPasteSecretSegment;
+
+struct _GPasteSecretSegmentBatch
+{
+    GMutex        lock;
+    GCond         done;
+    guint         pending;
+    gboolean      seal;
+    const guchar *key;
+};
+
+/* The nonce and associated data of block @index: the index, so segments cannot
+ * be moved around, and the @kind, so the manifest cannot pass for a segment. */
+static void
+segment_nonce (guint64        index,
+               guint8         kind,
+               unsigned char *npub,
+               unsigned char *ad)
+{
+    guint64 le = GUINT64_TO_LE (index);
+
+    memset (npub, 0, SEGMENT_NPUBBYTES);
+    memcpy (npub, &le, sizeof (le));
+    memcpy (ad, &le, sizeof (le));
+    ad[sizeof (le)] = kind;
+}
+
+static gboolean
+segment_run (GPasteSecretSegment *segment,
+             gboolean             seal,
+             const guchar        *key)
+{
+    unsigned char npub[SEGMENT_NPUBBYTES];
+    unsigned char ad[9];
+
+    segment_nonce (segment->index, SEGMENT_KIND_DATA, npub, ad);
+
+    if (seal)
+    {
+        crypto_aead_xchacha20poly1305_ietf_encrypt (segment->dst, NULL,
+                                                    segment->src, segment->src_len,
+                                                    ad, sizeof (ad), NULL, npub, key);
+        return TRUE;
+    }
+
+    return crypto_aead_xchacha20poly1305_ietf_decrypt (segment->dst, NULL, NULL,
+                                                       segment->src, segment->src_len,
+                                                       ad, sizeof (ad), npub, key) == 0;
+}
+
+static void
+segment_work (gpointer data,
+              gpointer user_data G_GNUC_UNUSED)
+{
+    GPasteSecretSegment *segment = data;
+    GPasteSecretSegmentBatch *batch = segment->batch;
+
+    segment->ok = segment_run (segment, batch->seal, batch->key);
+
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&batch->lock);
+
+    if (!--batch->pending)
+        g_cond_signal (&batch->done);
+}
+
+/* Shared by every converter: there is no point in more threads than cores,
+ * however many streams are busy at once. */
+static GThreadPool *
+segment_pool (void)
+{
+    static GThreadPool *pool = NULL;
+
+    if (g_once_init_enter_pointer (&pool))
+        g_once_init_leave_pointer (&pool, g_thread_pool_new (segment_work, NULL, (gint) g_get_num_processors (), FALSE, NULL));
+
+    return pool;
+}
+
+/* How many segments to process at once: enough to keep every core busy. */
+static guint
+segment_batch_size (void)
+{
+    return CLAMP (g_get_num_processors (), 1, MAX_SEGMENT_BATCH);
+}
+
+/* Seal or open @n segments, the first one on the calling thread and the others
+ * on the pool, and wait for all of them. */
+static gboolean
+segments_run (GPasteSecretSegment *segments,
+              guint                n,
+              gboolean             seal,
+              const guchar        *key)
+{
+    if (n == 1)
+        return segment_run (segments, seal, key);
+
+    GPasteSecretSegmentBatch batch = { .pending = n - 1, .seal = seal, .key = key };
+    GThreadPool *pool = segment_pool ();
+    gboolean ok;
+
+    g_mutex_init (&batch.lock);
+    g_cond_init (&batch.done);
+
+    for (guint i = 1; i < n; ++i)
+    {
+        segments[i].batch = &batch;
+        g_thread_pool_push (pool, &segments[i], NULL);
+    }
+
+    ok = segment_run (segments, seal, key);
+
+    g_mutex_lock (&batch.lock);
+    while (batch.pending)
+        g_cond_wait (&batch.done, &batch.lock);
+    g_mutex_unlock (&batch.lock);
+
+    g_mutex_clear (&batch.lock);
+    g_cond_clear (&batch.done);
+
+    for (guint i = 1; i < n; ++i)
+        ok &= segments[i].ok;
+
+    return ok;
+}
+
+static gboolean
+encrypt_segments (GPasteSecretStreamConverter *self,
+                  gboolean                     flush,
+                  gboolean                     at_end)
+{
+    guint batch = segment_batch_size ();
+    gsize consumed = 0;
+
+    /* Seal a whole batch of full segments at a time, so that each one keeps
+     * every core busy; a flush or the end of the input takes whatever is there,
+     * the last segment being short. */
+    while (self->in->len > consumed &&
+           (flush || at_end || self->in->len - consumed >= (gsize) batch * self->segment_size))
+    {
+        GPasteSecretSegment segments[MAX_SEGMENT_BATCH] = { 0 };
+        gsize offset = consumed;
+        gsize out_len = 0;
+        guint n = 0;
+
+        for (; n < batch && offset < self->in->len; ++n)
+        {
+            gsize len = MIN (self->segment_size, self->in->len - offset);
+
+            segments[n].src = self->in->data + offset;
+            segments[n].src_len = len;
+            segments[n].index = self->segment_index + n;
+            offset += len;
+            out_len += 4 + len + SEGMENT_ABYTES;
+        }
+
+        /* Size the output first, so that every segment gets a slice of it to
+         * write into and the pool never touches anything shared. */
+        gsize pos = self->out->len;
+
+        g_byte_array_set_size (self->out, pos + out_len);
+        for (guint i = 0; i < n; ++i)
+        {
+            guint32 clen = GUINT32_TO_LE ((guint32) (segments[i].src_len + SEGMENT_ABYTES));
+
+            memcpy (self->out->data + pos, &clen, sizeof (clen));
+            segments[i].dst = self->out->data + pos + 4;
+            pos += 4 + segments[i].src_len + SEGMENT_ABYTES;
+        }
+
+        segments_run (segments, n, TRUE, self->key);
+
+        self->segment_index += n;
+        self->plain_len += offset - consumed;
+        consumed = offset;
+    }
+
+    if (consumed)
+        g_byte_array_remove_range (self->in, 0, consumed);
+
+    if (at_end && !self->finished)
+    {
+        unsigned char npub[SEGMENT_NPUBBYTES];
+        unsigned char ad[9];
+        guint8 manifest[16];
+        guint64 count = GUINT64_TO_LE (self->segment_index);
+        guint64 len = GUINT64_TO_LE (self->plain_len);
+
+        memcpy (manifest, &count, 8);
+        memcpy (manifest + 8, &len, 8);
+        segment_nonce (self->segment_index, SEGMENT_KIND_MANIFEST, npub, ad);
+
+        append_u32_le (self->out, MANIFEST_MARKER);
+
+        gsize pos = self->out->len;
+
+        g_byte_array_set_size (self->out, pos + MANIFEST_LEN);
+        crypto_aead_xchacha20poly1305_ietf_encrypt (self->out->data + pos, NULL,
+                                                    manifest, sizeof (manifest),
+                                                    ad, sizeof (ad), NULL, npub, self->key);
+        self->finished = TRUE;
+    }
+
+    return TRUE;
+}
+
+/* Check the manifest in @frame against what was read. */
+static gboolean
+decrypt_manifest (GPasteSecretStreamConverter *self,
+                  const guint8                *frame,
+                  GError                     **error)
+{
+    unsigned char npub[SEGMENT_NPUBBYTES];
+    unsigned char ad[9];
+    guint8 manifest[16];
+
+    segment_nonce (self->segment_index, SEGMENT_KIND_MANIFEST, npub, ad);
+
+    if (crypto_aead_xchacha20poly1305_ietf_decrypt (manifest, NULL, NULL,
+                                                    frame + 4, MANIFEST_LEN,
+                                                    ad, sizeof (ad), npub, self->key) != 0 ||
+        read_u64_le (manifest) != self->segment_index ||
+        read_u64_le (manifest + 8) != self->plain_len)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "Truncated or corrupted encrypted stream");
+        return FALSE;
+    }
+
+    self->finished = TRUE;
+
+    return TRUE;
+}
+
+static gboolean
+decrypt_segments (GPasteSecretStreamConverter *self,
+                  gboolean                     at_end,
+                  GError                     **error)
+{
+    guint batch = segment_batch_size ();
+    gsize consumed = 0;
+
+    while (!self->finished)
+    {
+        GPasteSecretSegment segments[MAX_SEGMENT_BATCH] = { 0 };
+        gboolean manifest = FALSE;
+        gsize offset = consumed;
+        gsize out_len = 0;
+        guint n = 0;
+
+        while (n < batch && self->in->len - offset >= 4)
+        {
+            guint32 clen = read_u32_le (self->in->data + offset);
+
+            if (clen == MANIFEST_MARKER)
+            {
+                manifest = TRUE;
+                break;
+            }
+
+            if (clen < SEGMENT_ABYTES || clen > self->segment_size + SEGMENT_ABYTES)
+            {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "Corrupted encrypted stream");
+                return FALSE;
+            }
+
+            if (self->in->len - offset < (gsize) 4 + clen)
+                break; /* need the rest of the frame */
+
+            segments[n].src = self->in->data + offset + 4;
+            segments[n].src_len = clen;
+            segments[n].index = self->segment_index + n;
+            offset += 4 + clen;
+            out_len += clen - SEGMENT_ABYTES;
+            ++n;
+        }
+
+        /* Like encryption, wait for a whole batch unless there is no more
+         * to wait for. */
+        if (!n || (n < batch && !manifest && !at_end))
+        {
+            if (manifest && self->in->len - consumed >= 4 + MANIFEST_LEN)
+            {
+                if (!decrypt_manifest (self, self->in->data + consumed, error))
+                    return FALSE;
+                consumed += 4 + MANIFEST_LEN;
+            }
+            break;
+        }
+
+        gsize pos = self->out->len;
+
+        g_byte_array_set_size (self->out, pos + out_len);
+        for (guint i = 0; i < n; ++i)
+        {
+            segments[i].dst = self->out->data + pos;
+            pos += segments[i].src_len - SEGMENT_ABYTES;
+        }
+
+        if (!segments_run (segments, n, FALSE, self->key))
+        {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                 "Could not decrypt the stream (wrong passphrase or corrupted data)");
+            return FALSE;
+        }
+
+        self->segment_index += n;
+        self->plain_len += out_len;
+        consumed = offset;
+    }
+
+    if (consumed)
+        g_byte_array_remove_range (self->in, 0, consumed);
+
+    return TRUE;
+}
+
 static gboolean
 encrypt_process (GPasteSecretStreamConverter *self,
                  gboolean                     flush,
@@ -206,89 +1014,165 @@ encrypt_process (GPasteSecretStreamConverter *self,
     if (!self->header_done)
     {
         unsigned char salt[SALTBYTES];
+        unsigned char nonce[NONCEBYTES];
         unsigned char header[HEADERBYTES];
         guint64 opslimit = OPSLIMIT;
         guint64 memlimit = MEMLIMIT;
 
-        randombytes_buf (salt, sizeof (salt));
+        randombytes_buf (nonce, sizeof (nonce));
 
-        if (!derive_key (self, salt, opslimit, memlimit, error))
+        self->segmented = (self->format == G_PASTE_SECRET_STREAM_FORMAT_SEGMENTED);
+        if (!derive_stream_key (self, self->segmented ? SEGMENTED_SUBKEY_CONTEXT : SUBKEY_CONTEXT,
+                                NULL, opslimit, memlimit, nonce, salt, error))
             return FALSE;
 
-        crypto_secretstream_xchacha20poly1305_init_push (&self->state, header, self->key);
-
-        g_byte_array_append (self->out, (const guint8 *) G_PASTE_SECRET_STREAM_MAGIC, G_PASTE_SECRET_STREAM_MAGIC_LEN);
+        g_byte_array_append (self->out, (const guint8 *) (self->segmented ? G_PASTE_SECRET_STREAM_MAGIC_V3 : G_PASTE_SECRET_STREAM_MAGIC_V2),
+                             G_PASTE_SECRET_STREAM_MAGIC_LEN);
         g_byte_array_append (self->out, salt, sizeof (salt));
         append_u64_le (self->out, opslimit);
         append_u64_le (self->out, memlimit);
-        g_byte_array_append (self->out, header, sizeof (header));
+        g_byte_array_append (self->out, nonce, sizeof (nonce));
+
+        if (self->segmented)
+        {
+            self->segment_size = SEGMENT_SIZE;
+            append_u32_le (self->out, self->segment_size);
+        }
+        else
+        {
+            crypto_secretstream_xchacha20poly1305_init_push (&self->state, header, self->key);
+            g_byte_array_append (self->out, header, sizeof (header));
+        }
 
         self->header_done = TRUE;
     }
 
+    if (self->segmented)
+        return encrypt_segments (self, flush, at_end);
+
+    gsize consumed = 0;
+
     /* Emit full chunks while strictly more than a chunk is buffered, so the
      * trailing bytes are available to become the FINAL chunk at end. */
-    while (self->in->len > CHUNK_SIZE)
-        push_chunk (self, CHUNK_SIZE, TAG_MESSAGE);
+    while (self->in->len - consumed > CHUNK_SIZE)
+        consumed = push_chunk (self, consumed, CHUNK_SIZE, TAG_MESSAGE);
 
     /* On an explicit flush, also emit the buffered partial chunk so all the input
      * we were handed reaches the base stream (the GConverter flush contract); a
      * later write simply continues the stream and at_end still emits FINAL. */
-    if (flush && !at_end && self->in->len)
-        push_chunk (self, self->in->len, TAG_MESSAGE);
+    if (flush && !at_end && self->in->len > consumed)
+        consumed = push_chunk (self, consumed, self->in->len - consumed, TAG_MESSAGE);
 
     if (at_end && !self->finished)
     {
-        push_chunk (self, self->in->len, TAG_FINAL);
+        consumed = push_chunk (self, consumed, self->in->len - consumed, TAG_FINAL);
         self->finished = TRUE;
     }
 
+    if (consumed)
+        g_byte_array_remove_range (self->in, 0, consumed);
+
     return TRUE;
 }
 
 static gboolean
 decrypt_process (GPasteSecretStreamConverter *self,
-                 gboolean                     at_end G_GNUC_UNUSED,
+                 gboolean                     at_end,
                  GError                     **error)
 {
     if (!self->header_done)
     {
-        if (self->in->len < STREAM_HEADER_LEN)
+        if (self->in->len < G_PASTE_SECRET_STREAM_MAGIC_LEN)
             return TRUE; /* need more input */
 
         const guint8 *data = self->in->data;
+        guint version;
+        gsize header_len;
 
-        if (memcmp (data, G_PASTE_SECRET_STREAM_MAGIC, G_PASTE_SECRET_STREAM_MAGIC_LEN) != 0)
+        if (memcmp (data, G_PASTE_SECRET_STREAM_MAGIC_V3, G_PASTE_SECRET_STREAM_MAGIC_LEN) == 0)
+        {
+            version = 3;
+            header_len = STREAM_HEADER_V3_LEN;
+        }
+        else if (memcmp (data, G_PASTE_SECRET_STREAM_MAGIC_V2, G_PASTE_SECRET_STREAM_MAGIC_LEN) == 0)
+        {
+            version = 2;
+            header_len = STREAM_HEADER_V2_LEN;
+        }
+        else if (memcmp (data, G_PASTE_SECRET_STREAM_MAGIC_V1, G_PASTE_SECRET_STREAM_MAGIC_LEN) == 0)
+        {
+            version = 1;
+            header_len = STREAM_HEADER_V1_LEN;
+        }
+        else
         {
             g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
                                  "Not a GPaste encrypted stream");
             return FALSE;
         }
 
+        if (self->in->len < header_len)
+            return TRUE; /* need more input */
+
         const unsigned char *salt = data + G_PASTE_SECRET_STREAM_MAGIC_LEN;
         guint64 opslimit = read_u64_le (salt + SALTBYTES);
         guint64 memlimit = read_u64_le (salt + SALTBYTES + 8);
         const unsigned char *header = salt + SALTBYTES + 16;
 
-        /* derive_key() is what refuses the parameters this untrusted header asks
-         * for; see g_paste_crypto_derive_key(). */
-        if (!derive_key (self, salt, opslimit, memlimit, error))
+        /* g_paste_crypto_derive_key() is what refuses the parameters this
+         * untrusted header asks for, whichever way we get to it. */
+        if (version == 3)
+        {
+            unsigned char salt_out[SALTBYTES];
+            const unsigned char *nonce = header;
+
+            self->segment_size = read_u32_le (nonce + NONCEBYTES);
+            /* The header is untrusted too: the size decides how much we buffer. */
+            if (!self->segment_size || self->segment_size > MAX_SEGMENT_SIZE)
+            {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                     "Corrupted encryption header");
+                return FALSE;
+            }
+
+            if (!derive_stream_key (self, SEGMENTED_SUBKEY_CONTEXT, salt, opslimit, memlimit, nonce, salt_out, error))
+                return FALSE;
+
+            self->segmented = TRUE;
+        }
+        else if (version == 2)
+        {
+            unsigned char salt_out[SALTBYTES];
+            const unsigned char *nonce = header;
+
+            header += NONCEBYTES;
+            if (!derive_stream_key (self, SUBKEY_CONTEXT, salt, opslimit, memlimit, nonce, salt_out, error))
+                return FALSE;
+        }
+        else if (!derive_key (self, salt, opslimit, memlimit, error))
             return FALSE;
 
-        if (crypto_secretstream_xchacha20poly1305_init_pull (&self->state, header, self->key) != 0)
+        if (!self->segmented && crypto_secretstream_xchacha20poly1305_init_pull (&self->state, header, self->key) != 0)
         {
             g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
                                  "Corrupted encryption header");
             return FALSE;
         }
 
-        g_byte_array_remove_range (self->in, 0, STREAM_HEADER_LEN);
+        g_byte_array_remove_range (self->in, 0, header_len);
         self->header_done = TRUE;
     }
 
-    while (!self->finished && self->in->len >= 4)
+    if (self->segmented)
+        return decrypt_segments (self, at_end, error);
+
+    gsize consumed = 0;
+
+    /* As when encrypting, the input is dropped once, after the last frame. */
+    while (!self->finished && self->in->len - consumed >= 4)
     {
-        guint32 clen = read_u32_le (self->in->data);
+        const guint8 *frame = self->in->data + consumed;
+        guint32 clen = read_u32_le (frame);
 
         if (clen < ABYTES || clen > CHUNK_SIZE + ABYTES)
         {
@@ -297,7 +1181,7 @@ decrypt_process (GPasteSecretStreamConverter *self,
             return FALSE;
         }
 
-        if (self->in->len < (gsize) 4 + clen)
+        if (self->in->len - consumed < (gsize) 4 + clen)
             break; /* need the rest of the frame */
 
         unsigned char plain[CHUNK_SIZE];
@@ -305,7 +1189,7 @@ decrypt_process (GPasteSecretStreamConverter *self,
         unsigned char tag = 0;
 
         if (crypto_secretstream_xchacha20poly1305_pull (&self->state, plain, &mlen, &tag,
-                                                        self->in->data + 4, clen, NULL, 0) != 0)
+                                                        frame + 4, clen, NULL, 0) != 0)
         {
             g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
                                  "Could not decrypt the stream (wrong passphrase or corrupted data)");
@@ -313,15 +1197,37 @@ decrypt_process (GPasteSecretStreamConverter *self,
         }
 
         g_byte_array_append (self->out, plain, mlen);
-        g_byte_array_remove_range (self->in, 0, 4 + clen);
+        consumed += 4 + clen;
 
         if (tag == TAG_FINAL)
             self->finished = TRUE;
     }
 
+    if (consumed)
+        g_byte_array_remove_range (self->in, 0, consumed);
+
     return TRUE;
 }
 
+/* A batch of segments can leave megabytes of output behind, handed back a few
+ * kilobytes at a time: moving what is left to the front after every read would
+ * make draining it quadratic, so only drop what was read once it is all gone or
+ * it makes up more than half of the buffer. */
+static void
+g_paste_secret_stream_converter_compact_output (GPasteSecretStreamConverter *self)
+{
+    if (self->out_pos == self->out->len)
+    {
+        g_byte_array_set_size (self->out, 0);
+        self->out_pos = 0;
+    }
+    else if (self->out_pos > self->out->len / 2)
+    {
+        g_byte_array_remove_range (self->out, 0, self->out_pos);
+        self->out_pos = 0;
+    }
+}
+
 static GConverterResult
 g_paste_secret_stream_converter_convert (GConverter     *converter,
                                          const void     *inbuf,
@@ -356,25 +1262,29 @@ g_paste_secret_stream_converter_convert (GConverter     *converter,
         return G_CONVERTER_ERROR;
 
     /* Hand back as much produced output as fits. */
-    if (self->out->len && outbuf_size)
+    gsize pending = self->out->len - self->out_pos;
+
+    if (pending && outbuf_size)
     {
-        gsize n = MIN (self->out->len, outbuf_size);
+        gsize n = MIN (pending, outbuf_size);
 
-        memcpy (outbuf, self->out->data, n);
-        g_byte_array_remove_range (self->out, 0, n);
+        memcpy (outbuf, self->out->data + self->out_pos, n);
+        self->out_pos += n;
+        pending -= n;
         *bytes_written = n;
+        g_paste_secret_stream_converter_compact_output (self);
     }
 
-    if (self->finished && !self->out->len)
+    if (self->finished && !pending)
         return G_CONVERTER_FINISHED;
 
-    if ((flags & G_CONVERTER_FLUSH) && !self->out->len)
+    if ((flags & G_CONVERTER_FLUSH) && !pending)
         return G_CONVERTER_FLUSHED;
 
     if (!*bytes_read && !*bytes_written)
     {
         /* No progress: say why so the caller does not spin. */
-        if (self->out->len)
+        if (pending)
             g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
                                  "Not enough space in the output buffer");
         else
@@ -394,10 +1304,14 @@ g_paste_secret_stream_converter_reset (GConverter *converter)
 
     self->header_done = FALSE;
     self->finished = FALSE;
+    self->segmented = FALSE;
+    self->segment_index = 0;
+    self->plain_len = 0;
     sodium_memzero (self->key, KEYBYTES);
     sodium_memzero (&self->state, sizeof (self->state));
     g_byte_array_set_size (self->in, 0);
     g_byte_array_set_size (self->out, 0);
+    self->out_pos = 0;
 }
 
 static void
@@ -455,8 +1369,9 @@ g_paste_secret_stream_converter_init (GPasteSecretStreamConverter *self)
  * @passphrase: the passphrase the key is derived from
  *
  * Create a #GConverter that encrypts or decrypts a stream with libsodium's
- * secretstream (XChaCha20-Poly1305), deriving the key from @passphrase with
- * Argon2id. The same type handles both directions.
+ * secretstream (XChaCha20-Poly1305), keyed from @passphrase through Argon2id.
+ * The same type handles both directions; encryption writes the segmented
+ * format, decryption reads it as well as everything older versions wrote.
  *
  * Returns: (transfer full) (nullable): a newly allocated #GConverter,
  *          or %NULL if libsodium could not be initialised
@@ -464,6 +1379,28 @@ g_paste_secret_stream_converter_init (GPasteSecretStreamConverter *self)
 G_PASTE_VISIBLE GConverter *
 g_paste_secret_stream_converter_new (GPasteSecretStreamDirection direction,
                                      const gchar                *passphrase)
+{
+    return g_paste_secret_stream_converter_new_full (direction, passphrase, G_PASTE_SECRET_STREAM_FORMAT_SEGMENTED);
+}
+
+/**
+ * g_paste_secret_stream_converter_new_full:
+ * @direction: whether to encrypt or decrypt
+ * @passphrase: the passphrase the key is derived from
+ * @format: the format to write when encrypting
+ *
+ * Like g_paste_secret_stream_converter_new(), but encryption writes @format:
+ * %G_PASTE_SECRET_STREAM_FORMAT_SEQUENTIAL is the single secretstream the
+ * previous version wrote, for whatever still has to read it. Decryption
+ * ignores @format and goes by the stream's header.
+ *
+ * Returns: (transfer full) (nullable): a newly allocated #GConverter,
+ *          or %NULL if libsodium could not be initialised
+ */
+G_PASTE_VISIBLE GConverter *
+g_paste_secret_stream_converter_new_full (GPasteSecretStreamDirection direction,
+                                          const gchar                *passphrase,
+                                          GPasteSecretStreamFormat    format)
 {
     g_return_val_if_fail (passphrase && *passphrase, NULL);
 
@@ -476,6 +1413,7 @@ g_paste_secret_stream_converter_new (GPasteSecretStreamDirection direction,
     GPasteSecretStreamConverter *self = g_object_new (G_PASTE_TYPE_SECRET_STREAM_CONVERTER, NULL);
 
     self->direction = direction;
+    self->format = format;
     self->passphrase_len = strlen (passphrase);
     self->passphrase = (guchar *) gcr_secure_memory_strdup (passphrase);
 
@@ -15,12 +15,33 @@ typedef enum
     G_PASTE_SECRET_STREAM_DECRYPT,
 } GPasteSecretStreamDirection;
 
+typedef enum
+{
+    G_PASTE_SECRET_STREAM_FORMAT_SEGMENTED,
+    G_PASTE_SECRET_STREAM_FORMAT_SEQUENTIAL,
+} GPasteSecretStreamFormat;
+
 #define G_PASTE_TYPE_SECRET_STREAM_CONVERTER (g_paste_secret_stream_converter_get_type ())
 
 G_PASTE_FINAL_TYPE (SecretStreamConverter, secret_stream_converter, SECRET_STREAM_CONVERTER, GObject)
 
 GConverter *g_paste_secret_stream_converter_new (GPasteSecretStreamDirection  direction,
                                                  const gchar                 *passphrase);
+GConverter *g_paste_secret_stream_converter_new_full (GPasteSecretStreamDirection  direction,
+                                                      const gchar                 *passphrase,
+                                                      GPasteSecretStreamFormat     format);
+
+void        g_paste_secret_stream_converter_forget_keys (void);
+GVariant   *g_paste_secret_stream_converter_export_keys (const gchar *passphrase);
+void        g_paste_secret_stream_converter_import_keys (const gchar *passphrase,
+                                                         GVariant    *keys);
+
+GBytes     *g_paste_secret_stream_key_check_new   (const gchar *passphrase,
+                                                   GError     **error);
+gboolean    g_paste_secret_stream_key_check_match (const gchar *passphrase,
+                                                   GBytes      *check,
+                                                   gboolean    *matches,
+                                                   GError     **error);
 
 gboolean g_paste_crypto_derive_key (const gchar   *passphrase,
                                     gsize          passphrase_len,
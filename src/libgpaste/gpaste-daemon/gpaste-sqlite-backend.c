@@ -9,6 +9,7 @@
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-password-item.h>
 #include <gpaste-daemon/gpaste-sqlite-backend.h>
+#include <gpaste-daemon/gpaste-storage-compression.h>
 #include <gpaste-daemon/gpaste-text-item.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
 
@@ -28,13 +29,36 @@
  * the incremental vfuncs, so the saver feeds it per-operation changes instead
  * of full snapshots.
  *
+ * With the "sqlite-single-database" setting, every history lives in one
+ * database instead (histories.sqlite, see
+ * g_paste_sqlite_backend_get_single_database_path()): switching history is then a different `history_id` in the same statements,
+ * and the connection, its WAL and the encrypted flavor's key stay warm for the
+ * backend's whole life rather than being reopened — and the key re-derived —
+ * on every switch. Listing, counting, copying and deleting a history are
+ * queries. The setting is read once per backend; whichever layout it picks
+ * takes over the histories the other one left behind on first use.
+ *
  * Items live in an `items` table ordered by a monotonic `rank` (highest =
  * front of the history, so adds and selects never renumber anything), with
- * their extra MIME payloads in a `special_values` child table. The schema is
+ * their extra MIME payloads in a `special_values` child table. Each row names
+ * its history in `history_id`: a row of the `histories` table in the single
+ * database, always 1 in a per-history one (whose `histories` table stays
+ * empty, the file being the history). The schema is
  * versioned through PRAGMA user_version so it can evolve: older databases are
  * migrated stepwise on open, newer ones are refused (every operation then
  * no-ops) rather than corrupted.
  *
+ * The plain flavor also keeps a full-text (FTS5 trigram) index of the items'
+ * values when SQLite has one to offer, so a literal search -- in one history
+ * or across all of them -- is a query rather than a walk through the items.
+ *
+ * With the "storage-compression" setting, item values and special values
+ * worth it are stored compressed, the row's `compression` column saying how
+ * (0 for not at all), so a database can mix rows written under any setting.
+ * The full-text index sees through it: its triggers index the decompressed
+ * text, via the gpaste_text() SQL function every connection that writes
+ * registers.
+ *
  * Like the plain XML backend, password items are never persisted (the file is
  * user-readable). Images are stored as blobs in the `items.image` column, so an
  * item read back from here needs no file on disk; the item value remains its
@@ -54,12 +78,22 @@
  * metadata leak of row count/kind/rank/date/checksum for incremental
  * (non-rewriting) updates. */
 
-#define G_PASTE_SQLITE_SCHEMA_VERSION 2
+#define G_PASTE_SQLITE_SCHEMA_VERSION 4
+
+/* Every row of a per-history database belongs to its one history. */
+#define G_PASTE_SQLITE_OWN_HISTORY_ID 1
 
 /* Far beyond any reachable rank (one increment per add/select), but cheap to
  * guard against: past this, ranks are compacted back to 1..N on open. */
 #define G_PASTE_SQLITE_RANK_COMPACT_THRESHOLD (G_GINT64_CONSTANT (1) << 62)
 
+typedef enum
+{
+    G_PASTE_SQLITE_LAYOUT_UNSET,
+    G_PASTE_SQLITE_LAYOUT_PER_HISTORY,
+    G_PASTE_SQLITE_LAYOUT_SINGLE,
+} GPasteSqliteLayout;
+
 struct _GPasteSqliteBackend
 {
     GPasteStorageBackend parent_instance;
@@ -70,6 +104,21 @@ struct _GPasteSqliteBackend
     sqlite3 *db;
     gchar   *db_path;
     GMutex   lock;
+    /* Whether that database keeps the full-text index. */
+    gboolean searchable;
+
+    /* Settled from the settings on first use (they are only attached once the
+     * instance is built), so one backend never changes layout under a history
+     * it is serving; @adopted is whether it has taken over the other layout's
+     * leftovers yet. */
+    GPasteSqliteLayout layout;
+    gboolean           adopted;
+
+    /* The history the single database last resolved, so a history's id is
+     * looked up when switching to it rather than on every statement. Only valid
+     * along with the connection it was resolved on. */
+    gchar   *history_name;
+    gint64   history_id;
 
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     /* When set (in gcr secure memory), the content columns are encrypted, the
@@ -144,6 +193,33 @@ g_paste_sqlite_backend_query_int64 (sqlite3     *db,
     return value;
 }
 
+/* g_paste_sqlite_backend_query_int64() for a query about one history, its id
+ * bound as ?1. */
+static gint64
+g_paste_sqlite_backend_query_history_int64 (sqlite3     *db,
+                                            const gchar *sql,
+                                            gint64       history_id,
+                                            gint64       fallback)
+{
+    sqlite3_stmt *stmt = NULL;
+    gint64 value = fallback;
+
+    if (sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare “%s”: %s", sql, sqlite3_errmsg (db));
+        return fallback;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+        value = sqlite3_column_int64 (stmt, 0);
+
+    sqlite3_finalize (stmt);
+
+    return value;
+}
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 /*******************/
 /* Encrypted flavor */
@@ -233,18 +309,21 @@ g_paste_sqlite_backend_derive_key (const gchar  *passphrase,
     return FALSE;
 }
 
-/* Read the salt, Argon2 parameters and key-check blob from the meta table.
- * Quietly returns FALSE when they are absent (fresh database, or no meta table
- * at all), leaving it to the caller to decide what that means. */
+/* Read the salt, Argon2 parameters and key-check blob from the meta table,
+ * under their plain names or, with a "rekey_" @prefix, those of a re-key in
+ * progress. Quietly returns FALSE when they are absent (fresh database, or no
+ * meta table at all), leaving it to the caller to decide what that means. */
 static gboolean
-g_paste_sqlite_backend_load_crypto_params (sqlite3 *db,
-                                           guchar  *salt,
-                                           guint64 *opslimit,
-                                           guint64 *memlimit,
-                                           guchar **check,
-                                           gsize   *check_length)
+g_paste_sqlite_backend_load_crypto_params (sqlite3     *db,
+                                           const gchar *prefix,
+                                           guchar      *salt,
+                                           guint64     *opslimit,
+                                           guint64     *memlimit,
+                                           guchar     **check,
+                                           gsize       *check_length)
 {
     sqlite3_stmt *stmt = NULL;
+    gsize prefix_length = strlen (prefix);
 
     if (sqlite3_prepare_v2 (db, "SELECT key, value FROM meta;", -1, &stmt, NULL) != SQLITE_OK)
         return FALSE;
@@ -257,6 +336,11 @@ g_paste_sqlite_backend_load_crypto_params (sqlite3 *db,
     {
         const gchar *key = (const gchar *) sqlite3_column_text (stmt, 0);
 
+        if (!key || strncmp (key, prefix, prefix_length))
+            continue;
+
+        key += prefix_length;
+
         if (g_paste_str_equal (key, "salt") && sqlite3_column_bytes (stmt, 1) == crypto_pwhash_SALTBYTES)
         {
             memcpy (salt, sqlite3_column_blob (stmt, 1), crypto_pwhash_SALTBYTES);
@@ -297,21 +381,18 @@ g_paste_sqlite_backend_key_checks_out (const guchar *key,
 }
 
 /* Store a key check for @key, the salt it was derived from and the Argon2
- * parameters in the meta table, replacing any previous ones. Assumes a
- * transaction is already open, so a caller doing more than this (a re-key, which
- * must swap the parameters and re-encrypt the content as one unit) can share it. */
+ * parameters in the meta table under @prefix'd names, replacing the ones of
+ * the same names. Assumes a transaction is already open. */
 static gboolean
-g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
-                                            const guchar *salt,
-                                            guint64       opslimit,
-                                            guint64       memlimit,
-                                            const guchar *key)
+g_paste_sqlite_backend_insert_crypto_params (sqlite3      *db,
+                                             const gchar  *prefix,
+                                             const guchar *salt,
+                                             guint64       opslimit,
+                                             guint64       memlimit,
+                                             const guchar *key)
 {
-    if (!g_paste_sqlite_backend_exec (db, "DELETE FROM meta;"))
-        return FALSE;
-
     sqlite3_stmt *stmt = NULL;
-    gboolean success = (sqlite3_prepare_v2 (db, "INSERT INTO meta (key, value) VALUES (?, ?);", -1, &stmt, NULL) == SQLITE_OK);
+    gboolean success = (sqlite3_prepare_v2 (db, "INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?);", -1, &stmt, NULL) == SQLITE_OK);
 
     if (success)
     {
@@ -319,7 +400,7 @@ g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
         g_autofree guchar *check = g_paste_sqlite_backend_encrypt (key, G_PASTE_SQLITE_KEY_CHECK_MAGIC,
                                                                    strlen (G_PASTE_SQLITE_KEY_CHECK_MAGIC), &check_length);
 
-        sqlite3_bind_text (stmt, 1, "salt", -1, SQLITE_STATIC);
+        sqlite3_bind_text (stmt, 1, g_strconcat (prefix, "salt", NULL), -1, g_free);
         sqlite3_bind_blob64 (stmt, 2, salt, crypto_pwhash_SALTBYTES, SQLITE_STATIC);
         success = (sqlite3_step (stmt) == SQLITE_DONE);
         sqlite3_reset (stmt);
@@ -327,7 +408,7 @@ g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
 
         if (success)
         {
-            sqlite3_bind_text (stmt, 1, "opslimit", -1, SQLITE_STATIC);
+            sqlite3_bind_text (stmt, 1, g_strconcat (prefix, "opslimit", NULL), -1, g_free);
             sqlite3_bind_int64 (stmt, 2, opslimit);
             success = (sqlite3_step (stmt) == SQLITE_DONE);
             sqlite3_reset (stmt);
@@ -336,7 +417,7 @@ g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
 
         if (success)
         {
-            sqlite3_bind_text (stmt, 1, "memlimit", -1, SQLITE_STATIC);
+            sqlite3_bind_text (stmt, 1, g_strconcat (prefix, "memlimit", NULL), -1, g_free);
             sqlite3_bind_int64 (stmt, 2, memlimit);
             success = (sqlite3_step (stmt) == SQLITE_DONE);
             sqlite3_reset (stmt);
@@ -345,7 +426,7 @@ g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
 
         if (success)
         {
-            sqlite3_bind_text (stmt, 1, "check", -1, SQLITE_STATIC);
+            sqlite3_bind_text (stmt, 1, g_strconcat (prefix, "check", NULL), -1, g_free);
             sqlite3_bind_blob64 (stmt, 2, check, check_length, SQLITE_TRANSIENT);
             success = (sqlite3_step (stmt) == SQLITE_DONE);
         }
@@ -359,6 +440,21 @@ g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
     return success;
 }
 
+/* The parameters the database is encrypted with, replacing everything else in
+ * the meta table — a re-key in progress included. Assumes a transaction is
+ * already open, so a caller doing more than this (a re-key, which must swap the
+ * parameters and the content as one unit) can share it. */
+static gboolean
+g_paste_sqlite_backend_write_crypto_params (sqlite3      *db,
+                                            const guchar *salt,
+                                            guint64       opslimit,
+                                            guint64       memlimit,
+                                            const guchar *key)
+{
+    return g_paste_sqlite_backend_exec (db, "DELETE FROM meta;") &&
+           g_paste_sqlite_backend_insert_crypto_params (db, "", salt, opslimit, memlimit, key);
+}
+
 /* Generate a fresh salt and key check for @key and store them in their own
  * transaction: what preparing a database for a passphrase needs. */
 static gboolean
@@ -376,142 +472,580 @@ g_paste_sqlite_backend_store_crypto_params (sqlite3      *db,
                                                                                                   memlimit, key));
 }
 
-/* One collected content blob, waiting to be written back under the new key. */
-/* Re-encrypt one content column, row by row: @ids_sql lists the rowids holding
- * a value, then each is fetched through @select_sql, decrypted with @old_key and
- * written back through @update_sql (binding the new blob, then the rowid)
- * encrypted with @new_key. The rowids are taken first so no UPDATE ever runs
- * against the cursor that produced them, and only the rowids are held — one
- * value is in the clear at a time rather than the whole column, and it is wiped
- * as soon as it has been re-encrypted.
+/* A re-key re-encrypts the content in batches of at most this many rows and
+ * bytes: each batch is one short transaction — the daemon's own writes are
+ * never held off for long — and one checkpoint an interrupted re-key resumes
+ * from. */
+#define G_PASTE_SQLITE_REKEY_BATCH_ROWS  256
+#define G_PASTE_SQLITE_REKEY_BATCH_BYTES (8 << 20)
+
+/* The SQL below recognises a value by its nonce, the first 24 bytes of the
+ * stored blob: a fresh random one is drawn every time a value is written. */
+G_STATIC_ASSERT (crypto_secretbox_NONCEBYTES == 24);
+
+/* Every content column, as the statements a re-key drives. A column added to
+ * the schema that holds user content has to be listed here too, or a
+ * passphrase change would leave it behind, unreadable. Each one is known by
+ * its index in the `rekey` side table, hence the literal in its SQL:
  *
- * Assumes the caller's transaction is open. Gives up on anything short of a
- * complete pass: a value that does not decrypt means real corruption (the key
- * check passed), and a scan cut short — a busy database, an I/O error — must not
- * be mistaken for the end of the column, or the key check would be swapped while
- * part of it is still under the old key, which no passphrase would then open. */
+ * - @batch_sql lists (rowid, value) past a rowid, in rowid order, up to a limit;
+ * - @stale_sql lists those the side table has no current re-encryption of,
+ *   which is what was written since the batch that covered it, or after;
+ * - @update_sql binds a new value, then the rowid;
+ * - @apply_sql moves the side table's re-encryptions into place, for the
+ *   values that are still the ones they were made from;
+ * - @purge_sql drops the side table's re-encryptions of values that are gone,
+ *   or are no longer the ones they were made from. */
+static const struct
+{
+    const gchar *batch_sql;
+    const gchar *stale_sql;
+    const gchar *update_sql;
+    const gchar *apply_sql;
+    const gchar *purge_sql;
+} g_paste_sqlite_backend_content_columns[] = {
+    { "SELECT rowid, value FROM items WHERE rowid > ? ORDER BY rowid LIMIT ?;",
+      "SELECT rowid, value FROM items WHERE NOT EXISTS "
+      "(SELECT 1 FROM rekey WHERE col = 0 AND row = items.rowid AND nonce = substr (items.value, 1, 24));",
+      "UPDATE items SET value = ? WHERE rowid = ?;",
+      "UPDATE items SET value = rekey.blob FROM rekey "
+      "WHERE rekey.col = 0 AND rekey.row = items.rowid AND rekey.nonce = substr (items.value, 1, 24);",
+      "DELETE FROM rekey WHERE col = 0 AND NOT EXISTS "
+      "(SELECT 1 FROM items WHERE items.rowid = rekey.row AND substr (items.value, 1, 24) = rekey.nonce);" },
+    { "SELECT rowid, name FROM items WHERE rowid > ? AND name IS NOT NULL ORDER BY rowid LIMIT ?;",
+      "SELECT rowid, name FROM items WHERE name IS NOT NULL AND NOT EXISTS "
+      "(SELECT 1 FROM rekey WHERE col = 1 AND row = items.rowid AND nonce = substr (items.name, 1, 24));",
+      "UPDATE items SET name = ? WHERE rowid = ?;",
+      "UPDATE items SET name = rekey.blob FROM rekey "
+      "WHERE rekey.col = 1 AND rekey.row = items.rowid AND rekey.nonce = substr (items.name, 1, 24);",
+      "DELETE FROM rekey WHERE col = 1 AND NOT EXISTS "
+      "(SELECT 1 FROM items WHERE items.rowid = rekey.row AND substr (items.name, 1, 24) = rekey.nonce);" },
+    { "SELECT rowid, image FROM items WHERE rowid > ? AND image IS NOT NULL ORDER BY rowid LIMIT ?;",
+      "SELECT rowid, image FROM items WHERE image IS NOT NULL AND NOT EXISTS "
+      "(SELECT 1 FROM rekey WHERE col = 2 AND row = items.rowid AND nonce = substr (items.image, 1, 24));",
+      "UPDATE items SET image = ? WHERE rowid = ?;",
+      "UPDATE items SET image = rekey.blob FROM rekey "
+      "WHERE rekey.col = 2 AND rekey.row = items.rowid AND rekey.nonce = substr (items.image, 1, 24);",
+      "DELETE FROM rekey WHERE col = 2 AND NOT EXISTS "
+      "(SELECT 1 FROM items WHERE items.rowid = rekey.row AND substr (items.image, 1, 24) = rekey.nonce);" },
+    { "SELECT rowid, data FROM special_values WHERE rowid > ? ORDER BY rowid LIMIT ?;",
+      "SELECT rowid, data FROM special_values WHERE NOT EXISTS "
+      "(SELECT 1 FROM rekey WHERE col = 3 AND row = special_values.rowid AND nonce = substr (special_values.data, 1, 24));",
+      "UPDATE special_values SET data = ? WHERE rowid = ?;",
+      "UPDATE special_values SET data = rekey.blob FROM rekey "
+      "WHERE rekey.col = 3 AND rekey.row = special_values.rowid AND rekey.nonce = substr (special_values.data, 1, 24);",
+      "DELETE FROM rekey WHERE col = 3 AND NOT EXISTS "
+      "(SELECT 1 FROM special_values WHERE special_values.rowid = rekey.row AND substr (special_values.data, 1, 24) = rekey.nonce);" },
+};
+
+/* One stored value being re-encrypted: the blob as read, and what it becomes. */
+typedef struct
+{
+    gint64  rowid;
+    guchar *old;
+    gsize   old_length;
+    guchar *blob;
+    gsize   blob_length;
+} GPasteSqliteRekeyRow;
+
+static void
+g_paste_sqlite_backend_rekey_row_free (gpointer data)
+{
+    GPasteSqliteRekeyRow *row = data;
+
+    g_free (row->old);
+    g_free (row->blob);
+    g_free (row);
+}
+
+typedef struct _GPasteSqliteRekeyBatch GPasteSqliteRekeyBatch;
+
+/* A run of consecutive rows, re-encrypted by one thread. */
+typedef struct
+{
+    GPasteSqliteRekeyBatch *batch;
+    GPasteSqliteRekeyRow  **rows;
+    guint                   n_rows;
+    gboolean                ok;
+} GPasteSqliteRekeySlice;
+
+struct _GPasteSqliteRekeyBatch
+{
+    GMutex        lock;
+    GCond         done;
+    guint         pending;
+    const guchar *old_key;
+    const guchar *new_key;
+};
+
+/* Decrypt each row of @slice with @old_key and encrypt it again with @new_key.
+ * A value that does not decrypt means real corruption (the key check passed),
+ * and fails the whole re-key. */
 static gboolean
-g_paste_sqlite_backend_rekey_column (sqlite3      *db,
-                                     const guchar *old_key,
-                                     const guchar *new_key,
-                                     const gchar  *ids_sql,
-                                     const gchar  *select_sql,
-                                     const gchar  *update_sql)
+g_paste_sqlite_backend_rekey_slice_run (GPasteSqliteRekeySlice *slice,
+                                        const guchar           *old_key,
+                                        const guchar           *new_key)
 {
-    g_autoptr (GArray) rowids = g_array_new (FALSE, FALSE, sizeof (gint64));
-    sqlite3_stmt *stmt = NULL;
+    for (guint i = 0; i < slice->n_rows; ++i)
+    {
+        GPasteSqliteRekeyRow *row = slice->rows[i];
+        gsize length = 0;
+        g_autofree guchar *plain = g_paste_sqlite_backend_decrypt (old_key, row->old, row->old_length, &length);
+
+        if (!plain)
+        {
+            g_warning ("sqlite: a stored value did not decrypt; leaving the passphrase alone");
+            return FALSE;
+        }
+
+        row->blob = g_paste_sqlite_backend_encrypt (new_key, plain, length, &row->blob_length);
+
+        /* Item contents, passwords included: do not leave them behind in
+         * freed heap now that they are stored again. */
+        sodium_memzero (plain, length);
+    }
+
+    return TRUE;
+}
+
+static void
+g_paste_sqlite_backend_rekey_slice_work (gpointer data,
+                                         gpointer user_data G_GNUC_UNUSED)
+{
+    GPasteSqliteRekeySlice *slice = data;
+    GPasteSqliteRekeyBatch *batch = slice->batch;
+
+    slice->ok = g_paste_sqlite_backend_rekey_slice_run (slice, batch->old_key, batch->new_key);
+
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&batch->lock);
+
+    if (!--batch->pending)
+        g_cond_signal (&batch->done);
+}
+
+/* Shared by every backend: there is no point in more threads than cores,
+ * however many databases are being re-keyed. */
+static GThreadPool *
+g_paste_sqlite_backend_rekey_pool (void)
+{
+    static GThreadPool *pool = NULL;
 
-    if (sqlite3_prepare_v2 (db, ids_sql, -1, &stmt, NULL) != SQLITE_OK)
+    if (g_once_init_enter_pointer (&pool))
+        g_once_init_leave_pointer (&pool, g_thread_pool_new (g_paste_sqlite_backend_rekey_slice_work, NULL,
+                                                             (gint) g_get_num_processors (), FALSE, NULL));
+
+    return pool;
+}
+
+/* Re-encrypt @rows, split into one slice per core: the first on the calling
+ * thread, the others on the pool, waiting for all of them. Only the crypto
+ * runs in parallel; the caller writes the results back on its own. */
+static gboolean
+g_paste_sqlite_backend_rekey_rows (GPtrArray    *rows,
+                                   const guchar *old_key,
+                                   const guchar *new_key)
+{
+    guint n = CLAMP (g_get_num_processors (), 1, rows->len);
+    guint per_slice = (rows->len + n - 1) / n;
+    g_autofree GPasteSqliteRekeySlice *slices = g_new0 (GPasteSqliteRekeySlice, n);
+    GPasteSqliteRekeyBatch batch = { .old_key = old_key, .new_key = new_key };
+    GThreadPool *pool = g_paste_sqlite_backend_rekey_pool ();
+    gboolean ok;
+
+    n = 0;
+    for (guint start = 0; start < rows->len; start += per_slice, ++n)
     {
-        g_warning ("sqlite: failed to prepare \u201c%s\u201d: %s", ids_sql, sqlite3_errmsg (db));
-        return FALSE;
+        slices[n].batch = &batch;
+        slices[n].rows = (GPasteSqliteRekeyRow **) rows->pdata + start;
+        slices[n].n_rows = MIN (per_slice, rows->len - start);
     }
 
+    if (n == 1)
+        return g_paste_sqlite_backend_rekey_slice_run (slices, old_key, new_key);
+
+    batch.pending = n - 1;
+    g_mutex_init (&batch.lock);
+    g_cond_init (&batch.done);
+
+    for (guint i = 1; i < n; ++i)
+        g_thread_pool_push (pool, &slices[i], NULL);
+
+    ok = g_paste_sqlite_backend_rekey_slice_run (slices, old_key, new_key);
+
+    g_mutex_lock (&batch.lock);
+    while (batch.pending)
+        g_cond_wait (&batch.done, &batch.lock);
+    g_mutex_unlock (&batch.lock);
+
+    g_mutex_clear (&batch.lock);
+    g_cond_clear (&batch.done);
+
+    for (guint i = 1; i < n; ++i)
+        ok &= slices[i].ok;
+
+    return ok;
+}
+
+/* Collect the (rowid, value) rows @stmt produces into @rows, stopping short
+ * once they hold G_PASTE_SQLITE_REKEY_BATCH_BYTES when @bounded. A scan cut
+ * short by an error — a busy database, an I/O error — must not be mistaken for
+ * the end of the column, hence the failure. Finalizes @stmt. */
+static gboolean
+g_paste_sqlite_backend_rekey_collect (sqlite3      *db,
+                                      sqlite3_stmt *stmt,
+                                      gboolean      bounded,
+                                      GPtrArray    *rows)
+{
+    gsize bytes = 0;
     gint rc;
 
     while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
     {
-        gint64 rowid = sqlite3_column_int64 (stmt, 0);
+        GPasteSqliteRekeyRow *row = g_new0 (GPasteSqliteRekeyRow, 1);
+
+        row->rowid = sqlite3_column_int64 (stmt, 0);
+        row->old_length = sqlite3_column_bytes (stmt, 1);
+        row->old = g_memdup2 (sqlite3_column_blob (stmt, 1), row->old_length);
+        g_ptr_array_add (rows, row);
 
-        g_array_append_val (rowids, rowid);
+        bytes += row->old_length;
+
+        if (bounded && bytes >= G_PASTE_SQLITE_REKEY_BATCH_BYTES)
+        {
+            rc = SQLITE_DONE;
+            break;
+        }
     }
 
+    if (rc != SQLITE_DONE)
+        g_warning ("sqlite: could not read the values to re-encrypt: %s", sqlite3_errmsg (db));
+
     sqlite3_finalize (stmt);
 
-    if (rc != SQLITE_DONE)
+    return rc == SQLITE_DONE;
+}
+
+/* Record how far the re-key got: every value of the columns before @column,
+ * and those of @column up to @rowid, have their re-encryption in the side
+ * table. Assumes the caller's transaction is open. */
+static gboolean
+g_paste_sqlite_backend_rekey_checkpoint (sqlite3 *db,
+                                         guint    column,
+                                         gint64   rowid)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db, "INSERT OR REPLACE INTO meta (key, value) VALUES ('rekey_column', ?), ('rekey_rowid', ?);",
+                            -1, &stmt, NULL) != SQLITE_OK)
     {
-        g_warning ("sqlite: could not read every row of \u201c%s\u201d: %s", ids_sql, sqlite3_errmsg (db));
+        g_warning ("sqlite: failed to record the re-key progress: %s", sqlite3_errmsg (db));
         return FALSE;
     }
 
-    sqlite3_stmt *select = NULL;
-    sqlite3_stmt *update = NULL;
-    gboolean success = (sqlite3_prepare_v2 (db, select_sql, -1, &select, NULL) == SQLITE_OK &&
-                        sqlite3_prepare_v2 (db, update_sql, -1, &update, NULL) == SQLITE_OK);
+    sqlite3_bind_int64 (stmt, 1, column);
+    sqlite3_bind_int64 (stmt, 2, rowid);
 
-    if (!success)
-        g_warning ("sqlite: failed to prepare the re-encryption of \u201c%s\u201d: %s", select_sql, sqlite3_errmsg (db));
+    gboolean success = (sqlite3_step (stmt) == SQLITE_DONE);
+
+    sqlite3_finalize (stmt);
+
+    return success;
+}
 
-    for (guint i = 0; success && i < rowids->len; ++i)
+/* Store the re-encrypted @rows of @column in the side table, with the nonce of
+ * the value each was made from, and the checkpoint past them, as one
+ * transaction. */
+static gboolean
+g_paste_sqlite_backend_rekey_store (sqlite3   *db,
+                                    guint      column,
+                                    GPtrArray *rows)
+{
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return FALSE;
+
+    sqlite3_stmt *stmt = NULL;
+    gboolean success = (sqlite3_prepare_v2 (db, "INSERT OR REPLACE INTO rekey (col, row, nonce, blob) VALUES (?, ?, ?, ?);",
+                                            -1, &stmt, NULL) == SQLITE_OK);
+
+    for (guint i = 0; success && i < rows->len; ++i)
     {
-        gint64 rowid = g_array_index (rowids, gint64, i);
+        GPasteSqliteRekeyRow *row = g_ptr_array_index (rows, i);
+
+        sqlite3_bind_int64 (stmt, 1, column);
+        sqlite3_bind_int64 (stmt, 2, row->rowid);
+        sqlite3_bind_blob64 (stmt, 3, row->old, MIN (row->old_length, crypto_secretbox_NONCEBYTES), SQLITE_STATIC);
+        sqlite3_bind_blob64 (stmt, 4, row->blob, row->blob_length, SQLITE_STATIC);
+        success = (sqlite3_step (stmt) == SQLITE_DONE);
+        sqlite3_reset (stmt);
+        sqlite3_clear_bindings (stmt);
+    }
+
+    sqlite3_finalize (stmt);
+
+    if (!success)
+        g_warning ("sqlite: failed to store re-encrypted values: %s", sqlite3_errmsg (db));
+
+    GPasteSqliteRekeyRow *last = g_ptr_array_index (rows, rows->len - 1);
+
+    success = success && g_paste_sqlite_backend_rekey_checkpoint (db, column, last->rowid);
+
+    return g_paste_sqlite_backend_finish_transaction (db, success);
+}
 
-        sqlite3_bind_int64 (select, 1, rowid);
+/* How far a re-key got, in values, reported after every batch. */
+typedef struct
+{
+    GPasteStorageProgressFunc func;
+    gpointer                  user_data;
+    guint64                   done;
+    guint64                   total;
+} GPasteSqliteRekeyProgress;
+
+/* Re-encrypt @column past @rowid into the side table, batch by batch. Outside
+ * any transaction but the batches' own: a value the daemon rewrites meanwhile
+ * just leaves a stale entry behind, which the final swap catches. */
+static gboolean
+g_paste_sqlite_backend_rekey_column (sqlite3                   *db,
+                                     const guchar              *old_key,
+                                     const guchar              *new_key,
+                                     guint                      column,
+                                     gint64                     rowid,
+                                     GPasteSqliteRekeyProgress *progress)
+{
+    for (;;)
+    {
+        g_autoptr (GPtrArray) rows = g_ptr_array_new_with_free_func (g_paste_sqlite_backend_rekey_row_free);
+        sqlite3_stmt *stmt = NULL;
 
-        if (sqlite3_step (select) != SQLITE_ROW)
+        if (sqlite3_prepare_v2 (db, g_paste_sqlite_backend_content_columns[column].batch_sql, -1, &stmt, NULL) != SQLITE_OK)
         {
-            g_warning ("sqlite: a value went missing while re-encrypting it: %s", sqlite3_errmsg (db));
-            success = FALSE;
+            g_warning ("sqlite: failed to prepare the re-encryption: %s", sqlite3_errmsg (db));
+            return FALSE;
         }
-        else
-        {
-            gsize length = 0;
-            g_autofree guchar *plain = g_paste_sqlite_backend_decrypt (old_key,
-                                                                       sqlite3_column_blob (select, 0),
-                                                                       sqlite3_column_bytes (select, 0),
-                                                                       &length);
 
-            if (!plain)
-            {
-                g_warning ("sqlite: a stored value did not decrypt; leaving the passphrase alone");
-                success = FALSE;
-            }
-            else
-            {
-                gsize blob_length;
-                g_autofree guchar *blob = g_paste_sqlite_backend_encrypt (new_key, plain, length, &blob_length);
+        sqlite3_bind_int64 (stmt, 1, rowid);
+        sqlite3_bind_int64 (stmt, 2, G_PASTE_SQLITE_REKEY_BATCH_ROWS);
 
-                /* Item contents, passwords included: do not leave them behind in
-                 * freed heap now that they are stored again. */
-                sodium_memzero (plain, length);
+        if (!g_paste_sqlite_backend_rekey_collect (db, stmt, TRUE, rows))
+            return FALSE;
 
-                sqlite3_bind_blob64 (update, 1, blob, blob_length, SQLITE_STATIC);
-                sqlite3_bind_int64 (update, 2, rowid);
+        if (!rows->len)
+            return TRUE;
 
-                if (sqlite3_step (update) != SQLITE_DONE)
-                {
-                    g_warning ("sqlite: failed to re-encrypt a stored value: %s", sqlite3_errmsg (db));
-                    success = FALSE;
-                }
+        if (!g_paste_sqlite_backend_rekey_rows (rows, old_key, new_key) ||
+            !g_paste_sqlite_backend_rekey_store (db, column, rows))
+            return FALSE;
 
-                sqlite3_reset (update);
-                sqlite3_clear_bindings (update);
-            }
-        }
+        rowid = ((GPasteSqliteRekeyRow *) g_ptr_array_index (rows, rows->len - 1))->rowid;
+
+        /* The total was counted before the batches: values added since may
+         * take the count past it. */
+        progress->done = MIN (progress->done + rows->len, progress->total);
+
+        if (progress->func)
+            progress->func (progress->done, progress->total, progress->user_data);
+    }
+}
+
+/* While a re-key is under way, the side table holds a copy of every value it
+ * got to, under the new key: whatever the history drops from now on has to go
+ * from there too, or what the user deleted would stay on disk, readable with
+ * the new passphrase. Rewriting a value drops its copy just the same, leaving
+ * it to the swap to catch up on. */
+#define G_PASTE_SQLITE_REKEY_TRIGGERS_SQL                                          \
+    "CREATE TRIGGER IF NOT EXISTS rekey_items_delete"                              \
+    "    AFTER DELETE ON items"                                                    \
+    "    BEGIN DELETE FROM rekey WHERE col IN (0, 1, 2) AND row = old.rowid; END;" \
+    "CREATE TRIGGER IF NOT EXISTS rekey_items_update"                              \
+    "    AFTER UPDATE OF value, name, image ON items"                              \
+    "    BEGIN DELETE FROM rekey WHERE col IN (0, 1, 2) AND row = old.rowid; END;" \
+    "CREATE TRIGGER IF NOT EXISTS rekey_special_values_delete"                     \
+    "    AFTER DELETE ON special_values"                                           \
+    "    BEGIN DELETE FROM rekey WHERE col = 3 AND row = old.rowid; END;"          \
+    "CREATE TRIGGER IF NOT EXISTS rekey_special_values_update"                     \
+    "    AFTER UPDATE OF data ON special_values"                                   \
+    "    BEGIN DELETE FROM rekey WHERE col = 3 AND row = old.rowid; END;"
+
+#define G_PASTE_SQLITE_REKEY_DROP_TRIGGERS_SQL             \
+    "DROP TRIGGER IF EXISTS rekey_items_delete;"           \
+    "DROP TRIGGER IF EXISTS rekey_items_update;"           \
+    "DROP TRIGGER IF EXISTS rekey_special_values_delete;"  \
+    "DROP TRIGGER IF EXISTS rekey_special_values_update;"
+
+/* Everything a re-key leaves behind besides its triggers: the side table, the
+ * checkpoint, and the new passphrase's salt, parameters and key check. */
+#define G_PASTE_SQLITE_REKEY_DROP_SQL \
+    "DROP TABLE IF EXISTS rekey;"     \
+    "DELETE FROM meta WHERE key GLOB 'rekey_*';"
+
+/* Give up on a re-key: drop everything it left behind, so no copy of the
+ * content outlives it. A re-key that failed is started over the next time
+ * rather than resumed. */
+static void
+g_paste_sqlite_backend_rekey_abandon (sqlite3 *db)
+{
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return;
+
+    gboolean success = g_paste_sqlite_backend_exec (db, G_PASTE_SQLITE_REKEY_DROP_TRIGGERS_SQL G_PASTE_SQLITE_REKEY_DROP_SQL);
+
+    if (!g_paste_sqlite_backend_finish_transaction (db, success))
+        g_warning ("sqlite: could not drop what an abandoned re-key left behind");
+}
+
+/* Pick up where an interrupted re-key to @passphrase stopped, or start a new
+ * one. The target's salt, parameters and key check sit in `meta` under
+ * "rekey_" names, next to the checkpoint, so only the same passphrase resumes:
+ * the side table holds values already encrypted for it. Any other starts over,
+ * dropping what an earlier attempt left. */
+static gboolean
+g_paste_sqlite_backend_rekey_begin (sqlite3     *db,
+                                    const gchar *passphrase,
+                                    guchar      *salt,
+                                    guint64     *opslimit,
+                                    guint64     *memlimit,
+                                    guchar      *key,
+                                    guint       *column,
+                                    gint64      *rowid)
+{
+    g_autofree guchar *check = NULL;
+    gsize check_length = 0;
+
+    if (g_paste_sqlite_backend_load_crypto_params (db, "rekey_", salt, opslimit, memlimit, &check, &check_length) &&
+        g_paste_sqlite_backend_derive_key (passphrase, salt, *opslimit, *memlimit, key) &&
+        g_paste_sqlite_backend_key_checks_out (key, check, check_length))
+    {
+        *column = (guint) g_paste_sqlite_backend_query_int64 (db, "SELECT value FROM meta WHERE key = 'rekey_column';", 0);
+        *rowid = g_paste_sqlite_backend_query_int64 (db, "SELECT value FROM meta WHERE key = 'rekey_rowid';", 0);
+
+        /* A side table left by an older GPaste had no triggers keeping it in
+         * step with the history: drop the copies of what is gone since. */
+        if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+            return FALSE;
+
+        gboolean success = g_paste_sqlite_backend_exec (db, G_PASTE_SQLITE_REKEY_TRIGGERS_SQL);
+
+        for (guint i = 0; success && i < G_N_ELEMENTS (g_paste_sqlite_backend_content_columns); ++i)
+            success = g_paste_sqlite_backend_exec (db, g_paste_sqlite_backend_content_columns[i].purge_sql);
+
+        return g_paste_sqlite_backend_finish_transaction (db, success);
+    }
 
-        sqlite3_reset (select);
-        sqlite3_clear_bindings (select);
+    randombytes_buf (salt, crypto_pwhash_SALTBYTES);
+    *opslimit = crypto_pwhash_OPSLIMIT_MODERATE;
+    *memlimit = crypto_pwhash_MEMLIMIT_MODERATE;
+    *column = 0;
+    *rowid = 0;
+
+    if (!g_paste_sqlite_backend_derive_key (passphrase, salt, *opslimit, *memlimit, key))
+    {
+        g_warning ("sqlite: could not derive the new encryption key (out of memory?)");
+        return FALSE;
+    }
+
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return FALSE;
+
+    gboolean success = g_paste_sqlite_backend_exec (db,
+                                                    G_PASTE_SQLITE_REKEY_DROP_TRIGGERS_SQL
+                                                    "DROP TABLE IF EXISTS rekey;"
+                                                    "CREATE TABLE rekey ("
+                                                    "    col   INTEGER NOT NULL,"
+                                                    "    row   INTEGER NOT NULL,"
+                                                    "    nonce BLOB    NOT NULL,"
+                                                    "    blob  BLOB    NOT NULL,"
+                                                    "    PRIMARY KEY (col, row)"
+                                                    ");"
+                                                    G_PASTE_SQLITE_REKEY_TRIGGERS_SQL);
+
+    success = success && g_paste_sqlite_backend_insert_crypto_params (db, "rekey_", salt, *opslimit, *memlimit, key);
+    success = success && g_paste_sqlite_backend_rekey_checkpoint (db, 0, 0);
+
+    return g_paste_sqlite_backend_finish_transaction (db, success);
+}
+
+/* Re-encrypt, in place, what @column's side table entries do not cover.
+ * Normally nothing: only what was written while the batches ran. Assumes the
+ * caller's transaction is open. */
+static gboolean
+g_paste_sqlite_backend_rekey_stale (sqlite3      *db,
+                                    const guchar *old_key,
+                                    const guchar *new_key,
+                                    guint         column)
+{
+    g_autoptr (GPtrArray) rows = g_ptr_array_new_with_free_func (g_paste_sqlite_backend_rekey_row_free);
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db, g_paste_sqlite_backend_content_columns[column].stale_sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare the re-encryption: %s", sqlite3_errmsg (db));
+        return FALSE;
+    }
+
+    /* Collected whole before any UPDATE, so none runs against the cursor. */
+    if (!g_paste_sqlite_backend_rekey_collect (db, stmt, FALSE, rows))
+        return FALSE;
+
+    if (!rows->len)
+        return TRUE;
+
+    if (!g_paste_sqlite_backend_rekey_rows (rows, old_key, new_key))
+        return FALSE;
+
+    sqlite3_stmt *update = NULL;
+    gboolean success = (sqlite3_prepare_v2 (db, g_paste_sqlite_backend_content_columns[column].update_sql, -1, &update, NULL) == SQLITE_OK);
+
+    for (guint i = 0; success && i < rows->len; ++i)
+    {
+        GPasteSqliteRekeyRow *row = g_ptr_array_index (rows, i);
+
+        sqlite3_bind_blob64 (update, 1, row->blob, row->blob_length, SQLITE_STATIC);
+        sqlite3_bind_int64 (update, 2, row->rowid);
+        success = (sqlite3_step (update) == SQLITE_DONE);
+        sqlite3_reset (update);
+        sqlite3_clear_bindings (update);
     }
 
-    sqlite3_finalize (select);
     sqlite3_finalize (update);
 
+    if (!success)
+        g_warning ("sqlite: failed to re-encrypt a stored value: %s", sqlite3_errmsg (db));
+
     return success;
 }
 
-/* Every content column, as the (select, update) pair
- * g_paste_sqlite_backend_rekey_column() drives. A column added to the schema
- * that holds user content has to be listed here too, or a passphrase change
- * would leave it behind, unreadable. */
-static const struct
+/* The swap: catch up on what changed since its batch, move every
+ * re-encryption into place, and put the new salt and key check in, as one
+ * transaction — the database is only ever readable with the old passphrase or
+ * with the new one, never stuck between them. */
+static gboolean
+g_paste_sqlite_backend_rekey_commit (sqlite3      *db,
+                                     const guchar *old_key,
+                                     const guchar *new_key,
+                                     const guchar *salt,
+                                     guint64       opslimit,
+                                     guint64       memlimit)
 {
-    const gchar *ids_sql;
-    const gchar *select_sql;
-    const gchar *update_sql;
-} g_paste_sqlite_backend_content_columns[] = {
-    { "SELECT rowid FROM items;",
-      "SELECT value FROM items WHERE rowid = ?;",
-      "UPDATE items SET value = ? WHERE rowid = ?;" },
-    { "SELECT rowid FROM items WHERE name IS NOT NULL;",
-      "SELECT name FROM items WHERE rowid = ?;",
-      "UPDATE items SET name = ? WHERE rowid = ?;" },
-    { "SELECT rowid FROM items WHERE image IS NOT NULL;",
-      "SELECT image FROM items WHERE rowid = ?;",
-      "UPDATE items SET image = ? WHERE rowid = ?;" },
-    { "SELECT rowid FROM special_values;",
-      "SELECT data FROM special_values WHERE rowid = ?;",
-      "UPDATE special_values SET data = ? WHERE rowid = ?;" },
-};
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return FALSE;
+
+    /* The swap rewrites every value: the triggers would drop the very copies it
+     * is moving into place. */
+    gboolean success = g_paste_sqlite_backend_exec (db, G_PASTE_SQLITE_REKEY_DROP_TRIGGERS_SQL);
+
+    /* Stale ones first: re-encrypting them in place gives them a fresh nonce,
+     * so the side table's outdated entries for them no longer apply. */
+    for (guint i = 0; success && i < G_N_ELEMENTS (g_paste_sqlite_backend_content_columns); ++i)
+    {
+        success = g_paste_sqlite_backend_rekey_stale (db, old_key, new_key, i) &&
+                  g_paste_sqlite_backend_exec (db, g_paste_sqlite_backend_content_columns[i].apply_sql);
+    }
+
+    success = success && g_paste_sqlite_backend_write_crypto_params (db, salt, opslimit, memlimit, new_key);
+    success = success && g_paste_sqlite_backend_exec (db, G_PASTE_SQLITE_REKEY_DROP_SQL);
+
+    return g_paste_sqlite_backend_finish_transaction (db, success);
+}
 
 /* Prepare the encrypted flavor on an open database: derive the key from the
  * per-database salt and verify it against the stored key check. A fresh
@@ -536,7 +1070,7 @@ g_paste_sqlite_backend_setup_crypto (sqlite3     *db,
     g_autofree guchar *check = NULL;
     gsize check_length = 0;
 
-    if (g_paste_sqlite_backend_load_crypto_params (db, salt, &opslimit, &memlimit, &check, &check_length))
+    if (g_paste_sqlite_backend_load_crypto_params (db, "", salt, &opslimit, &memlimit, &check, &check_length))
     {
         /* derive_key() has already said why. */
         if (!g_paste_sqlite_backend_derive_key (passphrase, salt, opslimit, memlimit, key))
@@ -586,26 +1120,38 @@ static gboolean
 g_paste_sqlite_backend_create_schema (sqlite3 *db)
 {
     return g_paste_sqlite_backend_exec (db,
+        "CREATE TABLE IF NOT EXISTS histories ("
+        "    id       INTEGER PRIMARY KEY,"
+        "    name     TEXT    NOT NULL UNIQUE"
+        ");"
         "CREATE TABLE IF NOT EXISTS items ("
         "    id       INTEGER PRIMARY KEY,"
-        "    uuid     TEXT    NOT NULL UNIQUE,"
+        "    uuid     TEXT    NOT NULL,"
         "    kind     TEXT    NOT NULL,"
         "    value    TEXT    NOT NULL,"
         "    rank     INTEGER NOT NULL," /* highest = front of the history */
         "    date     INTEGER,"          /* Image: unix seconds */
-        "    checksum TEXT,"             /* Image: hex sha256 */
+        "    checksum TEXT,"             /* Image: its fingerprint (older rows: hex sha256) */
         "    name     TEXT,"             /* Password: reserved for an encrypted variant */
         "    image    BLOB,"             /* Image: the encoded PNG */
-        "    favourite INTEGER NOT NULL DEFAULT 0" /* pinned: exempt from both caps */
+        "    favourite INTEGER NOT NULL DEFAULT 0," /* pinned: exempt from both caps */
+        "    history_id INTEGER NOT NULL DEFAULT " G_STRINGIFY (G_PASTE_SQLITE_OWN_HISTORY_ID) ","
+        "    compression INTEGER NOT NULL DEFAULT 0" /* GPasteCompression of value */
         ");"
-        "CREATE UNIQUE INDEX IF NOT EXISTS items_rank ON items (rank DESC);"
+        "CREATE UNIQUE INDEX IF NOT EXISTS items_history_uuid ON items (history_id, uuid);"
+        "CREATE UNIQUE INDEX IF NOT EXISTS items_history_rank ON items (history_id, rank DESC);"
         "CREATE TABLE IF NOT EXISTS special_values ("
         "    item_id  INTEGER NOT NULL REFERENCES items (id) ON DELETE CASCADE,"
         "    position INTEGER NOT NULL,"
         "    mime     TEXT    NOT NULL," /* GPasteSpecialAtom value nick */
         "    data     BLOB    NOT NULL,"
+        "    compression INTEGER NOT NULL DEFAULT 0," /* GPasteCompression of data */
         "    PRIMARY KEY (item_id, position)"
-        ");");
+        ");"
+        /* Deleting a history is deleting its row: the items go with it, and
+         * their special values with them. */
+        "CREATE TRIGGER IF NOT EXISTS histories_drop AFTER DELETE ON histories "
+        "BEGIN DELETE FROM items WHERE history_id = OLD.id; END;");
 }
 
 /* Upgrade a database created by an older GPaste (its user_version is @from) to
@@ -624,18 +1170,122 @@ g_paste_sqlite_backend_migrate_schema (sqlite3 *db,
         if (!g_paste_sqlite_backend_exec (db, "ALTER TABLE items ADD COLUMN favourite INTEGER NOT NULL DEFAULT 0;"))
             return FALSE;
         G_GNUC_FALLTHROUGH;
+    case 2:
+        /* Several histories per database. Every row an older GPaste stored
+         * belongs to the one history its file is; its indexes become per
+         * history (the column UNIQUE on uuid stays, being part of the table,
+         * and is harmless with a single history in there). */
+        if (!g_paste_sqlite_backend_exec (db,
+                                          "ALTER TABLE items ADD COLUMN history_id INTEGER NOT NULL DEFAULT "
+                                          G_STRINGIFY (G_PASTE_SQLITE_OWN_HISTORY_ID) ";"
+                                          "DROP INDEX IF EXISTS items_rank;") ||
+            !g_paste_sqlite_backend_create_schema (db))
+            return FALSE;
+        G_GNUC_FALLTHROUGH;
+    case 3:
+        /* Compressed payloads. Every row an older GPaste stored is not, which
+         * the default says. The full-text triggers now index what
+         * gpaste_text() makes of a value: drop them so that the index is set
+         * up again, and rebuilt, with the new ones. */
+        if (!g_paste_sqlite_backend_exec (db,
+                                          "ALTER TABLE items ADD COLUMN compression INTEGER NOT NULL DEFAULT 0;"
+                                          "ALTER TABLE special_values ADD COLUMN compression INTEGER NOT NULL DEFAULT 0;"
+                                          "DROP TRIGGER IF EXISTS items_fts_insert;"
+                                          "DROP TRIGGER IF EXISTS items_fts_delete;"
+                                          "DROP TRIGGER IF EXISTS items_fts_update;"))
+            return FALSE;
+        G_GNUC_FALLTHROUGH;
     default:
         return TRUE;
     }
 }
 
-/* Get the (cached) connection for @db_path, opening and preparing the database
- * as needed. Returns NULL (and warns) when the database cannot be used, e.g.
- * when it was created by a newer GPaste: every operation then no-ops instead
- * of risking the data. Must be called with the backend lock held. */
-static sqlite3 *
-g_paste_sqlite_backend_open (GPasteStorageBackend *self,
-                             const gchar          *db_path)
+/* gpaste_text (value, compression): an item's value as the text it stands
+ * for, however it is stored, for the full-text index to index. NULL (which
+ * indexes nothing) for a value that does not decompress. */
+static void
+g_paste_sqlite_backend_text_function (sqlite3_context *context,
+                                      gint             argc G_GNUC_UNUSED,
+                                      sqlite3_value  **argv)
+{
+    GPasteCompression compression = sqlite3_value_int (argv[1]);
+
+    if (compression == G_PASTE_COMPRESSION_NONE)
+    {
+        sqlite3_result_value (context, argv[0]);
+        return;
+    }
+
+    gsize length;
+    guchar *text = g_paste_storage_decompress (compression, sqlite3_value_blob (argv[0]), sqlite3_value_bytes (argv[0]), &length);
+
+    if (text)
+        sqlite3_result_text64 (context, (const gchar *) text, length, g_free, SQLITE_UTF8);
+    else
+        sqlite3_result_null (context);
+}
+
+/* Keep the full-text index of the items' values, when this SQLite has FTS5
+ * and its trigram tokenizer: an external-content table over `items`, kept in
+ * step by triggers, so every statement the vfuncs run updates it without
+ * writing a value twice. Trigrams index every substring of three characters
+ * or more, caselessly, which is exactly what a literal search pattern looks
+ * for. Outside the versioned schema on purpose: a SQLite without FTS5 opening
+ * the database drops the triggers (which would fail every write) rather than
+ * refuse it, and the index is rebuilt once it is back. Returns whether the
+ * index can be searched. */
+static gboolean
+g_paste_sqlite_backend_setup_search (sqlite3 *db)
+{
+    /* Quietly: a missing module is a build choice, not a failure. */
+    if (sqlite3_exec (db,
+                      "CREATE VIRTUAL TABLE temp.fts5_probe USING fts5 (x, tokenize = 'trigram');"
+                      "DROP TABLE temp.fts5_probe;",
+                      NULL, NULL, NULL) != SQLITE_OK)
+    {
+        g_paste_sqlite_backend_exec (db,
+                                     "DROP TRIGGER IF EXISTS items_fts_insert;"
+                                     "DROP TRIGGER IF EXISTS items_fts_delete;"
+                                     "DROP TRIGGER IF EXISTS items_fts_update;");
+        return FALSE;
+    }
+
+    /* The triggers going missing is what says the index fell behind. */
+    if (g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM sqlite_master WHERE type = 'trigger' AND name = 'items_fts_update';", 0))
+        return TRUE;
+
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return FALSE;
+
+    gboolean success = g_paste_sqlite_backend_exec (db,
+        "CREATE VIRTUAL TABLE IF NOT EXISTS items_fts USING fts5 ("
+        "    value, content = 'items', content_rowid = 'id', tokenize = 'trigram'"
+        ");"
+        "CREATE TRIGGER IF NOT EXISTS items_fts_insert AFTER INSERT ON items BEGIN "
+        "    INSERT INTO items_fts (rowid, value) VALUES (new.id, gpaste_text (new.value, new.compression));"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS items_fts_delete AFTER DELETE ON items BEGIN "
+        "    INSERT INTO items_fts (items_fts, rowid, value) VALUES ('delete', old.id, gpaste_text (old.value, old.compression));"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS items_fts_update AFTER UPDATE OF value, compression ON items BEGIN "
+        "    INSERT INTO items_fts (items_fts, rowid, value) VALUES ('delete', old.id, gpaste_text (old.value, old.compression));"
+        "    INSERT INTO items_fts (rowid, value) VALUES (new.id, gpaste_text (new.value, new.compression));"
+        "END;"
+        /* Not 'rebuild': that reads `items` as it is stored, compressed
+         * values and all. */
+        "INSERT INTO items_fts (items_fts) VALUES ('delete-all');"
+        "INSERT INTO items_fts (rowid, value) SELECT id, gpaste_text (value, compression) FROM items;");
+
+    return g_paste_sqlite_backend_finish_transaction (db, success);
+}
+
+/* Get the (cached) connection for @db_path, opening and preparing the database
+ * as needed. Returns NULL (and warns) when the database cannot be used, e.g.
+ * when it was created by a newer GPaste: every operation then no-ops instead
+ * of risking the data. Must be called with the backend lock held. */
+static sqlite3 *
+g_paste_sqlite_backend_open (GPasteStorageBackend *self,
+                             const gchar          *db_path)
 {
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
 
@@ -644,6 +1294,8 @@ g_paste_sqlite_backend_open (GPasteStorageBackend *self,
 
     g_clear_pointer (&backend->db, g_paste_sqlite_backend_close);
     g_clear_pointer (&backend->db_path, g_free);
+    g_clear_pointer (&backend->history_name, g_free);
+    backend->searchable = FALSE;
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     /* The key is salt-dependent, so it dies with its database's connection. */
     g_clear_pointer (&backend->key, gcr_secure_memory_free);
@@ -663,7 +1315,13 @@ g_paste_sqlite_backend_open (GPasteStorageBackend *self,
 
     sqlite3_busy_timeout (db, 5000);
 
-    if (!g_paste_sqlite_backend_exec (db,
+    /* Before anything can write: the full-text triggers call it. The vacuum
+     * mode only takes on a database with no table yet, so maintenance can
+     * give a new one's free pages back without rewriting it whole. */
+    if (sqlite3_create_function_v2 (db, "gpaste_text", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS,
+                                    NULL, g_paste_sqlite_backend_text_function, NULL, NULL, NULL) != SQLITE_OK ||
+        !g_paste_sqlite_backend_exec (db,
+                                      "PRAGMA auto_vacuum = INCREMENTAL;"
                                       "PRAGMA journal_mode = WAL;"
                                       "PRAGMA synchronous = NORMAL;"
                                       "PRAGMA foreign_keys = ON;"))
@@ -683,13 +1341,25 @@ g_paste_sqlite_backend_open (GPasteStorageBackend *self,
         return NULL;
     }
 
-    if (version == 0)
-        ok = g_paste_sqlite_backend_create_schema (db);
-    else
-        ok = g_paste_sqlite_backend_migrate_schema (db, version);
+    /* One transaction, user_version included, so a step that fails leaves the
+     * database on the version it started from and the next open replays the
+     * whole upgrade rather than half of one. */
+    ok = g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;");
+
+    if (ok)
+    {
+        gboolean upgraded;
+
+        if (version == 0)
+            upgraded = g_paste_sqlite_backend_create_schema (db);
+        else
+            upgraded = g_paste_sqlite_backend_migrate_schema (db, version);
+
+        if (upgraded && version != G_PASTE_SQLITE_SCHEMA_VERSION)
+            upgraded = g_paste_sqlite_backend_exec (db, "PRAGMA user_version = " G_STRINGIFY (G_PASTE_SQLITE_SCHEMA_VERSION) ";");
 
-    if (ok && version != G_PASTE_SQLITE_SCHEMA_VERSION)
-        ok = g_paste_sqlite_backend_exec (db, "PRAGMA user_version = " G_STRINGIFY (G_PASTE_SQLITE_SCHEMA_VERSION) ";");
+        ok = g_paste_sqlite_backend_finish_transaction (db, upgraded);
+    }
 
     if (!ok)
     {
@@ -720,10 +1390,13 @@ g_paste_sqlite_backend_open (GPasteStorageBackend *self,
     {
         g_paste_sqlite_backend_exec (db,
                                      "UPDATE items SET rank = ranked.new_rank "
-                                     "FROM (SELECT id, ROW_NUMBER () OVER (ORDER BY rank) AS new_rank FROM items) AS ranked "
+                                     "FROM (SELECT id, ROW_NUMBER () OVER (PARTITION BY history_id ORDER BY rank) AS new_rank FROM items) AS ranked "
                                      "WHERE items.id = ranked.id;");
     }
 
+    /* The index is the plain flavor's alone: the encrypted one's values are
+     * ciphertext, with no text to match. */
+    backend->searchable = !g_paste_sqlite_backend_get_passphrase (self) && g_paste_sqlite_backend_setup_search (db);
     backend->db = db;
     backend->db_path = g_strdup (db_path);
 
@@ -734,6 +1407,16 @@ g_paste_sqlite_backend_open (GPasteStorageBackend *self,
 /* Writing items */
 /*****************/
 
+/* What the "storage-compression" setting asks for, when this build can do it:
+ * read per write, like every setting the backend follows. */
+static GPasteCompression
+g_paste_sqlite_backend_get_compression (GPasteStorageBackend *self)
+{
+    GPasteCompression compression = g_paste_settings_get_storage_compression (g_paste_storage_backend_get_settings (self));
+
+    return g_paste_storage_compression_is_available (compression) ? compression : G_PASTE_COMPRESSION_NONE;
+}
+
 /* Bind @data as-is, or as an encrypted blob when @key is set (the encrypted
  * flavor). Text values go through this too: they are just bytes to bind. */
 static void
@@ -780,11 +1463,45 @@ g_paste_sqlite_backend_bind_text (sqlite3_stmt *stmt,
     sqlite3_bind_text (stmt, position, text, -1, SQLITE_TRANSIENT);
 }
 
+/* Bind a payload at @position, compressed with @compression when that is
+ * worth it, and at @tag_position the compression it ends up stored with.
+ * Compressed bytes are a blob (encrypted in the encrypted flavor, compression
+ * coming first); a payload left as it is binds like bind_text (when @text,
+ * @data then being a string) or bind_content would. */
+static void
+g_paste_sqlite_backend_bind_payload (sqlite3_stmt     *stmt,
+                                     gint              position,
+                                     gint              tag_position,
+                                     const guchar     *key,
+                                     GPasteCompression compression,
+                                     gconstpointer     data,
+                                     gsize             length,
+                                     gboolean          text)
+{
+    gsize compressed_length;
+    g_autofree guchar *compressed = g_paste_storage_compress (compression, data, length, &compressed_length);
+
+    if (compressed)
+    {
+        g_paste_sqlite_backend_bind_content (stmt, position, key, compressed, compressed_length);
+        sqlite3_bind_int (stmt, tag_position, compression);
+        return;
+    }
+
+    sqlite3_bind_int (stmt, tag_position, G_PASTE_COMPRESSION_NONE);
+
+    if (text)
+        g_paste_sqlite_backend_bind_text (stmt, position, key, data);
+    else
+        g_paste_sqlite_backend_bind_content (stmt, position, key, data, length);
+}
+
 static gboolean
-g_paste_sqlite_backend_write_special_values (sqlite3      *db,
-                                             const guchar *key,
-                                             gint64        item_id,
-                                             GPasteItem   *item)
+g_paste_sqlite_backend_write_special_values (sqlite3          *db,
+                                             const guchar     *key,
+                                             GPasteCompression compression,
+                                             gint64            item_id,
+                                             GPasteItem       *item)
 {
     const GSList *special_values = g_paste_item_get_special_values (item);
 
@@ -793,7 +1510,7 @@ g_paste_sqlite_backend_write_special_values (sqlite3      *db,
 
     sqlite3_stmt *stmt = NULL;
 
-    if (sqlite3_prepare_v2 (db, "INSERT INTO special_values (item_id, position, mime, data) VALUES (?, ?, ?, ?);", -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2 (db, "INSERT INTO special_values (item_id, position, mime, data, compression) VALUES (?, ?, ?, ?, ?);", -1, &stmt, NULL) != SQLITE_OK)
     {
         g_warning ("sqlite: failed to prepare special value insertion: %s", sqlite3_errmsg (db));
         return FALSE;
@@ -823,7 +1540,7 @@ g_paste_sqlite_backend_write_special_values (sqlite3      *db,
         sqlite3_bind_int64 (stmt, 1, item_id);
         sqlite3_bind_int64 (stmt, 2, position);
         sqlite3_bind_text (stmt, 3, mime, -1, SQLITE_STATIC);
-        g_paste_sqlite_backend_bind_content (stmt, 4, key, data, data_length);
+        g_paste_sqlite_backend_bind_payload (stmt, 4, 5, key, compression, data, data_length, FALSE);
 
         if (sqlite3_step (stmt) != SQLITE_DONE)
         {
@@ -875,10 +1592,11 @@ g_paste_sqlite_backend_bind_image (sqlite3_stmt    *stmt,
 
 /* Replace an item's stored special values with the ones it carries. */
 static gboolean
-g_paste_sqlite_backend_rewrite_special_values (sqlite3      *db,
-                                               const guchar *key,
-                                               gint64        item_id,
-                                               GPasteItem   *item)
+g_paste_sqlite_backend_rewrite_special_values (sqlite3          *db,
+                                               const guchar     *key,
+                                               GPasteCompression compression,
+                                               gint64            item_id,
+                                               GPasteItem       *item)
 {
     sqlite3_stmt *del = NULL;
 
@@ -894,7 +1612,7 @@ g_paste_sqlite_backend_rewrite_special_values (sqlite3      *db,
 
     sqlite3_finalize (del);
 
-    return success && g_paste_sqlite_backend_write_special_values (db, key, item_id, item);
+    return success && g_paste_sqlite_backend_write_special_values (db, key, compression, item_id, item);
 }
 
 /* Bind an item's content columns: uuid, kind and value at the fixed positions
@@ -903,17 +1621,24 @@ g_paste_sqlite_backend_rewrite_special_values (sqlite3      *db,
  * @meta_base + 4. The INSERT and UPDATE statements share this layout and
  * differ only by @meta_base — the INSERT carries an extra rank column between the
  * value and the meta group, so it binds at base 5 while the UPDATE binds at 4.
+ * Both take the value's compression as ?11, past everything else either binds.
  * Keeping the two in one place stops their column indices drifting apart. */
 static void
-g_paste_sqlite_backend_bind_item (sqlite3_stmt *stmt,
-                                  const guchar *key,
-                                  GPasteItem   *item,
-                                  gint          meta_base)
+g_paste_sqlite_backend_bind_item (sqlite3_stmt     *stmt,
+                                  const guchar     *key,
+                                  GPasteCompression compression,
+                                  GPasteItem       *item,
+                                  gint              meta_base)
 {
+    const gchar *value = g_paste_item_get_real_value (item);
+
     sqlite3_bind_text (stmt, 1, g_paste_item_get_uuid (item), -1, SQLITE_STATIC);
     /* The nick is a static string owned by the enum class, hence SQLITE_STATIC. */
     sqlite3_bind_text (stmt, 2, g_paste_item_kind_to_string (g_paste_item_get_kind (item)), -1, SQLITE_STATIC);
-    g_paste_sqlite_backend_bind_text (stmt, 3, key, g_paste_item_get_real_value (item));
+    /* An image's value is its cache path: nothing to gain there. */
+    g_paste_sqlite_backend_bind_payload (stmt, 3, 11, key,
+                                         G_PASTE_IS_IMAGE_ITEM (item) ? G_PASTE_COMPRESSION_NONE : compression,
+                                         value, strlen (value), TRUE);
     /* Every kind has one, so it is bound outside the per-kind branches below.
      * Plaintext like rank and date: the read has to order and filter on it. */
     sqlite3_bind_int (stmt, meta_base + 4, g_paste_item_is_favourite (item));
@@ -936,16 +1661,19 @@ g_paste_sqlite_backend_bind_item (sqlite3_stmt *stmt,
  * to @rank (its value never changes, only its position and whether it is
  * pinned). Special values are rewritten from the item either way. */
 static gboolean
-g_paste_sqlite_backend_upsert_item (sqlite3      *db,
-                                    const guchar *key,
-                                    GPasteItem   *item,
-                                    gint64        rank)
+g_paste_sqlite_backend_upsert_item (sqlite3          *db,
+                                    const guchar     *key,
+                                    GPasteCompression compression,
+                                    gint64            history_id,
+                                    GPasteItem       *item,
+                                    gint64            rank)
 {
     sqlite3_stmt *stmt = NULL;
 
     if (sqlite3_prepare_v2 (db,
-                            "INSERT INTO items (uuid, kind, value, rank, date, checksum, name, image, favourite) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?) "
-                            "ON CONFLICT (uuid) DO UPDATE SET rank = excluded.rank, favourite = excluded.favourite "
+                            "INSERT INTO items (uuid, kind, value, rank, date, checksum, name, image, favourite, history_id, compression) "
+                            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+                            "ON CONFLICT (history_id, uuid) DO UPDATE SET rank = excluded.rank, favourite = excluded.favourite "
                             "RETURNING id;",
                             -1, &stmt, NULL) != SQLITE_OK)
     {
@@ -953,9 +1681,11 @@ g_paste_sqlite_backend_upsert_item (sqlite3      *db,
         return FALSE;
     }
 
-    /* uuid, kind, value at 1-3, then rank at 4, then the meta group at base 5. */
-    g_paste_sqlite_backend_bind_item (stmt, key, item, 5);
+    /* uuid, kind, value at 1-3, then rank at 4, then the meta group at base 5,
+     * then the history at 10 and the value's compression at 11. */
+    g_paste_sqlite_backend_bind_item (stmt, key, compression, item, 5);
     sqlite3_bind_int64 (stmt, 4, rank);
+    sqlite3_bind_int64 (stmt, 10, history_id);
 
     gboolean success = (sqlite3_step (stmt) == SQLITE_ROW);
     gint64 item_id = success ? sqlite3_column_int64 (stmt, 0) : 0;
@@ -965,7 +1695,7 @@ g_paste_sqlite_backend_upsert_item (sqlite3      *db,
 
     sqlite3_finalize (stmt);
 
-    return success && g_paste_sqlite_backend_rewrite_special_values (db, key, item_id, item);
+    return success && g_paste_sqlite_backend_rewrite_special_values (db, key, compression, item_id, item);
 }
 
 /* Whether @item is persisted at all: password entries only survive in the
@@ -997,30 +1727,49 @@ g_paste_sqlite_backend_count_stored (const guchar *key,
     return count;
 }
 
-static void
-g_paste_sqlite_backend_write_history_file (GPasteStorageBackend *self,
-                                           const gchar          *name,
-                                           const GList          *history)
+/* Run a statement about one history, its id bound as ?1, to completion. */
+static gboolean
+g_paste_sqlite_backend_exec_history (sqlite3     *db,
+                                     const gchar *sql,
+                                     gint64       history_id)
 {
-    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
-    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    g_autofree gchar *history_file_path = g_paste_storage_backend_get_history_file_path (self, name);
-    sqlite3 *db = g_paste_sqlite_backend_open (self, history_file_path);
+    sqlite3_stmt *stmt = NULL;
 
-    if (!db)
-        return;
+    if (sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare “%s”: %s", sql, sqlite3_errmsg (db));
+        return FALSE;
+    }
 
-    const guchar *key = g_paste_sqlite_backend_get_key (self);
+    sqlite3_bind_int64 (stmt, 1, history_id);
+
+    gboolean success = (sqlite3_step (stmt) == SQLITE_DONE);
+
+    if (!success)
+        g_warning ("sqlite: failed to run “%s”: %s", sql, sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+
+    return success;
+}
 
+/* Replace everything stored for @history_id with @history, in one transaction
+ * so that replacing the whole content is atomic: a failure (or crash) rolls
+ * back to the previous state instead of losing data. */
+static gboolean
+g_paste_sqlite_backend_write_items (sqlite3          *db,
+                                    const guchar     *key,
+                                    GPasteCompression compression,
+                                    gint64            history_id,
+                                    const GList      *history)
+{
     /* Count what we'll actually store so the front item gets the highest rank. */
     gint64 rank = g_paste_sqlite_backend_count_stored (key, history);
 
-    /* One transaction, so replacing the whole content is atomic: a failure
-     * (or crash) rolls back to the previous state instead of losing data. */
     if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
-        return;
+        return FALSE;
 
-    gboolean success = g_paste_sqlite_backend_exec (db, "DELETE FROM items;");
+    gboolean success = g_paste_sqlite_backend_exec_history (db, "DELETE FROM items WHERE history_id = ?1;", history_id);
 
     for (const GList *h = history; success && h; h = g_list_next (h))
     {
@@ -1029,10 +1778,251 @@ g_paste_sqlite_backend_write_history_file (GPasteStorageBackend *self,
         if (!g_paste_sqlite_backend_stores_item (key, item))
             continue;
 
-        success = g_paste_sqlite_backend_upsert_item (db, key, item, rank--);
+        success = g_paste_sqlite_backend_upsert_item (db, key, compression, history_id, item, rank--);
     }
 
-    g_paste_sqlite_backend_finish_transaction (db, success);
+    return g_paste_sqlite_backend_finish_transaction (db, success);
+}
+
+/***********/
+/* Layouts */
+/***********/
+
+/* Whether @backend keeps every history in the single database. Must be called
+ * with the backend lock held. */
+static gboolean
+g_paste_sqlite_backend_is_single (GPasteSqliteBackend *backend)
+{
+    if (backend->layout == G_PASTE_SQLITE_LAYOUT_UNSET)
+    {
+        GPasteSettings *settings = g_paste_storage_backend_get_settings (G_PASTE_STORAGE_BACKEND (backend));
+
+        backend->layout = (g_paste_settings_get_sqlite_single_database (settings)) ? G_PASTE_SQLITE_LAYOUT_SINGLE : G_PASTE_SQLITE_LAYOUT_PER_HISTORY;
+    }
+
+    return backend->layout == G_PASTE_SQLITE_LAYOUT_SINGLE;
+}
+
+static gchar *
+g_paste_sqlite_backend_get_single_path (GPasteStorageBackend *self)
+{
+    return g_paste_sqlite_backend_get_single_database_path (g_paste_storage_backend_get_kind (self));
+}
+
+/* The database holding the history called @name in @self's layout. Must be
+ * called with the backend lock held. */
+static gchar *
+g_paste_sqlite_backend_get_db_path (GPasteStorageBackend *self,
+                                    const gchar          *name)
+{
+    if (g_paste_sqlite_backend_is_single (G_PASTE_SQLITE_BACKEND (self)))
+        return g_paste_sqlite_backend_get_single_path (self);
+
+    return g_paste_storage_backend_get_history_file_path (self, name);
+}
+
+static void g_paste_sqlite_backend_adopt (GPasteStorageBackend *self);
+
+/* The id of the history called @name in the single database @db, 0 when it
+ * has none. */
+static gint64
+g_paste_sqlite_backend_query_history_id (sqlite3     *db,
+                                         const gchar *name)
+{
+    sqlite3_stmt *stmt = NULL;
+    gint64 history_id = 0;
+
+    if (sqlite3_prepare_v2 (db, "SELECT id FROM histories WHERE name = ?;", -1, &stmt, NULL) != SQLITE_OK)
+        return 0;
+
+    sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+        history_id = sqlite3_column_int64 (stmt, 0);
+
+    sqlite3_finalize (stmt);
+
+    return history_id;
+}
+
+/* Get the connection holding the history called @name, and @history_id, the id
+ * its rows carry in there: creating the database and, in the single one, the
+ * history's row as needed, so a fresh history is listed like any other. NULL
+ * as for g_paste_sqlite_backend_open(). Must be called with the backend lock
+ * held. */
+static sqlite3 *
+g_paste_sqlite_backend_open_history (GPasteStorageBackend *self,
+                                     const gchar          *name,
+                                     gint64               *history_id)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+
+    g_paste_sqlite_backend_adopt (self);
+
+    g_autofree gchar *db_path = g_paste_sqlite_backend_get_db_path (self, name);
+    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+
+    *history_id = G_PASTE_SQLITE_OWN_HISTORY_ID;
+
+    if (!db || !g_paste_sqlite_backend_is_single (backend))
+        return db;
+
+    if (g_paste_str_equal (backend->history_name, name))
+    {
+        *history_id = backend->history_id;
+        return db;
+    }
+
+    sqlite3_stmt *stmt = NULL;
+
+    /* The no-op update is what makes RETURNING answer for an existing row too. */
+    if (sqlite3_prepare_v2 (db,
+                            "INSERT INTO histories (name) VALUES (?) "
+                            "ON CONFLICT (name) DO UPDATE SET name = excluded.name "
+                            "RETURNING id;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare history lookup: %s", sqlite3_errmsg (db));
+        return NULL;
+    }
+
+    sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+
+    gboolean found = (sqlite3_step (stmt) == SQLITE_ROW);
+
+    if (found)
+    {
+        *history_id = backend->history_id = sqlite3_column_int64 (stmt, 0);
+        g_set_str (&backend->history_name, name);
+    }
+    else
+    {
+        g_warning ("sqlite: failed to look the history “%s” up: %s", name, sqlite3_errmsg (db));
+    }
+
+    sqlite3_finalize (stmt);
+
+    return (found) ? db : NULL;
+}
+
+static gboolean g_paste_sqlite_backend_read_history_up_to (GPasteStorageBackend *self,
+                                                           const gchar          *name,
+                                                           gint64                limit,
+                                                           GList               **history,
+                                                           gsize                *size);
+
+/* A backend of the same flavour and passphrase in the other layout: the one
+ * whose histories @self takes over. It takes over nothing itself. */
+static GPasteStorageBackend *
+g_paste_sqlite_backend_new_sibling (GPasteStorageBackend *self)
+{
+    GPasteStorageBackend *sibling = g_paste_storage_backend_new_with_passphrase (g_paste_storage_backend_get_kind (self),
+                                                                                 g_paste_storage_backend_get_settings (self),
+                                                                                 g_paste_sqlite_backend_get_passphrase (self));
+
+    /* The encrypted flavour degrades to no storage at all when libsodium
+     * cannot start, and then there is nothing to take over from. */
+    if (!G_PASTE_IS_SQLITE_BACKEND (sibling))
+    {
+        g_object_unref (sibling);
+        return NULL;
+    }
+
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (sibling);
+
+    backend->layout = (g_paste_sqlite_backend_is_single (G_PASTE_SQLITE_BACKEND (self))) ? G_PASTE_SQLITE_LAYOUT_PER_HISTORY : G_PASTE_SQLITE_LAYOUT_SINGLE;
+    backend->adopted = TRUE;
+
+    return sibling;
+}
+
+/* Move the histories the other layout holds into this one: the
+ * "sqlite-single-database" setting changed since they were written. Once per
+ * backend, ahead of its first connection, so nothing is served from a layout
+ * about to be emptied. A history that cannot be read back -- one this
+ * passphrase does not open -- stays where it is rather than be lost, for the
+ * next backend to try again. Must be called with the backend lock held. */
+static void
+g_paste_sqlite_backend_adopt (GPasteStorageBackend *self)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+
+    if (backend->adopted)
+        return;
+
+    backend->adopted = TRUE;
+
+    /* The single database is one file to look for, where the per-history ones
+     * take listing the directory: only do that when there may be something. */
+    if (!g_paste_sqlite_backend_is_single (backend))
+    {
+        g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_path (self);
+
+        if (!g_file_test (single_path, G_FILE_TEST_EXISTS))
+            return;
+    }
+
+    g_autoptr (GPasteStorageBackend) sibling = g_paste_sqlite_backend_new_sibling (self);
+
+    if (!sibling)
+        return;
+
+    g_autoptr (GError) error = NULL;
+    g_auto (GStrv) names = g_paste_storage_backend_list_histories (sibling, &error);
+
+    if (!names)
+    {
+        g_warning ("sqlite: could not list the histories to move over: %s", error->message);
+        return;
+    }
+
+    for (GStrv name = names; *name; ++name)
+    {
+        g_autolist (GPasteItem) history = NULL;
+        gsize size;
+        gint64 history_id;
+
+        /* Every row, not just what the size cap reads back: the store keeps
+         * more than that on purpose, and the old copy is deleted below. */
+        if (!g_paste_sqlite_backend_read_history_up_to (sibling, *name, -1, &history, &size))
+        {
+            g_warning ("sqlite: could not read the history “%s” back; leaving it where it is", *name);
+            continue;
+        }
+
+        /* Opening is what derives the key, which a per-history layout does per
+         * database: only ask for it after. */
+        sqlite3 *db = g_paste_sqlite_backend_open_history (self, *name, &history_id);
+
+        if (!db || !g_paste_sqlite_backend_write_items (db, g_paste_sqlite_backend_get_key (self), g_paste_sqlite_backend_get_compression (self), history_id, history))
+        {
+            g_warning ("sqlite: could not move the history “%s” over; leaving it where it is", *name);
+            continue;
+        }
+
+        g_autoptr (GError) delete_error = NULL;
+
+        /* The backend's own deletion, not the public one: the images of the
+         * history are still its own, wherever it now lives. */
+        G_PASTE_STORAGE_BACKEND_GET_CLASS (sibling)->delete_history (sibling, *name, &delete_error);
+
+        if (delete_error)
+            g_warning ("sqlite: the history “%s” was moved over, but its old copy stays: %s", *name, delete_error->message);
+    }
+}
+
+static void
+g_paste_sqlite_backend_write_history_file (GPasteStorageBackend *self,
+                                           const gchar          *name,
+                                           const GList          *history)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    if (db)
+        g_paste_sqlite_backend_write_items (db, g_paste_sqlite_backend_get_key (self), g_paste_sqlite_backend_get_compression (self), history_id, history);
 }
 
 /*****************/
@@ -1069,6 +2059,35 @@ g_paste_sqlite_backend_read_content (sqlite3_stmt *stmt,
     return content;
 }
 
+/* read_content, then undo the compression @tag_column records (with the same
+ * trailing NUL). NULL when either step fails. */
+static guchar *
+g_paste_sqlite_backend_read_payload (sqlite3_stmt *stmt,
+                                     gint          column,
+                                     gint          tag_column,
+                                     const guchar *key,
+                                     gsize        *length)
+{
+    GPasteCompression compression = sqlite3_column_int (stmt, tag_column);
+
+    if (compression == G_PASTE_COMPRESSION_NONE)
+        return g_paste_sqlite_backend_read_content (stmt, column, key, length);
+
+    gsize stored_length;
+    g_autofree guchar *stored = g_paste_sqlite_backend_read_content (stmt, column, key, &stored_length);
+
+    if (!stored)
+        return NULL;
+
+    gsize decompressed_length;
+    guchar *content = g_paste_storage_decompress (compression, stored, stored_length, &decompressed_length);
+
+    if (content && length)
+        *length = decompressed_length;
+
+    return content;
+}
+
 static void
 g_paste_sqlite_backend_read_special_values (sqlite3_stmt *stmt,
                                             GEnumClass   *atom_class,
@@ -1090,11 +2109,11 @@ g_paste_sqlite_backend_read_special_values (sqlite3_stmt *stmt,
         }
 
         gsize length = 0;
-        guchar *data = g_paste_sqlite_backend_read_content (stmt, 1, key, &length);
+        guchar *data = g_paste_sqlite_backend_read_payload (stmt, 1, 2, key, &length);
 
         if (!data)
         {
-            g_warning ("sqlite: failed to decrypt a special value; dropping it");
+            g_warning ("sqlite: failed to decrypt or decompress a special value; dropping it");
             continue;
         }
 
@@ -1112,11 +2131,11 @@ g_paste_sqlite_backend_read_item (sqlite3_stmt *stmt,
 {
     const gchar *kind_str = (const gchar *) sqlite3_column_text (stmt, 2);
     GPasteItemKind kind = g_paste_item_kind_from_string (kind_str);
-    g_autofree gchar *value = (gchar *) g_paste_sqlite_backend_read_content (stmt, 3, key, NULL);
+    g_autofree gchar *value = (gchar *) g_paste_sqlite_backend_read_payload (stmt, 3, 9, key, NULL);
 
     if (!value)
     {
-        g_warning ("sqlite: failed to decrypt an item; dropping it");
+        g_warning ("sqlite: failed to decrypt or decompress an item; dropping it");
         return NULL;
     }
 
@@ -1182,70 +2201,99 @@ g_paste_sqlite_backend_read_item (sqlite3_stmt *stmt,
     return NULL;
 }
 
-static gboolean
-g_paste_sqlite_backend_read_history_file (GPasteStorageBackend *self,
-                                          const gchar          *name,
-                                          GList               **history,
-                                          gsize                *size)
+/* Persist the fingerprints given to the image items read back with a checksum
+ * from an older GPaste (see g_paste_image_item_checksum_is_current()): @ids[i]
+ * is the row @items[i] came from. The checksum doubles as the value of a row
+ * holding its image as a blob; one still naming the file it was imported from
+ * keeps that path. Best effort: a failure rolls back and only means the next
+ * load upgrades them again. */
+static void
+g_paste_sqlite_backend_upgrade_checksums (sqlite3      *db,
+                                          const guchar *key,
+                                          GArray       *ids,
+                                          GPtrArray    *items)
 {
-    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
-    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
-    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    g_autofree gchar *history_file_path = g_paste_storage_backend_get_history_file_path (self, name);
-    /* Opening creates the database on first read, so a fresh history shows up
-     * in listings just like the file backend's empty placeholder. */
-    sqlite3 *db = g_paste_sqlite_backend_open (self, history_file_path);
-
-    *history = NULL;
-    *size = 0;
+    sqlite3_stmt *stmt = NULL;
 
-    /* A NULL db means the (possibly encrypted) database is present but could not
-     * be opened/decrypted: report the failure so a caller never mistakes it for
-     * a genuinely empty history. */
-    if (!db)
-        return FALSE;
+    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+        return;
 
-    sqlite3_stmt *stmt = NULL;
+    gboolean success = (sqlite3_prepare_v2 (db,
+                                            "UPDATE items SET checksum = ?1, value = CASE WHEN image IS NULL THEN value ELSE ?2 END, "
+                                            "                 compression = CASE WHEN image IS NULL THEN compression ELSE 0 END "
+                                            "WHERE id = ?3;",
+                                            -1, &stmt, NULL) == SQLITE_OK);
 
-    /* The LIMIT applies to the items the size cap can actually evict: a
-     * favourite is read back however deep it has sunk, or the next save would
-     * destroy the very thing pinning it was meant to protect. */
-    if (sqlite3_prepare_v2 (db,
-                            "SELECT id, uuid, kind, value, date, checksum, name, image, favourite FROM items "
-                            "WHERE favourite = 1 "
-                            "   OR id IN (SELECT id FROM items WHERE favourite = 0 ORDER BY rank DESC LIMIT ?) "
-                            "ORDER BY rank DESC;",
-                            -1, &stmt, NULL) != SQLITE_OK)
+    for (guint i = 0; success && i < ids->len; ++i)
     {
-        g_warning ("sqlite: failed to prepare history query: %s", sqlite3_errmsg (db));
-        return FALSE;
-    }
+        const gchar *checksum = g_paste_image_item_get_checksum (g_ptr_array_index (items, i));
 
-    sqlite3_bind_int64 (stmt, 1, g_paste_settings_get_max_history_size (settings));
+        sqlite3_bind_text (stmt, 1, checksum, -1, SQLITE_STATIC);
+        g_paste_sqlite_backend_bind_text (stmt, 2, key, checksum);
+        sqlite3_bind_int64 (stmt, 3, g_array_index (ids, gint64, i));
 
-    /* Prepared once for the whole load: reset and re-bound per item.
-     * add_special_value prepends, so walking positions backwards rebuilds each
-     * item's special values in their original order. */
+        success = (sqlite3_step (stmt) == SQLITE_DONE);
+
+        sqlite3_reset (stmt);
+        sqlite3_clear_bindings (stmt);
+    }
+
+    if (!success)
+        g_warning ("sqlite: failed to upgrade image checksums: %s", sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+    g_paste_sqlite_backend_finish_transaction (db, success);
+}
+
+/* Build the items @stmt reads (read_item()'s columns), in its order, along with
+ * their special values, and hand each to @func, adding up their size in @size
+ * if given. An item is only kept for as long as @func keeps it. Takes @stmt
+ * over. */
+static gboolean
+g_paste_sqlite_backend_walk_rows (GPasteStorageBackend *self,
+                                  sqlite3              *db,
+                                  sqlite3_stmt         *stmt,
+                                  GFunc                 func,
+                                  gpointer              user_data,
+                                  gsize                *size)
+{
+    /* Prepared once for the whole read: reset and re-bound per item.
+     * add_special_value prepends, so walking positions backwards rebuilds each
+     * item's special values in their original order. */
     sqlite3_stmt *sv_stmt = NULL;
 
-    if (sqlite3_prepare_v2 (db, "SELECT mime, data FROM special_values WHERE item_id = ? ORDER BY position DESC;", -1, &sv_stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2 (db, "SELECT mime, data, compression FROM special_values WHERE item_id = ? ORDER BY position DESC;", -1, &sv_stmt, NULL) != SQLITE_OK)
     {
         g_warning ("sqlite: failed to prepare special value query: %s", sqlite3_errmsg (db));
         sqlite3_finalize (stmt);
         return FALSE;
     }
 
+    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
     GEnumClass *atom_class = g_type_class_ref (G_PASTE_TYPE_SPECIAL_ATOM);
     const guchar *key = g_paste_sqlite_backend_get_key (self);
     gboolean images_support = g_paste_settings_get_images_support (settings);
+    /* Rows whose stored checksum the item did not keep, written back once the
+     * read is done. */
+    g_autoptr (GArray) upgraded_ids = g_array_new (FALSE, FALSE, sizeof (gint64));
+    g_autoptr (GPtrArray) upgraded = g_ptr_array_new_with_free_func (g_object_unref);
 
     while (sqlite3_step (stmt) == SQLITE_ROW)
     {
-        GPasteItem *item = g_paste_sqlite_backend_read_item (stmt, key, images_support);
+        g_autoptr (GPasteItem) item = g_paste_sqlite_backend_read_item (stmt, key, images_support);
 
         if (!item)
             continue;
 
+        if (G_PASTE_IS_IMAGE_ITEM (item) &&
+            !g_paste_str_equal ((const gchar *) sqlite3_column_text (stmt, 5), g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (item))))
+        {
+            gint64 id = sqlite3_column_int64 (stmt, 0);
+
+            g_array_append_val (upgraded_ids, id);
+            g_ptr_array_add (upgraded, g_object_ref (item));
+        }
+
         const gchar *uuid = (const gchar *) sqlite3_column_text (stmt, 1);
 
         if (uuid && g_uuid_string_is_valid (uuid))
@@ -1255,19 +2303,294 @@ g_paste_sqlite_backend_read_history_file (GPasteStorageBackend *self,
 
         g_paste_sqlite_backend_read_special_values (sv_stmt, atom_class, key, sqlite3_column_int64 (stmt, 0), item);
 
-        *history = g_list_prepend (*history, item);
-        *size += g_paste_item_get_size (item);
+        if (size)
+            *size += g_paste_item_get_size (item);
+        func (item, user_data);
     }
 
     g_type_class_unref (atom_class);
     sqlite3_finalize (sv_stmt);
     sqlite3_finalize (stmt);
 
-    *history = g_list_reverse (*history);
+    if (upgraded_ids->len)
+        g_paste_sqlite_backend_upgrade_checksums (db, key, upgraded_ids, upgraded);
 
     return TRUE;
 }
 
+static void
+g_paste_sqlite_backend_collect_item (gpointer data,
+                                     gpointer user_data)
+{
+    GList **items = user_data;
+
+    *items = g_list_prepend (*items, g_object_ref (data));
+}
+
+/* walk_rows() into @history, in @stmt's order. */
+static gboolean
+g_paste_sqlite_backend_read_rows (GPasteStorageBackend *self,
+                                  sqlite3              *db,
+                                  sqlite3_stmt         *stmt,
+                                  GList               **history,
+                                  gsize                *size)
+{
+    GList *items = NULL;
+    gboolean read = g_paste_sqlite_backend_walk_rows (self, db, stmt, g_paste_sqlite_backend_collect_item, &items, size);
+
+    *history = g_list_reverse (items);
+
+    return read;
+}
+
+/* The query reading history @history_id back, at most @limit of the items the
+ * size cap can evict along with every favourite (a negative @limit reads them
+ * all). */
+static sqlite3_stmt *
+g_paste_sqlite_backend_prepare_history (sqlite3 *db,
+                                        gint64   history_id,
+                                        gint64   limit)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    /* The LIMIT applies to the items the size cap can actually evict: a
+     * favourite is read back however deep it has sunk, or the next save would
+     * destroy the very thing pinning it was meant to protect. */
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT id, uuid, kind, value, date, checksum, name, image, favourite, compression FROM items "
+                            "WHERE history_id = ?1 AND (favourite = 1 "
+                            "   OR id IN (SELECT id FROM items WHERE history_id = ?1 AND favourite = 0 ORDER BY rank DESC LIMIT ?2)) "
+                            "ORDER BY rank DESC;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare history query: %s", sqlite3_errmsg (db));
+        return NULL;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_int64 (stmt, 2, limit);
+
+    return stmt;
+}
+
+/* Read the history called @name back, its items picked for @limit as
+ * g_paste_sqlite_backend_prepare_history() does. */
+static gboolean
+g_paste_sqlite_backend_read_history_up_to (GPasteStorageBackend *self,
+                                           const gchar          *name,
+                                           gint64                limit,
+                                           GList               **history,
+                                           gsize                *size)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    /* Opening creates the history on first read, so a fresh one shows up in
+     * listings just like the file backend's empty placeholder. */
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    *history = NULL;
+    *size = 0;
+
+    /* A NULL db means the (possibly encrypted) database is present but could not
+     * be opened/decrypted: report the failure so a caller never mistakes it for
+     * a genuinely empty history. */
+    if (!db)
+        return FALSE;
+
+    sqlite3_stmt *stmt = g_paste_sqlite_backend_prepare_history (db, history_id, limit);
+
+    return stmt && g_paste_sqlite_backend_read_rows (self, db, stmt, history, size);
+}
+
+static gboolean
+g_paste_sqlite_backend_read_history_file (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          GList               **history,
+                                          gsize                *size)
+{
+    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
+
+    return g_paste_sqlite_backend_read_history_up_to (self, name, g_paste_settings_get_max_history_size (settings), history, size);
+}
+
+/* read_history_file(), a row at a time. */
+static gboolean
+g_paste_sqlite_backend_foreach_item (GPasteStorageBackend *self,
+                                     const gchar          *name,
+                                     GFunc                 func,
+                                     gpointer              user_data)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    if (!db)
+        return FALSE;
+
+    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
+    sqlite3_stmt *stmt = g_paste_sqlite_backend_prepare_history (db, history_id, g_paste_settings_get_max_history_size (settings));
+
+    return stmt && g_paste_sqlite_backend_walk_rows (self, db, stmt, func, user_data, NULL);
+}
+
+/*********************/
+/* Partial histories */
+/*********************/
+
+/* The rows a history may leave in the store when it keeps only its newest
+ * items in memory: a favourite or a password always comes back with the head,
+ * as it does with every other read. */
+#define G_PASTE_SQLITE_COLD "favourite = 0 AND kind <> 'Password'"
+
+static gboolean
+g_paste_sqlite_backend_read_history_head (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          guint64               length,
+                                          GList               **history,
+                                          gsize                *size,
+                                          guint64              *cold_length)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    if (!db)
+        return FALSE;
+
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT id, uuid, kind, value, date, checksum, name, image, favourite, compression FROM items "
+                            "WHERE history_id = ?1 AND (NOT (" G_PASTE_SQLITE_COLD ") "
+                            "   OR id IN (SELECT id FROM items WHERE history_id = ?1 AND " G_PASTE_SQLITE_COLD " ORDER BY rank DESC LIMIT ?2)) "
+                            "ORDER BY rank DESC;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare history head query: %s", sqlite3_errmsg (db));
+        return FALSE;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_int64 (stmt, 2, length);
+
+    gint64 evictable = g_paste_sqlite_backend_query_history_int64 (db, "SELECT COUNT (*) FROM items WHERE history_id = ?1 AND " G_PASTE_SQLITE_COLD ";", history_id, 0);
+
+    *cold_length = evictable - MIN ((guint64) evictable, length);
+
+    return g_paste_sqlite_backend_read_rows (self, db, stmt, history, size);
+}
+
+static GList *
+g_paste_sqlite_backend_read_history_tail (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          guint64               offset,
+                                          guint64               limit)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+    GList *history = NULL;
+
+    if (!db)
+        return NULL;
+
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT id, uuid, kind, value, date, checksum, name, image, favourite, compression FROM items "
+                            "WHERE history_id = ?1 AND " G_PASTE_SQLITE_COLD " "
+                            "ORDER BY rank DESC LIMIT ?3 OFFSET ?2;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare history tail query: %s", sqlite3_errmsg (db));
+        return NULL;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_int64 (stmt, 2, offset);
+    /* A negative LIMIT is no limit at all. */
+    sqlite3_bind_int64 (stmt, 3, limit ? (gint64) limit : -1);
+
+    g_paste_sqlite_backend_read_rows (self, db, stmt, &history, NULL);
+
+    return history;
+}
+
+static GPasteItem *
+g_paste_sqlite_backend_read_stored_item (GPasteStorageBackend *self,
+                                         const gchar          *name,
+                                         const gchar          *uuid)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+    GList *history = NULL;
+
+    if (!db)
+        return NULL;
+
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT id, uuid, kind, value, date, checksum, name, image, favourite, compression FROM items "
+                            "WHERE history_id = ?1 AND uuid = ?2;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare stored item query: %s", sqlite3_errmsg (db));
+        return NULL;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_text (stmt, 2, uuid, -1, SQLITE_STATIC);
+
+    g_paste_sqlite_backend_read_rows (self, db, stmt, &history, NULL);
+
+    /* uuids are unique within a history: one row at most. */
+    GPasteItem *item = (history) ? history->data : NULL;
+
+    g_list_free (history);
+
+    return item;
+}
+
+static void
+g_paste_sqlite_backend_truncate_history (GPasteStorageBackend *self,
+                                         const gchar          *name,
+                                         guint64               length)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    if (!db)
+        return;
+
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2 (db,
+                            "DELETE FROM items WHERE id IN (SELECT id FROM items WHERE history_id = ?1 AND " G_PASTE_SQLITE_COLD " "
+                            "                               ORDER BY rank DESC LIMIT -1 OFFSET ?2);",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare history truncation: %s", sqlite3_errmsg (db));
+        return;
+    }
+
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_int64 (stmt, 2, length);
+
+    if (sqlite3_step (stmt) != SQLITE_DONE)
+        g_warning ("sqlite: failed to truncate a history: %s", sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+}
+
 /***********************/
 /* Incremental updates */
 /***********************/
@@ -1280,13 +2603,14 @@ g_paste_sqlite_backend_read_history_file (GPasteStorageBackend *self,
 static void
 g_paste_sqlite_backend_reconcile (sqlite3      *db,
                                   const guchar *key,
+                                  gint64        history_id,
                                   const GList  *history)
 {
     gint64 expected = g_paste_sqlite_backend_count_stored (key, history);
 
     /* The common case: nothing rode along, the store already matches. Only
      * build the uuid set (and scan the table) when it actually does not. */
-    if (g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM items;", expected) == expected)
+    if (g_paste_sqlite_backend_query_history_int64 (db, "SELECT COUNT (*) FROM items WHERE history_id = ?1;", history_id, expected) == expected)
         return;
 
     g_autoptr (GHashTable) uuids = g_hash_table_new (g_str_hash, g_str_equal);
@@ -1301,12 +2625,14 @@ g_paste_sqlite_backend_reconcile (sqlite3      *db,
 
     sqlite3_stmt *stmt = NULL;
 
-    if (sqlite3_prepare_v2 (db, "SELECT uuid FROM items;", -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2 (db, "SELECT uuid FROM items WHERE history_id = ?;", -1, &stmt, NULL) != SQLITE_OK)
     {
         g_warning ("sqlite: failed to prepare reconciliation query: %s", sqlite3_errmsg (db));
         return;
     }
 
+    sqlite3_bind_int64 (stmt, 1, history_id);
+
     g_autoptr (GStrvBuilder) extra = g_strv_builder_new ();
 
     while (sqlite3_step (stmt) == SQLITE_ROW)
@@ -1326,7 +2652,7 @@ g_paste_sqlite_backend_reconcile (sqlite3      *db,
 
     sqlite3_stmt *del = NULL;
 
-    if (sqlite3_prepare_v2 (db, "DELETE FROM items WHERE uuid = ?;", -1, &del, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2 (db, "DELETE FROM items WHERE history_id = ? AND uuid = ?;", -1, &del, NULL) != SQLITE_OK)
     {
         g_warning ("sqlite: failed to prepare reconciliation cleanup: %s", sqlite3_errmsg (db));
         return;
@@ -1334,7 +2660,8 @@ g_paste_sqlite_backend_reconcile (sqlite3      *db,
 
     for (GStrv uuid = to_delete; *uuid; ++uuid)
     {
-        sqlite3_bind_text (del, 1, *uuid, -1, SQLITE_STATIC);
+        sqlite3_bind_int64 (del, 1, history_id);
+        sqlite3_bind_text (del, 2, *uuid, -1, SQLITE_STATIC);
 
         if (sqlite3_step (del) != SQLITE_DONE)
             g_warning ("sqlite: failed to reconcile an item: %s", sqlite3_errmsg (db));
@@ -1356,10 +2683,10 @@ g_paste_sqlite_backend_add_item (GPasteStorageBackend *self,
                                  GPasteItem           *item,
                                  const GList          *history)
 {
-    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
     g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
 
     if (!db)
         return;
@@ -1372,15 +2699,15 @@ g_paste_sqlite_backend_add_item (GPasteStorageBackend *self,
 
     if (g_paste_sqlite_backend_stores_item (key, item))
     {
-        gint64 rank = g_paste_sqlite_backend_query_int64 (db, "SELECT COALESCE (MAX (rank), 0) FROM items;", 0) + 1;
+        gint64 rank = g_paste_sqlite_backend_query_history_int64 (db, "SELECT COALESCE (MAX (rank), 0) FROM items WHERE history_id = ?1;", history_id, 0) + 1;
 
-        success = g_paste_sqlite_backend_upsert_item (db, key, item, rank);
+        success = g_paste_sqlite_backend_upsert_item (db, key, g_paste_sqlite_backend_get_compression (self), history_id, item, rank);
     }
 
     /* A %NULL history says nothing was displaced by this add, so no row can
      * have been orphaned and there is nothing to reconcile. */
     if (success && history)
-        g_paste_sqlite_backend_reconcile (db, key, history);
+        g_paste_sqlite_backend_reconcile (db, key, history_id, history);
 
     g_paste_sqlite_backend_finish_transaction (db, success);
 }
@@ -1390,23 +2717,24 @@ g_paste_sqlite_backend_remove_item (GPasteStorageBackend *self,
                                     const gchar          *name,
                                     const gchar          *uuid)
 {
-    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
     g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
 
     if (!db)
         return;
 
     sqlite3_stmt *stmt = NULL;
 
-    if (sqlite3_prepare_v2 (db, "DELETE FROM items WHERE uuid = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2 (db, "DELETE FROM items WHERE history_id = ? AND uuid = ?;", -1, &stmt, NULL) != SQLITE_OK)
     {
         g_warning ("sqlite: failed to prepare item removal: %s", sqlite3_errmsg (db));
         return;
     }
 
-    sqlite3_bind_text (stmt, 1, uuid, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 1, history_id);
+    sqlite3_bind_text (stmt, 2, uuid, -1, SQLITE_STATIC);
 
     if (sqlite3_step (stmt) != SQLITE_DONE)
         g_warning ("sqlite: failed to remove an item: %s", sqlite3_errmsg (db));
@@ -1420,10 +2748,10 @@ g_paste_sqlite_backend_replace_item (GPasteStorageBackend *self,
                                      const gchar          *old_uuid,
                                      GPasteItem           *item)
 {
-    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
     g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
 
     if (!db)
         return;
@@ -1445,7 +2773,8 @@ g_paste_sqlite_backend_replace_item (GPasteStorageBackend *self,
 
     sqlite3_stmt *stmt = NULL;
     gboolean success = (sqlite3_prepare_v2 (db,
-                                            "UPDATE items SET uuid = ?, kind = ?, value = ?, date = ?, checksum = ?, name = ?, image = ?, favourite = ? WHERE uuid = ? "
+                                            "UPDATE items SET uuid = ?, kind = ?, value = ?, date = ?, checksum = ?, name = ?, image = ?, favourite = ?, compression = ?11 "
+                                            "WHERE uuid = ?9 AND history_id = ?10 "
                                             "RETURNING id;",
                                             -1, &stmt, NULL) == SQLITE_OK);
 
@@ -1456,9 +2785,14 @@ g_paste_sqlite_backend_replace_item (GPasteStorageBackend *self,
         return;
     }
 
-    /* uuid, kind, value at 1-3, the meta group at base 4, then old uuid at 9. */
-    g_paste_sqlite_backend_bind_item (stmt, key, item, 4);
+    /* uuid, kind, value at 1-3, the meta group at base 4, then old uuid at 9,
+     * the history at 10 and the value's compression at 11 (numbered: a bare ?
+     * after ?11 would be 12). */
+    GPasteCompression compression = g_paste_sqlite_backend_get_compression (self);
+
+    g_paste_sqlite_backend_bind_item (stmt, key, compression, item, 4);
     sqlite3_bind_text (stmt, 9, old_uuid, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 10, history_id);
 
     /* No row means the replaced item was never persisted (e.g. renaming a
      * password): nothing to update. */
@@ -1475,7 +2809,7 @@ g_paste_sqlite_backend_replace_item (GPasteStorageBackend *self,
     sqlite3_finalize (stmt);
 
     if (success && found)
-        success = g_paste_sqlite_backend_rewrite_special_values (db, key, item_id, item);
+        success = g_paste_sqlite_backend_rewrite_special_values (db, key, compression, item_id, item);
 
     g_paste_sqlite_backend_finish_transaction (db, success);
 }
@@ -1484,85 +2818,198 @@ static void
 g_paste_sqlite_backend_clear_history (GPasteStorageBackend *self,
                                       const gchar          *name)
 {
-    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
     g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
 
-    /* Keep the (now empty) database so the history is still listed. */
+    /* Keep the (now empty) history so it is still listed. */
     if (db)
-        g_paste_sqlite_backend_exec (db, "DELETE FROM items;");
+        g_paste_sqlite_backend_exec_history (db, "DELETE FROM items WHERE history_id = ?1;", history_id);
 }
 
 /**************/
 /* Management */
 /**************/
 
-#ifdef G_PASTE_ENABLE_ENCRYPTION
-/* Re-encrypt @name under @new_passphrase. Everything — every content column and
- * the meta parameters the key is checked against — moves in a single
- * transaction, so the database is only ever readable with the old passphrase or
- * with the new one, never stuck between them. */
-static gboolean
-g_paste_sqlite_backend_rekey (GPasteStorageBackend *self,
-                              const gchar          *name,
-                              const gchar          *new_passphrase)
+/* Close our connection to @db_path, if that is the one we hold, so the WAL is
+ * checkpointed and the database can be replaced or go away. Must be called with
+ * the backend lock held. */
+static void
+g_paste_sqlite_backend_forget (GPasteSqliteBackend *backend,
+                               const gchar         *db_path)
 {
-    if (!g_paste_sqlite_backend_get_passphrase (self))
-    {
-        g_warning ("This history is not encrypted: it has no passphrase to change");
-        return FALSE;
-    }
+    if (!backend->db || !g_paste_str_equal (backend->db_path, db_path))
+        return;
 
-    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
-    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
-    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
-    /* Opening verifies the current passphrase against the stored key check, so
-     * by here backend->key is the one everything is encrypted with. */
-    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    g_clear_pointer (&backend->db, g_paste_sqlite_backend_close);
+    g_clear_pointer (&backend->db_path, g_free);
+    g_clear_pointer (&backend->history_name, g_free);
+    backend->searchable = FALSE;
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    g_clear_pointer (&backend->key, gcr_secure_memory_free);
+#endif
+}
 
-    if (!db)
-        return FALSE;
+/* A connection to @db_path for a question that needs no key: the one we hold
+ * when it is that database, or a read-only one of its own (@owned, for the
+ * caller to close) that creates nothing. NULL when there is no such database.
+ * Must be called with the backend lock held. */
+static sqlite3 *
+g_paste_sqlite_backend_peek (GPasteSqliteBackend *backend,
+                             const gchar         *db_path,
+                             gboolean            *owned)
+{
+    *owned = FALSE;
 
-    guchar salt[crypto_pwhash_SALTBYTES];
-    guint64 opslimit = crypto_pwhash_OPSLIMIT_MODERATE;
-    guint64 memlimit = crypto_pwhash_MEMLIMIT_MODERATE;
-    guchar *new_key = gcr_secure_memory_alloc (crypto_secretbox_KEYBYTES);
+    if (backend->db && g_paste_str_equal (backend->db_path, db_path))
+        return backend->db;
 
-    randombytes_buf (salt, sizeof (salt));
+    if (!g_file_test (db_path, G_FILE_TEST_EXISTS))
+        return NULL;
 
-    if (!g_paste_sqlite_backend_derive_key (new_passphrase, salt, opslimit, memlimit, new_key))
-    {
-        g_warning ("sqlite: could not derive the new encryption key (out of memory?)");
-        gcr_secure_memory_free (new_key);
+    sqlite3 *db = NULL;
 
-        return FALSE;
+    if (sqlite3_open_v2 (db_path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close (db);
+        return NULL;
     }
 
-    if (!g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
-    {
-        gcr_secure_memory_free (new_key);
+    sqlite3_busy_timeout (db, 5000);
+    *owned = TRUE;
+
+    return db;
+}
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+/* Check @passphrase against the key check of the database at @db_path, read
+ * only. %FALSE when that says nothing either way: no database, or no crypto
+ * parameters in it (a fresh, corrupt or foreign one). Otherwise @checks_out is
+ * the verdict and @has_data whether a wrong passphrase would cost anything. */
+static gboolean
+g_paste_sqlite_backend_probe_passphrase (const gchar *db_path,
+                                         const gchar *passphrase,
+                                         gboolean    *checks_out,
+                                         gboolean    *has_data)
+{
+    sqlite3 *db = NULL;
 
+    /* Read-only: verification must never create or touch anything. */
+    if (sqlite3_open_v2 (db_path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close (db);
         return FALSE;
     }
 
-    gboolean success = TRUE;
+    guchar salt[crypto_pwhash_SALTBYTES];
+    guint64 opslimit = 0;
+    guint64 memlimit = 0;
+    g_autofree guchar *check = NULL;
+    gsize check_length = 0;
 
-    for (guint64 i = 0; success && i < G_N_ELEMENTS (g_paste_sqlite_backend_content_columns); ++i)
+    if (!g_paste_sqlite_backend_load_crypto_params (db, "", salt, &opslimit, &memlimit, &check, &check_length))
     {
-        success = g_paste_sqlite_backend_rekey_column (db, backend->key, new_key,
-                                                       g_paste_sqlite_backend_content_columns[i].ids_sql,
-                                                       g_paste_sqlite_backend_content_columns[i].select_sql,
-                                                       g_paste_sqlite_backend_content_columns[i].update_sql);
+        sqlite3_close (db);
+        return FALSE;
     }
 
-    /* The new salt and key check land in the same transaction as the content
-     * they describe: rolling back takes them with it. */
-    success = success && g_paste_sqlite_backend_write_crypto_params (db, salt, opslimit, memlimit, new_key);
-    success = g_paste_sqlite_backend_finish_transaction (db, success);
+    guchar key[crypto_secretbox_KEYBYTES];
+    gboolean derived = g_paste_sqlite_backend_derive_key (passphrase, salt, opslimit, memlimit, key);
+
+    *checks_out = derived && g_paste_sqlite_backend_key_checks_out (key, check, check_length);
+    *has_data = g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM items;", 0) > 0;
+
+    sodium_memzero (key, sizeof (key));
+    sqlite3_close (db);
+
+    return derived;
+}
+
+/* Re-encrypt @name under @new_passphrase. The content is re-encrypted batch by
+ * batch into the `rekey` side table, the crypto of each batch spread across
+ * cores, while the live columns stay on the old key; only then does a single
+ * transaction swap everything in, content and the meta parameters the key is
+ * checked against together, so the database is only ever readable with the old
+ * passphrase or with the new one, never stuck between them. Every batch
+ * commits with a checkpoint, so a re-key to the same passphrase that was
+ * interrupted — a crash, a logout — resumes where it stopped.
+ *
+ * The single database has one key for all of its histories, so the first of
+ * them re-keys the lot and the others find it done. */
+static gboolean
+g_paste_sqlite_backend_rekey (GPasteStorageBackend     *self,
+                              const gchar              *name,
+                              const gchar              *new_passphrase,
+                              GPasteStorageProgressFunc progress,
+                              gpointer                  user_data)
+{
+    if (!g_paste_sqlite_backend_get_passphrase (self))
+    {
+        g_warning ("This history is not encrypted: it has no passphrase to change");
+        return FALSE;
+    }
+
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    if (g_paste_sqlite_backend_is_single (backend))
+    {
+        g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_path (self);
+        gboolean checks_out = FALSE;
+        gboolean has_data = FALSE;
+
+        /* Taken over under the current passphrase before anything changes. */
+        g_paste_sqlite_backend_adopt (self);
+
+        if (g_paste_sqlite_backend_probe_passphrase (single_path, new_passphrase, &checks_out, &has_data) && checks_out)
+            return TRUE;
+    }
+
+    gint64 history_id;
+    /* Opening verifies the current passphrase against the stored key check, so
+     * by here backend->key is the one everything is encrypted with. */
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+
+    if (!db)
+        return FALSE;
+
+    guchar salt[crypto_pwhash_SALTBYTES];
+    guint64 opslimit = 0;
+    guint64 memlimit = 0;
+    guchar *new_key = gcr_secure_memory_alloc (crypto_secretbox_KEYBYTES);
+    guint column = 0;
+    gint64 rowid = 0;
+    gboolean success = g_paste_sqlite_backend_rekey_begin (db, new_passphrase, salt, &opslimit, &memlimit,
+                                                           new_key, &column, &rowid);
+
+    /* Every value the batches go through, one per non-NULL content column; a
+     * resumed re-key starts from what the side table already holds. */
+    GPasteSqliteRekeyProgress rekey_progress = {
+        .func = progress,
+        .user_data = user_data,
+        .done = 0,
+        .total = (guint64) g_paste_sqlite_backend_query_int64 (db,
+                                                               "SELECT (SELECT COUNT (*) FROM items)"
+                                                               "     + (SELECT COUNT (name) FROM items)"
+                                                               "     + (SELECT COUNT (image) FROM items)"
+                                                               "     + (SELECT COUNT (*) FROM special_values);",
+                                                               0),
+    };
+
+    if (success)
+        rekey_progress.done = (guint64) g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM rekey;", 0);
+
+    for (; success && column < G_N_ELEMENTS (g_paste_sqlite_backend_content_columns); ++column, rowid = 0)
+        success = g_paste_sqlite_backend_rekey_column (db, backend->key, new_key, column, rowid, &rekey_progress);
+
+    success = success && g_paste_sqlite_backend_rekey_commit (db, backend->key, new_key, salt, opslimit, memlimit);
 
     if (!success)
     {
+        /* Nothing it re-encrypted may outlive it: the side table holds a copy
+         * of the content readable with the new passphrase. */
+        g_paste_sqlite_backend_rekey_abandon (db);
         gcr_secure_memory_free (new_key);
         g_warning ("Failed to re-encrypt the history \"%s\"; it keeps its current passphrase", name);
 
@@ -1576,52 +3023,865 @@ g_paste_sqlite_backend_rekey (GPasteStorageBackend *self,
      * key no longer matching what is now on disk; re-opening this database
      * through this instance then refuses it at the key check rather than reading
      * it with a stale key. */
-    g_clear_pointer (&backend->db, g_paste_sqlite_backend_close);
-    g_clear_pointer (&backend->db_path, g_free);
-    g_clear_pointer (&backend->key, gcr_secure_memory_free);
+    g_paste_sqlite_backend_forget (backend, backend->db_path);
     gcr_secure_memory_free (new_key);
 
     return TRUE;
 }
 #endif /* G_PASTE_ENABLE_ENCRYPTION */
 
+static void
+g_paste_sqlite_backend_delete_sidecars (const gchar *db_path)
+{
+    static const gchar *sidecars[] = { "-wal", "-shm" };
+
+    for (guint64 i = 0; i < G_N_ELEMENTS (sidecars); ++i)
+    {
+        g_autofree gchar *sidecar_path = g_strconcat (db_path, sidecars[i], NULL);
+        g_autoptr (GFile) sidecar = g_file_new_for_path (sidecar_path);
+
+        /* Only present while a connection is (or was) open, so a missing one is
+         * the normal case and not worth reporting -- the database itself is
+         * what counts, and its callers report on that. */
+        g_file_delete (sidecar, NULL, NULL);
+    }
+}
+
+/* Delete @path and its sidecars, closing our connection to it first so they
+ * can go away with it. Must be called with the backend lock held. */
+static void
+g_paste_sqlite_backend_delete_database (GPasteSqliteBackend *backend,
+                                        const gchar         *db_path,
+                                        GError             **error)
+{
+    g_paste_sqlite_backend_forget (backend, db_path);
+
+    g_autoptr (GFile) db_file = g_file_new_for_path (db_path);
+
+    g_file_delete (db_file, NULL, error);
+    g_paste_sqlite_backend_delete_sidecars (db_path);
+}
+
+/* In the single database a history is its `histories` row: deleting it takes
+ * its items along (see the histories_drop trigger), and the database itself
+ * goes with the last one, like a per-history database does with its own. */
+static void
+g_paste_sqlite_backend_delete_single_history (GPasteStorageBackend *self,
+                                              const gchar          *name,
+                                              GError              **error)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autofree gchar *db_path = g_paste_sqlite_backend_get_single_path (self);
+
+    /* Nothing to open a database for, let alone create one. */
+    if (!g_file_test (db_path, G_FILE_TEST_EXISTS))
+        return;
+
+    sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+    sqlite3_stmt *stmt = NULL;
+
+    if (!db || sqlite3_prepare_v2 (db, "DELETE FROM histories WHERE name = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not delete the history “%s” from “%s”: %s",
+                     name, db_path, (db) ? sqlite3_errmsg (db) : "cannot open it");
+        return;
+    }
+
+    sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+
+    if (sqlite3_step (stmt) != SQLITE_DONE)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not delete the history “%s” from “%s”: %s",
+                     name, db_path, sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+
+    if (g_paste_str_equal (backend->history_name, name))
+        g_clear_pointer (&backend->history_name, g_free);
+
+    if (!(error && *error) && !g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM histories;", 1))
+        g_paste_sqlite_backend_delete_database (backend, db_path, error);
+}
+
 static void
 g_paste_sqlite_backend_delete_history (GPasteStorageBackend *self,
                                        const gchar          *name,
                                        GError              **error)
 {
-    const gchar *extension = g_paste_storage_backend_get_extension (self);
-    g_autofree gchar *db_path = g_paste_util_get_history_file_path (name, extension);
     GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
     g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
 
-    /* Close our connection first so the WAL is checkpointed and its sidecar
-     * files can go away with the database. */
+    /* Whatever the other layout still holds of @name would otherwise come
+     * back with the next history switch. */
+    g_paste_sqlite_backend_adopt (self);
+
+    if (g_paste_sqlite_backend_is_single (backend))
+    {
+        g_paste_sqlite_backend_delete_single_history (self, name, error);
+        return;
+    }
+
+    g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
+
+    g_paste_sqlite_backend_delete_database (backend, db_path, error);
+}
+
+/* Pages copied per backup step: small enough that a write to the source from
+ * another connection in between only restarts a short stretch. */
+#define G_PASTE_SQLITE_BACKUP_STEP_PAGES 256
+
+/* In the single database, a copy is the same rows under another history id:
+ * one transaction, still without decrypting or decoding anything, the content
+ * columns being keyed to the database and not to the history. */
+static gboolean
+g_paste_sqlite_backend_copy_single_history (GPasteStorageBackend *self,
+                                            const gchar          *name,
+                                            const gchar          *copy,
+                                            GError              **error)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    gint64 source_id;
+    gint64 copy_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &source_id);
+
+    if (!db || !g_paste_sqlite_backend_exec (db, "BEGIN IMMEDIATE;"))
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not copy “%s” to “%s”", name, copy);
+        return FALSE;
+    }
+
+    /* Same connection: the database is the same, only the history row is new. */
+    gboolean success = g_paste_sqlite_backend_open_history (self, copy, &copy_id) &&
+                       g_paste_sqlite_backend_exec_history (db, "DELETE FROM items WHERE history_id = ?1;", copy_id);
+    sqlite3_stmt *stmt = NULL;
+
+    if (success &&
+        sqlite3_prepare_v2 (db,
+                            "INSERT INTO items (history_id, uuid, kind, value, rank, date, checksum, name, image, favourite, compression) "
+                            "SELECT ?1, uuid, kind, value, rank, date, checksum, name, image, favourite, compression FROM items WHERE history_id = ?2;",
+                            -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_int64 (stmt, 1, copy_id);
+        sqlite3_bind_int64 (stmt, 2, source_id);
+        success = (sqlite3_step (stmt) == SQLITE_DONE);
+        g_clear_pointer (&stmt, sqlite3_finalize);
+    }
+    else
+    {
+        success = FALSE;
+    }
+
+    if (success &&
+        sqlite3_prepare_v2 (db,
+                            "INSERT INTO special_values (item_id, position, mime, data, compression) "
+                            "SELECT c.id, sv.position, sv.mime, sv.data, sv.compression FROM special_values sv "
+                            "JOIN items s ON sv.item_id = s.id "
+                            "JOIN items c ON c.history_id = ?1 AND c.uuid = s.uuid "
+                            "WHERE s.history_id = ?2;",
+                            -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_int64 (stmt, 1, copy_id);
+        sqlite3_bind_int64 (stmt, 2, source_id);
+        success = (sqlite3_step (stmt) == SQLITE_DONE);
+        g_clear_pointer (&stmt, sqlite3_finalize);
+    }
+    else
+    {
+        success = FALSE;
+    }
+
+    if (!g_paste_sqlite_backend_finish_transaction (db, success))
+    {
+        /* The copy's history row was resolved, and remembered, inside the
+         * transaction: rolled back, its id names nothing. */
+        g_clear_pointer (&backend->history_name, g_free);
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not copy “%s” to “%s”: %s", name, copy, sqlite3_errmsg (db));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* SQLite's online backup copies the database page by page, from a read-only
+ * connection of its own, into a temporary database renamed over @copy once
+ * complete. Images are blobs in the rows and the encrypted flavour keeps its
+ * salt and key check in the database itself, so the pages are the whole
+ * history: nothing is decrypted or decoded on the way.
+ *
+ * Neither connection is one this instance shares, so the backup runs without
+ * its lock — a large store takes a while, and every other operation would wait
+ * on it. SQLite itself keeps the copy consistent with what is written
+ * meanwhile. Only replacing @copy, whose connection may be cached, takes it. */
+static gboolean
+g_paste_sqlite_backend_copy_history (GPasteStorageBackend *self,
+                                     const gchar          *name,
+                                     const gchar          *copy,
+                                     GError              **error)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    g_paste_sqlite_backend_adopt (self);
+
+    if (g_paste_sqlite_backend_is_single (backend))
+        return g_paste_sqlite_backend_copy_single_history (self, name, copy, error);
+
+    g_clear_pointer (&locker, g_mutex_locker_free);
+
+    g_autofree gchar *source_path = g_paste_storage_backend_get_history_file_path (self, name);
+    g_autofree gchar *copy_path = g_paste_storage_backend_get_history_file_path (self, copy);
+    g_autofree gchar *tmp_path = g_strconcat (copy_path, ".tmp", NULL);
+    g_autoptr (GFile) tmp_file = g_file_new_for_path (tmp_path);
+    sqlite3 *source = NULL;
+    sqlite3 *target = NULL;
+    gint rc;
+
+    /* A leftover from an interrupted copy would be backed up into, not over. */
+    g_file_delete (tmp_file, NULL, NULL);
+
+    if ((rc = sqlite3_open_v2 (source_path, &source, SQLITE_OPEN_READONLY, NULL)) == SQLITE_OK &&
+        (rc = sqlite3_open_v2 (tmp_path, &target, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL)) == SQLITE_OK)
+    {
+        sqlite3_backup *backup = sqlite3_backup_init (target, "main", source, "main");
+
+        if (!backup)
+        {
+            rc = sqlite3_errcode (target);
+        }
+        else
+        {
+            /* Busy or locked only means a writer got in the way: wait it out. */
+            do
+            {
+                rc = sqlite3_backup_step (backup, G_PASTE_SQLITE_BACKUP_STEP_PAGES);
+
+                if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                    sqlite3_sleep (25);
+            } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+
+            gint finished = sqlite3_backup_finish (backup);
+
+            rc = (rc == SQLITE_DONE) ? finished : rc;
+        }
+    }
+
+    if (rc != SQLITE_OK)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not copy “%s” to “%s”: %s",
+                     source_path, copy_path, sqlite3_errstr (rc));
+        sqlite3_close (source);
+        sqlite3_close (target);
+        g_file_delete (tmp_file, NULL, NULL);
+
+        return FALSE;
+    }
+
+    sqlite3_close (source);
+    sqlite3_close (target);
+
+    locker = g_mutex_locker_new (&backend->lock);
+
+    /* The database being replaced must not leave a connection, or a WAL that
+     * would be replayed into its replacement, behind. */
+    g_paste_sqlite_backend_forget (backend, copy_path);
+    g_paste_sqlite_backend_delete_sidecars (copy_path);
+
+    g_autoptr (GFile) copy_file = g_file_new_for_path (copy_path);
+
+    if (!g_file_move (tmp_file, copy_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, error))
+    {
+        g_file_delete (tmp_file, NULL, NULL);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The single database lists its `histories`, plus, until they are taken over,
+ * whatever per-history databases are left beside it: a history is never
+ * missing from the list just because no operation moved it over yet. */
+static GStrv
+g_paste_sqlite_backend_list_histories (GPasteStorageBackend *self,
+                                       GError              **error)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    if (!g_paste_sqlite_backend_is_single (backend))
+        return g_paste_storage_backend_list_history_files (self, error);
+
+    g_auto (GStrv) leftovers = NULL;
+
+    if (!backend->adopted && !(leftovers = g_paste_storage_backend_list_history_files (self, error)))
+        return NULL;
+
+    g_autofree gchar *db_path = g_paste_sqlite_backend_get_single_path (self);
+    g_autoptr (GStrvBuilder) builder = g_strv_builder_new ();
+    gboolean owned;
+    sqlite3 *db = g_paste_sqlite_backend_peek (backend, db_path, &owned);
+
+    if (db)
+    {
+        sqlite3_stmt *stmt = NULL;
+        gint rc = sqlite3_prepare_v2 (db, "SELECT name FROM histories;", -1, &stmt, NULL);
+
+        while (rc == SQLITE_OK && (rc = sqlite3_step (stmt)) == SQLITE_ROW)
+        {
+            const gchar *name = (const gchar *) sqlite3_column_text (stmt, 0);
+
+            rc = SQLITE_OK;
+            if (!leftovers || !g_strv_contains ((const gchar * const *) leftovers, name))
+                g_strv_builder_add (builder, name);
+        }
+
+        if (rc != SQLITE_DONE)
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not list the histories of “%s”: %s", db_path, sqlite3_errmsg (db));
+
+        sqlite3_finalize (stmt);
+
+        if (owned)
+            sqlite3_close (db);
+
+        if (rc != SQLITE_DONE)
+            return NULL;
+    }
+
+    if (leftovers)
+        g_strv_builder_addv (builder, (const gchar **) leftovers);
+
+    return g_strv_builder_end (builder);
+}
+
+static gchar *
+g_paste_sqlite_backend_get_store_path (GPasteStorageBackend *self,
+                                       const gchar          *name)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    return g_paste_sqlite_backend_get_db_path (self, name);
+}
+
+/* The page cache of the open connection, which is all this backend keeps that
+ * the database holds anyway. */
+static gsize
+g_paste_sqlite_backend_release_memory (GPasteStorageBackend *self)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    gint before = 0, after = 0, highwater;
+
+    /* A write or a load in flight is using that cache right now. */
+    if (!g_mutex_trylock (&backend->lock))
+        return 0;
+
+    if (backend->db)
+    {
+        sqlite3_db_status (backend->db, SQLITE_DBSTATUS_CACHE_USED, &before, &highwater, FALSE);
+        sqlite3_db_release_memory (backend->db);
+        sqlite3_db_status (backend->db, SQLITE_DBSTATUS_CACHE_USED, &after, &highwater, FALSE);
+    }
+
+    g_mutex_unlock (&backend->lock);
+
+    return (before > after) ? (gsize) (before - after) : 0;
+}
+
+/***************/
+/* Maintenance */
+/***************/
+
+/* How many virtual machine steps go by between two looks at the deadline, past
+ * which a maintenance statement is interrupted rather than waited for. */
+#define G_PASTE_SQLITE_MAINTENANCE_PROGRESS_STEPS 1000
+
+/* How many free pages a round of incremental vacuum gives back. */
+#define G_PASTE_SQLITE_VACUUM_STEP_PAGES 256
+
+/* How fast a whole VACUUM is assumed to rewrite a database, on the slow side,
+ * to tell whether one fits in what is left of the budget. */
+#define G_PASTE_SQLITE_VACUUM_BYTES_PER_SECOND (16 * 1024 * 1024)
+
+static gint
+g_paste_sqlite_backend_past_deadline (gpointer user_data)
+{
+    const gint64 *deadline = user_data;
+
+    return g_get_monotonic_time () >= *deadline;
+}
+
+/* Run a maintenance statement. Only the deadline interrupting it cuts the run
+ * short: one that fails otherwise would fail again next time just the same. */
+static gboolean
+g_paste_sqlite_backend_maintenance_step (sqlite3     *db,
+                                         const gchar *sql)
+{
+    gchar *err = NULL;
+    gint rc = sqlite3_exec (db, sql, NULL, NULL, &err);
+
+    if (rc != SQLITE_OK && rc != SQLITE_INTERRUPT)
+        g_warning ("sqlite: failed to run “%s”: %s", sql, err);
+
+    sqlite3_free (err);
+
+    return rc != SQLITE_INTERRUPT;
+}
+
+/* The database and its WAL: what the store takes up on disk. */
+static guint64
+g_paste_sqlite_backend_store_size (const gchar *db_path)
+{
+    g_autofree gchar *wal_path = g_strconcat (db_path, "-wal", NULL);
+    const gchar *paths[] = { db_path, wal_path };
+    guint64 size = 0;
+
+    for (guint64 i = 0; i < G_N_ELEMENTS (paths); ++i)
+    {
+        g_autoptr (GFile) file = g_file_new_for_path (paths[i]);
+        g_autoptr (GFileInfo) info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+        if (info)
+            size += g_file_info_get_size (info);
+    }
+
+    return size;
+}
+
+/* Give the free pages back to the filesystem, a round at a time. Only a
+ * database in incremental auto-vacuum mode can, which every one is created in
+ * now; one from before is switched to it by a whole VACUUM, but only when that
+ * looks like it fits in what is left of the budget. An interrupted one would
+ * have rewritten the file for nothing, and would again every run after it, so
+ * one too large is left as it is: SQLite still reuses its free pages. */
+static gboolean
+g_paste_sqlite_backend_vacuum (sqlite3     *db,
+                               const gchar *db_path,
+                               gint64       deadline)
+{
+    if (!g_paste_sqlite_backend_query_int64 (db, "PRAGMA freelist_count;", 0))
+        return TRUE;
+
+    if (g_get_monotonic_time () >= deadline)
+        return FALSE;
+
+    if (g_paste_sqlite_backend_query_int64 (db, "PRAGMA auto_vacuum;", 0) != 2 /* INCREMENTAL */)
+    {
+        gint64 size = g_paste_sqlite_backend_query_int64 (db, "PRAGMA page_count;", 0) *
+                      g_paste_sqlite_backend_query_int64 (db, "PRAGMA page_size;", 0);
+
+        if (size / G_PASTE_SQLITE_VACUUM_BYTES_PER_SECOND * G_USEC_PER_SEC >= deadline - g_get_monotonic_time ())
+        {
+            g_debug ("sqlite: “%s” is too large to switch to incremental vacuum in the time left, leaving its free pages be", db_path);
+            return TRUE;
+        }
+
+        return g_paste_sqlite_backend_maintenance_step (db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;");
+    }
+
+    while (g_paste_sqlite_backend_query_int64 (db, "PRAGMA freelist_count;", 0))
+    {
+        if (g_get_monotonic_time () >= deadline ||
+            !g_paste_sqlite_backend_maintenance_step (db, "PRAGMA incremental_vacuum (" G_STRINGIFY (G_PASTE_SQLITE_VACUUM_STEP_PAGES) ");"))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Vacuum, refresh the statistics the planner goes by (a bounded ANALYZE of
+ * the tables that need it, across the whole database rather than the ones
+ * this connection happened to query) and fold the WAL back into the database.
+ * Ranks are left as they are: they only ever need compacting near the end of
+ * their range, which opening the database sees to. Needs no key, so a
+ * database that is not the one being served gets a connection of its own
+ * rather than a key derivation. */
+static gboolean
+g_paste_sqlite_backend_maintain (GPasteStorageBackend     *self,
+                                 const gchar              *name,
+                                 gint64                    deadline,
+                                 GPasteStorageMaintenance *report)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    g_autofree gchar *db_path = g_paste_sqlite_backend_get_db_path (self, name);
+    gboolean owned = FALSE;
+    sqlite3 *db = NULL;
+
     if (backend->db && g_paste_str_equal (backend->db_path, db_path))
     {
-        g_clear_pointer (&backend->db, g_paste_sqlite_backend_close);
-        g_clear_pointer (&backend->db_path, g_free);
-#ifdef G_PASTE_ENABLE_ENCRYPTION
-        g_clear_pointer (&backend->key, gcr_secure_memory_free);
-#endif
+        db = backend->db;
     }
+    else
+    {
+        if (!g_file_test (db_path, G_FILE_TEST_EXISTS))
+            return TRUE;
 
-    g_autoptr (GFile) db_file = g_file_new_for_path (db_path);
+        if (sqlite3_open_v2 (db_path, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+        {
+            sqlite3_close (db);
+            return TRUE;
+        }
 
-    g_file_delete (db_file, NULL, error);
+        sqlite3_busy_timeout (db, 5000);
+        owned = TRUE;
 
-    static const gchar *sidecars[] = { "-wal", "-shm" };
+        /* Like opening it to serve it: a newer GPaste's database is not ours
+         * to touch. */
+        if (g_paste_sqlite_backend_query_int64 (db, "PRAGMA user_version;", 0) > G_PASTE_SQLITE_SCHEMA_VERSION)
+        {
+            sqlite3_close (db);
+            return TRUE;
+        }
+    }
 
-    for (guint64 i = 0; i < G_N_ELEMENTS (sidecars); ++i)
+    guint64 before = g_paste_sqlite_backend_store_size (db_path);
+
+    sqlite3_progress_handler (db, G_PASTE_SQLITE_MAINTENANCE_PROGRESS_STEPS, g_paste_sqlite_backend_past_deadline, &deadline);
+
+    gboolean complete = g_paste_sqlite_backend_vacuum (db, db_path, deadline) &&
+                        g_paste_sqlite_backend_maintenance_step (db, "PRAGMA analysis_limit = 400; PRAGMA optimize = 0x10002;");
+
+    sqlite3_progress_handler (db, 0, NULL, NULL);
+
+    /* Last, so it folds in whatever the vacuum wrote. Not interruptible, but
+     * bounded by the WAL, which the autocheckpoint keeps small. */
+    if (sqlite3_wal_checkpoint_v2 (db, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL) != SQLITE_OK)
+        g_debug ("sqlite: could not checkpoint “%s”: %s", db_path, sqlite3_errmsg (db));
+
+    if (owned)
+        sqlite3_close (db);
+
+    guint64 after = g_paste_sqlite_backend_store_size (db_path);
+
+    if (before > after)
+        report->reclaimed += before - after;
+
+    return complete;
+}
+
+static gboolean
+g_paste_sqlite_backend_has_history (GPasteStorageBackend *self,
+                                    const gchar          *name)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    g_autofree gchar *file_path = g_paste_storage_backend_get_history_file_path (self, name);
+    gboolean file_exists = g_file_test (file_path, G_FILE_TEST_EXISTS);
+
+    /* The history's own database, or one the per-history layout left behind
+     * and that is not taken over yet. */
+    if (!g_paste_sqlite_backend_is_single (backend) || (!backend->adopted && file_exists))
+        return file_exists;
+
+    g_autofree gchar *db_path = g_paste_sqlite_backend_get_single_path (self);
+    gboolean owned;
+    sqlite3 *db = g_paste_sqlite_backend_peek (backend, db_path, &owned);
+
+    if (!db)
+        return FALSE;
+
+    gboolean found = (g_paste_sqlite_backend_query_history_id (db, name) != 0);
+
+    if (owned)
+        sqlite3_close (db);
+
+    return found;
+}
+
+/* What read_history_file() would return, counted instead of read: every pinned
+ * item, and the others up to the size cap. Needs no key, so the per-history
+ * layout does not derive one just to count a history it is not serving. */
+static gboolean
+g_paste_sqlite_backend_count_history (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      guint64              *length)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id = G_PASTE_SQLITE_OWN_HISTORY_ID;
+    gboolean owned = FALSE;
+    sqlite3 *db;
+
+    if (g_paste_sqlite_backend_is_single (backend))
     {
-        g_autofree gchar *sidecar_path = g_strconcat (db_path, sidecars[i], NULL);
-        g_autoptr (GFile) sidecar = g_file_new_for_path (sidecar_path);
+        g_autofree gchar *db_path = g_paste_sqlite_backend_get_single_path (self);
 
-        /* Only present while a connection is (or was) open, so a missing one is
-         * the normal case and not worth reporting -- the database itself is the
-         * delete that counts, and it reports through @error above. */
-        g_file_delete (sidecar, NULL, NULL);
+        /* The warm connection: counting a history is then one query. Adopting
+         * first, so a history still in its own database is counted here. */
+        g_paste_sqlite_backend_adopt (self);
+        if (!g_file_test (db_path, G_FILE_TEST_EXISTS))
+            return TRUE;
+        if (!(db = g_paste_sqlite_backend_open (self, db_path)))
+            return FALSE;
+
+        /* Counting must not create the history the way opening it does. */
+        history_id = g_paste_sqlite_backend_query_history_id (db, name);
+        if (!history_id)
+            return TRUE;
+    }
+    else
+    {
+        g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, name);
+
+        /* No database, no history: an empty one, as reading it would say. */
+        if (!(db = g_paste_sqlite_backend_peek (backend, db_path, &owned)))
+            return TRUE;
+    }
+
+    GPasteSettings *settings = g_paste_storage_backend_get_settings (self);
+    sqlite3_stmt *stmt = NULL;
+    gboolean counted = FALSE;
+
+    /* A database still on an older schema has no history_id to scope by and
+     * fails to prepare: the caller then reads the history instead. */
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT (SELECT COUNT (*) FROM items WHERE history_id = ?1 AND favourite = 1) + "
+                            "       MIN ((SELECT COUNT (*) FROM items WHERE history_id = ?1 AND favourite = 0), ?2);",
+                            -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_int64 (stmt, 1, history_id);
+        sqlite3_bind_int64 (stmt, 2, g_paste_settings_get_max_history_size (settings));
+
+        if ((counted = (sqlite3_step (stmt) == SQLITE_ROW)))
+            *length = sqlite3_column_int64 (stmt, 0);
+    }
+
+    sqlite3_finalize (stmt);
+
+    if (owned)
+        sqlite3_close (db);
+
+    return counted;
+}
+
+/*************/
+/* Searching */
+/*************/
+
+/* @text as one FTS5 phrase: quoted, its own quotes doubled, so nothing in it is
+ * read as query syntax. NULL when it is shorter than a trigram, which the index
+ * cannot find. */
+static gchar *
+g_paste_sqlite_backend_fts_phrase (const gchar *text)
+{
+    if (g_utf8_strlen (text, -1) < 3)
+        return NULL;
+
+    g_auto (GStrv) parts = g_strsplit (text, "\"", -1);
+    g_autofree gchar *escaped = g_strjoinv ("\"\"", parts);
+
+    return g_strconcat ("\"", escaped, "\"", NULL);
+}
+
+static GStrv
+g_paste_sqlite_backend_search (GPasteStorageBackend *self,
+                               const gchar          *name,
+                               const gchar          *text)
+{
+    g_autofree gchar *phrase = g_paste_sqlite_backend_fts_phrase (text);
+
+    if (!phrase)
+        return NULL;
+
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gint64 history_id;
+    sqlite3 *db = g_paste_sqlite_backend_open_history (self, name, &history_id);
+    sqlite3_stmt *stmt = NULL;
+
+    if (!db || !backend->searchable)
+        return NULL;
+
+    if (sqlite3_prepare_v2 (db,
+                            "SELECT items.uuid FROM items_fts JOIN items ON items.id = items_fts.rowid "
+                            "WHERE items_fts MATCH ?1 AND items.history_id = ?2 ORDER BY items.rank DESC;",
+                            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_warning ("sqlite: failed to prepare search: %s", sqlite3_errmsg (db));
+        return NULL;
+    }
+
+    sqlite3_bind_text (stmt, 1, phrase, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 2, history_id);
+
+    g_autoptr (GStrvBuilder) uuids = g_strv_builder_new ();
+    gint rc;
+
+    while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+        g_strv_builder_add (uuids, (const gchar *) sqlite3_column_text (stmt, 0));
+
+    if (rc != SQLITE_DONE)
+        g_warning ("sqlite: failed to search: %s", sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+
+    return (rc == SQLITE_DONE) ? g_strv_builder_end (uuids) : NULL;
+}
+
+/* Append to @hits the matches of @phrase in @db, best first and at most @limit
+ * of them (every one, if negative) after skipping @offset. The columns are
+ * those read_item() reads, then the history's name and the score, bm25 negated
+ * so that higher is better: the statements differ only in where the name
+ * comes from. */
+static gboolean
+g_paste_sqlite_backend_collect_hits (sqlite3     *db,
+                                     const gchar *sql,
+                                     const gchar *phrase,
+                                     gint64       offset,
+                                     gint64       limit,
+                                     const gchar *name,
+                                     gboolean     images_support,
+                                     GPtrArray   *hits)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    /* A database no build with FTS5 has opened since it gained the items
+     * has no index yet: not an error, but no answer either. */
+    if (sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return FALSE;
+
+    sqlite3_bind_text (stmt, 1, phrase, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 2, limit);
+    sqlite3_bind_int64 (stmt, 3, offset);
+    if (name)
+        sqlite3_bind_text (stmt, 4, name, -1, SQLITE_STATIC);
+
+    gint rc;
+
+    while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+    {
+        GPasteItem *item = g_paste_sqlite_backend_read_item (stmt, NULL, images_support);
+
+        if (!item)
+            continue;
+
+        const gchar *uuid = (const gchar *) sqlite3_column_text (stmt, 1);
+
+        if (uuid && g_uuid_string_is_valid (uuid))
+            g_paste_item_set_uuid (item, uuid);
+
+        g_paste_item_set_favourite (item, sqlite3_column_int (stmt, 8));
+
+        GPasteStorageHit *hit = g_new (GPasteStorageHit, 1);
+
+        hit->history = g_strdup ((const gchar *) sqlite3_column_text (stmt, 10));
+        hit->item = item;
+        hit->score = sqlite3_column_double (stmt, 11);
+        g_ptr_array_add (hits, hit);
     }
+
+    if (rc != SQLITE_DONE)
+        g_warning ("sqlite: failed to search: %s", sqlite3_errmsg (db));
+
+    sqlite3_finalize (stmt);
+
+    return rc == SQLITE_DONE;
+}
+
+static gint
+g_paste_sqlite_backend_compare_hits (gconstpointer a,
+                                     gconstpointer b)
+{
+    const GPasteStorageHit *hit_a = *((const GPasteStorageHit **) a);
+    const GPasteStorageHit *hit_b = *((const GPasteStorageHit **) b);
+
+    /* Best first. */
+    return (hit_a->score < hit_b->score) - (hit_a->score > hit_b->score);
+}
+
+/* The single database ranks everything in one query. Per-history databases are
+ * each asked for as many hits as the page could take from them, and the pages
+ * merged by score: bm25 weighs a term by how rare it is in its own database,
+ * so those scores compare a little less exactly than the single database's,
+ * which is the price of keeping the histories apart. Those are read through
+ * connections of their own, keyless: the index only exists where nothing is
+ * encrypted. */
+static GPtrArray *
+g_paste_sqlite_backend_search_all (GPasteStorageBackend *self,
+                                   const gchar          *text,
+                                   guint64               offset,
+                                   guint64               limit)
+{
+    g_autofree gchar *phrase = g_paste_sqlite_backend_fts_phrase (text);
+
+    if (!phrase || g_paste_sqlite_backend_get_passphrase (self))
+        return NULL;
+
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+    gboolean images_support = g_paste_settings_get_images_support (g_paste_storage_backend_get_settings (self));
+    g_autoptr (GPtrArray) hits = g_ptr_array_new_with_free_func ((GDestroyNotify) g_paste_storage_hit_free);
+    gint64 sql_limit = (limit) ? (gint64) MIN (limit, G_MAXINT64 / 2) : -1;
+
+    /* Leftovers the single database has not taken over would be missed. */
+    g_paste_sqlite_backend_adopt (self);
+
+    if (g_paste_sqlite_backend_is_single (backend))
+    {
+        g_autofree gchar *db_path = g_paste_sqlite_backend_get_single_path (self);
+
+        if (!g_file_test (db_path, G_FILE_TEST_EXISTS))
+            return g_steal_pointer (&hits);
+
+        /* The warm connection, which has the index set up. */
+        sqlite3 *db = g_paste_sqlite_backend_open (self, db_path);
+
+        if (!db || !backend->searchable)
+            return NULL;
+
+        gboolean found = g_paste_sqlite_backend_collect_hits (db,
+                                                              "SELECT items.id, items.uuid, items.kind, items.value, items.date, items.checksum, "
+                                                              "       items.name, items.image, items.favourite, items.compression, histories.name, -bm25 (items_fts) "
+                                                              "FROM items_fts JOIN items ON items.id = items_fts.rowid "
+                                                              "JOIN histories ON histories.id = items.history_id "
+                                                              "WHERE items_fts MATCH ?1 ORDER BY bm25 (items_fts) LIMIT ?2 OFFSET ?3;",
+                                                              phrase, (gint64) MIN (offset, G_MAXINT64 / 2), sql_limit, NULL, images_support, hits);
+
+        return (found) ? g_steal_pointer (&hits) : NULL;
+    }
+
+    g_autoptr (GError) error = NULL;
+    g_auto (GStrv) names = g_paste_storage_backend_list_history_files (self, &error);
+
+    if (!names)
+    {
+        g_warning ("sqlite: could not list the histories to search: %s", error->message);
+        return NULL;
+    }
+
+    /* Any of the first offset + limit hits overall can come from any one
+     * database, so each is asked for that many. */
+    gint64 per_database = (limit) ? (gint64) MIN (offset + limit, G_MAXINT64 / 2) : -1;
+
+    for (GStrv name = names; *name; ++name)
+    {
+        g_autofree gchar *db_path = g_paste_storage_backend_get_history_file_path (self, *name);
+        gboolean owned;
+        sqlite3 *db = g_paste_sqlite_backend_peek (backend, db_path, &owned);
+
+        if (!db)
+            continue;
+
+        gboolean found = g_paste_sqlite_backend_collect_hits (db,
+                                                              "SELECT items.id, items.uuid, items.kind, items.value, items.date, items.checksum, "
+                                                              "       items.name, items.image, items.favourite, items.compression, ?4, -bm25 (items_fts) "
+                                                              "FROM items_fts JOIN items ON items.id = items_fts.rowid "
+                                                              "WHERE items_fts MATCH ?1 ORDER BY bm25 (items_fts) LIMIT ?2 OFFSET ?3;",
+                                                              phrase, 0, per_database, *name, images_support, hits);
+
+        if (owned)
+            sqlite3_close (db);
+
+        /* A partial ranking would silently leave a history out. */
+        if (!found)
+            return NULL;
+    }
+
+    g_ptr_array_sort (hits, g_paste_sqlite_backend_compare_hits);
+
+    g_ptr_array_remove_range (hits, 0, (guint) MIN (offset, hits->len));
+    if (limit && hits->len > limit)
+        g_ptr_array_remove_range (hits, (guint) limit, hits->len - (guint) limit);
+
+    return g_steal_pointer (&hits);
 }
 
 static GPasteStorage
@@ -1637,6 +3897,7 @@ g_paste_sqlite_backend_finalize (GObject *object)
 
     g_clear_pointer (&self->db, g_paste_sqlite_backend_close);
     g_clear_pointer (&self->db_path, g_free);
+    g_clear_pointer (&self->history_name, g_free);
     g_mutex_clear (&self->lock);
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     g_clear_pointer (&self->key, gcr_secure_memory_free);
@@ -1650,43 +3911,52 @@ g_paste_sqlite_backend_finalize (GObject *object)
 /* See the vfunc: only encrypted data this backend's key does not open refutes
  * the passphrase. No crypto parameters (a corrupt or foreign file) and an empty
  * history both say nothing -- the latter gets re-keyed on open instead of
- * locking the user out. */
+ * locking the user out. A history the single database holds is checked against
+ * its one key check, and so is one left in its own database beside it. */
 static gboolean
 g_paste_sqlite_backend_history_refutes_passphrase (GPasteStorageBackend *self,
                                                    const gchar          *name)
 {
-    g_autofree gchar *path = g_paste_storage_backend_get_history_file_path (self, name);
-    sqlite3 *db = NULL;
+    const gchar *passphrase = g_paste_sqlite_backend_get_passphrase (self);
+    g_autofree gchar *file_path = g_paste_storage_backend_get_history_file_path (self, name);
+    gboolean checks_out = FALSE;
+    gboolean has_data = FALSE;
 
-    /* Read-only: verification must never create or touch anything. */
-    if (sqlite3_open_v2 (path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
-    {
-        sqlite3_close (db);
+    if (g_paste_sqlite_backend_probe_passphrase (file_path, passphrase, &checks_out, &has_data) && !checks_out && has_data)
+        return TRUE;
+
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    if (!g_paste_sqlite_backend_is_single (backend))
         return FALSE;
-    }
 
-    guchar salt[crypto_pwhash_SALTBYTES];
-    guint64 opslimit = 0;
-    guint64 memlimit = 0;
-    g_autofree guchar *check = NULL;
-    gsize check_length = 0;
+    g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_path (self);
 
-    if (!g_paste_sqlite_backend_load_crypto_params (db, salt, &opslimit, &memlimit, &check, &check_length))
-    {
-        sqlite3_close (db);
+    return g_paste_sqlite_backend_probe_passphrase (single_path, passphrase, &checks_out, &has_data) && !checks_out && has_data;
+}
+
+/* The single database's key check answers for every history in it, and so
+ * for the whole store once nothing is left in per-history databases. */
+static gboolean
+g_paste_sqlite_backend_store_confirms_passphrase (GPasteStorageBackend *self)
+{
+    GPasteSqliteBackend *backend = G_PASTE_SQLITE_BACKEND (self);
+    g_autoptr (GMutexLocker) locker = g_mutex_locker_new (&backend->lock);
+
+    if (!g_paste_sqlite_backend_is_single (backend))
         return FALSE;
-    }
 
-    const gchar *passphrase = g_paste_sqlite_backend_get_passphrase (self);
-    guchar key[crypto_secretbox_KEYBYTES];
-    gboolean derived = g_paste_sqlite_backend_derive_key (passphrase, salt, opslimit, memlimit, key);
-    gboolean checks_out = derived && g_paste_sqlite_backend_key_checks_out (key, check, check_length);
-    gboolean has_data = g_paste_sqlite_backend_query_int64 (db, "SELECT COUNT (*) FROM items;", 0) > 0;
+    g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_path (self);
+    gboolean checks_out = FALSE;
+    gboolean has_data = FALSE;
 
-    sodium_memzero (key, sizeof (key));
-    sqlite3_close (db);
+    if (!g_paste_sqlite_backend_probe_passphrase (single_path, g_paste_sqlite_backend_get_passphrase (self), &checks_out, &has_data) || !checks_out)
+        return FALSE;
+
+    g_auto (GStrv) leftovers = g_paste_storage_backend_list_history_files (self, NULL);
 
-    return derived && !checks_out && has_data;
+    return leftovers && !*leftovers;
 }
 #endif
 
@@ -1696,18 +3966,34 @@ g_paste_sqlite_backend_class_init (GPasteSqliteBackendClass *klass)
     GPasteStorageBackendClass *storage_class = G_PASTE_STORAGE_BACKEND_CLASS (klass);
 
     storage_class->read_history_file = g_paste_sqlite_backend_read_history_file;
+    storage_class->foreach_item = g_paste_sqlite_backend_foreach_item;
     storage_class->write_history_file = g_paste_sqlite_backend_write_history_file;
     storage_class->get_kind = g_paste_sqlite_backend_get_kind;
     storage_class->delete_history = g_paste_sqlite_backend_delete_history;
+    storage_class->list_histories = g_paste_sqlite_backend_list_histories;
+    storage_class->has_history = g_paste_sqlite_backend_has_history;
+    storage_class->count_history = g_paste_sqlite_backend_count_history;
+    storage_class->get_store_path = g_paste_sqlite_backend_get_store_path;
+    storage_class->search = g_paste_sqlite_backend_search;
+    storage_class->search_all = g_paste_sqlite_backend_search_all;
+    storage_class->copy_history = g_paste_sqlite_backend_copy_history;
+    storage_class->read_history_head = g_paste_sqlite_backend_read_history_head;
+    storage_class->read_history_tail = g_paste_sqlite_backend_read_history_tail;
+    storage_class->read_stored_item = g_paste_sqlite_backend_read_stored_item;
+    storage_class->truncate_history = g_paste_sqlite_backend_truncate_history;
 
     storage_class->add_item = g_paste_sqlite_backend_add_item;
     storage_class->remove_item = g_paste_sqlite_backend_remove_item;
     storage_class->replace_item = g_paste_sqlite_backend_replace_item;
     storage_class->clear_history = g_paste_sqlite_backend_clear_history;
 
+    storage_class->release_memory = g_paste_sqlite_backend_release_memory;
+    storage_class->maintain = g_paste_sqlite_backend_maintain;
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     storage_class->rekey = g_paste_sqlite_backend_rekey;
     storage_class->history_refutes_passphrase = g_paste_sqlite_backend_history_refutes_passphrase;
+    storage_class->store_confirms_passphrase = g_paste_sqlite_backend_store_confirms_passphrase;
 #endif
 
     G_OBJECT_CLASS (klass)->finalize = g_paste_sqlite_backend_finalize;
@@ -1719,6 +4005,25 @@ g_paste_sqlite_backend_init (GPasteSqliteBackend *self)
     g_mutex_init (&self->lock);
 }
 
+/**
+ * g_paste_sqlite_backend_get_single_database_path:
+ * @storage_kind: %G_PASTE_STORAGE_SQLITE or %G_PASTE_STORAGE_ENCRYPTED_SQLITE
+ *
+ * Get the path of the database every history of the @storage_kind flavour
+ * lives in when the "sqlite-single-database" setting is on. Its extension is
+ * deliberately not the per-history one, so it is never listed as a history.
+ *
+ * Returns: (transfer full): the path, free it with g_free
+ */
+G_PASTE_VISIBLE gchar *
+g_paste_sqlite_backend_get_single_database_path (GPasteStorage storage_kind)
+{
+    g_autofree gchar *history_dir_path = g_paste_util_get_history_dir_path ();
+    gboolean encrypted = (storage_kind == G_PASTE_STORAGE_ENCRYPTED_SQLITE);
+
+    return g_build_filename (history_dir_path, (encrypted) ? "histories.sqlites" : "histories.sqlite", NULL);
+}
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 /**
  * g_paste_sqlite_backend_new_encrypted:
@@ -11,6 +11,8 @@ G_BEGIN_DECLS
 
 G_PASTE_FINAL_TYPE (SqliteBackend, sqlite_backend, SQLITE_BACKEND, GPasteStorageBackend)
 
+gchar *g_paste_sqlite_backend_get_single_database_path (GPasteStorage storage_kind);
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 GPasteStorageBackend *g_paste_sqlite_backend_new_encrypted (GPasteSettings *settings,
                                                             const gchar    *passphrase);
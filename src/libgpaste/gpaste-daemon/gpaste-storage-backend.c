@@ -277,6 +277,32 @@ g_paste_storage_backend_get_history_file_path (GPasteStorageBackend *self,
     return g_paste_util_get_history_file_path (name, g_paste_storage_backend_get_extension (self));
 }
 
+/**
+ * g_paste_storage_backend_get_store_path:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of a history
+ *
+ * The file the history called @name is actually kept in: the one
+ * g_paste_storage_backend_get_history_file_path() names, unless the backend
+ * keeps several histories in one store.
+ *
+ * Returns: the newly allocated path
+ */
+G_PASTE_VISIBLE gchar *
+g_paste_storage_backend_get_store_path (GPasteStorageBackend *self,
+                                        const gchar          *name)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (name, NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    if (klass->get_store_path)
+        return klass->get_store_path (self, name);
+
+    return g_paste_storage_backend_get_history_file_path (self, name);
+}
+
 /**
  * g_paste_storage_backend_read_history:
  * @self: a #GPasteItem instance
@@ -310,6 +336,43 @@ g_paste_storage_backend_read_history (GPasteStorageBackend *self,
     return G_PASTE_STORAGE_BACKEND_GET_CLASS (self)->read_history_file (self, name, history, size);
 }
 
+/**
+ * g_paste_storage_backend_foreach_item:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to go through
+ * @func: (scope call): called with each item, which it only borrows
+ * @user_data: the data to pass to @func
+ *
+ * Go through the items g_paste_storage_backend_read_history() would read
+ * back, in the same order, one at a time when the backend can
+ *
+ * Returns: %FALSE when the history is present but could not be read back
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_foreach_item (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      GFunc                 func,
+                                      gpointer              user_data)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (func, FALSE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    if (klass->foreach_item)
+        return klass->foreach_item (self, name, func, user_data);
+
+    GList *history = NULL;
+    gsize size = 0;
+    gboolean read = klass->read_history_file (self, name, &history, &size);
+
+    g_list_foreach (history, func, user_data);
+    g_list_free_full (history, g_object_unref);
+
+    return read;
+}
+
 /**
  * g_paste_storage_backend_write_history:
  * @self: a #GPasteItem instance
@@ -452,13 +515,26 @@ g_paste_storage_backend_delete_history (GPasteStorageBackend *self,
         g_warning ("Could not delete the images of \"%s\": %s", name, images_error->message);
 }
 
-/* The default list_histories: enumerate the history dir for files of this
+/**
+ * g_paste_storage_backend_list_history_files:
+ * @self: a #GPasteStorageBackend instance
+ * @error: return location for a #GError, or %NULL
+ *
+ * The default list_histories: enumerate the history dir for files of this
  * backend's flavour (its get_extension suffix), so e.g. plain ".xml" and
- * encrypted ".xmls" histories never get mixed up. */
-static GStrv
-_g_paste_storage_backend_list_histories_by_extension (GPasteStorageBackend *self,
-                                                      GError              **error)
+ * encrypted ".xmls" histories never get mixed up. Public for a backend that
+ * only keeps a file per history in some of its layouts.
+ *
+ * Returns: (transfer full) (nullable): the names of the history files, or
+ *          %NULL when the directory could not be listed
+ */
+G_PASTE_VISIBLE GStrv
+g_paste_storage_backend_list_history_files (GPasteStorageBackend *self,
+                                            GError              **error)
 {
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (!error || !(*error), NULL);
+
     g_autoptr (GFile) history_dir = g_paste_util_get_history_dir ();
     g_autofree gchar *suffix = g_strconcat (".", g_paste_storage_backend_get_extension (self), NULL);
     gsize suffix_len = strlen (suffix);
@@ -518,7 +594,212 @@ g_paste_storage_backend_list_histories (GPasteStorageBackend *self,
     if (G_PASTE_STORAGE_BACKEND_GET_CLASS (self)->list_histories)
         return G_PASTE_STORAGE_BACKEND_GET_CLASS (self)->list_histories (self, error);
 
-    return _g_paste_storage_backend_list_histories_by_extension (self, error);
+    return g_paste_storage_backend_list_history_files (self, error);
+}
+
+/**
+ * g_paste_storage_backend_has_history:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of a history
+ *
+ * Whether the store holds a history called @name: its file is on disk, or
+ * whatever that means to a store that does not keep one per history.
+ *
+ * Returns: %TRUE when there is a stored history to read back
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_has_history (GPasteStorageBackend *self,
+                                     const gchar          *name)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    if (klass->has_history)
+        return klass->has_history (self, name);
+
+    g_autofree gchar *path = g_paste_storage_backend_get_history_file_path (self, name);
+
+    return g_file_test (path, G_FILE_TEST_EXISTS);
+}
+
+/**
+ * g_paste_storage_backend_count_history:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of a history
+ * @length: (out): how many items the history holds
+ *
+ * Count the items of a stored history without reading it back, for a backend
+ * that can: asking how long a history is should not cost decoding every image
+ * in it. An absent history holds nothing.
+ *
+ * Returns: %FALSE when the backend cannot tell, and the history has to be read
+ *          to know
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_count_history (GPasteStorageBackend *self,
+                                       const gchar          *name,
+                                       guint64              *length)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (length, FALSE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    *length = 0;
+
+    return klass->count_history && klass->count_history (self, name, length);
+}
+
+static void
+g_paste_storage_backend_append_file_stamp (GString     *stamp,
+                                           const gchar *path)
+{
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    g_autoptr (GFileInfo) info = g_file_query_info (file,
+                                                    G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+                                                    G_FILE_ATTRIBUTE_UNIX_INODE ","
+                                                    G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                                    G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                                    G_FILE_ATTRIBUTE_TIME_MODIFIED_NSEC,
+                                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                    NULL, /* cancellable */
+                                                    NULL); /* error */
+
+    g_string_append (stamp, path);
+
+    if (!info)
+    {
+        g_string_append (stamp, ":-;");
+        return;
+    }
+
+    g_string_append_printf (stamp, ":%u:%" G_GUINT64_FORMAT ":%" G_GOFFSET_FORMAT ":%" G_GUINT64_FORMAT ".%u;",
+                            g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE),
+                            g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE),
+                            g_file_info_get_size (info),
+                            g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                            g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_NSEC));
+}
+
+/* @path and the write-ahead log a database there would keep beside it. */
+static void
+g_paste_storage_backend_append_stamp (GString     *stamp,
+                                      const gchar *path)
+{
+    g_autofree gchar *wal = g_strconcat (path, "-wal", NULL);
+
+    g_paste_storage_backend_append_file_stamp (stamp, path);
+    g_paste_storage_backend_append_file_stamp (stamp, wal);
+}
+
+/**
+ * g_paste_storage_backend_dup_stamp:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of a history
+ *
+ * What the files the history called @name is kept in look like right now:
+ * which they are, their size and when they were last written, a write-ahead
+ * log included. Two equal stamps mean nothing was written there in between,
+ * which is what lets a successor daemon trust a history handed over in memory
+ * (see g_paste_history_export_state()) instead of reading it back.
+ *
+ * Returns: the newly allocated stamp
+ */
+G_PASTE_VISIBLE gchar *
+g_paste_storage_backend_dup_stamp (GPasteStorageBackend *self,
+                                   const gchar          *name)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (name, NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+    g_autofree gchar *path = g_paste_storage_backend_get_history_file_path (self, name);
+    g_autofree gchar *store_path = (klass->get_store_path) ? klass->get_store_path (self, name) : NULL;
+    GString *stamp = g_string_new (NULL);
+
+    g_paste_storage_backend_append_stamp (stamp, path);
+
+    /* Both, when they differ: a history can move from the one to the other. */
+    if (store_path && !g_paste_str_equal (store_path, path))
+        g_paste_storage_backend_append_stamp (stamp, store_path);
+
+    return g_string_free (stamp, FALSE);
+}
+
+/**
+ * g_paste_storage_hit_free:
+ * @hit: (transfer full): a #GPasteStorageHit
+ *
+ * Free a match of g_paste_storage_backend_search_all().
+ */
+G_PASTE_VISIBLE void
+g_paste_storage_hit_free (GPasteStorageHit *hit)
+{
+    if (!hit)
+        return;
+
+    g_free (hit->history);
+    g_clear_object (&hit->item);
+    g_free (hit);
+}
+
+/**
+ * g_paste_storage_backend_search:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to search
+ * @text: the text to look for
+ *
+ * Look @text up in the stored history called @name, for a backend that keeps
+ * an index of its items: the caseless substring match a literal search pattern
+ * makes, answered by the store rather than by going through every item.
+ *
+ * Returns: (transfer full) (nullable): the uuids of the matching items, in no
+ *          particular order, or %NULL when the backend cannot answer for @text
+ *          and the items have to be matched one by one
+ */
+G_PASTE_VISIBLE GStrv
+g_paste_storage_backend_search (GPasteStorageBackend *self,
+                                const gchar          *name,
+                                const gchar          *text)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (name, NULL);
+    g_return_val_if_fail (text && g_utf8_validate (text, -1, NULL), NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->search) ? klass->search (self, name, text) : NULL;
+}
+
+/**
+ * g_paste_storage_backend_search_all:
+ * @self: a #GPasteStorageBackend instance
+ * @text: the text to look for
+ * @offset: how many of the best matches to skip
+ * @limit: how many matches to return at most, 0 for all of them
+ *
+ * Look @text up in every stored history at once, the way
+ * g_paste_storage_backend_search() does in one, and rank what it finds.
+ *
+ * Returns: (transfer full) (nullable) (element-type GPasteStorageHit): the
+ *          matches, best first, or %NULL when the backend cannot answer for
+ *          @text
+ */
+G_PASTE_VISIBLE GPtrArray *
+g_paste_storage_backend_search_all (GPasteStorageBackend *self,
+                                    const gchar          *text,
+                                    guint64               offset,
+                                    guint64               limit)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (text && g_utf8_validate (text, -1, NULL), NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->search_all) ? klass->search_all (self, text, offset, limit) : NULL;
 }
 
 /**
@@ -546,6 +827,31 @@ G_PASTE_VISIBLE gboolean
 g_paste_storage_backend_rekey (GPasteStorageBackend *self,
                                const gchar          *name,
                                const gchar          *new_passphrase)
+{
+    return g_paste_storage_backend_rekey_with_progress (self, name, new_passphrase, NULL, NULL);
+}
+
+/**
+ * g_paste_storage_backend_rekey_with_progress:
+ * @self: a #GPasteStorageBackend instance, holding the passphrase @name is
+ *        currently encrypted with
+ * @name: the name of the history to re-encrypt
+ * @new_passphrase: the passphrase to encrypt @name with from now on
+ * @progress: (nullable) (scope call): told how far the re-key got, possibly
+ *            from another thread
+ * @user_data: the data to pass to @progress
+ *
+ * g_paste_storage_backend_rekey(), reporting each step along the way: a large
+ * history takes long enough to re-encrypt for that to be worth showing.
+ *
+ * Returns: %FALSE when @name was left exactly as it was
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_rekey_with_progress (GPasteStorageBackend     *self,
+                                             const gchar              *name,
+                                             const gchar              *new_passphrase,
+                                             GPasteStorageProgressFunc progress,
+                                             gpointer                  user_data)
 {
     g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
     g_return_val_if_fail (name, FALSE);
@@ -557,7 +863,65 @@ g_paste_storage_backend_rekey (GPasteStorageBackend *self,
         return FALSE;
     }
 
-    return G_PASTE_STORAGE_BACKEND_GET_CLASS (self)->rekey (self, name, new_passphrase);
+    return G_PASTE_STORAGE_BACKEND_GET_CLASS (self)->rekey (self, name, new_passphrase, progress, user_data);
+}
+
+/**
+ * g_paste_storage_backend_copy_history:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to copy
+ * @copy: the name to copy it to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Copy a stored history under another name, replacing whatever @copy held. A
+ * backend that can duplicate its store does so directly; the others, and an
+ * absent history, go through reading the items back and writing them out
+ * again. No cap is applied either way: the copy holds what the store did.
+ *
+ * Returns: whether @copy now holds the history
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_copy_history (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      const gchar          *copy,
+                                      GError              **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (copy, FALSE);
+    g_return_val_if_fail (!error || !*error, FALSE);
+
+    if (g_paste_str_equal (name, copy))
+        return TRUE;
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    if (klass->copy_history && g_paste_storage_backend_has_history (self, name))
+    {
+        g_autoptr (GError) copy_error = NULL;
+
+        if (klass->copy_history (self, name, copy, &copy_error))
+            return TRUE;
+
+        if (!g_error_matches (copy_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+            g_propagate_error (error, g_steal_pointer (&copy_error));
+            return FALSE;
+        }
+    }
+
+    g_autolist (GPasteItem) history = NULL;
+    gsize size;
+
+    if (!g_paste_storage_backend_read_history (self, name, &history, &size))
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not read the history “%s” back", name);
+        return FALSE;
+    }
+
+    g_paste_storage_backend_write_history (self, copy, history);
+
+    return TRUE;
 }
 
 /**
@@ -693,6 +1057,193 @@ g_paste_storage_backend_is_incremental (GPasteStorageBackend *self)
     return klass->add_item && klass->remove_item && klass->replace_item && klass->clear_history;
 }
 
+/**
+ * g_paste_storage_backend_has_cold_tier:
+ * @self: a #GPasteStorageBackend instance
+ *
+ * Whether the backend can serve a history a part at a time, so that a history
+ * may keep only its newest items in memory and leave the others to the store:
+ * it implements every one of the partial reads, plus the incremental updates
+ * that keep what it holds in step without a snapshot of everything.
+ *
+ * Returns: %TRUE if the backend can be a history's cold tier
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_has_cold_tier (GPasteStorageBackend *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return klass->read_history_head && klass->read_history_tail && klass->read_stored_item && klass->truncate_history &&
+           g_paste_storage_backend_is_incremental (self);
+}
+
+/**
+ * g_paste_storage_backend_read_history_head:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to load
+ * @length: how many of the items that may stay in the store to read
+ * @history: (out) (element-type GPasteItem): the items read
+ * @size: (out): the size used by those items
+ * @cold_length: (out): how many of those items were left in the store
+ *
+ * Read the head of a history: the @length newest of its items that are neither
+ * a favourite nor a password, along with every one that is, wherever it sits.
+ * Only for a backend g_paste_storage_backend_has_cold_tier() says can.
+ *
+ * Returns: what g_paste_storage_backend_read_history() would
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_read_history_head (GPasteStorageBackend *self,
+                                           const gchar          *name,
+                                           guint64               length,
+                                           GList               **history,
+                                           gsize                *size,
+                                           guint64              *cold_length)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (history && !*history, FALSE);
+    g_return_val_if_fail (size, FALSE);
+    g_return_val_if_fail (cold_length, FALSE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    g_return_val_if_fail (klass->read_history_head, FALSE);
+
+    /* Settled here for the same reason as in read_history(). */
+    *size = 0;
+    *cold_length = 0;
+
+    return klass->read_history_head (self, name, length, history, size, cold_length);
+}
+
+/**
+ * g_paste_storage_backend_read_history_tail:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to read
+ * @offset: how many of the newest such items to skip
+ * @limit: how many items to read at most, 0 for all of them
+ *
+ * Read the items of a history that are neither a favourite nor a password, past
+ * the @offset newest: the part g_paste_storage_backend_read_history_head() left
+ * in the store.
+ *
+ * Returns: (transfer full) (element-type GPasteItem): the items, newest first
+ */
+G_PASTE_VISIBLE GList *
+g_paste_storage_backend_read_history_tail (GPasteStorageBackend *self,
+                                           const gchar          *name,
+                                           guint64               offset,
+                                           guint64               limit)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (name, NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->read_history_tail) ? klass->read_history_tail (self, name, offset, limit) : NULL;
+}
+
+/**
+ * g_paste_storage_backend_read_stored_item:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to read from
+ * @uuid: the uuid of the item to read
+ *
+ * Read one item of a history back from the store, without the others.
+ *
+ * Returns: (transfer full) (nullable): the item, or %NULL when the store holds
+ *          none called @uuid
+ */
+G_PASTE_VISIBLE GPasteItem *
+g_paste_storage_backend_read_stored_item (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          const gchar          *uuid)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), NULL);
+    g_return_val_if_fail (name, NULL);
+    g_return_val_if_fail (uuid, NULL);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->read_stored_item) ? klass->read_stored_item (self, name, uuid) : NULL;
+}
+
+/**
+ * g_paste_storage_backend_truncate_history:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history to truncate
+ * @length: how many of the items that may stay in the store to keep
+ *
+ * Drop the oldest items of a history straight from the store, keeping the
+ * @length newest of those that are neither a favourite nor a password, and
+ * every one that is: the size cap, for the items a history only holds there.
+ */
+G_PASTE_VISIBLE void
+g_paste_storage_backend_truncate_history (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          guint64               length)
+{
+    g_return_if_fail (G_PASTE_IS_STORAGE_BACKEND (self));
+    g_return_if_fail (name);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    if (klass->truncate_history)
+        klass->truncate_history (self, name, length);
+}
+
+/**
+ * g_paste_storage_backend_release_memory:
+ * @self: a #GPasteStorageBackend instance
+ *
+ * Let go of whatever the backend caches in memory and can read back from the
+ * store, for when memory is short. Nothing is lost: only the next reads cost
+ * more.
+ *
+ * Returns: how many bytes that freed
+ */
+G_PASTE_VISIBLE gsize
+g_paste_storage_backend_release_memory (GPasteStorageBackend *self)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), 0);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->release_memory) ? klass->release_memory (self) : 0;
+}
+
+/**
+ * g_paste_storage_backend_maintain:
+ * @self: a #GPasteStorageBackend instance
+ * @name: the name of the history whose store to tidy up
+ * @deadline: when to stop, in g_get_monotonic_time() microseconds
+ * @report: (inout): where to add up what was done
+ *
+ * Give back the space the store of @name no longer uses and drop what failed
+ * writes left beside it, stopping at @deadline. Nothing it does changes what
+ * the store holds, so it can stop anywhere; a backend with nothing to tidy
+ * does nothing.
+ *
+ * Returns: %FALSE when @deadline cut it short
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_backend_maintain (GPasteStorageBackend     *self,
+                                  const gchar              *name,
+                                  gint64                    deadline,
+                                  GPasteStorageMaintenance *report)
+{
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (self), TRUE);
+    g_return_val_if_fail (name, TRUE);
+    g_return_val_if_fail (report, TRUE);
+
+    const GPasteStorageBackendClass *klass = G_PASTE_STORAGE_BACKEND_GET_CLASS (self);
+
+    return (klass->maintain) ? klass->maintain (self, name, deadline, report) : TRUE;
+}
+
 static void
 g_paste_storage_backend_dispose (GObject *object)
 {
@@ -726,12 +1277,25 @@ static void
 g_paste_storage_backend_class_init (GPasteStorageBackendClass *klass)
 {
     klass->read_history_file = NULL;
+    klass->foreach_item = NULL;
     klass->write_history_file = NULL;
     klass->get_kind = NULL;
     klass->delete_history = NULL;
     klass->list_histories = NULL;
     klass->rekey = NULL;
     klass->history_refutes_passphrase = NULL;
+    klass->store_confirms_passphrase = NULL;
+    klass->store_passphrase_confirmed = NULL;
+    klass->has_history = NULL;
+    klass->count_history = NULL;
+    klass->search = NULL;
+    klass->search_all = NULL;
+    klass->copy_history = NULL;
+
+    klass->read_history_head = NULL;
+    klass->read_history_tail = NULL;
+    klass->read_stored_item = NULL;
+    klass->truncate_history = NULL;
 
     klass->add_item = NULL;
     klass->remove_item = NULL;
@@ -839,6 +1403,11 @@ g_paste_storage_passphrase_can_decrypt (GPasteStorage   storage_kind,
     if (!klass->history_refutes_passphrase)
         return TRUE;
 
+    /* One derivation for the whole store, when it keeps a key check and that
+     * check vouches for @passphrase. */
+    if (klass->store_confirms_passphrase && klass->store_confirms_passphrase (backend))
+        return TRUE;
+
     g_autoptr (GError) error = NULL;
     g_auto (GStrv) names = g_paste_storage_backend_list_histories (backend, &error);
 
@@ -861,6 +1430,9 @@ g_paste_storage_passphrase_can_decrypt (GPasteStorage   storage_kind,
             return FALSE;
     }
 
+    if (klass->store_passphrase_confirmed)
+        klass->store_passphrase_confirmed (backend);
+
     return TRUE;
 }
 
@@ -14,6 +14,37 @@ G_BEGIN_DECLS
 
 G_PASTE_DERIVABLE_TYPE (StorageBackend, storage_backend, STORAGE_BACKEND, GObject)
 
+/* One match of g_paste_storage_backend_search_all(): the history it was found
+ * in, the item as it is stored there (its special values left out), and how
+ * well it matched, higher being better. */
+typedef struct
+{
+    gchar      *history;
+    GPasteItem *item;
+    gdouble     score;
+} GPasteStorageHit;
+
+void g_paste_storage_hit_free (GPasteStorageHit *hit);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GPasteStorageHit, g_paste_storage_hit_free)
+
+/* How far a long operation on one history got: @done of @total steps, in
+ * whatever the backend counts its work in. Called from whichever thread does
+ * the work. */
+typedef void (*GPasteStorageProgressFunc) (guint64  done,
+                                           guint64  total,
+                                           gpointer user_data);
+
+/* What g_paste_storage_backend_maintain() did, added up over as many stores as
+ * it was run on. */
+typedef struct
+{
+    guint64  histories; /* how many histories were gone through */
+    guint64  reclaimed; /* bytes given back to the filesystem */
+    guint64  orphans;   /* leftover files nothing referenced, now removed */
+    gboolean complete;  /* whether everything was gone through in time */
+} GPasteStorageMaintenance;
+
 struct _GPasteStorageBackendClass
 {
     GObjectClass parent_class;
@@ -44,6 +75,33 @@ struct _GPasteStorageBackendClass
     GStrv                 (*list_histories) (GPasteStorageBackend *self,
                                              GError               **error);
 
+    /*< protected, optional: reading a history an item at a time >*/
+    /* Hand @func each item read_history_file() would read back, in the same
+     * order, without keeping any of them: @func gets to borrow each in turn, so
+     * going through a large history never holds it all in memory. Returns
+     * %FALSE as read_history_file() does. */
+    gboolean (*foreach_item)         (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      GFunc                 func,
+                                      gpointer              user_data);
+
+    /*< protected, optional: a store that is not one file per history >*/
+    /* Whether the store holds a history called @name. Left unset, that is
+     * whether the file g_paste_storage_backend_get_history_file_path() names
+     * exists, which is all a backend keeping a file per history needs. */
+    gboolean (*has_history)          (GPasteStorageBackend *self,
+                                      const gchar          *name);
+    /* How many items reading @name back would yield, without reading it: a
+     * database counts its rows. %FALSE when it cannot tell. */
+    gboolean (*count_history)        (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      guint64              *length);
+    /* The file the history called @name is actually kept in, when it may not be
+     * the one g_paste_storage_backend_get_history_file_path() names: a database
+     * holding several histories at once. */
+    gchar   *(*get_store_path)       (GPasteStorageBackend *self,
+                                      const gchar          *name);
+
     /*< protected, optional: passphrase verification >*/
     /* Whether the history called @name proves this backend's passphrase wrong:
      * it holds encrypted data the backend cannot open. Everything else -- an
@@ -54,15 +112,27 @@ struct _GPasteStorageBackendClass
      * Only ever asked of a backend built with the passphrase under test. */
     gboolean (*history_refutes_passphrase) (GPasteStorageBackend *self,
                                             const gchar          *name);
+    /* Whether the store keeps a key check of its own that vouches for this
+     * backend's passphrase across all of its histories at once, sparing
+     * history_refutes_passphrase() a round -- and a key derivation -- per
+     * history. %FALSE is no refusal, only "ask the histories". */
+    gboolean (*store_confirms_passphrase)  (GPasteStorageBackend *self);
+    /* No history refuted this backend's passphrase: remember it, for
+     * store_confirms_passphrase() to answer next time. The backend must forget
+     * it as soon as anything is written under another passphrase. */
+    void     (*store_passphrase_confirmed) (GPasteStorageBackend *self);
 
     /*< protected, optional: re-encrypt an existing history under a new key >*/
     /* @self holds the passphrase the history is currently encrypted with; only
      * the encrypted flavors implement this. Returns %FALSE when @name was left
      * as it was, so a caller re-keying several histories can stop instead of
-     * ending up with a set split across two passphrases. */
-    gboolean (*rekey)                (GPasteStorageBackend *self,
-                                      const gchar          *name,
-                                      const gchar          *new_passphrase);
+     * ending up with a set split across two passphrases. @progress, when set,
+     * hears about each step of the way. */
+    gboolean (*rekey)                (GPasteStorageBackend     *self,
+                                      const gchar              *name,
+                                      const gchar              *new_passphrase,
+                                      GPasteStorageProgressFunc progress,
+                                      gpointer                  user_data);
 
     /*< protected, optional: data materialized outside the store >*/
     /* Drop whatever this backend wrote for @item beyond the history itself --
@@ -75,6 +145,68 @@ struct _GPasteStorageBackendClass
                                       const gchar          *name,
                                       GPasteItem           *item);
 
+    /*< protected, optional: copying a stored history as it is >*/
+    /* Copy the history called @name to @copy straight from store to store,
+     * without reading an item back: an I/O-bound copy for a backend that can
+     * duplicate what it wrote. Only asked for a history the store holds. An
+     * error of %G_IO_ERROR_NOT_SUPPORTED means this history needs the
+     * item-by-item copy after all, and leaves @copy for it to write; any other
+     * is the copy failing. */
+    gboolean (*copy_history)         (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      const gchar          *copy,
+                                      GError              **error);
+
+    /*< protected, optional: searching the store itself >*/
+    /* The uuids of the items of @name whose value contains @text, compared
+     * caselessly: what matching it as a literal pattern against every loaded
+     * item would find, without going through them. %NULL when the store cannot
+     * answer for @text -- no index, or one too coarse for it -- and the caller
+     * matches the items itself. */
+    GStrv      (*search)             (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      const gchar          *text);
+    /* The same across every history, best match first: @limit hits (every
+     * one, if 0) after skipping @offset of them, as a #GPtrArray of
+     * #GPasteStorageHit. %NULL as for search(). */
+    GPtrArray *(*search_all)         (GPasteStorageBackend *self,
+                                      const gchar          *text,
+                                      guint64               offset,
+                                      guint64               limit);
+
+    /*< protected, optional: serving a history a part at a time >*/
+    /* For a history keeping only its newest items in memory (the
+     * "resident-history-size" setting), with the rest read back on demand.
+     * The split is over the items that may stay in the store: never a
+     * favourite, never a password, both of which always come back with the head.
+     *
+     * read_history_head() reads what read_history_file() would, but only the
+     * @length newest of those items, and counts the others in @cold_length.
+     * read_history_tail() reads @limit of those others (every one, if 0) past
+     * the @offset newest, newest first. read_stored_item() reads back the item
+     * called @uuid, or %NULL when there is none. truncate_history() drops every
+     * one of them past the @length newest.
+     *
+     * Only worth having for a store that answers each of these without reading
+     * the whole history, and only ever used all four together, on top of the
+     * incremental updates below. */
+    gboolean    (*read_history_head) (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      guint64               length,
+                                      GList               **history,
+                                      gsize                *size,
+                                      guint64              *cold_length);
+    GList      *(*read_history_tail) (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      guint64               offset,
+                                      guint64               limit);
+    GPasteItem *(*read_stored_item)  (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      const gchar          *uuid);
+    void        (*truncate_history)  (GPasteStorageBackend *self,
+                                      const gchar          *name,
+                                      guint64               length);
+
     /*< protected, optional: incremental updates >*/
     /* @history is the whole history as it now stands, for reconciling whatever
      * rode along with the add -- a dedup, a grown line, an eviction. It is
@@ -95,6 +227,26 @@ struct _GPasteStorageBackendClass
                                       GPasteItem           *item);
     void     (*clear_history)        (GPasteStorageBackend *self,
                                       const gchar          *name);
+
+    /*< protected, optional: memory pressure >*/
+    /* Let go of whatever the backend caches and can read back from the store
+     * -- a database's page cache -- and say how many bytes that freed. Called
+     * from the main thread while a write may be running: a backend busy with
+     * its cache keeps it rather than waits. */
+    gsize    (*release_memory)       (GPasteStorageBackend *self);
+
+    /*< protected, optional: idle-time upkeep >*/
+    /* Tidy up the store of the history called @name: give back the space it
+     * no longer uses, refresh what its queries are planned from, drop the
+     * files a failed write left behind. Only ever run from the saver, in order
+     * with the writes, and only worth doing while nobody waits on the store.
+     * Adds what it did to @report, and returns %FALSE when it stopped short at
+     * @deadline (in g_get_monotonic_time() microseconds), leaving the rest for
+     * next time: nothing it does is needed for the store to be right. */
+    gboolean (*maintain)             (GPasteStorageBackend     *self,
+                                      const gchar              *name,
+                                      gint64                    deadline,
+                                      GPasteStorageMaintenance *report);
 };
 
 GPasteSettings *g_paste_storage_backend_get_settings (GPasteStorageBackend *self);
@@ -105,11 +257,17 @@ gboolean       g_paste_storage_backend_is_encrypted  (GPasteStorageBackend *self
 
 gchar *g_paste_storage_backend_get_history_file_path (GPasteStorageBackend *self,
                                                       const gchar          *name);
+gchar *g_paste_storage_backend_get_store_path        (GPasteStorageBackend *self,
+                                                      const gchar          *name);
 
 gboolean g_paste_storage_backend_read_history (GPasteStorageBackend *self,
                                                const gchar          *name,
                                                GList                **history,
                                                gsize                *size);
+gboolean g_paste_storage_backend_foreach_item (GPasteStorageBackend *self,
+                                               const gchar          *name,
+                                               GFunc                 func,
+                                               gpointer              user_data);
 void g_paste_storage_backend_write_history    (GPasteStorageBackend *self,
                                                const gchar          *name,
                                                const GList          *history);
@@ -118,9 +276,34 @@ void g_paste_storage_backend_delete_history   (GPasteStorageBackend *self,
                                                GError               **error);
 GStrv g_paste_storage_backend_list_histories  (GPasteStorageBackend *self,
                                                GError               **error);
+GStrv g_paste_storage_backend_list_history_files (GPasteStorageBackend *self,
+                                                  GError              **error);
+gboolean g_paste_storage_backend_has_history  (GPasteStorageBackend *self,
+                                               const gchar          *name);
+gboolean g_paste_storage_backend_count_history (GPasteStorageBackend *self,
+                                                const gchar          *name,
+                                                guint64              *length);
+gchar   *g_paste_storage_backend_dup_stamp     (GPasteStorageBackend *self,
+                                                const gchar          *name);
+GStrv g_paste_storage_backend_search         (GPasteStorageBackend *self,
+                                               const gchar          *name,
+                                               const gchar          *text);
+GPtrArray *g_paste_storage_backend_search_all (GPasteStorageBackend *self,
+                                               const gchar          *text,
+                                               guint64               offset,
+                                               guint64               limit);
 gboolean g_paste_storage_backend_rekey        (GPasteStorageBackend *self,
                                                const gchar          *name,
                                                const gchar          *new_passphrase);
+gboolean g_paste_storage_backend_rekey_with_progress (GPasteStorageBackend     *self,
+                                                      const gchar              *name,
+                                                      const gchar              *new_passphrase,
+                                                      GPasteStorageProgressFunc progress,
+                                                      gpointer                  user_data);
+gboolean g_paste_storage_backend_copy_history (GPasteStorageBackend *self,
+                                               const gchar          *name,
+                                               const gchar          *copy,
+                                               GError              **error);
 
 void     g_paste_storage_backend_add_item             (GPasteStorageBackend *self,
                                                        const gchar          *name,
@@ -144,6 +327,31 @@ void     g_paste_storage_backend_drop_item_data       (GPasteStorageBackend *sel
 
 gboolean g_paste_storage_backend_is_incremental       (GPasteStorageBackend *self);
 
+gboolean    g_paste_storage_backend_has_cold_tier      (GPasteStorageBackend *self);
+gboolean    g_paste_storage_backend_read_history_head  (GPasteStorageBackend *self,
+                                                        const gchar          *name,
+                                                        guint64               length,
+                                                        GList               **history,
+                                                        gsize                *size,
+                                                        guint64              *cold_length);
+GList      *g_paste_storage_backend_read_history_tail  (GPasteStorageBackend *self,
+                                                        const gchar          *name,
+                                                        guint64               offset,
+                                                        guint64               limit);
+GPasteItem *g_paste_storage_backend_read_stored_item   (GPasteStorageBackend *self,
+                                                        const gchar          *name,
+                                                        const gchar          *uuid);
+void        g_paste_storage_backend_truncate_history   (GPasteStorageBackend *self,
+                                                        const gchar          *name,
+                                                        guint64               length);
+
+gsize g_paste_storage_backend_release_memory (GPasteStorageBackend *self);
+
+gboolean g_paste_storage_backend_maintain (GPasteStorageBackend     *self,
+                                           const gchar              *name,
+                                           gint64                    deadline,
+                                           GPasteStorageMaintenance *report);
+
 void g_paste_storage_backend_lock   (void);
 void g_paste_storage_backend_unlock (void);
 
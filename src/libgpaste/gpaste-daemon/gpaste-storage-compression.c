@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <gpaste-daemon/gpaste-storage-compression.h>
+
+#include <string.h>
+
+#ifdef G_PASTE_ENABLE_ZSTD
+#include <zstd.h>
+
+/* zstd's own default: most of the ratio of the higher levels, at a speed that
+ * keeps a save well under the time it takes to write it out. */
+#define G_PASTE_STORAGE_ZSTD_LEVEL 3
+
+/* What one decompressed payload may claim to be. A clipboard item is bounded by
+ * the "max-text-item-size" setting long before this; a frame header claiming
+ * more is corrupt, and must not get to allocate it. */
+#define G_PASTE_STORAGE_ZSTD_MAX_SIZE (G_GUINT64_CONSTANT (1) << 31)
+#endif
+
+/**
+ * g_paste_storage_compression_is_available:
+ * @compression: a #GPasteCompression
+ *
+ * Whether this build can compress and decompress with @compression.
+ *
+ * Returns: whether @compression is usable
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_compression_is_available (GPasteCompression compression)
+{
+    switch (compression)
+    {
+    case G_PASTE_COMPRESSION_NONE:
+        return TRUE;
+    case G_PASTE_COMPRESSION_ZSTD:
+#ifdef G_PASTE_ENABLE_ZSTD
+        return TRUE;
+#else
+        return FALSE;
+#endif
+    case G_PASTE_N_COMPRESSION:
+        break;
+    }
+
+    return FALSE;
+}
+
+/**
+ * g_paste_storage_compress:
+ * @compression: the #GPasteCompression to use
+ * @data: the payload
+ * @length: the payload's length
+ * @compressed_length: (out): where to store the compressed length
+ *
+ * Compress @data with @compression, when that is worth it: not for a payload
+ * under %G_PASTE_STORAGE_COMPRESSION_MIN_SIZE, nor one that would not shrink,
+ * nor with a codec this build lacks.
+ *
+ * Returns: (nullable): the newly allocated compressed payload, or %NULL when
+ *          @data is to be stored as it is, uncompressed
+ */
+G_PASTE_VISIBLE guchar *
+g_paste_storage_compress (GPasteCompression compression,
+                          gconstpointer     data,
+                          gsize             length,
+                          gsize            *compressed_length)
+{
+    g_return_val_if_fail (compressed_length, NULL);
+
+    if (compression == G_PASTE_COMPRESSION_NONE || length < G_PASTE_STORAGE_COMPRESSION_MIN_SIZE)
+        return NULL;
+
+#ifdef G_PASTE_ENABLE_ZSTD
+    if (compression == G_PASTE_COMPRESSION_ZSTD)
+    {
+        gsize bound = ZSTD_compressBound (length);
+        g_autofree guchar *compressed = g_malloc (bound);
+        /* One shot, so the frame records its content size, which is what
+         * decompressing it sizes its buffer from. */
+        gsize written = ZSTD_compress (compressed, bound, data, length, G_PASTE_STORAGE_ZSTD_LEVEL);
+
+        if (ZSTD_isError (written) || written >= length)
+            return NULL;
+
+        *compressed_length = written;
+
+        return g_realloc (g_steal_pointer (&compressed), written);
+    }
+#else
+    (void) data;
+#endif
+
+    return NULL;
+}
+
+/**
+ * g_paste_storage_decompress:
+ * @compression: the #GPasteCompression @data was stored with
+ * @data: the stored payload
+ * @length: the stored payload's length
+ * @decompressed_length: (out) (optional): where to store the payload's length
+ *
+ * Get back the payload @data was made of. %G_PASTE_COMPRESSION_NONE copies it,
+ * so a caller handles every stored payload alike. The result gets a trailing
+ * NUL, so that it doubles as a string for the text ones.
+ *
+ * Returns: (nullable): the newly allocated payload, or %NULL when @data is
+ *          corrupt or was compressed with a codec this build lacks
+ */
+G_PASTE_VISIBLE guchar *
+g_paste_storage_decompress (GPasteCompression compression,
+                            gconstpointer     data,
+                            gsize             length,
+                            gsize            *decompressed_length)
+{
+    switch (compression)
+    {
+    case G_PASTE_COMPRESSION_NONE:
+    {
+        guchar *copy = g_malloc (length + 1);
+
+        if (length)
+            memcpy (copy, data, length);
+        copy[length] = '\0';
+        if (decompressed_length)
+            *decompressed_length = length;
+
+        return copy;
+    }
+    case G_PASTE_COMPRESSION_ZSTD:
+    {
+#ifdef G_PASTE_ENABLE_ZSTD
+        unsigned long long size = ZSTD_getFrameContentSize (data, length);
+
+        if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size > G_PASTE_STORAGE_ZSTD_MAX_SIZE)
+        {
+            g_warning ("Unusable zstd frame header in a stored item");
+            return NULL;
+        }
+
+        g_autofree guchar *payload = g_malloc (size + 1);
+        gsize read = ZSTD_decompress (payload, size, data, length);
+
+        if (ZSTD_isError (read) || read != size)
+        {
+            g_warning ("Failed to decompress a stored item: %s", ZSTD_isError (read) ? ZSTD_getErrorName (read) : "truncated");
+            return NULL;
+        }
+
+        payload[size] = '\0';
+        if (decompressed_length)
+            *decompressed_length = size;
+
+        return g_steal_pointer (&payload);
+#else
+        g_warning ("A stored item is zstd-compressed, but this GPaste was built without zstd");
+        return NULL;
+#endif
+    }
+    case G_PASTE_N_COMPRESSION:
+        break;
+    }
+
+    g_warning ("A stored item uses an unknown compression: %d", compression);
+
+    return NULL;
+}
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+#include <gpaste-3/gpaste-compression.h>
+
+G_BEGIN_DECLS
+
+/* The codecs behind the "storage-compression" setting, shared by the storage
+ * backends. A payload is compressed on its own -- one item's value, or one of
+ * its special values -- and stored along with the #GPasteCompression it was
+ * compressed with, so each backend tags it in its own format and a store can
+ * mix payloads written under any setting. Compression comes before encryption
+ * in the encrypted flavors: ciphertext does not compress. */
+
+/* Below this, a payload is stored as it is: compressing it saves next to
+ * nothing and costs a codec round trip on every load. */
+#define G_PASTE_STORAGE_COMPRESSION_MIN_SIZE 256
+
+gboolean g_paste_storage_compression_is_available (GPasteCompression compression);
+
+guchar  *g_paste_storage_compress                 (GPasteCompression compression,
+                                                   gconstpointer     data,
+                                                   gsize             length,
+                                                   gsize            *compressed_length);
+guchar  *g_paste_storage_decompress               (GPasteCompression compression,
+                                                   gconstpointer     data,
+                                                   gsize             length,
+                                                   gsize            *decompressed_length);
+
+G_END_DECLS
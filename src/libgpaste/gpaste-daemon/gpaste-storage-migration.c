@@ -10,6 +10,14 @@
 #include <gpaste-daemon/gpaste-storage-backend.h>
 #include <gpaste-daemon/gpaste-storage-migration.h>
 
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+#include <gpaste-daemon/gpaste-secret-stream-converter.h>
+#endif
+
+#ifdef G_PASTE_ENABLE_SQLITE
+#include <gpaste-daemon/gpaste-sqlite-backend.h>
+#endif
+
 #ifdef G_PASTE_ENABLE_LIBSECRET
 #include <gpaste-daemon/gpaste-storage-keyring.h>
 #endif
@@ -95,6 +103,23 @@ detect_current_backend (GPasteSettings *settings,
 
             return TRUE;
         }
+
+#ifdef G_PASTE_ENABLE_SQLITE
+        /* A flavour keeping every history in one database (see the
+         * "sqlite-single-database" setting) has no file per history, but that
+         * one holds the active history too. */
+        if (flavours[i] == G_PASTE_STORAGE_SQLITE || flavours[i] == G_PASTE_STORAGE_ENCRYPTED_SQLITE)
+        {
+            g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_database_path (flavours[i]);
+
+            if (g_file_test (single_path, G_FILE_TEST_EXISTS))
+            {
+                *current = flavours[i];
+
+                return TRUE;
+            }
+        }
+#endif
     }
 
     /* No history under the active name: fall back to whichever flavour has the
@@ -266,52 +291,286 @@ g_paste_storage_migration_needed (GPasteSettings *settings)
     return g_paste_settings_get_storage_backend_revision (settings) != G_PASTE_STORAGE_BACKEND_REVISION;
 }
 
-/* Whether @written faithfully reproduces @source: same kind, same content. The
- * real value carries that for every kind, an image's being its checksum, which
- * is the same string whichever backend the bytes came back from. This
- * deliberately differs from g_paste_item_equals(): that dedup predicate ignores
- * the kind and treats two distinct passwords as never equal, whereas migration
- * must confirm a password's real value round-tripped (an encrypted backend
- * persists it) — so it is not a drop-in replacement here. */
+/* At most this many histories import at once. An encrypted one holds an
+ * Argon2id derivation's worth of memory while it reads or writes, so the pool
+ * stays well short of what a many-core machine would schedule. */
+#define MAX_IMPORT_JOBS 4
+
+/* One import, shared by the jobs running it. Everything below @lock is only
+ * touched with it held. */
+typedef struct
+{
+    GPasteSettings *settings;
+    GPasteStorage   current;
+    const gchar    *current_passphrase;
+    GPasteStorage   chosen;
+    const gchar    *chosen_passphrase;
+    GPastePrompt   *prompt;
+    GMainContext   *context;
+    guint           total;
+
+    GMutex          lock;
+    gboolean        ok;
+    guint           done;
+    guint64         bytes;
+    gint64          start;
+} ImportRun;
+
+/* A progress update on its way to the main thread, where the prompt lives. */
+typedef struct
+{
+    GPastePrompt    *prompt;
+    GPastePromptText title;
+    gdouble          fraction;
+    gchar           *status;
+} StorageProgress;
+
+static void
+storage_progress_free (gpointer data)
+{
+    StorageProgress *progress = data;
+
+    g_object_unref (progress->prompt);
+    g_free (progress->status);
+    g_free (progress);
+}
+
 static gboolean
-imported_item_matches (GPasteItem *source,
-                       GPasteItem *written)
+storage_progress_show (gpointer data)
+{
+    StorageProgress *progress = data;
+
+    g_paste_prompt_progress (progress->prompt, g_paste_prompt_text (progress->title),
+                             progress->fraction, progress->status);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Tell @prompt how far a worker got, from the worker: the prompt is the UI's,
+ * so the update is handed to @context rather than made here. */
+static void
+storage_progress_post (GMainContext    *context,
+                       GPastePrompt    *prompt,
+                       GPastePromptText title,
+                       gdouble          fraction,
+                       gchar           *status) /* (transfer full) */
+{
+    StorageProgress *progress = g_new0 (StorageProgress, 1);
+
+    progress->prompt = g_object_ref (prompt);
+    progress->title = title;
+    progress->fraction = fraction;
+    progress->status = status;
+
+    g_main_context_invoke_full (context, G_PRIORITY_DEFAULT, storage_progress_show, progress, storage_progress_free);
+}
+
+/* The time the whole takes at the pace its first @fraction went since @start,
+ * less what is behind, as "M:SS". */
+static gchar *
+storage_progress_time_left_at (gint64  start,
+                               gdouble fraction)
+{
+    gdouble elapsed = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+    guint left = (fraction > 0) ? (guint) (elapsed * (1 - fraction) / fraction) : 0;
+
+    return g_strdup_printf ("%u:%02u", left / 60, left % 60);
+}
+
+/* As storage_progress_time_left_at(), @done steps out of @total in. */
+static gchar *
+storage_progress_time_left (gint64 start,
+                            guint  done,
+                            guint  total)
+{
+    return storage_progress_time_left_at (start, (gdouble) done / total);
+}
+
+/* How far the import got, from whichever job just finished a history. Called
+ * with @run's lock held, which is what keeps the counts it reads consistent
+ * with each other. */
+static void
+import_progress_post (ImportRun *run)
+{
+    gdouble elapsed = (gdouble) (g_get_monotonic_time () - run->start) / G_USEC_PER_SEC;
+    g_autofree gchar *rate = g_format_size ((guint64) (run->bytes / MAX (elapsed, 1.0)));
+    g_autofree gchar *eta = storage_progress_time_left (run->start, run->done, run->total);
+
+    storage_progress_post (run->context, run->prompt, G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE,
+                           (gdouble) run->done / run->total,
+                           g_strdup_printf (g_paste_prompt_text (G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS),
+                                            run->done, run->total, rate, eta));
+}
+
+static void
+import_digest_field (GChecksum    *digest,
+                     const guchar *data,
+                     gsize         len)
+{
+    guint64 prefix = GUINT64_TO_LE ((guint64) len);
+
+    g_checksum_update (digest, (const guchar *) &prefix, sizeof (prefix));
+    g_checksum_update (digest, data, len);
+}
+
+/* A digest of what makes a history itself, fed an item at a time: each item's
+ * uuid, kind and real value, in order, every field length-prefixed so no two
+ * histories run into the same bytes. The real value carries the content for
+ * every kind, an image's being its checksum, which is the same string whichever
+ * backend the bytes came back from; sizes are left out on purpose, since an
+ * image read back from a database blob carries its PNG bytes while a path-based
+ * one does not. Passwords are skipped when @skip_passwords, which is how the
+ * expected side matches a destination that never stores them. */
+typedef struct
+{
+    GChecksum *checksum;
+    gboolean   skip_passwords;
+} ImportDigest;
+
+static void
+import_digest_item (gpointer data,
+                    gpointer user_data)
+{
+    GPasteItem *item = data;
+    ImportDigest *digest = user_data;
+    guint8 kind = (guint8) g_paste_item_get_kind (item);
+
+    if (digest->skip_passwords && kind == G_PASTE_ITEM_KIND_PASSWORD)
+        return;
+
+    const gchar *uuid = g_paste_item_get_uuid (item);
+    const gchar *value = g_paste_item_get_real_value (item);
+
+    import_digest_field (digest->checksum, (const guchar *) uuid, strlen (uuid));
+    import_digest_field (digest->checksum, &kind, sizeof (kind));
+    import_digest_field (digest->checksum, (const guchar *) value, strlen (value));
+}
+
+/**
+ * g_paste_storage_migration_import_history:
+ * @from: the #GPasteStorageBackend to copy out of
+ * @to: the #GPasteStorageBackend to copy into
+ * @name: the name of the history to copy
+ * @size: (out): the size of the history copied
+ *
+ * Copy history @name from @from into @to and check it reads back as what was
+ * written: same items, same order, same contents. The check compares digests,
+ * the one of the read-back taken as @to hands its items over one at a time, so
+ * the source is gone before the read-back starts and a large history is never
+ * held twice.
+ *
+ * What is deliberately not a failure is @to dropping what it cannot store:
+ * only the plain flavors, which never persist passwords. An encrypted
+ * destination does, so a password missing there *is* one.
+ *
+ * Returns: whether the history was read, written and verified
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_storage_migration_import_history (GPasteStorageBackend *from,
+                                          GPasteStorageBackend *to,
+                                          const gchar          *name,
+                                          gsize                *size)
 {
-    if (g_paste_item_get_kind (source) != g_paste_item_get_kind (written))
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (from), FALSE);
+    g_return_val_if_fail (G_PASTE_IS_STORAGE_BACKEND (to), FALSE);
+    g_return_val_if_fail (name, FALSE);
+    g_return_val_if_fail (size, FALSE);
+
+    GList *history = NULL;
+
+    /* Never let a source we could not actually read (a wrong passphrase, a
+     * transient I/O error) pass as an empty history: writing that "empty"
+     * into the destination and reporting success would let the caller delete
+     * the still-intact originals. */
+    if (!g_paste_storage_backend_read_history (from, name, &history, size))
+    {
+        g_list_free_full (history, g_object_unref);
         return FALSE;
+    }
+
+    g_paste_storage_backend_write_history (to, name, history);
+
+    ImportDigest expected = { g_checksum_new (G_CHECKSUM_SHA256), !g_paste_storage_backend_is_encrypted (to) };
+
+    g_list_foreach (history, import_digest_item, &expected);
+    g_list_free_full (history, g_object_unref);
+
+    ImportDigest actual = { g_checksum_new (G_CHECKSUM_SHA256), FALSE };
+    gboolean read = g_paste_storage_backend_foreach_item (to, name, import_digest_item, &actual);
+    gboolean same = read && g_paste_str_equal (g_checksum_get_string (expected.checksum), g_checksum_get_string (actual.checksum));
+
+    g_checksum_free (expected.checksum);
+    g_checksum_free (actual.checksum);
+
+    return same;
+}
+
+/* Copy history @name into @run's destination and verify it (see
+ * g_paste_storage_migration_import_history()). Each call builds its own
+ * backends: the sqlite ones cache a connection per database, which two jobs
+ * must not share. */
+static gboolean
+import_history (ImportRun   *run,
+                const gchar *name,
+                gsize       *size)
+{
+    g_autoptr (GPasteStorageBackend) previous = g_paste_storage_backend_new_with_passphrase (run->current, run->settings, run->current_passphrase);
+    g_autoptr (GPasteStorageBackend) next = g_paste_storage_backend_new_with_passphrase (run->chosen, run->settings, run->chosen_passphrase);
+
+    return g_paste_storage_migration_import_history (previous, next, name, size);
+}
+
+static void
+import_job_run (gpointer data,
+                gpointer user_data)
+{
+    const gchar *name = data;
+    ImportRun *run = user_data;
+
+    /* Once one history failed the import as a whole has: the rest is not
+     * worth the key derivations, the originals are kept either way. */
+    g_mutex_lock (&run->lock);
+    gboolean go = run->ok;
+    g_mutex_unlock (&run->lock);
+
+    if (!go)
+        return;
+
+    gsize size = 0;
+    gboolean ok = import_history (run, name, &size);
+
+    g_mutex_lock (&run->lock);
 
-    return g_paste_str_equal (g_paste_item_get_real_value (source), g_paste_item_get_real_value (written));
+    if (!ok)
+        run->ok = FALSE;
+    else
+    {
+        ++run->done;
+        run->bytes += size;
+        import_progress_post (run);
+    }
+
+    g_mutex_unlock (&run->lock);
 }
 
-/* Returns TRUE only if every history was copied into @chosen and reads back
- * with the same items — matched by uuid in order, contents verified — so the
- * caller never deletes the originals on a genuinely failed write (e.g. an
- * encrypted write that ran out of memory deriving the key, or a row that
- * committed with a corrupt payload). Two things are deliberately not failures:
- * the destination legitimately dropping items it cannot store (only the plain
- * flavors, which never persist passwords — an encrypted destination does, so a
- * password missing there *is* a failure), and in-memory sizes differing across
- * backends (an image read back from a database blob carries its PNG bytes
- * while a path-based one does not). */
+/* Returns TRUE only if every history was copied into @chosen and verified (see
+ * import_history()), so the caller never deletes the originals on a genuinely
+ * failed write (e.g. an encrypted write that ran out of memory deriving the
+ * key, or a row that committed with a corrupt payload). Histories are
+ * independent of each other, so they import side by side on a small pool,
+ * reporting each one done to @prompt. */
 static gboolean
 import_histories (GPasteSettings *settings,
                   GPasteStorage   current,
                   const gchar    *current_passphrase,
                   GPasteStorage   chosen,
-                  const gchar    *chosen_passphrase)
+                  const gchar    *chosen_passphrase,
+                  GPastePrompt   *prompt,
+                  GMainContext   *context)
 {
-    /* Both keys are passed explicitly: source and destination may both be
-     * encrypted under two different passphrases, which the single process-wide
-     * one cannot express. */
     g_autoptr (GPasteStorageBackend) previous = g_paste_storage_backend_new_with_passphrase (current, settings, current_passphrase);
-    g_autoptr (GPasteStorageBackend) next = g_paste_storage_backend_new_with_passphrase (chosen, settings, chosen_passphrase);
     g_autoptr (GError) error = NULL;
     g_auto (GStrv) names = g_paste_storage_backend_list_histories (previous, &error);
-    /* Only the plain flavors drop password items; an encrypted destination stores
-     * them, so a password missing from the read-back is a genuine write failure
-     * there and must not be waved through (the caller may then delete the source). */
-    const gboolean chosen_stores_passwords = g_paste_storage_is_encrypted (chosen);
-    gboolean ok = TRUE;
 
     /* A source we could not even list is not an empty one: importing nothing and
      * reporting success would let the caller delete histories still on disk. */
@@ -321,52 +580,35 @@ import_histories (GPasteSettings *settings,
         return FALSE;
     }
 
-    for (GStrv name = names; ok && *name; ++name)
-    {
-        GList *history = NULL;
-        gsize size = 0;
-
-        /* Never let a source we could not actually read (a wrong passphrase, a
-         * transient I/O error) pass as an empty history: writing that "empty"
-         * into the destination and reporting success would let the caller delete
-         * the still-intact originals. Bail out instead so the migration is kept
-         * for a retry with the data untouched. */
-        if (!g_paste_storage_backend_read_history (previous, *name, &history, &size))
-        {
-            g_list_free_full (history, g_object_unref);
-            ok = FALSE;
-            break;
-        }
-
-        g_paste_storage_backend_write_history (next, *name, history);
-
-        GList *written = NULL;
-        gsize written_size = 0;
-
-        g_paste_storage_backend_read_history (next, *name, &written, &written_size);
+    /* Both keys are passed explicitly: source and destination may both be
+     * encrypted under two different passphrases, which the single process-wide
+     * one cannot express. */
+    ImportRun run = {
+        .settings = settings,
+        .current = current,
+        .current_passphrase = current_passphrase,
+        .chosen = chosen,
+        .chosen_passphrase = chosen_passphrase,
+        .prompt = prompt,
+        .context = context,
+        .total = g_strv_length (names),
+        .ok = TRUE,
+        .start = g_get_monotonic_time (),
+    };
 
-        const GList *w = written;
+    g_mutex_init (&run.lock);
 
-        for (const GList *h = history; ok && h; h = g_list_next (h))
-        {
-            if (w && g_paste_str_equal (g_paste_item_get_uuid (h->data), g_paste_item_get_uuid (w->data)))
-            {
-                ok = imported_item_matches (h->data, w->data);
-                w = g_list_next (w);
-            }
-            else
-                ok = !chosen_stores_passwords && g_paste_item_get_kind (h->data) == G_PASTE_ITEM_KIND_PASSWORD;
-        }
+    /* Not exclusive, so this cannot fail. */
+    GThreadPool *pool = g_thread_pool_new (import_job_run, &run, MIN ((gint) g_get_num_processors (), MAX_IMPORT_JOBS), FALSE, NULL);
 
-        /* Nothing may read back that was not written. */
-        if (w)
-            ok = FALSE;
+    for (GStrv name = names; *name; ++name)
+        g_thread_pool_push (pool, *name, NULL);
 
-        g_list_free_full (written, g_object_unref);
-        g_list_free_full (history, g_object_unref);
-    }
+    /* Waits for every queued history, which is what lets @run live here. */
+    g_thread_pool_free (pool, FALSE, TRUE);
+    g_mutex_clear (&run.lock);
 
-    return ok;
+    return run.ok;
 }
 
 /* Delete what the import copied out of. %FALSE, with @error saying what first
@@ -426,6 +668,8 @@ typedef struct
     GPasteStorage     chosen;
     GPastePassphrase *current_passphrase;
     GPastePassphrase *chosen_passphrase;
+    GPastePrompt     *prompt;
+    GMainContext     *context;
 } ImportWork;
 
 static void
@@ -435,18 +679,20 @@ import_work_free (gpointer data)
 
     g_paste_passphrase_free (work->current_passphrase);
     g_paste_passphrase_free (work->chosen_passphrase);
+    g_object_unref (work->prompt);
+    g_main_context_unref (work->context);
     g_object_unref (work->settings);
     g_free (work);
 }
 
-/* Runs on a worker thread. Importing an encrypted history derives an Argon2id
- * key per stream — read the source, write the destination, read it back to
- * verify — at MODERATE limits, so a few hundred milliseconds and a few hundred
- * megabytes each, several times over per history. On the main loop that is a
- * frozen daemon; hosted inside gnome-shell it is a frozen desktop, which is
- * what this exists to avoid. Nothing else touches the store meanwhile: a
- * migration runs before the daemon is built, or after it has been flushed and
- * stopped. */
+/* Runs on a worker thread. Importing an encrypted history reads the source,
+ * writes the destination and reads it back to verify, each stream sealed under
+ * a key taken from its store's passphrase — an Argon2id derivation at MODERATE
+ * limits the first time, so a few hundred milliseconds and a few hundred
+ * megabytes. On the main loop that is a frozen daemon; hosted inside
+ * gnome-shell it is a frozen desktop, which is what this exists to avoid.
+ * Nothing else touches the store meanwhile: a migration runs before the daemon
+ * is built, or after it has been flushed and stopped. */
 static void
 import_work_run (GTask        *task,
                  gpointer      source      G_GNUC_UNUSED,
@@ -459,7 +705,9 @@ import_work_run (GTask        *task,
                                                    work->current,
                                                    g_paste_passphrase_peek (work->current_passphrase),
                                                    work->chosen,
-                                                   g_paste_passphrase_peek (work->chosen_passphrase)));
+                                                   g_paste_passphrase_peek (work->chosen_passphrase),
+                                                   work->prompt,
+                                                   work->context));
 }
 
 /* Everything after the import: settings, cleanup and keyring, all back on the
@@ -569,9 +817,14 @@ on_import_done (GObject      *source G_GNUC_UNUSED,
                 GAsyncResult *result,
                 gpointer      user_data)
 {
+    MigrationData *self = user_data;
+
+    /* Done either way, so whatever shows the progress can go. */
+    g_paste_prompt_progress (self->prompt, g_paste_prompt_text (G_PASTE_PROMPT_TEXT_MIGRATION_PROGRESS_TITLE), 1, NULL);
+
     /* The worker only ever returns a boolean (see import_work_run), never an
      * error, so there is none to propagate. */
-    apply_migration_settle (user_data, g_task_propagate_boolean (G_TASK (result), NULL));
+    apply_migration_settle (self, g_task_propagate_boolean (G_TASK (result), NULL));
 }
 
 static void
@@ -590,6 +843,9 @@ apply_migration (MigrationData *self)
     ImportWork *work = g_new0 (ImportWork, 1);
 
     work->settings = g_object_ref (self->settings);
+    work->prompt = g_object_ref (self->prompt);
+    /* Where progress goes back to: this thread's, whichever that is. */
+    work->context = g_main_context_ref_thread_default ();
     work->current = self->current;
     work->chosen = self->chosen;
 #ifdef G_PASTE_ENABLE_ENCRYPTION
@@ -1073,6 +1329,9 @@ typedef struct
     GPastePassphrase              *new_passphrase;
     GPasteStorageRemember          remember;
 
+    /* Where the worker's progress goes back to, once there is a worker. */
+    GMainContext                  *context;
+
     /* Set by the worker when a failed re-key could not be undone either, so the
      * histories are left split across two passphrases. Written on the worker
      * thread and read once it has completed, which the task's completion orders
@@ -1090,6 +1349,7 @@ rekey_finish (RekeyData *self,
 
     g_paste_passphrase_free (self->current_passphrase);
     g_paste_passphrase_free (self->new_passphrase);
+    g_clear_pointer (&self->context, g_main_context_unref);
     g_object_unref (self->settings);
     g_object_unref (self->prompt);
     g_free (self);
@@ -1097,27 +1357,57 @@ rekey_finish (RekeyData *self,
     storage_concern_return (task, error);
 }
 
-/* Re-encrypt every history of the current flavor with @passphrase. Each one is
- * re-keyed atomically, but they go one at a time: stop at the first failure
- * rather than carrying on, so what is left is "these are on the new passphrase,
- * those are still on the old" — recoverable by running again — instead of a set
- * silently split further apart. */
+/* Where the forward pass is: which history, out of how many, since when. */
+typedef struct
+{
+    RekeyData *data;
+    guint      index;
+    guint      n_histories;
+    gint64     start;
+} RekeyProgress;
+
+/* How far the history being re-keyed got, from its backend, as a share of the
+ * whole run: one history's worth of a large store can take minutes. */
+static void
+rekey_progress_post (guint64  done,
+                     guint64  total,
+                     gpointer user_data)
+{
+    RekeyProgress *progress = user_data;
+    gdouble fraction = (progress->index + (total ? (gdouble) done / total : 1)) / progress->n_histories;
+    g_autofree gchar *eta = storage_progress_time_left_at (progress->start, fraction);
+
+    storage_progress_post (progress->data->context, progress->data->prompt, G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE,
+                           fraction,
+                           g_strdup_printf (g_paste_prompt_text (G_PASTE_PROMPT_TEXT_REKEY_PROGRESS),
+                                            progress->index, progress->n_histories, eta));
+}
+
 /* Re-key @name on its own backend: a backend caches whatever it last opened, so
  * giving each history a fresh one keeps a re-keyed database from being reopened
- * through an instance that still holds the old key. */
+ * through an instance that still holds the old key. @progress, if any, hears
+ * about every batch. */
 static gboolean
-rekey_history (RekeyData   *self,
-               const gchar *name,
-               const gchar *from,
-               const gchar *to)
+rekey_history (RekeyData     *self,
+               const gchar   *name,
+               const gchar   *from,
+               const gchar   *to,
+               RekeyProgress *progress) /* (nullable) */
 {
     g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (self->storage_kind,
                                                                                             self->settings,
                                                                                             from);
 
-    return g_paste_storage_backend_rekey (backend, name, to);
+    return g_paste_storage_backend_rekey_with_progress (backend, name, to,
+                                                        (progress) ? rekey_progress_post : NULL, progress);
 }
 
+/* Re-encrypt every history of the current flavor with @passphrase. Each one is
+ * re-keyed atomically, spreading its own work across cores, but they go one at
+ * a time: stop at the first failure rather than carrying on, so what is left is
+ * "these are on the new passphrase, those are still on the old" — recoverable
+ * by running again — instead of a set silently split further apart. Every
+ * batch of each one is reported to the prompt. */
 static gboolean
 rekey_histories (RekeyData   *self,
                  const gchar *passphrase,
@@ -1140,10 +1430,28 @@ rekey_histories (RekeyData   *self,
         return FALSE;
     }
 
+    RekeyProgress progress = {
+        .data = self,
+        .index = 0,
+        .n_histories = g_strv_length (names),
+        .start = g_get_monotonic_time (),
+    };
+
     for (GStrv name = names; *name; ++name)
     {
-        if (rekey_history (self, *name, current, passphrase))
+        progress.index = (guint) (name - names);
+
+        if (rekey_history (self, *name, current, passphrase, &progress))
+        {
+            guint done = progress.index + 1;
+            g_autofree gchar *eta = storage_progress_time_left (progress.start, done, progress.n_histories);
+
+            storage_progress_post (self->context, self->prompt, G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE,
+                                   (gdouble) done / progress.n_histories,
+                                   g_strdup_printf (g_paste_prompt_text (G_PASTE_PROMPT_TEXT_REKEY_PROGRESS),
+                                                    done, progress.n_histories, eta));
             continue;
+        }
 
         /* Put the ones that did move back on the passphrase they all still
          * shared a moment ago, rather than leave the set split between two — a
@@ -1152,7 +1460,7 @@ rekey_histories (RekeyData   *self,
          * or not at all, so the failing one needs nothing undone. */
         for (GStrv done = names; done != name; ++done)
         {
-            if (rekey_history (self, *done, passphrase, current))
+            if (rekey_history (self, *done, passphrase, current, NULL))
                 continue;
 
             g_warning ("The history \"%s\" is left on the new passphrase while the others keep the old one", *done);
@@ -1211,6 +1519,9 @@ on_rekey_done (GObject      *source G_GNUC_UNUSED,
     RekeyData *self = user_data;
     g_autoptr (GError) error = NULL;
 
+    /* Done either way, so whatever shows the progress can go. */
+    g_paste_prompt_progress (self->prompt, g_paste_prompt_text (G_PASTE_PROMPT_TEXT_REKEY_PROGRESS_TITLE), 1, NULL);
+
     if (g_task_propagate_boolean (G_TASK (result), &error))
     {
         const gchar *cleartext = g_paste_passphrase_peek (self->new_passphrase);
@@ -1218,6 +1529,10 @@ on_rekey_done (GObject      *source G_GNUC_UNUSED,
         g_paste_storage_backend_set_passphrase (cleartext);
 
         remember_passphrase (self->remember, cleartext);
+
+        /* Nothing is encrypted under the old passphrase any more: its master
+         * key has no business staying in memory. */
+        g_paste_secret_stream_converter_forget_keys ();
     }
     else
     {
@@ -1275,11 +1590,12 @@ on_rekey_passphrase_set (GObject      *source,
     }
 
     /* Re-encrypting every history derives an Argon2id key per history, twice
-     * over when one fails and the rest have to be put back — the same reason
-     * the import runs off the main loop. Keep the passphrase and the choice
+     * over when one fails and the rest have to be put back, then rewrites all
+     * of its content — the same reason the import runs off the main loop. Keep the passphrase and the choice
      * alive across the hop; the rest is decided back here. */
     self->new_passphrase = g_paste_passphrase_copy (passphrase);
     self->remember = remember;
+    self->context = g_main_context_ref_thread_default ();
 
     g_autoptr (GTask) task = g_task_new (NULL, NULL, on_rekey_done, self);
 
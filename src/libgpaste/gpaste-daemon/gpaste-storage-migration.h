@@ -6,6 +6,7 @@
 #include <gpaste-3/gpaste-settings.h>
 
 #include <gpaste-daemon/gpaste-prompt.h>
+#include <gpaste-daemon/gpaste-storage-backend.h>
 
 G_BEGIN_DECLS
 
@@ -80,4 +81,11 @@ void     g_paste_storage_rekey_async  (GPastePrompt        *prompt,
 gboolean g_paste_storage_rekey_finish (GAsyncResult        *result,
                                        GError             **error);
 
+/* One history's worth of a migration: copy @name from @from into @to and
+ * check, through a digest of each side, that it reads back as written. */
+gboolean g_paste_storage_migration_import_history (GPasteStorageBackend *from,
+                                                   GPasteStorageBackend *to,
+                                                   const gchar          *name,
+                                                   gsize                *size);
+
 G_END_DECLS
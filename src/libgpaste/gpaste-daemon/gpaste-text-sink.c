@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <gpaste-daemon/gpaste-text-sink.h>
+
+/* Where the clipboard providers read text into. Both used to read the whole
+ * thing before looking at it, so someone copying a 500 MB log had the daemon
+ * allocate and validate all of it just to find it over max-text-item-size.
+ * This stream checks as it is written to: the write that would take it past
+ * its cap fails, and so does the one carrying invalid UTF-8, which aborts the
+ * transfer feeding it (a splice, a MetaSelection transfer) right there.
+ *
+ * It is a #GMemoryOutputStream underneath, so it is pollable and every write
+ * lands on the thread that made it rather than on a worker. */
+struct _GPasteTextSink
+{
+    GMemoryOutputStream parent_instance;
+
+    gsize max_size;
+    /* How much of the data is known to be valid UTF-8. Anything past it is the
+     * start of a character the next write has the rest of. */
+    gsize validated;
+};
+
+G_PASTE_DEFINE_TYPE (TextSink, text_sink, G_TYPE_MEMORY_OUTPUT_STREAM)
+
+/* Validate what was written since last time, leaving a character cut short by
+ * the end of the data for the next write to complete. */
+static gboolean
+g_paste_text_sink_validate (GPasteTextSink *self,
+                            GError        **error)
+{
+    GMemoryOutputStream *stream = G_MEMORY_OUTPUT_STREAM (self);
+    const gchar *data = g_memory_output_stream_get_data (stream);
+    gsize size = g_memory_output_stream_get_data_size (stream);
+    const gchar *start = data + self->validated;
+    const gchar *end;
+
+    if (g_utf8_validate_len (start, size - self->validated, &end))
+    {
+        self->validated = size;
+        return TRUE;
+    }
+
+    self->validated = end - data;
+
+    /* Only the last few bytes can be a character still missing its end, which
+     * -2 says they are. Anything else is garbage, an embedded NUL included, as
+     * g_utf8_validate() has always had it (and which -2 would also describe). */
+    gsize rest = size - self->validated;
+
+    if (*end == '\0' || rest >= 4 || g_utf8_get_char_validated (end, (gssize) rest) != (gunichar) -2)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Text is not valid UTF-8");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gssize
+g_paste_text_sink_write (GOutputStream *stream,
+                         const void    *buffer,
+                         gsize          count,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+    GPasteTextSink *self = G_PASTE_TEXT_SINK (stream);
+    gsize size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
+
+    if (count > self->max_size - size)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                     "Text is larger than %" G_GSIZE_FORMAT " bytes", self->max_size);
+        return -1;
+    }
+
+    gssize written = G_OUTPUT_STREAM_CLASS (g_paste_text_sink_parent_class)->write_fn (stream, buffer, count, cancellable, error);
+
+    if (written < 0 || !g_paste_text_sink_validate (self, error))
+        return -1;
+
+    return written;
+}
+
+/**
+ * g_paste_text_sink_finish:
+ * @self: a #GPasteTextSink instance
+ * @error: return location for a #GError, or %NULL
+ *
+ * Close @self if it is not already and take the text written to it, once
+ * whatever fed it is done.
+ *
+ * Returns: (transfer full) (nullable): the text, valid UTF-8 and not
+ *          NUL-terminated, or %NULL with @error set if it stopped in the
+ *          middle of a character
+ */
+G_PASTE_VISIBLE GBytes *
+g_paste_text_sink_finish (GPasteTextSink *self,
+                          GError        **error)
+{
+    g_return_val_if_fail (G_PASTE_IS_TEXT_SINK (self), NULL);
+    g_return_val_if_fail (!error || !*error, NULL);
+
+    GMemoryOutputStream *stream = G_MEMORY_OUTPUT_STREAM (self);
+
+    /* Closing a #GMemoryOutputStream cannot fail. */
+    g_output_stream_close (G_OUTPUT_STREAM (self), NULL, NULL);
+
+    if (self->validated != g_memory_output_stream_get_data_size (stream))
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Text ends in the middle of a character");
+        return NULL;
+    }
+
+    return g_memory_output_stream_steal_as_bytes (stream);
+}
+
+static void
+g_paste_text_sink_class_init (GPasteTextSinkClass *klass)
+{
+    G_OUTPUT_STREAM_CLASS (klass)->write_fn = g_paste_text_sink_write;
+}
+
+static void
+g_paste_text_sink_init (GPasteTextSink *self G_GNUC_UNUSED)
+{
+}
+
+/**
+ * g_paste_text_sink_new:
+ * @max_size: how many bytes of text to accept at most
+ *
+ * Create a new #GPasteTextSink: an in-memory stream to read clipboard text
+ * into, which fails the write that would take it past @max_size or that
+ * carries invalid UTF-8.
+ *
+ * Returns: a newly allocated #GPasteTextSink
+ *          free it with g_object_unref
+ */
+G_PASTE_VISIBLE GOutputStream *
+g_paste_text_sink_new (gsize max_size)
+{
+    GPasteTextSink *self = g_object_new (G_PASTE_TYPE_TEXT_SINK,
+                                         "realloc-function", g_realloc,
+                                         "destroy-function", g_free,
+                                         NULL);
+
+    self->max_size = max_size;
+
+    return G_OUTPUT_STREAM (self);
+}
@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+#include <gpaste-3/gpaste-macros.h>
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define G_PASTE_TYPE_TEXT_SINK (g_paste_text_sink_get_type ())
+
+G_PASTE_FINAL_TYPE (TextSink, text_sink, TEXT_SINK, GMemoryOutputStream)
+
+GBytes        *g_paste_text_sink_finish (GPasteTextSink *self,
+                                         GError        **error);
+
+GOutputStream *g_paste_text_sink_new    (gsize max_size);
+
+G_END_DECLS
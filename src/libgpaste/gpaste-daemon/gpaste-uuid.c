@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#include <gpaste-daemon/gpaste-uuid.h>
+
+/**
+ * g_paste_uuid_parse:
+ * @str: a uuid, as text
+ * @uuid: (out): where to store its bytes
+ *
+ * Read a uuid in any case, which is how RFC 4122 has them compare.
+ *
+ * Returns: whether @str was a valid uuid
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_uuid_parse (const gchar *str,
+                    GPasteUuid  *uuid)
+{
+    g_return_val_if_fail (uuid, FALSE);
+
+    if (!str || !g_uuid_string_is_valid (str))
+        return FALSE;
+
+    guint64 halves[2] = { 0, 0 };
+    guint digits = 0;
+
+    for (const gchar *c = str; *c; ++c)
+    {
+        if (*c == '-')
+            continue;
+
+        halves[digits / 16] = (halves[digits / 16] << 4) | (guint64) g_ascii_xdigit_value (*c);
+        ++digits;
+    }
+
+    uuid->high = halves[0];
+    uuid->low = halves[1];
+
+    return TRUE;
+}
+
+/**
+ * g_paste_uuid_format:
+ * @uuid: a #GPasteUuid
+ * @str: (out caller-allocates): room for %G_PASTE_UUID_STRING_LENGTH characters
+ *       and a NUL
+ *
+ * Write @uuid out the way g_uuid_string_random() does: lowercase, dashed.
+ */
+G_PASTE_VISIBLE void
+g_paste_uuid_format (const GPasteUuid *uuid,
+                     gchar            *str)
+{
+    g_return_if_fail (uuid);
+    g_return_if_fail (str);
+
+    static const gchar hex[] = "0123456789abcdef";
+    guint digit = 0;
+
+    for (guint i = 0; i < G_PASTE_UUID_STRING_LENGTH; ++i)
+    {
+        if (i == 8 || i == 13 || i == 18 || i == 23)
+        {
+            str[i] = '-';
+            continue;
+        }
+
+        guint64 half = (digit < 16) ? uuid->high : uuid->low;
+
+        str[i] = hex[(half >> (4 * (15 - digit % 16))) & 0xf];
+        ++digit;
+    }
+
+    str[G_PASTE_UUID_STRING_LENGTH] = '\0';
+}
+
+/**
+ * g_paste_uuid_hash:
+ * @uuid: (type GPasteUuid): a #GPasteUuid
+ *
+ * Hash a uuid for a #GHashTable. Random uuids need no mixing: their bits
+ * already are.
+ *
+ * Returns: the hash
+ */
+G_PASTE_VISIBLE guint
+g_paste_uuid_hash (gconstpointer uuid)
+{
+    const GPasteUuid *u = uuid;
+
+    return (guint) (u->low ^ (u->low >> 32) ^ u->high);
+}
+
+/**
+ * g_paste_uuid_equal:
+ * @a: (type GPasteUuid): a #GPasteUuid
+ * @b: (type GPasteUuid): another #GPasteUuid
+ *
+ * Compare two uuids for a #GHashTable.
+ *
+ * Returns: whether they are the same
+ */
+G_PASTE_VISIBLE gboolean
+g_paste_uuid_equal (gconstpointer a,
+                    gconstpointer b)
+{
+    const GPasteUuid *ua = a;
+    const GPasteUuid *ub = b;
+
+    return ua->high == ub->high && ua->low == ub->low;
+}
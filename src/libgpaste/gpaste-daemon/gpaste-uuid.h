@@ -0,0 +1,31 @@
+// SPDX-FileCopyrightText: 2010-2026 Marc-Antoine Perennou <Marc-Antoine@Perennou.com>
+// SPDX-License-Identifier: BSD-2-Clause
+
+#pragma once
+
+#include <gpaste-daemon/gpaste-item.h>
+
+G_BEGIN_DECLS
+
+/* A uuid as the 16 bytes it spells rather than the 36 characters it is written
+ * with: what the history indexes its items by, hashed and compared as two
+ * integers. Every item holds its own, next to the string it hands out. */
+typedef struct
+{
+    guint64 high;
+    guint64 low;
+} GPasteUuid;
+
+#define G_PASTE_UUID_STRING_LENGTH 36
+
+gboolean g_paste_uuid_parse  (const gchar      *str,
+                              GPasteUuid       *uuid);
+void     g_paste_uuid_format (const GPasteUuid *uuid,
+                              gchar            *str);
+guint    g_paste_uuid_hash   (gconstpointer     uuid);
+gboolean g_paste_uuid_equal  (gconstpointer     a,
+                              gconstpointer     b);
+
+const GPasteUuid *g_paste_item_get_binary_uuid (GPasteItem *self);
+
+G_END_DECLS
@@ -79,7 +79,17 @@ g_paste_gtk_preferences_history_settings_page_new (GPasteSettings *settings)
     g_paste_gtk_preferences_group_add_range_setting (group,
                                                      _("Max history size"),
                                                      G_PASTE_MAX_HISTORY_SIZE_SETTING,
-                                                     5, 65535, 5,
+                                                     5, 16777215, 5,
+                                                     settings);
+    g_paste_gtk_preferences_group_add_range_setting (group,
+                                                     _("Items kept in memory (0 for all)"),
+                                                     G_PASTE_RESIDENT_HISTORY_SIZE_SETTING,
+                                                     0, 65535, 5,
+                                                     settings);
+    g_paste_gtk_preferences_group_add_range_setting (group,
+                                                     _("Recent histories kept in memory"),
+                                                     G_PASTE_RECENT_HISTORIES_SETTING,
+                                                     0, 16, 1,
                                                      settings);
     g_paste_gtk_preferences_group_add_range_setting (group,
                                                      _("Max memory usage (MB)"),
@@ -17,7 +17,9 @@
 #include <gpaste-3/gpaste-update-enums.h>
 
 /* GPasteSettings */
+#include <gpaste-3/gpaste-compression.h>
 #include <gpaste-3/gpaste-gsettings-keys.h>
+#include <gpaste-3/gpaste-image-encoder.h>
 #include <gpaste-3/gpaste-settings.h>
 #include <gpaste-3/gpaste-storage.h>
 
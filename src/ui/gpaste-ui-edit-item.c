@@ -50,27 +50,25 @@ on_edit_response (GObject      *dialog,
 }
 
 static void
-on_item_ready (GObject      *source_object,
-               GAsyncResult *res,
-               gpointer      user_data)
+on_value_ready (GObject      *source_object,
+                GAsyncResult *res,
+                gpointer      user_data)
 {
     g_autofree CallbackData *data = user_data;
     g_autofree gchar *uuid = data->uuid;
     g_autoptr (GtkWindow) rootwin = data->rootwin;
     GPasteClient *client = G_PASTE_CLIENT (source_object);
     g_autoptr (GError) error = NULL;
-    g_autoptr (GPasteClientItem) item = g_paste_client_get_item_finish (client, res, &error);
+    g_autofree gchar *old_item = g_paste_client_get_value_finish (client, res, &error);
 
     /* Without it there is no dialog to show, and the Edit the user asked for
      * would simply not happen. */
-    if (!item)
+    if (!old_item)
     {
         g_warning ("Could not read the item to edit: %s", error->message);
         return;
     }
 
-    const gchar *old_item = g_paste_client_item_get_value (item);
-
     GtkTextBuffer *buf = NULL;
     AdwAlertDialog *dialog = g_paste_gtk_util_text_dialog (_("Edit"), old_item, &buf);
 
@@ -93,9 +91,10 @@ g_paste_ui_edit_item_activate (GPasteUiItemAction *action,
     data->rootwin = g_object_ref (self->rootwin);
     data->uuid = g_strdup (uuid);
 
-    /* The plain getter: Edit is only sensitive for a text item, whose display
-     * string is its value. */
-    g_paste_client_get_item (client, uuid, on_item_ready, data);
+    /* The whole value rather than the item: the row only holds the start of a
+     * long one, and editing that would replace the rest with nothing. Edit is
+     * only sensitive for a text item, whose display string is its value. */
+    g_paste_client_get_value (client, uuid, on_value_ready, data);
 }
 
 static void
@@ -4,21 +4,34 @@
 #include <gpaste-3/gpaste-util.h>
 
 #include <gpaste-daemon/gpaste-clipboard-content.h>
+#include <gpaste-daemon/gpaste-clipboards-manager.h>
 #include <gpaste-daemon/gpaste-daemon-util.h>
+#include <gpaste-daemon/gpaste-file-backend.h>
+#include <gpaste-daemon/gpaste-handover.h>
 #include <gpaste-daemon/gpaste-history.h>
 #include <gpaste-daemon/gpaste-image-item.h>
 #include <gpaste-daemon/gpaste-password-item.h>
 #include <gpaste-daemon/gpaste-storage-backend.h>
+#include <gpaste-daemon/gpaste-storage-compression.h>
+#include <gpaste-daemon/gpaste-storage-migration.h>
 #include <gpaste-daemon/gpaste-text-item.h>
+#include <gpaste-daemon/gpaste-text-sink.h>
 #include <gpaste-daemon/gpaste-uris-item.h>
+#include <gpaste-daemon/gpaste-uuid.h>
 
 #include <string.h>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 #include <gpaste-3/gpaste-util.h>
 
 #include <gpaste-daemon/gpaste-file-backend.h>
 #include <gpaste-daemon/gpaste-password-item.h>
+#include <gpaste-daemon/gpaste-secret-stream-converter.h>
+#include <sodium.h>
 #include <string.h>
 #endif
 
@@ -34,6 +47,7 @@
 
 #include <sqlite3.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifdef G_PASTE_ENABLE_ENCRYPTION
 #include <sodium.h>
@@ -41,7 +55,8 @@
 #endif
 
 /* Build a fresh, empty history backed by an in-memory GSettings.
- * Growing-lines merging is disabled so distinct strings stay distinct. */
+ * Growing-lines merging is disabled so distinct strings stay distinct, and idle
+ * items are not compressed so an item's size is that of what was copied. */
 static GPasteHistory *
 make_history (GPasteSettings **out_settings,
               guint64          max_history_size)
@@ -57,6 +72,7 @@ make_history (GPasteSettings **out_settings,
     g_paste_settings_set_growing_lines (settings, FALSE);
     g_paste_settings_set_max_history_size (settings, max_history_size);
     g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_compress_idle_items (settings, FALSE);
 
     GPasteHistory *history = g_paste_history_new (settings);
 
@@ -282,13 +298,380 @@ test_image_capture_does_not_write (void)
 
     g_assert_nonnull (texture);
 
-    g_autoptr (GPasteItem) item = g_paste_image_item_new (texture);
+    g_autoptr (GPasteItem) item = g_paste_image_item_new (texture, G_PASTE_IMAGE_ENCODER_DEFAULT);
 
     g_assert_nonnull (item);
     g_assert_nonnull (g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item)));
     g_assert_false (g_file_test (g_paste_item_get_value (item), G_FILE_TEST_EXISTS));
 }
 
+static void
+on_image_item_cancelled (GObject      *source_object G_GNUC_UNUSED,
+                         GAsyncResult *res,
+                         gpointer      user_data)
+{
+    gboolean *done = user_data;
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GPasteItem) item = g_paste_image_item_new_finish (res, &error);
+
+    g_assert_null (item);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    *done = TRUE;
+}
+
+static void
+on_image_item_built (GObject      *source_object G_GNUC_UNUSED,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+    GPasteItem **out = user_data;
+    g_autoptr (GError) error = NULL;
+
+    *out = g_paste_image_item_new_finish (res, &error);
+    g_assert_no_error (error);
+}
+
+/* The worker-built item is the one g_paste_image_item_new() would have given:
+ * same checksum, same encoded bytes to persist, and handed back on the main
+ * context rather than on the thread that built it. */
+static void
+test_image_capture_async (void)
+{
+    g_autoptr (GBytes) png = test_png_bytes_colored (4, 5, 6);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GdkTexture) texture = gdk_texture_new_from_bytes (png, &error);
+
+    g_assert_nonnull (texture);
+
+    g_autoptr (GPasteItem) item = NULL;
+
+    g_paste_image_item_new_async (texture, G_PASTE_IMAGE_ENCODER_DEFAULT, NULL, on_image_item_built, &item);
+
+    for (guint i = 0; !item && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_nonnull (item);
+
+    g_autofree gchar *checksum = g_paste_image_item_compute_checksum (texture);
+
+    g_assert_cmpstr (g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (item)), ==, checksum);
+    g_assert_cmpstr (g_paste_item_get_value (item), ==, checksum);
+    g_assert_nonnull (g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item)));
+    g_assert_nonnull (g_paste_image_item_get_image (G_PASTE_IMAGE_ITEM (item)));
+}
+
+/* A capture superseded before a worker picked it up never comes back as an
+ * item. */
+static void
+test_image_capture_async_cancelled (void)
+{
+    g_autoptr (GBytes) png = test_png_bytes_colored (7, 8, 9);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GdkTexture) texture = gdk_texture_new_from_bytes (png, &error);
+    g_autoptr (GCancellable) cancellable = g_cancellable_new ();
+    gboolean done = FALSE;
+
+    g_assert_nonnull (texture);
+
+    g_cancellable_cancel (cancellable);
+    g_paste_image_item_new_async (texture, G_PASTE_IMAGE_ENCODER_DEFAULT, cancellable, on_image_item_cancelled, &done);
+
+    for (guint i = 0; !done && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_true (done);
+}
+
+/* A capture built straight from the PNG a clipboard owner offered keeps those
+ * very bytes, and is fingerprinted like any other capture of the same image. */
+static void
+test_image_capture_from_png (void)
+{
+    g_autoptr (GBytes) png = test_png_bytes_colored (31, 32, 33);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GdkTexture) texture = gdk_texture_new_from_bytes (png, &error);
+
+    g_assert_nonnull (texture);
+
+    g_autoptr (GPasteItem) item = NULL;
+
+    g_paste_image_item_new_from_png_async (png, G_PASTE_IMAGE_ENCODER_DEFAULT, NULL, on_image_item_built, &item);
+
+    for (guint i = 0; !item && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_nonnull (item);
+
+    g_autofree gchar *checksum = g_paste_image_item_compute_checksum (texture);
+
+    g_assert_cmpstr (g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (item)), ==, checksum);
+    g_assert_true (g_bytes_equal (g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item)), png));
+}
+
+/* A 64x48 texture whose luminance ramps left to right (right to left when
+ * @reverse), brightened by @offset: something for the perceptual half of a
+ * fingerprint to look at, unlike a flat color. */
+static GdkTexture *
+test_gradient_texture (gboolean reverse,
+                       guchar   offset)
+{
+    const gint width = 64;
+    const gint height = 48;
+    gsize size = (gsize) width * height * 4;
+    guchar *pixels = g_malloc (size);
+
+    for (gint y = 0; y < height; ++y)
+    {
+        for (gint x = 0; x < width; ++x)
+        {
+            guchar *pixel = pixels + ((gsize) y * width + x) * 4;
+            guchar value = (guchar) (((reverse) ? width - 1 - x : x) * 3 + offset);
+
+            pixel[0] = pixel[1] = pixel[2] = value;
+            pixel[3] = 0xff;
+        }
+    }
+
+    g_autoptr (GBytes) data = g_bytes_new_take (pixels, size);
+
+    return gdk_memory_texture_new (width, height, GDK_MEMORY_R8G8B8A8, data, (gsize) width * 4);
+}
+
+/* Fingerprints tell different pixels apart, and their perceptual half still
+ * sees a slightly brightened copy as the same picture -- but not a mirrored
+ * one. */
+static void
+test_image_fingerprint (void)
+{
+    g_autoptr (GdkTexture) ramp = test_gradient_texture (FALSE, 0);
+    g_autoptr (GdkTexture) brighter = test_gradient_texture (FALSE, 4);
+    g_autoptr (GdkTexture) mirrored = test_gradient_texture (TRUE, 0);
+    g_autoptr (GPasteItem) a = g_paste_image_item_new (ramp, G_PASTE_IMAGE_ENCODER_DEFAULT);
+    g_autoptr (GPasteItem) b = g_paste_image_item_new (brighter, G_PASTE_IMAGE_ENCODER_DEFAULT);
+    g_autoptr (GPasteItem) c = g_paste_image_item_new (mirrored, G_PASTE_IMAGE_ENCODER_DEFAULT);
+    g_autofree gchar *again = g_paste_image_item_compute_checksum (ramp);
+    const gchar *checksum = g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (a));
+
+    g_assert_true (g_paste_image_item_checksum_is_current (checksum));
+    g_assert_cmpstr (checksum, ==, again);
+    g_assert_cmpstr (checksum, !=, g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (b)));
+    g_assert_false (g_paste_item_equals (a, b));
+
+    g_assert_true (g_paste_image_item_is_near_duplicate (G_PASTE_IMAGE_ITEM (a), G_PASTE_IMAGE_ITEM (b)));
+    g_assert_false (g_paste_image_item_is_near_duplicate (G_PASTE_IMAGE_ITEM (a), G_PASTE_IMAGE_ITEM (c)));
+
+    /* What an older GPaste stored: a plain hex SHA256. */
+    g_assert_false (g_paste_image_item_checksum_is_current ("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"));
+}
+
+/* The kinds of picture the encoders are measured against: what people copy
+ * ranges from flat UI to photographs, and each compresses its own way. */
+typedef enum
+{
+    TEST_CORPUS_FLAT,       /* one color */
+    TEST_CORPUS_GRADIENT,   /* smooth, every row different */
+    TEST_CORPUS_SCREENSHOT, /* flat panels, lines of "text", a translucent edge */
+    TEST_CORPUS_NOISE,      /* incompressible, a worst case */
+    TEST_N_CORPUS
+} TestCorpusKind;
+
+static const gchar *test_corpus_names[TEST_N_CORPUS] = { "flat", "gradient", "screenshot", "noise" };
+
+static GdkTexture *
+test_corpus_texture (TestCorpusKind kind,
+                     gint           width,
+                     gint           height)
+{
+    gsize size = (gsize) width * height * 4;
+    guchar *pixels = g_malloc (size);
+    GRand *rand = g_rand_new_with_seed (kind);
+
+    for (gint y = 0; y < height; ++y)
+    {
+        for (gint x = 0; x < width; ++x)
+        {
+            guchar *pixel = pixels + ((gsize) y * width + x) * 4;
+
+            switch (kind)
+            {
+            case TEST_CORPUS_FLAT:
+                pixel[0] = 0x30; pixel[1] = 0x60; pixel[2] = 0x90; pixel[3] = 0xff;
+                break;
+            case TEST_CORPUS_GRADIENT:
+                pixel[0] = (guchar) (x * 255 / width);
+                pixel[1] = (guchar) (y * 255 / height);
+                pixel[2] = (guchar) ((x + y) * 255 / (width + height));
+                pixel[3] = 0xff;
+                break;
+            case TEST_CORPUS_SCREENSHOT:
+            {
+                gboolean sidebar = x < width / 5;
+                gboolean text = !sidebar && (y % 16) < 10 && ((x / 7 + y / 16) % 5) && ((x * 31 + y * 17) % 3);
+
+                pixel[0] = pixel[1] = pixel[2] = (text) ? 0x20 : (sidebar) ? 0xe8 : 0xfa;
+                pixel[3] = (y < 8) ? (guchar) (y * 32) : 0xff;
+                break;
+            }
+            default:
+                for (guint i = 0; i < 4; ++i)
+                    pixel[i] = (guchar) g_rand_int_range (rand, 0, 256);
+                break;
+            }
+        }
+    }
+
+    g_rand_free (rand);
+
+    g_autoptr (GBytes) data = g_bytes_new_take (pixels, size);
+
+    return gdk_memory_texture_new (width, height, GDK_MEMORY_R8G8B8A8, data, (gsize) width * 4);
+}
+
+/* Whichever encoder wrote it, a stored image is a PNG that decodes back to the
+ * very pixels it was made of. */
+static void
+test_image_encoders_roundtrip (void)
+{
+    for (TestCorpusKind kind = 0; kind < TEST_N_CORPUS; ++kind)
+    {
+        g_autoptr (GdkTexture) texture = test_corpus_texture (kind, 37, 23);
+        g_autofree gchar *checksum = g_paste_image_item_compute_checksum (texture);
+
+        for (GPasteImageEncoder encoder = 0; encoder < G_PASTE_N_IMAGE_ENCODER; ++encoder)
+        {
+            g_autoptr (GBytes) png = g_paste_image_item_encode (texture, encoder);
+            g_autoptr (GError) error = NULL;
+            g_autoptr (GdkTexture) decoded = gdk_texture_new_from_bytes (png, &error);
+
+            g_assert_no_error (error);
+            g_assert_nonnull (decoded);
+
+            g_autofree gchar *decoded_checksum = g_paste_image_item_compute_checksum (decoded);
+
+            g_assert_cmpstr (decoded_checksum, ==, checksum);
+        }
+    }
+
+    /* The setting reaches the item: a capture carries what its encoder wrote. */
+    g_autoptr (GdkTexture) texture = test_corpus_texture (TEST_CORPUS_SCREENSHOT, 37, 23);
+    g_autoptr (GPasteItem) item = g_paste_image_item_new (texture, G_PASTE_IMAGE_ENCODER_SMALL);
+    g_autoptr (GBytes) small = g_paste_image_item_encode (texture, G_PASTE_IMAGE_ENCODER_SMALL);
+
+    g_assert_true (g_bytes_equal (g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item)), small));
+}
+
+/* Benchmark: encode time and size of each encoder over the corpus. Screen
+ * sized under -m perf, a quarter of that otherwise so the suite stays quick;
+ * the figures are reported, not asserted on, as they depend on the machine. */
+static void
+test_image_encoders_benchmark (void)
+{
+    static const gchar *encoder_names[G_PASTE_N_IMAGE_ENCODER] = { "default", "fast", "small" };
+    gint divisor = (g_test_perf ()) ? 1 : 4;
+    gint width = 1920 / divisor;
+    gint height = 1080 / divisor;
+
+    for (TestCorpusKind kind = 0; kind < TEST_N_CORPUS; ++kind)
+    {
+        g_autoptr (GdkTexture) texture = test_corpus_texture (kind, width, height);
+
+        for (GPasteImageEncoder encoder = 0; encoder < G_PASTE_N_IMAGE_ENCODER; ++encoder)
+        {
+            gint64 start = g_get_monotonic_time ();
+            g_autoptr (GBytes) png = g_paste_image_item_encode (texture, encoder);
+            gint64 elapsed = g_get_monotonic_time () - start;
+
+            g_assert_nonnull (png);
+            g_test_message ("%dx%d %-10s %-7s %8.2f ms %10" G_GSIZE_FORMAT " bytes",
+                            width, height,
+                            test_corpus_names[kind], encoder_names[encoder],
+                            elapsed / 1000.0, g_bytes_get_size (png));
+        }
+    }
+}
+
+/* An item read back with an older GPaste's checksum gets the fingerprint a
+ * fresh capture of the same image would, while a current one is taken as
+ * stored. */
+static void
+test_image_legacy_checksum_upgraded (void)
+{
+    g_autoptr (GBytes) png = test_png_bytes_colored (34, 35, 36);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GdkTexture) texture = gdk_texture_new_from_bytes (png, &error);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+
+    g_assert_nonnull (texture);
+
+    g_autofree gchar *expected = g_paste_image_item_compute_checksum (texture);
+    g_autoptr (GPasteItem) legacy = g_paste_image_item_new_from_bytes (png, date,
+                                                                       "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+    g_autoptr (GPasteItem) current = g_paste_image_item_new_from_bytes (png, date,
+                                                                        "0123456789abcdef0123456789abcdef-0123456789abcdef");
+
+    g_assert_cmpstr (g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (legacy)), ==, expected);
+    g_assert_cmpstr (g_paste_item_get_value (legacy), ==, expected);
+    g_assert_cmpstr (g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (current)), ==,
+                     "0123456789abcdef0123456789abcdef-0123456789abcdef");
+}
+
+/* A file history written by an older GPaste: the image comes back under its
+ * fingerprint, and the next write moves its file to the name that goes with
+ * it, removing the old one. */
+static void
+test_file_image_legacy_checksum_migrated (void)
+{
+    const gchar *name = "file-image-legacy";
+    const gchar *legacy = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_images_support (settings, TRUE);
+
+    g_autoptr (GBytes) png = test_png_bytes_colored (37, 38, 39);
+    g_autofree gchar *images_dir = g_paste_file_backend_images_dir (name);
+    g_autofree gchar *legacy_path = g_paste_file_backend_image_path (name, legacy);
+    g_autofree gchar *contents = g_strdup_printf ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                                  "<history version=\"2.0\">\n"
+                                                  "  <item kind=\"Image\" date=\"1234567890\" checksum=\"%s\">\n"
+                                                  "    <value><![CDATA[%s]]></value>\n"
+                                                  "  </item>\n"
+                                                  "</history>\n",
+                                                  legacy, legacy_path);
+
+    g_assert_true (g_paste_util_ensure_history_dir_exists ());
+    g_assert_cmpint (g_mkdir_with_parents (images_dir, 0700), ==, 0);
+    g_assert_true (g_file_set_contents (legacy_path, g_bytes_get_data (png, NULL), g_bytes_get_size (png), NULL));
+
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "xml");
+
+    g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+    g_autolist (GPasteItem) loaded = read_history (backend, name);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+
+    const gchar *checksum = g_paste_image_item_get_checksum (loaded->data);
+
+    g_assert_true (g_paste_image_item_checksum_is_current (checksum));
+    /* It no longer needs the file it was read from. */
+    g_assert_true (g_bytes_equal (g_paste_image_item_get_png_bytes (loaded->data), png));
+
+    g_paste_storage_backend_write_history (backend, name, loaded);
+
+    g_autofree gchar *new_path = g_paste_file_backend_image_path (name, checksum);
+
+    g_assert_true (g_file_test (new_path, G_FILE_TEST_EXISTS));
+    g_assert_false (g_file_test (legacy_path, G_FILE_TEST_EXISTS));
+
+    g_autolist (GPasteItem) reloaded = read_history (backend, name);
+
+    g_assert_cmpuint (g_list_length (reloaded), ==, 1);
+    g_assert_cmpstr (g_paste_item_get_value (reloaded->data), ==, checksum);
+    g_assert_cmpstr (g_paste_image_item_get_cache_path (reloaded->data), ==, new_path);
+}
+
 /* The plain file backend materializes an image's cache file from the item
  * bytes when writing its XML, and reads it back by path -- the item itself
  * knowing only its checksum until a backend hands it a file. */
@@ -356,7 +739,7 @@ test_history_image_names_no_file (void)
 
     g_assert_nonnull (texture);
 
-    g_paste_history_add (history, g_paste_image_item_new (texture));
+    g_paste_history_add (history, g_paste_image_item_new (texture, G_PASTE_IMAGE_ENCODER_DEFAULT));
 
     GPasteItem *item = g_paste_history_get (history, 0);
     const gchar *checksum = g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (item));
@@ -462,6 +845,97 @@ test_file_backup_owns_images (void)
     g_list_free_full (items, g_object_unref);
 }
 
+typedef struct
+{
+    gboolean done;
+    gboolean ok;
+    GError  *error;
+} BackupOutcome;
+
+static void
+on_history_backed_up (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+    BackupOutcome *outcome = user_data;
+
+    outcome->ok = g_paste_history_backup_finish (G_PASTE_HISTORY (source_object), result, &outcome->error);
+    outcome->done = TRUE;
+}
+
+/* BackupHistory copies the store rather than the model: the file backend
+ * streams the document over with its image references moved to the backup's
+ * own directory, behind whatever writes were still queued when it was asked. */
+static void
+test_file_backup_copies_store (void)
+{
+    const gchar *name = "backup-copy-src";
+    const gchar *backup = "backup-copy-dst";
+
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+
+    g_paste_settings_set_images_support (settings, TRUE);
+    g_paste_history_load (history, name);
+
+    g_autoptr (GBytes) png = test_png_bytes_colored (22, 23, 24);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GPasteItem *image = g_paste_image_item_new_from_bytes (png, date, NULL);
+
+    g_assert_nonnull (image);
+
+    g_autofree gchar *checksum = g_strdup (g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (image)));
+
+    g_paste_history_add (history, g_paste_text_item_new ("one"));
+    g_paste_history_add (history, image);
+    g_paste_history_add (history, g_paste_text_item_new ("two\n    <value><![CDATA[lines"));
+
+    /* No pumping first: the backup must still see all three. */
+    BackupOutcome outcome = { FALSE, FALSE, NULL };
+
+    g_paste_history_backup (history, NULL, backup, on_history_backed_up, &outcome);
+
+    for (guint i = 0; !outcome.done && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_true (outcome.done);
+    g_assert_no_error (outcome.error);
+    g_assert_true (outcome.ok);
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+    g_autofree gchar *backup_image = g_paste_file_backend_image_path (backup, checksum);
+
+    /* The backup owns its image, so deleting the source takes nothing from it. */
+    g_paste_storage_backend_delete_history (backend, name, NULL);
+
+    g_autolist (GPasteItem) loaded = read_history (backend, backup);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 3);
+    g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "two\n    <value><![CDATA[lines");
+    g_assert_cmpint (g_paste_item_get_kind (loaded->next->data), ==, G_PASTE_ITEM_KIND_IMAGE);
+    g_assert_cmpstr (g_paste_item_get_value (loaded->next->data), ==, checksum);
+    g_assert_cmpstr (g_paste_image_item_get_cache_path (loaded->next->data), ==, backup_image);
+    g_assert_true (g_file_test (backup_image, G_FILE_TEST_EXISTS));
+    g_assert_cmpstr (g_paste_item_get_value (loaded->next->next->data), ==, "one");
+
+    /* A store handed over takes no backup. */
+    BackupOutcome refusal = { FALSE, FALSE, NULL };
+
+    g_paste_history_flush (history);
+    g_paste_history_backup (history, NULL, "backup-copy-refused", on_history_backed_up, &refusal);
+
+    for (guint i = 0; !refusal.done && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_false (refusal.ok);
+    g_assert_error (refusal.error, G_IO_ERROR, G_IO_ERROR_BUSY);
+    g_clear_error (&refusal.error);
+
+    g_autofree gchar *refused = g_paste_util_get_history_file_path ("backup-copy-refused", "xml");
+
+    g_assert_false (g_file_test (refused, G_FILE_TEST_EXISTS));
+}
+
 /* Dropping an image from a history takes the file the backend materialized for
  * it: whoever wrote it is the one that deletes it, which for the file flavours
  * is the cache file under the history's own images directory. */
@@ -585,70 +1059,322 @@ test_content_kind_transitions (void)
     g_assert_true (g_paste_clipboard_content_is_empty (&content));
 }
 
-/* Setting an item's display string to what it already says must leave its size
- * alone. g_set_str_take() frees the string handed to it and keeps the old
- * pointer when the two compare equal, so measuring the argument rather than
- * what we ended up holding both reads freed memory and underflows the size —
- * after which the history believes it is permanently over max-memory-usage and
- * starts evicting. Reachable from D-Bus as `gpaste-client rename-password foo
- * foo`. */
+/* Clipboard text is validated as it streams in: a character split across two
+ * writes is fine, while invalid UTF-8, an embedded NUL, going over the cap or
+ * stopping in the middle of a character is not. */
 static void
-test_same_display_string_keeps_size (void)
+test_text_sink_validates_and_caps (void)
 {
-    g_autoptr (GPasteItem) item = g_paste_password_item_new ("foo", "s3kr1t");
-    guint64 size = g_paste_item_get_size (item);
+    const gchar *text = "caf\xc3\xa9 au lait";
+    g_autoptr (GOutputStream) sink = g_paste_text_sink_new (64);
+    g_autoptr (GError) error = NULL;
 
-    g_assert_cmpuint (size, >, 0);
+    g_assert_true (g_output_stream_write_all (sink, text, 4, NULL, NULL, &error));
+    g_assert_true (g_output_stream_write_all (sink, text + 4, strlen (text) - 4, NULL, NULL, &error));
 
-    for (guint i = 0; i < 3; ++i)
-    {
-        g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foo");
-        g_assert_cmpuint (g_paste_item_get_size (item), ==, size);
-    }
+    g_autoptr (GBytes) bytes = g_paste_text_sink_finish (G_PASTE_TEXT_SINK (sink), &error);
 
-    /* A real rename still has to move the size with it, and renaming back has
-     * to land exactly where we started: the accounting is only right if it is
-     * symmetric. */
-    g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foobar");
-    g_assert_cmpuint (g_paste_item_get_size (item), >, size);
+    g_assert_no_error (error);
+    g_assert_cmpmem (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), text, strlen (text));
 
-    g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foo");
-    g_assert_cmpuint (g_paste_item_get_size (item), ==, size);
-}
+    g_autoptr (GOutputStream) capped = g_paste_text_sink_new (8);
 
-static void
-test_add_get_length (void)
-{
-    g_autoptr (GPasteSettings) settings = NULL;
-    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    g_assert_true (g_output_stream_write_all (capped, "12345", 5, NULL, NULL, &error));
+    g_assert_false (g_output_stream_write_all (capped, "6789", 4, NULL, NULL, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE);
+    g_clear_error (&error);
 
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 0);
+    g_autoptr (GOutputStream) invalid = g_paste_text_sink_new (64);
 
-    g_paste_history_add (history, g_paste_text_item_new ("first"));
-    g_paste_history_add (history, g_paste_text_item_new ("second"));
+    g_assert_false (g_output_stream_write_all (invalid, "ab\xff", 3, NULL, NULL, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
 
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
-    /* Most recently added is at the front. */
-    g_assert_cmpstr (value_at (history, 0), ==, "second");
-    g_assert_cmpstr (value_at (history, 1), ==, "first");
-    g_assert_null (g_paste_history_get (history, 2));
+    g_autoptr (GOutputStream) nul = g_paste_text_sink_new (64);
+
+    g_assert_false (g_output_stream_write_all (nul, "a\0b", 3, NULL, NULL, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+
+    g_autoptr (GOutputStream) truncated = g_paste_text_sink_new (64);
+
+    g_assert_true (g_output_stream_write_all (truncated, "caf\xc3", 4, NULL, NULL, &error));
+    g_assert_null (g_paste_text_sink_finish (G_PASTE_TEXT_SINK (truncated), &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT);
 }
 
+/* An oversized text fails the transfer feeding the sink long before the end:
+ * the rest of it is never read, let alone allocated. */
 static void
-test_dedup_moves_to_front (void)
+test_text_sink_aborts_oversized_read (void)
 {
-    g_autoptr (GPasteSettings) settings = NULL;
-    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    const gsize size = 4 << 20;
+    g_autofree gchar *huge = g_malloc (size);
 
-    g_paste_history_add (history, g_paste_text_item_new ("foo"));
-    g_paste_history_add (history, g_paste_text_item_new ("bar"));
-    /* Re-adding an existing (non-first) item must not duplicate it, just move
-     * it back to the front. */
-    g_paste_history_add (history, g_paste_text_item_new ("foo"));
+    memset (huge, 'a', size);
 
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
-    g_assert_cmpstr (value_at (history, 0), ==, "foo");
-    g_assert_cmpstr (value_at (history, 1), ==, "bar");
+    g_autoptr (GInputStream) source = g_memory_input_stream_new_from_data (huge, size, NULL);
+    g_autoptr (GOutputStream) sink = g_paste_text_sink_new (1024);
+    g_autoptr (GError) error = NULL;
+
+    g_assert_cmpint (g_output_stream_splice (sink, source, G_OUTPUT_STREAM_SPLICE_NONE, NULL, &error), ==, -1);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE);
+    g_assert_cmpint (g_seekable_tell (G_SEEKABLE (source)), <, 1 << 20);
+    g_assert_cmpuint (g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (sink)), <=, 1024);
+}
+
+/* A provider whose updates only complete when the test says so, to watch the
+ * clipboards manager schedule them. */
+G_DECLARE_FINAL_TYPE (GPasteClipboardFake, g_paste_clipboard_fake, G_PASTE, CLIPBOARD_FAKE, GObject)
+
+typedef struct
+{
+    GCancellable                         *cancellable;
+    GPasteClipboardProviderUpdateCallback callback;
+    gpointer                              user_data;
+} FakeUpdate;
+
+struct _GPasteClipboardFake
+{
+    GObject parent_instance;
+
+    gchar  *text;
+    GQueue  updates; /* FakeUpdate*, oldest first */
+    guint   started;
+};
+
+static void g_paste_clipboard_fake_provider_iface_init (GPasteClipboardProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GPasteClipboardFake, g_paste_clipboard_fake, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_PASTE_TYPE_CLIPBOARD_PROVIDER, g_paste_clipboard_fake_provider_iface_init))
+
+static gboolean
+g_paste_clipboard_fake_is_clipboard (GPasteClipboardFake *self G_GNUC_UNUSED)
+{
+    return TRUE;
+}
+
+static const gchar *
+g_paste_clipboard_fake_get_text (GPasteClipboardFake *self)
+{
+    return self->text;
+}
+
+static const gchar *
+g_paste_clipboard_fake_get_image_checksum (GPasteClipboardFake *self G_GNUC_UNUSED)
+{
+    return NULL;
+}
+
+static gboolean
+g_paste_clipboard_fake_is_empty (GPasteClipboardFake *self)
+{
+    return !self->text;
+}
+
+static void
+g_paste_clipboard_fake_update (GPasteClipboardFake                  *self,
+                               GCancellable                         *cancellable,
+                               GPasteClipboardProviderUpdateCallback callback,
+                               gpointer                              user_data)
+{
+    FakeUpdate *update = g_new0 (FakeUpdate, 1);
+
+    update->cancellable = g_object_ref (cancellable);
+    update->callback = callback;
+    update->user_data = user_data;
+    g_queue_push_tail (&self->updates, update);
+    ++self->started;
+}
+
+static void
+g_paste_clipboard_fake_select_text (GPasteClipboardFake *self,
+                                    const gchar         *text)
+{
+    g_set_str (&self->text, text);
+}
+
+static void
+g_paste_clipboard_fake_sync_text (GPasteClipboardFake *self G_GNUC_UNUSED,
+                                  GPasteClipboardFake *other G_GNUC_UNUSED)
+{
+}
+
+static gboolean
+g_paste_clipboard_fake_select_item (GPasteClipboardFake *self,
+                                    GPasteItem          *item)
+{
+    g_set_str (&self->text, g_paste_item_get_value (item));
+    return TRUE;
+}
+
+static void
+g_paste_clipboard_fake_store (GPasteClipboardFake *self G_GNUC_UNUSED)
+{
+}
+
+G_PASTE_CLIPBOARD_PROVIDER_DEFINE_VFUNCS (fake, FAKE)
+
+/* Finish the oldest update still pending, as if the owner had offered @text
+ * (%NULL: nothing new). Returns whether it had been cancelled. */
+static gboolean
+g_paste_clipboard_fake_complete (GPasteClipboardFake *self,
+                                 const gchar         *text)
+{
+    g_autofree FakeUpdate *update = g_queue_pop_head (&self->updates);
+    g_autoptr (GCancellable) cancellable = update->cancellable;
+    gboolean cancelled = g_cancellable_is_cancelled (cancellable);
+    GPasteItem *item = NULL;
+
+    /* Like the real providers: a cancelled read leaves the cache alone. */
+    if (text && !cancelled)
+    {
+        g_set_str (&self->text, text);
+        item = g_paste_text_item_new (text);
+    }
+
+    update->callback (G_PASTE_CLIPBOARD_PROVIDER (self), item, update->user_data);
+
+    return cancelled;
+}
+
+static void
+g_paste_clipboard_fake_finalize (GObject *object)
+{
+    GPasteClipboardFake *self = G_PASTE_CLIPBOARD_FAKE (object);
+
+    while (!g_queue_is_empty (&self->updates))
+        g_paste_clipboard_fake_complete (self, NULL);
+    g_free (self->text);
+
+    G_OBJECT_CLASS (g_paste_clipboard_fake_parent_class)->finalize (object);
+}
+
+static void
+g_paste_clipboard_fake_class_init (GPasteClipboardFakeClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = g_paste_clipboard_fake_finalize;
+}
+
+static void
+g_paste_clipboard_fake_init (GPasteClipboardFake *self)
+{
+    g_queue_init (&self->updates);
+}
+
+/* A burst of owner changes inside track-changes-delay costs one update, and
+ * the update still reading when the burst began is cancelled rather than
+ * landing behind it. */
+static void
+test_clipboard_changes_coalesce (void)
+{
+    GPasteSettings *settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    g_autoptr (GPasteSettings) owned_settings = settings;
+    g_autoptr (GPasteClipboardFake) fake = g_object_new (g_paste_clipboard_fake_get_type (), NULL);
+
+    g_paste_settings_set_track_changes (settings, TRUE);
+    g_paste_settings_set_track_changes_delay (settings, 20);
+
+    g_autoptr (GPasteClipboardsManager) manager = g_paste_clipboards_manager_new (history, settings);
+
+    g_paste_clipboards_manager_add_clipboard (manager, G_PASTE_CLIPBOARD_PROVIDER (fake));
+    g_paste_clipboards_manager_activate (manager);
+    g_assert_cmpuint (fake->started, ==, 1); /* the bootstrap */
+
+    for (guint i = 0; i < 5; ++i)
+        g_paste_clipboard_provider_emit_changed (G_PASTE_CLIPBOARD_PROVIDER (fake));
+
+    /* Nothing is read before the window closes, but the bootstrap is dropped. */
+    g_assert_cmpuint (fake->started, ==, 1);
+    g_assert_true (g_paste_clipboard_fake_complete (fake, "stale"));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 0);
+
+    for (guint i = 0; i < 1000 && fake->started < 2; ++i)
+        pump_once ();
+
+    g_assert_cmpuint (fake->started, ==, 2);
+    g_assert_cmpuint (g_paste_clipboards_manager_get_coalesced_updates (manager), ==, 4);
+    g_assert_false (g_paste_clipboard_fake_complete (fake, "burst"));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 1);
+    g_assert_cmpstr (value_at (history, 0), ==, "burst");
+
+    /* With no window, every change is read at once and overtakes the last. */
+    g_paste_settings_set_track_changes_delay (settings, 0);
+    g_paste_clipboard_provider_emit_changed (G_PASTE_CLIPBOARD_PROVIDER (fake));
+    g_paste_clipboard_provider_emit_changed (G_PASTE_CLIPBOARD_PROVIDER (fake));
+    g_assert_cmpuint (fake->started, ==, 4);
+    g_assert_true (g_paste_clipboard_fake_complete (fake, "overtaken"));
+    g_assert_false (g_paste_clipboard_fake_complete (fake, "latest"));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
+    g_assert_cmpstr (value_at (history, 0), ==, "latest");
+    g_assert_cmpuint (g_paste_clipboards_manager_get_coalesced_updates (manager), ==, 4);
+}
+
+/* Setting an item's display string to what it already says must leave its size
+ * alone. g_set_str_take() frees the string handed to it and keeps the old
+ * pointer when the two compare equal, so measuring the argument rather than
+ * what we ended up holding both reads freed memory and underflows the size —
+ * after which the history believes it is permanently over max-memory-usage and
+ * starts evicting. Reachable from D-Bus as `gpaste-client rename-password foo
+ * foo`. */
+static void
+test_same_display_string_keeps_size (void)
+{
+    g_autoptr (GPasteItem) item = g_paste_password_item_new ("foo", "s3kr1t");
+    guint64 size = g_paste_item_get_size (item);
+
+    g_assert_cmpuint (size, >, 0);
+
+    for (guint i = 0; i < 3; ++i)
+    {
+        g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foo");
+        g_assert_cmpuint (g_paste_item_get_size (item), ==, size);
+    }
+
+    /* A real rename still has to move the size with it, and renaming back has
+     * to land exactly where we started: the accounting is only right if it is
+     * symmetric. */
+    g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foobar");
+    g_assert_cmpuint (g_paste_item_get_size (item), >, size);
+
+    g_paste_password_item_set_name (G_PASTE_PASSWORD_ITEM (item), "foo");
+    g_assert_cmpuint (g_paste_item_get_size (item), ==, size);
+}
+
+static void
+test_add_get_length (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 0);
+
+    g_paste_history_add (history, g_paste_text_item_new ("first"));
+    g_paste_history_add (history, g_paste_text_item_new ("second"));
+
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
+    /* Most recently added is at the front. */
+    g_assert_cmpstr (value_at (history, 0), ==, "second");
+    g_assert_cmpstr (value_at (history, 1), ==, "first");
+    g_assert_null (g_paste_history_get (history, 2));
+}
+
+static void
+test_dedup_moves_to_front (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+
+    g_paste_history_add (history, g_paste_text_item_new ("foo"));
+    g_paste_history_add (history, g_paste_text_item_new ("bar"));
+    /* Re-adding an existing (non-first) item must not duplicate it, just move
+     * it back to the front. */
+    g_paste_history_add (history, g_paste_text_item_new ("foo"));
+
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
+    g_assert_cmpstr (value_at (history, 0), ==, "foo");
+    g_assert_cmpstr (value_at (history, 1), ==, "bar");
 }
 
 static void
@@ -1199,125 +1925,436 @@ test_uris_item_answers_its_uris (void)
     g_assert_cmpstr (uris[2], ==, "trash:///c");
 }
 
+/* Drain the main context for up to @max_ms ms, stopping early once @history
+ * has switched to @name: the switch itself waits for the settings change. */
+static gboolean
+pump_until_current (GPasteHistory *history,
+                    const gchar   *name,
+                    guint          max_ms)
+{
+    for (guint i = 0; i < max_ms; ++i)
+    {
+        if (g_paste_str_equal (g_paste_history_get_current (history), name))
+            return TRUE;
+
+        pump_once ();
+    }
+    return g_paste_str_equal (g_paste_history_get_current (history), name);
+}
+
+/* Switching back to a history switched away from shortly before is the very
+ * model it left behind, not a read of it: the same objects, at once. */
 static void
-test_select_moves_to_front (void)
+test_recent_histories_switch_back (void)
 {
     g_autoptr (GPasteSettings) settings = NULL;
-    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    g_autoptr (GPasteHistory) history = make_history (&settings, 10);
 
-    g_paste_history_add (history, g_paste_text_item_new ("a"));
-    g_autofree gchar *uuid_a = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
-    g_paste_history_add (history, g_paste_text_item_new ("b"));
-    g_paste_history_add (history, g_paste_text_item_new ("c"));
+    g_paste_settings_set_recent_histories (settings, 2);
+    g_paste_history_add (history, g_paste_text_item_new ("kept across switches"));
 
-    g_assert_true (g_paste_history_select (history, uuid_a));
+    g_autoptr (GPasteItem) kept = g_object_ref (g_paste_history_get (history, 0));
+    g_autofree gchar *first = g_strdup (g_paste_history_get_current (history));
 
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 3);
-    g_assert_cmpstr (value_at (history, 0), ==, "a");
+    g_paste_settings_set_history_name (settings, "recent-other");
+    g_assert_true (pump_until_current (history, "recent-other", 5000));
+    g_assert_null (g_paste_history_get_by_uuid (history, g_paste_item_get_uuid (kept)));
 
-    g_assert_false (g_paste_history_select (history, "missing"));
+    g_paste_settings_set_history_name (settings, first);
+    g_assert_true (pump_until_current (history, first, 5000));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 1);
+    g_assert_true (g_paste_history_get (history, 0) == kept);
+
+    g_paste_history_delete (history, "recent-other", NULL);
 }
 
+/* A low memory warning sheds what is cheap to get back and keeps the history
+ * switched away from; a more pressing one lets that go too, and switching back
+ * then reads it in again, whole. */
 static void
-test_empty (void)
+test_shed_caches_under_memory_pressure (void)
 {
     g_autoptr (GPasteSettings) settings = NULL;
-    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    g_autoptr (GPasteHistory) history = make_history (&settings, 10);
 
-    g_paste_history_add (history, g_paste_text_item_new ("a"));
-    g_paste_history_add (history, g_paste_text_item_new ("b"));
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
+    g_paste_settings_set_recent_histories (settings, 2);
+    g_paste_history_add (history, g_paste_text_item_new ("kept under pressure"));
 
-    g_paste_history_empty (history);
-    g_assert_cmpuint (g_paste_history_get_length (history), ==, 0);
-    g_assert_null (g_paste_history_get (history, 0));
-}
+    g_autoptr (GPasteItem) kept = g_object_ref (g_paste_history_get (history, 0));
+    g_autofree gchar *first = g_strdup (g_paste_history_get_current (history));
 
-static void
-test_save_load_roundtrip (void)
-{
-    const gchar *name = "roundtrip";
+    g_paste_settings_set_history_name (settings, "pressure-other");
+    g_assert_true (pump_until_current (history, "pressure-other", 5000));
 
-    /* Write through the async saver: add two items, then flush so the
-     * background write deterministically reaches disk. */
-    {
-        g_autoptr (GPasteHistory) writer = make_plain_history ();
-        g_paste_history_load (writer, name);
+    g_paste_history_shed_caches (history, G_MEMORY_MONITOR_WARNING_LEVEL_LOW);
 
-        g_paste_history_add (writer, g_paste_text_item_new ("alpha"));
-        g_paste_history_add (writer, g_paste_text_item_new ("beta"));
+    g_paste_settings_set_history_name (settings, first);
+    g_assert_true (pump_until_current (history, first, 5000));
+    g_assert_true (g_paste_history_get (history, 0) == kept);
 
-        g_paste_history_flush (writer);
-    }
+    g_paste_settings_set_history_name (settings, "pressure-other");
+    g_assert_true (pump_until_current (history, "pressure-other", 5000));
 
-    /* Read it back asynchronously into a fresh history. */
-    {
-        g_autoptr (GPasteHistory) reader = make_plain_history ();
-        g_paste_history_load_async (reader, name);
+    g_assert_cmpuint (g_paste_history_shed_caches (history, G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM), >=, g_paste_item_get_size (kept));
 
-        g_assert_true (pump_until_length (reader, 2, 5000));
-        g_assert_cmpstr (value_at (reader, 0), ==, "beta");
-        g_assert_cmpstr (value_at (reader, 1), ==, "alpha");
-    }
+    g_paste_settings_set_history_name (settings, first);
+    g_assert_true (pump_until_current (history, first, 5000));
+    g_assert_true (pump_until_length (history, 1, 5000));
+    g_assert_false (g_paste_history_get (history, 0) == kept);
+    g_assert_cmpstr (value_at (history, 0), ==, "kept under pressure");
+
+    g_paste_history_delete (history, "pressure-other", NULL);
 }
 
-/* g_paste_history_flush() must get every pending change to disk synchronously,
- * without the caller having to pump the main loop: an exit/handover path relies
- * on the on-disk history being complete the moment flush() returns. */
+/* Backdate @path by @seconds, for it to look like a leftover. */
 static void
-test_flush_persists_synchronously (void)
+age_file (const gchar *path,
+          gint64       seconds)
 {
-    const gchar *name = "flush-sync";
-
-    {
-        g_autoptr (GPasteHistory) writer = make_plain_history ();
-        g_paste_history_load (writer, name);
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    g_autoptr (GError) error = NULL;
 
-        g_paste_history_add (writer, g_paste_text_item_new ("one"));
-        g_paste_history_add (writer, g_paste_text_item_new ("two"));
+    g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, g_get_real_time () / G_USEC_PER_SEC - seconds,
+                                 G_FILE_QUERY_INFO_NONE, NULL, &error);
+    g_assert_no_error (error);
+}
 
-        /* Note: no main-loop pumping here, unlike the roundtrip test. */
-        g_paste_history_flush (writer);
-    }
+typedef struct
+{
+    gboolean                 done;
+    GPasteStorageMaintenance report;
+    GError                  *error;
+} MaintenanceOutcome;
 
-    {
-        g_autoptr (GPasteHistory) reader = make_plain_history ();
-        g_paste_history_load_async (reader, name);
+static void
+on_history_maintained (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    MaintenanceOutcome *outcome = user_data;
 
-        g_assert_true (pump_until_length (reader, 2, 5000));
-        g_assert_cmpstr (value_at (reader, 0), ==, "two");
-        g_assert_cmpstr (value_at (reader, 1), ==, "one");
-    }
+    g_paste_history_maintain_finish (G_PASTE_HISTORY (source_object), result, &outcome->report, &outcome->error);
+    outcome->done = TRUE;
 }
 
-/* After a flush the history stops persisting changes, so a successor daemon that
- * has taken over the on-disk state is not overwritten by our late edits. */
+/* Maintaining the file store removes what a write that died half way left
+ * behind -- its temporary file, an image the history never got to name -- once
+ * it has been there a while, and nothing the history names. */
 static void
-test_flush_stops_recording (void)
+test_file_maintenance_removes_leftovers (void)
 {
-    const gchar *name = "flush-stop";
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    const gchar *name = g_paste_history_get_current (history);
 
-    {
-        g_autoptr (GPasteHistory) writer = make_plain_history ();
-        g_paste_history_load (writer, name);
+    g_paste_settings_set_images_support (settings, TRUE);
 
-        g_paste_history_add (writer, g_paste_text_item_new ("kept"));
-        g_paste_history_flush (writer);
+    g_autoptr (GBytes) png = test_png_bytes_colored (25, 26, 27);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GPasteItem *image = g_paste_image_item_new_from_bytes (png, date, NULL);
 
-        /* This change happens after the flush: it stays in memory but must never
-         * reach the disk. Pump the loop so an (erroneous) async write would run. */
-        g_paste_history_add (writer, g_paste_text_item_new ("dropped"));
+    g_assert_nonnull (image);
 
-        pump_for_ms (100);
-    }
+    g_autofree gchar *named = g_paste_file_backend_image_path (name, g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (image)));
 
-    {
-        g_autoptr (GPasteHistory) reader = make_plain_history ();
-        g_paste_history_load_async (reader, name);
+    g_paste_history_add (history, image);
 
-        g_assert_true (pump_until_length (reader, 1, 5000));
-        g_assert_cmpstr (value_at (reader, 0), ==, "kept");
-    }
+    for (guint i = 0; !g_file_test (named, G_FILE_TEST_EXISTS) && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_true (g_file_test (named, G_FILE_TEST_EXISTS));
+
+    g_autofree gchar *orphan = g_paste_file_backend_image_path (name, "maintenance-orphan");
+    g_autofree gchar *fresh = g_paste_file_backend_image_path (name, "maintenance-fresh");
+    g_autofree gchar *history_path = g_paste_util_get_history_file_path (name, "xml");
+    g_autofree gchar *tmp = g_strconcat (history_path, ".tmp", NULL);
+    const gchar *leftovers[] = { orphan, fresh, tmp };
+
+    for (guint i = 0; i < G_N_ELEMENTS (leftovers); ++i)
+        g_assert_true (g_file_set_contents (leftovers[i], "leftover", -1, NULL));
+
+    age_file (named, 2 * 60 * 60);
+    age_file (orphan, 2 * 60 * 60);
+    age_file (tmp, 2 * 60 * 60);
+
+    MaintenanceOutcome outcome = { FALSE, { 0 }, NULL };
+
+    g_paste_history_maintain (history, G_TIME_SPAN_MINUTE, on_history_maintained, &outcome);
+
+    for (guint i = 0; !outcome.done && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_true (outcome.done);
+    g_assert_no_error (outcome.error);
+    g_assert_true (outcome.report.complete);
+    g_assert_cmpuint (outcome.report.histories, >=, 1);
+    g_assert_cmpuint (outcome.report.orphans, ==, 2);
+    g_assert_cmpuint (outcome.report.reclaimed, ==, 2 * strlen ("leftover"));
+
+    g_assert_false (g_file_test (orphan, G_FILE_TEST_EXISTS));
+    g_assert_false (g_file_test (tmp, G_FILE_TEST_EXISTS));
+    g_assert_true (g_file_test (fresh, G_FILE_TEST_EXISTS));
+    g_assert_true (g_file_test (named, G_FILE_TEST_EXISTS));
+
+    /* A store handed over is not maintained. */
+    MaintenanceOutcome refusal = { FALSE, { 0 }, NULL };
+
+    g_paste_history_flush (history);
+    g_paste_history_maintain (history, G_TIME_SPAN_MINUTE, on_history_maintained, &refusal);
+
+    for (guint i = 0; !refusal.done && i < 5000; ++i)
+        pump_once ();
+
+    g_assert_error (refusal.error, G_IO_ERROR, G_IO_ERROR_BUSY);
+    g_clear_error (&refusal.error);
+}
+
+/* A history usually switched to next is read ahead of the switch, so going
+ * round more histories than "recent-histories" keeps is still served from
+ * memory once the round is known. */
+static void
+test_prefetch_likely_next_history (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 10);
+    g_autofree gchar *first = g_strdup (g_paste_history_get_current (history));
+    const gchar *round[] = { "prefetch-b", "prefetch-c", first };
+
+    /* Only the history just left is kept: without reading ahead, each switch
+     * of the round would be a read. */
+    g_paste_settings_set_recent_histories (settings, 1);
+    g_paste_history_add (history, g_paste_text_item_new (first));
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (g_paste_settings_get_storage_backend (settings), settings);
+
+        for (guint i = 0; i < 2; ++i)
+        {
+            GList *items = g_list_append (NULL, g_paste_text_item_new (round[i]));
+
+            g_paste_storage_backend_write_history (backend, round[i], items);
+            g_list_free_full (items, g_object_unref);
+        }
+    }
+
+    for (guint r = 0; r < 3; ++r)
+    {
+        for (guint i = 0; i < G_N_ELEMENTS (round); ++i)
+        {
+            g_paste_settings_set_history_name (settings, round[i]);
+            g_assert_true (pump_until_current (history, round[i], 5000));
+            g_assert_true (pump_until_length (history, 1, 5000));
+            g_assert_cmpstr (value_at (history, 0), ==, round[i]);
+            /* For the next one to be read ahead and kept */
+            pump_for_ms (100);
+        }
+    }
+
+    guint64 switches, hits, prefetches, prefetch_hits;
+
+    g_paste_history_get_switch_stats (history, &switches, &hits, &prefetches, &prefetch_hits);
+
+    /* The first round is learnt, reading each history in; the others are read
+     * ahead, all of them. */
+    g_assert_cmpuint (switches, ==, 9);
+    g_assert_cmpuint (hits, ==, 6);
+    g_assert_cmpuint (prefetch_hits, ==, 6);
+    g_assert_cmpuint (prefetches, >=, prefetch_hits);
+
+    g_paste_history_delete (history, "prefetch-b", NULL);
+    g_paste_history_delete (history, "prefetch-c", NULL);
+}
+
+/* A re-executed daemon takes the history over from memory -- the password a
+ * plain store never keeps is the proof -- once it went through the sealed memfd
+ * unchanged, but reads it back when the store was written in between. */
+static void
+test_history_handover (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    GPasteHistory *history = make_history (&settings, 10);
+    g_autofree gchar *name = g_strdup (g_paste_history_get_current (history));
+
+    g_paste_history_add (history, g_paste_text_item_new ("handed over"));
+    g_paste_history_add (history, g_paste_password_item_new ("handover-password", "hunter2"));
+    g_paste_history_flush (history);
+
+    g_autoptr (GVariant) state = g_paste_history_export_state (history);
+
+    g_clear_object (&history);
+    g_assert_nonnull (state);
+
+    {
+        g_auto (GVariantDict) dict = G_VARIANT_DICT_INIT (NULL);
+
+        g_variant_dict_insert_value (&dict, "history", state);
+
+        g_autoptr (GVariant) sent = g_variant_ref_sink (g_variant_dict_end (&dict));
+        g_autoptr (GError) error = NULL;
+
+        g_assert_cmpint (g_paste_handover_send (sent, &error), >=, 0);
+        g_assert_no_error (error);
+
+        g_autoptr (GVariant) received = g_paste_handover_receive ();
+
+        g_assert_nonnull (received);
+        g_assert_true (g_variant_equal (received, sent));
+        /* Taken once and for all. */
+        g_assert_null (g_paste_handover_receive ());
+    }
+
+    g_paste_settings_set_history_name (settings, name);
+
+    {
+        g_autoptr (GPasteHistory) successor = g_paste_history_new (settings);
+
+        g_paste_history_load_state_async (successor, state);
+        g_assert_true (pump_until_length (successor, 2, 5000));
+
+        GPasteItem *password = g_paste_history_get (successor, 0);
+
+        g_assert_true (G_PASTE_IS_PASSWORD_ITEM (password));
+        g_assert_cmpstr (g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM (password)), ==, "handover-password");
+        g_assert_cmpstr (g_paste_item_get_real_value (password), ==, "hunter2");
+        g_assert_cmpstr (value_at (successor, 1), ==, "handed over");
+    }
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (g_paste_settings_get_storage_backend (settings), settings);
+        GList *items = g_list_append (NULL, g_paste_text_item_new ("written since"));
+
+        g_paste_storage_backend_write_history (backend, name, items);
+        g_list_free_full (items, g_object_unref);
+    }
+
+    {
+        g_autoptr (GPasteHistory) successor = g_paste_history_new (settings);
+
+        g_paste_history_load_state_async (successor, state);
+        g_assert_true (pump_until_length (successor, 1, 5000));
+        g_assert_cmpstr (value_at (successor, 0), ==, "written since");
+    }
+}
+
+static void
+test_select_moves_to_front (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+
+    g_paste_history_add (history, g_paste_text_item_new ("a"));
+    g_autofree gchar *uuid_a = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
+    g_paste_history_add (history, g_paste_text_item_new ("b"));
+    g_paste_history_add (history, g_paste_text_item_new ("c"));
+
+    g_assert_true (g_paste_history_select (history, uuid_a));
+
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 3);
+    g_assert_cmpstr (value_at (history, 0), ==, "a");
+
+    g_assert_false (g_paste_history_select (history, "missing"));
+}
+
+static void
+test_empty (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+
+    g_paste_history_add (history, g_paste_text_item_new ("a"));
+    g_paste_history_add (history, g_paste_text_item_new ("b"));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 2);
+
+    g_paste_history_empty (history);
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 0);
+    g_assert_null (g_paste_history_get (history, 0));
+}
+
+static void
+test_save_load_roundtrip (void)
+{
+    const gchar *name = "roundtrip";
+
+    /* Write through the async saver: add two items, then flush so the
+     * background write deterministically reaches disk. */
+    {
+        g_autoptr (GPasteHistory) writer = make_plain_history ();
+        g_paste_history_load (writer, name);
+
+        g_paste_history_add (writer, g_paste_text_item_new ("alpha"));
+        g_paste_history_add (writer, g_paste_text_item_new ("beta"));
+
+        g_paste_history_flush (writer);
+    }
+
+    /* Read it back asynchronously into a fresh history. */
+    {
+        g_autoptr (GPasteHistory) reader = make_plain_history ();
+        g_paste_history_load_async (reader, name);
+
+        g_assert_true (pump_until_length (reader, 2, 5000));
+        g_assert_cmpstr (value_at (reader, 0), ==, "beta");
+        g_assert_cmpstr (value_at (reader, 1), ==, "alpha");
+    }
+}
+
+/* g_paste_history_flush() must get every pending change to disk synchronously,
+ * without the caller having to pump the main loop: an exit/handover path relies
+ * on the on-disk history being complete the moment flush() returns. */
+static void
+test_flush_persists_synchronously (void)
+{
+    const gchar *name = "flush-sync";
+
+    {
+        g_autoptr (GPasteHistory) writer = make_plain_history ();
+        g_paste_history_load (writer, name);
+
+        g_paste_history_add (writer, g_paste_text_item_new ("one"));
+        g_paste_history_add (writer, g_paste_text_item_new ("two"));
+
+        /* Note: no main-loop pumping here, unlike the roundtrip test. */
+        g_paste_history_flush (writer);
+    }
+
+    {
+        g_autoptr (GPasteHistory) reader = make_plain_history ();
+        g_paste_history_load_async (reader, name);
+
+        g_assert_true (pump_until_length (reader, 2, 5000));
+        g_assert_cmpstr (value_at (reader, 0), ==, "two");
+        g_assert_cmpstr (value_at (reader, 1), ==, "one");
+    }
+}
+
+/* After a flush the history stops persisting changes, so a successor daemon that
+ * has taken over the on-disk state is not overwritten by our late edits. */
+static void
+test_flush_stops_recording (void)
+{
+    const gchar *name = "flush-stop";
+
+    {
+        g_autoptr (GPasteHistory) writer = make_plain_history ();
+        g_paste_history_load (writer, name);
+
+        g_paste_history_add (writer, g_paste_text_item_new ("kept"));
+        g_paste_history_flush (writer);
+
+        /* This change happens after the flush: it stays in memory but must never
+         * reach the disk. Pump the loop so an (erroneous) async write would run. */
+        g_paste_history_add (writer, g_paste_text_item_new ("dropped"));
+
+        pump_for_ms (100);
+    }
+
+    {
+        g_autoptr (GPasteHistory) reader = make_plain_history ();
+        g_paste_history_load_async (reader, name);
+
+        g_assert_true (pump_until_length (reader, 1, 5000));
+        g_assert_cmpstr (value_at (reader, 0), ==, "kept");
+    }
 }
 
 /* A delete must not race whoever owns the store now: once the history has been
@@ -1529,7 +2566,7 @@ test_encrypted_roundtrip (void)
     gsize raw_len = 0;
     g_assert_true (g_file_get_contents (path, &raw, &raw_len, NULL));
     g_assert_cmpuint (raw_len, >=, 8);
-    g_assert_cmpint (memcmp (raw, "GPSTENC1", 8), ==, 0);
+    g_assert_cmpint (memcmp (raw, "GPSTENC3", 8), ==, 0);
     /* Binary-safe scan: the ciphertext is full of NUL bytes, so g_strstr_len
      * would stop at the first one and only check a tiny prefix. */
     g_assert_false (file_contains (path, secret));
@@ -1586,66 +2623,364 @@ test_encrypted_roundtrip (void)
     g_list_free_full (items, g_object_unref);
 }
 
-/* g_paste_storage_backend_new_with_passphrase() must key the backend with
- * exactly the passphrase it is given, never with the process-wide one: a
- * migration between two encrypted flavors holds the source and the destination
- * open at the same time under two different keys, and reading the source with
- * the destination's key would yield an empty history that passes for an emptied
- * one. */
+/* Run @input through @converter in one go. */
+static GBytes *
+convert_bytes (GConverter   *converter,
+               GBytes       *input,
+               GError      **error)
+{
+    g_autoptr (GOutputStream) sink = g_memory_output_stream_new_resizable ();
+    g_autoptr (GOutputStream) stream = g_converter_output_stream_new (sink, converter);
+    gsize size;
+    const guchar *data = g_bytes_get_data (input, &size);
+
+    if (!g_output_stream_write_all (stream, data, size, NULL, NULL, error) ||
+        !g_output_stream_close (stream, NULL, error))
+        return NULL;
+
+    return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (sink));
+}
+
+/* The streams written in a session share the salt (hence one Argon2id run
+ * between them) but not their key, and a version 1 stream, salted and keyed on
+ * its own, still decrypts. */
 static void
-test_encrypted_explicit_passphrase (void)
+test_encrypted_stream_master_key (void)
 {
-    if (g_test_subprocess ())
-    {
-        G_PASTE_TEST_IN_SUBPROCESS;
+    const gchar *passphrase = "one derivation for them all";
+    g_autoptr (GBytes) plain = g_bytes_new_static ("some history", 12);
+    g_autoptr (GConverter) encrypt_a = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase);
+    g_autoptr (GConverter) encrypt_b = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GBytes) a = convert_bytes (encrypt_a, plain, &error);
 
-        const gchar *name = "encrypted-explicit";
-        const gchar *source_passphrase = "the source passphrase";
-        const gchar *value = "only the source key reads this";
+    g_assert_no_error (error);
 
-        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    gint64 start = g_get_monotonic_time ();
+    g_autoptr (GBytes) b = convert_bytes (encrypt_b, plain, &error);
+    gint64 elapsed = g_get_monotonic_time () - start;
 
-        /* The process-wide passphrase is deliberately a different one throughout,
-         * standing in for the destination's key during a migration. */
-        g_paste_storage_backend_set_passphrase ("the destination passphrase");
+    g_assert_no_error (error);
+    g_test_message ("second stream keyed in %" G_GINT64_FORMAT " us", elapsed);
 
-        {
-            g_autoptr (GPasteStorageBackend) backend =
-                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, source_passphrase);
-            GList *items = g_list_append (NULL, g_paste_text_item_new (value));
+    const guchar *ra = g_bytes_get_data (a, NULL);
+    const guchar *rb = g_bytes_get_data (b, NULL);
 
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
-        }
+    /* magic (8), salt (16), opslimit and memlimit (16), nonce (32) */
+    g_assert_cmpint (memcmp (ra, "GPSTENC3", 8), ==, 0);
+    g_assert_cmpint (memcmp (rb, "GPSTENC3", 8), ==, 0);
+    g_assert_cmpint (memcmp (ra + 8, rb + 8, 16), ==, 0);
+    g_assert_cmpint (memcmp (ra + 40, rb + 40, 32), !=, 0);
+    g_assert_false (g_bytes_equal (a, b));
 
-        /* The explicit key reads it back... */
-        {
-            g_autoptr (GPasteStorageBackend) backend =
-                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, source_passphrase);
-            g_autolist (GPasteItem) loaded = read_history_ok (backend, name);
-            g_assert_cmpuint (g_list_length (loaded), ==, 1);
-            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, value);
-        }
+    for (guint i = 0; i < 2; ++i)
+    {
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        g_autoptr (GBytes) back = convert_bytes (decrypt, (i) ? b : a, &error);
 
-        /* ...while the process-wide one does not, and is refused rather than
-         * silently yielding an empty history. */
-        {
-            g_autoptr (GPasteStorageBackend) backend =
-                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings,
-                                                             g_paste_storage_backend_get_passphrase ());
-            assert_history_refused (backend, name);
-        }
+        g_assert_no_error (error);
+        g_assert_true (g_bytes_equal (back, plain));
+    }
 
-        /* No passphrase at all degrades to "no storage" instead of falling back
-         * to the process-wide one (the destination's key here). */
-        {
-            g_autoptr (GPasteStorageBackend) backend =
-                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, NULL);
-            g_autolist (GPasteItem) loaded = read_history (backend, name);
-            g_assert_null (loaded);
-        }
+    /* Forgotten keys are derived again, from the salt in the stream. */
+    g_paste_secret_stream_converter_forget_keys ();
 
-        /* The plain constructor, by contrast, does fall back to the process-wide
+    {
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        g_autoptr (GBytes) back = convert_bytes (decrypt, a, &error);
+
+        g_assert_no_error (error);
+        g_assert_true (g_bytes_equal (back, plain));
+    }
+
+    /* Version 1, built by hand: the Argon2id output is the stream key. */
+    guchar salt[crypto_pwhash_SALTBYTES];
+    guchar key[crypto_secretstream_xchacha20poly1305_KEYBYTES];
+    guchar header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    guchar cipher[12 + crypto_secretstream_xchacha20poly1305_ABYTES];
+    unsigned long long clen = 0;
+    crypto_secretstream_xchacha20poly1305_state state;
+    guint64 opslimit = GUINT64_TO_LE (crypto_pwhash_OPSLIMIT_MIN);
+    guint64 memlimit = GUINT64_TO_LE (crypto_pwhash_MEMLIMIT_MIN);
+    guint32 frame_len;
+    g_autoptr (GByteArray) v1 = g_byte_array_new ();
+
+    randombytes_buf (salt, sizeof (salt));
+    g_assert_true (g_paste_crypto_derive_key (passphrase, strlen (passphrase), salt,
+                                              crypto_pwhash_OPSLIMIT_MIN, crypto_pwhash_MEMLIMIT_MIN,
+                                              key, sizeof (key), NULL));
+    crypto_secretstream_xchacha20poly1305_init_push (&state, header, key);
+    crypto_secretstream_xchacha20poly1305_push (&state, cipher, &clen, g_bytes_get_data (plain, NULL), 12, NULL, 0,
+                                                crypto_secretstream_xchacha20poly1305_TAG_FINAL);
+    frame_len = GUINT32_TO_LE ((guint32) clen);
+
+    g_byte_array_append (v1, (const guint8 *) "GPSTENC1", 8);
+    g_byte_array_append (v1, salt, sizeof (salt));
+    g_byte_array_append (v1, (const guint8 *) &opslimit, 8);
+    g_byte_array_append (v1, (const guint8 *) &memlimit, 8);
+    g_byte_array_append (v1, header, sizeof (header));
+    g_byte_array_append (v1, (const guint8 *) &frame_len, 4);
+    g_byte_array_append (v1, cipher, clen);
+
+    g_autoptr (GBytes) v1_bytes = g_byte_array_free_to_bytes (g_steal_pointer (&v1));
+    g_autoptr (GConverter) decrypt_v1 = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+    g_autoptr (GBytes) v1_back = convert_bytes (decrypt_v1, v1_bytes, &error);
+
+    g_assert_no_error (error);
+    g_assert_true (g_bytes_equal (v1_back, plain));
+}
+
+/* Plaintext for the segmented stream tests: not all zeroes, so a segment
+ * landing in the wrong place shows. */
+static GBytes *
+test_stream_plaintext (gsize size)
+{
+    guint8 *data = g_malloc (size);
+
+    for (gsize i = 0; i < size; ++i)
+        data[i] = (guint8) (i * 31 + i / 4096);
+
+    return g_bytes_new_take (data, size);
+}
+
+/* A stream spanning several segments round-trips, and one cut short -- mid
+ * segment, at a segment boundary, or right before the manifest -- or tampered
+ * with fails to decrypt instead of passing for a shorter history. */
+static void
+test_encrypted_segmented_stream (void)
+{
+    const gchar *passphrase = "many cores";
+    g_autoptr (GBytes) plain = test_stream_plaintext ((5 << 20) / 2);
+    g_autoptr (GConverter) encrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase);
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GBytes) sealed = convert_bytes (encrypt, plain, &error);
+
+    g_assert_no_error (error);
+
+    gsize sealed_len;
+    const guint8 *raw = g_bytes_get_data (sealed, &sealed_len);
+
+    g_assert_cmpint (memcmp (raw, "GPSTENC3", 8), ==, 0);
+
+    {
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        g_autoptr (GBytes) back = convert_bytes (decrypt, sealed, &error);
+
+        g_assert_no_error (error);
+        g_assert_true (g_bytes_equal (back, plain));
+    }
+
+    /* header (76), then frames of clen (4) and 1 MiB + 16; the manifest is
+     * 4 + 32 bytes. */
+    gsize header_len = 8 + 16 + 8 + 8 + 32 + 4;
+    gsize cuts[] = {
+        sealed_len - 1,
+        sealed_len - (4 + 32),
+        header_len + 4 + (1 << 20) + 16,
+        header_len + 100,
+    };
+
+    for (guint i = 0; i < G_N_ELEMENTS (cuts); ++i)
+    {
+        g_autoptr (GBytes) truncated = g_bytes_new_from_bytes (sealed, 0, cuts[i]);
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        g_autoptr (GError) cut_error = NULL;
+        g_autoptr (GBytes) back = convert_bytes (decrypt, truncated, &cut_error);
+
+        g_assert_null (back);
+        g_assert_nonnull (cut_error);
+    }
+
+    {
+        g_autofree guint8 *tampered = g_memdup2 (raw, sealed_len);
+
+        tampered[header_len + 4 + (1 << 20) + 16 + 4 + 10] ^= 1;
+
+        g_autoptr (GBytes) tampered_bytes = g_bytes_new_take (g_steal_pointer (&tampered), sealed_len);
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        g_autoptr (GError) tamper_error = NULL;
+        g_autoptr (GBytes) back = convert_bytes (decrypt, tampered_bytes, &tamper_error);
+
+        g_assert_null (back);
+        g_assert_error (tamper_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    }
+
+    /* The sequential format is still written on demand, and read. */
+    g_autoptr (GConverter) encrypt_v2 = g_paste_secret_stream_converter_new_full (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase,
+                                                                                  G_PASTE_SECRET_STREAM_FORMAT_SEQUENTIAL);
+    g_autoptr (GBytes) v2 = convert_bytes (encrypt_v2, plain, &error);
+
+    g_assert_no_error (error);
+    g_assert_cmpint (memcmp (g_bytes_get_data (v2, NULL), "GPSTENC2", 8), ==, 0);
+
+    g_autoptr (GConverter) decrypt_v2 = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+    g_autoptr (GBytes) v2_back = convert_bytes (decrypt_v2, v2, &error);
+
+    g_assert_no_error (error);
+    g_assert_true (g_bytes_equal (v2_back, plain));
+}
+
+/* Write @input to @path through @converter the way the file backend saves a
+ * history: a converter output stream over the replaced file, fed a piece at a
+ * time (the backend writes an item, or a fragment of one, per call). */
+static gboolean
+seal_to_file (GConverter   *converter,
+              GBytes       *input,
+              const gchar  *path,
+              GError      **error)
+{
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    g_autoptr (GFileOutputStream) file_out = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, error);
+
+    if (!file_out)
+        return FALSE;
+
+    g_autoptr (GOutputStream) stream = g_converter_output_stream_new (G_OUTPUT_STREAM (file_out), converter);
+    gsize size;
+    const guchar *data = g_bytes_get_data (input, &size);
+
+    for (gsize pos = 0; pos < size; pos += 4096)
+    {
+        if (!g_output_stream_write_all (stream, data + pos, MIN (size - pos, 4096), NULL, NULL, error))
+            return FALSE;
+    }
+
+    return g_output_stream_close (stream, NULL, error);
+}
+
+/* Read @path back through @converter the way the file backend loads a history:
+ * a converter input stream spliced into memory. */
+static GBytes *
+open_from_file (GConverter   *converter,
+                const gchar  *path,
+                GError      **error)
+{
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+    g_autoptr (GFileInputStream) file_in = g_file_read (file, NULL, error);
+
+    if (!file_in)
+        return NULL;
+
+    g_autoptr (GInputStream) stream = g_converter_input_stream_new (G_INPUT_STREAM (file_in), converter);
+    g_autoptr (GOutputStream) sink = g_memory_output_stream_new_resizable ();
+
+    if (g_output_stream_splice (sink, stream,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                NULL, error) < 0)
+        return NULL;
+
+    return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (sink));
+}
+
+/* Benchmark: encryption and decryption throughput of the sequential and the
+ * segmented formats, through a file written and read back the way the file
+ * backend does it. 256 MiB under -m perf, 16 MiB otherwise; the key is derived
+ * before timing, so this is the cipher and the plumbing alone. */
+static void
+test_encrypted_stream_benchmark (void)
+{
+    static const gchar *format_names[] = { "segmented", "sequential" };
+    const gchar *passphrase = "throughput";
+    gsize size = (g_test_perf ()) ? (gsize) 256 << 20 : (gsize) 16 << 20;
+    g_autoptr (GBytes) plain = test_stream_plaintext (size);
+    g_autofree gchar *path = g_build_filename (g_get_user_data_dir (), "stream-benchmark.enc", NULL);
+    g_autoptr (GError) error = NULL;
+
+    for (GPasteSecretStreamFormat format = G_PASTE_SECRET_STREAM_FORMAT_SEGMENTED; format <= G_PASTE_SECRET_STREAM_FORMAT_SEQUENTIAL; ++format)
+    {
+        /* Warm the master key cache. */
+        g_autoptr (GConverter) warm = g_paste_secret_stream_converter_new_full (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase, format);
+
+        g_assert_true (seal_to_file (warm, plain, path, &error));
+        g_assert_no_error (error);
+
+        g_autoptr (GConverter) encrypt = g_paste_secret_stream_converter_new_full (G_PASTE_SECRET_STREAM_ENCRYPT, passphrase, format);
+        gint64 start = g_get_monotonic_time ();
+        gboolean sealed = seal_to_file (encrypt, plain, path, &error);
+        gint64 encrypt_time = g_get_monotonic_time () - start;
+
+        g_assert_no_error (error);
+        g_assert_true (sealed);
+
+        g_autoptr (GConverter) decrypt = g_paste_secret_stream_converter_new (G_PASTE_SECRET_STREAM_DECRYPT, passphrase);
+        start = g_get_monotonic_time ();
+        g_autoptr (GBytes) back = open_from_file (decrypt, path, &error);
+        gint64 decrypt_time = g_get_monotonic_time () - start;
+
+        g_assert_no_error (error);
+        g_assert_true (g_bytes_equal (back, plain));
+
+        g_test_message ("%" G_GSIZE_FORMAT " MiB %-10s encrypt %8.1f MB/s  decrypt %8.1f MB/s (%u cores)",
+                        size >> 20, format_names[format],
+                        size / (gdouble) MAX (encrypt_time, 1), size / (gdouble) MAX (decrypt_time, 1),
+                        g_get_num_processors ());
+    }
+
+    g_autoptr (GFile) file = g_file_new_for_path (path);
+
+    g_file_delete (file, NULL, NULL);
+}
+
+/* g_paste_storage_backend_new_with_passphrase() must key the backend with
+ * exactly the passphrase it is given, never with the process-wide one: a
+ * migration between two encrypted flavors holds the source and the destination
+ * open at the same time under two different keys, and reading the source with
+ * the destination's key would yield an empty history that passes for an emptied
+ * one. */
+static void
+test_encrypted_explicit_passphrase (void)
+{
+    if (g_test_subprocess ())
+    {
+        G_PASTE_TEST_IN_SUBPROCESS;
+
+        const gchar *name = "encrypted-explicit";
+        const gchar *source_passphrase = "the source passphrase";
+        const gchar *value = "only the source key reads this";
+
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+        /* The process-wide passphrase is deliberately a different one throughout,
+         * standing in for the destination's key during a migration. */
+        g_paste_storage_backend_set_passphrase ("the destination passphrase");
+
+        {
+            g_autoptr (GPasteStorageBackend) backend =
+                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, source_passphrase);
+            GList *items = g_list_append (NULL, g_paste_text_item_new (value));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        /* The explicit key reads it back... */
+        {
+            g_autoptr (GPasteStorageBackend) backend =
+                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, source_passphrase);
+            g_autolist (GPasteItem) loaded = read_history_ok (backend, name);
+            g_assert_cmpuint (g_list_length (loaded), ==, 1);
+            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, value);
+        }
+
+        /* ...while the process-wide one does not, and is refused rather than
+         * silently yielding an empty history. */
+        {
+            g_autoptr (GPasteStorageBackend) backend =
+                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings,
+                                                             g_paste_storage_backend_get_passphrase ());
+            assert_history_refused (backend, name);
+        }
+
+        /* No passphrase at all degrades to "no storage" instead of falling back
+         * to the process-wide one (the destination's key here). */
+        {
+            g_autoptr (GPasteStorageBackend) backend =
+                g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, NULL);
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            g_assert_null (loaded);
+        }
+
+        /* The plain constructor, by contrast, does fall back to the process-wide
          * passphrase — which is the destination's, hence unable to read this. */
         {
             g_autoptr (GPasteStorageBackend) backend =
@@ -1900,7 +3235,7 @@ test_sqlite_roundtrip (void)
     items = g_list_append (items, g_paste_uris_item_new_from_str ("file:///tmp/a\nfile:///tmp/b"));
     items = g_list_append (items, g_paste_color_item_new_from_str ("rgb(255,0,0)"));
     items = g_list_append (items, g_paste_image_item_new_from_file (png_path, date,
-                                                                    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"));
+                                                                    "0123456789abcdef0123456789abcdef-0123456789abcdef"));
     items = g_list_append (items, g_paste_password_item_new ("my login", "s3cr3t"));
 
     g_paste_storage_backend_write_history (backend, name, items);
@@ -1955,7 +3290,7 @@ test_sqlite_roundtrip (void)
 
     g_assert_cmpint (g_date_time_to_unix ((GDateTime *) g_paste_image_item_get_date (image)), ==, 1234567890);
     g_assert_cmpstr (g_paste_image_item_get_checksum (image), ==,
-                     "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+                     "0123456789abcdef0123456789abcdef-0123456789abcdef");
 
     GBytes *read_png = g_paste_image_item_get_png_bytes (image);
 
@@ -2189,741 +3524,2190 @@ test_sqlite_schema_migration (void)
         g_list_free_full (history, g_object_unref);
     }
 
-    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA user_version;"), ==, 2);
+    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA user_version;"), ==, 4);
     g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM pragma_table_info ('items') WHERE name = 'favourite';"), ==, 1);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM pragma_table_info ('items') WHERE name = 'history_id';"), ==, 1);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM pragma_table_info ('items') WHERE name = 'compression';"), ==, 1);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM pragma_table_info ('special_values') WHERE name = 'compression';"), ==, 1);
 }
 
-/* remove_item relies on the FK cascade to clean an item's special values, and
- * foreign_keys is a per-connection pragma that fails silent: prove it is
- * actually ON for the backend's connection instead of leaking orphaned blobs. */
+/* The plain SQLite store answers literal searches out of its FTS5 index, kept
+ * in step by every incremental write: matching is a caseless substring one,
+ * the history's order is kept, and SearchAll ranks across histories. Skipped
+ * where the SQLite in use was built without FTS5. */
 static void
-test_sqlite_cascade (void)
+test_sqlite_fts_search (void)
 {
-    const gchar *name = "sqlite-cascade";
+    const gchar *name = "sqlite-fts";
+    const gchar *other = "sqlite-fts-other";
 
     g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_growing_lines (settings, FALSE);
+    g_paste_settings_set_max_history_size (settings, 10);
+    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_SQLITE);
+
     g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
 
-    GPasteItem *rich = g_paste_text_item_new ("rich");
-    g_paste_item_add_special_value (rich, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
-                                                                   g_bytes_new_static ("<b>rich</b>", 11)));
-    g_paste_item_add_special_value (rich, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_GNOME_COPIED_FILES,
-                                                                   g_bytes_new_static ("copy\nfile:///tmp/z", 18)));
+    g_paste_history_load (history, name);
+    g_paste_history_empty (history);
 
-    GPasteItem *survivor = g_paste_text_item_new ("survivor");
-    g_paste_item_add_special_value (survivor, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
-                                                                       g_bytes_new_static ("<u>keep</u>", 11)));
+    g_paste_history_add (history, g_paste_text_item_new ("Hello World"));
+    g_autofree gchar *hello = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
+    g_paste_history_add (history, g_paste_text_item_new ("say hello again"));
+    g_autofree gchar *again = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
+    g_paste_history_add (history, g_paste_text_item_new ("nothing to see"));
 
-    GList *items = NULL;
-    items = g_list_append (items, rich);
-    items = g_list_append (items, survivor);
+    g_auto (GStrv) found = g_paste_history_search (history, "HELLO");
 
-    g_paste_storage_backend_write_history (backend, name, items);
+    /* In history order, whichever way they were found. */
+    g_assert_cmpuint (g_strv_length (found), ==, 2);
+    g_assert_cmpstr (found[0], ==, again);
+    g_assert_cmpstr (found[1], ==, hello);
 
-    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+    g_auto (GStrv) stored = g_paste_storage_backend_search (backend, name, "hello");
 
-    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM special_values;"), ==, 3);
+    if (!stored)
+    {
+        g_test_skip ("SQLite built without FTS5");
+        g_paste_history_delete (history, name, NULL);
+        return;
+    }
 
-    /* The backend is incremental, so the fallback snapshot is never used. */
-    g_paste_storage_backend_remove_item (backend, name, g_paste_item_get_uuid (rich), NULL);
+    g_assert_cmpuint (g_strv_length (stored), ==, 2);
+    g_assert_true (g_strv_contains ((const gchar * const *) stored, hello));
+    g_assert_true (g_strv_contains ((const gchar * const *) stored, again));
 
-    /* Only the survivor and its own special value remain. */
-    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 1);
-    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM special_values;"), ==, 1);
+    /* Too short for a trigram: left to the history's own scan. */
+    g_assert_null (g_paste_storage_backend_search (backend, name, "he"));
 
-    g_list_free_full (items, g_object_unref);
-}
+    /* Removing and replacing items is seen by the index. */
+    g_assert_true (g_paste_history_remove_by_uuid (history, hello));
+    g_paste_history_replace (history, again, "goodbye");
 
-/* The images/<name>/ directory belongs to the history *name*, shared across
- * backend flavors: a migration imports into the destination and then deletes
- * the source under the same name, which must not sweep the images the
- * destination just materialized. Only the last flavor to store the name may
- * take the directory with it. */
-static void
-test_sqlite_migration_keeps_destination_images (void)
-{
-    const gchar *name = "sqlite-migrate-images";
+    g_auto (GStrv) after_edit = g_paste_history_search (history, "hello");
+    g_auto (GStrv) stored_after_edit = g_paste_storage_backend_search (backend, name, "hello");
+    g_auto (GStrv) replaced = g_paste_storage_backend_search (backend, name, "goodbye");
 
-    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_assert_cmpuint (g_strv_length (after_edit), ==, 0);
+    g_assert_cmpuint (g_strv_length (stored_after_edit), ==, 0);
+    g_assert_cmpuint (g_strv_length (replaced), ==, 1);
 
-    g_paste_settings_set_images_support (settings, TRUE);
+    /* A regex is still a regex. */
+    g_auto (GStrv) regex = g_paste_history_search (history, "^good.*e$");
 
-    g_autoptr (GBytes) png = test_png_bytes_colored (22, 23, 24);
-    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
-    GList *items = g_list_append (NULL, g_paste_image_item_new_from_bytes (png, date, NULL));
+    g_assert_cmpuint (g_strv_length (regex), ==, 1);
 
-    g_assert_nonnull (items->data);
+    /* Across histories, best first and paged. */
+    GList *items = NULL;
 
-    g_autoptr (GPasteStorageBackend) source = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-    g_autoptr (GPasteStorageBackend) destination = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+    items = g_list_append (items, g_paste_text_item_new ("goodbye goodbye goodbye"));
+    items = g_list_append (items, g_paste_text_item_new ("unrelated"));
+    g_paste_storage_backend_write_history (backend, other, items);
+    g_list_free_full (items, g_object_unref);
 
-    /* What a sqlite -> file migration does: import, then clean the source up. */
-    g_paste_storage_backend_write_history (source, name, items);
-    g_paste_storage_backend_write_history (destination, name, items);
+    g_autoptr (GPtrArray) hits = g_paste_history_search_all (history, "goodbye", 0, 0);
 
-    g_autofree gchar *image_path = g_paste_file_backend_image_path (name,
-                                                                    g_paste_image_item_get_checksum (items->data));
+    g_assert_nonnull (hits);
+    g_assert_cmpuint (hits->len, ==, 2);
 
-    g_assert_true (g_file_test (image_path, G_FILE_TEST_EXISTS));
+    GPasteStorageHit *best = g_ptr_array_index (hits, 0);
+    GPasteStorageHit *next = g_ptr_array_index (hits, 1);
 
-    g_paste_storage_backend_delete_history (source, name, NULL);
+    g_assert_cmpstr (best->history, ==, other);
+    g_assert_cmpstr (g_paste_item_get_value (best->item), ==, "goodbye goodbye goodbye");
+    g_assert_cmpstr (next->history, ==, name);
+    g_assert_cmpfloat (best->score, >=, next->score);
 
-    /* The destination still stores the name: its images must survive... */
-    g_assert_true (g_file_test (image_path, G_FILE_TEST_EXISTS));
+    g_autoptr (GPtrArray) page = g_paste_history_search_all (history, "goodbye", 1, 1);
 
-    g_autolist (GPasteItem) loaded = read_history (destination, name);
-    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+    g_assert_nonnull (page);
+    g_assert_cmpuint (page->len, ==, 1);
+    g_assert_cmpstr (((GPasteStorageHit *) g_ptr_array_index (page, 0))->history, ==, name);
 
-    /* ...and go away with the last flavor storing it. */
-    g_paste_storage_backend_delete_history (destination, name, NULL);
-    g_assert_false (g_file_test (image_path, G_FILE_TEST_EXISTS));
+    /* Emptying the history empties its part of the index. */
+    g_paste_history_empty (history);
 
-    g_list_free_full (items, g_object_unref);
+    g_auto (GStrv) emptied = g_paste_history_search (history, "goodbye");
+    g_auto (GStrv) stored_emptied = g_paste_storage_backend_search (backend, name, "goodbye");
+
+    g_assert_cmpuint (g_strv_length (emptied), ==, 0);
+    g_assert_cmpuint (g_strv_length (stored_emptied), ==, 0);
+
+    g_paste_storage_backend_delete_history (backend, other, NULL);
+    g_paste_history_delete (history, name, NULL);
 }
 
-/* The stored blob is the source of truth for images: an item must survive the
- * complete absence of its on-disk cache file — including rebuilding its
- * texture — while a plain database visibly contains the PNG. */
+/* With a resident history size, only the newest items are held in memory and
+ * the rest stay in the store, yet it all behaves as one history: its length,
+ * lookups, searches and selection reach the cold items, the caps cut from the
+ * cold end, and another daemon reads back what was left. */
 static void
-test_sqlite_image_blob (void)
+test_tiered_history (void)
 {
-    const gchar *name = "sqlite-image-blob";
+    const gchar *name = "tiered";
 
     g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-    g_paste_settings_set_images_support (settings, TRUE);
+    g_paste_settings_set_growing_lines (settings, FALSE);
+    g_paste_settings_set_max_history_size (settings, 20);
+    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_SQLITE);
+    g_paste_settings_set_resident_history_size (settings, 3);
 
-    g_autoptr (GBytes) png = test_png_bytes_colored (10, 11, 12);
-    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
-    GList *items = g_list_append (NULL, g_paste_image_item_new_from_bytes (png, date, NULL));
+    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
 
-    g_assert_nonnull (items->data);
+    g_paste_history_load (history, name);
+    g_paste_history_empty (history);
 
-    /* The bytes-built item never touches the disk: it names no file at all, and
-     * the one the file backend would have written for it does not exist. */
-    g_assert_null (g_paste_image_item_get_cache_path (items->data));
+    for (guint i = 0; i < 10; ++i)
+    {
+        g_autofree gchar *value = g_strdup_printf ("cold item %u", i);
 
-    g_autofree gchar *cache_path = g_paste_file_backend_image_path (name,
-                                                                    g_paste_image_item_get_checksum (items->data));
+        g_paste_history_add (history, g_paste_text_item_new (value));
+    }
 
-    g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
+    /* The newest three in memory, the rest in the store, all of it one history. */
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 10);
+    g_assert_cmpuint (g_paste_history_get_history (history)->len, ==, 3);
+    g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get (history, 0)), ==, "cold item 9");
+    g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get (history, 5)), ==, "cold item 4");
 
-    {
-        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autofree gchar *one = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 8)));
+    g_autofree gchar *zero = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 9)));
 
-        g_paste_storage_backend_write_history (backend, name, items);
-        /* Dropping the backend checkpoints the WAL for the scan below. */
-    }
+    g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get_by_uuid (history, one)), ==, "cold item 1");
 
-    /* A plain database carries the PNG in clear (its IHDR chunk shows). */
-    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+    /* Found whether the store answers the search or the history scans it. */
+    g_auto (GStrv) literal = g_paste_history_search (history, "cold item 2");
+    g_auto (GStrv) regex = g_paste_history_search (history, "^cold item [34]$");
 
-    g_assert_true (file_contains (path, "IHDR"));
+    g_assert_cmpuint (g_strv_length (literal), ==, 1);
+    g_assert_cmpuint (g_strv_length (regex), ==, 2);
 
-    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-    g_autolist (GPasteItem) loaded = read_history (backend, name);
+    /* Selecting a cold item brings it back in front. */
+    g_paste_history_select (history, one);
 
-    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 10);
+    g_assert_cmpstr (g_paste_item_get_uuid (g_paste_history_get (history, 0)), ==, one);
+    g_assert_cmpuint (g_paste_history_get_history (history)->len, ==, 3);
 
-    GPasteItem *read = loaded->data;
-    GPasteImageItem *image = G_PASTE_IMAGE_ITEM (read);
-    GBytes *read_png = g_paste_image_item_get_png_bytes (image);
+    /* And the caps still apply to the whole of it, cutting from the cold end. */
+    for (guint i = 10; i < 21; ++i)
+    {
+        g_autofree gchar *value = g_strdup_printf ("cold item %u", i);
+
+        g_paste_history_add (history, g_paste_text_item_new (value));
+    }
+
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 20);
+    g_assert_null (g_paste_history_get_by_uuid (history, zero));
+
+    g_autofree gchar *two = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 19)));
+
+    g_assert_true (g_paste_history_remove_by_uuid (history, two));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 19);
+    g_assert_null (g_paste_history_get_by_uuid (history, two));
+
+    /* What another daemon reads back is what was left. */
+    g_paste_history_flush (history);
+
+    g_autoptr (GPasteHistory) reloaded = g_paste_history_new (settings);
+
+    g_paste_history_load (reloaded, name);
+
+    g_assert_cmpuint (g_paste_history_get_length (reloaded), ==, 19);
+    g_assert_cmpuint (g_paste_history_get_history (reloaded)->len, ==, 3);
+    g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get (reloaded, 0)), ==, "cold item 20");
+
+    g_paste_history_delete (reloaded, name, NULL);
+}
+
+/* Drain the main context for up to @max_ms ms, stopping early once @history
+ * holds @expected_len entries in memory: once a streamed load is all in. */
+static gboolean
+pump_until_resident (GPasteHistory *history,
+                     guint          expected_len,
+                     guint          max_ms)
+{
+    for (guint i = 0; i < max_ms; ++i)
+    {
+        if (g_paste_history_get_history (history)->len == expected_len)
+            return TRUE;
+
+        pump_once ();
+    }
+    return g_paste_history_get_history (history)->len == expected_len;
+}
+
+/* A history loaded in the background shows its whole length from the first
+ * page on and streams the rest in behind it, reading back on demand whatever
+ * has not come yet. Copies made while it streams leave no page out and none
+ * in twice. */
+static void
+test_progressive_load (void)
+{
+    const gchar *name = "progressive";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_growing_lines (settings, FALSE);
+    g_paste_settings_set_max_history_size (settings, 1000);
+    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_SQLITE);
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    GList *items = NULL;
+
+    for (guint i = 0; i < 300; ++i)
+    {
+        g_autofree gchar *value = g_strdup_printf ("streamed %u", i);
+
+        items = g_list_prepend (items, g_paste_text_item_new (value));
+    }
+
+    g_paste_storage_backend_write_history (backend, name, items);
+    g_list_free_full (items, g_object_unref);
+
+    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
+
+    g_paste_history_load_async (history, name);
+
+    /* The whole length is known from the first page on, and what has not
+     * streamed in yet is read back on demand. */
+    g_assert_true (pump_until_length (history, 300, 5000));
+    g_assert_cmpstr (value_at (history, 0), ==, "streamed 299");
+    g_assert_cmpstr (value_at (history, 299), ==, "streamed 0");
+
+    /* Changes in the middle of the stream leave no page out, and none twice. */
+    for (guint i = 0; i < 3; ++i)
+    {
+        g_autofree gchar *value = g_strdup_printf ("while streaming %u", i);
+
+        g_paste_history_add (history, g_paste_text_item_new (value));
+        pump_once ();
+    }
+
+    g_assert_true (pump_until_resident (history, 303, 5000));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 303);
+    g_assert_cmpstr (value_at (history, 0), ==, "while streaming 2");
+    g_assert_cmpstr (value_at (history, 3), ==, "streamed 299");
+    g_assert_cmpstr (value_at (history, 152), ==, "streamed 150");
+    g_assert_cmpstr (value_at (history, 302), ==, "streamed 0");
+
+    /* And the store still holds all of it. */
+    g_paste_history_flush (history);
+
+    g_autolist (GPasteItem) stored = read_history (backend, name);
+
+    g_assert_cmpuint (g_list_length (stored), ==, 303);
+
+    g_paste_history_resume (history);
+    g_paste_history_delete (history, name, NULL);
+}
+
+/* With "sqlite-single-database", every history is rows in one database: no
+ * per-history file appears, and listing, counting, copying and deleting a
+ * history are all answered from it. The per-history databases an earlier run
+ * left behind are taken over rather than forgotten. */
+static void
+test_sqlite_single_database (void)
+{
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_database_path (G_PASTE_STORAGE_SQLITE);
+    g_autofree gchar *left_path = g_paste_util_get_history_file_path ("sqlite-single-left", "db");
+    g_autofree gchar *one_path = g_paste_util_get_history_file_path ("sqlite-single-one", "db");
+    GList *left = g_list_append (NULL, g_paste_text_item_new ("left behind"));
+    GList *one = NULL;
+
+    one = g_list_append (one, g_paste_text_item_new ("first"));
+    one = g_list_append (one, g_paste_text_item_new ("second"));
+
+    /* Written by the per-history layout, before the setting changed. */
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+
+        g_paste_storage_backend_write_history (backend, "sqlite-single-left", left);
+    }
+
+    g_assert_true (g_file_test (left_path, G_FILE_TEST_EXISTS));
+
+    g_paste_settings_set_sqlite_single_database (settings, TRUE);
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+        g_autoptr (GError) error = NULL;
+        guint64 length = 0;
+
+        g_paste_storage_backend_write_history (backend, "sqlite-single-one", one);
+        g_paste_storage_backend_clear_history (backend, "sqlite-single-two", NULL);
+
+        /* The history left in its own database moved over with the first use. */
+        g_assert_true (g_file_test (single_path, G_FILE_TEST_EXISTS));
+        g_assert_false (g_file_test (one_path, G_FILE_TEST_EXISTS));
+        g_assert_false (g_file_test (left_path, G_FILE_TEST_EXISTS));
+
+        g_auto (GStrv) names = g_paste_storage_backend_list_histories (backend, &error);
+
+        g_assert_no_error (error);
+        g_assert_true (g_strv_contains ((const gchar * const *) names, "sqlite-single-one"));
+        g_assert_true (g_strv_contains ((const gchar * const *) names, "sqlite-single-two"));
+        g_assert_true (g_strv_contains ((const gchar * const *) names, "sqlite-single-left"));
+
+        g_assert_true (g_paste_storage_backend_count_history (backend, "sqlite-single-one", &length));
+        g_assert_cmpuint (length, ==, 2);
+        g_assert_true (g_paste_storage_backend_count_history (backend, "sqlite-single-left", &length));
+        g_assert_cmpuint (length, ==, 1);
+        g_assert_true (g_paste_storage_backend_count_history (backend, "sqlite-single-two", &length));
+        g_assert_cmpuint (length, ==, 0);
+        /* Counting a history that does not exist does not create it. */
+        g_assert_true (g_paste_storage_backend_count_history (backend, "sqlite-single-none", &length));
+        g_assert_cmpuint (length, ==, 0);
+        g_assert_false (g_paste_storage_backend_has_history (backend, "sqlite-single-none"));
+
+        g_assert_true (g_paste_storage_backend_copy_history (backend, "sqlite-single-one", "sqlite-single-two", &error));
+        g_assert_no_error (error);
+
+        g_autolist (GPasteItem) copied = read_history (backend, "sqlite-single-two");
+
+        g_assert_cmpuint (g_list_length (copied), ==, 2);
+        g_assert_cmpstr (g_paste_item_get_value (copied->data), ==, "first");
+
+        /* Each history keeps its own rows: the copy is not the original. */
+        g_paste_storage_backend_clear_history (backend, "sqlite-single-one", NULL);
+        g_assert_true (g_paste_storage_backend_count_history (backend, "sqlite-single-two", &length));
+        g_assert_cmpuint (length, ==, 2);
+
+        g_assert_cmpint (sqlite_raw_count (single_path, "SELECT COUNT (*) FROM histories WHERE name LIKE 'sqlite-single-%';"), ==, 3);
+
+        /* The earlier tests' databases were taken over too, as they share the
+         * history dir: delete everything so the last deletion can be seen. */
+        g_auto (GStrv) all = g_paste_storage_backend_list_histories (backend, &error);
+
+        g_assert_no_error (error);
+
+        for (GStrv name = all; *name; ++name)
+        {
+            g_paste_storage_backend_delete_history (backend, *name, &error);
+            g_assert_no_error (error);
+            g_assert_false (g_paste_storage_backend_has_history (backend, *name));
+        }
+
+        /* The database goes with its last history. */
+        g_assert_false (g_file_test (single_path, G_FILE_TEST_EXISTS));
+    }
+
+    g_paste_settings_set_sqlite_single_database (settings, FALSE);
+
+    g_list_free_full (left, g_object_unref);
+    g_list_free_full (one, g_object_unref);
+}
+
+/* The rows a history keeps past max-history-size are moved along with the rest
+ * when "sqlite-single-database" changes, both ways: taking a history over must
+ * not read it back through the size cap. */
+static void
+test_sqlite_layout_switch_keeps_every_row (void)
+{
+    const gchar *name = "sqlite-layout-switch";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autofree gchar *single_path = g_paste_sqlite_backend_get_single_database_path (G_PASTE_STORAGE_SQLITE);
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+    guint64 max_history_size = g_paste_settings_get_max_history_size (settings);
+    GList *items = NULL;
+
+    for (guint i = 0; i < 10; ++i)
+    {
+        g_autofree gchar *text = g_strdup_printf ("layout-%u", i);
+        items = g_list_append (items, g_paste_text_item_new (text));
+    }
+
+    g_paste_settings_set_max_history_size (settings, 100);
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+
+        g_paste_storage_backend_write_history (backend, name, items);
+    }
+
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 10);
+
+    g_paste_settings_set_max_history_size (settings, 3);
+    g_paste_settings_set_sqlite_single_database (settings, TRUE);
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+        guint64 length = 0;
+
+        /* Counting is what takes the history over here. */
+        g_assert_true (g_paste_storage_backend_count_history (backend, name, &length));
+        g_assert_cmpuint (length, ==, 3);
+    }
+
+    g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+    g_assert_cmpint (sqlite_raw_count (single_path, "SELECT COUNT (*) FROM items "
+                                                    "WHERE history_id = (SELECT id FROM histories WHERE name = 'sqlite-layout-switch');"), ==, 10);
+
+    g_paste_settings_set_sqlite_single_database (settings, FALSE);
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+        g_autolist (GPasteItem) history = read_history (backend, name);
+        g_autoptr (GError) error = NULL;
+
+        g_assert_cmpuint (g_list_length (history), ==, 3);
+        g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 10);
+
+        g_paste_storage_backend_delete_history (backend, name, &error);
+        g_assert_no_error (error);
+    }
+
+    g_paste_settings_set_max_history_size (settings, max_history_size);
+
+    g_list_free_full (items, g_object_unref);
+}
+
+/* remove_item relies on the FK cascade to clean an item's special values, and
+ * foreign_keys is a per-connection pragma that fails silent: prove it is
+ * actually ON for the backend's connection instead of leaking orphaned blobs. */
+static void
+test_sqlite_cascade (void)
+{
+    const gchar *name = "sqlite-cascade";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+
+    GPasteItem *rich = g_paste_text_item_new ("rich");
+    g_paste_item_add_special_value (rich, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
+                                                                   g_bytes_new_static ("<b>rich</b>", 11)));
+    g_paste_item_add_special_value (rich, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_GNOME_COPIED_FILES,
+                                                                   g_bytes_new_static ("copy\nfile:///tmp/z", 18)));
+
+    GPasteItem *survivor = g_paste_text_item_new ("survivor");
+    g_paste_item_add_special_value (survivor, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
+                                                                       g_bytes_new_static ("<u>keep</u>", 11)));
+
+    GList *items = NULL;
+    items = g_list_append (items, rich);
+    items = g_list_append (items, survivor);
+
+    g_paste_storage_backend_write_history (backend, name, items);
+
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM special_values;"), ==, 3);
+
+    /* The backend is incremental, so the fallback snapshot is never used. */
+    g_paste_storage_backend_remove_item (backend, name, g_paste_item_get_uuid (rich), NULL);
+
+    /* Only the survivor and its own special value remain. */
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 1);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM special_values;"), ==, 1);
+
+    g_list_free_full (items, g_object_unref);
+}
+
+static goffset
+sqlite_wal_size (const gchar *path)
+{
+    g_autofree gchar *wal = g_strconcat (path, "-wal", NULL);
+    g_autoptr (GFile) file = g_file_new_for_path (wal);
+    g_autoptr (GFileInfo) info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    return (info) ? g_file_info_get_size (info) : 0;
+}
+
+/* Maintaining a database gives the pages its removed rows freed back to the
+ * filesystem and folds the WAL back in, and a run with no budget left stops
+ * short of the vacuum and says so. */
+static void
+test_sqlite_maintenance (void)
+{
+    const gchar *name = "sqlite-maintenance";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    GList *items = NULL;
+
+    /* Random enough not to compress away: the rows must take up pages. */
+    for (guint i = 0; i < 200; ++i)
+    {
+        g_autoptr (GString) text = g_string_new (NULL);
+
+        while (text->len < 8192)
+            g_string_append_printf (text, "%08x", g_random_int ());
+
+        items = g_list_append (items, g_paste_text_item_new (text->str));
+    }
+
+    g_paste_storage_backend_write_history (backend, name, items);
+
+    for (GList *l = items->next; l; l = l->next)
+        g_paste_storage_backend_remove_item (backend, name, g_paste_item_get_uuid (l->data), NULL);
+
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+
+    /* Created in incremental auto-vacuum mode, so no whole VACUUM is needed. */
+    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA auto_vacuum;"), ==, 2);
+    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA freelist_count;"), >, 0);
+    g_assert_cmpint (sqlite_wal_size (path), >, 0);
+
+    GPasteStorageMaintenance cut_short = { 0 };
+
+    g_assert_false (g_paste_storage_backend_maintain (backend, name, g_get_monotonic_time (), &cut_short));
+    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA freelist_count;"), >, 0);
+
+    GPasteStorageMaintenance report = { 0 };
+
+    g_assert_true (g_paste_storage_backend_maintain (backend, name, g_get_monotonic_time () + G_TIME_SPAN_MINUTE, &report));
+    g_assert_cmpuint (report.reclaimed, >, 0);
+    g_assert_cmpint (sqlite_raw_count (path, "PRAGMA freelist_count;"), ==, 0);
+    g_assert_cmpint (sqlite_wal_size (path), ==, 0);
+
+    /* Only the removed rows went. */
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 1);
+
+    g_list_free_full (items, g_object_unref);
+}
+
+/* The images/<name>/ directory belongs to the history *name*, shared across
+ * backend flavors: a migration imports into the destination and then deletes
+ * the source under the same name, which must not sweep the images the
+ * destination just materialized. Only the last flavor to store the name may
+ * take the directory with it. */
+static void
+test_sqlite_migration_keeps_destination_images (void)
+{
+    const gchar *name = "sqlite-migrate-images";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_images_support (settings, TRUE);
+
+    g_autoptr (GBytes) png = test_png_bytes_colored (22, 23, 24);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GList *items = g_list_append (NULL, g_paste_image_item_new_from_bytes (png, date, NULL));
+
+    g_assert_nonnull (items->data);
+
+    g_autoptr (GPasteStorageBackend) source = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autoptr (GPasteStorageBackend) destination = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+
+    /* What a sqlite -> file migration does: import, then clean the source up. */
+    g_paste_storage_backend_write_history (source, name, items);
+    g_paste_storage_backend_write_history (destination, name, items);
+
+    g_autofree gchar *image_path = g_paste_file_backend_image_path (name,
+                                                                    g_paste_image_item_get_checksum (items->data));
+
+    g_assert_true (g_file_test (image_path, G_FILE_TEST_EXISTS));
+
+    g_paste_storage_backend_delete_history (source, name, NULL);
+
+    /* The destination still stores the name: its images must survive... */
+    g_assert_true (g_file_test (image_path, G_FILE_TEST_EXISTS));
+
+    g_autolist (GPasteItem) loaded = read_history (destination, name);
+    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+
+    /* ...and go away with the last flavor storing it. */
+    g_paste_storage_backend_delete_history (destination, name, NULL);
+    g_assert_false (g_file_test (image_path, G_FILE_TEST_EXISTS));
+
+    g_list_free_full (items, g_object_unref);
+}
+
+static void
+collect_uuid (gpointer data,
+              gpointer user_data)
+{
+    g_ptr_array_add (user_data, g_strdup (g_paste_item_get_uuid (data)));
+}
+
+/* A migration imports each history and checks the destination reads back as
+ * what it was given, through digests of both sides: the read-back goes
+ * through the destination an item at a time, in the order a read gives. A
+ * plain destination leaving the password out is no mismatch, it never stores
+ * one. */
+static void
+test_sqlite_import_digest_match (void)
+{
+    const gchar *name = "sqlite-import-match";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autoptr (GPasteStorageBackend) source = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autoptr (GPasteStorageBackend) destination = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+    GList *items = NULL;
+
+    items = g_list_append (items, g_paste_text_item_new ("newest"));
+    items = g_list_append (items, g_paste_password_item_new ("secret", "hunter2"));
+    items = g_list_append (items, g_paste_text_item_new ("oldest"));
+    g_paste_storage_backend_write_history (source, name, items);
+
+    gsize size = 0;
+
+    g_assert_true (g_paste_storage_migration_import_history (source, destination, name, &size));
+    g_assert_cmpuint (size, >, 0);
+
+    g_autolist (GPasteItem) loaded = read_history (destination, name);
+    g_autoptr (GPtrArray) uuids = g_ptr_array_new_with_free_func (g_free);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 2);
+    g_assert_true (g_paste_storage_backend_foreach_item (destination, name, collect_uuid, uuids));
+    g_assert_cmpuint (uuids->len, ==, 2);
+    g_assert_cmpstr (g_ptr_array_index (uuids, 0), ==, g_paste_item_get_uuid (loaded->data));
+    g_assert_cmpstr (g_ptr_array_index (uuids, 1), ==, g_paste_item_get_uuid (loaded->next->data));
+
+    g_paste_storage_backend_delete_history (source, name, NULL);
+    g_paste_storage_backend_delete_history (destination, name, NULL);
+    g_list_free_full (items, g_object_unref);
+}
+
+/* A destination that loses the oldest item of every history written to it,
+ * which is what the import's check is there to catch. Everything else goes to
+ * the backend it wraps. */
+G_DECLARE_FINAL_TYPE (GPasteLossyBackend, g_paste_lossy_backend, G_PASTE, LOSSY_BACKEND, GPasteStorageBackend)
+
+struct _GPasteLossyBackend
+{
+    GPasteStorageBackend parent_instance;
+
+    GPasteStorageBackend *inner;
+};
+
+G_DEFINE_TYPE (GPasteLossyBackend, g_paste_lossy_backend, G_PASTE_TYPE_STORAGE_BACKEND)
+
+static gboolean
+g_paste_lossy_backend_read_history_file (GPasteStorageBackend *self,
+                                         const gchar          *name,
+                                         GList               **history,
+                                         gsize                *size)
+{
+    return g_paste_storage_backend_read_history (G_PASTE_LOSSY_BACKEND (self)->inner, name, history, size);
+}
+
+static void
+g_paste_lossy_backend_write_history_file (GPasteStorageBackend *self,
+                                          const gchar          *name,
+                                          const GList          *history)
+{
+    GList *kept = g_list_copy ((GList *) history);
+
+    kept = g_list_delete_link (kept, g_list_last (kept));
+    g_paste_storage_backend_write_history (G_PASTE_LOSSY_BACKEND (self)->inner, name, kept);
+    g_list_free (kept);
+}
+
+static GPasteStorage
+g_paste_lossy_backend_get_kind (GPasteStorageBackend *self)
+{
+    return g_paste_storage_backend_get_kind (G_PASTE_LOSSY_BACKEND (self)->inner);
+}
+
+static void
+g_paste_lossy_backend_dispose (GObject *object)
+{
+    g_clear_object (&G_PASTE_LOSSY_BACKEND (object)->inner);
+
+    G_OBJECT_CLASS (g_paste_lossy_backend_parent_class)->dispose (object);
+}
+
+static void
+g_paste_lossy_backend_class_init (GPasteLossyBackendClass *klass)
+{
+    GPasteStorageBackendClass *storage_class = G_PASTE_STORAGE_BACKEND_CLASS (klass);
+
+    storage_class->read_history_file = g_paste_lossy_backend_read_history_file;
+    storage_class->write_history_file = g_paste_lossy_backend_write_history_file;
+    storage_class->get_kind = g_paste_lossy_backend_get_kind;
+    G_OBJECT_CLASS (klass)->dispose = g_paste_lossy_backend_dispose;
+}
+
+static void
+g_paste_lossy_backend_init (GPasteLossyBackend *self G_GNUC_UNUSED)
+{
+}
+
+/* A destination that did not keep what it was given fails the import, which is
+ * what keeps the migration from deleting the originals. */
+static void
+test_sqlite_import_digest_mismatch (void)
+{
+    const gchar *name = "sqlite-import-mismatch";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autoptr (GPasteStorageBackend) source = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autoptr (GPasteLossyBackend) destination = g_object_new (g_paste_lossy_backend_get_type (), NULL);
+    GList *items = NULL;
+
+    destination->inner = g_paste_storage_backend_new (G_PASTE_STORAGE_FILE, settings);
+    items = g_list_append (items, g_paste_text_item_new ("kept"));
+    items = g_list_append (items, g_paste_text_item_new ("lost"));
+    g_paste_storage_backend_write_history (source, name, items);
+
+    gsize size = 0;
+
+    g_assert_false (g_paste_storage_migration_import_history (source, G_PASTE_STORAGE_BACKEND (destination), name, &size));
+
+    /* The read-back itself went fine: it is the contents that differ. */
+    g_autolist (GPasteItem) loaded = read_history (destination->inner, name);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+    g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "kept");
+
+    g_paste_storage_backend_delete_history (source, name, NULL);
+    g_paste_storage_backend_delete_history (destination->inner, name, NULL);
+    g_list_free_full (items, g_object_unref);
+}
+
+/* A SQLite history copies through the online backup API: the copy is a
+ * database of its own, images included, that later writes to the source never
+ * reach — and one that replaces an older copy leaves none of it behind. */
+static void
+test_sqlite_copy_history (void)
+{
+    const gchar *name = "sqlite-copy-src";
+    const gchar *copy = "sqlite-copy-dst";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_images_support (settings, TRUE);
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autoptr (GBytes) png = test_png_bytes_colored (28, 29, 30);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GList *items = NULL;
+
+    items = g_list_append (items, g_paste_text_item_new ("front"));
+    items = g_list_append (items, g_paste_image_item_new_from_bytes (png, date, NULL));
+
+    GList *stale = g_list_append (NULL, g_paste_text_item_new ("stale"));
+
+    g_paste_storage_backend_write_history (backend, copy, stale);
+    g_paste_storage_backend_write_history (backend, name, items);
+
+    g_autoptr (GError) error = NULL;
+
+    g_assert_true (g_paste_storage_backend_copy_history (backend, name, copy, &error));
+    g_assert_no_error (error);
+
+    g_paste_storage_backend_add_item (backend, name, g_list_last (items)->data, NULL);
+
+    g_autolist (GPasteItem) loaded = read_history (backend, copy);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 2);
+    g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "front");
+    g_assert_cmpint (g_paste_item_get_kind (loaded->next->data), ==, G_PASTE_ITEM_KIND_IMAGE);
+    g_assert_true (g_bytes_equal (g_paste_image_item_get_png_bytes (loaded->next->data), png));
+
+    g_list_free_full (items, g_object_unref);
+    g_list_free_full (stale, g_object_unref);
+}
+
+/* The stored blob is the source of truth for images: an item must survive the
+ * complete absence of its on-disk cache file — including rebuilding its
+ * texture — while a plain database visibly contains the PNG. */
+static void
+test_sqlite_image_blob (void)
+{
+    const gchar *name = "sqlite-image-blob";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_images_support (settings, TRUE);
+
+    g_autoptr (GBytes) png = test_png_bytes_colored (10, 11, 12);
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GList *items = g_list_append (NULL, g_paste_image_item_new_from_bytes (png, date, NULL));
+
+    g_assert_nonnull (items->data);
+
+    /* The bytes-built item never touches the disk: it names no file at all, and
+     * the one the file backend would have written for it does not exist. */
+    g_assert_null (g_paste_image_item_get_cache_path (items->data));
+
+    g_autofree gchar *cache_path = g_paste_file_backend_image_path (name,
+                                                                    g_paste_image_item_get_checksum (items->data));
+
+    g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+
+        g_paste_storage_backend_write_history (backend, name, items);
+        /* Dropping the backend checkpoints the WAL for the scan below. */
+    }
+
+    /* A plain database carries the PNG in clear (its IHDR chunk shows). */
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+
+    g_assert_true (file_contains (path, "IHDR"));
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+    g_autolist (GPasteItem) loaded = read_history (backend, name);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 1);
+
+    GPasteItem *read = loaded->data;
+    GPasteImageItem *image = G_PASTE_IMAGE_ITEM (read);
+    GBytes *read_png = g_paste_image_item_get_png_bytes (image);
+
+    g_assert_cmpint (g_paste_item_get_kind (read), ==, G_PASTE_ITEM_KIND_IMAGE);
+    g_assert_nonnull (read_png);
+    g_assert_true (g_bytes_equal (read_png, png));
+    g_assert_cmpstr (g_paste_image_item_get_checksum (image),
+                     ==, g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (items->data)));
+
+    /* The texture rebuilds from the bytes, with no file anywhere. */
+    g_assert_null (g_paste_image_item_get_cache_path (image));
+    g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
+    g_paste_item_set_state (read, G_PASTE_ITEM_STATE_ACTIVE);
+    g_assert_nonnull (g_paste_image_item_get_image (image));
+    g_paste_item_set_state (read, G_PASTE_ITEM_STATE_IDLE);
+
+    g_list_free_full (items, g_object_unref);
+}
+
+/* Switching histories loads with save_after=TRUE so a snapshot-rewriting
+ * backend persists its read-time normalization — for an incremental backend
+ * that full rewrite is skipped: the database must keep rows beyond
+ * max-history-size (only memory is capped) instead of being truncated by a
+ * write-back of the capped read. */
+static void
+test_sqlite_no_rewrite_on_switch (void)
+{
+    const gchar *big_name = "sqlite-switch-big";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_growing_lines (settings, FALSE);
+    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_max_history_size (settings, 100);
+    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_SQLITE);
+
+    /* Seed a history holding more items than the soon-to-be max size. */
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+        GList *items = NULL;
+
+        for (guint i = 0; i < 7; ++i)
+        {
+            g_autofree gchar *text = g_strdup_printf ("big-%u", i);
+            items = g_list_append (items, g_paste_text_item_new (text));
+        }
+
+        g_paste_storage_backend_write_history (backend, big_name, items);
+        g_list_free_full (items, g_object_unref);
+    }
+
+    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
+
+    g_paste_history_load (history, "sqlite-switch-start");
+    g_paste_settings_set_max_history_size (settings, 5);
+
+    /* Switch through the settings key: this is the path that loads with
+     * save_after=TRUE (g_paste_history_load itself never writes back). */
+    g_paste_settings_set_history_name (settings, big_name);
+    g_assert_true (pump_until_length (history, 5, 5000));
+
+    /* Flush the saver: a (wrongly) recorded post-load rewrite would be applied
+     * right here, so the assertion below catches it deterministically. */
+    g_paste_history_flush (history);
+
+    /* Memory is capped at 5, but all 7 rows must still be in the database. */
+    g_autofree gchar *path = g_paste_util_get_history_file_path (big_name, "db");
+
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 7);
+}
+
+/* A database created by a newer GPaste (higher user_version) must be left
+ * alone: reads come back empty and writes are dropped instead of clobbering. */
+static void
+test_sqlite_version_guard (void)
+{
+    if (g_test_subprocess ())
+    {
+        G_PASTE_TEST_IN_SUBPROCESS;
+
+        const gchar *name = "sqlite-newer";
+
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+        sqlite3 *db = NULL;
+        sqlite3_stmt *stmt = NULL;
+        gint64 current_version = 0;
+
+        /* Remember the real schema version to restore it after tampering. */
+        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_prepare_v2 (db, "PRAGMA user_version;", -1, &stmt, NULL), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_ROW);
+        current_version = sqlite3_column_int64 (stmt, 0);
+        sqlite3_finalize (stmt);
+        g_assert_cmpint (sqlite3_exec (db, "PRAGMA user_version = 99;", NULL, NULL, NULL), ==, SQLITE_OK);
+        sqlite3_close (db);
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            g_assert_null (loaded);
+
+            /* A write against the newer database must not touch it. */
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        /* Once the version is back within range, the original data is intact. */
+        g_autofree gchar *restore = g_strdup_printf ("PRAGMA user_version = %" G_GINT64_FORMAT ";", current_version);
+
+        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_exec (db, restore, NULL, NULL, NULL), ==, SQLITE_OK);
+        sqlite3_close (db);
+
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
+        g_autolist (GPasteItem) loaded = read_history (backend, name);
+        g_assert_cmpuint (g_list_length (loaded), ==, 1);
+        g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
+
+        return;
+    }
+
+    G_PASTE_TEST_TRAP_SUBPROCESS ("*newer GPaste*");
+}
+#endif
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+/* Two histories of the same flavor, keyed differently -- the state a rekey that
+ * fails partway through leaves behind, and which the migration warns about by
+ * name. A passphrase that opens one of them but not the other must be refused:
+ * accepting it would load the one it cannot open as empty, and that history's
+ * next save would then destroy the real content -- which is what answering on
+ * the first history that opens would do. */
+static void
+test_encrypted_split_keys_refuse_passphrase (void)
+{
+    const struct {
+        GPasteStorage kind;
+        const gchar  *first;
+        const gchar  *second;
+    } flavors[] = {
+        { G_PASTE_STORAGE_ENCRYPTED_FILE, "split-file-a", "split-file-b" },
+#ifdef G_PASTE_ENABLE_SQLITE
+        { G_PASTE_STORAGE_ENCRYPTED_SQLITE, "split-db-a", "split-db-b" },
+#endif
+    };
+
+    for (gsize i = 0; i < G_N_ELEMENTS (flavors); ++i)
+    {
+        const gchar *one = "passphrase one";
+        const gchar *two = "passphrase two";
+
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+        /* Both hold data, so neither can be silently re-keyed on open. */
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, one);
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("first"));
+
+            g_paste_storage_backend_write_history (backend, flavors[i].first, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, two);
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("second"));
+
+            g_paste_storage_backend_write_history (backend, flavors[i].second, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        /* Each opens its own and not the other, whichever is enumerated first. */
+        g_assert_false (g_paste_storage_passphrase_can_decrypt (flavors[i].kind, settings, one));
+        g_assert_false (g_paste_storage_passphrase_can_decrypt (flavors[i].kind, settings, two));
+
+        /* Both must go: every test in this binary shares one XDG_DATA_HOME, and
+         * a pair no single passphrase opens would make every later can_decrypt
+         * refuse -- which is precisely the behaviour under test.
+         *
+         * Not asserted for the same reason: that a passphrase opening
+         * everything is accepted. The scan sees whatever the other tests have
+         * left lying around under their own passphrases. */
+        g_autoptr (GPasteStorageBackend) cleanup_one = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, one);
+        g_autoptr (GPasteStorageBackend) cleanup_two = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, two);
+
+        g_paste_storage_backend_delete_history (cleanup_one, flavors[i].first, NULL);
+        g_paste_storage_backend_delete_history (cleanup_two, flavors[i].second, NULL);
+    }
+}
+#endif
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+/* Once no history refuted a passphrase, the store's key check vouches for it on
+ * its own: verifying again is one key derivation however many histories there
+ * are, and does not even look at them. Anything written under another
+ * passphrase drops the check, so it never vouches for a store that moved on. */
+static void
+test_encrypted_file_key_check (void)
+{
+    const gchar *passphrase = "checked once for all";
+    const gchar *other = "written under another";
+    const gchar *names[] = { "key-check-a", "key-check-b", "key-check-c" };
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, passphrase);
+    g_autofree gchar *dir = g_paste_util_get_history_dir_path ();
+    g_autofree gchar *check_path = g_build_filename (dir, "xmls.key-check", NULL);
+
+    for (gsize i = 0; i < G_N_ELEMENTS (names); ++i)
+    {
+        GList *items = g_list_append (NULL, g_paste_text_item_new (names[i]));
+
+        g_paste_storage_backend_write_history (backend, names[i], items);
+        g_list_free_full (items, g_object_unref);
+    }
+
+    /* What can_decrypt() does once its scan found nothing to object: not
+     * reached through it here, as the histories the other tests left behind
+     * under their own passphrases would object. */
+    G_PASTE_STORAGE_BACKEND_GET_CLASS (backend)->store_passphrase_confirmed (backend);
+    g_assert_true (g_file_test (check_path, G_FILE_TEST_EXISTS));
+
+    /* Starting from no key at all: the one derivation is the key check's. */
+    g_paste_secret_stream_converter_forget_keys ();
+
+    gint64 start = g_get_monotonic_time ();
+
+    g_assert_true (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, passphrase));
+    g_test_message ("verified through the key check in %" G_GINT64_FORMAT " us",
+                    g_get_monotonic_time () - start);
+
+    /* A passphrase it was not made for falls back to the histories. */
+    g_assert_false (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, other));
+
+    /* The key check itself. */
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+    gboolean matches = FALSE;
+    g_autoptr (GError) error = NULL;
+
+    g_assert_true (g_file_get_contents (check_path, &contents, &length, NULL));
+
+    g_autoptr (GBytes) check = g_bytes_new (contents, length);
+
+    g_assert_true (g_paste_secret_stream_key_check_match (passphrase, check, &matches, &error));
+    g_assert_no_error (error);
+    g_assert_true (matches);
+    g_assert_true (g_paste_secret_stream_key_check_match (other, check, &matches, &error));
+    g_assert_no_error (error);
+    g_assert_false (matches);
+
+    g_autoptr (GBytes) garbage = g_bytes_new_static ("GPSTKEY1 but no more", 20);
+
+    g_assert_false (g_paste_secret_stream_key_check_match (passphrase, garbage, &matches, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+
+    /* A history written under another passphrase drops it. */
+    {
+        g_autoptr (GPasteStorageBackend) foreign = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_FILE, settings, other);
+        GList *items = g_list_append (NULL, g_paste_text_item_new ("foreign"));
+
+        g_paste_storage_backend_write_history (foreign, "key-check-foreign", items);
+        g_list_free_full (items, g_object_unref);
+
+        g_assert_false (g_file_test (check_path, G_FILE_TEST_EXISTS));
+        g_paste_storage_backend_delete_history (foreign, "key-check-foreign", NULL);
+    }
+
+    for (gsize i = 0; i < G_N_ELEMENTS (names); ++i)
+        g_paste_storage_backend_delete_history (backend, names[i], NULL);
+}
+#endif
+
+#if defined(G_PASTE_ENABLE_SQLITE) && defined(G_PASTE_ENABLE_ENCRYPTION)
+/* The Argon2 parameters live in the store's own `meta` table, so anything that
+ * can write to $XDG_DATA_HOME dictates them. An absurd opslimit would otherwise
+ * have crypto_pwhash run effectively forever -- a denial of service just from
+ * opening the history -- so deriving a key with them must be refused outright
+ * rather than attempted. The real data must survive the refusal. */
+static void
+test_encrypted_sqlite_absurd_kdf_params (void)
+{
+    if (g_test_subprocess ())
+    {
+        G_PASTE_TEST_IN_SUBPROCESS;
+
+        const gchar *name = "sqlite-absurd-kdf";
+        const gchar *passphrase = "correct horse battery staple";
+
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
+        sqlite3 *db = NULL;
+
+        /* Way past crypto_pwhash_OPSLIMIT_SENSITIVE. Deriving with this is what
+         * we must never get as far as doing. */
+        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_exec (db, "UPDATE meta SET value = 4000000000 WHERE key = 'opslimit';", NULL, NULL, NULL), ==, SQLITE_OK);
+        sqlite3_close (db);
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            g_assert_null (loaded);
+
+            /* And the refusal must not let a write clobber what is still there. */
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
+
+        /* Note what is deliberately *not* asserted here: that the passphrase is
+         * rejected. A store we cannot open is corrupt, not proof of a wrong
+         * passphrase, and saying otherwise would tell the user their correct one
+         * is wrong. Refusing the read and the write is what keeps the data safe,
+         * and that is what the restore below proves. */
+
+        /* Put the real parameters back: the original data is untouched. */
+        g_autofree gchar *restore = g_strdup_printf ("UPDATE meta SET value = %u WHERE key = 'opslimit';",
+                                                     (guint) crypto_pwhash_OPSLIMIT_MODERATE);
+
+        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_exec (db, restore, NULL, NULL, NULL), ==, SQLITE_OK);
+        sqlite3_close (db);
+
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
+        g_autolist (GPasteItem) loaded = read_history (backend, name);
+        g_assert_cmpuint (g_list_length (loaded), ==, 1);
+        g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
+
+        return;
+    }
+
+    G_PASTE_TEST_TRAP_SUBPROCESS ("*Unreasonable key-derivation parameters*");
+}
+
+/* The encrypted SQLite flavor must round-trip everything the plain one does,
+ * plus password items (real value and name), with no plaintext content ever
+ * reaching the ".dbs" file. */
+static void
+test_encrypted_sqlite_roundtrip (void)
+{
+    const gchar *name = "sqlite-encrypted";
+    const gchar *master = "the master passphrase";
+    const gchar *secret = "s3cr3t-passw0rd";
+    const gchar *pw_name = "my login";
+    const gchar *text_value = "plain text entry";
+    const gchar *html_value = "<b>hidden markup</b>";
+
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+
+    g_paste_settings_set_images_support (settings, TRUE);
+
+    g_autoptr (GBytes) png = test_png_bytes ();
+    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    GList *items = NULL;
+    GPasteItem *text = g_paste_text_item_new (text_value);
+
+    g_paste_item_add_special_value (text, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
+                                                                   g_bytes_new_static (html_value, strlen (html_value))));
+    items = g_list_append (items, text);
+    items = g_list_append (items, g_paste_password_item_new (pw_name, secret));
+    items = g_list_append (items, g_paste_color_item_new_from_str ("rgb(0,255,0)"));
+    items = g_list_append (items, g_paste_image_item_new_from_bytes (png, date, NULL));
+
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, master);
+
+        g_assert_true (g_paste_storage_backend_is_incremental (backend));
+        g_paste_storage_backend_write_history (backend, name, items);
+
+        g_auto (GStrv) names = g_paste_storage_backend_list_histories (backend, NULL);
+        g_assert_true (g_strv_contains ((const gchar * const *) names, name));
+
+        /* Dropping the backend closes the connection, checkpointing the WAL so
+         * everything is in the main database file for the scan below. */
+    }
+
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
+
+    g_assert_true (g_file_test (path, G_FILE_TEST_EXISTS));
+    g_assert_false (file_contains (path, text_value));
+    g_assert_false (file_contains (path, html_value));
+    g_assert_false (file_contains (path, secret));
+    g_assert_false (file_contains (path, pw_name));
+    /* The image blob is encrypted too: no PNG chunk marker in clear. */
+    g_assert_false (file_contains (path, "IHDR"));
+
+    /* The passphrase verification is quiet and flavor-aware. */
+    g_assert_true (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, master));
+    g_assert_false (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, "not the passphrase"));
+
+    g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, master);
+    g_autolist (GPasteItem) loaded = read_history (backend, name);
+
+    g_assert_cmpuint (g_list_length (loaded), ==, 4);
+
+    GPasteItem *read_text = loaded->data;
+    GPasteItem *read_password = loaded->next->data;
+    GPasteItem *read_color = loaded->next->next->data;
+    GPasteItem *read_image = loaded->next->next->next->data;
+
+    g_assert_cmpstr (g_paste_item_get_value (read_text), ==, text_value);
+
+    const GSList *svs = g_paste_item_get_special_values (read_text);
+    g_assert_cmpuint (g_slist_length ((GSList *) svs), ==, 1);
+    g_assert_cmpint (g_paste_binary_data_get_mime (svs->data), ==, G_PASTE_SPECIAL_ATOM_TEXT_HTML);
+    g_assert_cmpmem (g_bytes_get_data (g_paste_binary_data_get_bytes (svs->data), NULL), strlen (html_value),
+                     html_value, strlen (html_value));
+
+    g_assert_cmpint (g_paste_item_get_kind (read_password), ==, G_PASTE_ITEM_KIND_PASSWORD);
+    g_assert_cmpstr (g_paste_item_get_real_value (read_password), ==, secret);
+    g_assert_cmpstr (g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM ((gpointer) read_password)), ==, pw_name);
+
+    g_assert_cmpstr (g_paste_item_get_value (read_color), ==, g_paste_item_get_value (g_list_nth_data (items, 2)));
+
+    GBytes *read_png = g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (read_image));
 
-    g_assert_cmpint (g_paste_item_get_kind (read), ==, G_PASTE_ITEM_KIND_IMAGE);
     g_assert_nonnull (read_png);
     g_assert_true (g_bytes_equal (read_png, png));
-    g_assert_cmpstr (g_paste_image_item_get_checksum (image),
-                     ==, g_paste_image_item_get_checksum (G_PASTE_IMAGE_ITEM (items->data)));
-
-    /* The texture rebuilds from the bytes, with no file anywhere. */
-    g_assert_null (g_paste_image_item_get_cache_path (image));
-    g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
-    g_paste_item_set_state (read, G_PASTE_ITEM_STATE_ACTIVE);
-    g_assert_nonnull (g_paste_image_item_get_image (image));
-    g_paste_item_set_state (read, G_PASTE_ITEM_STATE_IDLE);
 
     g_list_free_full (items, g_object_unref);
 }
 
-/* Switching histories loads with save_after=TRUE so a snapshot-rewriting
- * backend persists its read-time normalization — for an incremental backend
- * that full rewrite is skipped: the database must keep rows beyond
- * max-history-size (only memory is capped) instead of being truncated by a
- * write-back of the capped read. */
+/* A wrong passphrase must be refused outright — reads come back empty, writes
+ * are dropped, the real data survives — while an *empty* encrypted history is
+ * silently re-keyed for the new passphrase instead of locking the user out. */
 static void
-test_sqlite_no_rewrite_on_switch (void)
+test_encrypted_sqlite_wrong_passphrase (void)
 {
-    const gchar *big_name = "sqlite-switch-big";
+    if (g_test_subprocess ())
+    {
+        G_PASTE_TEST_IN_SUBPROCESS;
 
-    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+        const gchar *name = "sqlite-encrypted-wrong";
 
-    g_paste_settings_set_growing_lines (settings, FALSE);
-    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
-    g_paste_settings_set_max_history_size (settings, 100);
-    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_SQLITE);
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-    /* Seed a history holding more items than the soon-to-be max size. */
-    {
-        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-        GList *items = NULL;
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "right passphrase");
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
+        }
 
-        for (guint i = 0; i < 7; ++i)
         {
-            g_autofree gchar *text = g_strdup_printf ("big-%u", i);
-            items = g_list_append (items, g_paste_text_item_new (text));
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "wrong passphrase");
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            g_assert_null (loaded);
+
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
+
+            g_paste_storage_backend_write_history (backend, name, items);
+            g_list_free_full (items, g_object_unref);
         }
 
-        g_paste_storage_backend_write_history (backend, big_name, items);
-        g_list_free_full (items, g_object_unref);
-    }
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "right passphrase");
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            g_assert_cmpuint (g_list_length (loaded), ==, 1);
+            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
+        }
 
-    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
+        /* An empty encrypted history holds nothing to lose: a different
+         * passphrase re-keys it instead of refusing it. */
+        const gchar *empty_name = "sqlite-encrypted-empty";
 
-    g_paste_history_load (history, "sqlite-switch-start");
-    g_paste_settings_set_max_history_size (settings, 5);
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "original passphrase");
+            g_autolist (GPasteItem) loaded = read_history (backend, empty_name);
+            g_assert_null (loaded);
+        }
 
-    /* Switch through the settings key: this is the path that loads with
-     * save_after=TRUE (g_paste_history_load itself never writes back). */
-    g_paste_settings_set_history_name (settings, big_name);
-    g_assert_true (pump_until_length (history, 5, 5000));
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "replacement passphrase");
+            g_autolist (GPasteItem) loaded = read_history (backend, empty_name);
+            g_assert_null (loaded);
 
-    /* Flush the saver: a (wrongly) recorded post-load rewrite would be applied
-     * right here, so the assertion below catches it deterministically. */
-    g_paste_history_flush (history);
+            GList *items = g_list_append (NULL, g_paste_text_item_new ("fresh start"));
 
-    /* Memory is capped at 5, but all 7 rows must still be in the database. */
-    g_autofree gchar *path = g_paste_util_get_history_file_path (big_name, "db");
+            g_paste_storage_backend_write_history (backend, empty_name, items);
+            g_list_free_full (items, g_object_unref);
 
-    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items;"), ==, 7);
+            g_autolist (GPasteItem) refilled = read_history (backend, empty_name);
+            g_assert_cmpuint (g_list_length (refilled), ==, 1);
+        }
+
+        return;
+    }
+
+    G_PASTE_TEST_TRAP_SUBPROCESS ("*does not unlock*");
 }
 
-/* A database created by a newer GPaste (higher user_version) must be left
- * alone: reads come back empty and writes are dropped instead of clobbering. */
+/* The database flavor re-keys every content column it holds — the value, the
+ * password name, the image blob and the special values — in one go, so the new
+ * passphrase reads all of it back and the old one no longer opens the file. */
 static void
-test_sqlite_version_guard (void)
+test_encrypted_sqlite_rekey (void)
 {
     if (g_test_subprocess ())
     {
+        /* The refused read with the old passphrase warns; see the file flavor's
+         * re-key test for why fatality is dropped here. */
         G_PASTE_TEST_IN_SUBPROCESS;
 
-        const gchar *name = "sqlite-newer";
+        const gchar *name = "sqlite-rekey";
+        const gchar *other_name = "sqlite-rekey-backup";
+        const gchar *other_value = "the second history";
+        const gchar *old_passphrase = "the old passphrase";
+        const gchar *new_passphrase = "the new passphrase";
+        const gchar *secret = "s3cr3t-passw0rd";
+        const gchar *pw_name = "my login";
+        const gchar *html_value = "<b>hidden markup</b>";
 
         g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+        g_autoptr (GBytes) png = test_png_bytes_colored (11, 13, 17);
+        g_autoptr (GBytes) html = g_bytes_new_static (html_value, strlen (html_value));
+        g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+
+        g_paste_settings_set_images_support (settings, TRUE);
 
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
+            GPasteItem *text = g_paste_text_item_new ("plain text entry");
+            GList *items = NULL;
+
+            /* A special value exercises the special_values.data column. */
+            g_paste_item_add_special_value (text, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
+                                                                           g_bytes_ref (html)));
+
+            items = g_list_append (items, text);
+            items = g_list_append (items, g_paste_password_item_new (pw_name, secret));
+            items = g_list_append (items, g_paste_image_item_new_from_bytes (png, date, NULL));
 
             g_paste_storage_backend_write_history (backend, name, items);
             g_list_free_full (items, g_object_unref);
+
+            /* A second history (a backup, say): the daemon re-keys every one of
+             * them through this same backend, so re-keying must leave it able to
+             * open the ones it has not reached yet — still with the old
+             * passphrase. */
+            GList *other_items = g_list_append (NULL, g_paste_text_item_new (other_value));
+
+            g_paste_storage_backend_write_history (backend, other_name, other_items);
+            g_list_free_full (other_items, g_object_unref);
+
+            g_assert_true (g_paste_storage_backend_rekey (backend, name, new_passphrase));
+            g_assert_true (g_paste_storage_backend_rekey (backend, other_name, new_passphrase));
+        }
+
+        /* Both histories moved, not just the first. */
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
+            g_autolist (GPasteItem) loaded = read_history_ok (backend, other_name);
+            g_assert_cmpuint (g_list_length (loaded), ==, 1);
+            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, other_value);
+        }
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
+            g_autolist (GPasteItem) loaded = read_history_ok (backend, name);
+            g_assert_cmpuint (g_list_length (loaded), ==, 3);
+
+            gboolean found_text = FALSE;
+            gboolean found_password = FALSE;
+            gboolean found_image = FALSE;
+
+            for (const GList *l = loaded; l; l = l->next)
+            {
+                GPasteItem *item = l->data;
+                GPasteItemKind kind = g_paste_item_get_kind (item);
+
+                if (kind == G_PASTE_ITEM_KIND_PASSWORD)
+                {
+                    found_password = TRUE;
+                    g_assert_cmpstr (g_paste_item_get_real_value (item), ==, secret);
+                    g_assert_cmpstr (g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM (item)), ==, pw_name);
+                }
+                else if (kind == G_PASTE_ITEM_KIND_IMAGE)
+                {
+                    found_image = TRUE;
+
+                    GBytes *read_png = g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item));
+
+                    g_assert_nonnull (read_png);
+                    g_assert_true (g_bytes_equal (read_png, png));
+                }
+                else
+                {
+                    const GSList *svs = g_paste_item_get_special_values (item);
+
+                    found_text = TRUE;
+
+                    g_assert_cmpuint (g_slist_length ((GSList *) svs), ==, 1);
+                    g_assert_cmpint (g_paste_binary_data_get_mime (svs->data), ==, G_PASTE_SPECIAL_ATOM_TEXT_HTML);
+                    g_assert_true (g_bytes_equal (g_paste_binary_data_get_bytes (svs->data), html));
+                }
+            }
+
+            g_assert_true (found_text);
+            g_assert_true (found_password);
+            g_assert_true (found_image);
+        }
+
+        {
+            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
+            assert_history_refused (backend, name);
         }
 
-        g_autofree gchar *path = g_paste_util_get_history_file_path (name, "db");
+        return;
+    }
+
+    G_PASTE_TEST_TRAP_SUBPROCESS ("*does not unlock*");
+}
+
+/* Overwrite the stored value of items row @rowid through a raw connection. */
+static void
+sqlite_raw_set_value (sqlite3      *db,
+                      gint64        rowid,
+                      gconstpointer data,
+                      gsize         length)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    g_assert_cmpint (sqlite3_prepare_v2 (db, "UPDATE items SET value = ? WHERE rowid = ?;", -1, &stmt, NULL), ==, SQLITE_OK);
+    sqlite3_bind_blob64 (stmt, 1, data, length, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 2, rowid);
+    g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_DONE);
+    sqlite3_finalize (stmt);
+}
+
+/* Write @n_items text items, "item 0" oldest, to @name through a fresh backend
+ * on @passphrase. @settings has to keep that many. */
+static void
+sqlite_rekey_fill (GPasteSettings *settings,
+                   const gchar    *name,
+                   const gchar    *passphrase,
+                   guint           n_items)
+{
+    g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, passphrase);
+    GList *items = NULL;
+
+    for (guint i = 0; i < n_items; ++i)
+    {
+        g_autofree gchar *value = g_strdup_printf ("item %u", i);
+
+        items = g_list_prepend (items, g_paste_text_item_new (value));
+    }
+
+    g_paste_storage_backend_write_history (backend, name, items);
+    g_list_free_full (items, g_object_unref);
+}
+
+/* A re-key that fails part way — here on a value that does not decrypt, put
+ * back afterwards — leaves the database on the old passphrase, and nothing of
+ * what its finished batches re-encrypted behind: no side table, no checkpoint,
+ * no salt or key check for the new passphrase, no triggers. The next re-key
+ * starts over and completes. */
+static void
+test_encrypted_sqlite_rekey_failure (void)
+{
+    if (g_test_subprocess ())
+    {
+        /* The failed re-key warns; see the file flavor's re-key test for why
+         * fatality is dropped here. */
+        G_PASTE_TEST_IN_SUBPROCESS;
+
+        const gchar *name = "sqlite-rekey-failure";
+        const gchar *old_passphrase = "the old passphrase";
+        const gchar *new_passphrase = "the new passphrase";
+        /* Past two full batches, so the third fails with two stored. */
+        const guint n_items = 600;
+
+        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+        g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
+
+        g_paste_settings_set_max_history_size (settings, n_items);
+        sqlite_rekey_fill (settings, name, old_passphrase, n_items);
+
+        g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
         sqlite3 *db = NULL;
         sqlite3_stmt *stmt = NULL;
-        gint64 current_version = 0;
 
-        /* Remember the real schema version to restore it after tampering. */
-        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
-        g_assert_cmpint (sqlite3_prepare_v2 (db, "PRAGMA user_version;", -1, &stmt, NULL), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_open_v2 (path, &db, SQLITE_OPEN_READWRITE, NULL), ==, SQLITE_OK);
+        sqlite3_busy_timeout (db, 5000);
+        g_assert_cmpint (sqlite3_prepare_v2 (db, "SELECT rowid, value FROM items ORDER BY rowid DESC LIMIT 1;", -1, &stmt, NULL), ==, SQLITE_OK);
         g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_ROW);
-        current_version = sqlite3_column_int64 (stmt, 0);
+
+        gint64 last = sqlite3_column_int64 (stmt, 0);
+        g_autoptr (GBytes) original = g_bytes_new (sqlite3_column_blob (stmt, 1), sqlite3_column_bytes (stmt, 1));
+
         sqlite3_finalize (stmt);
-        g_assert_cmpint (sqlite3_exec (db, "PRAGMA user_version = 99;", NULL, NULL, NULL), ==, SQLITE_OK);
+
+        gsize length = 0;
+        g_autofree guchar *broken = g_memdup2 (g_bytes_get_data (original, &length), g_bytes_get_size (original));
+
+        /* One bit of the MAC. */
+        broken[length - 1] ^= 1;
+        sqlite_raw_set_value (db, last, broken, length);
+
+        g_assert_false (g_paste_storage_backend_rekey (backend, name, new_passphrase));
+        g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM meta WHERE key LIKE 'rekey_%';"), ==, 0);
+        g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM sqlite_master WHERE name LIKE 'rekey%';"), ==, 0);
+
+        sqlite_raw_set_value (db, last, g_bytes_get_data (original, NULL), length);
         sqlite3_close (db);
 
+        /* Meanwhile, the history is still the old passphrase's, whole. */
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-            g_autolist (GPasteItem) loaded = read_history (backend, name);
-            g_assert_null (loaded);
+            g_autoptr (GPasteStorageBackend) old = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
+            g_autolist (GPasteItem) loaded = read_history_ok (old, name);
 
-            /* A write against the newer database must not touch it. */
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
-
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
+            g_assert_cmpuint (g_list_length (loaded), ==, n_items);
         }
 
-        /* Once the version is back within range, the original data is intact. */
-        g_autofree gchar *restore = g_strdup_printf ("PRAGMA user_version = %" G_GINT64_FORMAT ";", current_version);
+        g_assert_true (g_paste_storage_backend_rekey (backend, name, new_passphrase));
 
-        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
-        g_assert_cmpint (sqlite3_exec (db, restore, NULL, NULL, NULL), ==, SQLITE_OK);
-        sqlite3_close (db);
+        {
+            g_autoptr (GPasteStorageBackend) rekeyed = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
+            g_autolist (GPasteItem) loaded = read_history_ok (rekeyed, name);
 
-        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (G_PASTE_STORAGE_SQLITE, settings);
-        g_autolist (GPasteItem) loaded = read_history (backend, name);
-        g_assert_cmpuint (g_list_length (loaded), ==, 1);
-        g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
+            g_assert_cmpuint (g_list_length (loaded), ==, n_items);
+            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "item 599");
+        }
 
         return;
     }
 
-    G_PASTE_TEST_TRAP_SUBPROCESS ("*newer GPaste*");
+    G_PASTE_TEST_TRAP_SUBPROCESS ("*did not decrypt*");
 }
-#endif
 
-#ifdef G_PASTE_ENABLE_ENCRYPTION
-/* Two histories of the same flavor, keyed differently -- the state a rekey that
- * fails partway through leaves behind, and which the migration warns about by
- * name. A passphrase that opens one of them but not the other must be refused:
- * accepting it would load the one it cannot open as empty, and that history's
- * next save would then destroy the real content -- which is what answering on
- * the first history that opens would do. */
+/* Dies, like a logout would, as soon as two batches are in. */
 static void
-test_encrypted_split_keys_refuse_passphrase (void)
+sqlite_rekey_die_after_two_batches (guint64  done,
+                                    guint64  total,
+                                    gpointer user_data G_GNUC_UNUSED)
 {
-    const struct {
-        GPasteStorage kind;
-        const gchar  *first;
-        const gchar  *second;
-    } flavors[] = {
-        { G_PASTE_STORAGE_ENCRYPTED_FILE, "split-file-a", "split-file-b" },
-#ifdef G_PASTE_ENABLE_SQLITE
-        { G_PASTE_STORAGE_ENCRYPTED_SQLITE, "split-db-a", "split-db-b" },
-#endif
-    };
-
-    for (gsize i = 0; i < G_N_ELEMENTS (flavors); ++i)
-    {
-        const gchar *one = "passphrase one";
-        const gchar *two = "passphrase two";
-
-        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
-
-        /* Both hold data, so neither can be silently re-keyed on open. */
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, one);
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("first"));
+    g_assert_cmpuint (done, <, total);
 
-            g_paste_storage_backend_write_history (backend, flavors[i].first, items);
-            g_list_free_full (items, g_object_unref);
-        }
+    if (done >= 512)
+        _exit (0);
+}
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, two);
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("second"));
+/* A re-key interrupted part way — here by its process dying, the one way a
+ * re-key stops without failing — leaves the database on the old passphrase
+ * with its finished batches checkpointed. Until the next re-key, what the
+ * history drops leaves the side table too, so no copy of deleted content
+ * outlives it under the new passphrase; the next re-key to the same
+ * passphrase then picks up from there and completes. */
+static void
+test_encrypted_sqlite_rekey_resume (void)
+{
+    const gchar *name = "sqlite-rekey-resume";
+    const gchar *old_passphrase = "the old passphrase";
+    const gchar *new_passphrase = "the new passphrase";
+    /* Past two full batches, so there is a third left to resume. */
+    const guint n_items = 600;
 
-            g_paste_storage_backend_write_history (backend, flavors[i].second, items);
-            g_list_free_full (items, g_object_unref);
-        }
+    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-        /* Each opens its own and not the other, whichever is enumerated first. */
-        g_assert_false (g_paste_storage_passphrase_can_decrypt (flavors[i].kind, settings, one));
-        g_assert_false (g_paste_storage_passphrase_can_decrypt (flavors[i].kind, settings, two));
+    g_paste_settings_set_max_history_size (settings, n_items);
 
-        /* Both must go: every test in this binary shares one XDG_DATA_HOME, and
-         * a pair no single passphrase opens would make every later can_decrypt
-         * refuse -- which is precisely the behaviour under test.
-         *
-         * Not asserted for the same reason: that a passphrase opening
-         * everything is accepted. The scan sees whatever the other tests have
-         * left lying around under their own passphrases. */
-        g_autoptr (GPasteStorageBackend) cleanup_one = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, one);
-        g_autoptr (GPasteStorageBackend) cleanup_two = g_paste_storage_backend_new_with_passphrase (flavors[i].kind, settings, two);
+    if (g_test_subprocess ())
+    {
+        g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
 
-        g_paste_storage_backend_delete_history (cleanup_one, flavors[i].first, NULL);
-        g_paste_storage_backend_delete_history (cleanup_two, flavors[i].second, NULL);
+        sqlite_rekey_fill (settings, name, old_passphrase, n_items);
+        g_paste_storage_backend_rekey_with_progress (backend, name, new_passphrase, sqlite_rekey_die_after_two_batches, NULL);
+        g_assert_not_reached ();
     }
-}
-#endif
 
-#if defined(G_PASTE_ENABLE_SQLITE) && defined(G_PASTE_ENABLE_ENCRYPTION)
-/* The Argon2 parameters live in the store's own `meta` table, so anything that
- * can write to $XDG_DATA_HOME dictates them. An absurd opslimit would otherwise
- * have crypto_pwhash run effectively forever -- a denial of service just from
- * opening the history -- so deriving a key with them must be refused outright
- * rather than attempted. The real data must survive the refusal. */
-static void
-test_encrypted_sqlite_absurd_kdf_params (void)
-{
-    if (g_test_subprocess ())
-    {
-        G_PASTE_TEST_IN_SUBPROCESS;
+    /* The subprocess leaves its database for us to look at. */
+    g_auto (GStrv) envp = g_environ_setenv (g_get_environ (), "G_PASTE_TEST_DATA_HOME", g_get_user_data_dir (), TRUE);
 
-        const gchar *name = "sqlite-absurd-kdf";
-        const gchar *passphrase = "correct horse battery staple";
+    g_test_trap_subprocess_with_envp (NULL, (const gchar * const *) envp, 0, G_TEST_SUBPROCESS_DEFAULT);
+    g_test_trap_assert_passed ();
 
-        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT value FROM meta WHERE key = 'rekey_rowid';"), >, 0);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM rekey;"), ==, 512);
 
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
-        }
+    /* The first row the batches went through. */
+    g_autofree gchar *first = NULL;
+    gint64 first_id = 0;
 
-        g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
+    {
         sqlite3 *db = NULL;
+        sqlite3_stmt *stmt = NULL;
 
-        /* Way past crypto_pwhash_OPSLIMIT_SENSITIVE. Deriving with this is what
-         * we must never get as far as doing. */
-        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
-        g_assert_cmpint (sqlite3_exec (db, "UPDATE meta SET value = 4000000000 WHERE key = 'opslimit';", NULL, NULL, NULL), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_open_v2 (path, &db, SQLITE_OPEN_READONLY, NULL), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_prepare_v2 (db, "SELECT id, uuid FROM items ORDER BY id LIMIT 1;", -1, &stmt, NULL), ==, SQLITE_OK);
+        g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_ROW);
+        first_id = sqlite3_column_int64 (stmt, 0);
+        first = g_strdup ((const gchar *) sqlite3_column_text (stmt, 1));
+        sqlite3_finalize (stmt);
         sqlite3_close (db);
+    }
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
-            g_autolist (GPasteItem) loaded = read_history (backend, name);
-            g_assert_null (loaded);
+    g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
+    g_autofree gchar *copies = g_strdup_printf ("SELECT COUNT (*) FROM rekey WHERE row = %" G_GINT64_FORMAT ";", first_id);
 
-            /* And the refusal must not let a write clobber what is still there. */
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
+    g_assert_cmpint (sqlite_raw_count (path, copies), ==, 1);
+    g_paste_storage_backend_remove_item (backend, name, first, NULL);
+    g_assert_cmpint (sqlite_raw_count (path, copies), ==, 0);
 
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
-        }
+    /* Meanwhile, the history is still the old passphrase's. */
+    {
+        g_autoptr (GPasteStorageBackend) old = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
+        g_autolist (GPasteItem) loaded = read_history_ok (old, name);
 
-        /* Note what is deliberately *not* asserted here: that the passphrase is
-         * rejected. A store we cannot open is corrupt, not proof of a wrong
-         * passphrase, and saying otherwise would tell the user their correct one
-         * is wrong. Refusing the read and the write is what keeps the data safe,
-         * and that is what the restore below proves. */
+        g_assert_cmpuint (g_list_length (loaded), ==, n_items - 1);
+    }
 
-        /* Put the real parameters back: the original data is untouched. */
-        g_autofree gchar *restore = g_strdup_printf ("UPDATE meta SET value = %u WHERE key = 'opslimit';",
-                                                     (guint) crypto_pwhash_OPSLIMIT_MODERATE);
+    g_assert_true (g_paste_storage_backend_rekey (backend, name, new_passphrase));
 
-        g_assert_cmpint (sqlite3_open (path, &db), ==, SQLITE_OK);
-        g_assert_cmpint (sqlite3_exec (db, restore, NULL, NULL, NULL), ==, SQLITE_OK);
-        sqlite3_close (db);
+    {
+        g_autoptr (GPasteStorageBackend) rekeyed = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
+        g_autolist (GPasteItem) loaded = read_history_ok (rekeyed, name);
 
-        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new_with_passphrase (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, passphrase);
-        g_autolist (GPasteItem) loaded = read_history (backend, name);
-        g_assert_cmpuint (g_list_length (loaded), ==, 1);
-        g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
+        g_assert_cmpuint (g_list_length (loaded), ==, n_items - 1);
 
-        return;
+        for (GList *l = loaded; l; l = g_list_next (l))
+            g_assert_cmpstr (g_paste_item_get_uuid (l->data), !=, first);
     }
 
-    G_PASTE_TEST_TRAP_SUBPROCESS ("*Unreasonable key-derivation parameters*");
+    /* Nothing of the re-key outlives it. */
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM meta WHERE key LIKE 'rekey_%';"), ==, 0);
+    g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM sqlite_master WHERE name LIKE 'rekey%';"), ==, 0);
 }
 
-/* The encrypted SQLite flavor must round-trip everything the plain one does,
- * plus password items (real value and name), with no plaintext content ever
- * reaching the ".dbs" file. */
+/* The incremental save path works identically through the encrypted flavor,
+ * driven by the factory + process-wide passphrase like the daemon does it. */
 static void
-test_encrypted_sqlite_roundtrip (void)
+test_encrypted_sqlite_incremental (void)
 {
-    const gchar *name = "sqlite-encrypted";
-    const gchar *master = "the master passphrase";
-    const gchar *secret = "s3cr3t-passw0rd";
-    const gchar *pw_name = "my login";
-    const gchar *text_value = "plain text entry";
-    const gchar *html_value = "<b>hidden markup</b>";
+    const gchar *name = "sqlite-encrypted-incr";
+
+    g_paste_storage_backend_set_passphrase ("incremental passphrase");
 
     g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-    g_paste_settings_set_images_support (settings, TRUE);
+    g_paste_settings_set_growing_lines (settings, FALSE);
+    g_paste_settings_set_max_history_size (settings, 5);
+    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
+    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_ENCRYPTED_SQLITE);
 
-    g_autoptr (GBytes) png = test_png_bytes ();
-    g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
-    GList *items = NULL;
-    GPasteItem *text = g_paste_text_item_new (text_value);
+    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
 
-    g_paste_item_add_special_value (text, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
-                                                                   g_bytes_new_static (html_value, strlen (html_value))));
-    items = g_list_append (items, text);
-    items = g_list_append (items, g_paste_password_item_new (pw_name, secret));
-    items = g_list_append (items, g_paste_color_item_new_from_str ("rgb(0,255,0)"));
-    items = g_list_append (items, g_paste_image_item_new_from_bytes (png, date, NULL));
+    g_paste_history_load (history, name);
 
-    {
-        g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, master);
+    g_paste_history_add (history, g_paste_text_item_new ("a"));
+    g_autofree gchar *uuid_a = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
+    g_paste_history_add (history, g_paste_text_item_new ("b"));
+    g_paste_history_add (history, g_paste_text_item_new ("c"));
+    g_assert_true (g_paste_history_select (history, uuid_a));
+    g_paste_history_remove (history, 1); /* [a, c, b] -> drop c */
 
-        g_assert_true (g_paste_storage_backend_is_incremental (backend));
-        g_paste_storage_backend_write_history (backend, name, items);
+    const gchar * const after_ops[] = { "a", "b", NULL };
+    g_assert_true (sqlite_wait_for_values (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, name, after_ops, 5000));
 
-        g_auto (GStrv) names = g_paste_storage_backend_list_histories (backend, NULL);
-        g_assert_true (g_strv_contains ((const gchar * const *) names, name));
+    g_paste_history_empty (history);
 
-        /* Dropping the backend closes the connection, checkpointing the WAL so
-         * everything is in the main database file for the scan below. */
-    }
+    const gchar * const after_empty[] = { NULL };
+    g_assert_true (sqlite_wait_for_values (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, name, after_empty, 5000));
 
-    g_autofree gchar *path = g_paste_util_get_history_file_path (name, "dbs");
+    g_paste_storage_backend_set_passphrase (NULL);
+}
+#endif
 
-    g_assert_true (g_file_test (path, G_FILE_TEST_EXISTS));
-    g_assert_false (file_contains (path, text_value));
-    g_assert_false (file_contains (path, html_value));
-    g_assert_false (file_contains (path, secret));
-    g_assert_false (file_contains (path, pw_name));
-    /* The image blob is encrypted too: no PNG chunk marker in clear. */
-    g_assert_false (file_contains (path, "IHDR"));
+/* Text payloads shaped like what actually gets copied and compresses like it:
+ * source code, log lines and HTML, @seed varying the numbers in them. */
+typedef enum
+{
+    TEST_TEXT_CODE,
+    TEST_TEXT_LOG,
+    TEST_TEXT_HTML,
+    TEST_N_TEXT
+} TestTextKind;
 
-    /* The passphrase verification is quiet and flavor-aware. */
-    g_assert_true (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, master));
-    g_assert_false (g_paste_storage_passphrase_can_decrypt (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, "not the passphrase"));
+static const gchar *test_text_names[TEST_N_TEXT] = { "code", "log", "html" };
 
-    g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, master);
-    g_autolist (GPasteItem) loaded = read_history (backend, name);
+static gchar *
+test_corpus_text (TestTextKind kind,
+                  guint        seed,
+                  guint        lines)
+{
+    GString *text = g_string_new (NULL);
 
-    g_assert_cmpuint (g_list_length (loaded), ==, 4);
+    for (guint i = 0; i < lines; ++i)
+    {
+        guint n = seed * 7919 + i;
 
-    GPasteItem *read_text = loaded->data;
-    GPasteItem *read_password = loaded->next->data;
-    GPasteItem *read_color = loaded->next->next->data;
-    GPasteItem *read_image = loaded->next->next->next->data;
+        switch (kind)
+        {
+        case TEST_TEXT_CODE:
+            g_string_append_printf (text, "static gint\nhelper_%u (gint value_%u)\n{\n    return value_%u * %u + %u;\n}\n\n",
+                                    n, i, i, n % 97, n % 13);
+            break;
+        case TEST_TEXT_LOG:
+            g_string_append_printf (text, "2026-10-%02u 12:%02u:%02u.%03u host gpaste-daemon[%u]: history: saved %u items (%u bytes)\n",
+                                    1 + n % 28, n % 60, (n / 60) % 60, n % 1000, 1000 + seed, n % 200, n * 37 % 65536);
+            break;
+        case TEST_TEXT_HTML:
+            g_string_append_printf (text, "<tr class=\"row-%u\"><td><a href=\"https://example.org/item/%u\">Item %u</a></td><td>%u</td></tr>\n",
+                                    n % 2, n, n, n * 31 % 1000);
+            break;
+        case TEST_N_TEXT:
+            g_assert_not_reached ();
+        }
+    }
 
-    g_assert_cmpstr (g_paste_item_get_value (read_text), ==, text_value);
+    return g_string_free (text, FALSE);
+}
 
-    const GSList *svs = g_paste_item_get_special_values (read_text);
-    g_assert_cmpuint (g_slist_length ((GSList *) svs), ==, 1);
-    g_assert_cmpint (g_paste_binary_data_get_mime (svs->data), ==, G_PASTE_SPECIAL_ATOM_TEXT_HTML);
-    g_assert_cmpmem (g_bytes_get_data (g_paste_binary_data_get_bytes (svs->data), NULL), strlen (html_value),
-                     html_value, strlen (html_value));
+/* An HTML payload comes with its text/html special value, as a browser copy
+ * would. */
+static GPasteItem *
+test_corpus_item (TestTextKind kind,
+                  guint        seed,
+                  guint        lines)
+{
+    gchar *text = test_corpus_text (kind, seed, lines);
+    GPasteItem *item = g_paste_text_item_new (text);
 
-    g_assert_cmpint (g_paste_item_get_kind (read_password), ==, G_PASTE_ITEM_KIND_PASSWORD);
-    g_assert_cmpstr (g_paste_item_get_real_value (read_password), ==, secret);
-    g_assert_cmpstr (g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM ((gpointer) read_password)), ==, pw_name);
+    if (kind == TEST_TEXT_HTML)
+        g_paste_item_add_special_value (item, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML, g_bytes_new_take (text, strlen (text))));
+    else
+        g_free (text);
 
-    g_assert_cmpstr (g_paste_item_get_value (read_color), ==, g_paste_item_get_value (g_list_nth_data (items, 2)));
+    return item;
+}
 
-    GBytes *read_png = g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (read_image));
+static const gchar *test_storage_extensions[G_PASTE_N_STORAGE] = { NULL, "xml", "xmls", "db", "dbs" };
+
+/* What a history takes on disk: its file, plus whatever a SQLite one still
+ * holds in its WAL. */
+static goffset
+test_history_disk_size (GPasteStorage storage,
+                        const gchar  *name)
+{
+    g_autofree gchar *path = g_paste_util_get_history_file_path (name, test_storage_extensions[storage]);
+    g_autofree gchar *wal = g_strconcat (path, "-wal", NULL);
+    const gchar *paths[] = { path, wal };
+    goffset size = 0;
+
+    for (gsize i = 0; i < G_N_ELEMENTS (paths); ++i)
+    {
+        g_autoptr (GFile) file = g_file_new_for_path (paths[i]);
+        g_autoptr (GFileInfo) info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
 
-    g_assert_nonnull (read_png);
-    g_assert_true (g_bytes_equal (read_png, png));
+        if (info)
+            size += g_file_info_get_size (info);
+    }
 
-    g_list_free_full (items, g_object_unref);
+    return size;
 }
 
-/* A wrong passphrase must be refused outright — reads come back empty, writes
- * are dropped, the real data survives — while an *empty* encrypted history is
- * silently re-keyed for the new passphrase instead of locking the user out. */
+static const GPasteStorage test_compressing_storages[] = {
+    G_PASTE_STORAGE_FILE,
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    G_PASTE_STORAGE_ENCRYPTED_FILE,
+#endif
+#ifdef G_PASTE_ENABLE_SQLITE
+    G_PASTE_STORAGE_SQLITE,
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    G_PASTE_STORAGE_ENCRYPTED_SQLITE,
+#endif
+#endif
+};
+
+/* With "storage-compression" on, the payloads worth it are stored compressed
+ * and tagged, the small ones as they always were, and all of them come back
+ * exactly -- also once the setting is off again, the tags alone saying how to
+ * read what is stored. The encrypted flavors compress before they encrypt, so
+ * what they store ends up smaller than the text it holds. Skipped in a build
+ * without zstd. */
 static void
-test_encrypted_sqlite_wrong_passphrase (void)
+test_storage_compression_roundtrip (void)
 {
-    if (g_test_subprocess ())
+    if (!g_paste_storage_compression_is_available (G_PASTE_COMPRESSION_ZSTD))
     {
-        G_PASTE_TEST_IN_SUBPROCESS;
+        g_test_skip ("built without zstd");
+        return;
+    }
 
-        const gchar *name = "sqlite-encrypted-wrong";
+    const gchar *name = "storage-compression";
+
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    g_paste_storage_backend_set_passphrase ("compression passphrase");
+#endif
 
+    for (gsize s = 0; s < G_N_ELEMENTS (test_compressing_storages); ++s)
+    {
+        GPasteStorage storage = test_compressing_storages[s];
         g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "right passphrase");
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("precious"));
+        g_paste_settings_set_storage_compression (settings, G_PASTE_COMPRESSION_ZSTD);
 
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
-        }
+        g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (storage, settings);
+        GList *items = NULL;
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "wrong passphrase");
-            g_autolist (GPasteItem) loaded = read_history (backend, name);
-            g_assert_null (loaded);
+        items = g_list_append (items, test_corpus_item (TEST_TEXT_HTML, 1, 40));
+        items = g_list_append (items, test_corpus_item (TEST_TEXT_CODE, 1, 40));
+        items = g_list_append (items, g_paste_text_item_new ("too short to bother"));
 
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("usurper"));
+        g_paste_storage_backend_write_history (backend, name, items);
 
-            g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
-        }
+        g_autofree gchar *path = g_paste_util_get_history_file_path (name, test_storage_extensions[storage]);
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+        /* The two large values, the HTML one twice over with its special value. */
+        gsize html_length = strlen (g_paste_item_get_real_value (items->data));
+        gsize code_length = strlen (g_paste_item_get_real_value (items->next->data));
+#endif
 
+        if (storage == G_PASTE_STORAGE_FILE)
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "right passphrase");
-            g_autolist (GPasteItem) loaded = read_history (backend, name);
-            g_assert_cmpuint (g_list_length (loaded), ==, 1);
-            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, "precious");
-        }
-
-        /* An empty encrypted history holds nothing to lose: a different
-         * passphrase re-keys it instead of refusing it. */
-        const gchar *empty_name = "sqlite-encrypted-empty";
+            g_autofree gchar *contents = NULL;
 
+            g_assert_true (g_file_get_contents (path, &contents, NULL, NULL));
+            g_assert_nonnull (strstr (contents, "<history version=\"2.1\">"));
+            g_assert_nonnull (strstr (contents, "compression=\"Zstd\""));
+            g_assert_nonnull (strstr (contents, "too short to bother"));
+            g_assert_null (strstr (contents, "helper_"));
+        }
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+        else if (storage == G_PASTE_STORAGE_ENCRYPTED_FILE)
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "original passphrase");
-            g_autolist (GPasteItem) loaded = read_history (backend, empty_name);
-            g_assert_null (loaded);
+            /* Ciphertext does not compress: only compressing first gets the
+             * whole file below the text it holds. */
+            g_assert_cmpint (test_history_disk_size (storage, name), <, 2 * html_length + code_length);
         }
-
+#endif
+#ifdef G_PASTE_ENABLE_SQLITE
+        else
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, "replacement passphrase");
-            g_autolist (GPasteItem) loaded = read_history (backend, empty_name);
-            g_assert_null (loaded);
+            g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM items WHERE compression <> 0;"), ==, 2);
+            g_assert_cmpint (sqlite_raw_count (path, "SELECT COUNT (*) FROM special_values WHERE compression <> 0;"), ==, 1);
 
-            GList *items = g_list_append (NULL, g_paste_text_item_new ("fresh start"));
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+            if (storage == G_PASTE_STORAGE_ENCRYPTED_SQLITE)
+            {
+                /* Each one, nonce and MAC included, below its own plaintext. */
+                g_assert_cmpint (sqlite_raw_count (path, "SELECT MAX (length (CAST (value AS BLOB))) FROM items WHERE compression <> 0;"),
+                                 <, MIN (html_length, code_length));
+                g_assert_cmpint (sqlite_raw_count (path, "SELECT length (CAST (data AS BLOB)) FROM special_values;"), <, html_length);
+            }
+#endif
 
-            g_paste_storage_backend_write_history (backend, empty_name, items);
-            g_list_free_full (items, g_object_unref);
+            /* The full-text index holds the text, not what it is stored as. */
+            g_auto (GStrv) found = g_paste_storage_backend_search (backend, name, "helper_7920");
 
-            g_autolist (GPasteItem) refilled = read_history (backend, empty_name);
-            g_assert_cmpuint (g_list_length (refilled), ==, 1);
+            if (found)
+            {
+                g_assert_cmpuint (g_strv_length (found), ==, 1);
+                g_assert_cmpstr (found[0], ==, g_paste_item_get_uuid (items->next->data));
+            }
         }
+#endif
 
-        return;
+        g_paste_settings_set_storage_compression (settings, G_PASTE_COMPRESSION_NONE);
+
+        g_autolist (GPasteItem) loaded = read_history (backend, name);
+
+        g_assert_cmpuint (g_list_length (loaded), ==, 3);
+
+        for (const GList *l = loaded, *o = items; l; l = l->next, o = o->next)
+            g_assert_cmpstr (g_paste_item_get_real_value (l->data), ==, g_paste_item_get_real_value (o->data));
+
+        const GSList *read_svs = g_paste_item_get_special_values (loaded->data);
+        const GSList *orig_svs = g_paste_item_get_special_values (items->data);
+
+        g_assert_cmpuint (g_slist_length ((GSList *) read_svs), ==, 1);
+        g_assert_cmpint (g_paste_binary_data_get_mime (read_svs->data), ==, G_PASTE_SPECIAL_ATOM_TEXT_HTML);
+        g_assert_true (g_bytes_equal (g_paste_binary_data_get_bytes (read_svs->data), g_paste_binary_data_get_bytes (orig_svs->data)));
+
+        g_paste_storage_backend_delete_history (backend, name, NULL);
+        g_list_free_full (items, g_object_unref);
     }
 
-    G_PASTE_TEST_TRAP_SUBPROCESS ("*does not unlock*");
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    g_paste_storage_backend_set_passphrase (NULL);
+#endif
 }
 
-/* The database flavor re-keys every content column it holds — the value, the
- * password name, the image blob and the special values — in one go, so the new
- * passphrase reads all of it back and the old one no longer opens the file. */
+/* Not a test so much as a measurement: what each codec saves on disk, and
+ * what it costs or saves in save and load latency, per backend, for a history
+ * of source code, logs and HTML pages. Reported, not asserted; run with -m perf
+ * for a history the size of a real one. */
 static void
-test_encrypted_sqlite_rekey (void)
+test_storage_compression_benchmark (void)
 {
-    if (g_test_subprocess ())
-    {
-        /* The refused read with the old passphrase warns; see the file flavor's
-         * re-key test for why fatality is dropped here. */
-        G_PASTE_TEST_IN_SUBPROCESS;
+    static const gchar *storage_names[G_PASTE_N_STORAGE] = { "noop", "file", "encrypted-file", "sqlite", "encrypted-sqlite" };
+    static const gchar *compression_names[G_PASTE_N_COMPRESSION] = { "none", "zstd" };
+    const gchar *name = "storage-compression-benchmark";
+    guint count = (g_test_perf ()) ? 300 : 30;
+    GList *items = NULL;
 
-        const gchar *name = "sqlite-rekey";
-        const gchar *other_name = "sqlite-rekey-backup";
-        const gchar *other_value = "the second history";
-        const gchar *old_passphrase = "the old passphrase";
-        const gchar *new_passphrase = "the new passphrase";
-        const gchar *secret = "s3cr3t-passw0rd";
-        const gchar *pw_name = "my login";
-        const gchar *html_value = "<b>hidden markup</b>";
+    for (guint i = 0; i < count; ++i)
+        items = g_list_prepend (items, test_corpus_item (i % TEST_N_TEXT, i, 60));
 
-        g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
-        g_autoptr (GBytes) png = test_png_bytes_colored (11, 13, 17);
-        g_autoptr (GBytes) html = g_bytes_new_static (html_value, strlen (html_value));
-        g_autoptr (GDateTime) date = g_date_time_new_from_unix_local (1234567890);
+    g_test_message ("%u items, a third each of %s, %s and %s", count,
+                    test_text_names[TEST_TEXT_CODE], test_text_names[TEST_TEXT_LOG], test_text_names[TEST_TEXT_HTML]);
 
-        g_paste_settings_set_images_support (settings, TRUE);
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    g_paste_storage_backend_set_passphrase ("compression passphrase");
+#endif
 
+    for (gsize s = 0; s < G_N_ELEMENTS (test_compressing_storages); ++s)
+    {
+        GPasteStorage storage = test_compressing_storages[s];
+
+        for (GPasteCompression compression = 0; compression < G_PASTE_N_COMPRESSION; ++compression)
         {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
-            GPasteItem *text = g_paste_text_item_new ("plain text entry");
-            GList *items = NULL;
+            if (!g_paste_storage_compression_is_available (compression))
+                continue;
 
-            /* A special value exercises the special_values.data column. */
-            g_paste_item_add_special_value (text, g_paste_binary_data_new (G_PASTE_SPECIAL_ATOM_TEXT_HTML,
-                                                                           g_bytes_ref (html)));
+            g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
 
-            items = g_list_append (items, text);
-            items = g_list_append (items, g_paste_password_item_new (pw_name, secret));
-            items = g_list_append (items, g_paste_image_item_new_from_bytes (png, date, NULL));
+            g_paste_settings_set_storage_compression (settings, compression);
+
+            g_autoptr (GPasteStorageBackend) backend = g_paste_storage_backend_new (storage, settings);
+            gint64 start = g_get_monotonic_time ();
 
             g_paste_storage_backend_write_history (backend, name, items);
-            g_list_free_full (items, g_object_unref);
 
-            /* A second history (a backup, say): the daemon re-keys every one of
-             * them through this same backend, so re-keying must leave it able to
-             * open the ones it has not reached yet — still with the old
-             * passphrase. */
-            GList *other_items = g_list_append (NULL, g_paste_text_item_new (other_value));
+            gint64 saved = g_get_monotonic_time ();
+            g_autolist (GPasteItem) loaded = read_history (backend, name);
+            gint64 loaded_at = g_get_monotonic_time ();
 
-            g_paste_storage_backend_write_history (backend, other_name, other_items);
-            g_list_free_full (other_items, g_object_unref);
+            g_assert_cmpuint (g_list_length (loaded), ==, count);
+            g_test_message ("%-7s %-5s %10" G_GOFFSET_FORMAT " bytes  save %8.2f ms  load %8.2f ms",
+                            storage_names[storage], compression_names[compression],
+                            test_history_disk_size (storage, name),
+                            (saved - start) / 1000.0, (loaded_at - saved) / 1000.0);
 
-            g_assert_true (g_paste_storage_backend_rekey (backend, name, new_passphrase));
-            g_assert_true (g_paste_storage_backend_rekey (backend, other_name, new_passphrase));
+            g_paste_storage_backend_delete_history (backend, name, NULL);
+            g_paste_settings_set_storage_compression (settings, G_PASTE_COMPRESSION_NONE);
         }
+    }
 
-        /* Both histories moved, not just the first. */
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
-            g_autolist (GPasteItem) loaded = read_history_ok (backend, other_name);
-            g_assert_cmpuint (g_list_length (loaded), ==, 1);
-            g_assert_cmpstr (g_paste_item_get_value (loaded->data), ==, other_value);
-        }
+#ifdef G_PASTE_ENABLE_ENCRYPTION
+    g_paste_storage_backend_set_passphrase (NULL);
+#endif
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, new_passphrase);
-            g_autolist (GPasteItem) loaded = read_history_ok (backend, name);
-            g_assert_cmpuint (g_list_length (loaded), ==, 3);
+    g_list_free_full (items, g_object_unref);
+}
 
-            gboolean found_text = FALSE;
-            gboolean found_password = FALSE;
-            gboolean found_image = FALSE;
+/* With "compress-idle-items", a large item that stops being the active one is
+ * held compressed and counts for that, yet reads, searches and dedups like
+ * before; selecting it expands it again. Reading more of them than the cache
+ * keeps copies of does not lose any. Skipped in a build without zstd. */
+static void
+test_idle_items_compressed (void)
+{
+    if (!g_paste_storage_compression_is_available (G_PASTE_COMPRESSION_ZSTD))
+    {
+        g_test_skip ("built without zstd");
+        return;
+    }
 
-            for (const GList *l = loaded; l; l = l->next)
-            {
-                GPasteItem *item = l->data;
-                GPasteItemKind kind = g_paste_item_get_kind (item);
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
+    g_autoptr (GPtrArray) texts = g_ptr_array_new_with_free_func (g_free);
 
-                if (kind == G_PASTE_ITEM_KIND_PASSWORD)
-                {
-                    found_password = TRUE;
-                    g_assert_cmpstr (g_paste_item_get_real_value (item), ==, secret);
-                    g_assert_cmpstr (g_paste_password_item_get_name (G_PASTE_PASSWORD_ITEM (item)), ==, pw_name);
-                }
-                else if (kind == G_PASTE_ITEM_KIND_IMAGE)
-                {
-                    found_image = TRUE;
+    g_paste_settings_set_compress_idle_items (settings, TRUE);
 
-                    GBytes *read_png = g_paste_image_item_get_png_bytes (G_PASTE_IMAGE_ITEM (item));
+    for (guint i = 0; i < 12; ++i)
+    {
+        g_ptr_array_add (texts, test_corpus_text (i % TEST_N_TEXT, i, 100));
+        g_paste_history_add (history, g_paste_text_item_new (texts->pdata[i]));
+    }
 
-                    g_assert_nonnull (read_png);
-                    g_assert_true (g_bytes_equal (read_png, png));
-                }
-                else
-                {
-                    const GSList *svs = g_paste_item_get_special_values (item);
+    g_paste_history_add (history, g_paste_text_item_new ("short and active"));
 
-                    found_text = TRUE;
+    /* Newest first: item 1 is the last corpus text. */
+    GPasteItem *idle = g_paste_history_get (history, 1);
+    const gchar *text = texts->pdata[11];
 
-                    g_assert_cmpuint (g_slist_length ((GSList *) svs), ==, 1);
-                    g_assert_cmpint (g_paste_binary_data_get_mime (svs->data), ==, G_PASTE_SPECIAL_ATOM_TEXT_HTML);
-                    g_assert_true (g_bytes_equal (g_paste_binary_data_get_bytes (svs->data), html));
-                }
-            }
+    g_assert_cmpuint (g_paste_item_get_size (idle), <, strlen (text) / 2);
+    g_assert_cmpstr (g_paste_item_get_value (idle), ==, text);
 
-            g_assert_true (found_text);
-            g_assert_true (found_password);
-            g_assert_true (found_image);
-        }
+    for (guint i = 0; i < 12; ++i)
+        g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get (history, 12 - i)), ==, texts->pdata[i]);
 
-        {
-            g_autoptr (GPasteStorageBackend) backend = g_paste_sqlite_backend_new_encrypted (settings, old_passphrase);
-            assert_history_refused (backend, name);
-        }
+    /* Dedup still sees the value: re-adding it brings the same one forward. */
+    g_paste_history_add (history, g_paste_text_item_new (texts->pdata[3]));
+    g_assert_cmpuint (g_paste_history_get_length (history), ==, 13);
+    g_assert_cmpstr (g_paste_item_get_value (g_paste_history_get (history, 0)), ==, texts->pdata[3]);
 
-        return;
-    }
+    g_auto (GStrv) found = g_paste_history_search (history, "helper_23757");
 
-    G_PASTE_TEST_TRAP_SUBPROCESS ("*does not unlock*");
+    g_assert_cmpuint (g_strv_length (found), ==, 1);
+
+    g_autofree gchar *uuid = g_strdup (g_paste_item_get_uuid (idle));
+
+    g_assert_true (g_paste_history_select (history, uuid));
+    g_assert_cmpuint (g_paste_item_get_size (idle), >, strlen (text));
+    g_assert_cmpstr (g_paste_item_get_value (idle), ==, text);
+
+    g_paste_settings_set_compress_idle_items (settings, FALSE);
 }
 
-/* The incremental save path works identically through the encrypted flavor,
- * driven by the factory + process-wide passphrase like the daemon does it. */
+/* A long item is listed by the start of its display string, on one line and
+ * cut between graphemes, and tells how long the whole one is; a short one by
+ * the whole of it. The preview follows the value, and counts in the size. */
 static void
-test_encrypted_sqlite_incremental (void)
+test_item_preview (void)
 {
-    const gchar *name = "sqlite-encrypted-incr";
+    g_autoptr (GPasteItem) item = g_paste_text_item_new ("short\nenough");
 
-    g_paste_storage_backend_set_passphrase ("incremental passphrase");
+    g_assert_true (g_paste_item_get_preview (item) == g_paste_item_get_display_string (item));
+    g_assert_cmpuint (g_paste_item_get_display_length (item), ==, strlen ("short\nenough"));
 
-    g_autoptr (GPasteSettings) settings = g_paste_settings_new ();
+    g_autofree gchar *text = test_corpus_text (TEST_TEXT_CODE, 0, 100);
+    g_autoptr (GPasteItem) long_item = g_paste_text_item_new (text);
+    const gchar *preview = g_paste_item_get_preview (long_item);
 
-    g_paste_settings_set_growing_lines (settings, FALSE);
-    g_paste_settings_set_max_history_size (settings, 5);
-    g_paste_settings_set_max_memory_usage (settings, 1024 /* MiB */);
-    g_paste_settings_set_storage_backend (settings, G_PASTE_STORAGE_ENCRYPTED_SQLITE);
+    g_assert_cmpuint (g_utf8_strlen (preview, -1), ==, 512);
+    g_assert_true (g_str_has_prefix (preview, "static gint helper_0 (gint value_0) {     return"));
+    g_assert_null (strchr (preview, '\n'));
+    g_assert_cmpuint (g_paste_item_get_display_length (long_item), ==, strlen (text));
+    g_assert_cmpstr (g_paste_item_get_display_string (long_item), ==, text);
+    g_assert_cmpuint (g_paste_item_get_size (long_item), ==, strlen (text) + 1 + strlen (preview) + 1);
 
-    g_autoptr (GPasteHistory) history = g_paste_history_new (settings);
+    /* An "é" spelled with a combining accent, straddling the cut: both go. */
+    g_autoptr (GString) accented = g_string_new (NULL);
 
-    g_paste_history_load (history, name);
+    for (guint i = 0; i < 511; ++i)
+        g_string_append_c (accented, 'a');
+    g_string_append (accented, "e\xcc\x81 and more");
 
-    g_paste_history_add (history, g_paste_text_item_new ("a"));
-    g_autofree gchar *uuid_a = g_strdup (g_paste_item_get_uuid (g_paste_history_get (history, 0)));
-    g_paste_history_add (history, g_paste_text_item_new ("b"));
-    g_paste_history_add (history, g_paste_text_item_new ("c"));
-    g_assert_true (g_paste_history_select (history, uuid_a));
-    g_paste_history_remove (history, 1); /* [a, c, b] -> drop c */
+    g_paste_item_set_value (long_item, accented->str);
+    preview = g_paste_item_get_preview (long_item);
+    g_assert_cmpuint (g_utf8_strlen (preview, -1), ==, 511);
+    g_assert_cmpuint (g_paste_item_get_display_length (long_item), ==, accented->len);
 
-    const gchar * const after_ops[] = { "a", "b", NULL };
-    g_assert_true (sqlite_wait_for_values (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, name, after_ops, 5000));
+    g_paste_item_set_value (long_item, "short again");
+    g_assert_cmpstr (g_paste_item_get_preview (long_item), ==, "short again");
+    g_assert_cmpuint (g_paste_item_get_size (long_item), ==, strlen ("short again") + 1);
+}
 
-    g_paste_history_empty (history);
+/* The history finds an item by the bytes of its uuid: in whatever case the uuid
+ * is asked in, and never for what is no uuid. A uuid reads back the way it was
+ * set, lowercased. Short values live in the item and long ones apart from it,
+ * and a value going from one to the other reads and counts the same. */
+static void
+test_binary_uuid_index (void)
+{
+    g_autoptr (GPasteSettings) settings = NULL;
+    g_autoptr (GPasteHistory) history = make_history (&settings, 100);
 
-    const gchar * const after_empty[] = { NULL };
-    g_assert_true (sqlite_wait_for_values (G_PASTE_STORAGE_ENCRYPTED_SQLITE, settings, name, after_empty, 5000));
+    g_paste_history_add (history, g_paste_text_item_new ("short"));
 
-    g_paste_storage_backend_set_passphrase (NULL);
+    GPasteItem *item = g_paste_history_get (history, 0);
+    const gchar *uuid = g_paste_item_get_uuid (item);
+    g_autofree gchar *upper = g_ascii_strup (uuid, -1);
+
+    g_assert_true (g_paste_history_get_by_uuid (history, uuid) == item);
+    g_assert_true (g_paste_history_get_by_uuid (history, upper) == item);
+    g_assert_null (g_paste_history_get_by_uuid (history, ""));
+
+    GPasteUuid parsed;
+    gchar formatted[G_PASTE_UUID_STRING_LENGTH + 1];
+
+    g_assert_true (g_paste_uuid_parse (upper, &parsed));
+    g_paste_uuid_format (&parsed, formatted);
+    g_assert_cmpstr (formatted, ==, uuid);
+    g_assert_true (g_paste_uuid_equal (&parsed, g_paste_item_get_binary_uuid (item)));
+    g_assert_false (g_paste_uuid_parse ("0123abcd-0000-4000-8000-00000000fffg", &parsed));
+
+    g_autoptr (GPasteItem) loose = g_paste_text_item_new ("x");
+
+    g_paste_item_set_uuid (loose, "0123ABCD-0000-4000-8000-00000000FFFF");
+    g_assert_cmpstr (g_paste_item_get_uuid (loose), ==, "0123abcd-0000-4000-8000-00000000ffff");
+
+    g_autofree gchar *big = g_strnfill (100, 'b');
+
+    g_paste_item_set_value (loose, big);
+    g_assert_cmpstr (g_paste_item_get_value (loose), ==, big);
+    g_assert_cmpuint (g_paste_item_get_size (loose), ==, 101);
+
+    g_paste_item_set_value (loose, "tiny");
+    g_assert_cmpstr (g_paste_item_get_value (loose), ==, "tiny");
+    g_assert_cmpuint (g_paste_item_get_size (loose), ==, 5);
+
+    /* A piece of the very value it replaces. */
+    g_paste_item_set_value (loose, g_paste_item_get_value (loose) + 1);
+    g_assert_cmpstr (g_paste_item_get_value (loose), ==, "iny");
+    g_assert_cmpuint (g_paste_item_get_size (loose), ==, 4);
 }
+
+/* What an item costs on the heap, uuid index included, for 100k short
+ * snippets: the case where the per-item overhead is all there is. Reported,
+ * not asserted. */
+static void
+test_item_footprint_benchmark (void)
+{
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ (2, 33)
+    const guint n = 100000;
+    g_autoptr (GPtrArray) items = g_ptr_array_new_full (n, g_object_unref);
+    g_autoptr (GHashTable) index = g_hash_table_new (g_paste_uuid_hash, g_paste_uuid_equal);
+    struct mallinfo2 before = mallinfo2 ();
+
+    for (guint i = 0; i < n; ++i)
+    {
+        g_autofree gchar *text = g_strdup_printf ("snippet %u", i);
+        GPasteItem *item = g_paste_text_item_new (text);
+
+        g_ptr_array_add (items, item);
+        g_hash_table_insert (index, (gpointer) g_paste_item_get_binary_uuid (item), item);
+    }
+
+    struct mallinfo2 after = mallinfo2 ();
+    gsize used = (after.uordblks + after.hblkhd) - (before.uordblks + before.hblkhd);
+
+    g_assert_cmpuint (g_hash_table_size (index), ==, n);
+    g_test_message ("item footprint: %.1f bytes per item of %u", (gdouble) used / n, n);
+    return;
 #endif
+#endif
+    g_test_skip ("needs glibc's mallinfo2");
+}
 
 int
 main (int argc, char *argv[])
 {
-    /* Keep any persistence the model schedules out of the real user data dir. */
-    g_autofree gchar *tmp = g_dir_make_tmp ("gpaste-test-XXXXXX", NULL);
+    /* Keep any persistence the model schedules out of the real user data dir. A
+     * subprocess that leaves its work for the test to check is handed the
+     * test's. */
+    const gchar *shared = g_getenv ("G_PASTE_TEST_DATA_HOME");
+    g_autofree gchar *tmp = (shared) ? g_strdup (shared) : g_dir_make_tmp ("gpaste-test-XXXXXX", NULL);
     if (tmp)
     {
         g_setenv ("XDG_DATA_HOME", tmp, TRUE);
@@ -2934,12 +5718,24 @@ main (int argc, char *argv[])
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/history/image_capture_does_not_write", test_image_capture_does_not_write);
+    g_test_add_func ("/history/image_capture_async", test_image_capture_async);
+    g_test_add_func ("/history/image_capture_async_cancelled", test_image_capture_async_cancelled);
+    g_test_add_func ("/history/image_capture_from_png", test_image_capture_from_png);
+    g_test_add_func ("/history/image_fingerprint", test_image_fingerprint);
+    g_test_add_func ("/history/image_legacy_checksum_upgraded", test_image_legacy_checksum_upgraded);
+    g_test_add_func ("/history/file_image_legacy_checksum_migrated", test_file_image_legacy_checksum_migrated);
+    g_test_add_func ("/history/image_encoders_roundtrip", test_image_encoders_roundtrip);
+    g_test_add_func ("/history/image_encoders_benchmark", test_image_encoders_benchmark);
     g_test_add_func ("/history/file_image_materialization", test_file_image_materialization);
     g_test_add_func ("/history/history_image_names_no_file", test_history_image_names_no_file);
     g_test_add_func ("/history/file_image_per_history", test_file_image_per_history);
     g_test_add_func ("/history/file_backup_owns_images", test_file_backup_owns_images);
+    g_test_add_func ("/history/file_backup_copies_store", test_file_backup_copies_store);
     g_test_add_func ("/history/file_eviction_deletes_image", test_file_eviction_deletes_image);
     g_test_add_func ("/history/content_kind_transitions", test_content_kind_transitions);
+    g_test_add_func ("/history/text_sink_validates_and_caps", test_text_sink_validates_and_caps);
+    g_test_add_func ("/history/text_sink_aborts_oversized_read", test_text_sink_aborts_oversized_read);
+    g_test_add_func ("/history/clipboard_changes_coalesce", test_clipboard_changes_coalesce);
     g_test_add_func ("/history/same_display_string_keeps_size", test_same_display_string_keeps_size);
     g_test_add_func ("/history/add_get_length", test_add_get_length);
     g_test_add_func ("/history/dedup_moves_to_front", test_dedup_moves_to_front);
@@ -2961,6 +5757,11 @@ main (int argc, char *argv[])
     g_test_add_func ("/history/uris_item_answers_its_uris", test_uris_item_answers_its_uris);
     g_test_add_func ("/history/load_applies_the_caps", test_load_applies_the_caps);
     g_test_add_func ("/history/load_leaves_a_flushed_history_alone", test_load_leaves_a_flushed_history_alone);
+    g_test_add_func ("/history/recent_histories_switch_back", test_recent_histories_switch_back);
+    g_test_add_func ("/history/prefetch_likely_next_history", test_prefetch_likely_next_history);
+    g_test_add_func ("/history/shed_caches_under_memory_pressure", test_shed_caches_under_memory_pressure);
+    g_test_add_func ("/history/file_maintenance_removes_leftovers", test_file_maintenance_removes_leftovers);
+    g_test_add_func ("/history/history_handover", test_history_handover);
     g_test_add_func ("/history/select_moves_to_front", test_select_moves_to_front);
     g_test_add_func ("/history/empty", test_empty);
     g_test_add_func ("/history/save_load_roundtrip", test_save_load_roundtrip);
@@ -2969,28 +5770,49 @@ main (int argc, char *argv[])
     g_test_add_func ("/history/delete_refused_after_flush", test_delete_refused_after_flush);
     g_test_add_func ("/history/file_v1_refused_and_preserved", test_file_v1_refused_and_preserved);
     g_test_add_func ("/history/file_version_guard", test_file_version_guard);
+    g_test_add_func ("/history/storage_compression_roundtrip", test_storage_compression_roundtrip);
+    g_test_add_func ("/history/storage_compression_benchmark", test_storage_compression_benchmark);
+    g_test_add_func ("/history/idle_items_compressed", test_idle_items_compressed);
+    g_test_add_func ("/history/item_preview", test_item_preview);
+    g_test_add_func ("/history/binary_uuid_index", test_binary_uuid_index);
+    g_test_add_func ("/history/item_footprint_benchmark", test_item_footprint_benchmark);
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     g_test_add_func ("/history/encrypted_roundtrip", test_encrypted_roundtrip);
+    g_test_add_func ("/history/encrypted_stream_master_key", test_encrypted_stream_master_key);
+    g_test_add_func ("/history/encrypted_segmented_stream", test_encrypted_segmented_stream);
+    g_test_add_func ("/history/encrypted_stream_benchmark", test_encrypted_stream_benchmark);
     g_test_add_func ("/history/encrypted_explicit_passphrase", test_encrypted_explicit_passphrase);
     g_test_add_func ("/history/encrypted_rekey", test_encrypted_rekey);
     g_test_add_func ("/history/encrypted_split_keys_refuse_passphrase", test_encrypted_split_keys_refuse_passphrase);
+    g_test_add_func ("/history/encrypted_file_key_check", test_encrypted_file_key_check);
 #endif
 #ifdef G_PASTE_ENABLE_SQLITE
     g_test_add_func ("/history/sqlite_roundtrip", test_sqlite_roundtrip);
     g_test_add_func ("/history/sqlite_incremental", test_sqlite_incremental);
     g_test_add_func ("/history/sqlite_replace", test_sqlite_replace);
     g_test_add_func ("/history/sqlite_cascade", test_sqlite_cascade);
+    g_test_add_func ("/history/sqlite_maintenance", test_sqlite_maintenance);
     g_test_add_func ("/history/sqlite_migration_keeps_destination_images", test_sqlite_migration_keeps_destination_images);
+    g_test_add_func ("/history/sqlite_import_digest_match", test_sqlite_import_digest_match);
+    g_test_add_func ("/history/sqlite_import_digest_mismatch", test_sqlite_import_digest_mismatch);
+    g_test_add_func ("/history/sqlite_copy_history", test_sqlite_copy_history);
     g_test_add_func ("/history/sqlite_image_blob", test_sqlite_image_blob);
     g_test_add_func ("/history/sqlite_eviction_deletes_no_image", test_sqlite_eviction_deletes_no_image);
     g_test_add_func ("/history/sqlite_no_rewrite_on_switch", test_sqlite_no_rewrite_on_switch);
     g_test_add_func ("/history/sqlite_version_guard", test_sqlite_version_guard);
     g_test_add_func ("/history/sqlite_schema_migration", test_sqlite_schema_migration);
+    g_test_add_func ("/history/sqlite_fts_search", test_sqlite_fts_search);
+    g_test_add_func ("/history/sqlite_single_database", test_sqlite_single_database);
+    g_test_add_func ("/history/sqlite_layout_switch_keeps_every_row", test_sqlite_layout_switch_keeps_every_row);
+    g_test_add_func ("/history/tiered_history", test_tiered_history);
+    g_test_add_func ("/history/progressive_load", test_progressive_load);
 #ifdef G_PASTE_ENABLE_ENCRYPTION
     g_test_add_func ("/history/encrypted_sqlite_absurd_kdf_params", test_encrypted_sqlite_absurd_kdf_params);
     g_test_add_func ("/history/encrypted_sqlite_roundtrip", test_encrypted_sqlite_roundtrip);
     g_test_add_func ("/history/encrypted_sqlite_wrong_passphrase", test_encrypted_sqlite_wrong_passphrase);
     g_test_add_func ("/history/encrypted_sqlite_rekey", test_encrypted_sqlite_rekey);
+    g_test_add_func ("/history/encrypted_sqlite_rekey_failure", test_encrypted_sqlite_rekey_failure);
+    g_test_add_func ("/history/encrypted_sqlite_rekey_resume", test_encrypted_sqlite_rekey_resume);
     g_test_add_func ("/history/encrypted_sqlite_incremental", test_encrypted_sqlite_incremental);
 #endif
 #endif